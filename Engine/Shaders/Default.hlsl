@@ -12,10 +12,15 @@
 #define NUM_SPOT_LIGHTS 10
 #endif
 
+// Size of the texture table, must match the descriptor range of the root signature.
+#ifndef MAX_TEXTURES
+#define MAX_TEXTURES 1024
+#endif
+
 // Include structures and functions for lighting.
 #include "../Shaders/LightningUtils.hlsl"
 
-Texture2D    gDiffuseMap : register(t0);
+Texture2D    gTextureMaps[MAX_TEXTURES] : register(t0);
 
 SamplerState gsamPointWrap        : register(s0);
 SamplerState gsamPointClamp       : register(s1);
@@ -24,11 +29,42 @@ SamplerState gsamLinearClamp      : register(s3);
 SamplerState gsamAnisotropicWrap  : register(s4);
 SamplerState gsamAnisotropicClamp : register(s5);
 
-// Constant data that varies per frame.
-cbuffer cbPerObject : register(b0)
+struct InstanceData
+{
+    float4x4 World;
+    float4x4 TexTransform;
+    uint     MaterialIndex;
+    uint     InstPad0;
+    uint     InstPad1;
+    uint     InstPad2;
+};
+
+struct MaterialData
 {
-    float4x4 gWorld;
-    float4x4 gTexTransform;
+    float4   DiffuseAlbedo;
+    float3   FresnelR0;
+    float    Roughness;
+    float4x4 MatTransform;
+    uint     DiffuseMapIndex;
+    uint     MatPad0;
+    uint     MatPad1;
+    uint     MatPad2;
+};
+
+// Data of every render item, indexed by its ObjConstantBufferIndex.
+StructuredBuffer<InstanceData> gInstanceData : register(t0, space1);
+StructuredBuffer<MaterialData> gMaterialData : register(t1, space1);
+// Instances of this frame's draws, grouped by draw.
+StructuredBuffer<uint> gInstanceIndices : register(t2, space1);
+
+// Constant data that varies per draw.
+cbuffer cbPerDraw : register(b0)
+{
+    // Position of the draw's first instance in gInstanceIndices.
+    uint gBaseInstance;
+    // Decodes packed positions of the submesh, PosL = offset + unorm * scale.
+    float3 gPositionOffset;
+    float3 gPositionScale;
 };
 
 cbuffer cbPass : register(b1)
@@ -61,21 +97,31 @@ cbuffer cbPass : register(b1)
     Light gLights[MaxLights];
 };
 
-// Constant data that varies per material.
-cbuffer cbMaterial : register(b2)
+#ifdef PACKED_VERTICES
+// PackedVertex: unorm position within the submesh bounds, octahedral normal and half
+// texture coordinates.  The input assembler converts them to floats.
+struct VertexIn
 {
-    float4   gDiffuseAlbedo;
-    float3   gFresnelR0;
-    float    gRoughness;
-    float4x4 gMatTransform;
+    float4 PosL    : POSITION;
+    float2 NormalL : NORMAL;
+    float2 TexC    : TEXCOORD;
 };
 
+float3 OctahedralDecode(float2 e)
+{
+    float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+#else
 struct VertexIn
 {
 	float3 PosL    : POSITION;
     float3 NormalL : NORMAL;
 	float2 TexC    : TEXCOORD;
 };
+#endif
 
 struct VertexOut
 {
@@ -83,32 +129,61 @@ struct VertexOut
     float3 PosW    : POSITION;
     float3 NormalW : NORMAL;
 	float2 TexC    : TEXCOORD;
+
+    // nointerpolation is used so the index is not interpolated across the triangle.
+    nointerpolation uint MatIndex : MATINDEX;
 };
 
-VertexOut VS(VertexIn vin)
+VertexOut VS(VertexIn vin, uint instanceID : SV_InstanceID)
 {
     VertexOut vout = (VertexOut)0.0f;
 
+    // Fetch the instance data.
+    InstanceData instData = gInstanceData[gInstanceIndices[gBaseInstance + instanceID]];
+    float4x4 world = instData.World;
+    float4x4 texTransform = instData.TexTransform;
+    uint matIndex = instData.MaterialIndex;
+
+    vout.MatIndex = matIndex;
+
+    // Fetch the material data.
+    MaterialData matData = gMaterialData[matIndex];
+
+#ifdef PACKED_VERTICES
+    float3 posL = gPositionOffset + vin.PosL.xyz * gPositionScale;
+    float3 normalL = OctahedralDecode(vin.NormalL);
+#else
+    float3 posL = vin.PosL;
+    float3 normalL = vin.NormalL;
+#endif
+
     // Transform to world space.
-    float4 posW = mul(float4(vin.PosL, 1.0f), gWorld);
+    float4 posW = mul(float4(posL, 1.0f), world);
     vout.PosW = posW.xyz;
 
     // Assumes nonuniform scaling; otherwise, need to use inverse-transpose of world matrix.
-    vout.NormalW = mul(vin.NormalL, (float3x3)gWorld);
+    vout.NormalW = mul(normalL, (float3x3)world);
 
     // Transform to homogeneous clip space.
     vout.PosH = mul(posW, gViewProj);
 
     // Output vertex attributes for interpolation across triangle.
-    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), gTexTransform);
-    vout.TexC = mul(texC, gMatTransform).xy;
+    float4 texC = mul(float4(vin.TexC, 0.0f, 1.0f), texTransform);
+    vout.TexC = mul(texC, matData.MatTransform).xy;
 
     return vout;
 }
 
 float4 PS(VertexOut pin) : SV_Target
 {
-    float4 diffuseAlbedo = gDiffuseMap.Sample(gsamAnisotropicWrap, pin.TexC) * gDiffuseAlbedo;
+    // Fetch the material data.
+    MaterialData matData = gMaterialData[pin.MatIndex];
+    float4 diffuseAlbedo = matData.DiffuseAlbedo;
+    float3 fresnelR0 = matData.FresnelR0;
+    float  roughness = matData.Roughness;
+
+    // Draws are batched by texture, so the index is the same for the whole draw.
+    diffuseAlbedo *= gTextureMaps[matData.DiffuseMapIndex].Sample(gsamAnisotropicWrap, pin.TexC);
 
     #ifdef ALPHA_TEST
     // Discard pixel if texture alpha < 0.1.  We do this test as soon 
@@ -127,8 +202,8 @@ float4 PS(VertexOut pin) : SV_Target
     // Light terms.
     float4 ambient = gAmbientLight * diffuseAlbedo;
 
-    const float shininess = 1.0f - gRoughness;
-    Material mat = { gDiffuseAlbedo, gFresnelR0, shininess };
+    const float shininess = 1.0f - roughness;
+    Material mat = { matData.DiffuseAlbedo, fresnelR0, shininess };
     float shadowFactor[NUM_DIR_LIGHTS];
     for (int i = 0; i < NUM_DIR_LIGHTS; i++)
         shadowFactor[i] = 1.0f;
@@ -143,7 +218,7 @@ float4 PS(VertexOut pin) : SV_Target
     #endif
 
         // Common convention to take alpha from diffuse material.
-        litColor.a = gDiffuseAlbedo.a;
+        litColor.a = matData.DiffuseAlbedo.a;
 
         return litColor;
 }
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "Engine.h"
+#include "BlobCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace
+{
+	struct CacheFileHeader
+	{
+		std::uint32_t Magic;
+		std::uint32_t Version;
+		std::uint32_t EntryCount;
+		std::uint32_t Pad;
+	};
+
+	struct CacheFileEntry
+	{
+		std::uint64_t Hash;
+		std::uint64_t Offset;
+		std::uint64_t ByteSize;
+	};
+
+	const std::uint64_t HashPrime = 1099511628211ull;
+}
+
+BlobCache::BlobCache(std::uint32_t fileMagic, std::uint32_t fileVersion) :
+	m_FileMagic(fileMagic),
+	m_FileVersion(fileVersion)
+{
+}
+
+bool BlobCache::Load(const std::filesystem::path& path)
+{
+	m_Entries.clear();
+	m_Stored = false;
+
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+		return false;
+
+	std::ostringstream stream;
+	stream << file.rdbuf();
+	const std::string data = stream.str();
+	if (data.size() < sizeof(CacheFileHeader))
+		return false;
+
+	CacheFileHeader header;
+	std::memcpy(&header, data.data(), sizeof(header));
+	if (header.Magic != m_FileMagic || header.Version != m_FileVersion)
+		return false;
+
+	std::uint64_t indexEnd = sizeof(CacheFileHeader) + (std::uint64_t)header.EntryCount * sizeof(CacheFileEntry);
+	if (indexEnd > data.size())
+		return false;
+
+	for (std::uint32_t i = 0; i < header.EntryCount; ++i)
+	{
+		CacheFileEntry entry;
+		std::memcpy(&entry, data.data() + sizeof(CacheFileHeader) + i * sizeof(CacheFileEntry), sizeof(entry));
+		if (entry.Offset < indexEnd || entry.Offset > data.size() || entry.ByteSize > data.size() - entry.Offset)
+		{
+			m_Entries.clear();
+			return false;
+		}
+
+		const std::uint8_t* bytes = reinterpret_cast<const std::uint8_t*>(data.data()) + entry.Offset;
+		m_Entries[entry.Hash].Data.assign(bytes, bytes + entry.ByteSize);
+	}
+
+	return true;
+}
+
+bool BlobCache::Save(const std::filesystem::path& path) const
+{
+	std::vector<std::pair<std::uint64_t, const Blob*>> used;
+	for (auto& e : m_Entries)
+	{
+		if (e.second.Used)
+			used.push_back({ e.first, &e.second.Data });
+	}
+
+	CacheFileHeader header = { m_FileMagic, m_FileVersion, (std::uint32_t)used.size(), 0 };
+
+	std::vector<CacheFileEntry> index;
+	std::uint64_t offset = sizeof(CacheFileHeader) + used.size() * sizeof(CacheFileEntry);
+	for (auto& u : used)
+	{
+		index.push_back({ u.first, offset, u.second->size() });
+		offset += u.second->size();
+	}
+
+	std::filesystem::path tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file)
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(CacheFileEntry));
+		for (auto& u : used)
+			file.write(reinterpret_cast<const char*>(u.second->data()), u.second->size());
+
+		if (!file)
+		{
+			file.close();
+			std::error_code ec;
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tempPath, path, ec);
+	return !ec;
+}
+
+const BlobCache::Blob* BlobCache::Find(std::uint64_t hash)
+{
+	auto it = m_Entries.find(hash);
+	if (it == m_Entries.end())
+	{
+		m_Misses++;
+		return nullptr;
+	}
+
+	m_Hits++;
+	it->second.Used = true;
+	return &it->second.Data;
+}
+
+void BlobCache::Store(std::uint64_t hash, Blob blob)
+{
+	Entry& entry = m_Entries[hash];
+	entry.Data = std::move(blob);
+	entry.Used = true;
+	m_Stored = true;
+}
+
+bool BlobCache::IsDirty() const
+{
+	if (m_Stored)
+		return true;
+
+	for (auto& e : m_Entries)
+	{
+		if (!e.second.Used)
+			return true;
+	}
+	return false;
+}
+
+std::uint32_t BlobCache::EntryCount() const
+{
+	return (std::uint32_t)m_Entries.size();
+}
+
+std::uint32_t BlobCache::Hits() const
+{
+	return m_Hits;
+}
+
+std::uint32_t BlobCache::Misses() const
+{
+	return m_Misses;
+}
+
+std::uint64_t BlobCache::HashBytes(const void* data, size_t byteSize, std::uint64_t hash)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+	for (size_t i = 0; i < byteSize; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= HashPrime;
+	}
+	return hash;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+// Blobs keyed by a 64-bit hash, persisted in one file: a header, an index of hashes,
+// offsets and sizes, then the blobs.  Holds the bytes of the shader and pipeline caches.
+class ENGINE_API BlobCache
+{
+public:
+	using Blob = std::vector<std::uint8_t>;
+
+	static const std::uint64_t HashBasis = 14695981039346656037ull;
+
+	// fileMagic and fileVersion tell the files of different caches and layouts apart.
+	BlobCache(std::uint32_t fileMagic, std::uint32_t fileVersion);
+	BlobCache(const BlobCache& rhs) = delete;
+	BlobCache& operator=(const BlobCache& rhs) = delete;
+	~BlobCache() = default;
+
+	// Replaces the entries with the ones of a cache file.  Returns false and leaves the cache
+	// empty if the file is missing, truncated or was written by another version.
+	bool Load(const std::filesystem::path& path);
+	// Writes the entries used since Load(), the ones nobody asked for are dropped.  The file
+	// is replaced atomically.
+	bool Save(const std::filesystem::path& path) const;
+
+	// nullptr on a miss.
+	const Blob* Find(std::uint64_t hash);
+	void Store(std::uint64_t hash, Blob blob);
+
+	// True if Save() would write something different from the loaded file.
+	bool IsDirty() const;
+	std::uint32_t EntryCount() const;
+	std::uint32_t Hits() const;
+	std::uint32_t Misses() const;
+
+	// 64-bit FNV-1a, continuing from hash.
+	static std::uint64_t HashBytes(const void* data, size_t byteSize, std::uint64_t hash = HashBasis);
+
+private:
+	struct Entry
+	{
+		Blob Data;
+		bool Used = false;
+	};
+
+	std::uint32_t m_FileMagic;
+	std::uint32_t m_FileVersion;
+
+	std::unordered_map<std::uint64_t, Entry> m_Entries;
+	bool m_Stored = false;
+	std::uint32_t m_Hits = 0;
+	std::uint32_t m_Misses = 0;
+};
@@ -0,0 +1,158 @@
+#include "Engine.h"
+#include "DescriptorAllocator.h"
+
+DescriptorAllocator::DescriptorAllocator(std::uint32_t capacity) :
+	m_Capacity(capacity)
+{
+	if (capacity > 0)
+		AddFreeRange(0, capacity);
+}
+
+std::uint32_t DescriptorAllocator::Allocate(std::uint32_t count)
+{
+	assert(count > 0);
+
+	auto best = m_FreeBySize.lower_bound(count);
+	if (best == m_FreeBySize.end())
+		return InvalidOffset;
+
+	std::uint32_t offset = best->second;
+	std::uint32_t size = best->first;
+	RemoveFreeRange(m_FreeByOffset.find(offset));
+
+	// The rest of the range stays free.
+	if (size > count)
+		AddFreeRange(offset + count, size - count);
+
+	m_AllocatedCount += count;
+	return offset;
+}
+
+void DescriptorAllocator::Free(std::uint32_t offset, std::uint32_t count)
+{
+	assert(count > 0 && offset + count <= m_Capacity);
+	assert(m_AllocatedCount >= count);
+
+	m_AllocatedCount -= count;
+
+	// Merge with the free range that ends at offset and the one that starts after the range.
+	auto next = m_FreeByOffset.lower_bound(offset);
+	assert(next == m_FreeByOffset.end() || next->first >= offset + count);
+	if (next != m_FreeByOffset.begin())
+	{
+		auto prev = std::prev(next);
+		assert(prev->first + prev->second <= offset);
+		if (prev->first + prev->second == offset)
+		{
+			offset = prev->first;
+			count += prev->second;
+			RemoveFreeRange(prev);
+		}
+	}
+	if (next != m_FreeByOffset.end() && next->first == offset + count)
+	{
+		count += next->second;
+		RemoveFreeRange(next);
+	}
+
+	AddFreeRange(offset, count);
+}
+
+std::uint32_t DescriptorAllocator::Capacity() const
+{
+	return m_Capacity;
+}
+
+std::uint32_t DescriptorAllocator::AllocatedCount() const
+{
+	return m_AllocatedCount;
+}
+
+std::uint32_t DescriptorAllocator::FreeRangeCount() const
+{
+	return (std::uint32_t)m_FreeByOffset.size();
+}
+
+std::uint32_t DescriptorAllocator::LargestFreeRange() const
+{
+	return m_FreeBySize.empty() ? 0 : m_FreeBySize.rbegin()->first;
+}
+
+void DescriptorAllocator::AddFreeRange(std::uint32_t offset, std::uint32_t count)
+{
+	m_FreeByOffset.emplace(offset, count);
+	m_FreeBySize.emplace(count, offset);
+}
+
+void DescriptorAllocator::RemoveFreeRange(std::map<std::uint32_t, std::uint32_t>::iterator range)
+{
+	// Several free ranges may have the same size, find the one at this offset.
+	auto sizes = m_FreeBySize.equal_range(range->second);
+	for (auto it = sizes.first; it != sizes.second; ++it)
+	{
+		if (it->second == range->first)
+		{
+			m_FreeBySize.erase(it);
+			break;
+		}
+	}
+	m_FreeByOffset.erase(range);
+}
+
+TransientDescriptorRing::TransientDescriptorRing(std::uint32_t capacity) :
+	m_Capacity(capacity)
+{
+}
+
+std::uint32_t TransientDescriptorRing::Allocate(std::uint32_t count)
+{
+	assert(count > 0);
+	if (count > m_Capacity)
+		return InvalidOffset;
+
+	std::uint64_t head = m_Head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		// Allocations do not wrap around the end of the ring, the rest of it is skipped.
+		std::uint64_t start = head;
+		std::uint64_t offset = start % m_Capacity;
+		if (offset + count > m_Capacity)
+			start += m_Capacity - offset;
+
+		if (start + count - m_Tail.load(std::memory_order_acquire) > m_Capacity)
+			return InvalidOffset;
+
+		// Another thread may have moved the head, then try again from its position.
+		if (m_Head.compare_exchange_weak(head, start + count, std::memory_order_relaxed))
+			return (std::uint32_t)(start % m_Capacity);
+	}
+}
+
+void TransientDescriptorRing::EndFrame(std::uint64_t fence)
+{
+	std::uint64_t head = m_Head.load(std::memory_order_relaxed);
+	std::uint64_t ended = m_Frames.empty() ? m_Tail.load(std::memory_order_relaxed) : m_Frames.back().End;
+	if (head != ended)
+		m_Frames.push_back({ fence, head });
+}
+
+void TransientDescriptorRing::Retire(std::uint64_t completedFence)
+{
+	std::uint64_t tail = m_Tail.load(std::memory_order_relaxed);
+	while (!m_Frames.empty() && m_Frames.front().Fence <= completedFence)
+	{
+		tail = m_Frames.front().End;
+		m_Frames.pop_front();
+	}
+	m_Tail.store(tail, std::memory_order_release);
+}
+
+std::uint32_t TransientDescriptorRing::Capacity() const
+{
+	return m_Capacity;
+}
+
+std::uint32_t TransientDescriptorRing::UsedCount() const
+{
+	return (std::uint32_t)(m_Head.load(std::memory_order_relaxed) - m_Tail.load(std::memory_order_relaxed));
+}
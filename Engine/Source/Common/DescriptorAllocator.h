@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+
+// Hands out ranges of long lived descriptors.  Free ranges are kept sorted by offset, so a
+// freed range merges with its free neighbours, and by size, so an allocation takes the
+// smallest range it fits in.  Offsets only, knows nothing about D3D.
+class ENGINE_API DescriptorAllocator
+{
+public:
+	static const std::uint32_t InvalidOffset = 0xFFFFFFFF;
+
+	explicit DescriptorAllocator(std::uint32_t capacity);
+	DescriptorAllocator(const DescriptorAllocator& rhs) = delete;
+	DescriptorAllocator& operator=(const DescriptorAllocator& rhs) = delete;
+	~DescriptorAllocator() = default;
+
+	// Returns the offset of count contiguous descriptors, or InvalidOffset when no free range
+	// is large enough.
+	std::uint32_t Allocate(std::uint32_t count);
+	// offset and count must be a range returned by Allocate().
+	void Free(std::uint32_t offset, std::uint32_t count);
+
+	std::uint32_t Capacity() const;
+	std::uint32_t AllocatedCount() const;
+	// Number of free ranges and the size of the largest one, measure the fragmentation.
+	std::uint32_t FreeRangeCount() const;
+	std::uint32_t LargestFreeRange() const;
+
+private:
+	void AddFreeRange(std::uint32_t offset, std::uint32_t count);
+	void RemoveFreeRange(std::map<std::uint32_t, std::uint32_t>::iterator range);
+
+private:
+	std::uint32_t m_Capacity;
+	std::uint32_t m_AllocatedCount = 0;
+
+	// Offset to size, and size to offset, of every free range.
+	std::map<std::uint32_t, std::uint32_t> m_FreeByOffset;
+	std::multimap<std::uint32_t, std::uint32_t> m_FreeBySize;
+};
+
+// Hands out descriptors that are only used by the frame they are allocated in.  Allocations
+// advance a ring position and may come from several recording threads at once.  At the end
+// of a frame its descriptors are tagged with the frame's fence, and reused once that fence
+// is complete.  Offsets only, knows nothing about D3D.
+class ENGINE_API TransientDescriptorRing
+{
+public:
+	static const std::uint32_t InvalidOffset = 0xFFFFFFFF;
+
+	explicit TransientDescriptorRing(std::uint32_t capacity);
+	TransientDescriptorRing(const TransientDescriptorRing& rhs) = delete;
+	TransientDescriptorRing& operator=(const TransientDescriptorRing& rhs) = delete;
+	~TransientDescriptorRing() = default;
+
+	// Returns the offset of count contiguous descriptors, or InvalidOffset when the frames in
+	// flight use the rest of the ring.  Thread safe and lock free.
+	std::uint32_t Allocate(std::uint32_t count);
+
+	// Tags the descriptors allocated since the last call with fence.  Must not run at the
+	// same time as Allocate().
+	void EndFrame(std::uint64_t fence);
+	// Frees the descriptors of the frames whose fence is at most completedFence.  May run at
+	// the same time as Allocate(), but not as EndFrame().
+	void Retire(std::uint64_t completedFence);
+
+	std::uint32_t Capacity() const;
+	// Descriptors allocated and not yet retired, including the ones skipped at the end of
+	// the ring.
+	std::uint32_t UsedCount() const;
+
+private:
+	struct Frame
+	{
+		std::uint64_t Fence;
+		// Ring position after the last allocation of the frame.
+		std::uint64_t End;
+	};
+
+	std::uint32_t m_Capacity;
+
+	// Positions grow without wrapping, the offset is the position modulo the capacity.
+	std::atomic<std::uint64_t> m_Head = 0;
+	std::atomic<std::uint64_t> m_Tail = 0;
+	std::deque<Frame> m_Frames;
+};
@@ -0,0 +1,310 @@
+#include "Engine.h"
+#include "JobSystem.h"
+
+namespace
+{
+	// Queue of the calling thread.  A thread only owns a queue of the job system that
+	// created it (or, for thread 0, the job system it created).
+	thread_local JobSystem* t_Owner = nullptr;
+	thread_local int t_ThreadIndex = -1;
+}
+
+JobSystem* JobSystem::s_Instance = nullptr;
+
+JobSystem::JobSystem(std::uint32_t workerCount)
+{
+	if (workerCount == 0)
+	{
+		std::uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (std::uint32_t i = 0; i < workerCount + 1; ++i)
+		m_Queues.push_back(std::make_unique<WorkQueue>());
+
+	t_Owner = this;
+	t_ThreadIndex = 0;
+
+	m_Workers.reserve(workerCount);
+	for (std::uint32_t i = 1; i <= workerCount; ++i)
+		m_Workers.emplace_back(&JobSystem::WorkerMain, this, i);
+
+	s_Instance = this;
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_Running = false;
+	}
+	m_WakeUp.notify_all();
+
+	for (auto& worker : m_Workers)
+		worker.join();
+
+	// Jobs that were never run.
+	for (auto& queue : m_Queues)
+	{
+		while (Job* job = queue->Pop())
+			delete job;
+	}
+	for (Job* job : m_SharedJobs)
+		delete job;
+
+	if (t_Owner == this)
+	{
+		t_Owner = nullptr;
+		t_ThreadIndex = -1;
+	}
+
+	if (s_Instance == this)
+		s_Instance = nullptr;
+}
+
+JobSystem* JobSystem::Instance()
+{
+	return s_Instance;
+}
+
+std::uint32_t JobSystem::ThreadCount() const
+{
+	return (std::uint32_t)m_Queues.size();
+}
+
+void JobSystem::Run(JobCounter* counter, JobFunction job)
+{
+	if (counter != nullptr)
+		counter->Value.fetch_add(1);
+
+	Job* newJob = new Job{ std::move(job), counter };
+
+	// Count the job before it becomes visible, so a thief never sees it uncounted.
+	m_PendingJobs.fetch_add(1);
+
+	int threadIndex = ThreadIndex();
+	if (threadIndex < 0)
+	{
+		std::lock_guard<std::mutex> lock(m_SharedMutex);
+		m_SharedJobs.push_back(newJob);
+	}
+	else if (!m_Queues[threadIndex]->Push(newJob))
+	{
+		// The queue is full, run the job right away instead.
+		m_PendingJobs.fetch_sub(1);
+		Execute(newJob);
+		return;
+	}
+
+	if (m_SleepingWorkers.load() > 0)
+	{
+		// Taking the lock orders the notification after a worker's check of the pending
+		// count, so the wake up cannot be lost.
+		std::lock_guard<std::mutex> lock(m_SleepMutex);
+		m_WakeUp.notify_one();
+	}
+}
+
+void JobSystem::Wait(JobCounter& counter)
+{
+	int threadIndex = ThreadIndex();
+
+	while (counter.Value.load(std::memory_order_acquire) > 0)
+	{
+		Job* job = threadIndex >= 0 ? FindJob((std::uint32_t)threadIndex) : nullptr;
+		if (job != nullptr)
+			Execute(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::WorkerMain(std::uint32_t threadIndex)
+{
+	t_Owner = this;
+	t_ThreadIndex = (int)threadIndex;
+
+	while (m_Running.load())
+	{
+		if (Job* job = FindJob(threadIndex))
+		{
+			Execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(m_SleepMutex);
+		m_SleepingWorkers.fetch_add(1);
+		m_WakeUp.wait(lock, [this]() { return m_PendingJobs.load() > 0 || !m_Running.load(); });
+		m_SleepingWorkers.fetch_sub(1);
+	}
+}
+
+int JobSystem::ThreadIndex() const
+{
+	return t_Owner == this ? t_ThreadIndex : -1;
+}
+
+JobSystem::Job* JobSystem::FindJob(std::uint32_t threadIndex)
+{
+	// Newest local work first, it is most likely still in the cache.
+	Job* job = m_Queues[threadIndex]->Pop();
+
+	if (job == nullptr)
+	{
+		std::lock_guard<std::mutex> lock(m_SharedMutex);
+		if (!m_SharedJobs.empty())
+		{
+			job = m_SharedJobs.back();
+			m_SharedJobs.pop_back();
+		}
+	}
+
+	// Steal the oldest work of the other threads, which tends to be the largest.
+	std::uint32_t queueCount = (std::uint32_t)m_Queues.size();
+	for (std::uint32_t i = 1; job == nullptr && i < queueCount; ++i)
+		job = m_Queues[(threadIndex + i) % queueCount]->Steal();
+
+	if (job != nullptr)
+		m_PendingJobs.fetch_sub(1);
+
+	return job;
+}
+
+void JobSystem::Execute(Job* job)
+{
+	job->Function();
+
+	if (job->Counter != nullptr)
+		job->Counter->Value.fetch_sub(1, std::memory_order_release);
+
+	delete job;
+}
+
+bool JobSystem::WorkQueue::Push(Job* job)
+{
+	std::int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+	std::int64_t top = m_Top.load(std::memory_order_acquire);
+	if (bottom - top >= Capacity)
+		return false;
+
+	m_Jobs[bottom & (Capacity - 1)].store(job, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+JobSystem::Job* JobSystem::WorkQueue::Pop()
+{
+	std::int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+	m_Bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::int64_t top = m_Top.load(std::memory_order_relaxed);
+
+	if (top > bottom)
+	{
+		// Empty.
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = m_Jobs[bottom & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (top == bottom)
+	{
+		// Last job, race the thieves for it.
+		if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			job = nullptr;
+		m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+JobSystem::Job* JobSystem::WorkQueue::Steal()
+{
+	std::int64_t top = m_Top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	std::int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+	if (top >= bottom)
+		return nullptr;
+
+	Job* job = m_Jobs[top & (Capacity - 1)].load(std::memory_order_relaxed);
+	if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		return nullptr;
+
+	return job;
+}
+
+JobGraph::NodeId JobGraph::Add(JobSystem::JobFunction job)
+{
+	Node node;
+	node.Function = std::move(job);
+	node.RemainingDependencies = std::make_unique<std::atomic<std::uint32_t>>(0);
+	m_Nodes.push_back(std::move(node));
+	return (NodeId)(m_Nodes.size() - 1);
+}
+
+void JobGraph::Precede(NodeId before, NodeId after)
+{
+	m_Nodes[before].Successors.push_back(after);
+	m_Nodes[after].DependencyCount++;
+}
+
+void JobGraph::Run(JobSystem* jobSystem)
+{
+	if (jobSystem == nullptr)
+	{
+		// Serial topological order.
+		std::vector<std::uint32_t> remaining(m_Nodes.size());
+		std::vector<NodeId> ready;
+		for (NodeId id = 0; id < (NodeId)m_Nodes.size(); ++id)
+		{
+			remaining[id] = m_Nodes[id].DependencyCount;
+			if (remaining[id] == 0)
+				ready.push_back(id);
+		}
+
+		while (!ready.empty())
+		{
+			NodeId id = ready.back();
+			ready.pop_back();
+			m_Nodes[id].Function();
+
+			for (NodeId successor : m_Nodes[id].Successors)
+			{
+				if (--remaining[successor] == 0)
+					ready.push_back(successor);
+			}
+		}
+		return;
+	}
+
+	for (auto& node : m_Nodes)
+		node.RemainingDependencies->store(node.DependencyCount, std::memory_order_relaxed);
+
+	JobCounter counter;
+	for (NodeId id = 0; id < (NodeId)m_Nodes.size(); ++id)
+	{
+		if (m_Nodes[id].DependencyCount == 0)
+			Schedule(jobSystem, &counter, id);
+	}
+
+	jobSystem->Wait(counter);
+}
+
+void JobGraph::Schedule(JobSystem* jobSystem, JobCounter* counter, NodeId id)
+{
+	jobSystem->Run(counter, [this, jobSystem, counter, id]()
+		{
+			Node& node = m_Nodes[id];
+			node.Function();
+
+			// Successors are scheduled before this job is counted as done, so the counter
+			// cannot reach zero while the graph still has work left.
+			for (NodeId successor : node.Successors)
+			{
+				if (m_Nodes[successor].RemainingDependencies->fetch_sub(1, std::memory_order_acq_rel) == 1)
+					Schedule(jobSystem, counter, successor);
+			}
+		});
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts outstanding jobs.  Run() increments it when a job is scheduled and the job
+// decrements it when it has finished, so waiting for zero waits for all of them.
+struct JobCounter
+{
+	std::atomic<std::uint32_t> Value = 0;
+};
+
+// Work stealing job system.  Every thread has a Chase-Lev deque: the owner pushes and
+// pops jobs at the bottom, idle threads steal the oldest jobs from the top of another
+// thread's deque.  The thread that creates the job system takes part as thread 0 whenever
+// it waits, so a wait never blocks a core.  Only the standard library is used.
+class ENGINE_API JobSystem
+{
+public:
+	using JobFunction = std::function<void()>;
+
+	// workerCount 0 starts one worker per hardware thread besides the calling thread.
+	explicit JobSystem(std::uint32_t workerCount = 0);
+	JobSystem(const JobSystem& rhs) = delete;
+	JobSystem& operator=(const JobSystem& rhs) = delete;
+	~JobSystem();
+
+	// The most recently created job system, or nullptr.  Code that may run without one
+	// (tools, tests) falls back to running serially.
+	static JobSystem* Instance();
+
+	// Number of threads that execute jobs, including the creating thread.
+	std::uint32_t ThreadCount() const;
+
+	// Schedules a job.  counter may be nullptr for fire-and-forget jobs.
+	void Run(JobCounter* counter, JobFunction job);
+
+	// Executes jobs until counter reaches zero.
+	void Wait(JobCounter& counter);
+
+	// Calls func(begin, end) on ranges of at most grainSize items covering [0, count)
+	// and returns when all of them are done.
+	template<typename Func>
+	void ParallelFor(std::uint32_t count, std::uint32_t grainSize, Func&& func);
+
+private:
+	struct Job
+	{
+		JobFunction Function;
+		JobCounter* Counter = nullptr;
+	};
+
+	// Fixed capacity Chase-Lev deque ("Correct and Efficient Work-Stealing for Weak
+	// Memory Models", Le et al. 2013).
+	class WorkQueue
+	{
+	public:
+		bool Push(Job* job);
+		Job* Pop();
+		Job* Steal();
+
+	private:
+		static const std::int64_t Capacity = 4096;
+
+		alignas(64) std::atomic<std::int64_t> m_Top = 0;
+		alignas(64) std::atomic<std::int64_t> m_Bottom = 0;
+		std::atomic<Job*> m_Jobs[Capacity] = {};
+	};
+
+	void WorkerMain(std::uint32_t threadIndex);
+	// Index of the calling thread's queue, or -1 for threads that do not belong to this
+	// job system.
+	int ThreadIndex() const;
+	Job* FindJob(std::uint32_t threadIndex);
+	void Execute(Job* job);
+
+private:
+	static JobSystem* s_Instance;
+
+	std::vector<std::unique_ptr<WorkQueue>> m_Queues;
+	std::vector<std::thread> m_Workers;
+
+	// Jobs scheduled from threads that do not own a queue.
+	std::mutex m_SharedMutex;
+	std::vector<Job*> m_SharedJobs;
+
+	// Idle workers sleep until a job is scheduled.
+	std::atomic<std::uint32_t> m_PendingJobs = 0;
+	std::atomic<std::uint32_t> m_SleepingWorkers = 0;
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeUp;
+	std::atomic<bool> m_Running = true;
+};
+
+// Set of jobs with dependencies between them.  The graph can be run any number of times.
+class ENGINE_API JobGraph
+{
+public:
+	using NodeId = std::uint32_t;
+
+	NodeId Add(JobSystem::JobFunction job);
+	// after does not start before before has finished.
+	void Precede(NodeId before, NodeId after);
+
+	// Runs every node once, independent nodes in parallel, and returns when all are done.
+	// Without a job system the nodes run serially in dependency order.
+	void Run(JobSystem* jobSystem);
+
+private:
+	struct Node
+	{
+		JobSystem::JobFunction Function;
+		std::vector<NodeId> Successors;
+		std::uint32_t DependencyCount = 0;
+		std::unique_ptr<std::atomic<std::uint32_t>> RemainingDependencies;
+	};
+
+	void Schedule(JobSystem* jobSystem, JobCounter* counter, NodeId id);
+
+private:
+	std::vector<Node> m_Nodes;
+};
+
+template<typename Func>
+void JobSystem::ParallelFor(std::uint32_t count, std::uint32_t grainSize, Func&& func)
+{
+	if (count == 0)
+		return;
+
+	grainSize = grainSize > 0 ? grainSize : 1;
+	std::uint32_t jobCount = (count + grainSize - 1) / grainSize;
+
+	if (jobCount == 1)
+	{
+		func(0u, count);
+		return;
+	}
+
+	// The calling thread takes the first range and helps with the rest while waiting.
+	JobCounter counter;
+	for (std::uint32_t j = 1; j < jobCount; ++j)
+	{
+		std::uint32_t begin = j * grainSize;
+		std::uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+		Run(&counter, [&func, begin, end]() { func(begin, end); });
+	}
+
+	func(0u, grainSize);
+	Wait(counter);
+}
@@ -0,0 +1,332 @@
+#include "Engine.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+namespace
+{
+	struct Float3
+	{
+		float X, Y, Z;
+	};
+
+	Float3 Position(const void* vertices, size_t vertexStride, std::uint32_t index)
+	{
+		Float3 p;
+		std::memcpy(&p, static_cast<const std::uint8_t*>(vertices) + index * vertexStride, sizeof(p));
+		return p;
+	}
+
+	// Triangles around every vertex, as offsets into one array.
+	struct Adjacency
+	{
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+	};
+
+	void BuildAdjacency(const std::uint32_t* indices, size_t indexCount, size_t vertexCount, Adjacency& adjacency)
+	{
+		adjacency.Offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			adjacency.Offsets[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacency.Offsets[v + 1] += adjacency.Offsets[v];
+
+		std::vector<std::uint32_t> cursor(adjacency.Offsets.begin(), adjacency.Offsets.end() - 1);
+		adjacency.Triangles.resize(indexCount);
+		for (size_t i = 0; i < indexCount; ++i)
+			adjacency.Triangles[cursor[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+}
+
+MeshOptimizer::Result MeshOptimizer::Optimize(void* vertices, size_t vertexStride, size_t vertexCount,
+	std::uint32_t* indices, size_t indexCount, bool optimizeOverdraw)
+{
+	Result result;
+	result.Before = AnalyzeVertexCache(indices, indexCount, vertexCount);
+
+	// Exported meshes are often cache ordered already, the input order is kept unless
+	// Tipsify beats it.
+	std::vector<std::uint32_t> original(indices, indices + indexCount);
+	std::vector<std::uint32_t> clusterStarts;
+	OptimizeVertexCache(indices, indexCount, vertexCount, DefaultCacheSize, &clusterStarts);
+
+	VertexCacheStats cacheOrder = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	if (cacheOrder.TransformCount >= result.Before.TransformCount)
+	{
+		std::memcpy(indices, original.data(), indexCount * sizeof(std::uint32_t));
+		clusterStarts.clear();
+		cacheOrder = result.Before;
+	}
+
+	// Sorting the clusters breaks reuse across their boundaries, it is undone if that
+	// costs more than a few percent of the transforms.
+	if (optimizeOverdraw && clusterStarts.size() > 1)
+	{
+		std::vector<std::uint32_t> cacheOrdered(indices, indices + indexCount);
+		OptimizeOverdraw(indices, indexCount, vertices, vertexStride, clusterStarts);
+		if (AnalyzeVertexCache(indices, indexCount, vertexCount).Acmr > cacheOrder.Acmr * OverdrawAcmrThreshold)
+			std::memcpy(indices, cacheOrdered.data(), indexCount * sizeof(std::uint32_t));
+	}
+
+	OptimizeVertexFetch(vertices, vertexStride, vertexCount, indices, indexCount);
+
+	result.After = AnalyzeVertexCache(indices, indexCount, vertexCount);
+	return result;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::uint32_t* indices, size_t indexCount,
+	size_t vertexCount, std::uint32_t cacheSize)
+{
+	VertexCacheStats stats;
+	stats.TriangleCount = (std::uint32_t)(indexCount / 3);
+
+	// A vertex is in the FIFO while fewer than cacheSize vertices were added after it.
+	std::vector<std::uint32_t> addedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	std::uint32_t time = cacheSize + 1;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		std::uint32_t v = indices[i];
+		if (!used[v])
+		{
+			used[v] = true;
+			stats.VertexCount++;
+		}
+		if (time - addedAt[v] > cacheSize)
+		{
+			addedAt[v] = time++;
+			stats.TransformCount++;
+		}
+	}
+
+	if (stats.TriangleCount > 0)
+		stats.Acmr = (float)stats.TransformCount / stats.TriangleCount;
+	if (stats.VertexCount > 0)
+		stats.Atvr = (float)stats.TransformCount / stats.VertexCount;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::uint32_t* indices, size_t indexCount, size_t vertexCount,
+	std::uint32_t cacheSize, std::vector<std::uint32_t>* clusterStarts)
+{
+	if (clusterStarts != nullptr)
+		clusterStarts->clear();
+
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	Adjacency adjacency;
+	BuildAdjacency(indices, indexCount, vertexCount, adjacency);
+
+	std::vector<std::uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v)
+		liveTriangles[v] = adjacency.Offsets[v + 1] - adjacency.Offsets[v];
+
+	std::vector<std::uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<std::uint32_t> deadEnd;
+	std::vector<std::uint32_t> candidates;
+
+	std::vector<std::uint32_t> output;
+	output.reserve(indexCount);
+
+	std::uint32_t time = cacheSize + 1;
+	std::uint32_t scan = 0;
+
+	// Start at the first vertex that has triangles.
+	std::int64_t fan = -1;
+	while (scan < vertexCount && liveTriangles[scan] == 0)
+		++scan;
+	if (scan < vertexCount)
+		fan = scan;
+
+	if (clusterStarts != nullptr)
+		clusterStarts->push_back(0);
+
+	while (fan >= 0)
+	{
+		// Emit every triangle around the fanning vertex.
+		candidates.clear();
+		for (std::uint32_t a = adjacency.Offsets[fan]; a < adjacency.Offsets[fan + 1]; ++a)
+		{
+			std::uint32_t t = adjacency.Triangles[a];
+			if (emitted[t])
+				continue;
+
+			for (std::uint32_t k = 0; k < 3; ++k)
+			{
+				std::uint32_t v = indices[3 * t + k];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+				if (time - cacheTime[v] > cacheSize)
+					cacheTime[v] = time++;
+			}
+			emitted[t] = true;
+		}
+
+		// Next fan: the candidate that stays longest in the cache after its remaining
+		// triangles are emitted.
+		std::int64_t next = -1;
+		std::int64_t bestPriority = -1;
+		for (std::uint32_t v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			std::int64_t priority = 0;
+			std::int64_t age = time - cacheTime[v];
+			if (age + 2 * (std::int64_t)liveTriangles[v] <= cacheSize)
+				priority = age;
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = v;
+			}
+		}
+
+		if (next < 0)
+		{
+			// Dead end: a recently used vertex with triangles left, else the next one in
+			// input order.  Either way the following triangles start a new cluster.
+			while (!deadEnd.empty() && next < 0)
+			{
+				std::uint32_t v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0)
+					next = v;
+			}
+			while (next < 0 && scan < vertexCount)
+			{
+				if (liveTriangles[scan] > 0)
+					next = scan;
+				else
+					++scan;
+			}
+
+			if (next >= 0 && clusterStarts != nullptr)
+				clusterStarts->push_back((std::uint32_t)(output.size() / 3));
+		}
+
+		fan = next;
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(std::uint32_t));
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::uint32_t* indices, size_t indexCount,
+	const void* vertices, size_t vertexStride, const std::vector<std::uint32_t>& clusterStarts)
+{
+	std::uint32_t triangleCount = (std::uint32_t)(indexCount / 3);
+	std::uint32_t clusterCount = (std::uint32_t)clusterStarts.size();
+	if (clusterCount < 2)
+		return;
+
+	// Area weighted centroid and normal of each cluster and of the whole mesh.
+	std::vector<Float3> centroids(clusterCount, { 0.0f, 0.0f, 0.0f });
+	std::vector<Float3> normals(clusterCount, { 0.0f, 0.0f, 0.0f });
+	std::vector<float> areas(clusterCount, 0.0f);
+	Float3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (std::uint32_t c = 0; c < clusterCount; ++c)
+	{
+		std::uint32_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+		for (std::uint32_t t = clusterStarts[c]; t < end; ++t)
+		{
+			Float3 p0 = Position(vertices, vertexStride, indices[3 * t + 0]);
+			Float3 p1 = Position(vertices, vertexStride, indices[3 * t + 1]);
+			Float3 p2 = Position(vertices, vertexStride, indices[3 * t + 2]);
+
+			Float3 e1 = { p1.X - p0.X, p1.Y - p0.Y, p1.Z - p0.Z };
+			Float3 e2 = { p2.X - p0.X, p2.Y - p0.Y, p2.Z - p0.Z };
+			// Twice the area times the unit normal.
+			Float3 n = { e1.Y * e2.Z - e1.Z * e2.Y, e1.Z * e2.X - e1.X * e2.Z, e1.X * e2.Y - e1.Y * e2.X };
+			float area = std::sqrt(n.X * n.X + n.Y * n.Y + n.Z * n.Z);
+
+			Float3 center = { (p0.X + p1.X + p2.X) / 3.0f, (p0.Y + p1.Y + p2.Y) / 3.0f, (p0.Z + p1.Z + p2.Z) / 3.0f };
+			centroids[c].X += center.X * area;
+			centroids[c].Y += center.Y * area;
+			centroids[c].Z += center.Z * area;
+			normals[c].X += n.X;
+			normals[c].Y += n.Y;
+			normals[c].Z += n.Z;
+			areas[c] += area;
+		}
+
+		meshCentroid.X += centroids[c].X;
+		meshCentroid.Y += centroids[c].Y;
+		meshCentroid.Z += centroids[c].Z;
+		meshArea += areas[c];
+	}
+
+	if (meshArea > 0.0f)
+	{
+		meshCentroid.X /= meshArea;
+		meshCentroid.Y /= meshArea;
+		meshCentroid.Z /= meshArea;
+	}
+
+	// How far the cluster faces away from the mesh center.
+	std::vector<float> sortKeys(clusterCount, 0.0f);
+	for (std::uint32_t c = 0; c < clusterCount; ++c)
+	{
+		if (areas[c] <= 0.0f)
+			continue;
+
+		Float3 n = normals[c];
+		float length = std::sqrt(n.X * n.X + n.Y * n.Y + n.Z * n.Z);
+		if (length <= 0.0f)
+			continue;
+
+		Float3 d = { centroids[c].X / areas[c] - meshCentroid.X, centroids[c].Y / areas[c] - meshCentroid.Y,
+			centroids[c].Z / areas[c] - meshCentroid.Z };
+		sortKeys[c] = (d.X * n.X + d.Y * n.Y + d.Z * n.Z) / length;
+	}
+
+	std::vector<std::uint32_t> order(clusterCount);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+		[&](std::uint32_t a, std::uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+	std::vector<std::uint32_t> output;
+	output.reserve(indexCount);
+	for (std::uint32_t c : order)
+	{
+		std::uint32_t end = c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount;
+		output.insert(output.end(), indices + 3 * clusterStarts[c], indices + 3 * end);
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(std::uint32_t));
+}
+
+void MeshOptimizer::OptimizeVertexFetch(void* vertices, size_t vertexStride, size_t vertexCount,
+	std::uint32_t* indices, size_t indexCount)
+{
+	const std::uint32_t unused = 0xFFFFFFFF;
+
+	std::vector<std::uint32_t> remap(vertexCount, unused);
+	std::uint32_t next = 0;
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		if (remap[indices[i]] == unused)
+			remap[indices[i]] = next++;
+		indices[i] = remap[indices[i]];
+	}
+	for (size_t v = 0; v < vertexCount; ++v)
+	{
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+
+	std::uint8_t* bytes = static_cast<std::uint8_t*>(vertices);
+	std::vector<std::uint8_t> copy(bytes, bytes + vertexCount * vertexStride);
+	for (size_t v = 0; v < vertexCount; ++v)
+		std::memcpy(bytes + remap[v] * vertexStride, copy.data() + v * vertexStride, vertexStride);
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Transforms of a post-transform vertex cache simulated as a FIFO.
+struct VertexCacheStats
+{
+	std::uint32_t TriangleCount = 0;
+	// Vertices referenced by at least one triangle.
+	std::uint32_t VertexCount = 0;
+	std::uint32_t TransformCount = 0;
+	// Average cache miss ratio, transforms per triangle: 3 without any reuse, 0.5 to 0.7
+	// for a well ordered regular mesh.
+	float Acmr = 0.0f;
+	// Average transform to vertex ratio, 1 means every vertex is transformed once.
+	float Atvr = 0.0f;
+};
+
+// Reorders triangle lists for the GPU.  Triangles are ordered for the post-transform vertex
+// cache with Tipsify ("Fast Triangle Reordering for Vertex Locality and Reduced Overdraw",
+// Sander et al. 2007), the resulting clusters are optionally sorted so that outward facing
+// ones are drawn first, and vertices are then renumbered in the order the triangles first
+// use them.  Works on 32-bit indices and any vertex layout that starts with a float3
+// position.
+class ENGINE_API MeshOptimizer
+{
+public:
+	// Smaller than any current GPU, a cache order for it does not thrash a larger cache.
+	static const std::uint32_t DefaultCacheSize = 16;
+	// ACMR increase the overdraw order may cost over the cache order.
+	static constexpr float OverdrawAcmrThreshold = 1.05f;
+
+	struct Result
+	{
+		VertexCacheStats Before;
+		VertexCacheStats After;
+	};
+
+	// Runs the three passes below in order, keeping the input order where it is better.
+	static Result Optimize(void* vertices, size_t vertexStride, size_t vertexCount,
+		std::uint32_t* indices, size_t indexCount, bool optimizeOverdraw = true);
+
+	static VertexCacheStats AnalyzeVertexCache(const std::uint32_t* indices, size_t indexCount,
+		size_t vertexCount, std::uint32_t cacheSize = DefaultCacheSize);
+
+	// Reorders the triangles in place.  clusterStarts, if given, receives the first
+	// triangle of each cluster, a run of triangles drawn without jumping across the mesh.
+	static void OptimizeVertexCache(std::uint32_t* indices, size_t indexCount, size_t vertexCount,
+		std::uint32_t cacheSize = DefaultCacheSize, std::vector<std::uint32_t>* clusterStarts = nullptr);
+
+	// Reorders the clusters found by OptimizeVertexCache() so that the ones facing away
+	// from the center of the mesh, which tend to occlude the others, are drawn first.
+	static void OptimizeOverdraw(std::uint32_t* indices, size_t indexCount,
+		const void* vertices, size_t vertexStride, const std::vector<std::uint32_t>& clusterStarts);
+
+	// Renumbers the vertices in the order the triangles first use them and moves them to
+	// match.  Vertices no triangle uses keep their order after the used ones.
+	static void OptimizeVertexFetch(void* vertices, size_t vertexStride, size_t vertexCount,
+		std::uint32_t* indices, size_t indexCount);
+};
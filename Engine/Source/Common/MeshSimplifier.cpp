@@ -0,0 +1,601 @@
+#include "Engine.h"
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace
+{
+	// Rings of simplified triangles searched around a removed vertex before its distance is
+	// taken as it is.
+	const std::uint32_t SearchRingCount = 4;
+
+	std::uint64_t EdgeKey(std::uint32_t a, std::uint32_t b)
+	{
+		return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a;
+	}
+
+	struct PositionKey
+	{
+		std::uint32_t Bits[3];
+
+		bool operator==(const PositionKey& rhs) const = default;
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return ((size_t)key.Bits[0] * 73856093) ^ ((size_t)key.Bits[1] * 19349663) ^ ((size_t)key.Bits[2] * 83492791);
+		}
+	};
+
+	void Cross(const float* a, const float* b, const float* c, float* n)
+	{
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	// Triangles around every vertex, as offsets into one array.
+	struct Fans
+	{
+		std::vector<std::uint32_t> Offsets;
+		std::vector<std::uint32_t> Triangles;
+	};
+
+	void BuildFans(const std::vector<std::uint32_t>& indices, size_t vertexCount, Fans& fans)
+	{
+		fans.Offsets.assign(vertexCount + 1, 0);
+		for (std::uint32_t v : indices)
+			fans.Offsets[v + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			fans.Offsets[v + 1] += fans.Offsets[v];
+
+		std::vector<std::uint32_t> cursor(fans.Offsets.begin(), fans.Offsets.end() - 1);
+		fans.Triangles.resize(indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+			fans.Triangles[cursor[indices[i]]++] = (std::uint32_t)(i / 3);
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Distance from p to the closest point of triangle abc, found by its Voronoi regions
+	// ("Real-Time Collision Detection", Ericson 2005, 5.1.5).
+	float PointTriangleDistance(const float* p, const float* a, const float* b, const float* c)
+	{
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+		float bp[3] = { p[0] - b[0], p[1] - b[1], p[2] - b[2] };
+		float cp[3] = { p[0] - c[0], p[1] - c[1], p[2] - c[2] };
+
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		float va = d3 * d6 - d5 * d4;
+		float vb = d5 * d2 - d1 * d6;
+		float vc = d1 * d4 - d3 * d2;
+
+		// Barycentric weights of b and c of the closest point.
+		float v = 0.0f, w = 0.0f;
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			v = w = 0.0f;
+		else if (d3 >= 0.0f && d4 <= d3)
+			v = 1.0f, w = 0.0f;
+		else if (d6 >= 0.0f && d5 <= d6)
+			v = 0.0f, w = 1.0f;
+		else if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			v = d1 / (d1 - d3), w = 0.0f;
+		else if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			v = 0.0f, w = d2 / (d2 - d6);
+		else if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+			w = (d4 - d3) / ((d4 - d3) + (d5 - d6)), v = 1.0f - w;
+		else if (va + vb + vc > 0.0f)
+			v = vb / (va + vb + vc), w = vc / (va + vb + vc);
+
+		float d[3] = { ap[0] - v * ab[0] - w * ac[0], ap[1] - v * ab[1] - w * ac[1], ap[2] - v * ab[2] - w * ac[2] };
+		return std::sqrt(Dot(d, d));
+	}
+}
+
+MeshSimplifier::MeshSimplifier(const void* vertices, size_t vertexStride, size_t vertexCount,
+	const std::vector<SimplifyAttribute>& attributes) :
+	m_Vertices(static_cast<const std::uint8_t*>(vertices)),
+	m_VertexStride(vertexStride),
+	m_VertexCount(vertexCount),
+	m_Attributes(attributes)
+{
+	assert(vertexStride >= 3 * sizeof(float));
+
+	if (vertexCount == 0)
+		return;
+
+	float min[3] = { Position(0)[0], Position(0)[1], Position(0)[2] };
+	float max[3] = { min[0], min[1], min[2] };
+	for (std::uint32_t v = 1; v < vertexCount; ++v)
+	{
+		const float* p = Position(v);
+		for (int k = 0; k < 3; ++k)
+		{
+			min[k] = std::min<float>(min[k], p[k]);
+			max[k] = std::max<float>(max[k], p[k]);
+		}
+	}
+
+	float d[3] = { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+	m_Extent = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+void MeshSimplifier::Reset(const std::uint32_t* indices, size_t indexCount)
+{
+	m_Indices.assign(indices, indices + indexCount);
+	m_InputIndices = m_Indices;
+	m_Error = 0.0f;
+	m_Collapsed.resize(m_VertexCount);
+	std::iota(m_Collapsed.begin(), m_Collapsed.end(), 0);
+
+	ClassifyVertices();
+	BuildQuadrics();
+}
+
+void MeshSimplifier::Simplify(size_t targetIndexCount, float maxError)
+{
+	size_t triangleCount = m_Indices.size() / 3;
+	size_t targetTriangleCount = targetIndexCount / 3;
+	double extentSq = m_Extent > 0.0f ? (double)m_Extent * m_Extent : 1.0;
+
+	Fans fans;
+	std::vector<Collapse> collapses;
+	std::vector<std::uint32_t> remap(m_VertexCount);
+	std::vector<bool> touched;
+
+	// Every pass collapses the cheapest edges whose neighbourhoods do not overlap, so
+	// the costs computed at the start of the pass stay valid for all of them.
+	while (triangleCount > targetTriangleCount)
+	{
+		BuildFans(m_Indices, m_VertexCount, fans);
+
+		collapses.clear();
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t a = m_Indices[3 * t + k];
+				std::uint32_t b = m_Indices[3 * t + (k + 1) % 3];
+				std::uint32_t ends[2][2] = { { a, b }, { b, a } };
+				for (auto& e : ends)
+				{
+					if (m_Locked[e[0]])
+						continue;
+
+					Quadric q = m_Quadrics[e[0]];
+					AddQuadric(q, m_Quadrics[e[1]]);
+					double distanceSq = q.Weight > 0.0 ? std::max<double>(Evaluate(q, Position(e[1])) / q.Weight, 0.0) : 0.0;
+
+					Collapse collapse;
+					collapse.From = e[0];
+					collapse.To = e[1];
+					collapse.Cost = (float)(distanceSq / extentSq) + AttributeDistance(e[0], e[1]);
+					collapse.Error = (float)std::sqrt(distanceSq);
+					collapses.push_back(collapse);
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& a, const Collapse& b) { return a.Cost < b.Cost; });
+
+		for (size_t v = 0; v < m_VertexCount; ++v)
+			remap[v] = (std::uint32_t)v;
+		touched.assign(m_VertexCount, false);
+
+		size_t collapseCount = 0;
+		for (const Collapse& c : collapses)
+		{
+			if (triangleCount <= targetTriangleCount)
+				break;
+			if (c.Error > maxError || touched[c.From] || touched[c.To])
+				continue;
+
+			std::vector<std::uint32_t> triangles(fans.Triangles.begin() + fans.Offsets[c.From],
+				fans.Triangles.begin() + fans.Offsets[c.From + 1]);
+			if (FlipsTriangle(c.From, c.To, triangles))
+				continue;
+
+			for (std::uint32_t t : triangles)
+			{
+				bool degenerate = false;
+				for (int k = 0; k < 3; ++k)
+				{
+					touched[m_Indices[3 * t + k]] = true;
+					degenerate |= m_Indices[3 * t + k] == c.To;
+				}
+				if (degenerate)
+					--triangleCount;
+			}
+
+			remap[c.From] = c.To;
+			AddQuadric(m_Quadrics[c.To], m_Quadrics[c.From]);
+			m_Error = std::max<float>(m_Error, c.Error);
+			++collapseCount;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Drop the triangles that lost an edge.
+		size_t write = 0;
+		for (size_t i = 0; i < m_Indices.size(); i += 3)
+		{
+			std::uint32_t a = remap[m_Indices[i + 0]];
+			std::uint32_t b = remap[m_Indices[i + 1]];
+			std::uint32_t c = remap[m_Indices[i + 2]];
+			if (a == b || b == c || c == a)
+				continue;
+
+			m_Indices[write++] = a;
+			m_Indices[write++] = b;
+			m_Indices[write++] = c;
+		}
+		m_Indices.resize(write);
+		triangleCount = write / 3;
+
+		for (std::uint32_t& v : m_Collapsed)
+			v = remap[v];
+	}
+
+	m_Error = std::max(m_Error, MeasureDistance());
+}
+
+const std::vector<std::uint32_t>& MeshSimplifier::Indices() const
+{
+	return m_Indices;
+}
+
+float MeshSimplifier::Error() const
+{
+	return m_Error;
+}
+
+float MeshSimplifier::Extent() const
+{
+	return m_Extent;
+}
+
+std::vector<MeshLod> MeshSimplifier::BuildLodChain(const void* vertices, size_t vertexStride, size_t vertexCount,
+	const std::uint32_t* indices, size_t indexCount, const std::vector<SimplifyAttribute>& attributes,
+	std::vector<std::uint32_t>& lodIndices)
+{
+	std::vector<MeshLod> lods;
+	lods.push_back({ 0, (std::uint32_t)indexCount, 0.0f });
+	lodIndices.assign(indices, indices + indexCount);
+
+	MeshSimplifier simplifier(vertices, vertexStride, vertexCount, attributes);
+	simplifier.Reset(indices, indexCount);
+	float maxError = MaxLodError * simplifier.Extent();
+
+	while (lods.size() < MaxLodCount)
+	{
+		size_t previous = lods.back().IndexCount;
+		simplifier.Simplify((size_t)(previous / 3 * LodReduction) * 3, maxError);
+
+		// Stop once locked vertices or the error bound barely let the mesh shrink, or the
+		// measured error is above the bound after all.
+		const std::vector<std::uint32_t>& simplified = simplifier.Indices();
+		if (simplified.empty() || simplified.size() * 10 > previous * 9 || simplifier.Error() > maxError)
+			break;
+
+		MeshLod lod;
+		lod.FirstIndex = (std::uint32_t)lodIndices.size();
+		lod.IndexCount = (std::uint32_t)simplified.size();
+		lod.Error = simplifier.Error();
+		lodIndices.insert(lodIndices.end(), simplified.begin(), simplified.end());
+		MeshOptimizer::OptimizeVertexCache(lodIndices.data() + lod.FirstIndex, lod.IndexCount, vertexCount);
+		lods.push_back(lod);
+	}
+
+	return lods;
+}
+
+void MeshSimplifier::AddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+{
+	q.A00 += weight * a * a;
+	q.A01 += weight * a * b;
+	q.A02 += weight * a * c;
+	q.A11 += weight * b * b;
+	q.A12 += weight * b * c;
+	q.A22 += weight * c * c;
+	q.B0 += weight * a * d;
+	q.B1 += weight * b * d;
+	q.B2 += weight * c * d;
+	q.C += weight * d * d;
+	q.Weight += weight;
+}
+
+void MeshSimplifier::AddQuadric(Quadric& q, const Quadric& rhs)
+{
+	q.A00 += rhs.A00;
+	q.A01 += rhs.A01;
+	q.A02 += rhs.A02;
+	q.A11 += rhs.A11;
+	q.A12 += rhs.A12;
+	q.A22 += rhs.A22;
+	q.B0 += rhs.B0;
+	q.B1 += rhs.B1;
+	q.B2 += rhs.B2;
+	q.C += rhs.C;
+	q.Weight += rhs.Weight;
+}
+
+double MeshSimplifier::Evaluate(const Quadric& q, const float* p)
+{
+	double x = p[0], y = p[1], z = p[2];
+	return q.A00 * x * x + q.A11 * y * y + q.A22 * z * z +
+		2.0 * (q.A01 * x * y + q.A02 * x * z + q.A12 * y * z) +
+		2.0 * (q.B0 * x + q.B1 * y + q.B2 * z) + q.C;
+}
+
+const float* MeshSimplifier::Position(std::uint32_t v) const
+{
+	return reinterpret_cast<const float*>(m_Vertices + v * m_VertexStride);
+}
+
+float MeshSimplifier::AttributeDistance(std::uint32_t a, std::uint32_t b) const
+{
+	float distance = 0.0f;
+	for (const SimplifyAttribute& attribute : m_Attributes)
+	{
+		const float* va = reinterpret_cast<const float*>(m_Vertices + a * m_VertexStride + attribute.Offset);
+		const float* vb = reinterpret_cast<const float*>(m_Vertices + b * m_VertexStride + attribute.Offset);
+
+		float sum = 0.0f;
+		for (std::uint32_t k = 0; k < attribute.Count; ++k)
+			sum += (va[k] - vb[k]) * (va[k] - vb[k]);
+		distance += attribute.Weight * sum;
+	}
+
+	return distance;
+}
+
+bool MeshSimplifier::FlipsTriangle(std::uint32_t from, std::uint32_t to, const std::vector<std::uint32_t>& triangles) const
+{
+	for (std::uint32_t t : triangles)
+	{
+		const std::uint32_t* tri = &m_Indices[3 * t];
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			continue;
+
+		const float* before[3] = { Position(tri[0]), Position(tri[1]), Position(tri[2]) };
+		const float* after[3] = { before[0], before[1], before[2] };
+		for (int k = 0; k < 3; ++k)
+		{
+			if (tri[k] == from)
+				after[k] = Position(to);
+		}
+
+		float n0[3];
+		float n1[3];
+		Cross(before[0], before[1], before[2], n0);
+		Cross(after[0], after[1], after[2], n1);
+
+		// Turning a triangle by more than about 75 degrees folds the surface.
+		float dot = n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2];
+		float length0 = std::sqrt(n0[0] * n0[0] + n0[1] * n0[1] + n0[2] * n0[2]);
+		float length1 = std::sqrt(n1[0] * n1[0] + n1[1] * n1[1] + n1[2] * n1[2]);
+		if (length0 > 0.0f && dot <= 0.25f * length0 * length1)
+			return true;
+	}
+
+	return false;
+}
+
+float MeshSimplifier::MeasureDistance() const
+{
+	Fans input;
+	Fans output;
+	BuildFans(m_InputIndices, m_VertexCount, input);
+	BuildFans(m_Indices, m_VertexCount, output);
+
+	// Input vertices grouped by the vertex they ended up on.
+	std::vector<std::uint32_t> groupOffsets(m_VertexCount + 1, 0);
+	for (std::uint32_t to : m_Collapsed)
+		groupOffsets[to + 1]++;
+	for (size_t v = 0; v < m_VertexCount; ++v)
+		groupOffsets[v + 1] += groupOffsets[v];
+	std::vector<std::uint32_t> cursor(groupOffsets.begin(), groupOffsets.end() - 1);
+	std::vector<std::uint32_t> groups(m_VertexCount);
+	for (std::uint32_t v = 0; v < m_VertexCount; ++v)
+		groups[cursor[m_Collapsed[v]]++] = v;
+
+	// Triangles near a vertex or a triangle, each once.
+	std::vector<std::uint32_t> nearby;
+	std::vector<std::uint32_t> stamps(std::max(m_InputIndices.size(), m_Indices.size()) / 3, 0);
+	std::uint32_t stamp = 0;
+	auto addNearby = [&](const Fans& fans, std::uint32_t v)
+	{
+		for (std::uint32_t a = fans.Offsets[v]; a < fans.Offsets[v + 1]; ++a)
+		{
+			std::uint32_t t = fans.Triangles[a];
+			if (stamps[t] != stamp)
+			{
+				stamps[t] = stamp;
+				nearby.push_back(t);
+			}
+		}
+	};
+
+	// Only part of each surface is searched, so both distances can only come out too
+	// large.  The search starts from the triangles in nearby and, while a point is further
+	// away than the largest distance so far, grows by the triangles around the corners of
+	// the last ones.
+	struct Pending
+	{
+		float P[3];
+		float Distance;
+	};
+	std::vector<Pending> pending;
+	float error = 0.0f;
+	auto search = [&](const Fans& fans, const std::vector<std::uint32_t>& indices)
+	{
+		size_t searched = 0;
+		for (std::uint32_t ring = 0; ; ++ring)
+		{
+			for (size_t i = 0; i < pending.size(); )
+			{
+				Pending& point = pending[i];
+				for (size_t n = searched; n < nearby.size() && point.Distance > error; ++n)
+				{
+					const std::uint32_t* tri = &indices[3 * nearby[n]];
+					point.Distance = std::min(point.Distance,
+						PointTriangleDistance(point.P, Position(tri[0]), Position(tri[1]), Position(tri[2])));
+				}
+				if (point.Distance <= error)
+				{
+					point = pending.back();
+					pending.pop_back();
+				}
+				else
+				{
+					++i;
+				}
+			}
+			if (pending.empty() || ring == SearchRingCount || searched == nearby.size())
+				break;
+
+			size_t end = nearby.size();
+			for (size_t n = searched; n < end; ++n)
+			{
+				for (int k = 0; k < 3; ++k)
+					addNearby(fans, indices[3 * nearby[n] + k]);
+			}
+			searched = end;
+		}
+		for (const Pending& point : pending)
+			error = std::max(error, point.Distance);
+	};
+
+	// From every removed vertex to the simplified triangles around the vertex it ended up
+	// on.
+	for (std::uint32_t to = 0; to < m_VertexCount; ++to)
+	{
+		if (groupOffsets[to + 1] - groupOffsets[to] < 2)
+			continue;
+
+		const float* q = Position(to);
+		pending.clear();
+		for (std::uint32_t g = groupOffsets[to]; g < groupOffsets[to + 1]; ++g)
+		{
+			const float* p = Position(groups[g]);
+			float d[3] = { p[0] - q[0], p[1] - q[1], p[2] - q[2] };
+			pending.push_back({ { p[0], p[1], p[2] }, std::sqrt(Dot(d, d)) });
+		}
+
+		nearby.clear();
+		++stamp;
+		addNearby(output, to);
+		search(output, m_Indices);
+	}
+
+	// From the centroid and edge midpoints of every simplified triangle to the input
+	// triangles around the vertices that ended up on its corners.
+	for (size_t i = 0; i < m_Indices.size(); i += 3)
+	{
+		const float* c[3] = { Position(m_Indices[i + 0]), Position(m_Indices[i + 1]), Position(m_Indices[i + 2]) };
+		pending.assign(4, { {}, std::numeric_limits<float>::max() });
+		for (int k = 0; k < 3; ++k)
+		{
+			pending[0].P[k] = (c[0][k] + c[1][k] + c[2][k]) / 3.0f;
+			pending[1].P[k] = (c[0][k] + c[1][k]) / 2.0f;
+			pending[2].P[k] = (c[1][k] + c[2][k]) / 2.0f;
+			pending[3].P[k] = (c[2][k] + c[0][k]) / 2.0f;
+		}
+
+		nearby.clear();
+		++stamp;
+		for (int k = 0; k < 3; ++k)
+		{
+			std::uint32_t to = m_Indices[i + k];
+			for (std::uint32_t g = groupOffsets[to]; g < groupOffsets[to + 1]; ++g)
+				addNearby(input, groups[g]);
+		}
+		search(input, m_InputIndices);
+	}
+
+	return error;
+}
+
+void MeshSimplifier::ClassifyVertices()
+{
+	// Vertices that share a position are copies split along an attribute seam.
+	std::unordered_map<PositionKey, std::uint32_t, PositionKeyHash> positions;
+	std::vector<std::uint32_t> group(m_VertexCount);
+	std::vector<std::uint32_t> groupSize;
+	for (std::uint32_t v = 0; v < m_VertexCount; ++v)
+	{
+		PositionKey key;
+		std::memcpy(key.Bits, Position(v), sizeof(key.Bits));
+
+		auto result = positions.emplace(key, (std::uint32_t)groupSize.size());
+		if (result.second)
+			groupSize.push_back(0);
+		group[v] = result.first->second;
+		groupSize[group[v]]++;
+	}
+
+	// A manifold interior edge is shared by exactly two triangles.
+	std::unordered_map<std::uint64_t, std::uint32_t> edges;
+	for (size_t i = 0; i < m_Indices.size(); i += 3)
+	{
+		for (int k = 0; k < 3; ++k)
+			edges[EdgeKey(group[m_Indices[i + k]], group[m_Indices[i + (k + 1) % 3]])]++;
+	}
+
+	std::vector<bool> lockedGroup(groupSize.size(), false);
+	for (const auto& e : edges)
+	{
+		if (e.second != 2)
+		{
+			lockedGroup[e.first >> 32] = true;
+			lockedGroup[e.first & 0xFFFFFFFF] = true;
+		}
+	}
+
+	m_Locked.resize(m_VertexCount);
+	for (std::uint32_t v = 0; v < m_VertexCount; ++v)
+		m_Locked[v] = groupSize[group[v]] > 1 || lockedGroup[group[v]];
+}
+
+void MeshSimplifier::BuildQuadrics()
+{
+	m_Quadrics.assign(m_VertexCount, Quadric());
+
+	// Planes are weighted by the area of their triangle.
+	for (size_t i = 0; i < m_Indices.size(); i += 3)
+	{
+		const float* p0 = Position(m_Indices[i + 0]);
+		const float* p1 = Position(m_Indices[i + 1]);
+		const float* p2 = Position(m_Indices[i + 2]);
+
+		float n[3];
+		Cross(p0, p1, p2, n);
+		double length = std::sqrt((double)n[0] * n[0] + (double)n[1] * n[1] + (double)n[2] * n[2]);
+		if (length <= 0.0)
+			continue;
+
+		double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+		double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+		for (int k = 0; k < 3; ++k)
+			AddPlane(m_Quadrics[m_Indices[i + k]], a, b, c, d, 0.5 * length);
+	}
+}
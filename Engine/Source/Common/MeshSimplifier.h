@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-vertex floats that take part in the collapse cost, e.g. normals or texture
+// coordinates.
+struct SimplifyAttribute
+{
+	// Byte offset of the first float in the vertex and the number of floats.
+	std::uint32_t Offset = 0;
+	std::uint32_t Count = 0;
+	// Cost of a unit attribute difference, relative to a position error of the mesh extent.
+	float Weight = 1.0f;
+};
+
+// One level of detail, a range of a shared index list drawn with the same vertices as
+// the full mesh.
+struct MeshLod
+{
+	std::uint32_t FirstIndex = 0;
+	std::uint32_t IndexCount = 0;
+	// Largest distance between the level and the full mesh surface, in mesh units.
+	float Error = 0.0f;
+};
+
+// Simplifies triangle lists by edge collapse with quadric error metrics ("Surface
+// Simplification Using Quadric Error Metrics", Garland and Heckbert 1997).  Vertices only
+// ever collapse onto a neighbour, so every level indexes the original vertex buffer.
+// Vertices on open borders, on attribute seams and on non-manifold edges are never
+// removed.  Works on 32-bit indices and any vertex layout that starts with a float3
+// position.
+class ENGINE_API MeshSimplifier
+{
+public:
+	static const std::uint32_t MaxLodCount = 5;
+	// Each level aims at this fraction of the triangles of the previous one.
+	static constexpr float LodReduction = 0.5f;
+	// Levels stop once the error would exceed this fraction of the mesh extent.
+	static constexpr float MaxLodError = 0.05f;
+
+	MeshSimplifier(const void* vertices, size_t vertexStride, size_t vertexCount,
+		const std::vector<SimplifyAttribute>& attributes = {});
+	MeshSimplifier(const MeshSimplifier& rhs) = delete;
+	MeshSimplifier& operator=(const MeshSimplifier& rhs) = delete;
+	~MeshSimplifier() = default;
+
+	// Starts over from a new triangle list.
+	void Reset(const std::uint32_t* indices, size_t indexCount);
+
+	// Collapses edges until at most targetIndexCount indices are left or every remaining
+	// collapse would move the surface further than maxError.  Continues from the previous
+	// call, so successive calls with smaller targets produce nested levels.  The measured
+	// Error() may still end up above maxError.
+	void Simplify(size_t targetIndexCount, float maxError);
+
+	const std::vector<std::uint32_t>& Indices() const;
+	// Distance between the simplified and the input surface: the larger of the quadric
+	// error of every collapse and the distances measured in both directions after the
+	// last call.  The quadric error alone is a mean over the planes and underestimates
+	// the largest distance.
+	float Error() const;
+	// Diagonal of the bounding box of the vertices.
+	float Extent() const;
+
+	// Builds up to MaxLodCount levels.  The full mesh is level 0, the later levels are
+	// simplified from it and ordered for the vertex cache.  All of them are written to
+	// lodIndices one after the other.
+	static std::vector<MeshLod> BuildLodChain(const void* vertices, size_t vertexStride, size_t vertexCount,
+		const std::uint32_t* indices, size_t indexCount, const std::vector<SimplifyAttribute>& attributes,
+		std::vector<std::uint32_t>& lodIndices);
+
+private:
+	// Symmetric 4x4 matrix of the summed squared plane distances, plus the summed area so
+	// the error is a mean squared distance.
+	struct Quadric
+	{
+		double A00 = 0, A01 = 0, A02 = 0, A11 = 0, A12 = 0, A22 = 0;
+		double B0 = 0, B1 = 0, B2 = 0;
+		double C = 0;
+		double Weight = 0;
+	};
+
+	struct Collapse
+	{
+		std::uint32_t From;
+		std::uint32_t To;
+		float Cost;
+		float Error;
+	};
+
+	static void AddPlane(Quadric& q, double a, double b, double c, double d, double weight);
+	static void AddQuadric(Quadric& q, const Quadric& rhs);
+	static double Evaluate(const Quadric& q, const float* p);
+
+	const float* Position(std::uint32_t v) const;
+	float AttributeDistance(std::uint32_t a, std::uint32_t b) const;
+	bool FlipsTriangle(std::uint32_t from, std::uint32_t to, const std::vector<std::uint32_t>& triangles) const;
+	// Largest distance from the removed vertices to the simplified surface and from points
+	// on the simplified triangles to the input surface, an upper bound of both.
+	float MeasureDistance() const;
+	void ClassifyVertices();
+	void BuildQuadrics();
+
+private:
+	const std::uint8_t* m_Vertices;
+	size_t m_VertexStride;
+	size_t m_VertexCount;
+	std::vector<SimplifyAttribute> m_Attributes;
+	float m_Extent = 0.0f;
+
+	std::vector<std::uint32_t> m_InputIndices;
+	std::vector<std::uint32_t> m_Indices;
+	std::vector<Quadric> m_Quadrics;
+	// Vertices that may not collapse onto a neighbour.
+	std::vector<bool> m_Locked;
+	// Vertex each input vertex was collapsed onto, itself while it is still there.
+	std::vector<std::uint32_t> m_Collapsed;
+	float m_Error = 0.0f;
+};
@@ -0,0 +1,332 @@
+#include "Engine.h"
+#include "Meshlets.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	void Load(const std::uint8_t* vertices, size_t vertexStride, std::uint32_t index, float* p)
+	{
+		std::memcpy(p, vertices + index * vertexStride, 3 * sizeof(float));
+	}
+
+	// Unit normal of a clockwise triangle, false if it has no area.
+	bool TriangleNormal(const std::uint8_t* vertices, size_t vertexStride, const std::uint32_t* triangle, float* n)
+	{
+		float p0[3], p1[3], p2[3];
+		Load(vertices, vertexStride, triangle[0], p0);
+		Load(vertices, vertexStride, triangle[1], p1);
+		Load(vertices, vertexStride, triangle[2], p2);
+
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length <= 0.0f)
+			return false;
+
+		n[0] /= length;
+		n[1] /= length;
+		n[2] /= length;
+		return true;
+	}
+
+	void ComputeBounds(const std::uint8_t* vertices, size_t vertexStride, const std::uint32_t* indices,
+		const std::vector<std::uint32_t>& meshletVertices, Meshlet& meshlet)
+	{
+		// Sphere around the box of the vertices.
+		float min[3] = { +INFINITY, +INFINITY, +INFINITY };
+		float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+		for (std::uint32_t v : meshletVertices)
+		{
+			float p[3];
+			Load(vertices, vertexStride, v, p);
+			for (int k = 0; k < 3; ++k)
+			{
+				min[k] = std::min<float>(min[k], p[k]);
+				max[k] = std::max<float>(max[k], p[k]);
+			}
+		}
+
+		for (int k = 0; k < 3; ++k)
+			meshlet.Center[k] = 0.5f * (min[k] + max[k]);
+
+		float radiusSq = 0.0f;
+		for (std::uint32_t v : meshletVertices)
+		{
+			float p[3];
+			Load(vertices, vertexStride, v, p);
+			float d[3] = { p[0] - meshlet.Center[0], p[1] - meshlet.Center[1], p[2] - meshlet.Center[2] };
+			radiusSq = std::max<float>(radiusSq, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+		}
+		meshlet.Radius = std::sqrt(radiusSq);
+
+		// The cone axis is the average triangle normal, its spread the largest angle to
+		// any of them.
+		std::vector<float> normals;
+		normals.reserve(meshlet.IndexCount);
+		float axis[3] = { 0.0f, 0.0f, 0.0f };
+		for (std::uint32_t i = meshlet.FirstIndex; i < meshlet.FirstIndex + meshlet.IndexCount; i += 3)
+		{
+			float n[3];
+			if (!TriangleNormal(vertices, vertexStride, indices + i, n))
+				continue;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				axis[k] += n[k];
+				normals.push_back(n[k]);
+			}
+		}
+
+		float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+		if (axisLength <= 0.0f)
+			return;
+
+		float minDot = 1.0f;
+		for (int k = 0; k < 3; ++k)
+			meshlet.ConeAxis[k] = axis[k] / axisLength;
+		for (size_t i = 0; i < normals.size(); i += 3)
+		{
+			float dot = normals[i + 0] * meshlet.ConeAxis[0] + normals[i + 1] * meshlet.ConeAxis[1] + normals[i + 2] * meshlet.ConeAxis[2];
+			minDot = std::min<float>(minDot, dot);
+		}
+
+		// Cones wider than about 84 degrees are too wide to ever cull much.
+		if (minDot > 0.1f)
+			meshlet.ConeCutoff = std::sqrt(1.0f - minDot * minDot);
+	}
+}
+
+std::vector<Meshlet> MeshletBuilder::Build(const void* vertices, size_t vertexStride, size_t vertexCount,
+	std::uint32_t* indices, size_t indexCount, std::uint32_t maxVertices, std::uint32_t maxTriangles)
+{
+	assert(maxVertices >= 3 && maxTriangles >= 1);
+
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(vertices);
+	std::uint32_t triangleCount = (std::uint32_t)(indexCount / 3);
+
+	// Triangles around every vertex.
+	std::vector<std::uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < 3 * (size_t)triangleCount; ++i)
+		offsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; ++v)
+		offsets[v + 1] += offsets[v];
+	std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+	std::vector<std::uint32_t> adjacency(3 * (size_t)triangleCount);
+	for (size_t i = 0; i < 3 * (size_t)triangleCount; ++i)
+		adjacency[cursor[indices[i]]++] = (std::uint32_t)(i / 3);
+
+	std::vector<float> normals(3 * (size_t)triangleCount, 0.0f);
+	for (std::uint32_t t = 0; t < triangleCount; ++t)
+		TriangleNormal(bytes, vertexStride, indices + 3 * t, &normals[3 * t]);
+
+	std::vector<std::uint32_t> output;
+	output.reserve(3 * (size_t)triangleCount);
+	std::vector<bool> emitted(triangleCount, false);
+	// Meshlet that last used each vertex, plus one.
+	std::vector<std::uint32_t> owner(vertexCount, 0);
+	std::vector<std::uint32_t> meshletVertices;
+	std::vector<Meshlet> meshlets;
+
+	auto newVertexCount = [&](std::uint32_t t, std::uint32_t id)
+		{
+			const std::uint32_t* tri = indices + 3 * t;
+			std::uint32_t count = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				bool repeated = (k > 0 && tri[0] == tri[k]) || (k > 1 && tri[1] == tri[k]);
+				if (owner[tri[k]] != id && !repeated)
+					++count;
+			}
+			return count;
+		};
+
+	// Seeds are taken in input order, so a cache ordered list keeps its locality.
+	std::uint32_t seed = 0;
+	for (;;)
+	{
+		while (seed < triangleCount && emitted[seed])
+			++seed;
+		if (seed == triangleCount)
+			break;
+
+		std::uint32_t id = (std::uint32_t)meshlets.size() + 1;
+		Meshlet meshlet;
+		meshlet.FirstIndex = (std::uint32_t)output.size();
+		meshletVertices.clear();
+		float normal[3] = { 0.0f, 0.0f, 0.0f };
+
+		std::uint32_t next = seed;
+		while (next != InvalidTriangle)
+		{
+			const std::uint32_t* tri = indices + 3 * next;
+			for (int k = 0; k < 3; ++k)
+			{
+				output.push_back(tri[k]);
+				if (owner[tri[k]] != id)
+				{
+					owner[tri[k]] = id;
+					meshletVertices.push_back(tri[k]);
+				}
+			}
+			for (int k = 0; k < 3; ++k)
+				normal[k] += normals[3 * next + k];
+			emitted[next] = true;
+			meshlet.IndexCount += 3;
+
+			if (meshlet.IndexCount / 3 == maxTriangles)
+				break;
+
+			// Grow through the triangles around the meshlet's vertices.  Fewer new vertices
+			// come first, then a normal close to the meshlet's for a narrow cone.
+			next = InvalidTriangle;
+			float bestCost = INFINITY;
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			float scale = length > 0.0f ? 1.0f / length : 0.0f;
+			for (std::uint32_t v : meshletVertices)
+			{
+				for (std::uint32_t a = offsets[v]; a < offsets[v + 1]; ++a)
+				{
+					std::uint32_t t = adjacency[a];
+					if (emitted[t])
+						continue;
+
+					std::uint32_t added = newVertexCount(t, id);
+					if (meshletVertices.size() + added > maxVertices)
+						continue;
+
+					const float* n = &normals[3 * t];
+					float spread = 1.0f - (n[0] * normal[0] + n[1] * normal[1] + n[2] * normal[2]) * scale;
+					float cost = added + ConeWeight * spread;
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						next = t;
+					}
+				}
+			}
+		}
+
+		meshlet.VertexCount = (std::uint32_t)meshletVertices.size();
+		ComputeBounds(bytes, vertexStride, output.data(), meshletVertices, meshlet);
+		meshlets.push_back(meshlet);
+	}
+
+	std::memcpy(indices, output.data(), output.size() * sizeof(std::uint32_t));
+	return meshlets;
+}
+
+MeshletCuller::MeshletCuller(const std::vector<Meshlet>& meshlets) :
+	m_MeshletCount((std::uint32_t)meshlets.size())
+{
+	size_t padded = (meshlets.size() + 3) & ~(size_t)3;
+	m_CenterX.assign(padded, 0.0f);
+	m_CenterY.assign(padded, 0.0f);
+	m_CenterZ.assign(padded, 0.0f);
+	m_Radius.assign(padded, -INFINITY);
+	m_AxisX.assign(padded, 0.0f);
+	m_AxisY.assign(padded, 0.0f);
+	m_AxisZ.assign(padded, 0.0f);
+	m_Cutoff.assign(padded, 1.0f);
+	m_Ranges.resize(meshlets.size());
+
+	for (size_t i = 0; i < meshlets.size(); ++i)
+	{
+		const Meshlet& m = meshlets[i];
+		m_CenterX[i] = m.Center[0];
+		m_CenterY[i] = m.Center[1];
+		m_CenterZ[i] = m.Center[2];
+		m_Radius[i] = m.Radius;
+		m_AxisX[i] = m.ConeAxis[0];
+		m_AxisY[i] = m.ConeAxis[1];
+		m_AxisZ[i] = m.ConeAxis[2];
+		m_Cutoff[i] = m.ConeCutoff;
+		m_Ranges[i] = { m.FirstIndex, m.IndexCount };
+	}
+}
+
+std::uint32_t MeshletCuller::Cull(const float planes[6][4], const float cameraPosition[3], bool backfaceCulling,
+	std::vector<IndexRange>& ranges) const
+{
+	ranges.clear();
+
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = _mm_set1_ps(planes[p][0]);
+		planeY[p] = _mm_set1_ps(planes[p][1]);
+		planeZ[p] = _mm_set1_ps(planes[p][2]);
+		planeW[p] = _mm_set1_ps(planes[p][3]);
+	}
+	__m128 cameraX = _mm_set1_ps(cameraPosition[0]);
+	__m128 cameraY = _mm_set1_ps(cameraPosition[1]);
+	__m128 cameraZ = _mm_set1_ps(cameraPosition[2]);
+
+	std::uint32_t visibleCount = 0;
+	for (std::uint32_t i = 0; i < m_MeshletCount; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&m_CenterX[i]);
+		__m128 y = _mm_loadu_ps(&m_CenterY[i]);
+		__m128 z = _mm_loadu_ps(&m_CenterZ[i]);
+		__m128 radius = _mm_loadu_ps(&m_Radius[i]);
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+		// Inside unless the sphere is entirely behind one of the planes.  The padding's
+		// negative radius fails the first plane.
+		__m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)),
+				_mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+			visible = _mm_and_ps(visible, _mm_cmpge_ps(distance, negativeRadius));
+		}
+		visible = _mm_and_ps(visible, _mm_cmpge_ps(radius, _mm_setzero_ps()));
+
+		if (backfaceCulling)
+		{
+			__m128 dx = _mm_sub_ps(x, cameraX);
+			__m128 dy = _mm_sub_ps(y, cameraY);
+			__m128 dz = _mm_sub_ps(z, cameraZ);
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+			__m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, _mm_loadu_ps(&m_AxisX[i])), _mm_mul_ps(dy, _mm_loadu_ps(&m_AxisY[i]))),
+				_mm_mul_ps(dz, _mm_loadu_ps(&m_AxisZ[i])));
+			__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(&m_Cutoff[i]), length), radius);
+			visible = _mm_andnot_ps(_mm_cmpge_ps(dot, limit), visible);
+		}
+
+		int mask = _mm_movemask_ps(visible);
+		while (mask != 0)
+		{
+			std::uint32_t lane = 0;
+			while ((mask & (1 << lane)) == 0)
+				++lane;
+			mask &= ~(1 << lane);
+
+			const IndexRange& range = m_Ranges[i + lane];
+			if (!ranges.empty() && ranges.back().FirstIndex + ranges.back().IndexCount == range.FirstIndex)
+				ranges.back().IndexCount += range.IndexCount;
+			else
+				ranges.push_back(range);
+			++visibleCount;
+		}
+	}
+
+	return visibleCount;
+}
+
+std::uint32_t MeshletCuller::MeshletCount() const
+{
+	return m_MeshletCount;
+}
+
+bool MeshletCuller::Empty() const
+{
+	return m_MeshletCount == 0;
+}
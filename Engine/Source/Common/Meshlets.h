@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A cluster of neighbouring triangles with the bounds used to cull it as a whole.
+struct Meshlet
+{
+	// The triangles are a range of the mesh's index list.
+	std::uint32_t FirstIndex = 0;
+	std::uint32_t IndexCount = 0;
+	std::uint32_t VertexCount = 0;
+
+	// Bounding sphere.
+	float Center[3] = {};
+	float Radius = 0.0f;
+
+	// Normal cone.  Every triangle faces away from a viewpoint p where
+	// dot(Center - p, ConeAxis) >= ConeCutoff * length(Center - p) + Radius.  A cutoff of
+	// one never culls.
+	float ConeAxis[3] = {};
+	float ConeCutoff = 1.0f;
+};
+
+struct IndexRange
+{
+	std::uint32_t FirstIndex = 0;
+	std::uint32_t IndexCount = 0;
+};
+
+// Splits an index list into meshlets.  A meshlet grows from a seed triangle through its
+// neighbours, preferring triangles that add no vertices and whose normal is close to the
+// meshlet's, which keeps the normal cones narrow.  Seeds are taken in input order, so the
+// list should already be ordered for the vertex cache.  The triangles are reordered so that
+// every meshlet is a contiguous index range.  Works on 32-bit indices and any vertex layout
+// that starts with a float3 position.
+class ENGINE_API MeshletBuilder
+{
+public:
+	// Fit the vertex and primitive limits of a mesh shader thread group.
+	static const std::uint32_t MaxVertices = 64;
+	static const std::uint32_t MaxTriangles = 124;
+
+	static std::vector<Meshlet> Build(const void* vertices, size_t vertexStride, size_t vertexCount,
+		std::uint32_t* indices, size_t indexCount,
+		std::uint32_t maxVertices = MaxVertices, std::uint32_t maxTriangles = MaxTriangles);
+
+private:
+	static const std::uint32_t InvalidTriangle = 0xFFFFFFFF;
+	// Cost of a normal at right angles to the meshlet's, in new vertices.
+	static constexpr float ConeWeight = 0.5f;
+};
+
+// Culls the meshlets of one mesh against a frustum and by their normal cones.  The bounds
+// are kept as a structure of arrays so SSE tests four meshlets at a time.
+class ENGINE_API MeshletCuller
+{
+public:
+	MeshletCuller() = default;
+	explicit MeshletCuller(const std::vector<Meshlet>& meshlets);
+
+	// Tests every meshlet against the planes, given in the mesh's local space with
+	// normals pointing into the frustum, and, with backfaceCulling, against the
+	// camera position in local space.  Writes the index ranges of the visible meshlets
+	// with adjacent ranges merged and returns the number of visible meshlets.
+	std::uint32_t Cull(const float planes[6][4], const float cameraPosition[3], bool backfaceCulling,
+		std::vector<IndexRange>& ranges) const;
+
+	std::uint32_t MeshletCount() const;
+	bool Empty() const;
+
+private:
+	std::uint32_t m_MeshletCount = 0;
+
+	// Padded to a multiple of four.  Padding has a negative radius and is never visible.
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_Radius;
+	std::vector<float> m_AxisX;
+	std::vector<float> m_AxisY;
+	std::vector<float> m_AxisZ;
+	std::vector<float> m_Cutoff;
+
+	std::vector<IndexRange> m_Ranges;
+};
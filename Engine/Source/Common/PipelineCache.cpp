@@ -0,0 +1,131 @@
+#include "Engine.h"
+#include "PipelineCache.h"
+#include "JobSystem.h"
+
+#include <cstring>
+#include <exception>
+
+PipelineCache::PipelineCache() :
+	m_Blobs(FileMagic, FileVersion)
+{
+}
+
+PipelineCache::PipelineId PipelineCache::Add(const void* desc, size_t byteSize)
+{
+	std::uint64_t hash = BlobCache::HashBytes(desc, byteSize);
+
+	// Equal hashes of different descriptions are unlikely, but must not share a pipeline.
+	auto range = m_PipelinesByHash.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const Blob& other = m_Pipelines[it->second].Desc;
+		if (other.size() == byteSize && std::memcmp(other.data(), desc, byteSize) == 0)
+		{
+			m_DuplicateCount++;
+			return it->second;
+		}
+	}
+
+	PipelineId id = (PipelineId)m_Pipelines.size();
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(desc);
+	m_Pipelines.push_back({ hash, Blob(bytes, bytes + byteSize) });
+	m_PipelinesByHash.emplace(hash, id);
+	return id;
+}
+
+void PipelineCache::CreatePending(const CreateFunction& create, JobSystem* jobSystem)
+{
+	PipelineId first = m_CreatedCount;
+	std::uint32_t count = (std::uint32_t)m_Pipelines.size() - first;
+
+	// A colliding description gets no cached blob, the driver would reject it anyway.
+	std::vector<const Blob*> cachedBlobs(count);
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		std::uint64_t hash = m_Pipelines[first + i].Hash;
+		if (m_PipelinesByHash.count(hash) == 1)
+			cachedBlobs[i] = m_Blobs.Find(hash);
+	}
+
+	// Each create writes only its own blob, the cache is updated afterwards.
+	std::vector<Blob> blobs(count);
+	std::vector<std::exception_ptr> errors(count);
+	auto createPipelines = [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t i = begin; i < end; ++i)
+		{
+			try
+			{
+				blobs[i] = create(first + i, cachedBlobs[i]);
+			}
+			catch (...)
+			{
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+
+	if (jobSystem != nullptr)
+		jobSystem->ParallelFor(count, 1, createPipelines);
+	else
+		createPipelines(0, count);
+
+	for (auto& error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	for (std::uint32_t i = 0; i < count; ++i)
+	{
+		if (cachedBlobs[i] != nullptr)
+			m_CachedCount++;
+
+		// The cached blob is already stored unless the driver replaced it.
+		bool replaced = cachedBlobs[i] == nullptr || *cachedBlobs[i] != blobs[i];
+		if (!blobs[i].empty() && replaced && m_PipelinesByHash.count(m_Pipelines[first + i].Hash) == 1)
+			m_Blobs.Store(m_Pipelines[first + i].Hash, std::move(blobs[i]));
+	}
+
+	m_CreatedCount = (PipelineId)m_Pipelines.size();
+}
+
+bool PipelineCache::Load(const std::filesystem::path& path)
+{
+	return m_Blobs.Load(path);
+}
+
+bool PipelineCache::Save(const std::filesystem::path& path) const
+{
+	return m_Blobs.Save(path);
+}
+
+bool PipelineCache::IsDirty() const
+{
+	return m_Blobs.IsDirty();
+}
+
+std::uint32_t PipelineCache::PipelineCount() const
+{
+	return (std::uint32_t)m_Pipelines.size();
+}
+
+std::uint32_t PipelineCache::DuplicateCount() const
+{
+	return m_DuplicateCount;
+}
+
+std::uint32_t PipelineCache::CachedCount() const
+{
+	return m_CachedCount;
+}
+
+std::uint32_t PipelineCache::CompiledCount() const
+{
+	return m_CreatedCount - m_CachedCount;
+}
+
+std::uint64_t PipelineCache::Hash(PipelineId id) const
+{
+	return m_Pipelines[id].Hash;
+}
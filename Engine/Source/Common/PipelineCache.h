@@ -0,0 +1,71 @@
+#pragma once
+
+#include "BlobCache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+class JobSystem;
+
+// Pipelines described by the canonical bytes of their description.  Identical descriptions
+// share one pipeline, and the blobs the driver compiled them to are kept in a BlobCache file
+// keyed by the description hash, so the next run can skip the compile.  The caller creates
+// the pipelines, the cache itself only uses the standard library.
+class ENGINE_API PipelineCache
+{
+public:
+	static const std::uint32_t FileMagic = 0x434F5350; // "PSOC"
+	// Bump whenever the file layout or the description bytes change.
+	static const std::uint32_t FileVersion = 1;
+
+	using PipelineId = std::uint32_t;
+	using Blob = BlobCache::Blob;
+	// Creates pipeline id from the blob cached by an earlier run, or compiles it when
+	// cachedBlob is nullptr or turns out to be stale.  Returns the blob to cache, empty if
+	// there is none.  Called from several threads at once and may throw.
+	using CreateFunction = std::function<Blob(PipelineId id, const Blob* cachedBlob)>;
+
+	PipelineCache();
+	PipelineCache(const PipelineCache& rhs) = delete;
+	PipelineCache& operator=(const PipelineCache& rhs) = delete;
+	~PipelineCache() = default;
+
+	// Returns the id of the pipeline with this description, adding it if it is new.
+	PipelineId Add(const void* desc, size_t byteSize);
+
+	// Creates every pipeline added since the last call, in parallel on jobSystem or serially
+	// without one.  An exception thrown by create is rethrown once all have finished.
+	void CreatePending(const CreateFunction& create, JobSystem* jobSystem);
+
+	bool Load(const std::filesystem::path& path);
+	bool Save(const std::filesystem::path& path) const;
+	bool IsDirty() const;
+
+	std::uint32_t PipelineCount() const;
+	// Add() calls that found an identical description.
+	std::uint32_t DuplicateCount() const;
+	// Pipelines that were created with a cached blob, and ones that had none.
+	std::uint32_t CachedCount() const;
+	std::uint32_t CompiledCount() const;
+
+	std::uint64_t Hash(PipelineId id) const;
+
+private:
+	struct Pipeline
+	{
+		std::uint64_t Hash;
+		Blob Desc;
+	};
+
+	std::vector<Pipeline> m_Pipelines;
+	std::unordered_multimap<std::uint64_t, PipelineId> m_PipelinesByHash;
+	// Pipelines below this id have been created.
+	PipelineId m_CreatedCount = 0;
+	std::uint32_t m_DuplicateCount = 0;
+	std::uint32_t m_CachedCount = 0;
+
+	BlobCache m_Blobs;
+};
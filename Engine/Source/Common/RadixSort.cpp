@@ -0,0 +1,50 @@
+#include "Engine.h"
+#include "RadixSort.h"
+
+void RadixSort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch)
+{
+	const std::size_t count = keys.size();
+	if (count < 2)
+		return;
+
+	scratch.resize(count);
+
+	// Histograms of all eight bytes in one pass over the keys.
+	std::uint32_t histograms[8][256] = {};
+	for (const SortKey& key : keys)
+	{
+		for (int byte = 0; byte < 8; ++byte)
+			histograms[byte][(key.Key >> (byte * 8)) & 0xFF]++;
+	}
+
+	SortKey* source = keys.data();
+	SortKey* destination = scratch.data();
+
+	for (int byte = 0; byte < 8; ++byte)
+	{
+		std::uint32_t* histogram = histograms[byte];
+
+		// Every key has the same byte, the pass would not move anything.
+		if (histogram[(source[0].Key >> (byte * 8)) & 0xFF] == count)
+			continue;
+
+		std::uint32_t offset = 0;
+		for (int digit = 0; digit < 256; ++digit)
+		{
+			std::uint32_t digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			std::uint32_t digit = (source[i].Key >> (byte * 8)) & 0xFF;
+			destination[histogram[digit]++] = source[i];
+		}
+
+		std::swap(source, destination);
+	}
+
+	if (source != keys.data())
+		keys.swap(scratch);
+}
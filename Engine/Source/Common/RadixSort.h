@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Key with the position of the element it orders.
+struct SortKey
+{
+	std::uint64_t Key = 0;
+	std::uint32_t Value = 0;
+};
+
+// Stable least significant digit radix sort on the 64-bit keys, one pass per byte.
+// Bytes that are the same in every key are skipped, so keys with constant high bits cost
+// no more than shorter keys.  scratch is resized as needed and can be kept between calls.
+ENGINE_API void RadixSort(std::vector<SortKey>& keys, std::vector<SortKey>& scratch);
@@ -0,0 +1,211 @@
+#include "Engine.h"
+#include "ShaderCache.h"
+#include "JobSystem.h"
+
+#include <exception>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace
+{
+	// The length goes first so that consecutive strings can not run into each other.
+	std::uint64_t HashString(std::uint64_t hash, const std::string& s)
+	{
+		std::uint64_t length = s.size();
+		hash = BlobCache::HashBytes(&length, sizeof(length), hash);
+		return BlobCache::HashBytes(s.data(), s.size(), hash);
+	}
+
+	bool ReadFile(const std::filesystem::path& path, std::string& contents)
+	{
+		std::ifstream file(path, std::ios::binary);
+		if (!file)
+			return false;
+
+		std::ostringstream stream;
+		stream << file.rdbuf();
+		contents = stream.str();
+		return true;
+	}
+
+	// Names of the files included by source, in order of appearance.
+	std::vector<std::string> ParseIncludes(const std::string& source)
+	{
+		std::vector<std::string> includes;
+
+		std::istringstream lines(source);
+		std::string line;
+		while (std::getline(lines, line))
+		{
+			size_t i = line.find_first_not_of(" \t");
+			if (i == std::string::npos || line[i] != '#')
+				continue;
+			i = line.find_first_not_of(" \t", i + 1);
+			if (i == std::string::npos || line.compare(i, 7, "include") != 0)
+				continue;
+			i = line.find_first_not_of(" \t", i + 7);
+			if (i == std::string::npos || (line[i] != '"' && line[i] != '<'))
+				continue;
+
+			char close = line[i] == '"' ? '"' : '>';
+			size_t end = line.find(close, i + 1);
+			if (end != std::string::npos)
+				includes.push_back(line.substr(i + 1, end - i - 1));
+		}
+
+		return includes;
+	}
+
+	void AddIncludes(const std::filesystem::path& file, const std::string& source,
+		std::set<std::filesystem::path>& visited, std::vector<std::filesystem::path>& closure)
+	{
+		for (const std::string& include : ParseIncludes(source))
+		{
+			std::filesystem::path path = (file.parent_path() / include).lexically_normal();
+
+			std::string contents;
+			if (visited.count(path) != 0 || !ReadFile(path, contents))
+				continue;
+
+			visited.insert(path);
+			closure.push_back(path);
+			AddIncludes(path, contents, visited, closure);
+		}
+	}
+}
+
+ShaderCache::ShaderCache() :
+	m_Blobs(FileMagic, FileVersion)
+{
+}
+
+bool ShaderCache::Load(const std::filesystem::path& path)
+{
+	return m_Blobs.Load(path);
+}
+
+bool ShaderCache::Save(const std::filesystem::path& path) const
+{
+	return m_Blobs.Save(path);
+}
+
+std::vector<ShaderCache::Bytecode> ShaderCache::GetOrCompile(const std::vector<ShaderKey>& keys,
+	const CompileFunction& compile, JobSystem* jobSystem)
+{
+	std::vector<Bytecode> bytecodes(keys.size());
+	std::vector<std::uint64_t> hashes(keys.size());
+
+	std::vector<std::uint32_t> misses;
+	for (std::uint32_t i = 0; i < (std::uint32_t)keys.size(); ++i)
+	{
+		hashes[i] = Hash(keys[i]);
+		if (const Bytecode* bytecode = Find(hashes[i]))
+			bytecodes[i] = *bytecode;
+		else
+			misses.push_back(i);
+	}
+
+	// Each compile writes only its own bytecode, the cache is updated afterwards.
+	std::vector<std::exception_ptr> errors(misses.size());
+	auto compileMisses = [&](std::uint32_t begin, std::uint32_t end)
+	{
+		for (std::uint32_t m = begin; m < end; ++m)
+		{
+			try
+			{
+				bytecodes[misses[m]] = compile(keys[misses[m]]);
+			}
+			catch (...)
+			{
+				errors[m] = std::current_exception();
+			}
+		}
+	};
+
+	if (jobSystem != nullptr)
+		jobSystem->ParallelFor((std::uint32_t)misses.size(), 1, compileMisses);
+	else
+		compileMisses(0, (std::uint32_t)misses.size());
+
+	for (auto& error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	for (std::uint32_t m : misses)
+		Store(hashes[m], bytecodes[m]);
+
+	return bytecodes;
+}
+
+const ShaderCache::Bytecode* ShaderCache::Find(std::uint64_t hash)
+{
+	return m_Blobs.Find(hash);
+}
+
+void ShaderCache::Store(std::uint64_t hash, Bytecode bytecode)
+{
+	m_Blobs.Store(hash, std::move(bytecode));
+}
+
+bool ShaderCache::IsDirty() const
+{
+	return m_Blobs.IsDirty();
+}
+
+std::uint32_t ShaderCache::EntryCount() const
+{
+	return m_Blobs.EntryCount();
+}
+
+std::uint32_t ShaderCache::Hits() const
+{
+	return m_Blobs.Hits();
+}
+
+std::uint32_t ShaderCache::Misses() const
+{
+	return m_Blobs.Misses();
+}
+
+std::uint64_t ShaderCache::Hash(const ShaderKey& key)
+{
+	std::uint64_t hash = BlobCache::HashBasis;
+
+	// Only the contents count, so the same sources hash the same from any directory.
+	for (const std::filesystem::path& file : IncludeClosure(key.File))
+	{
+		std::string contents;
+		ReadFile(file, contents);
+		hash = HashString(hash, contents);
+	}
+
+	for (const ShaderDefine& define : key.Defines)
+	{
+		hash = HashString(hash, define.Name);
+		hash = HashString(hash, define.Value);
+	}
+	hash = HashString(hash, key.EntryPoint);
+	hash = HashString(hash, key.Target);
+	hash = BlobCache::HashBytes(&key.Flags, sizeof(key.Flags), hash);
+
+	return hash;
+}
+
+std::vector<std::filesystem::path> ShaderCache::IncludeClosure(const std::filesystem::path& file)
+{
+	std::vector<std::filesystem::path> closure;
+
+	std::filesystem::path path = file.lexically_normal();
+	std::string contents;
+	if (!ReadFile(path, contents))
+		return closure;
+
+	std::set<std::filesystem::path> visited = { path };
+	closure.push_back(path);
+	AddIncludes(path, contents, visited, closure);
+
+	return closure;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "BlobCache.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+class JobSystem;
+
+struct ShaderDefine
+{
+	std::string Name;
+	std::string Value;
+};
+
+// Everything that decides the bytecode of a shader.
+struct ShaderKey
+{
+	std::filesystem::path File;
+	std::vector<ShaderDefine> Defines;
+	std::string EntryPoint;
+	std::string Target;
+	std::uint32_t Flags = 0;
+};
+
+// On-disk cache of compiled shaders.  An entry is keyed by a hash of the source file, every
+// file it includes, the defines, entry point, target and compile flags, so editing any of
+// them misses the cache.  All entries live in one BlobCache file.  The compiler is supplied
+// by the caller, the cache itself only uses the standard library.
+class ENGINE_API ShaderCache
+{
+public:
+	static const std::uint32_t FileMagic = 0x43444853; // "SHDC"
+	// Bump whenever the file layout or the hashed data changes.
+	static const std::uint32_t FileVersion = 1;
+
+	using Bytecode = BlobCache::Blob;
+	// Compiles key into bytecode.  Called from several threads at once and may throw.
+	using CompileFunction = std::function<Bytecode(const ShaderKey& key)>;
+
+	ShaderCache();
+	ShaderCache(const ShaderCache& rhs) = delete;
+	ShaderCache& operator=(const ShaderCache& rhs) = delete;
+	~ShaderCache() = default;
+
+	// Replaces the entries with the ones of a cache file.  Returns false and leaves the cache
+	// empty if the file is missing, truncated or was written by another version.
+	bool Load(const std::filesystem::path& path);
+	// Writes the entries used since Load().  Entries of shaders that changed or are no
+	// longer compiled are dropped.  The file is replaced atomically.
+	bool Save(const std::filesystem::path& path) const;
+
+	// Returns the bytecode of every key in order.  Misses are compiled in parallel on
+	// jobSystem, or serially without one, and added to the cache.  An exception thrown by
+	// compile is rethrown once all compiles have finished.
+	std::vector<Bytecode> GetOrCompile(const std::vector<ShaderKey>& keys,
+		const CompileFunction& compile, JobSystem* jobSystem);
+
+	// nullptr on a miss.
+	const Bytecode* Find(std::uint64_t hash);
+	void Store(std::uint64_t hash, Bytecode bytecode);
+
+	// True if Save() would write something different from the loaded file.
+	bool IsDirty() const;
+	std::uint32_t EntryCount() const;
+	std::uint32_t Hits() const;
+	std::uint32_t Misses() const;
+
+	static std::uint64_t Hash(const ShaderKey& key);
+	// The file followed by every file it includes, directly or not, each once.  Includes
+	// are resolved like the standard include handler of the compiler, relative to the
+	// including file, and ones that do not exist are left out.
+	static std::vector<std::filesystem::path> IncludeClosure(const std::filesystem::path& file);
+
+private:
+	BlobCache m_Blobs;
+};
@@ -0,0 +1,51 @@
+#include "Engine.h"
+#include "SlotAllocator.h"
+
+SlotAllocator::SlotAllocator(std::uint32_t slotsPerPage) :
+	m_SlotsPerPage(slotsPerPage > 0 ? slotsPerPage : 1)
+{
+}
+
+std::uint32_t SlotAllocator::Allocate()
+{
+	if (!m_FreeSlots.empty())
+	{
+		std::uint32_t slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+		return slot;
+	}
+
+	return m_NextSlot++;
+}
+
+void SlotAllocator::Free(std::uint32_t slot)
+{
+	assert(slot < m_NextSlot);
+	m_FreeSlots.push_back(slot);
+}
+
+void SlotAllocator::Clear()
+{
+	m_NextSlot = 0;
+	m_FreeSlots.clear();
+}
+
+std::uint32_t SlotAllocator::Count() const
+{
+	return m_NextSlot - (std::uint32_t)m_FreeSlots.size();
+}
+
+std::uint32_t SlotAllocator::SlotsPerPage() const
+{
+	return m_SlotsPerPage;
+}
+
+std::uint32_t SlotAllocator::PageCount() const
+{
+	return (m_NextSlot + m_SlotsPerPage - 1) / m_SlotsPerPage;
+}
+
+std::uint32_t SlotAllocator::Capacity() const
+{
+	return PageCount() * m_SlotsPerPage;
+}
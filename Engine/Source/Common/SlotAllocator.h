@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Hands out indices into a buffer of fixed size elements.  Freed indices are reused before
+// new ones are taken, and the buffer only needs room for the pages that were ever touched,
+// so buffers sized by Capacity() grow by whole pages and existing indices never move.
+class ENGINE_API SlotAllocator
+{
+public:
+	explicit SlotAllocator(std::uint32_t slotsPerPage = 64);
+	SlotAllocator(const SlotAllocator& rhs) = delete;
+	SlotAllocator& operator=(const SlotAllocator& rhs) = delete;
+	~SlotAllocator() = default;
+
+	std::uint32_t Allocate();
+	void Free(std::uint32_t slot);
+	void Clear();
+
+	// Slots currently allocated.
+	std::uint32_t Count() const;
+	std::uint32_t SlotsPerPage() const;
+	std::uint32_t PageCount() const;
+	// Elements a buffer needs to hold every slot handed out so far.
+	std::uint32_t Capacity() const;
+
+private:
+	std::uint32_t m_SlotsPerPage;
+
+	// Slots below this were handed out at least once.
+	std::uint32_t m_NextSlot = 0;
+	std::vector<std::uint32_t> m_FreeSlots;
+};
@@ -0,0 +1,50 @@
+#include "Engine.h"
+#include "TextureRegistry.h"
+
+TextureRegistry::TextureRegistry(std::uint32_t capacity) :
+	m_Capacity(capacity)
+{
+}
+
+std::uint32_t TextureRegistry::Register(const std::string& name)
+{
+	auto it = m_Indices.find(name);
+	if (it != m_Indices.end())
+		return it->second;
+
+	// The allocator reuses freed indices first and only takes a new one when all below it
+	// are in use, so staying under the capacity keeps every index inside the table.
+	if (m_Slots.Count() >= m_Capacity)
+		return InvalidIndex;
+
+	std::uint32_t index = m_Slots.Allocate();
+	m_Indices.emplace(name, index);
+	return index;
+}
+
+bool TextureRegistry::Unregister(const std::string& name)
+{
+	auto it = m_Indices.find(name);
+	if (it == m_Indices.end())
+		return false;
+
+	m_Slots.Free(it->second);
+	m_Indices.erase(it);
+	return true;
+}
+
+std::uint32_t TextureRegistry::IndexOf(const std::string& name) const
+{
+	auto it = m_Indices.find(name);
+	return it != m_Indices.end() ? it->second : InvalidIndex;
+}
+
+std::uint32_t TextureRegistry::Count() const
+{
+	return m_Slots.Count();
+}
+
+std::uint32_t TextureRegistry::Capacity() const
+{
+	return m_Capacity;
+}
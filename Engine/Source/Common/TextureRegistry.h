@@ -0,0 +1,38 @@
+#pragma once
+
+#include "SlotAllocator.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// Assigns every texture a stable index into the shader visible texture table.  Materials
+// store the index, so textures can be added and removed without touching other materials.
+// Freed indices are reused before new ones are taken.  Knows nothing about D3D.
+class ENGINE_API TextureRegistry
+{
+public:
+	static const std::uint32_t InvalidIndex = 0xFFFFFFFF;
+
+	explicit TextureRegistry(std::uint32_t capacity);
+	TextureRegistry(const TextureRegistry& rhs) = delete;
+	TextureRegistry& operator=(const TextureRegistry& rhs) = delete;
+	~TextureRegistry() = default;
+
+	// Returns the index of the texture, registering it if it is new.  Returns InvalidIndex
+	// when the table is full.
+	std::uint32_t Register(const std::string& name);
+	// Returns false if the texture was not registered.
+	bool Unregister(const std::string& name);
+
+	// InvalidIndex if the texture is not registered.
+	std::uint32_t IndexOf(const std::string& name) const;
+
+	std::uint32_t Count() const;
+	std::uint32_t Capacity() const;
+
+private:
+	std::uint32_t m_Capacity;
+	SlotAllocator m_Slots;
+	std::unordered_map<std::string, std::uint32_t> m_Indices;
+};
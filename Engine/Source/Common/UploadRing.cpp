@@ -0,0 +1,89 @@
+#include "Engine.h"
+#include "UploadRing.h"
+
+UploadRing::UploadRing(UploadQueue* queue, std::uint64_t size) :
+	m_Queue(queue),
+	m_Size(size)
+{
+	assert(queue != nullptr && size > 0);
+}
+
+std::uint64_t UploadRing::Allocate(std::uint64_t size, std::uint64_t alignment)
+{
+	assert(size <= m_Size);
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0 && m_Size % alignment == 0);
+
+	for (;;)
+	{
+		std::uint64_t start = (m_Head + alignment - 1) & ~(alignment - 1);
+
+		// Allocations do not wrap around the end of the buffer, the rest of it is skipped.
+		std::uint64_t offset = start % m_Size;
+		if (offset + size > m_Size)
+			start += m_Size - offset;
+
+		// Nothing is in use, so the skipped bytes do not count either.
+		if (m_Tail == m_Head)
+			m_Tail = m_Head = start;
+
+		if (start + size - m_Tail <= m_Size)
+		{
+			m_Head = start + size;
+			return start % m_Size;
+		}
+
+		// Full.  The oldest allocations may not have been submitted yet.
+		if (m_Submissions.empty())
+			Submit();
+		WaitForTicket(m_Submissions.front().Fence);
+	}
+}
+
+std::uint64_t UploadRing::Submit()
+{
+	std::uint64_t fence = m_Queue->Submit();
+
+	std::uint64_t submitted = m_Submissions.empty() ? m_Tail : m_Submissions.back().End;
+	if (m_Head != submitted)
+		m_Submissions.push_back({ fence, m_Head });
+
+	return fence;
+}
+
+void UploadRing::Retire()
+{
+	std::uint64_t completed = m_Queue->CompletedFence();
+	while (!m_Submissions.empty() && m_Submissions.front().Fence <= completed)
+	{
+		m_Tail = m_Submissions.front().End;
+		m_Submissions.pop_front();
+	}
+}
+
+bool UploadRing::IsComplete(std::uint64_t ticket) const
+{
+	return m_Queue->CompletedFence() >= ticket;
+}
+
+void UploadRing::WaitForTicket(std::uint64_t ticket)
+{
+	if (!IsComplete(ticket))
+		m_Queue->WaitForFence(ticket);
+
+	Retire();
+}
+
+std::uint64_t UploadRing::Size() const
+{
+	return m_Size;
+}
+
+std::uint64_t UploadRing::UsedBytes() const
+{
+	return m_Head - m_Tail;
+}
+
+std::uint32_t UploadRing::PendingSubmits() const
+{
+	return (std::uint32_t)m_Submissions.size();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+
+// Queue the upload ring submits its copies to.  Fence values grow with every submit and the
+// queue completes them in order.  Implemented by the D3D12 copy queue, and by a simulated
+// timeline where there is no GPU.
+class ENGINE_API UploadQueue
+{
+public:
+	virtual ~UploadQueue() = default;
+
+	// Submits the copies recorded since the last submit and returns the fence value the
+	// queue reaches when they are done.
+	virtual std::uint64_t Submit() = 0;
+	virtual std::uint64_t CompletedFence() const = 0;
+	// Blocks until the queue has reached fence.
+	virtual void WaitForFence(std::uint64_t fence) = 0;
+};
+
+// Suballocates staging memory from one persistent buffer used as a ring.  Allocations are
+// grouped by the submit that uploads them, and a group's bytes are reused once the queue
+// has passed the fence of its submit.  Offsets and fences only, the caller owns the memory.
+class ENGINE_API UploadRing
+{
+public:
+	UploadRing(UploadQueue* queue, std::uint64_t size);
+	UploadRing(const UploadRing& rhs) = delete;
+	UploadRing& operator=(const UploadRing& rhs) = delete;
+	~UploadRing() = default;
+
+	// Returns the offset of size free bytes aligned to alignment.  When the ring is full it
+	// submits the pending allocations if needed and waits for the oldest uploads.  size must
+	// not exceed the ring, alignment must be a power of two that divides the ring size.
+	std::uint64_t Allocate(std::uint64_t size, std::uint64_t alignment);
+
+	// Submits the queue and returns the ticket of every allocation since the last submit.
+	std::uint64_t Submit();
+
+	// Frees the allocations of the submits the queue has completed.
+	void Retire();
+
+	bool IsComplete(std::uint64_t ticket) const;
+	void WaitForTicket(std::uint64_t ticket);
+
+	std::uint64_t Size() const;
+	// Bytes allocated and not yet retired, including padding.
+	std::uint64_t UsedBytes() const;
+	// Submits whose allocations have not been retired.
+	std::uint32_t PendingSubmits() const;
+
+private:
+	struct Submission
+	{
+		std::uint64_t Fence;
+		// Ring position after the last allocation of the submit.
+		std::uint64_t End;
+	};
+
+	UploadQueue* m_Queue;
+	std::uint64_t m_Size;
+
+	// Positions grow without wrapping, the offset into the buffer is the position modulo
+	// the ring size.  Everything between tail and head is in use.
+	std::uint64_t m_Head = 0;
+	std::uint64_t m_Tail = 0;
+	std::deque<Submission> m_Submissions;
+};
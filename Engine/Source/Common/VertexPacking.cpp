@@ -0,0 +1,394 @@
+#include "Engine.h"
+#include "VertexPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+namespace
+{
+	const float UnormMax = 65535.0f;
+	const float SnormMax = 32767.0f;
+
+	// Vertices processed per chunk by MeasureError().
+	const std::size_t ErrorChunkSize = 256;
+
+	// Four float vertices, one per lane.
+	struct VertexLanes
+	{
+		__m128 Px, Py, Pz;
+		__m128 Nx, Ny, Nz;
+		__m128 U, V;
+	};
+
+	const float* Attribute(const void* vertices, std::size_t stride, std::size_t index, std::size_t offset)
+	{
+		return reinterpret_cast<const float*>(static_cast<const std::uint8_t*>(vertices) + index * stride + offset);
+	}
+
+	float* Attribute(void* vertices, std::size_t stride, std::size_t index, std::size_t offset)
+	{
+		return reinterpret_cast<float*>(static_cast<std::uint8_t*>(vertices) + index * stride + offset);
+	}
+
+	// Loads the vertices from first on, repeating the last one past count.
+	VertexLanes LoadLanes(const void* vertices, const FloatVertexLayout& layout, std::size_t first, std::size_t count)
+	{
+		const float* p[4];
+		const float* n[4];
+		const float* t[4];
+		for (std::size_t k = 0; k < 4; ++k)
+		{
+			std::size_t i = std::min(first + k, count - 1);
+			p[k] = Attribute(vertices, layout.Stride, i, 0);
+			n[k] = Attribute(vertices, layout.Stride, i, layout.NormalOffset);
+			t[k] = Attribute(vertices, layout.Stride, i, layout.TexCOffset);
+		}
+
+		VertexLanes lanes;
+		lanes.Px = _mm_setr_ps(p[0][0], p[1][0], p[2][0], p[3][0]);
+		lanes.Py = _mm_setr_ps(p[0][1], p[1][1], p[2][1], p[3][1]);
+		lanes.Pz = _mm_setr_ps(p[0][2], p[1][2], p[2][2], p[3][2]);
+		lanes.Nx = _mm_setr_ps(n[0][0], n[1][0], n[2][0], n[3][0]);
+		lanes.Ny = _mm_setr_ps(n[0][1], n[1][1], n[2][1], n[3][1]);
+		lanes.Nz = _mm_setr_ps(n[0][2], n[1][2], n[2][2], n[3][2]);
+		lanes.U = _mm_setr_ps(t[0][0], t[1][0], t[2][0], t[3][0]);
+		lanes.V = _mm_setr_ps(t[0][1], t[1][1], t[2][1], t[3][1]);
+		return lanes;
+	}
+
+	void StoreLanes(const VertexLanes& lanes, void* vertices, const FloatVertexLayout& layout, std::size_t first,
+		std::size_t count)
+	{
+		alignas(16) float values[8][4];
+		_mm_store_ps(values[0], lanes.Px);
+		_mm_store_ps(values[1], lanes.Py);
+		_mm_store_ps(values[2], lanes.Pz);
+		_mm_store_ps(values[3], lanes.Nx);
+		_mm_store_ps(values[4], lanes.Ny);
+		_mm_store_ps(values[5], lanes.Nz);
+		_mm_store_ps(values[6], lanes.U);
+		_mm_store_ps(values[7], lanes.V);
+
+		for (std::size_t k = 0; k < 4 && first + k < count; ++k)
+		{
+			float* p = Attribute(vertices, layout.Stride, first + k, 0);
+			float* n = Attribute(vertices, layout.Stride, first + k, layout.NormalOffset);
+			float* t = Attribute(vertices, layout.Stride, first + k, layout.TexCOffset);
+			p[0] = values[0][k];
+			p[1] = values[1][k];
+			p[2] = values[2][k];
+			n[0] = values[3][k];
+			n[1] = values[4][k];
+			n[2] = values[5][k];
+			t[0] = values[6][k];
+			t[1] = values[7][k];
+		}
+	}
+
+	__m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	__m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	__m128 Abs(__m128 v)
+	{
+		return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+	}
+
+	// +1 or -1 with the sign of v, zero counts as positive.
+	__m128 SignNotZero(__m128 v)
+	{
+		return _mm_or_ps(_mm_set1_ps(1.0f), _mm_and_ps(v, _mm_set1_ps(-0.0f)));
+	}
+
+	// Rounds to nearest even, values past the half range become infinity and NaN stays
+	// NaN.  After Giesen's float_to_half_fast3_rtne without the F16C instructions.
+	__m128i FloatToHalf(__m128 f)
+	{
+		__m128i bits = _mm_castps_si128(f);
+		__m128i sign = _mm_and_si128(bits, _mm_set1_epi32((int)0x80000000));
+		__m128i magnitude = _mm_xor_si128(bits, sign);
+
+		__m128i isNan = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(0x7f800000));
+		__m128i infNan = Select(isNan, _mm_set1_epi32(0x7e00), _mm_set1_epi32(0x7c00));
+		__m128i isLarge = _mm_cmpgt_epi32(magnitude, _mm_set1_epi32(((127 + 16) << 23) - 1));
+		__m128i isSubnormal = _mm_cmplt_epi32(magnitude, _mm_set1_epi32(113 << 23));
+
+		// Adding the magic value aligns the 10 mantissa bits at the bottom and rounds.
+		__m128 denormMagic = _mm_castsi128_ps(_mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23));
+		__m128i subnormal = _mm_sub_epi32(
+			_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(magnitude), denormMagic)), _mm_castps_si128(denormMagic));
+
+		// Rebias the exponent and round the dropped mantissa bits to even.
+		__m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(magnitude, 13), _mm_set1_epi32(1));
+		__m128i normal = _mm_add_epi32(magnitude, _mm_set1_epi32(-((127 - 15) << 23) + 0xfff));
+		normal = _mm_srli_epi32(_mm_add_epi32(normal, mantissaOdd), 13);
+
+		__m128i half = Select(isSubnormal, subnormal, normal);
+		half = Select(isLarge, infNan, half);
+		return _mm_or_si128(half, _mm_srli_epi32(sign, 16));
+	}
+
+	// Takes halves in the low 16 bits of each lane.
+	__m128 HalfToFloat(__m128i h)
+	{
+		const __m128i shiftedExponent = _mm_set1_epi32(0x7c00 << 13);
+
+		__m128i bits = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+		__m128i exponent = _mm_and_si128(bits, shiftedExponent);
+		bits = _mm_add_epi32(bits, _mm_set1_epi32((127 - 15) << 23));
+
+		// Infinity and NaN keep the full exponent.
+		__m128i isInfNan = _mm_cmpeq_epi32(exponent, shiftedExponent);
+		bits = _mm_add_epi32(bits, _mm_and_si128(isInfNan, _mm_set1_epi32((128 - 16) << 23)));
+
+		// Zero and subnormals are renormalized by a float subtraction.
+		__m128i isSubnormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+		__m128 subnormal = _mm_sub_ps(_mm_castsi128_ps(_mm_add_epi32(bits, _mm_set1_epi32(1 << 23))),
+			_mm_castsi128_ps(_mm_set1_epi32(113 << 23)));
+		bits = Select(isSubnormal, _mm_castps_si128(subnormal), bits);
+
+		bits = _mm_or_si128(bits, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+		return _mm_castsi128_ps(bits);
+	}
+
+	// Projects the normals onto the octahedron and folds the lower half over the upper.
+	// Normals need not be normalized, a zero normal encodes +z.
+	void OctahedralEncode(__m128 x, __m128 y, __m128 z, __m128& octX, __m128& octY)
+	{
+		__m128 l1 = _mm_add_ps(_mm_add_ps(Abs(x), Abs(y)), Abs(z));
+		__m128 invL1 = _mm_div_ps(_mm_set1_ps(1.0f), _mm_max_ps(l1, _mm_set1_ps(1e-30f)));
+		__m128 px = _mm_mul_ps(x, invL1);
+		__m128 py = _mm_mul_ps(y, invL1);
+
+		__m128 foldedX = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), Abs(py)), SignNotZero(px));
+		__m128 foldedY = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), Abs(px)), SignNotZero(py));
+		__m128 isLower = _mm_cmplt_ps(z, _mm_setzero_ps());
+		octX = Select(isLower, foldedX, px);
+		octY = Select(isLower, foldedY, py);
+	}
+
+	void OctahedralDecode(__m128 octX, __m128 octY, __m128& x, __m128& y, __m128& z)
+	{
+		z = _mm_sub_ps(_mm_sub_ps(_mm_set1_ps(1.0f), Abs(octX)), Abs(octY));
+		__m128 t = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), z), _mm_setzero_ps());
+		x = _mm_sub_ps(octX, _mm_or_ps(t, _mm_and_ps(octX, _mm_set1_ps(-0.0f))));
+		y = _mm_sub_ps(octY, _mm_or_ps(t, _mm_and_ps(octY, _mm_set1_ps(-0.0f))));
+
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		__m128 invLength = _mm_div_ps(_mm_set1_ps(1.0f), length);
+		x = _mm_mul_ps(x, invLength);
+		y = _mm_mul_ps(y, invLength);
+		z = _mm_mul_ps(z, invLength);
+	}
+
+	__m128 Clamp(__m128 v, float low, float high)
+	{
+		return _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(low)), _mm_set1_ps(high));
+	}
+
+	// Two 16-bit values per lane, a in the low half.
+	__m128i Interleave16(__m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(a, _mm_set1_epi32(0xffff)), _mm_slli_epi32(b, 16));
+	}
+
+	// Turns four lanes of four 32-bit values into four rows, or back.
+	void Transpose(__m128i& r0, __m128i& r1, __m128i& r2, __m128i& r3)
+	{
+		__m128 a = _mm_castsi128_ps(r0);
+		__m128 b = _mm_castsi128_ps(r1);
+		__m128 c = _mm_castsi128_ps(r2);
+		__m128 d = _mm_castsi128_ps(r3);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		r0 = _mm_castps_si128(a);
+		r1 = _mm_castps_si128(b);
+		r2 = _mm_castps_si128(c);
+		r3 = _mm_castps_si128(d);
+	}
+}
+
+PositionQuantization VertexPacker::ComputeQuantization(const void* vertices, std::size_t vertexStride,
+	std::size_t vertexCount)
+{
+	PositionQuantization quantization;
+	if (vertexCount == 0)
+		return quantization;
+
+	float minimum[3];
+	float maximum[3];
+	const float* p = Attribute(vertices, vertexStride, 0, 0);
+	for (int c = 0; c < 3; ++c)
+		minimum[c] = maximum[c] = p[c];
+
+	for (std::size_t i = 1; i < vertexCount; ++i)
+	{
+		p = Attribute(vertices, vertexStride, i, 0);
+		for (int c = 0; c < 3; ++c)
+		{
+			minimum[c] = std::min<float>(minimum[c], p[c]);
+			maximum[c] = std::max<float>(maximum[c], p[c]);
+		}
+	}
+
+	for (int c = 0; c < 3; ++c)
+	{
+		quantization.Offset[c] = minimum[c];
+		quantization.Scale[c] = maximum[c] - minimum[c];
+	}
+	return quantization;
+}
+
+void VertexPacker::Pack(const void* vertices, const FloatVertexLayout& layout, std::size_t vertexCount,
+	const PositionQuantization& quantization, PackedVertex* packed)
+{
+	__m128 offset[3];
+	__m128 invScale[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		offset[c] = _mm_set1_ps(quantization.Offset[c]);
+		invScale[c] = _mm_set1_ps(quantization.Scale[c] > 0.0f ? UnormMax / quantization.Scale[c] : 0.0f);
+	}
+
+	for (std::size_t i = 0; i < vertexCount; i += 4)
+	{
+		VertexLanes lanes = LoadLanes(vertices, layout, i, vertexCount);
+
+		// Rounded to nearest, the rounding mode is the same for every lane and call.
+		__m128i px = _mm_cvtps_epi32(Clamp(_mm_mul_ps(_mm_sub_ps(lanes.Px, offset[0]), invScale[0]), 0.0f, UnormMax));
+		__m128i py = _mm_cvtps_epi32(Clamp(_mm_mul_ps(_mm_sub_ps(lanes.Py, offset[1]), invScale[1]), 0.0f, UnormMax));
+		__m128i pz = _mm_cvtps_epi32(Clamp(_mm_mul_ps(_mm_sub_ps(lanes.Pz, offset[2]), invScale[2]), 0.0f, UnormMax));
+
+		__m128 octX, octY;
+		OctahedralEncode(lanes.Nx, lanes.Ny, lanes.Nz, octX, octY);
+		__m128i nx = _mm_cvtps_epi32(_mm_mul_ps(Clamp(octX, -1.0f, 1.0f), _mm_set1_ps(SnormMax)));
+		__m128i ny = _mm_cvtps_epi32(_mm_mul_ps(Clamp(octY, -1.0f, 1.0f), _mm_set1_ps(SnormMax)));
+
+		// One PackedVertex per lane, then one per row.
+		__m128i position = Interleave16(px, py);
+		__m128i positionZ = pz;
+		__m128i normal = Interleave16(nx, ny);
+		__m128i texC = Interleave16(FloatToHalf(lanes.U), FloatToHalf(lanes.V));
+		Transpose(position, positionZ, normal, texC);
+
+		if (i + 4 <= vertexCount)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i + 0), position);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i + 1), positionZ);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i + 2), normal);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i + 3), texC);
+		}
+		else
+		{
+			PackedVertex tail[4];
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(tail + 0), position);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(tail + 1), positionZ);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(tail + 2), normal);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(tail + 3), texC);
+			std::memcpy(packed + i, tail, (vertexCount - i) * sizeof(PackedVertex));
+		}
+	}
+}
+
+void VertexPacker::Unpack(const PackedVertex* packed, std::size_t vertexCount,
+	const PositionQuantization& quantization, void* vertices, const FloatVertexLayout& layout)
+{
+	__m128 offset[3];
+	__m128 step[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		offset[c] = _mm_set1_ps(quantization.Offset[c]);
+		step[c] = _mm_set1_ps(quantization.Scale[c] / UnormMax);
+	}
+
+	const __m128i lowMask = _mm_set1_epi32(0xffff);
+	for (std::size_t i = 0; i < vertexCount; i += 4)
+	{
+		PackedVertex tail[4] = {};
+		const PackedVertex* source = packed + i;
+		if (i + 4 > vertexCount)
+		{
+			std::memcpy(tail, source, (vertexCount - i) * sizeof(PackedVertex));
+			source = tail;
+		}
+
+		__m128i position = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 0));
+		__m128i positionZ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 1));
+		__m128i normal = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 2));
+		__m128i texC = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 3));
+		Transpose(position, positionZ, normal, texC);
+
+		VertexLanes lanes;
+		lanes.Px = _mm_add_ps(offset[0], _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(position, lowMask)), step[0]));
+		lanes.Py = _mm_add_ps(offset[1], _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(position, 16)), step[1]));
+		lanes.Pz = _mm_add_ps(offset[2], _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(positionZ, lowMask)), step[2]));
+
+		// Sign extended, snorm -32768 maps to -1 like -32767.
+		__m128 octX = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(normal, 16), 16));
+		__m128 octY = _mm_cvtepi32_ps(_mm_srai_epi32(normal, 16));
+		octX = _mm_max_ps(_mm_div_ps(octX, _mm_set1_ps(SnormMax)), _mm_set1_ps(-1.0f));
+		octY = _mm_max_ps(_mm_div_ps(octY, _mm_set1_ps(SnormMax)), _mm_set1_ps(-1.0f));
+		OctahedralDecode(octX, octY, lanes.Nx, lanes.Ny, lanes.Nz);
+
+		lanes.U = HalfToFloat(_mm_and_si128(texC, lowMask));
+		lanes.V = HalfToFloat(_mm_srli_epi32(texC, 16));
+
+		StoreLanes(lanes, vertices, layout, i, vertexCount);
+	}
+}
+
+PackingError VertexPacker::MeasureError(const void* vertices, const FloatVertexLayout& layout,
+	const PackedVertex* packed, std::size_t vertexCount, const PositionQuantization& quantization)
+{
+	struct UnpackedVertex
+	{
+		float Position[3];
+		float Normal[3];
+		float TexC[2];
+	};
+	const FloatVertexLayout unpackedLayout = { sizeof(UnpackedVertex), 3 * sizeof(float), 6 * sizeof(float) };
+
+	PackingError error;
+	double maxNormalAngle = 0.0;
+	UnpackedVertex unpacked[ErrorChunkSize];
+	for (std::size_t first = 0; first < vertexCount; first += ErrorChunkSize)
+	{
+		std::size_t count = std::min<std::size_t>(ErrorChunkSize, vertexCount - first);
+		Unpack(packed + first, count, quantization, unpacked, unpackedLayout);
+
+		for (std::size_t k = 0; k < count; ++k)
+		{
+			const float* p = Attribute(vertices, layout.Stride, first + k, 0);
+			const float* n = Attribute(vertices, layout.Stride, first + k, layout.NormalOffset);
+			const float* t = Attribute(vertices, layout.Stride, first + k, layout.TexCOffset);
+			const UnpackedVertex& u = unpacked[k];
+
+			for (int c = 0; c < 3; ++c)
+				error.Position = std::max<float>(error.Position, std::fabs(p[c] - u.Position[c]));
+			for (int c = 0; c < 2; ++c)
+				error.TexC = std::max<float>(error.TexC, std::fabs(t[c] - u.TexC[c]));
+
+			// The angle from the cross product, an acos of the dot product cannot resolve
+			// angles below a few hundredths of a degree in float.  Zero normals have no
+			// direction to lose.
+			double cross[3] = {
+				(double)n[1] * u.Normal[2] - (double)n[2] * u.Normal[1],
+				(double)n[2] * u.Normal[0] - (double)n[0] * u.Normal[2],
+				(double)n[0] * u.Normal[1] - (double)n[1] * u.Normal[0] };
+			double dot = (double)n[0] * u.Normal[0] + (double)n[1] * u.Normal[1] + (double)n[2] * u.Normal[2];
+			double sine = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]);
+			if (sine > 0.0 || dot > 0.0)
+				maxNormalAngle = std::max(maxNormalAngle, std::atan2(sine, dot));
+		}
+	}
+
+	error.Normal = (float)(maxNormalAngle * 180.0 / 3.14159265358979);
+	return error;
+}
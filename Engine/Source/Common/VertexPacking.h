@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Vertex of 16 bytes for the GPU, half of the float layout.  Positions are 16-bit unorm
+// within the bounds of their submesh, normals are octahedral encoded ("A Survey of
+// Efficient Representations for Independent Unit Vectors", Cigolle et al. 2014) in two
+// 16-bit snorm, and texture coordinates are half floats.
+struct PackedVertex
+{
+	// x, y, z and an unused w, DXGI_FORMAT_R16G16B16A16_UNORM.
+	std::uint16_t Position[4];
+	// DXGI_FORMAT_R16G16_SNORM.
+	std::int16_t Normal[2];
+	// DXGI_FORMAT_R16G16_FLOAT.
+	std::uint16_t TexC[2];
+};
+static_assert(sizeof(PackedVertex) == 16, "PackedVertex is read by the input assembler");
+
+// Maps the unorm positions of a submesh back to its space, position = Offset + unorm * Scale.
+struct PositionQuantization
+{
+	float Offset[3] = { 0.0f, 0.0f, 0.0f };
+	float Scale[3] = { 1.0f, 1.0f, 1.0f };
+};
+
+// Float vertex that starts with a float3 position and holds a float3 normal and a float2
+// texture coordinate at the given byte offsets.
+struct FloatVertexLayout
+{
+	std::size_t Stride;
+	std::size_t NormalOffset;
+	std::size_t TexCOffset;
+};
+
+// Largest differences between float vertices and their packed version.
+struct PackingError
+{
+	// Per component, in the units of the positions.
+	float Position = 0.0f;
+	// Angle in degrees to the normalized float normal.
+	float Normal = 0.0f;
+	// Per component.
+	float TexC = 0.0f;
+};
+
+// Packs and unpacks vertices with SSE2, four at a time.  A vertex packs to the same bits
+// wherever it is in the array.
+class ENGINE_API VertexPacker
+{
+public:
+	// Bounds of the positions.  An axis without extent gets a scale of zero.
+	static PositionQuantization ComputeQuantization(const void* vertices, std::size_t vertexStride,
+		std::size_t vertexCount);
+
+	static void Pack(const void* vertices, const FloatVertexLayout& layout, std::size_t vertexCount,
+		const PositionQuantization& quantization, PackedVertex* packed);
+
+	// Writes the position, normal and texture coordinate of each vertex, the rest of the
+	// layout is left alone.  Normals come out normalized.
+	static void Unpack(const PackedVertex* packed, std::size_t vertexCount,
+		const PositionQuantization& quantization, void* vertices, const FloatVertexLayout& layout);
+
+	static PackingError MeasureError(const void* vertices, const FloatVertexLayout& layout,
+		const PackedVertex* packed, std::size_t vertexCount, const PositionQuantization& quantization);
+};
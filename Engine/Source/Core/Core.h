@@ -6,6 +6,7 @@
 
 #include "Common/Logger.h"
 #include "Common/Timer.h"
+#include "Common/JobSystem.h"
 #include "Core/PerGameSettings.h"
 
 #ifdef WIN32
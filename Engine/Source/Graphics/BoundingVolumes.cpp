@@ -0,0 +1,413 @@
+#include "Engine.h"
+#include "BoundingVolumes.h"
+
+#include "MathHelper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	// Reads four points as x, y and z vectors.  Lanes past count repeat the first point,
+	// which changes no bound and adds nothing to the sums around it.
+	void LoadPoints(const std::uint8_t* points, size_t stride, size_t first, size_t count,
+		XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		XMMATRIX m;
+		for (size_t lane = 0; lane < 4; ++lane)
+		{
+			size_t i = first + lane < count ? first + lane : 0;
+			m.r[lane] = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(points + i * stride));
+		}
+
+		m = XMMatrixTranspose(m);
+		x = m.r[0];
+		y = m.r[1];
+		z = m.r[2];
+	}
+
+	XMFLOAT3 LoadPoint(const std::uint8_t* points, size_t stride, size_t i)
+	{
+		XMFLOAT3 p;
+		std::memcpy(&p, points + i * stride, sizeof(p));
+		return p;
+	}
+
+	// The rounded center and extents can miss the end points by a step, widen the extents
+	// until both are covered, measured from the center as a containment test does.
+	void GrowToCover(float center, float& extent, float lo, float hi)
+	{
+		while (hi - center > extent || center - lo > extent)
+			extent = std::nextafter(extent, MathHelper::Infinity);
+	}
+
+	float HorizontalMin(FXMVECTOR v)
+	{
+		XMFLOAT4 f;
+		XMStoreFloat4(&f, v);
+		return std::min<float>(std::min<float>(f.x, f.y), std::min<float>(f.z, f.w));
+	}
+
+	float HorizontalMax(FXMVECTOR v)
+	{
+		XMFLOAT4 f;
+		XMStoreFloat4(&f, v);
+		return std::max<float>(std::max<float>(f.x, f.y), std::max<float>(f.z, f.w));
+	}
+
+	float HorizontalSum(FXMVECTOR v)
+	{
+		XMFLOAT4 f;
+		XMStoreFloat4(&f, v);
+		return (f.x + f.y) + (f.z + f.w);
+	}
+
+	// Point index of the lane holding the smallest (or largest) value.
+	std::uint32_t ExtremeIndex(FXMVECTOR values, FXMVECTOR indices, bool largest)
+	{
+		XMFLOAT4 f;
+		XMUINT4 i;
+		XMStoreFloat4(&f, values);
+		XMStoreUInt4(&i, indices);
+
+		float value[4] = { f.x, f.y, f.z, f.w };
+		std::uint32_t index[4] = { i.x, i.y, i.z, i.w };
+
+		int best = 0;
+		for (int lane = 1; lane < 4; ++lane)
+		{
+			if (largest ? value[lane] > value[best] : value[lane] < value[best])
+				best = lane;
+		}
+		return index[best];
+	}
+
+	// Eigenvectors of a symmetric 3x3 matrix by cyclic Jacobi rotations, as the columns
+	// of vectors.
+	void SymmetricEigenvectors(double a[3][3], double vectors[3][3])
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+				vectors[i][j] = i == j ? 1.0 : 0.0;
+		}
+
+		for (int sweep = 0; sweep < 32; ++sweep)
+		{
+			double offDiagonal = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+			if (offDiagonal < 1e-30)
+				break;
+
+			for (int p = 0; p < 2; ++p)
+			{
+				for (int q = p + 1; q < 3; ++q)
+				{
+					if (std::abs(a[p][q]) < 1e-30)
+						continue;
+
+					// Rotation that zeroes a[p][q] ("Numerical Recipes", 11.1).
+					double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+					double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::abs(theta) + std::sqrt(theta * theta + 1.0));
+					double c = 1.0 / std::sqrt(t * t + 1.0);
+					double s = t * c;
+
+					for (int k = 0; k < 3; ++k)
+					{
+						double akp = a[k][p];
+						double akq = a[k][q];
+						a[k][p] = c * akp - s * akq;
+						a[k][q] = s * akp + c * akq;
+					}
+					for (int k = 0; k < 3; ++k)
+					{
+						double apk = a[p][k];
+						double aqk = a[q][k];
+						a[p][k] = c * apk - s * aqk;
+						a[q][k] = s * apk + c * aqk;
+					}
+					for (int k = 0; k < 3; ++k)
+					{
+						double vkp = vectors[k][p];
+						double vkq = vectors[k][q];
+						vectors[k][p] = c * vkp - s * vkq;
+						vectors[k][q] = s * vkp + c * vkq;
+					}
+				}
+			}
+		}
+	}
+}
+
+BoundingVolumes BoundsBuilder::Build(const void* points, size_t pointStride, size_t pointCount)
+{
+	BoundingVolumes volumes;
+	volumes.Box = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f));
+	volumes.Sphere = BoundingSphere(XMFLOAT3(0.0f, 0.0f, 0.0f), 0.0f);
+	volumes.OrientedBox = BoundingOrientedBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 0.0f, 0.0f),
+		XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	if (pointCount == 0)
+		return volumes;
+
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(points);
+
+	//
+	// First pass: the box, the points at its faces and the sums of the covariance.
+	// The sums are taken around the first point to keep their float precision.
+	//
+
+	XMFLOAT3 origin = LoadPoint(bytes, pointStride, 0);
+	XMVECTOR originX = XMVectorReplicate(origin.x);
+	XMVECTOR originY = XMVectorReplicate(origin.y);
+	XMVECTOR originZ = XMVectorReplicate(origin.z);
+
+	XMVECTOR minX = originX, minY = originY, minZ = originZ;
+	XMVECTOR maxX = originX, maxY = originY, maxZ = originZ;
+	XMVECTOR minIndexX = XMVectorZero(), minIndexY = XMVectorZero(), minIndexZ = XMVectorZero();
+	XMVECTOR maxIndexX = XMVectorZero(), maxIndexY = XMVectorZero(), maxIndexZ = XMVectorZero();
+
+	XMVECTOR sumX = XMVectorZero(), sumY = XMVectorZero(), sumZ = XMVectorZero();
+	XMVECTOR sumXX = XMVectorZero(), sumXY = XMVectorZero(), sumXZ = XMVectorZero();
+	XMVECTOR sumYY = XMVectorZero(), sumYZ = XMVectorZero(), sumZZ = XMVectorZero();
+
+	for (size_t i = 0; i < pointCount; i += 4)
+	{
+		XMVECTOR x, y, z;
+		LoadPoints(bytes, pointStride, i, pointCount, x, y, z);
+
+		XMVECTOR index = XMVectorSetInt((std::uint32_t)i, (std::uint32_t)i + 1, (std::uint32_t)i + 2, (std::uint32_t)i + 3);
+
+		XMVECTOR less = XMVectorLess(x, minX);
+		minX = XMVectorSelect(minX, x, less);
+		minIndexX = XMVectorSelect(minIndexX, index, less);
+		less = XMVectorLess(y, minY);
+		minY = XMVectorSelect(minY, y, less);
+		minIndexY = XMVectorSelect(minIndexY, index, less);
+		less = XMVectorLess(z, minZ);
+		minZ = XMVectorSelect(minZ, z, less);
+		minIndexZ = XMVectorSelect(minIndexZ, index, less);
+
+		XMVECTOR greater = XMVectorGreater(x, maxX);
+		maxX = XMVectorSelect(maxX, x, greater);
+		maxIndexX = XMVectorSelect(maxIndexX, index, greater);
+		greater = XMVectorGreater(y, maxY);
+		maxY = XMVectorSelect(maxY, y, greater);
+		maxIndexY = XMVectorSelect(maxIndexY, index, greater);
+		greater = XMVectorGreater(z, maxZ);
+		maxZ = XMVectorSelect(maxZ, z, greater);
+		maxIndexZ = XMVectorSelect(maxIndexZ, index, greater);
+
+		XMVECTOR dx = XMVectorSubtract(x, originX);
+		XMVECTOR dy = XMVectorSubtract(y, originY);
+		XMVECTOR dz = XMVectorSubtract(z, originZ);
+		sumX = XMVectorAdd(sumX, dx);
+		sumY = XMVectorAdd(sumY, dy);
+		sumZ = XMVectorAdd(sumZ, dz);
+		sumXX = XMVectorMultiplyAdd(dx, dx, sumXX);
+		sumXY = XMVectorMultiplyAdd(dx, dy, sumXY);
+		sumXZ = XMVectorMultiplyAdd(dx, dz, sumXZ);
+		sumYY = XMVectorMultiplyAdd(dy, dy, sumYY);
+		sumYZ = XMVectorMultiplyAdd(dy, dz, sumYZ);
+		sumZZ = XMVectorMultiplyAdd(dz, dz, sumZZ);
+	}
+
+	XMFLOAT3 boxMin(HorizontalMin(minX), HorizontalMin(minY), HorizontalMin(minZ));
+	XMFLOAT3 boxMax(HorizontalMax(maxX), HorizontalMax(maxY), HorizontalMax(maxZ));
+	XMVECTOR boxCenter = 0.5f * (XMLoadFloat3(&boxMax) + XMLoadFloat3(&boxMin));
+	XMVECTOR boxExtents = 0.5f * (XMLoadFloat3(&boxMax) - XMLoadFloat3(&boxMin));
+	XMStoreFloat3(&volumes.Box.Center, boxCenter);
+	XMStoreFloat3(&volumes.Box.Extents, boxExtents);
+	GrowToCover(volumes.Box.Center.x, volumes.Box.Extents.x, boxMin.x, boxMax.x);
+	GrowToCover(volumes.Box.Center.y, volumes.Box.Extents.y, boxMin.y, boxMax.y);
+	GrowToCover(volumes.Box.Center.z, volumes.Box.Extents.z, boxMin.z, boxMax.z);
+
+	//
+	// Ritter's initial sphere spans the farthest apart pair of the points at the box faces
+	// ("An Efficient Bounding Sphere", Graphics Gems, 1990).
+	//
+
+	std::uint32_t extremes[3][2] =
+	{
+		{ ExtremeIndex(minX, minIndexX, false), ExtremeIndex(maxX, maxIndexX, true) },
+		{ ExtremeIndex(minY, minIndexY, false), ExtremeIndex(maxY, maxIndexY, true) },
+		{ ExtremeIndex(minZ, minIndexZ, false), ExtremeIndex(maxZ, maxIndexZ, true) },
+	};
+
+	XMVECTOR sphereCenter = XMVectorZero();
+	float sphereRadius = -1.0f;
+	for (const auto& pair : extremes)
+	{
+		XMFLOAT3 p0 = LoadPoint(bytes, pointStride, pair[0]);
+		XMFLOAT3 p1 = LoadPoint(bytes, pointStride, pair[1]);
+		XMVECTOR a = XMLoadFloat3(&p0);
+		XMVECTOR b = XMLoadFloat3(&p1);
+		float radius = 0.5f * XMVectorGetX(XMVector3Length(b - a));
+		if (radius > sphereRadius)
+		{
+			sphereCenter = 0.5f * (a + b);
+			sphereRadius = radius;
+		}
+	}
+
+	//
+	// Principal axes from the covariance of the points.
+	//
+
+	double invCount = 1.0 / (double)pointCount;
+	double mean[3] = { HorizontalSum(sumX) * invCount, HorizontalSum(sumY) * invCount, HorizontalSum(sumZ) * invCount };
+	double covariance[3][3];
+	covariance[0][0] = HorizontalSum(sumXX) * invCount - mean[0] * mean[0];
+	covariance[0][1] = HorizontalSum(sumXY) * invCount - mean[0] * mean[1];
+	covariance[0][2] = HorizontalSum(sumXZ) * invCount - mean[0] * mean[2];
+	covariance[1][1] = HorizontalSum(sumYY) * invCount - mean[1] * mean[1];
+	covariance[1][2] = HorizontalSum(sumYZ) * invCount - mean[1] * mean[2];
+	covariance[2][2] = HorizontalSum(sumZZ) * invCount - mean[2] * mean[2];
+	covariance[1][0] = covariance[0][1];
+	covariance[2][0] = covariance[0][2];
+	covariance[2][1] = covariance[1][2];
+
+	double eigenvectors[3][3];
+	SymmetricEigenvectors(covariance, eigenvectors);
+
+	// Rows of the box rotation, made right handed.
+	XMMATRIX axes = XMMatrixIdentity();
+	axes.r[0] = XMVector3Normalize(XMVectorSet((float)eigenvectors[0][0], (float)eigenvectors[1][0], (float)eigenvectors[2][0], 0.0f));
+	axes.r[1] = XMVector3Normalize(XMVectorSet((float)eigenvectors[0][1], (float)eigenvectors[1][1], (float)eigenvectors[2][1], 0.0f));
+	axes.r[2] = XMVector3Normalize(XMVector3Cross(axes.r[0], axes.r[1]));
+
+	//
+	// Second pass: grow Ritter's sphere over the points outside it, project the points
+	// onto the principal axes and find the point farthest from the box center.  The
+	// projections are taken around the box center to keep their float precision.
+	//
+
+	XMVECTOR axisX[3], axisY[3], axisZ[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		axisX[k] = XMVectorSplatX(axes.r[k]);
+		axisY[k] = XMVectorSplatY(axes.r[k]);
+		axisZ[k] = XMVectorSplatZ(axes.r[k]);
+	}
+
+	XMVECTOR projectionMin[3], projectionMax[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		projectionMin[k] = XMVectorReplicate(+MathHelper::Infinity);
+		projectionMax[k] = XMVectorReplicate(-MathHelper::Infinity);
+	}
+
+	XMVECTOR boxCenterX = XMVectorSplatX(boxCenter);
+	XMVECTOR boxCenterY = XMVectorSplatY(boxCenter);
+	XMVECTOR boxCenterZ = XMVectorSplatZ(boxCenter);
+	XMVECTOR boxDistanceSq = XMVectorZero();
+
+	XMVECTOR centerX = XMVectorSplatX(sphereCenter);
+	XMVECTOR centerY = XMVectorSplatY(sphereCenter);
+	XMVECTOR centerZ = XMVectorSplatZ(sphereCenter);
+	XMVECTOR radiusSq = XMVectorReplicate(sphereRadius * sphereRadius);
+
+	for (size_t i = 0; i < pointCount; i += 4)
+	{
+		XMVECTOR x, y, z;
+		LoadPoints(bytes, pointStride, i, pointCount, x, y, z);
+
+		XMVECTOR dx = XMVectorSubtract(x, boxCenterX);
+		XMVECTOR dy = XMVectorSubtract(y, boxCenterY);
+		XMVECTOR dz = XMVectorSubtract(z, boxCenterZ);
+		for (int k = 0; k < 3; ++k)
+		{
+			XMVECTOR projection = XMVectorMultiply(dx, axisX[k]);
+			projection = XMVectorMultiplyAdd(dy, axisY[k], projection);
+			projection = XMVectorMultiplyAdd(dz, axisZ[k], projection);
+			projectionMin[k] = XMVectorMin(projectionMin[k], projection);
+			projectionMax[k] = XMVectorMax(projectionMax[k], projection);
+		}
+
+		XMVECTOR distanceSq = XMVectorMultiply(dx, dx);
+		distanceSq = XMVectorMultiplyAdd(dy, dy, distanceSq);
+		distanceSq = XMVectorMultiplyAdd(dz, dz, distanceSq);
+		boxDistanceSq = XMVectorMax(boxDistanceSq, distanceSq);
+
+		dx = XMVectorSubtract(x, centerX);
+		dy = XMVectorSubtract(y, centerY);
+		dz = XMVectorSubtract(z, centerZ);
+		distanceSq = XMVectorMultiply(dx, dx);
+		distanceSq = XMVectorMultiplyAdd(dy, dy, distanceSq);
+		distanceSq = XMVectorMultiplyAdd(dz, dz, distanceSq);
+
+		// Few points are outside once the sphere has grown, they are handled one by one.
+		if (!XMComparisonAnyTrue(XMVector4GreaterR(distanceSq, radiusSq)))
+			continue;
+
+		for (size_t lane = 0; lane < 4 && i + lane < pointCount; ++lane)
+		{
+			XMFLOAT3 p = LoadPoint(bytes, pointStride, i + lane);
+			XMVECTOR offset = XMLoadFloat3(&p) - sphereCenter;
+			float distance = XMVectorGetX(XMVector3Length(offset));
+			if (distance <= sphereRadius)
+				continue;
+
+			// Move the center towards the point just enough to reach it.
+			float radius = 0.5f * (sphereRadius + distance);
+			sphereCenter = XMVectorMultiplyAdd(offset, XMVectorReplicate((radius - sphereRadius) / distance), sphereCenter);
+			sphereRadius = radius;
+		}
+
+		centerX = XMVectorSplatX(sphereCenter);
+		centerY = XMVectorSplatY(sphereCenter);
+		centerZ = XMVectorSplatZ(sphereCenter);
+		radiusSq = XMVectorReplicate(sphereRadius * sphereRadius);
+	}
+
+	// The sphere around the box center wins for symmetric meshes.
+	float boxRadius = std::sqrt(HorizontalMax(boxDistanceSq));
+	if (boxRadius < sphereRadius)
+	{
+		sphereCenter = boxCenter;
+		sphereRadius = boxRadius;
+	}
+
+	XMStoreFloat3(&volumes.Sphere.Center, sphereCenter);
+	volumes.Sphere.Radius = sphereRadius;
+
+	//
+	// The box along the principal axes, unless the axis-aligned one is tighter.
+	//
+
+	float axisMin[3], axisMax[3];
+	for (int k = 0; k < 3; ++k)
+	{
+		axisMin[k] = HorizontalMin(projectionMin[k]);
+		axisMax[k] = HorizontalMax(projectionMax[k]);
+	}
+
+	// The center is rounded when it is stored and the orientation when it becomes a
+	// quaternion, a few float steps of the larger of the two cover both.
+	float largest = std::max<float>(std::max<float>(axisMax[0] - axisMin[0], axisMax[1] - axisMin[1]), axisMax[2] - axisMin[2]);
+	float rounding = 4.0f * FLT_EPSILON * (HorizontalMax(XMVectorAbs(boxCenter)) + largest);
+	XMFLOAT3 extents(0.5f * (axisMax[0] - axisMin[0]) + rounding, 0.5f * (axisMax[1] - axisMin[1]) + rounding,
+		0.5f * (axisMax[2] - axisMin[2]) + rounding);
+	XMFLOAT3 boxSize = volumes.Box.Extents;
+	if (extents.x * extents.y * extents.z < boxSize.x * boxSize.y * boxSize.z)
+	{
+		XMVECTOR center = XMVectorMultiplyAdd(axes.r[0], XMVectorReplicate(0.5f * (axisMin[0] + axisMax[0])), boxCenter);
+		center = XMVectorMultiplyAdd(axes.r[1], XMVectorReplicate(0.5f * (axisMin[1] + axisMax[1])), center);
+		center = XMVectorMultiplyAdd(axes.r[2], XMVectorReplicate(0.5f * (axisMin[2] + axisMax[2])), center);
+
+		XMStoreFloat3(&volumes.OrientedBox.Center, center);
+		volumes.OrientedBox.Extents = extents;
+		XMStoreFloat4(&volumes.OrientedBox.Orientation, XMQuaternionRotationMatrix(axes));
+	}
+	else
+	{
+		volumes.OrientedBox.Center = volumes.Box.Center;
+		volumes.OrientedBox.Extents = volumes.Box.Extents;
+	}
+
+	return volumes;
+}
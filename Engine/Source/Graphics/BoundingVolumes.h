@@ -0,0 +1,25 @@
+#pragma once
+
+#include <DirectXCollision.h>
+#include <cstddef>
+
+// Bounding volumes around one set of points.  Culling rejects an item when its oriented
+// box or its sphere is outside a plane, so every plane is tested with the tighter of them.
+struct BoundingVolumes
+{
+	// Axis-aligned box, for picking.
+	DirectX::BoundingBox Box;
+	// Ritter's sphere, or the sphere around the center of Box when that one is smaller.
+	DirectX::BoundingSphere Sphere;
+	// Box along the principal axes of the points, or Box when that has less volume.
+	DirectX::BoundingOrientedBox OrientedBox;
+};
+
+// Builds all the volumes in two passes over the points, four points at a time.
+class ENGINE_API BoundsBuilder
+{
+public:
+	// points are float3 positions pointStride bytes apart.  Without points the volumes
+	// are empty, at the origin.
+	static BoundingVolumes Build(const void* points, size_t pointStride, size_t pointCount);
+};
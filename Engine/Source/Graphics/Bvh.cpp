@@ -0,0 +1,351 @@
+#include "Engine.h"
+#include "Bvh.h"
+
+using namespace DirectX;
+
+namespace
+{
+	float Axis(const XMFLOAT3& v, int axis)
+	{
+		return (&v.x)[axis];
+	}
+
+	float HalfArea(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax)
+	{
+		float ex = boundsMax.x - boundsMin.x;
+		float ey = boundsMax.y - boundsMin.y;
+		float ez = boundsMax.z - boundsMin.z;
+		return ex * ey + ey * ez + ez * ex;
+	}
+
+	void Grow(XMFLOAT3& boundsMin, XMFLOAT3& boundsMax, const XMFLOAT3& pMin, const XMFLOAT3& pMax)
+	{
+		boundsMin.x = std::min<float>(boundsMin.x, pMin.x);
+		boundsMin.y = std::min<float>(boundsMin.y, pMin.y);
+		boundsMin.z = std::min<float>(boundsMin.z, pMin.z);
+		boundsMax.x = std::max<float>(boundsMax.x, pMax.x);
+		boundsMax.y = std::max<float>(boundsMax.y, pMax.y);
+		boundsMax.z = std::max<float>(boundsMax.z, pMax.z);
+	}
+
+	struct Bin
+	{
+		XMFLOAT3 BoundsMin = { +MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity };
+		XMFLOAT3 BoundsMax = { -MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity };
+		UINT Count = 0;
+	};
+}
+
+void Bvh::Build(UINT primitiveCount, const XMFLOAT3* boundsMin, const XMFLOAT3* boundsMax)
+{
+	Clear();
+
+	if (primitiveCount == 0)
+		return;
+
+	m_PrimitiveIndices.resize(primitiveCount);
+	std::vector<XMFLOAT3> centroids(primitiveCount);
+	for (UINT i = 0; i < primitiveCount; ++i)
+	{
+		m_PrimitiveIndices[i] = i;
+		centroids[i] = XMFLOAT3(
+			0.5f * (boundsMin[i].x + boundsMax[i].x),
+			0.5f * (boundsMin[i].y + boundsMax[i].y),
+			0.5f * (boundsMin[i].z + boundsMax[i].z));
+	}
+
+	// A binary tree over n leaves never has more than 2n - 1 nodes.
+	m_Nodes.reserve(2 * primitiveCount);
+
+	Node root;
+	root.LeftFirst = 0;
+	root.PrimitiveCount = primitiveCount;
+	m_Nodes.push_back(root);
+
+	UpdateNodeBounds(0, boundsMin, boundsMax);
+	Subdivide(0, 1, boundsMin, boundsMax, centroids.data());
+}
+
+void Bvh::Refit(const XMFLOAT3* boundsMin, const XMFLOAT3* boundsMax)
+{
+	// Children are always stored after their parent, so walking the array backwards
+	// visits both children before the parent.
+	for (size_t i = m_Nodes.size(); i-- > 0;)
+	{
+		Node& node = m_Nodes[i];
+		if (node.PrimitiveCount > 0)
+		{
+			UpdateNodeBounds((UINT)i, boundsMin, boundsMax);
+			continue;
+		}
+
+		const Node& left = m_Nodes[node.LeftFirst];
+		const Node& right = m_Nodes[node.LeftFirst + 1];
+		node.BoundsMin = left.BoundsMin;
+		node.BoundsMax = left.BoundsMax;
+		Grow(node.BoundsMin, node.BoundsMax, right.BoundsMin, right.BoundsMax);
+	}
+}
+
+void Bvh::Clear()
+{
+	m_Nodes.clear();
+	m_PrimitiveIndices.clear();
+}
+
+bool Bvh::Empty() const
+{
+	return m_Nodes.empty();
+}
+
+const std::vector<Bvh::Node>& Bvh::Nodes() const
+{
+	return m_Nodes;
+}
+
+const std::vector<UINT>& Bvh::PrimitiveIndices() const
+{
+	return m_PrimitiveIndices;
+}
+
+void Bvh::UpdateNodeBounds(UINT nodeIndex, const XMFLOAT3* boundsMin, const XMFLOAT3* boundsMax)
+{
+	Node& node = m_Nodes[nodeIndex];
+	node.BoundsMin = XMFLOAT3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+	node.BoundsMax = XMFLOAT3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+
+	for (UINT i = 0; i < node.PrimitiveCount; ++i)
+	{
+		UINT primitive = m_PrimitiveIndices[node.LeftFirst + i];
+		Grow(node.BoundsMin, node.BoundsMax, boundsMin[primitive], boundsMax[primitive]);
+	}
+}
+
+void Bvh::Subdivide(UINT nodeIndex, UINT depth, const XMFLOAT3* boundsMin,
+	const XMFLOAT3* boundsMax, const XMFLOAT3* centroids)
+{
+	// Copy, m_Nodes may reallocate when children are pushed.
+	Node node = m_Nodes[nodeIndex];
+
+	if (node.PrimitiveCount <= 1 || depth >= MaxDepth)
+		return;
+
+	// Bin the primitives by centroid along each axis and keep the split plane with the
+	// lowest surface area cost.
+	XMFLOAT3 centroidMin(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
+	XMFLOAT3 centroidMax(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
+	for (UINT i = 0; i < node.PrimitiveCount; ++i)
+	{
+		const XMFLOAT3& c = centroids[m_PrimitiveIndices[node.LeftFirst + i]];
+		Grow(centroidMin, centroidMax, c, c);
+	}
+
+	int bestAxis = -1;
+	UINT bestSplit = 0;
+	float bestCost = MathHelper::Infinity;
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float axisMin = Axis(centroidMin, axis);
+		float axisMax = Axis(centroidMax, axis);
+		if (axisMin == axisMax)
+			continue;
+
+		float scale = BinCount / (axisMax - axisMin);
+
+		Bin bins[BinCount];
+		for (UINT i = 0; i < node.PrimitiveCount; ++i)
+		{
+			UINT primitive = m_PrimitiveIndices[node.LeftFirst + i];
+			UINT b = std::min<UINT>(BinCount - 1, (UINT)((Axis(centroids[primitive], axis) - axisMin) * scale));
+			bins[b].Count++;
+			Grow(bins[b].BoundsMin, bins[b].BoundsMax, boundsMin[primitive], boundsMax[primitive]);
+		}
+
+		// Sweep from both sides to get the area and count left and right of each plane.
+		float leftArea[BinCount - 1];
+		float rightArea[BinCount - 1];
+		UINT leftCount[BinCount - 1];
+		UINT rightCount[BinCount - 1];
+
+		Bin left;
+		Bin right;
+		for (UINT i = 0; i < BinCount - 1; ++i)
+		{
+			left.Count += bins[i].Count;
+			Grow(left.BoundsMin, left.BoundsMax, bins[i].BoundsMin, bins[i].BoundsMax);
+			leftCount[i] = left.Count;
+			leftArea[i] = left.Count > 0 ? HalfArea(left.BoundsMin, left.BoundsMax) : 0.0f;
+
+			UINT r = BinCount - 1 - i;
+			right.Count += bins[r].Count;
+			Grow(right.BoundsMin, right.BoundsMax, bins[r].BoundsMin, bins[r].BoundsMax);
+			rightCount[r - 1] = right.Count;
+			rightArea[r - 1] = right.Count > 0 ? HalfArea(right.BoundsMin, right.BoundsMax) : 0.0f;
+		}
+
+		for (UINT i = 0; i < BinCount - 1; ++i)
+		{
+			if (leftCount[i] == 0 || rightCount[i] == 0)
+				continue;
+
+			float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = i;
+			}
+		}
+	}
+
+	// Splitting costs one extra box test, keep the leaf if that does not pay off.
+	float leafCost = node.PrimitiveCount * HalfArea(node.BoundsMin, node.BoundsMax);
+	if (bestAxis < 0 || HalfArea(node.BoundsMin, node.BoundsMax) + bestCost >= leafCost)
+		return;
+
+	// Partition the primitive indices in place, bins up to bestSplit go left.
+	float axisMin = Axis(centroidMin, bestAxis);
+	float scale = BinCount / (Axis(centroidMax, bestAxis) - axisMin);
+
+	UINT* first = m_PrimitiveIndices.data() + node.LeftFirst;
+	UINT* last = first + node.PrimitiveCount;
+	UINT* middle = std::partition(first, last, [&](UINT primitive)
+		{
+			UINT b = std::min<UINT>(BinCount - 1, (UINT)((Axis(centroids[primitive], bestAxis) - axisMin) * scale));
+			return b <= bestSplit;
+		});
+
+	UINT leftCount = (UINT)(middle - first);
+	if (leftCount == 0 || leftCount == node.PrimitiveCount)
+		return;
+
+	UINT leftIndex = (UINT)m_Nodes.size();
+
+	Node leftChild;
+	leftChild.LeftFirst = node.LeftFirst;
+	leftChild.PrimitiveCount = leftCount;
+	m_Nodes.push_back(leftChild);
+
+	Node rightChild;
+	rightChild.LeftFirst = node.LeftFirst + leftCount;
+	rightChild.PrimitiveCount = node.PrimitiveCount - leftCount;
+	m_Nodes.push_back(rightChild);
+
+	m_Nodes[nodeIndex].LeftFirst = leftIndex;
+	m_Nodes[nodeIndex].PrimitiveCount = 0;
+
+	UpdateNodeBounds(leftIndex, boundsMin, boundsMax);
+	UpdateNodeBounds(leftIndex + 1, boundsMin, boundsMax);
+
+	Subdivide(leftIndex, depth + 1, boundsMin, boundsMax, centroids);
+	Subdivide(leftIndex + 1, depth + 1, boundsMin, boundsMax, centroids);
+}
+
+void TriangleBvh::Build(const void* vertices, UINT vertexByteStride, const void* indices, UINT indexByteSize,
+	UINT indexCount, UINT startIndexLocation, INT baseVertexLocation)
+{
+	UINT triangleCount = indexCount / 3;
+
+	const BYTE* vertexBytes = static_cast<const BYTE*>(vertices);
+	auto readIndex = [&](UINT i) -> UINT
+		{
+			UINT index = indexByteSize == 2 ?
+				static_cast<const std::uint16_t*>(indices)[startIndexLocation + i] :
+				static_cast<const std::uint32_t*>(indices)[startIndexLocation + i];
+			return (UINT)((INT)index + baseVertexLocation);
+		};
+	auto readPosition = [&](UINT vertex)
+		{
+			// The position is the first member of every vertex format.
+			return *reinterpret_cast<const XMFLOAT3*>(vertexBytes + (size_t)vertex * vertexByteStride);
+		};
+
+	std::vector<XMFLOAT3> positions(3 * (size_t)triangleCount);
+	std::vector<XMFLOAT3> boundsMin(triangleCount);
+	std::vector<XMFLOAT3> boundsMax(triangleCount);
+
+	for (UINT t = 0; t < triangleCount; ++t)
+	{
+		XMFLOAT3& p0 = positions[3 * t + 0];
+		XMFLOAT3& p1 = positions[3 * t + 1];
+		XMFLOAT3& p2 = positions[3 * t + 2];
+		p0 = readPosition(readIndex(3 * t + 0));
+		p1 = readPosition(readIndex(3 * t + 1));
+		p2 = readPosition(readIndex(3 * t + 2));
+
+		boundsMin[t] = p0;
+		boundsMax[t] = p0;
+		Grow(boundsMin[t], boundsMax[t], p1, p1);
+		Grow(boundsMin[t], boundsMax[t], p2, p2);
+	}
+
+	m_Bvh.Build(triangleCount, boundsMin.data(), boundsMax.data());
+
+	// Store the triangles in leaf order.
+	const std::vector<UINT>& order = m_Bvh.PrimitiveIndices();
+	m_TriangleIndices = order;
+	m_Positions.resize(positions.size());
+	for (UINT i = 0; i < triangleCount; ++i)
+	{
+		m_Positions[3 * i + 0] = positions[3 * order[i] + 0];
+		m_Positions[3 * i + 1] = positions[3 * order[i] + 1];
+		m_Positions[3 * i + 2] = positions[3 * order[i] + 2];
+	}
+}
+
+bool TriangleBvh::Intersect(FXMVECTOR origin, FXMVECTOR direction, float& t, UINT& triangle) const
+{
+	bool hit = false;
+
+	t = m_Bvh.Intersect(origin, direction, t, [&](UINT slot, float tMax)
+		{
+			// Two sided Moller-Trumbore test.  Unlike TriangleTests::Intersects it does not
+			// require a unit direction, so the ray can stay in the item's local space scale.
+			XMVECTOR v0 = XMLoadFloat3(&m_Positions[3 * slot + 0]);
+			XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&m_Positions[3 * slot + 1]), v0);
+			XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&m_Positions[3 * slot + 2]), v0);
+
+			XMVECTOR p = XMVector3Cross(direction, e2);
+			float det = XMVectorGetX(XMVector3Dot(e1, p));
+			if (std::fabs(det) < 1e-12f)
+				return tMax;
+
+			float invDet = 1.0f / det;
+			XMVECTOR s = XMVectorSubtract(origin, v0);
+			float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+			if (u < 0.0f || u > 1.0f)
+				return tMax;
+
+			XMVECTOR q = XMVector3Cross(s, e1);
+			float v = XMVectorGetX(XMVector3Dot(direction, q)) * invDet;
+			if (v < 0.0f || u + v > 1.0f)
+				return tMax;
+
+			float tHit = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+			if (tHit < 0.0f || tHit >= tMax)
+				return tMax;
+
+			hit = true;
+			triangle = m_TriangleIndices[slot];
+			return tHit;
+		});
+
+	return hit;
+}
+
+UINT TriangleBvh::TriangleCount() const
+{
+	return (UINT)m_TriangleIndices.size();
+}
+
+BoundingBox TriangleBvh::Bounds() const
+{
+	BoundingBox bounds;
+	if (m_Bvh.Empty())
+		return bounds;
+
+	const Bvh::Node& root = m_Bvh.Nodes()[0];
+	BoundingBox::CreateFromPoints(bounds, XMLoadFloat3(&root.BoundsMin), XMLoadFloat3(&root.BoundsMax));
+	return bounds;
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "MathHelper.h"
+
+#include <DirectXCollision.h>
+#include <algorithm>
+#include <vector>
+
+// Bounding volume hierarchy over axis-aligned boxes.  The tree is built top-down with the
+// binned surface area heuristic and flattened into a single node array in depth-first
+// order, where the two children of an interior node are stored next to each other.
+class ENGINE_API Bvh
+{
+public:
+	struct Node
+	{
+		DirectX::XMFLOAT3 BoundsMin = { 0.0f, 0.0f, 0.0f };
+		// Interior node: index of the left child, the right child follows it.
+		// Leaf: index of the first slot in PrimitiveIndices().
+		UINT LeftFirst = 0;
+		DirectX::XMFLOAT3 BoundsMax = { 0.0f, 0.0f, 0.0f };
+		// Number of primitives in a leaf, 0 for interior nodes.
+		UINT PrimitiveCount = 0;
+	};
+
+	// Builds the hierarchy over primitiveCount boxes given by their min and max corners.
+	void Build(UINT primitiveCount, const DirectX::XMFLOAT3* boundsMin, const DirectX::XMFLOAT3* boundsMax);
+
+	// Recomputes the node bounds after the primitive boxes moved, keeping the tree topology.
+	// The primitive count must match the last Build().
+	void Refit(const DirectX::XMFLOAT3* boundsMin, const DirectX::XMFLOAT3* boundsMax);
+
+	void Clear();
+	bool Empty() const;
+
+	const std::vector<Node>& Nodes() const;
+	// Primitive indices in leaf order.  Leaves reference contiguous slots of this array.
+	const std::vector<UINT>& PrimitiveIndices() const;
+
+	// Visits the leaves hit by the ray, nearest first, and skips every node that starts
+	// beyond the closest hit found so far.  leafFunc(slot, tMax) is called for each
+	// primitive slot in a visited leaf and returns the new closest hit distance.
+	// Returns the closest hit distance, or tMax if nothing closer was hit.
+	template<typename LeafFunc>
+	float Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, LeafFunc&& leafFunc) const;
+
+private:
+	void UpdateNodeBounds(UINT nodeIndex, const DirectX::XMFLOAT3* boundsMin, const DirectX::XMFLOAT3* boundsMax);
+	void Subdivide(UINT nodeIndex, UINT depth, const DirectX::XMFLOAT3* boundsMin,
+		const DirectX::XMFLOAT3* boundsMax, const DirectX::XMFLOAT3* centroids);
+
+	static bool IntersectNode(const Node& node, const DirectX::XMFLOAT3& origin,
+		const DirectX::XMFLOAT3& invDirection, float tMax, float& tEntry);
+
+private:
+	// Traversal uses a fixed size stack, so the depth of the tree is capped.
+	static const UINT MaxDepth = 64;
+	static const UINT BinCount = 16;
+
+	std::vector<Node> m_Nodes;
+	std::vector<UINT> m_PrimitiveIndices;
+};
+
+// Triangle BVH of one submesh, used for ray picking.  The triangle positions are copied
+// out of the vertex/index buffers in leaf order so a leaf reads contiguous memory.
+class ENGINE_API TriangleBvh
+{
+public:
+	// indexByteSize is 2 for 16-bit and 4 for 32-bit index buffers.
+	void Build(const void* vertices, UINT vertexByteStride, const void* indices, UINT indexByteSize,
+		UINT indexCount, UINT startIndexLocation, INT baseVertexLocation);
+
+	// Finds the nearest triangle hit by the ray closer than t.  The direction does not need
+	// to be unit length, t is measured in multiples of it.  On a hit t and triangle are updated.
+	bool Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float& t, UINT& triangle) const;
+
+	UINT TriangleCount() const;
+	// Box around all the triangles.
+	DirectX::BoundingBox Bounds() const;
+
+private:
+	Bvh m_Bvh;
+
+	// Three positions per triangle in leaf order.
+	std::vector<DirectX::XMFLOAT3> m_Positions;
+	// Original triangle index of each triangle in leaf order.
+	std::vector<UINT> m_TriangleIndices;
+};
+
+inline bool Bvh::IntersectNode(const Node& node, const DirectX::XMFLOAT3& origin,
+	const DirectX::XMFLOAT3& invDirection, float tMax, float& tEntry)
+{
+	// Slab test.
+	float tx1 = (node.BoundsMin.x - origin.x) * invDirection.x;
+	float tx2 = (node.BoundsMax.x - origin.x) * invDirection.x;
+	float tNear = std::min<float>(tx1, tx2);
+	float tFar = std::max<float>(tx1, tx2);
+
+	float ty1 = (node.BoundsMin.y - origin.y) * invDirection.y;
+	float ty2 = (node.BoundsMax.y - origin.y) * invDirection.y;
+	tNear = std::max<float>(tNear, std::min<float>(ty1, ty2));
+	tFar = std::min<float>(tFar, std::max<float>(ty1, ty2));
+
+	float tz1 = (node.BoundsMin.z - origin.z) * invDirection.z;
+	float tz2 = (node.BoundsMax.z - origin.z) * invDirection.z;
+	tNear = std::max<float>(tNear, std::min<float>(tz1, tz2));
+	tFar = std::min<float>(tFar, std::max<float>(tz1, tz2));
+
+	tEntry = tNear;
+	return tFar >= tNear && tFar >= 0.0f && tNear < tMax;
+}
+
+template<typename LeafFunc>
+float Bvh::Intersect(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float tMax, LeafFunc&& leafFunc) const
+{
+	if (m_Nodes.empty())
+		return tMax;
+
+	DirectX::XMFLOAT3 o;
+	DirectX::XMFLOAT3 d;
+	DirectX::XMStoreFloat3(&o, origin);
+	DirectX::XMStoreFloat3(&d, direction);
+
+	// Division by zero gives an infinite slab, which the slab test handles.
+	DirectX::XMFLOAT3 invD(1.0f / d.x, 1.0f / d.y, 1.0f / d.z);
+
+	struct StackEntry
+	{
+		UINT NodeIndex;
+		float TEntry;
+	};
+	StackEntry stack[MaxDepth];
+	UINT stackSize = 0;
+
+	float tEntry = 0.0f;
+	if (!IntersectNode(m_Nodes[0], o, invD, tMax, tEntry))
+		return tMax;
+
+	UINT nodeIndex = 0;
+	for (;;)
+	{
+		const Node& node = m_Nodes[nodeIndex];
+
+		if (node.PrimitiveCount > 0)
+		{
+			for (UINT i = 0; i < node.PrimitiveCount; ++i)
+				tMax = leafFunc(node.LeftFirst + i, tMax);
+		}
+		else
+		{
+			UINT nearIndex = node.LeftFirst;
+			UINT farIndex = node.LeftFirst + 1;
+			float tNear = 0.0f;
+			float tFar = 0.0f;
+			bool hitNear = IntersectNode(m_Nodes[nearIndex], o, invD, tMax, tNear);
+			bool hitFar = IntersectNode(m_Nodes[farIndex], o, invD, tMax, tFar);
+
+			if (hitNear && hitFar)
+			{
+				// Descend into the closer child first and remember the other one.
+				if (tFar < tNear)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(tNear, tFar);
+				}
+				stack[stackSize++] = { farIndex, tFar };
+				nodeIndex = nearIndex;
+				continue;
+			}
+			if (hitNear)
+			{
+				nodeIndex = nearIndex;
+				continue;
+			}
+			if (hitFar)
+			{
+				nodeIndex = farIndex;
+				continue;
+			}
+		}
+
+		// Pop the next node that can still contain a closer hit.
+		bool found = false;
+		while (stackSize > 0)
+		{
+			StackEntry entry = stack[--stackSize];
+			if (entry.TEntry < tMax)
+			{
+				nodeIndex = entry.NodeIndex;
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+			break;
+	}
+
+	return tMax;
+}
@@ -119,28 +119,17 @@ namespace Graphics
 
 	void D3DClass::CreateRtvAndDsvAndSrvDescriptorHeaps()
 	{
-		D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-		rtvHeapDesc.NumDescriptors = swapChainBufferCount;
-		rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-		rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-		rtvHeapDesc.NodeMask = 0;
-		ThrowIfFailed(m_d3dDevice->CreateDescriptorHeap(
-			&rtvHeapDesc, IID_PPV_ARGS(m_RenderTargetViewHeap.GetAddressOf())));
-
-		D3D12_DESCRIPTOR_HEAP_DESC dsvHeapDesc = {};
-		dsvHeapDesc.NumDescriptors = 1;
-		dsvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_DSV;
-		dsvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
-		dsvHeapDesc.NodeMask = 0;
-		ThrowIfFailed(m_d3dDevice->CreateDescriptorHeap(
-			&dsvHeapDesc, IID_PPV_ARGS(m_DepthStencilViewHeap.GetAddressOf())));
-
-		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		srvHeapDesc.NumDescriptors = 1;
-		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		ThrowIfFailed(m_d3dDevice->CreateDescriptorHeap(
-			&srvHeapDesc, IID_PPV_ARGS(&m_ShaderResourceViewHeap)));
+		m_RenderTargetViewHeap = std::make_unique<DescriptorHeap>(m_d3dDevice.Get(),
+			D3D12_DESCRIPTOR_HEAP_TYPE_RTV, swapChainBufferCount, 0, false);
+		m_BackBufferRtvIndex = m_RenderTargetViewHeap->AllocatePersistent(swapChainBufferCount);
+
+		m_DepthStencilViewHeap = std::make_unique<DescriptorHeap>(m_d3dDevice.Get(),
+			D3D12_DESCRIPTOR_HEAP_TYPE_DSV, 1, 0, false);
+		m_DepthStencilDsvIndex = m_DepthStencilViewHeap->AllocatePersistent(1);
+
+		m_CbvSrvUavHeap = std::make_unique<DescriptorHeap>(m_d3dDevice.Get(),
+			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, PersistentDescriptorCount, TransientDescriptorCount, true);
+		m_ImguiSrvIndex = m_CbvSrvUavHeap->AllocatePersistent(1);
 	}
 
 	void D3DClass::OnResize()
@@ -168,13 +157,11 @@ namespace Graphics
 
 		m_CurrentBackBuffer = 0;
 
-		CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHeapHandle(
-			m_RenderTargetViewHeap->GetCPUDescriptorHandleForHeapStart());
 		for (UINT i = 0; i < swapChainBufferCount; i++)
 		{
 			ThrowIfFailed(m_SwapChain->GetBuffer(i, IID_PPV_ARGS(&m_SwapChainBuffer[i])));
-			m_d3dDevice->CreateRenderTargetView(m_SwapChainBuffer[i].Get(), nullptr, rtvHeapHandle);
-			rtvHeapHandle.Offset(1, m_RenderTargetViewDescriptorSize);
+			m_d3dDevice->CreateRenderTargetView(m_SwapChainBuffer[i].Get(), nullptr,
+				m_RenderTargetViewHeap->CpuHandle(m_BackBufferRtvIndex + i));
 		}
 
 		D3D12_RESOURCE_DESC depthStencilDesc = {};
@@ -237,7 +224,8 @@ namespace Graphics
 
 		m_ScissorRect = { 0, 0, m_ClientWidth, m_ClientHeight };
 
-		m_ImguiManager.Initialize(m_d3dDevice.Get(), m_BackBufferFormat, m_ShaderResourceViewHeap);
+		m_ImguiManager.Initialize(m_d3dDevice.Get(), m_BackBufferFormat, m_CbvSrvUavHeap->Heap(),
+			m_CbvSrvUavHeap->CpuHandle(m_ImguiSrvIndex), m_CbvSrvUavHeap->GpuHandle(m_ImguiSrvIndex));
 	}
 
 	void D3DClass::InitDirect3D()
@@ -271,13 +259,6 @@ namespace Graphics
 
 		ThrowIfFailed(m_d3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence)));
 
-		m_RenderTargetViewDescriptorSize = m_d3dDevice->GetDescriptorHandleIncrementSize(
-			D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-		m_DepthStencilViewDescriptorSize = m_d3dDevice->GetDescriptorHandleIncrementSize(
-			D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-		m_CbvSrvUavDescriptorSize = m_d3dDevice->GetDescriptorHandleIncrementSize(
-			D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
 		// Check 4X MSAA quality support for our back buffer format.
 		// All Direct3D 11 capable devices support 4X MSAA for all render 
 		// target formats, so we only need to check quality support.
@@ -386,15 +367,12 @@ namespace Graphics
 
 	D3D12_CPU_DESCRIPTOR_HANDLE D3DClass::CurrentBackBufferView() const
 	{
-		return CD3DX12_CPU_DESCRIPTOR_HANDLE(
-			m_RenderTargetViewHeap->GetCPUDescriptorHandleForHeapStart(),
-			m_CurrentBackBuffer,
-			m_RenderTargetViewDescriptorSize);
+		return m_RenderTargetViewHeap->CpuHandle(m_BackBufferRtvIndex + m_CurrentBackBuffer);
 	}
 
 	D3D12_CPU_DESCRIPTOR_HANDLE D3DClass::DepthStencilView() const
 	{
-		return m_DepthStencilViewHeap->GetCPUDescriptorHandleForHeapStart();
+		return m_DepthStencilViewHeap->CpuHandle(m_DepthStencilDsvIndex);
 	}
 
 	void D3DClass::LogAdapters()
@@ -6,6 +6,7 @@
 #endif
 
 #include "D3DUtils.h"
+#include "DescriptorHeap.h"
 #include "ImGui/ImguiManager.h"
 
 // Link necessary d3d12 libraries.
@@ -68,7 +69,7 @@ namespace Graphics
 		void LogAdapterOutputs(IDXGIAdapter* adapter);
 		void LogOutputDisplayModes(IDXGIOutput* output, DXGI_FORMAT format);
 
-		std::wstring CalculateFrameStats();
+		virtual std::wstring CalculateFrameStats();
 
 	protected:
 		ImguiManager m_ImguiManager;
@@ -84,7 +85,12 @@ namespace Graphics
 		D3D12_VIEWPORT m_ScreenViewport;
 		D3D12_RECT m_ScissorRect;
 
-		ID3D12DescriptorHeap* m_ShaderResourceViewHeap = NULL;
+		// Persistent descriptors live until freed, transient ones for a single frame.
+		static const UINT PersistentDescriptorCount = 2048;
+		static const UINT TransientDescriptorCount = 1024;
+
+		// The only shader visible heap, shared by the scene and ImGui.
+		std::unique_ptr<DescriptorHeap> m_CbvSrvUavHeap;
 
 		static const int swapChainBufferCount = 2;
 		int m_CurrentBackBuffer = 0;
@@ -114,11 +120,13 @@ namespace Graphics
 		Microsoft::WRL::ComPtr<ID3D12Resource> m_SwapChainBuffer[swapChainBufferCount];
 		Microsoft::WRL::ComPtr<ID3D12Resource> m_DepthStencilBuffer;
 
-		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_RenderTargetViewHeap;
-		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_DepthStencilViewHeap;
+		std::unique_ptr<DescriptorHeap> m_RenderTargetViewHeap;
+		std::unique_ptr<DescriptorHeap> m_DepthStencilViewHeap;
 
-		UINT m_RenderTargetViewDescriptorSize = 0;
-		UINT m_DepthStencilViewDescriptorSize = 0;
-		UINT m_CbvSrvUavDescriptorSize = 0;
+		// First of the swap chain's render target views, the depth stencil view and the
+		// ImGui font texture's view.
+		UINT m_BackBufferRtvIndex = 0;
+		UINT m_DepthStencilDsvIndex = 0;
+		UINT m_ImguiSrvIndex = 0;
 	};
 }
@@ -114,10 +114,7 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
     const std::string& entrypoint,
     const std::string& target)
 {
-    UINT compileFlags = 0;
-    #if defined(DEBUG) || defined(_DEBUG)  
-        compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-    #endif
+    UINT compileFlags = ShaderCompileFlags();
 
     HRESULT hr = S_OK;
 
@@ -134,3 +131,37 @@ ComPtr<ID3DBlob> d3dUtil::CompileShader(
     return byteCode;
 }
 
+UINT d3dUtil::ShaderCompileFlags()
+{
+    UINT compileFlags = 0;
+    #if defined(DEBUG) || defined(_DEBUG)  
+        compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    #endif
+
+    return compileFlags;
+}
+
+ShaderCache::Bytecode d3dUtil::CompileShader(const ShaderKey& key)
+{
+    assert(key.Flags == ShaderCompileFlags());
+
+    std::vector<D3D_SHADER_MACRO> defines;
+    for (const ShaderDefine& define : key.Defines)
+        defines.push_back({ define.Name.c_str(), define.Value.c_str() });
+    defines.push_back({ NULL, NULL });
+
+    ComPtr<ID3DBlob> byteCode = CompileShader(key.File.wstring(), defines.data(), key.EntryPoint, key.Target);
+
+    const uint8_t* bytes = (const uint8_t*)byteCode->GetBufferPointer();
+    return ShaderCache::Bytecode(bytes, bytes + byteCode->GetBufferSize());
+}
+
+ComPtr<ID3DBlob> d3dUtil::CreateBlob(const ShaderCache::Bytecode& bytecode)
+{
+    ComPtr<ID3DBlob> blob;
+    ThrowIfFailed(D3DCreateBlob(bytecode.size(), blob.GetAddressOf()));
+    memcpy(blob->GetBufferPointer(), bytecode.data(), bytecode.size());
+
+    return blob;
+}
+
@@ -27,6 +27,13 @@
 #include "MathHelper.h"
 #include "DXHelper.h"
 #include "DDSTextureLoader.h"
+#include "Bvh.h"
+#include "BoundingVolumes.h"
+#include "Common/ShaderCache.h"
+#include "Common/MeshSimplifier.h"
+#include "Common/VertexPacking.h"
+#include "Common/Meshlets.h"
+#include "SceneTypes.h"
 
 #define MaxLights 21
 
@@ -96,6 +103,14 @@ public:
         const D3D_SHADER_MACRO* defines,
         const std::string& entrypoint,
         const std::string& target);
+
+    // Flags CompileShader() passes to the compiler, part of every shader cache key.
+    static UINT ShaderCompileFlags();
+
+    // Compiles a shader cache miss.
+    static ShaderCache::Bytecode CompileShader(const ShaderKey& key);
+
+    static Microsoft::WRL::ComPtr<ID3DBlob> CreateBlob(const ShaderCache::Bytecode& bytecode);
 };
 
 class ENGINE_API DxException
@@ -112,21 +127,6 @@ public:
     int LineNumber = -1;
 };
 
-// Defines a subrange of geometry in a MeshGeometry.  This is for when multiple
-// geometries are stored in one vertex and index buffer.  It provides the offsets
-// and data needed to draw a subset of geometry stores in the vertex and index 
-// buffers so that we can implement the technique described by Figure 6.3.
-struct SubmeshGeometry
-{
-    UINT IndexCount = 0;
-    UINT StartIndexLocation = 0;
-    INT BaseVertexLocation = 0;
-
-    // Bounding box of the geometry defined by this submesh. 
-    // This is used in later chapters of the book.
-    DirectX::BoundingBox Bounds;
-};
-
 struct MeshGeometry
 {
     // Give it a name so we can look it up by name.
@@ -149,11 +149,18 @@ struct MeshGeometry
     DXGI_FORMAT IndexFormat = DXGI_FORMAT_R16_UINT;
     UINT IndexBufferByteSize = 0;
 
+    // Vertices are PackedVertex, in the GPU buffer and in the CPU copy, and are drawn with
+    // the packed pipelines.
+    bool PackedVertices = false;
+
     // A MeshGeometry may store multiple geometries in one vertex/index buffer.
     // Use this container to define the Submesh geometries so we can draw
     // the Submeshes individually.
     std::unordered_map<std::string, SubmeshGeometry> DrawArgs;
 
+    // Triangle BVH of each submesh in DrawArgs, built from the CPU copies for picking.
+    std::unordered_map<std::string, TriangleBvh> SubmeshBvhs;
+
     D3D12_VERTEX_BUFFER_VIEW VertexBufferView()const
     {
         D3D12_VERTEX_BUFFER_VIEW vbv = {};
@@ -200,35 +207,12 @@ struct MaterialConstants
 
     // Used in texture mapping.
     DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
-};
 
-// Simple struct to represent a material for our demos.  A production 3D engine
-// would likely create a class hierarchy of Materials.
-struct Material
-{
-    // Unique material name for lookup.
-    std::string Name;
-
-    // Index into constant buffer corresponding to this material.
-    int MatCBIndex = -1;
-
-    // Index into SRV heap for diffuse texture.
-    int DiffuseSrvHeapIndex = -1;
-
-    // Index into SRV heap for normal texture.
-    int NormalSrvHeapIndex = -1;
-
-    // Dirty flag indicating the material has changed and we need to update the constant buffer.
-    // Because we have a material constant buffer for each FrameResource, we have to apply the
-    // update to each FrameResource.  Thus, when we modify a material we should set 
-    // NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-    int NumFramesDirty = gNumFrameResources;
-
-    // Material constant buffer data used for shading.
-    DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
-    DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
-    float Roughness = 0.25f;
-    DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+    // Index of the diffuse texture in the texture table.
+    UINT DiffuseMapIndex = 0;
+    UINT MatPad0;
+    UINT MatPad1;
+    UINT MatPad2;
 };
 
 struct Texture
@@ -242,58 +226,6 @@ struct Texture
     Microsoft::WRL::ComPtr<ID3D12Resource> UploadHeap = nullptr;
 };
 
-struct RenderItem
-{
-    RenderItem() = default;
-
-    // World matrix of the shape that describes the object's local space
-    // relative to the world space, which defines the position, orientation,
-    // and scale of the object in the world.
-    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
-
-    DirectX::XMFLOAT3 WorldScaling = { 1.0f, 1.0f, 1.0f };
-    DirectX::XMFLOAT3 WorldRotation = { 0.0f, 0.0f, 0.0f };
-    DirectX::XMFLOAT3 WorldTranslation = { 0.0f, 0.0f, 0.0f };
-
-    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-
-    DirectX::BoundingBox Bounds;
-    bool FrustumTest = true;
-    bool FrustumTestResult = true;
-
-    bool IsVisible = true;
-
-    bool DoPicking = false;
-    bool IsPicked = false;
-
-    // Dirty flag indicating the object data has changed and we need to update the constant buffer.
-    // Because we have an object cbuffer for each FrameResource, we have to apply the
-    // update to each FrameResource.  Thus, when we modify obect data we should set 
-    // NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-    int NumFramesDirty = gNumFrameResources;
-
-    // Index into GPU constant buffer corresponding to the ObjectCB for this render item.
-    UINT ObjConstantBufferIndex = -1;
-
-    Material* Mat = nullptr;
-    MeshGeometry* Geo = nullptr;
-
-    // Primitive topology.
-    D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-
-    // DrawIndexedInstanced parameters.
-    UINT IndexCount = 0;
-    UINT StartIndexLocation = 0;
-    int BaseVertexLocation = 0;
-
-    std::string GeoName;
-    std::string GeoShapeName;
-
-    RenderItem* ShadowSource = nullptr;
-    UINT ShadowIndex = 0;
-    RenderItem* ReflectionSource = nullptr;
-};
-
 enum class RenderLayer : int
 {
     Opaque = 0,
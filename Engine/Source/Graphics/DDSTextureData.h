@@ -0,0 +1,97 @@
+#pragma once
+
+// CPU phase of DDS texture loading: header validation, surface sizes and the layout of
+// the subresources in the file.  Needs no Direct3D header, CreateDDSTextureFromData12 in
+// DDSTextureLoader.h creates the texture from the result.
+
+#include "DDS.h"
+#include "MappedFile.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace DirectX
+{
+    enum DDS_ALPHA_MODE
+    {
+        DDS_ALPHA_MODE_UNKNOWN = 0,
+        DDS_ALPHA_MODE_STRAIGHT = 1,
+        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
+        DDS_ALPHA_MODE_OPAQUE = 3,
+        DDS_ALPHA_MODE_CUSTOM = 4,
+    };
+
+    // Bits and pitches of one subresource, with the members of D3D12_SUBRESOURCE_DATA.
+    struct DDSSubresource
+    {
+        const void* pData = nullptr;
+        std::intptr_t RowPitch = 0;
+        std::intptr_t SlicePitch = 0;
+    };
+
+    // Texture read and validated on the CPU, ready to be created on the GPU.
+    struct DDSTextureData
+    {
+        // Mapping of the file, the subresources point into it.  Empty when the data was
+        // given in memory.
+        std::unique_ptr<MappedFile> File;
+
+        // A DDS_RESOURCE_DIMENSION, which has the values of D3D12_RESOURCE_DIMENSION.
+        uint32_t ResourceDimension = 0;
+        size_t Width = 0;
+        size_t Height = 0;
+        size_t Depth = 0;
+        size_t MipCount = 0;
+        size_t ArraySize = 0;
+        DXGI_FORMAT Format = DXGI_FORMAT_UNKNOWN;
+        bool IsCubeMap = false;
+        DDS_ALPHA_MODE AlphaMode = DDS_ALPHA_MODE_UNKNOWN;
+
+        // Pitches of every subresource.
+        std::vector<DDSSubresource> Subresources;
+    };
+
+    // Checks the magic number and headers of a DDS file in memory and finds the bit data.
+    HRESULT ValidateDDSData(const uint8_t* ddsData,
+        size_t ddsDataSize,
+        const DDS_HEADER** header,
+        const uint8_t** bitData,
+        size_t* bitSize
+    );
+
+    // Bits per pixel of a format, 0 for the formats a DDS file cannot hold.
+    size_t BitsPerPixel(DXGI_FORMAT fmt);
+
+    // Bytes of a surface, of one row and the number of rows.  Rows of block compressed
+    // formats are rows of 4x4 blocks.
+    void GetSurfaceInfo(size_t width,
+        size_t height,
+        DXGI_FORMAT fmt,
+        size_t* outNumBytes,
+        size_t* outRowBytes,
+        size_t* outNumRows
+    );
+
+    // Format of a pixel format without the DX10 header, DXGI_FORMAT_UNKNOWN if there is none.
+    DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf);
+
+    DDS_ALPHA_MODE GetAlphaMode(const DDS_HEADER* header);
+
+    // Validates a DDS file in memory and lays out its subresources, skipping the mips
+    // larger than maxsize.  The subresources point into ddsData, textureData.File is left
+    // as it is.
+    HRESULT GetDDSTextureData(const uint8_t* ddsData,
+        size_t ddsDataSize,
+        DDSTextureData& textureData,
+        size_t maxsize = 0
+    );
+
+    // CPU phase of CreateDDSTextureFromFile12: maps the file, validates the headers and
+    // lays out the subresources.  Needs no device, so files can be loaded on any thread.
+    HRESULT LoadDDSTextureData(const wchar_t* szFileName,
+        DDSTextureData& textureData,
+        size_t maxsize = 0
+    );
+}
@@ -3,6 +3,7 @@
 #include <wrl.h>
 #include <d3d11_1.h>
 #include "d3dx12.h"
+#include "DDSTextureData.h"
 
 #pragma warning(push)
 #pragma warning(disable : 4005)
@@ -10,6 +11,9 @@
 
 #pragma warning(pop)
 
+#include <memory>
+#include <vector>
+
 #if defined(_MSC_VER) && (_MSC_VER<1610) && !defined(_In_reads_)
 #define _In_reads_(exp)
 #define _Out_writes_(exp)
@@ -24,15 +28,6 @@
 
 namespace DirectX
 {
-    enum DDS_ALPHA_MODE
-    {
-        DDS_ALPHA_MODE_UNKNOWN = 0,
-        DDS_ALPHA_MODE_STRAIGHT = 1,
-        DDS_ALPHA_MODE_PREMULTIPLIED = 2,
-        DDS_ALPHA_MODE_OPAQUE = 3,
-        DDS_ALPHA_MODE_CUSTOM = 4,
-    };
-
     // Standard version
     HRESULT CreateDDSTextureFromMemory(_In_ ID3D11Device* d3dDevice,
         _In_reads_bytes_(ddsDataSize) const uint8_t* ddsData,
@@ -70,6 +65,16 @@ namespace DirectX
         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr
     );
 
+    // GPU phase of CreateDDSTextureFromFile12, after LoadDDSTextureData in DDSTextureData.h:
+    // creates the texture and records the upload of its subresources.  The
+    // subresources are copied into the upload heap before it returns.
+    HRESULT CreateDDSTextureFromData12(_In_ ID3D12Device* device,
+        _In_ ID3D12GraphicsCommandList* cmdList,
+        _In_ const DDSTextureData& textureData,
+        _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& texture,
+        _Out_ Microsoft::WRL::ComPtr<ID3D12Resource>& textureUploadHeap
+    );
+
     // Standard version with optional auto-gen mipmap support
     HRESULT CreateDDSTextureFromMemory(_In_ ID3D11Device* d3dDevice,
         _In_opt_ ID3D11DeviceContext* d3dContext,
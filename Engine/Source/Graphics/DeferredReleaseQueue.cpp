@@ -0,0 +1,48 @@
+#include "Engine.h"
+#include "DeferredReleaseQueue.h"
+
+void DeferredReleaseQueue::Release(UINT64 fence, Microsoft::WRL::ComPtr<ID3D12Resource>&& resource)
+{
+	if (resource == nullptr)
+		return;
+
+	assert(m_Entries.empty() || m_Entries.back().Fence <= fence);
+
+	// Size of the heap memory behind the resource, textures are padded and aligned.
+	Microsoft::WRL::ComPtr<ID3D12Device> device;
+	ThrowIfFailed(resource->GetDevice(IID_PPV_ARGS(&device)));
+	D3D12_RESOURCE_DESC desc = resource->GetDesc();
+	UINT64 byteSize = device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes;
+
+	m_Entries.push_back({ fence, byteSize, std::move(resource) });
+	m_PendingBytes += byteSize;
+}
+
+UINT64 DeferredReleaseQueue::Drain(UINT64 completedFence)
+{
+	UINT64 reclaimed = 0;
+	while (!m_Entries.empty() && m_Entries.front().Fence <= completedFence)
+	{
+		reclaimed += m_Entries.front().ByteSize;
+		m_Entries.pop_front();
+	}
+
+	m_PendingBytes -= reclaimed;
+	m_ReclaimedBytes += reclaimed;
+	return reclaimed;
+}
+
+UINT64 DeferredReleaseQueue::PendingBytes() const
+{
+	return m_PendingBytes;
+}
+
+UINT64 DeferredReleaseQueue::ReclaimedBytes() const
+{
+	return m_ReclaimedBytes;
+}
+
+UINT DeferredReleaseQueue::PendingCount() const
+{
+	return (UINT)m_Entries.size();
+}
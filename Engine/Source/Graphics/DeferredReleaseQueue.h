@@ -0,0 +1,41 @@
+#pragma once
+
+#include "D3DUtils.h"
+
+#include <deque>
+
+// Keeps retired resources alive until the GPU has passed the fence of the last commands
+// that may use them.  Fences are queued in increasing order, so draining stops at the first
+// one that is not complete.
+class ENGINE_API DeferredReleaseQueue
+{
+public:
+	DeferredReleaseQueue() = default;
+	DeferredReleaseQueue(const DeferredReleaseQueue& rhs) = delete;
+	DeferredReleaseQueue& operator=(const DeferredReleaseQueue& rhs) = delete;
+	~DeferredReleaseQueue() = default;
+
+	// Takes the reference of resource and drops it once fence is complete.  Null resources
+	// are ignored.
+	void Release(UINT64 fence, Microsoft::WRL::ComPtr<ID3D12Resource>&& resource);
+
+	// Releases the resources whose fence is at most completedFence and returns their bytes.
+	UINT64 Drain(UINT64 completedFence);
+
+	// Bytes waiting for their fence and bytes released since creation.
+	UINT64 PendingBytes() const;
+	UINT64 ReclaimedBytes() const;
+	UINT PendingCount() const;
+
+private:
+	struct Entry
+	{
+		UINT64 Fence;
+		UINT64 ByteSize;
+		Microsoft::WRL::ComPtr<ID3D12Resource> Resource;
+	};
+
+	std::deque<Entry> m_Entries;
+	UINT64 m_PendingBytes = 0;
+	UINT64 m_ReclaimedBytes = 0;
+};
@@ -0,0 +1,76 @@
+#include "Engine.h"
+#include "DescriptorHeap.h"
+
+DescriptorHeap::DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+	UINT persistentCount, UINT transientCount, bool shaderVisible) :
+	m_ShaderVisible(shaderVisible),
+	m_Persistent(persistentCount),
+	m_Transient(transientCount)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC heapDesc = {};
+	heapDesc.NumDescriptors = persistentCount + transientCount;
+	heapDesc.Type = type;
+	heapDesc.Flags = shaderVisible ? D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE : D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+	heapDesc.NodeMask = 0;
+	ThrowIfFailed(device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&m_Heap)));
+
+	m_DescriptorSize = device->GetDescriptorHandleIncrementSize(type);
+}
+
+UINT DescriptorHeap::AllocatePersistent(UINT count)
+{
+	UINT offset = m_Persistent.Allocate(count);
+	if (offset == DescriptorAllocator::InvalidOffset)
+		ThrowIfFailed(E_OUTOFMEMORY);
+	return offset;
+}
+
+void DescriptorHeap::FreePersistent(UINT index, UINT count)
+{
+	m_Persistent.Free(index, count);
+}
+
+UINT DescriptorHeap::AllocateTransient(UINT count)
+{
+	// The transient region follows the persistent one.
+	UINT offset = m_Transient.Allocate(count);
+	if (offset == TransientDescriptorRing::InvalidOffset)
+		ThrowIfFailed(E_OUTOFMEMORY);
+	return m_Persistent.Capacity() + offset;
+}
+
+void DescriptorHeap::EndFrame(UINT64 fence)
+{
+	m_Transient.EndFrame(fence);
+}
+
+void DescriptorHeap::Retire(UINT64 completedFence)
+{
+	m_Transient.Retire(completedFence);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorHeap::CpuHandle(UINT index) const
+{
+	return CD3DX12_CPU_DESCRIPTOR_HANDLE(m_Heap->GetCPUDescriptorHandleForHeapStart(), index, m_DescriptorSize);
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE DescriptorHeap::GpuHandle(UINT index) const
+{
+	assert(m_ShaderVisible);
+	return CD3DX12_GPU_DESCRIPTOR_HANDLE(m_Heap->GetGPUDescriptorHandleForHeapStart(), index, m_DescriptorSize);
+}
+
+ID3D12DescriptorHeap* DescriptorHeap::Heap() const
+{
+	return m_Heap.Get();
+}
+
+UINT DescriptorHeap::PersistentCount() const
+{
+	return m_Persistent.AllocatedCount();
+}
+
+UINT DescriptorHeap::TransientCount() const
+{
+	return m_Transient.UsedCount();
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "D3DUtils.h"
+#include "Common/DescriptorAllocator.h"
+
+// One D3D12 descriptor heap split in two regions.  The persistent region holds descriptors
+// that live until they are freed, the transient region the ones of a single frame, reused
+// once the frame's fence is complete.  Indices are counted from the start of the heap.
+class ENGINE_API DescriptorHeap
+{
+public:
+	DescriptorHeap(ID3D12Device* device, D3D12_DESCRIPTOR_HEAP_TYPE type,
+		UINT persistentCount, UINT transientCount, bool shaderVisible);
+	DescriptorHeap(const DescriptorHeap& rhs) = delete;
+	DescriptorHeap& operator=(const DescriptorHeap& rhs) = delete;
+	~DescriptorHeap() = default;
+
+	// Each returns the index of the first of count contiguous descriptors.  Running out of
+	// descriptors is fatal.
+	UINT AllocatePersistent(UINT count);
+	void FreePersistent(UINT index, UINT count);
+	// Thread safe, for use while recording the frame's commands.
+	UINT AllocateTransient(UINT count);
+
+	// Tags the transient descriptors of the frame with its fence, after the frame has been
+	// recorded.
+	void EndFrame(UINT64 fence);
+	// Frees the transient descriptors of the completed frames.
+	void Retire(UINT64 completedFence);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE CpuHandle(UINT index) const;
+	// Only for shader visible heaps.
+	D3D12_GPU_DESCRIPTOR_HANDLE GpuHandle(UINT index) const;
+
+	ID3D12DescriptorHeap* Heap() const;
+
+	UINT PersistentCount() const;
+	UINT TransientCount() const;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> m_Heap;
+	UINT m_DescriptorSize = 0;
+	bool m_ShaderVisible = false;
+
+	DescriptorAllocator m_Persistent;
+	TransientDescriptorRing m_Transient;
+};
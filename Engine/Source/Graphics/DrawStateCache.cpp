@@ -0,0 +1,60 @@
+#include "Engine.h"
+#include "DrawStateCache.h"
+
+void DrawStateCache::Reset()
+{
+	m_PipelineState = nullptr;
+	m_Geo = nullptr;
+	m_Submesh = nullptr;
+	m_PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+	m_StateChanges = 0;
+	m_SkippedStateChanges = 0;
+}
+
+bool DrawStateCache::SetPipelineState(ID3D12PipelineState* pipelineState)
+{
+	bool changed = pipelineState != m_PipelineState;
+	m_PipelineState = pipelineState;
+	return Track(changed);
+}
+
+bool DrawStateCache::SetGeometry(const MeshGeometry* geo)
+{
+	bool changed = geo != m_Geo;
+	m_Geo = geo;
+	return Track(changed);
+}
+
+bool DrawStateCache::SetSubmesh(const SubmeshGeometry* submesh)
+{
+	bool changed = submesh != m_Submesh;
+	m_Submesh = submesh;
+	return Track(changed);
+}
+
+bool DrawStateCache::SetPrimitiveType(D3D12_PRIMITIVE_TOPOLOGY primitiveType)
+{
+	bool changed = primitiveType != m_PrimitiveType;
+	m_PrimitiveType = primitiveType;
+	return Track(changed);
+}
+
+UINT DrawStateCache::StateChanges() const
+{
+	return m_StateChanges;
+}
+
+UINT DrawStateCache::SkippedStateChanges() const
+{
+	return m_SkippedStateChanges;
+}
+
+bool DrawStateCache::Track(bool changed)
+{
+	if (changed)
+		m_StateChanges++;
+	else
+		m_SkippedStateChanges++;
+	return changed;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "SceneTypes.h"
+
+// Remembers the state the draw loop has bound on a command list, so state that is already
+// set is not set again.  Only compares values and addresses, the caller records the
+// commands, so the cache never needs the Direct3D definitions of what it tracks.
+class ENGINE_API DrawStateCache
+{
+public:
+	DrawStateCache() = default;
+	DrawStateCache(const DrawStateCache& rhs) = delete;
+	DrawStateCache& operator=(const DrawStateCache& rhs) = delete;
+	~DrawStateCache() = default;
+
+	// Forgets the bound state, for a new command list or a new root signature.  Also
+	// restarts the counters.
+	void Reset();
+
+	// Each returns true when the value differs from the bound one and has to be set.
+	bool SetPipelineState(ID3D12PipelineState* pipelineState);
+	bool SetGeometry(const MeshGeometry* geo);
+	// The submesh whose position quantization is in the per-draw constants.
+	bool SetSubmesh(const SubmeshGeometry* submesh);
+	bool SetPrimitiveType(D3D12_PRIMITIVE_TOPOLOGY primitiveType);
+
+	// Set calls that returned true and false since the last Reset().
+	UINT StateChanges() const;
+	UINT SkippedStateChanges() const;
+
+private:
+	bool Track(bool changed);
+
+private:
+	ID3D12PipelineState* m_PipelineState = nullptr;
+	const MeshGeometry* m_Geo = nullptr;
+	const SubmeshGeometry* m_Submesh = nullptr;
+	D3D12_PRIMITIVE_TOPOLOGY m_PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
+
+	UINT m_StateChanges = 0;
+	UINT m_SkippedStateChanges = 0;
+};
@@ -1,7 +1,7 @@
 #include "Engine.h"
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT instanceCount)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -9,9 +9,16 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 
     //  FrameCB = std::make_unique<UploadBuffer<FrameConstants>>(device, 1, true);
     PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-    MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
-    ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
-    InstanceBuffer = std::make_unique<UploadBuffer<InstanceData>>(device, 1, false);
+    MaterialBuffer = std::make_unique<GrowableUploadBuffer<MaterialConstants>>(device, materialCount, false);
+    InstanceBuffer = std::make_unique<GrowableUploadBuffer<InstanceData>>(device, objectCount, false);
+    InstanceIndexBuffer = std::make_unique<GrowableUploadBuffer<UINT>>(device, instanceCount, false);
+}
+
+void FrameResource::Reserve(ID3D12Device* device, UINT objectCount, UINT materialCount, UINT instanceCount)
+{
+    MaterialBuffer->Reserve(device, materialCount);
+    InstanceBuffer->Reserve(device, objectCount);
+    InstanceIndexBuffer->Reserve(device, instanceCount);
 }
 
 FrameResource::~FrameResource()
@@ -1,9 +1,12 @@
 #pragma once
 
 #include "D3DUtils.h"
+#include "RenderItemStore.h"
 #include "MathHelper.h"
 #include "UploadBuffer.h"
+#include "Vertex.h"
 
+// Per-item data read by the shaders through the item's ObjConstantBufferIndex.
 struct InstanceData
 {
     DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
@@ -14,12 +17,6 @@ struct InstanceData
     UINT InstancePad2;
 };
 
-struct ObjectConstants
-{
-    DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
-    DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
-};
-
 struct PassConstants
 {
     DirectX::XMFLOAT4X4 View = MathHelper::Identity4x4();
@@ -51,28 +48,19 @@ struct PassConstants
     Light Lights[MaxLights];
 };
 
-struct Vertex
-{
-    Vertex() = default;
-    Vertex(float x, float y, float z, float nx, float ny, float nz, float u, float v) :
-        Pos(x, y, z),
-        Normal(nx, ny, nz),
-        TexC(u, v) {}
-
-    DirectX::XMFLOAT3 Pos;
-    DirectX::XMFLOAT3 Normal;
-    DirectX::XMFLOAT2 TexC;
-};
-
 // Stores the resources needed for the CPU to build the command lists
 // for a frame.  
 struct FrameResource
 {
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT instanceCount);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
 
+    // Grows the buffers to hold the given number of elements.  Existing elements keep
+    // their index and contents.  Only call while the GPU is not using this frame resource.
+    void Reserve(ID3D12Device* device, UINT objectCount, UINT materialCount, UINT instanceCount);
+
     // We cannot reset the allocator until the GPU is done processing the commands.
     // So each frame needs their own allocator.
     Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
@@ -81,10 +69,17 @@ struct FrameResource
     // that reference it.  So each frame needs their own cbuffers.
    // std::unique_ptr<UploadBuffer<FrameConstants>> FrameCB = nullptr;
     std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-    std::unique_ptr<UploadBuffer<MaterialConstants>> MaterialCB = nullptr;
-    std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+    std::unique_ptr<GrowableUploadBuffer<MaterialConstants>> MaterialBuffer = nullptr;
+    std::unique_ptr<GrowableUploadBuffer<InstanceData>> InstanceBuffer = nullptr;
+
+    // Instances of this frame's draws, indices into InstanceBuffer grouped by batch.
+    // Rewritten every frame from the visible items.
+    std::unique_ptr<GrowableUploadBuffer<UINT>> InstanceIndexBuffer = nullptr;
 
-    std::unique_ptr<UploadBuffer<InstanceData>> InstanceBuffer = nullptr;
+    // Items and materials whose constants changed since this frame resource was last
+    // updated.  Drained by the constant buffer updates, so a static scene writes nothing.
+    std::vector<RenderItemHandle> DirtyRenderItems;
+    std::vector<Material*> DirtyMaterials;
 
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
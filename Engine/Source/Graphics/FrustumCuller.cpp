@@ -0,0 +1,264 @@
+#include "Engine.h"
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace DirectX;
+
+void FrustumCuller::Resize(UINT itemCount)
+{
+	m_ItemCount = itemCount;
+
+	// Round up to whole SIMD vectors.
+	size_t paddedCount = (itemCount + 3) & ~3u;
+
+	m_CenterX.resize(paddedCount, 0.0f);
+	m_CenterY.resize(paddedCount, 0.0f);
+	m_CenterZ.resize(paddedCount, 0.0f);
+	for (int k = 0; k < 3; ++k)
+	{
+		m_AxisX[k].resize(paddedCount, 0.0f);
+		m_AxisY[k].resize(paddedCount, 0.0f);
+		m_AxisZ[k].resize(paddedCount, 0.0f);
+	}
+	m_SphereX.resize(paddedCount, 0.0f);
+	m_SphereY.resize(paddedCount, 0.0f);
+	m_SphereZ.resize(paddedCount, 0.0f);
+	m_SphereRadius.resize(paddedCount, 0.0f);
+	m_AlwaysVisible.resize(paddedCount, 0);
+}
+
+UINT FrustumCuller::ItemCount() const
+{
+	return m_ItemCount;
+}
+
+void FrustumCuller::UpdateBounds(UINT index, const BoundingVolumes& localBounds, const XMFLOAT4X4& world)
+{
+	XMMATRIX W = XMLoadFloat4x4(&world);
+	const BoundingOrientedBox& box = localBounds.OrientedBox;
+	const BoundingSphere& sphere = localBounds.Sphere;
+
+	XMVECTOR worldCenter;
+	XMVECTOR worldAxes[3];
+	XMVECTOR worldSphereCenter;
+	float worldSphereRadius;
+
+	if (world._14 == 0.0f && world._24 == 0.0f && world._34 == 0.0f && world._44 == 1.0f)
+	{
+		// Affine transform: the box stays a box, its axes scaled by the extents are
+		// transformed as directions.
+		XMMATRIX R = XMMatrixRotationQuaternion(XMLoadFloat4(&box.Orientation));
+		XMVECTOR extents = XMLoadFloat3(&box.Extents);
+
+		worldCenter = XMVector3Transform(XMLoadFloat3(&box.Center), W);
+		worldAxes[0] = XMVector3TransformNormal(XMVectorScale(R.r[0], XMVectorGetX(extents)), W);
+		worldAxes[1] = XMVector3TransformNormal(XMVectorScale(R.r[1], XMVectorGetY(extents)), W);
+		worldAxes[2] = XMVector3TransformNormal(XMVectorScale(R.r[2], XMVectorGetZ(extents)), W);
+
+		// The sphere radius grows by the largest singular value of the matrix, bounded by
+		// the largest absolute row sum of W * W^T.  The bound is exact without shear.
+		XMVECTOR r0 = W.r[0], r1 = W.r[1], r2 = W.r[2];
+		float g00 = XMVectorGetX(XMVector3Dot(r0, r0));
+		float g11 = XMVectorGetX(XMVector3Dot(r1, r1));
+		float g22 = XMVectorGetX(XMVector3Dot(r2, r2));
+		float g01 = std::abs(XMVectorGetX(XMVector3Dot(r0, r1)));
+		float g02 = std::abs(XMVectorGetX(XMVector3Dot(r0, r2)));
+		float g12 = std::abs(XMVectorGetX(XMVector3Dot(r1, r2)));
+		float maxScaleSq = std::max<float>(g00 + g01 + g02, std::max<float>(g01 + g11 + g12, g02 + g12 + g22));
+
+		worldSphereCenter = XMVector3Transform(XMLoadFloat3(&sphere.Center), W);
+		worldSphereRadius = sphere.Radius * std::sqrt(maxScaleSq);
+	}
+	else
+	{
+		// Projective transform (e.g. planar shadows): transform the corners with the
+		// homogeneous divide and fit an axis-aligned box and its sphere around them.
+		XMFLOAT3 corners[BoundingOrientedBox::CORNER_COUNT];
+		box.GetCorners(corners);
+
+		XMVECTOR vMin = XMVectorReplicate(+MathHelper::Infinity);
+		XMVECTOR vMax = XMVectorReplicate(-MathHelper::Infinity);
+		for (size_t i = 0; i < BoundingOrientedBox::CORNER_COUNT; ++i)
+		{
+			XMVECTOR P = XMVector3TransformCoord(XMLoadFloat3(&corners[i]), W);
+			vMin = XMVectorMin(vMin, P);
+			vMax = XMVectorMax(vMax, P);
+		}
+
+		worldCenter = 0.5f * (vMin + vMax);
+		XMVECTOR worldExtents = 0.5f * (vMax - vMin);
+		worldAxes[0] = XMVectorAndInt(worldExtents, g_XMMaskX);
+		worldAxes[1] = XMVectorAndInt(worldExtents, g_XMMaskY);
+		worldAxes[2] = XMVectorAndInt(worldExtents, g_XMMaskZ);
+
+		worldSphereCenter = worldCenter;
+		worldSphereRadius = XMVectorGetX(XMVector3Length(worldExtents));
+	}
+
+	XMFLOAT3 c;
+	XMStoreFloat3(&c, worldCenter);
+	m_CenterX[index] = c.x;
+	m_CenterY[index] = c.y;
+	m_CenterZ[index] = c.z;
+
+	for (int k = 0; k < 3; ++k)
+	{
+		XMFLOAT3 axis;
+		XMStoreFloat3(&axis, worldAxes[k]);
+		m_AxisX[k][index] = axis.x;
+		m_AxisY[k][index] = axis.y;
+		m_AxisZ[k][index] = axis.z;
+	}
+
+	XMStoreFloat3(&c, worldSphereCenter);
+	m_SphereX[index] = c.x;
+	m_SphereY[index] = c.y;
+	m_SphereZ[index] = c.z;
+	m_SphereRadius[index] = worldSphereRadius;
+}
+
+void FrustumCuller::SetAlwaysVisible(UINT index, bool alwaysVisible)
+{
+	m_AlwaysVisible[index] = alwaysVisible ? 0xFFFFFFFF : 0;
+}
+
+void FrustumCuller::Cull(const BoundingFrustum& worldFrustum)
+{
+	// Plane normals point out of the frustum, so a point p is outside when dot(plane, p) > 0.
+	XMVECTOR planes[6];
+	worldFrustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+	m_VisibleIndices.clear();
+
+	JobSystem* jobSystem = JobSystem::Instance();
+	UINT taskCount = jobSystem != nullptr ?
+		std::min<UINT>(jobSystem->ThreadCount(), m_ItemCount / MinItemsPerTask) : 1;
+
+	if (taskCount <= 1)
+	{
+		CullRange(planes, 0, m_ItemCount, m_VisibleIndices);
+		return;
+	}
+
+	// Split the items into one contiguous, vector aligned range per task.  Every task
+	// collects its visible items separately and the lists are joined in order.
+	UINT itemsPerTask = ((m_ItemCount + taskCount - 1) / taskCount + 3) & ~3u;
+
+	m_TaskVisibleIndices.resize(taskCount);
+	for (auto& visible : m_TaskVisibleIndices)
+		visible.clear();
+
+	jobSystem->ParallelFor(m_ItemCount, itemsPerTask, [this, &planes, itemsPerTask](UINT begin, UINT end)
+		{
+			CullRange(planes, begin, end, m_TaskVisibleIndices[begin / itemsPerTask]);
+		});
+
+	for (const auto& visible : m_TaskVisibleIndices)
+		m_VisibleIndices.insert(m_VisibleIndices.end(), visible.begin(), visible.end());
+}
+
+void FrustumCuller::SetAllVisible()
+{
+	m_VisibleIndices.resize(m_ItemCount);
+	for (UINT i = 0; i < m_ItemCount; ++i)
+		m_VisibleIndices[i] = i;
+}
+
+const std::vector<UINT>& FrustumCuller::VisibleIndices() const
+{
+	return m_VisibleIndices;
+}
+
+BoundingSphere FrustumCuller::WorldSphere(UINT index) const
+{
+	assert(index < m_ItemCount);
+
+	BoundingSphere sphere;
+	sphere.Center = XMFLOAT3(m_SphereX[index], m_SphereY[index], m_SphereZ[index]);
+	sphere.Radius = m_SphereRadius[index];
+	return sphere;
+}
+
+void FrustumCuller::CullRange(const XMVECTOR* planes, UINT begin, UINT end, std::vector<UINT>& visible) const
+{
+	// Splat the plane components once so the inner loop is pure multiply-adds.
+	XMVECTOR planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = XMVectorSplatX(planes[p]);
+		planeY[p] = XMVectorSplatY(planes[p]);
+		planeZ[p] = XMVectorSplatZ(planes[p]);
+		planeW[p] = XMVectorSplatW(planes[p]);
+	}
+
+	// Test four items per iteration.
+	for (UINT i = begin; i < end; i += 4)
+	{
+		XMVECTOR cx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_CenterX[i]));
+		XMVECTOR cy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_CenterY[i]));
+		XMVECTOR cz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_CenterZ[i]));
+		XMVECTOR ax[3], ay[3], az[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			ax[k] = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_AxisX[k][i]));
+			ay[k] = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_AxisY[k][i]));
+			az[k] = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_AxisZ[k][i]));
+		}
+		XMVECTOR sx = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_SphereX[i]));
+		XMVECTOR sy = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_SphereY[i]));
+		XMVECTOR sz = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_SphereZ[i]));
+		XMVECTOR sr = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(&m_SphereRadius[i]));
+
+		XMVECTOR outside = XMVectorFalseInt();
+		for (int p = 0; p < 6; ++p)
+		{
+			// Signed distance of the box center to the plane.
+			XMVECTOR distance = XMVectorMultiplyAdd(cx, planeX[p], planeW[p]);
+			distance = XMVectorMultiplyAdd(cy, planeY[p], distance);
+			distance = XMVectorMultiplyAdd(cz, planeZ[p], distance);
+
+			// Projected radius of the box onto the plane normal.
+			XMVECTOR radius = XMVectorZero();
+			for (int k = 0; k < 3; ++k)
+			{
+				XMVECTOR projection = XMVectorMultiply(ax[k], planeX[p]);
+				projection = XMVectorMultiplyAdd(ay[k], planeY[p], projection);
+				projection = XMVectorMultiplyAdd(az[k], planeZ[p], projection);
+				radius = XMVectorAdd(radius, XMVectorAbs(projection));
+			}
+
+			// Signed distance of the sphere center to the plane.
+			XMVECTOR sphereDistance = XMVectorMultiplyAdd(sx, planeX[p], planeW[p]);
+			sphereDistance = XMVectorMultiplyAdd(sy, planeY[p], sphereDistance);
+			sphereDistance = XMVectorMultiplyAdd(sz, planeZ[p], sphereDistance);
+
+			// The item is completely outside if either volume is in front of any plane.
+			outside = XMVectorOrInt(outside, XMVectorGreater(distance, radius));
+			outside = XMVectorOrInt(outside, XMVectorGreater(sphereDistance, sr));
+		}
+
+		XMVECTOR alwaysVisible = XMLoadInt4(&m_AlwaysVisible[i]);
+		XMVECTOR isVisible = XMVectorOrInt(XMVectorAndCInt(XMVectorTrueInt(), outside), alwaysVisible);
+
+#if defined(_XM_SSE_INTRINSICS_)
+		int mask = _mm_movemask_ps(isVisible);
+#else
+		std::uint32_t lanes[4];
+		XMStoreInt4(lanes, isVisible);
+		int mask = (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+#endif
+
+		if (mask == 0)
+			continue;
+
+		// Padding lanes past the last item are never reported.
+		UINT laneCount = std::min<UINT>(4, end - i);
+		for (UINT lane = 0; lane < laneCount; ++lane)
+		{
+			if (mask & (1 << lane))
+				visible.push_back(i + lane);
+		}
+	}
+}
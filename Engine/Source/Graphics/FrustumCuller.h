@@ -0,0 +1,72 @@
+#pragma once
+
+#include "BoundingVolumes.h"
+#include "MathHelper.h"
+
+#include <vector>
+
+// Culls render item bounds against the camera frustum.  World-space oriented boxes and
+// spheres are stored as a structure of arrays so that one SIMD instruction tests four
+// items against a frustum plane, and large item counts are split across the job system
+// threads.  The result is a compact list of visible item indices.
+class ENGINE_API FrustumCuller
+{
+public:
+	FrustumCuller() = default;
+	FrustumCuller(const FrustumCuller& rhs) = delete;
+	FrustumCuller& operator=(const FrustumCuller& rhs) = delete;
+	~FrustumCuller() = default;
+
+	// Grows or shrinks the bounds arrays to hold itemCount items.  New items start
+	// with empty bounds, so they must be given bounds before the next Cull().
+	void Resize(UINT itemCount);
+	UINT ItemCount() const;
+
+	// Transforms the local space oriented box and sphere by the world matrix and stores
+	// them.  Only needs to be called when the world matrix or bounds change.
+	void UpdateBounds(UINT index, const BoundingVolumes& localBounds, const DirectX::XMFLOAT4X4& world);
+
+	// Items that skip the frustum test are always reported as visible.
+	void SetAlwaysVisible(UINT index, bool alwaysVisible);
+
+	// Tests every item against the world space frustum and rebuilds the visible index list.
+	void Cull(const DirectX::BoundingFrustum& worldFrustum);
+
+	// Reports every item as visible (frustum culling disabled).
+	void SetAllVisible();
+
+	// Indices of the visible items in ascending order.
+	const std::vector<UINT>& VisibleIndices() const;
+
+	// World space bounding sphere of an item.
+	DirectX::BoundingSphere WorldSphere(UINT index) const;
+
+private:
+	void CullRange(const DirectX::XMVECTOR* planes, UINT begin, UINT end, std::vector<UINT>& visible) const;
+
+private:
+	// Below this many items per worker it is cheaper to cull on the calling thread.
+	static const UINT MinItemsPerTask = 4096;
+
+	UINT m_ItemCount = 0;
+
+	// World space oriented boxes, as a center and three axes scaled by the extents, and
+	// spheres.  An item is culled when either one is outside a plane.  Sizes are padded to
+	// a multiple of four so the SIMD loop can always load whole vectors.
+	std::vector<float> m_CenterX;
+	std::vector<float> m_CenterY;
+	std::vector<float> m_CenterZ;
+	std::vector<float> m_AxisX[3];
+	std::vector<float> m_AxisY[3];
+	std::vector<float> m_AxisZ[3];
+	std::vector<float> m_SphereX;
+	std::vector<float> m_SphereY;
+	std::vector<float> m_SphereZ;
+	std::vector<float> m_SphereRadius;
+
+	// 0xFFFFFFFF for items that are always visible, 0 otherwise.
+	std::vector<std::uint32_t> m_AlwaysVisible;
+
+	std::vector<UINT> m_VisibleIndices;
+	std::vector<std::vector<UINT>> m_TaskVisibleIndices;
+};
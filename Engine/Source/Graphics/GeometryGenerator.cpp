@@ -1,15 +1,144 @@
 #include "Engine.h"
 #include "GeometryGenerator.h"
 
+#include "Common/JobSystem.h"
+
 #include <algorithm>
+#include <cstring>
 
 using namespace DirectX;
 
+namespace
+{
+	using uint32 = GeometryGenerator::uint32;
+	using MeshBuffers = GeometryGenerator::MeshBuffers;
+
+	// No edge has the same vertex at both ends.
+	const std::uint64_t EmptyEdge = ~0ull;
+
+	char* VertexAt(const MeshBuffers& out, uint32 vertex, size_t offset)
+	{
+		return static_cast<char*>(out.Vertices) + vertex * out.Layout.Stride + offset;
+	}
+
+	XMFLOAT3 ReadFloat3(const MeshBuffers& out, uint32 vertex, size_t offset)
+	{
+		XMFLOAT3 value;
+		std::memcpy(&value, VertexAt(out, vertex, offset), sizeof(value));
+		return value;
+	}
+
+	XMFLOAT2 ReadFloat2(const MeshBuffers& out, uint32 vertex, size_t offset)
+	{
+		XMFLOAT2 value;
+		std::memcpy(&value, VertexAt(out, vertex, offset), sizeof(value));
+		return value;
+	}
+
+	// Writes the position and the attributes the layout has.
+	void WriteVertex(const MeshBuffers& out, uint32 vertex, const XMFLOAT3& position,
+		const XMFLOAT3& normal, const XMFLOAT3& tangent, const XMFLOAT2& texC)
+	{
+		const GeometryGenerator::VertexLayout& layout = out.Layout;
+
+		std::memcpy(VertexAt(out, vertex, 0), &position, sizeof(position));
+		if (layout.NormalOffset != GeometryGenerator::NoAttribute)
+			std::memcpy(VertexAt(out, vertex, layout.NormalOffset), &normal, sizeof(normal));
+		if (layout.TangentOffset != GeometryGenerator::NoAttribute)
+			std::memcpy(VertexAt(out, vertex, layout.TangentOffset), &tangent, sizeof(tangent));
+		if (layout.TexCOffset != GeometryGenerator::NoAttribute)
+			std::memcpy(VertexAt(out, vertex, layout.TexCOffset), &texC, sizeof(texC));
+	}
+
+	void WriteVertex(const MeshBuffers& out, uint32 vertex, const GeometryGenerator::Vertex& v)
+	{
+		WriteVertex(out, vertex, v.Position, v.Normal, v.TangentU, v.TexC);
+	}
+
+	uint32 ReadIndex(const MeshBuffers& out, uint32 i)
+	{
+		if (out.IndexByteSize == sizeof(std::uint16_t))
+			return static_cast<const std::uint16_t*>(out.Indices)[i];
+
+		return static_cast<const uint32*>(out.Indices)[i];
+	}
+
+	void WriteIndex(const MeshBuffers& out, uint32 i, uint32 value)
+	{
+		assert(out.IndexByteSize == sizeof(uint32) || value <= 0xFFFF);
+
+		if (out.IndexByteSize == sizeof(std::uint16_t))
+			static_cast<std::uint16_t*>(out.Indices)[i] = static_cast<std::uint16_t>(value);
+		else
+			static_cast<uint32*>(out.Indices)[i] = value;
+	}
+
+	void WriteTriangle(const MeshBuffers& out, uint32 i, uint32 v0, uint32 v1, uint32 v2)
+	{
+		WriteIndex(out, i + 0, v0);
+		WriteIndex(out, i + 1, v1);
+		WriteIndex(out, i + 2, v2);
+	}
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)
+{
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+	// Each face is a grid of (2^n + 1)^2 vertices, faces do not share vertices.
+	uint32 side = (1u << numSubdivisions) + 1;
+	return { 6 * side * side, 36u << (2 * numSubdivisions) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+	sliceCount = std::max<uint32>(sliceCount, 3u);
+	stackCount = std::max<uint32>(stackCount, 2u);
+
+	return { 2 + (stackCount - 1) * (sliceCount + 1), 6 * sliceCount * (stackCount - 1) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+	// Every level adds a vertex per edge and splits each triangle into four.
+	return { 10u * (1u << (2 * numSubdivisions)) + 2, 60u << (2 * numSubdivisions) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	sliceCount = std::max<uint32>(sliceCount, 3u);
+	stackCount = std::max<uint32>(stackCount, 1u);
+
+	// Rings of the stacks and the two caps with their center.
+	return { (stackCount + 1) * (sliceCount + 1) + 2 * (sliceCount + 2), 6 * sliceCount * (stackCount + 1) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	m = std::max<uint32>(m, 2u);
+	n = std::max<uint32>(n, 2u);
+
+	return { m * n, 6 * (m - 1) * (n - 1) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize()
+{
+	return { 4, 6 };
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(
 	float width, float height, float depth, uint32 numSubdivisions)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateBox(width, height, depth, numSubdivisions, Allocate(meshData, BoxSize(numSubdivisions)));
+	return meshData;
+}
 
+void GeometryGenerator::CreateBox(
+	float width, float height, float depth, uint32 numSubdivisions, const MeshBuffers& out)
+{
     //
 	// Create the vertices.
 	//
@@ -19,7 +148,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(
 	float w2 = 0.5f*width;
 	float h2 = 0.5f*height;
 	float d2 = 0.5f*depth;
-    
+
 	// Fill in the front face vertex data.
 	v[0] = Vertex(-w2, -h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 	v[1] = Vertex(-w2, +h2, -d2, 0.0f, 0.0f, -1.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
@@ -56,8 +185,9 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
 
-	meshData.Vertices.assign(&v[0], &v[24]);
- 
+	for(uint32 k = 0; k < 24; ++k)
+		WriteVertex(out, k, v[k]);
+
 	//
 	// Create the indices.
 	//
@@ -88,20 +218,32 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(
 	i[30] = 20; i[31] = 21; i[32] = 22;
 	i[33] = 20; i[34] = 22; i[35] = 23;
 
-	meshData.Indices32.assign(&i[0], &i[36]);
+	for(uint32 k = 0; k < 36; ++k)
+		WriteIndex(out, k, i[k]);
 
-    // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+	// Put a cap on the number of subdivisions.
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
-    for(uint32 i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
+	uint32 vertexCount = 24;
+	uint32 indexCount = 36;
+	for(uint32 k = 0; k < numSubdivisions; ++k, indexCount *= 4)
+		vertexCount = Subdivide(out, vertexCount, indexCount, true);
 
-    return meshData;
+	assert(vertexCount == BoxSize(numSubdivisions).VertexCount);
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateSphere(radius, sliceCount, stackCount, Allocate(meshData, SphereSize(sliceCount, stackCount)));
+	return meshData;
+}
+
+void GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshBuffers& out)
+{
+	// A sphere needs a ring between its poles.
+	sliceCount = std::max<uint32>(sliceCount, 3u);
+	stackCount = std::max<uint32>(stackCount, 2u);
 
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
@@ -113,60 +255,51 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	uint32 vertex = 0;
+	WriteVertex(out, vertex++, topVertex);
 
-	float phiStep   = XM_PI/stackCount;
-	float thetaStep = 2.0f*XM_PI/sliceCount;
+	float phiStep = XM_PI/stackCount;
+
+	// Every ring has the same angles around the y-axis.
+	BuildSinCosTable(sliceCount);
 
 	// Compute vertices for each stack ring (do not count the poles as rings).
 	for(uint32 i = 1; i <= stackCount-1; ++i)
 	{
 		float phi = i*phiStep;
+		float sinPhi = sinf(phi);
+		float cosPhi = cosf(phi);
 
 		// Vertices of ring.
         for(uint32 j = 0; j <= sliceCount; ++j)
 		{
-			float theta = j*thetaStep;
-
-			Vertex v;
-
-			// spherical to cartesian
-			v.Position.x = radius*sinf(phi)*cosf(theta);
-			v.Position.y = radius*cosf(phi);
-			v.Position.z = radius*sinf(phi)*sinf(theta);
+			float cosTheta = m_SinCos[j].x;
+			float sinTheta = m_SinCos[j].y;
 
-			// Partial derivative of P with respect to theta
-			v.TangentU.x = -radius*sinf(phi)*sinf(theta);
-			v.TangentU.y = 0.0f;
-			v.TangentU.z = +radius*sinf(phi)*cosf(theta);
+			// spherical to cartesian, the normal is the unit position
+			XMFLOAT3 normal(sinPhi*cosTheta, cosPhi, sinPhi*sinTheta);
+			XMFLOAT3 position(radius*normal.x, radius*normal.y, radius*normal.z);
 
-			XMVECTOR T = XMLoadFloat3(&v.TangentU);
-			XMStoreFloat3(&v.TangentU, XMVector3Normalize(T));
+			// Partial derivative of P with respect to theta, normalized
+			XMFLOAT3 tangent(-sinTheta, 0.0f, cosTheta);
 
-			XMVECTOR p = XMLoadFloat3(&v.Position);
-			XMStoreFloat3(&v.Normal, XMVector3Normalize(p));
+			XMFLOAT2 texC((float)j/sliceCount, phi/XM_PI);
 
-			v.TexC.x = theta / XM_2PI;
-			v.TexC.y = phi / XM_PI;
-
-			meshData.Vertices.push_back( v );
+			WriteVertex(out, vertex++, position, normal, tangent, texC);
 		}
 	}
 
-	meshData.Vertices.push_back( bottomVertex );
+	WriteVertex(out, vertex++, bottomVertex);
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
-    for(uint32 i = 1; i <= sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
-	}
-	
+	uint32 k = 0;
+    for(uint32 i = 1; i <= sliceCount; ++i, k += 3)
+		WriteTriangle(out, k, 0, i+1, i);
+
 	//
 	// Compute indices for inner stacks (not connected to poles).
 	//
@@ -177,15 +310,17 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
     uint32 ringVertexCount = sliceCount + 1;
 	for(uint32 i = 0; i < stackCount-2; ++i)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		for(uint32 j = 0; j < sliceCount; ++j, k += 6)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			WriteTriangle(out, k,
+				baseIndex + i*ringVertexCount + j,
+				baseIndex + i*ringVertexCount + j+1,
+				baseIndex + (i+1)*ringVertexCount + j);
+
+			WriteTriangle(out, k+3,
+				baseIndex + (i+1)*ringVertexCount + j,
+				baseIndex + i*ringVertexCount + j+1,
+				baseIndex + (i+1)*ringVertexCount + j+1);
 		}
 	}
 
@@ -195,196 +330,226 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	//
 
 	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 southPoleIndex = vertex-1;
 
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
-	
-	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
-	}
-
-    return meshData;
-}
- 
-void GeometryGenerator::Subdivide(MeshData& meshData)
-{
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	for(uint32 i = 0; i < sliceCount; ++i, k += 3)
+		WriteTriangle(out, k, southPoleIndex, baseIndex+i, baseIndex+i+1);
 
-	//       v1
-	//       *
-	//      / \
-	//     /   \
-	//  m0*-----*m1
-	//   / \   / \
-	//  /   \ /   \
-	// *-----*-----*
-	// v0    m2     v2
+	assert(vertex == SphereSize(sliceCount, stackCount).VertexCount);
+}
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
-	for(uint32 i = 0; i < numTris; ++i)
+GeometryGenerator::uint32 GeometryGenerator::Subdivide(
+	const MeshBuffers& out, uint32 vertexCount, uint32 indexCount, bool attributes)
+{
+	// Open addressing table of the edges seen so far, sized to stay sparse.
+	uint32 numTris = indexCount/3;
+	size_t tableSize = 1;
+	while (tableSize < 3 * (size_t)numTris)
+		tableSize <<= 1;
+
+	m_EdgeMidpoints.assign(tableSize, { EmptyEdge, 0 });
+
+	/*
+	       v1
+	       *
+	      / \
+	     /   \
+	  m0*-----*m1
+	   / \   / \
+	  /   \ /   \
+	 *-----*-----*
+	 v0    m2     v2
+	*/
+
+	// The four triangles of triangle i go where triangle 4i was, so walking backwards
+	// never overwrites a triangle that is still to be read.
+	for(uint32 i = numTris; i-- > 0;)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+		uint32 v0 = ReadIndex(out, i*3+0);
+		uint32 v1 = ReadIndex(out, i*3+1);
+		uint32 v2 = ReadIndex(out, i*3+2);
 
 		//
 		// Generate the midpoints.
 		//
 
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
+		uint32 m0 = MidPoint(out, v0, v1, vertexCount, attributes);
+		uint32 m1 = MidPoint(out, v1, v2, vertexCount, attributes);
+		uint32 m2 = MidPoint(out, v0, v2, vertexCount, attributes);
 
 		//
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		WriteTriangle(out, i*12+0, v0, m0, m2);
+		WriteTriangle(out, i*12+3, m0, m1, m2);
+		WriteTriangle(out, i*12+6, m2, m1, v2);
+		WriteTriangle(out, i*12+9, m0, v1, m1);
 	}
+
+	return vertexCount;
 }
 
-GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Vertex& v1)
+GeometryGenerator::uint32 GeometryGenerator::MidPoint(
+	const MeshBuffers& out, uint32 v0, uint32 v1, uint32& vertexCount, bool attributes)
 {
-    XMVECTOR p0 = XMLoadFloat3(&v0.Position);
-    XMVECTOR p1 = XMLoadFloat3(&v1.Position);
+	std::uint64_t edge = v0 < v1 ? ((std::uint64_t)v0 << 32 | v1) : ((std::uint64_t)v1 << 32 | v0);
+
+	// Fibonacci hashing, linear probing.
+	size_t mask = m_EdgeMidpoints.size() - 1;
+	size_t slot = (size_t)((edge * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+	while (m_EdgeMidpoints[slot].Edge != EmptyEdge)
+	{
+		if (m_EdgeMidpoints[slot].Edge == edge)
+			return m_EdgeMidpoints[slot].Midpoint;
 
-    XMVECTOR n0 = XMLoadFloat3(&v0.Normal);
-    XMVECTOR n1 = XMLoadFloat3(&v1.Normal);
+		slot = (slot + 1) & mask;
+	}
+
+	uint32 m = vertexCount++;
+	m_EdgeMidpoints[slot] = { edge, m };
+
+	const VertexLayout& layout = out.Layout;
 
-    XMVECTOR tan0 = XMLoadFloat3(&v0.TangentU);
-    XMVECTOR tan1 = XMLoadFloat3(&v1.TangentU);
+    XMFLOAT3 p0 = ReadFloat3(out, v0, 0);
+    XMFLOAT3 p1 = ReadFloat3(out, v1, 0);
+    XMFLOAT3 pos;
+    XMStoreFloat3(&pos, 0.5f*(XMLoadFloat3(&p0) + XMLoadFloat3(&p1)));
+    std::memcpy(VertexAt(out, m, 0), &pos, sizeof(pos));
 
-    XMVECTOR tex0 = XMLoadFloat2(&v0.TexC);
-    XMVECTOR tex1 = XMLoadFloat2(&v1.TexC);
+	if (!attributes)
+		return m;
 
     // Compute the midpoints of all the attributes.  Vectors need to be normalized
-    // since linear interpolating can make them not unit length.  
-    XMVECTOR pos = 0.5f*(p0 + p1);
-    XMVECTOR normal = XMVector3Normalize(0.5f*(n0 + n1));
-    XMVECTOR tangent = XMVector3Normalize(0.5f*(tan0+tan1));
-    XMVECTOR tex = 0.5f*(tex0 + tex1);
-
-    Vertex v;
-    XMStoreFloat3(&v.Position, pos);
-    XMStoreFloat3(&v.Normal, normal);
-    XMStoreFloat3(&v.TangentU, tangent);
-    XMStoreFloat2(&v.TexC, tex);
-
-    return v;
+    // since linear interpolating can make them not unit length.
+	for (size_t offset : { layout.NormalOffset, layout.TangentOffset })
+	{
+		if (offset == NoAttribute)
+			continue;
+
+		XMFLOAT3 n0 = ReadFloat3(out, v0, offset);
+		XMFLOAT3 n1 = ReadFloat3(out, v1, offset);
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, XMVector3Normalize(0.5f*(XMLoadFloat3(&n0) + XMLoadFloat3(&n1))));
+		std::memcpy(VertexAt(out, m, offset), &n, sizeof(n));
+	}
+
+	if (layout.TexCOffset != NoAttribute)
+	{
+		XMFLOAT2 tex0 = ReadFloat2(out, v0, layout.TexCOffset);
+		XMFLOAT2 tex1 = ReadFloat2(out, v1, layout.TexCOffset);
+		XMFLOAT2 tex;
+		XMStoreFloat2(&tex, 0.5f*(XMLoadFloat2(&tex0) + XMLoadFloat2(&tex1)));
+		std::memcpy(VertexAt(out, m, layout.TexCOffset), &tex, sizeof(tex));
+	}
+
+	return m;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateGeosphere(radius, numSubdivisions, Allocate(meshData, GeosphereSize(numSubdivisions)));
+	return meshData;
+}
 
+void GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, const MeshBuffers& out)
+{
 	// Put a cap on the number of subdivisions.
     numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
 	// Approximate a sphere by tessellating an icosahedron.
 
-	const float X = 0.525731f; 
+	const float X = 0.525731f;
 	const float Z = 0.850651f;
 
-	XMFLOAT3 pos[12] = 
+	XMFLOAT3 pos[12] =
 	{
-		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),  
-		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),    
-		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X), 
-		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),    
-		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f), 
+		XMFLOAT3(-X, 0.0f, Z),  XMFLOAT3(X, 0.0f, Z),
+		XMFLOAT3(-X, 0.0f, -Z), XMFLOAT3(X, 0.0f, -Z),
+		XMFLOAT3(0.0f, Z, X),   XMFLOAT3(0.0f, Z, -X),
+		XMFLOAT3(0.0f, -Z, X),  XMFLOAT3(0.0f, -Z, -X),
+		XMFLOAT3(Z, X, 0.0f),   XMFLOAT3(-Z, X, 0.0f),
 		XMFLOAT3(Z, -X, 0.0f),  XMFLOAT3(-Z, -X, 0.0f)
 	};
 
     uint32 k[60] =
 	{
-		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,    
-		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,    
-		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0, 
-		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
+		1,4,0,  4,9,0,  4,5,9,  8,5,4,  1,8,4,
+		1,10,8, 10,3,8, 8,3,5,  3,2,5,  3,7,2,
+		3,10,7, 10,6,7, 6,11,7, 6,0,11, 6,1,0,
+		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7
 	};
 
-    meshData.Vertices.resize(12);
-    meshData.Indices32.assign(&k[0], &k[60]);
-
+	// Only the positions are subdivided, the attributes follow from the projection.
 	for(uint32 i = 0; i < 12; ++i)
-		meshData.Vertices[i].Position = pos[i];
+		std::memcpy(VertexAt(out, i, 0), &pos[i], sizeof(pos[i]));
+
+	for(uint32 i = 0; i < 60; ++i)
+		WriteIndex(out, i, k[i]);
+
+	uint32 vertexCount = 12;
+	uint32 indexCount = 60;
+	for(uint32 i = 0; i < numSubdivisions; ++i, indexCount *= 4)
+		vertexCount = Subdivide(out, vertexCount, indexCount, false);
 
-	for(uint32 i = 0; i < numSubdivisions; ++i)
-		Subdivide(meshData);
+	assert(vertexCount == GeosphereSize(numSubdivisions).VertexCount);
 
 	// Project vertices onto sphere and scale.
-	for(uint32 i = 0; i < meshData.Vertices.size(); ++i)
+	for(uint32 i = 0; i < vertexCount; ++i)
 	{
+		XMFLOAT3 position = ReadFloat3(out, i, 0);
+
 		// Project onto unit sphere.
-		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&meshData.Vertices[i].Position));
+		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&position));
 
 		// Project onto sphere.
 		XMVECTOR p = radius*n;
 
-		XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+		XMFLOAT3 normal;
+		XMStoreFloat3(&position, p);
+		XMStoreFloat3(&normal, n);
 
 		// Derive texture coordinates from spherical coordinates.
-        float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
+        float theta = atan2f(normal.z, normal.x);
 
         // Put in [0, 2pi].
         if(theta < 0.0f)
             theta += XM_2PI;
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+		float phi = acosf(std::min<float>(std::max<float>(normal.y, -1.0f), 1.0f));
 
-		meshData.Vertices[i].TexC.x = theta/XM_2PI;
-		meshData.Vertices[i].TexC.y = phi/XM_PI;
+		XMFLOAT2 texC(theta/XM_2PI, phi/XM_PI);
 
-		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+		// Partial derivative of P with respect to theta, which is parallel to
+		// (-z, 0, x) of the normal.  Zero at the poles.
+		XMFLOAT3 tangent;
+		XMStoreFloat3(&tangent, XMVector3Normalize(XMVectorSet(-normal.z, 0.0f, normal.x, 0.0f)));
 
-		XMVECTOR T = XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
+		WriteVertex(out, i, position, normal, tangent, texC);
 	}
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
-    MeshData meshData;
+	MeshData meshData;
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount,
+		Allocate(meshData, CylinderSize(sliceCount, stackCount)));
+	return meshData;
+}
+
+void GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+	const MeshBuffers& out)
+{
+	sliceCount = std::max<uint32>(sliceCount, 3u);
+	stackCount = std::max<uint32>(stackCount, 1u);
 
 	//
 	// Build Stacks.
-	// 
+	//
 
 	float stackHeight = height / stackCount;
 
@@ -393,6 +558,37 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount+1;
 
+	// Every ring and both caps have the same angles around the y-axis.
+	BuildSinCosTable(sliceCount);
+
+	// Cylinder can be parameterized as follows, where we introduce v
+	// parameter that goes in the same direction as the v tex-coord
+	// so that the bitangent goes in the same direction as the v tex-coord.
+	//   Let r0 be the bottom radius and let r1 be the top radius.
+	//   y(v) = h - hv for v in [0,1].
+	//   r(v) = r1 + (r0-r1)v
+	//
+	//   x(t, v) = r(v)*cos(t)
+	//   y(t, v) = h - hv
+	//   z(t, v) = r(v)*sin(t)
+	//
+	//  dx/dt = -r(v)*sin(t)
+	//  dy/dt = 0
+	//  dz/dt = +r(v)*cos(t)
+	//
+	//  dx/dv = (r0-r1)*cos(t)
+	//  dy/dv = -h
+	//  dz/dv = (r0-r1)*sin(t)
+	//
+	// The normal is cross(T, B) = (h*cos(t), r0-r1, h*sin(t)), its length does not
+	// depend on t.
+	float dr = bottomRadius-topRadius;
+	float invLength = 1.0f / sqrtf(height*height + dr*dr);
+
+	// Add one because we duplicate the first and last vertex per ring
+	// since the texture coordinates are different.
+	uint32 ringVertexCount = sliceCount+1;
+
 	// Compute vertices for each stack ring starting at the bottom and moving up.
 	for(uint32 i = 0; i < ringCount; ++i)
 	{
@@ -400,163 +596,127 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 		float r = bottomRadius + i*radiusStep;
 
 		// vertices of ring
-		float dTheta = 2.0f*XM_PI/sliceCount;
 		for(uint32 j = 0; j <= sliceCount; ++j)
 		{
-			Vertex vertex;
-
-			float c = cosf(j*dTheta);
-			float s = sinf(j*dTheta);
-
-			vertex.Position = XMFLOAT3(r*c, y, r*s);
-
-			vertex.TexC.x = (float)j/sliceCount;
-			vertex.TexC.y = 1.0f - (float)i/stackCount;
-
-			// Cylinder can be parameterized as follows, where we introduce v
-			// parameter that goes in the same direction as the v tex-coord
-			// so that the bitangent goes in the same direction as the v tex-coord.
-			//   Let r0 be the bottom radius and let r1 be the top radius.
-			//   y(v) = h - hv for v in [0,1].
-			//   r(v) = r1 + (r0-r1)v
-			//
-			//   x(t, v) = r(v)*cos(t)
-			//   y(t, v) = h - hv
-			//   z(t, v) = r(v)*sin(t)
-			// 
-			//  dx/dt = -r(v)*sin(t)
-			//  dy/dt = 0
-			//  dz/dt = +r(v)*cos(t)
-			//
-			//  dx/dv = (r0-r1)*cos(t)
-			//  dy/dv = -h
-			//  dz/dv = (r0-r1)*sin(t)
+			float c = m_SinCos[j].x;
+			float s = m_SinCos[j].y;
 
-			// This is unit length.
-			vertex.TangentU = XMFLOAT3(-s, 0.0f, c);
+			XMFLOAT3 position(r*c, y, r*s);
+			XMFLOAT3 normal(height*c*invLength, dr*invLength, height*s*invLength);
 
-			float dr = bottomRadius-topRadius;
-			XMFLOAT3 bitangent(dr*c, -height, dr*s);
+			// This is unit length.
+			XMFLOAT3 tangent(-s, 0.0f, c);
 
-			XMVECTOR T = XMLoadFloat3(&vertex.TangentU);
-			XMVECTOR B = XMLoadFloat3(&bitangent);
-			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
-			XMStoreFloat3(&vertex.Normal, N);
+			XMFLOAT2 texC((float)j/sliceCount, 1.0f - (float)i/stackCount);
 
-			meshData.Vertices.push_back(vertex);
+			WriteVertex(out, i*ringVertexCount + j, position, normal, tangent, texC);
 		}
 	}
 
-	// Add one because we duplicate the first and last vertex per ring
-	// since the texture coordinates are different.
-	uint32 ringVertexCount = sliceCount+1;
-
 	// Compute indices for each stack.
+	uint32 k = 0;
 	for(uint32 i = 0; i < stackCount; ++i)
 	{
-		for(uint32 j = 0; j < sliceCount; ++j)
+		for(uint32 j = 0; j < sliceCount; ++j, k += 6)
 		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
+			WriteTriangle(out, k,
+				i*ringVertexCount + j,
+				(i+1)*ringVertexCount + j,
+				(i+1)*ringVertexCount + j+1);
+
+			WriteTriangle(out, k+3,
+				i*ringVertexCount + j,
+				(i+1)*ringVertexCount + j+1,
+				i*ringVertexCount + j+1);
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-
-    return meshData;
+	// Each cap has a ring and a center vertex and a triangle per slice.
+	uint32 capVertex = ringCount*ringVertexCount;
+	BuildCylinderTopCap(topRadius, height, sliceCount, out, capVertex, k);
+	BuildCylinderBottomCap(bottomRadius, height, sliceCount, out,
+		capVertex + sliceCount + 2, k + 3*sliceCount);
 }
 
-void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderTopCap(float topRadius, float height,
+	uint32 sliceCount, const MeshBuffers& out, uint32 baseVertex, uint32 baseIndex)
 {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
-
 	float y = 0.5f*height;
-	float dTheta = 2.0f*XM_PI/sliceCount;
 
 	// Duplicate cap ring vertices because the texture coordinates and normals differ.
 	for(uint32 i = 0; i <= sliceCount; ++i)
 	{
-		float x = topRadius*cosf(i*dTheta);
-		float z = topRadius*sinf(i*dTheta);
+		float x = topRadius*m_SinCos[i].x;
+		float z = topRadius*m_SinCos[i].y;
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		WriteVertex(out, baseVertex + i, Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseVertex + sliceCount + 1;
+	WriteVertex(out, centerIndex, Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
 
 	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
-	}
+		WriteTriangle(out, baseIndex + i*3, centerIndex, baseVertex + i+1, baseVertex + i);
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, 
-	float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float height,
+	uint32 sliceCount, const MeshBuffers& out, uint32 baseVertex, uint32 baseIndex)
 {
-	// 
+	//
 	// Build bottom cap.
 	//
 
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
 	float y = -0.5f*height;
 
 	// vertices of ring
-	float dTheta = 2.0f*XM_PI/sliceCount;
 	for(uint32 i = 0; i <= sliceCount; ++i)
 	{
-		float x = bottomRadius*cosf(i*dTheta);
-		float z = bottomRadius*sinf(i*dTheta);
+		float x = bottomRadius*m_SinCos[i].x;
+		float z = bottomRadius*m_SinCos[i].y;
 
 		// Scale down by the height to try and make top cap texture coord area
 		// proportional to base.
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		WriteVertex(out, baseVertex + i, Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v));
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
-
-	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = baseVertex + sliceCount + 1;
+	WriteVertex(out, centerIndex, Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
 
 	for(uint32 i = 0; i < sliceCount; ++i)
-	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
-	}
+		WriteTriangle(out, baseIndex + i*3, centerIndex, baseVertex + i, baseVertex + i+1);
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
+void GeometryGenerator::BuildSinCosTable(uint32 sliceCount)
 {
-    MeshData meshData;
+	float dTheta = 2.0f*XM_PI/sliceCount;
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
+	m_SinCos.resize(sliceCount + 1);
+	for(uint32 j = 0; j <= sliceCount; ++j)
+		m_SinCos[j] = XMFLOAT2(cosf(j*dTheta), sinf(j*dTheta));
+}
 
-	//
-	// Create the vertices.
-	//
+GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
+{
+	MeshData meshData;
+	CreateGrid(width, depth, m, n, Allocate(meshData, GridSize(m, n)));
+	return meshData;
+}
+
+void GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshBuffers& out)
+{
+	// A grid needs two rows and two columns for a quad.
+	m = std::max<uint32>(m, 2u);
+	n = std::max<uint32>(n, 2u);
 
 	float halfWidth = 0.5f*width;
 	float halfDepth = 0.5f*depth;
@@ -567,91 +727,112 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
-	{
-		float z = halfDepth - i*dz;
-		for(uint32 j = 0; j < n; ++j)
-		{
-			float x = -halfWidth + j*dx;
-
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
-		}
-	}
- 
-    //
-	// Create the indices.
-	//
-
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
+	// Writes the vertices of rows [begin, end) and the indices of the quads below them.
+	auto writeRows = [&](uint32 begin, uint32 end)
 	{
-		for(uint32 j = 0; j < n-1; ++j)
+		for(uint32 i = begin; i < end; ++i)
 		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
-
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
-
-			k += 6; // next quad
+			float z = halfDepth - i*dz;
+			for(uint32 j = 0; j < n; ++j)
+			{
+				float x = -halfWidth + j*dx;
+
+				// Stretch texture over grid.
+				WriteVertex(out, i*n+j, XMFLOAT3(x, 0.0f, z), XMFLOAT3(0.0f, 1.0f, 0.0f),
+					XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT2(j*du, i*dv));
+			}
+
+			if(i == m-1)
+				continue;
+
+			// Iterate over each quad and compute indices.
+			uint32 k = i*(n-1)*6;
+			for(uint32 j = 0; j < n-1; ++j, k += 6) // next quad
+			{
+				WriteTriangle(out, k, i*n+j, i*n+j+1, (i+1)*n+j);
+				WriteTriangle(out, k+3, (i+1)*n+j, i*n+j+1, (i+1)*n+j+1);
+			}
 		}
-	}
+	};
 
-    return meshData;
+	// Rows do not share anything, large grids are split across the job system.
+	JobSystem* jobSystem = JobSystem::Instance();
+	if (jobSystem != nullptr)
+		jobSystem->ParallelFor(m, std::max<uint32>(MinGridVerticesPerJob / n, 1u), writeRows);
+	else
+		writeRows(0, m);
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(
 	float x, float y, float w, float h, float depth)
 {
-    MeshData meshData;
-
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
+	MeshData meshData;
+	CreateQuad(x, y, w, h, depth, Allocate(meshData, QuadSize()));
+	return meshData;
+}
 
+void GeometryGenerator::CreateQuad(
+	float x, float y, float w, float h, float depth, const MeshBuffers& out)
+{
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	WriteVertex(out, 0, Vertex(
         x, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 1.0f);
+		0.0f, 1.0f));
 
-	meshData.Vertices[1] = Vertex(
+	WriteVertex(out, 1, Vertex(
 		x, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		0.0f, 0.0f);
+		0.0f, 0.0f));
 
-	meshData.Vertices[2] = Vertex(
+	WriteVertex(out, 2, Vertex(
 		x+w, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 0.0f);
+		1.0f, 0.0f));
 
-	meshData.Vertices[3] = Vertex(
+	WriteVertex(out, 3, Vertex(
 		x+w, y-h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
-		1.0f, 1.0f);
+		1.0f, 1.0f));
 
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
+	WriteTriangle(out, 0, 0, 1, 2);
+	WriteTriangle(out, 3, 0, 2, 3);
+}
 
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
+GeometryGenerator::PreparedMesh GeometryGenerator::Prepare(void* vertices, const VertexLayout& layout,
+	uint32 vertexCount, std::vector<uint32>& indices, bool optimizeOverdraw)
+{
+	MeshOptimizer::Optimize(vertices, layout.Stride, vertexCount, indices.data(), indices.size(), optimizeOverdraw);
+
+	// Texture coordinates weigh more than normals, a stretched texture shows sooner than
+	// a smoothed shading.
+	std::vector<SimplifyAttribute> attributes;
+	if (layout.NormalOffset != NoAttribute)
+		attributes.push_back({ (uint32)layout.NormalOffset, 3, 0.5f });
+	if (layout.TexCOffset != NoAttribute)
+		attributes.push_back({ (uint32)layout.TexCOffset, 2, 1.0f });
+
+	PreparedMesh prepared;
+	std::vector<uint32> lodIndices;
+	prepared.Lods = MeshSimplifier::BuildLodChain(vertices, layout.Stride, vertexCount,
+		indices.data(), indices.size(), attributes, lodIndices);
+	indices = std::move(lodIndices);
+
+	prepared.Meshlets = MeshletBuilder::Build(vertices, layout.Stride, vertexCount,
+		indices.data(), prepared.Lods[0].IndexCount);
+
+	return prepared;
+}
+
+GeometryGenerator::MeshBuffers GeometryGenerator::Allocate(MeshData& meshData, const MeshSize& size)
+{
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
 
-    return meshData;
+	const VertexLayout layout = { sizeof(Vertex), offsetof(Vertex, Normal), offsetof(Vertex, TangentU), offsetof(Vertex, TexC) };
+	return { meshData.Vertices.data(), layout, meshData.Indices32.data(), sizeof(uint32) };
 }
@@ -18,6 +18,10 @@
 #include <DirectXMath.h>
 #include <vector>
 
+#include "Common/MeshOptimizer.h"
+#include "Common/MeshSimplifier.h"
+#include "Common/Meshlets.h"
+
 class ENGINE_API GeometryGenerator
 {
 public:
@@ -73,23 +77,70 @@ public:
 		std::vector<uint16> m_Indices16;
 	};
 
+	// Offset of an attribute the caller's vertex does not have.  It is not written.
+	static constexpr size_t NoAttribute = ~size_t(0);
+
+	// Float vertex the generator writes: a float3 position at offset 0 and the float3
+	// normal, float3 tangent and float2 texture coordinate at the given byte offsets.
+	struct VertexLayout
+	{
+		size_t Stride;
+		size_t NormalOffset;
+		size_t TangentOffset;
+		size_t TexCOffset;
+	};
+
+	// Caller owned memory a Create function writes the mesh to, sized by the matching Size
+	// function.  Indices are 2 or 4 bytes and count from the first vertex.
+	struct MeshBuffers
+	{
+		void* Vertices;
+		VertexLayout Layout;
+		void* Indices;
+		uint32 IndexByteSize;
+	};
+
+	struct MeshSize
+	{
+		uint32 VertexCount;
+		uint32 IndexCount;
+	};
+
+	// Levels of detail and meshlets of a mesh ready for the GPU.
+	struct PreparedMesh
+	{
+		std::vector<MeshLod> Lods;
+		std::vector<Meshlet> Meshlets;
+	};
+
+	// Vertices and indices the Create functions below write for the same arguments.
+	static MeshSize BoxSize(uint32 numSubdivisions);
+	static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GeosphereSize(uint32 numSubdivisions);
+	static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
+	static MeshSize GridSize(uint32 m, uint32 n);
+	static MeshSize QuadSize();
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
 	///</summary>
     MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    void CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshBuffers& out);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    void CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshBuffers& out);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
 	/// depth controls the level of tessellation.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    void CreateGeosphere(float radius, uint32 numSubdivisions, const MeshBuffers& out);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -97,22 +148,59 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    void CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+        const MeshBuffers& out);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
-	/// at the origin with the specified width and depth.
+	/// at the origin with the specified width and depth.  Large grids are written
+	/// by the job system.
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    void CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshBuffers& out);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
+    void CreateQuad(float x, float y, float w, float h, float depth, const MeshBuffers& out);
+
+	///<summary>
+	/// Reorders the triangles and vertices for the GPU with MeshOptimizer, replaces the
+	/// indices with the levels of detail of MeshSimplifier, the full mesh first, and
+	/// orders the full level into meshlets with MeshletBuilder.
+	///</summary>
+	static PreparedMesh Prepare(void* vertices, const VertexLayout& layout, uint32 vertexCount,
+		std::vector<uint32>& indices, bool optimizeOverdraw = true);
+
+private:
+	// Fewest grid vertices a job writes.
+	static const uint32 MinGridVerticesPerJob = 16 * 1024;
+
+	struct EdgeMidpoint
+	{
+		std::uint64_t Edge;
+		uint32 Midpoint;
+	};
+
+	// Splits every triangle into four and returns the new vertex count.  Edges shared by two
+	// triangles share their midpoint.  The indices are rewritten in place, the midpoints are
+	// appended to the vertices.  Without attributes only the positions are interpolated.
+	uint32 Subdivide(const MeshBuffers& out, uint32 vertexCount, uint32 indexCount, bool attributes);
+	uint32 MidPoint(const MeshBuffers& out, uint32 v0, uint32 v1, uint32& vertexCount, bool attributes);
+	// Fills m_SinCos with the cosine and sine of sliceCount + 1 steps around the circle.
+	void BuildSinCosTable(uint32 sliceCount);
+	void BuildCylinderTopCap(float topRadius, float height, uint32 sliceCount,
+		const MeshBuffers& out, uint32 baseVertex, uint32 baseIndex);
+	void BuildCylinderBottomCap(float bottomRadius, float height, uint32 sliceCount,
+		const MeshBuffers& out, uint32 baseVertex, uint32 baseIndex);
+	// Sizes meshData for size and returns its buffers.
+	static MeshBuffers Allocate(MeshData& meshData, const MeshSize& size);
 
 private:
-	void Subdivide(MeshData& meshData);
-    Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, MeshData& meshData);
+	// Scratch memory kept between calls, so creating shapes does not allocate once it has
+	// grown to the largest one.
+	std::vector<EdgeMidpoint> m_EdgeMidpoints;
+	std::vector<DirectX::XMFLOAT2> m_SinCos;
 };
 
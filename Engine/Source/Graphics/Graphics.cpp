@@ -1,6 +1,8 @@
 #include "Engine.h"
 #include "Graphics.h"
 
+#include <chrono>
+
 namespace Graphics
 {
 	GraphicsClass::GraphicsClass()
@@ -17,13 +19,11 @@ namespace Graphics
 	{
 		D3DClass::Initialize(mainWnd, width, height);
 
+		m_UploadService = std::make_unique<UploadService>(m_d3dDevice.Get(), StagingBufferSize);
+
 		// Reset the command list to prep for initialization commands.
 		ThrowIfFailed(m_CommandList->Reset(m_DirectCommandListAllocator.Get(), nullptr));
 
-		// Get the increment size of a descriptor in this heap type.  This is hardware specific, 
-		// so we have to query this information.
-		m_CbvSrvDescriptorSize = m_d3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
 		m_Camera.SetPosition(0.0f, 8.0f, -40.0f);
 
 		LoadTextures();
@@ -32,10 +32,12 @@ namespace Graphics
 		BuildShadersAndInputLayout();
 		BuildRoomGeometry();
 		BuildShapeGeometry();
-		BuildCarGeometry();
+		BuildModelGeometry("car");
+		BuildModelGeometry("skull");
 		BuildMaterials();
 		BuildRenderItems();
 		BuildFrameResources();
+		MarkAllDirty();
 		BuildPipelineStateObjects();
 
 		// Execute the initialization commands.
@@ -46,6 +48,50 @@ namespace Graphics
 
 		// Wait until initialization is complete.
 		FlushCommandQueue();
+		m_UploadService->WaitForTicket(m_UploadService->Flush());
+
+		// The textures have been copied, their upload heaps go with the first drain.
+		for (auto& e : m_Textures)
+			m_DeferredReleases.Release(m_CurrentFence, std::move(e.second->UploadHeap));
+		for (auto& e : m_Geometries)
+		{
+			m_DeferredReleases.Release(m_CurrentFence, std::move(e.second->VertexBufferUploader));
+			m_DeferredReleases.Release(m_CurrentFence, std::move(e.second->IndexBufferUploader));
+		}
+	}
+
+	UINT64 GraphicsClass::GetInstanceBufferBytesWritten() const
+	{
+		return m_InstanceBytesWritten.load();
+	}
+
+	UINT64 GraphicsClass::GetMaterialBufferBytesWritten() const
+	{
+		return m_MaterialBytesWritten.load();
+	}
+
+	UINT64 GraphicsClass::GetPassConstantBufferBytesWritten() const
+	{
+		return m_PassCBBytesWritten.load();
+	}
+
+	std::wstring GraphicsClass::CalculateFrameStats()
+	{
+		UINT64 bytesWritten = GetInstanceBufferBytesWritten() +
+			GetMaterialBufferBytesWritten() + GetPassConstantBufferBytesWritten();
+
+		return D3DClass::CalculateFrameStats() +
+			L"   upload bytes: " + std::to_wstring(bytesWritten) +
+			L"   draws: " + std::to_wstring(m_InstanceBatcher.BatchCount()) +
+			L" (" + std::to_wstring(m_InstanceBatcher.ItemCount()) + L" items)" +
+			L"   state changes: " + std::to_wstring(m_DrawState.StateChanges()) +
+			L" (" + std::to_wstring(m_DrawState.SkippedStateChanges()) + L" skipped)" +
+			L"   pending release bytes: " + std::to_wstring(m_DeferredReleases.PendingBytes()) +
+			L" (" + std::to_wstring(m_DeferredReleases.ReclaimedBytes()) + L" reclaimed)" +
+			L"   descriptors: " + std::to_wstring(m_CbvSrvUavHeap->PersistentCount()) +
+			L" (" + std::to_wstring(m_CbvSrvUavHeap->TransientCount()) + L" transient)" +
+			L"   meshlets: " + std::to_wstring(m_MeshletsVisible.load()) +
+			L"/" + std::to_wstring(m_MeshletsTested.load());
 	}
 
 	void GraphicsClass::OnResize()
@@ -57,6 +103,9 @@ namespace Graphics
 
 	void GraphicsClass::Update(const Timer& gameTimer)
 	{
+		EraseShapes();
+		m_UploadService->Retire();
+		AddUploadedShapes();
 		if (m_ImguiManager.AddShapeFlag())
 			AddShape();
 		if(m_ImguiManager.CreateMaterialFlag())
@@ -79,13 +128,50 @@ namespace Graphics
 			CloseHandle(eventHandle);
 		}
 
-		FrustumCulling(gameTimer);
-		UpdateShadows(gameTimer);
-		UpdateReflections(gameTimer);
-		UpdateObjectConstantBuffers(gameTimer);
-		UpdateMaterialConstantBuffers(gameTimer);
-		UpdateMainPassConstantBuffer(gameTimer);
-		UpdateReflectedPassConstantBuffer(gameTimer);
+		m_DeferredReleases.Drain(m_Fence->GetCompletedValue());
+		m_CbvSrvUavHeap->Retire(m_Fence->GetCompletedValue());
+
+		// The GPU is done with this frame resource, so its buffers can grow to fit the
+		// slots handed out since it was last used.
+		m_CurrentFrameResource->Reserve(m_d3dDevice.Get(),
+			m_ObjectSlots.Capacity(), m_MaterialSlots.Capacity(), LayerItemCount());
+
+		m_InstanceBytesWritten = 0;
+		m_MaterialBytesWritten = 0;
+		m_PassCBBytesWritten = 0;
+
+		// The per-frame stages form a small task graph.  Independent stages overlap and
+		// the stages over all render items split their loops across the job threads.
+		//
+		//   main pass CB -> reflected pass CB
+		//                -> transforms -> culling bounds -> frustum culling -> LOD selection -> batching
+		//                                                -> instance buffer                   -> meshlet culling
+		//   material buffer
+		//
+		// Shadow transforms need this frame's light direction from the main pass, and the
+		// culling bounds have to see the dirty list before the instance update drains it.
+		JobGraph updateGraph;
+		auto mainPass = updateGraph.Add([&]() { UpdateMainPassConstantBuffer(gameTimer); });
+		auto reflectedPass = updateGraph.Add([&]() { UpdateReflectedPassConstantBuffer(gameTimer); });
+		auto transforms = updateGraph.Add([&]() { UpdateTransforms(gameTimer); });
+		auto cullingBounds = updateGraph.Add([&]() { UpdateCullingBounds(gameTimer); });
+		auto culling = updateGraph.Add([&]() { FrustumCulling(gameTimer); });
+		auto lods = updateGraph.Add([&]() { SelectLods(gameTimer); });
+		auto meshlets = updateGraph.Add([&]() { CullMeshlets(gameTimer); });
+		auto batching = updateGraph.Add([&]() { BuildInstanceBatches(gameTimer); });
+		auto instances = updateGraph.Add([&]() { UpdateInstanceBuffer(gameTimer); });
+		updateGraph.Add([&]() { UpdateMaterialBuffer(gameTimer); });
+
+		updateGraph.Precede(mainPass, reflectedPass);
+		updateGraph.Precede(mainPass, transforms);
+		updateGraph.Precede(transforms, cullingBounds);
+		updateGraph.Precede(cullingBounds, culling);
+		updateGraph.Precede(culling, lods);
+		updateGraph.Precede(lods, batching);
+		updateGraph.Precede(lods, meshlets);
+		updateGraph.Precede(cullingBounds, instances);
+
+		updateGraph.Run(&m_JobSystem);
 	}
 
 	void GraphicsClass::Draw(const Timer& gameTimer)
@@ -107,7 +193,7 @@ namespace Graphics
 
 		// A command list can be reset after it has been added to the command queue via ExecuteCommandList.
 		// Reusing the command list reuses memory.
-		ThrowIfFailed(m_CommandList->Reset(cmdListAlloc.Get(), m_PipelineStateObjects["opaque"].Get()));
+		ThrowIfFailed(m_CommandList->Reset(cmdListAlloc.Get(), m_PipelineStates->Get("opaque")));
 
 		m_CommandList->RSSetViewports(1, &m_ScreenViewport);
 		m_CommandList->RSSetScissorRects(1, &m_ScissorRect);
@@ -126,7 +212,8 @@ namespace Graphics
 		D3D12_CPU_DESCRIPTOR_HANDLE depthStencilView = DepthStencilView();
 		m_CommandList->OMSetRenderTargets(1, &currentBackBufferView, true, &depthStencilView);
 
-		ID3D12DescriptorHeap* descriptorHeaps[] = { m_ShaderResourceViewDescriptorHeap.Get() };
+		// ImGui's descriptors are in the same heap, so it is set once for the whole frame.
+		ID3D12DescriptorHeap* descriptorHeaps[] = { m_CbvSrvUavHeap->Heap() };
 		m_CommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
 		m_CommandList->SetGraphicsRootSignature(m_RootSignature.Get());
@@ -136,41 +223,45 @@ namespace Graphics
 		auto passCB = m_CurrentFrameResource->PassCB->Resource();
 		m_CommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
 
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::Opaque]);
+		// Instance, material and instance index buffers are shared by all draws.
+		m_CommandList->SetGraphicsRootShaderResourceView(3,
+			m_CurrentFrameResource->InstanceBuffer->Resource()->GetGPUVirtualAddress());
+		m_CommandList->SetGraphicsRootShaderResourceView(4,
+			m_CurrentFrameResource->MaterialBuffer->Resource()->GetGPUVirtualAddress());
+		m_CommandList->SetGraphicsRootShaderResourceView(5,
+			m_CurrentFrameResource->InstanceIndexBuffer->Resource()->GetGPUVirtualAddress());
+		// Every texture is in the table, materials select theirs by index.
+		m_CommandList->SetGraphicsRootDescriptorTable(0, m_CbvSrvUavHeap->GpuHandle(m_TextureTableIndex));
+
+		m_DrawState.Reset();
+
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::Opaque], "opaque");
 
 		// Mark the visible mirror pixels in the stencil buffer with the value 1
 		m_CommandList->OMSetStencilRef(1);
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["markStencilMirrors"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::Mirrors]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::Mirrors], "markStencilMirrors");
 
 		// Draw the reflection into the mirror only (only for pixels where the stencil buffer is 1).
 		// Note that we must supply a different per-pass constant buffer--one with the lights reflected.
 		m_CommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress() + 1 * passCBByteSize);
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["drawStencilReflections"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::Reflected]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::Reflected], "drawStencilReflections");
 
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["drawShadowReflections"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::ShadowReflected]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::ShadowReflected], "drawShadowReflections");
 
 		// Restore main pass constants and stencil ref.
 		m_CommandList->SetGraphicsRootConstantBufferView(2, passCB->GetGPUVirtualAddress());
 		m_CommandList->OMSetStencilRef(0);
 
 		// Draw mirror with transparency so reflection blends through.
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["transparent"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::Transparent]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::Transparent], "transparent");
 
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["alphaTested"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::AlphaTested]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::AlphaTested], "alphaTested");
 
 		// Draw shadows
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["shadow"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::Shadow]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::Shadow], "shadow");
 
-		m_CommandList->SetPipelineState(m_PipelineStateObjects["highlight"].Get());
-		DrawRenderItems(m_CommandList.Get(), m_RenderItemLayer[(int)RenderLayer::Highlight]);
+		DrawRenderItems(m_CommandList.Get(), m_VisibleBatches[(int)RenderLayer::Highlight], "highlight");
 
-		m_CommandList->SetDescriptorHeaps(1, &m_ShaderResourceViewHeap);
 		m_ImguiManager.DrawRenderData(m_CommandList.Get());
 
 		// Indicate a state transition on the resource usage.
@@ -196,6 +287,8 @@ namespace Graphics
 		// Because we are on the GPU timeline, the new fence point won't be 
 		// set until the GPU finishes processing all the commands prior to this Signal().
 		m_CommandQueue->Signal(m_Fence.Get(), m_CurrentFence);
+
+		m_CbvSrvUavHeap->EndFrame(m_CurrentFence);
 	}
 
 	void GraphicsClass::OnRightMouseDown(WPARAM buttonState, int x, int y)
@@ -275,118 +368,283 @@ namespace Graphics
 		m_ImguiManager.CameraPosition(m_Camera.GetPosition3f());
 	}
 
+	void GraphicsClass::UpdateCullingBounds(const Timer& gameTimer)
+	{
+		m_FrustumCuller.Resize((UINT)m_RenderItems.Count());
+
+		// The culler keeps world space bounds, so they only need to be refreshed
+		// for items whose world matrix has changed.
+		const auto& dirtyItems = m_CurrentFrameResource->DirtyRenderItems;
+		m_JobSystem.ParallelFor((UINT)dirtyItems.size(), RenderItemsPerJob, [&](UINT begin, UINT end)
+			{
+				for (UINT i = begin; i < end; ++i)
+				{
+					RenderItemHandle ri = dirtyItems[i];
+					// Destroyed after it was queued.
+					if (!m_RenderItems.IsValid(ri))
+						continue;
+
+					UINT index = m_RenderItems.IndexOf(ri);
+					m_FrustumCuller.UpdateBounds(index, m_RenderItems.Bounds(ri), m_RenderItems.Transform(ri).World);
+					m_FrustumCuller.SetAlwaysVisible(index, m_RenderItems.Flags(ri).FrustumTest == false);
+				}
+			});
+	}
+
 	void GraphicsClass::FrustumCulling(const Timer& gameTimer)
 	{
-		XMMATRIX view = m_Camera.GetView();
-		XMVECTOR detView = XMMatrixDeterminant(view);
-		XMMATRIX invView = XMMatrixInverse(&detView, view);
+		if (m_FrustumCullingIsEnabled)
+		{
+			XMMATRIX view = m_Camera.GetView();
+			XMVECTOR detView = XMMatrixDeterminant(view);
+			XMMATRIX invView = XMMatrixInverse(&detView, view);
+
+			// Transform the camera frustum from view space to world space once and
+			// test all the world space bounds against it.
+			BoundingFrustum worldSpaceFrustum;
+			m_CameraFrustum.Transform(worldSpaceFrustum, invView);
+			m_FrustumCuller.Cull(worldSpaceFrustum);
+		}
+		else
+		{
+			m_FrustumCuller.SetAllVisible();
+		}
+
+		// Sort the visible items back into their layers for drawing.
+		for (auto& layer : m_VisibleRenderItemLayer)
+			layer.clear();
 
-		for (auto& e : m_AllRenderItems)
+		const std::vector<RenderItemFlags>& flags = m_RenderItems.FlagsArray();
+		for (UINT i : m_FrustumCuller.VisibleIndices())
 		{
-			if (e.get()->FrustumTest)
+			for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
 			{
-				XMMATRIX world = XMLoadFloat4x4(&e->World);
-				XMMATRIX texTransform = XMLoadFloat4x4(&e->TexTransform);
+				if (flags[i].LayerMask & (1u << layer))
+					m_VisibleRenderItemLayer[layer].push_back(m_RenderItems.HandleAt(i));
+			}
+		}
+	}
+
+	void GraphicsClass::SelectLods(const Timer& gameTimer)
+	{
+		// Pixels covered by one world unit at a distance of one.
+		float pixelsPerUnit = m_ClientHeight / (2.0f * tanf(0.5f * m_Camera.GetFovY()));
+		XMVECTOR eye = m_Camera.GetPosition();
 
-				XMVECTOR detWorld = XMMatrixDeterminant(world);
-				XMMATRIX invWorld = XMMatrixInverse(&detWorld, world);
+		// Only the visible items, whose draw arguments the batching reads next.  Switching
+		// levels changes the draw ids, so this runs on one thread.
+		for (UINT i : m_FrustumCuller.VisibleIndices())
+		{
+			RenderItemHandle ri = m_RenderItems.HandleAt(i);
+			const RenderItemDrawArgs& drawArgs = m_RenderItems.DrawArgs(ri);
+			if (drawArgs.Submesh == nullptr || drawArgs.Submesh->Lods.size() < 2)
+				continue;
 
-				// View space to the object's local space.
-				XMMATRIX viewToLocal = XMMatrixMultiply(invView, invWorld);
+			float localRadius = m_RenderItems.Bounds(ri).Sphere.Radius;
+			if (localRadius <= 0.0f)
+				continue;
 
-				// Transform the camera frustum from view space to the object's local space.
-				BoundingFrustum localSpaceFrustum;
-				m_CameraFrustum.Transform(localSpaceFrustum, viewToLocal);
+			// Projected diameter of the bounding sphere, which also gives the pixels per
+			// unit of the item's local space the level errors are measured in.
+			BoundingSphere sphere = m_FrustumCuller.WorldSphere(i);
+			float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&sphere.Center) - eye)) - sphere.Radius;
+			distance = std::max<float>(distance, m_Camera.GetNearZ());
+			float projectedDiameter = 2.0f * sphere.Radius * pixelsPerUnit / distance;
+			float pixelsPerLocalUnit = projectedDiameter / (2.0f * localRadius);
 
-				// Perform the box/frustum intersection test in local space.
-				if ((localSpaceFrustum.Contains(e->Bounds) != DirectX::DISJOINT) || (m_FrustumCullingIsEnabled == false))
-					e->FrustumTestResult = true;
-				else
-					e->FrustumTestResult = false;
-			}
+			const std::vector<MeshLod>& lods = drawArgs.Submesh->Lods;
+			UINT lod = 0;
+			while (lod + 1 < lods.size() && lods[lod + 1].Error * pixelsPerLocalUnit <= MaxLodPixelError)
+				++lod;
+
+			if (lod == drawArgs.Lod)
+				continue;
+
+			RenderItemDrawArgs lodDrawArgs = drawArgs;
+			lodDrawArgs.Lod = lod;
+			lodDrawArgs.IndexCount = lods[lod].IndexCount;
+			lodDrawArgs.StartIndexLocation = drawArgs.Submesh->StartIndexLocation + lods[lod].FirstIndex;
+			m_RenderItems.SetDrawArgs(ri, lodDrawArgs);
 		}
 	}
 
-	void GraphicsClass::UpdateShadows(const Timer& gameTimer)
+	bool GraphicsClass::IsInvertibleAffine(const XMFLOAT4X4& world)
 	{
-		for (auto& e : m_AllRenderItems)
-		{
-			if (e->ShadowSource != nullptr)
+		if (world._14 != 0.0f || world._24 != 0.0f || world._34 != 0.0f || world._44 != 1.0f)
+			return false;
+
+		// Relative to the row lengths, so uniformly scaled items are treated alike.
+		XMMATRIX W = XMLoadFloat4x4(&world);
+		float det = XMVectorGetX(XMMatrixDeterminant(W));
+		float scale = XMVectorGetX(XMVector3Length(W.r[0])) * XMVectorGetX(XMVector3Length(W.r[1])) *
+			XMVectorGetX(XMVector3Length(W.r[2]));
+		return std::abs(det) > 1e-4f * scale;
+	}
+
+	void GraphicsClass::CullMeshlets(const Timer& gameTimer)
+	{
+		m_VisibleMeshlets.resize(m_RenderItems.Count());
+		m_MeshletsTested = 0;
+		m_MeshletsVisible = 0;
+
+		XMMATRIX viewProj = m_Camera.GetView() * m_Camera.GetProj();
+		XMVECTOR eye = m_Camera.GetPosition();
+		// Their pipelines draw back faces as well.
+		const UINT twoSidedLayers = (1u << (int)RenderLayer::AlphaTested) | (1u << (int)RenderLayer::Transparent);
+
+		const std::vector<UINT>& visibleIndices = m_FrustumCuller.VisibleIndices();
+		m_JobSystem.ParallelFor((UINT)visibleIndices.size(), RenderItemsPerJob, [&](UINT begin, UINT end)
 			{
-				// Update shadow world matrix.
-				XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f); // xz plane
-				XMVECTOR toMainLight = -XMLoadFloat3(&m_MainPassConstantBuffer.Lights[0].Direction);
-				XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
-				XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
-				XMStoreFloat4x4(&e->World, XMLoadFloat4x4(&e->ShadowSource->World) * S * shadowOffsetY);
-				e->NumFramesDirty = gNumFrameResources;
-			}
-		}
+				UINT tested = 0;
+				UINT visible = 0;
+				for (UINT j = begin; j < end; ++j)
+				{
+					UINT i = visibleIndices[j];
+					RenderItemHandle ri = m_RenderItems.HandleAt(i);
+					const RenderItemDrawArgs& drawArgs = m_RenderItems.DrawArgs(ri);
+					const RenderItemFlags& flags = m_RenderItems.Flags(ri);
+
+					VisibleMeshlets& meshlets = m_VisibleMeshlets[i];
+					meshlets.IsCulled = m_FrustumCullingIsEnabled && flags.FrustumTest && drawArgs.Submesh != nullptr &&
+						drawArgs.Lod == 0 && !drawArgs.Submesh->Meshlets.Empty() &&
+						IsInvertibleAffine(m_RenderItems.Transform(ri).World);
+					if (!meshlets.IsCulled)
+						continue;
+
+					// Frustum planes in the item's local space, pointing inwards.
+					XMMATRIX world = XMLoadFloat4x4(&m_RenderItems.Transform(ri).World);
+					XMMATRIX M = XMMatrixTranspose(world * viewProj);
+					XMVECTOR planeVectors[6] =
+					{
+						M.r[3] + M.r[0], M.r[3] - M.r[0],
+						M.r[3] + M.r[1], M.r[3] - M.r[1],
+						M.r[2], M.r[3] - M.r[2],
+					};
+					float planes[6][4];
+					for (int p = 0; p < 6; ++p)
+						XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(planes[p]), XMPlaneNormalize(planeVectors[p]));
+
+					XMVECTOR detWorld = XMMatrixDeterminant(world);
+					XMMATRIX invWorld = XMMatrixInverse(&detWorld, world);
+					XMFLOAT3 camera;
+					XMStoreFloat3(&camera, XMVector3TransformCoord(eye, invWorld));
+
+					bool backfaceCulling = (flags.LayerMask & twoSidedLayers) == 0;
+					tested += drawArgs.Submesh->Meshlets.MeshletCount();
+					visible += drawArgs.Submesh->Meshlets.Cull(planes, &camera.x, backfaceCulling, meshlets.Ranges);
+				}
+
+				m_MeshletsTested += tested;
+				m_MeshletsVisible += visible;
+			});
 	}
 
-	void GraphicsClass::UpdateReflections(const Timer& gameTimer)
+	void GraphicsClass::UpdateTransforms(const Timer& gameTimer)
 	{
-		XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f); // xy plane
-		XMMATRIX R = XMMatrixReflect(mirrorPlane);
-		for (auto& e : m_AllRenderItems)
+		XMVECTOR shadowPlane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f); // xz plane
+		XMVECTOR toMainLight = -XMLoadFloat3(&m_MainPassConstantBuffer.Lights[0].Direction);
+		XMMATRIX S = XMMatrixShadow(shadowPlane, toMainLight);
+		XMMATRIX shadowOffsetY = XMMatrixTranslation(0.0f, 0.001f, 0.0f);
+
+		XMFLOAT4X4 shadowTransform;
+		XMStoreFloat4x4(&shadowTransform, S * shadowOffsetY);
+
+		// The projection is the local transform of every shadow, so the shadows only need
+		// new locals when the light turns.  Otherwise they follow their caster.
+		if (memcmp(&shadowTransform, &m_ShadowTransform, sizeof(shadowTransform)) != 0)
 		{
-			if (e->ReflectionSource != nullptr)
+			m_ShadowTransform = shadowTransform;
+			for (RenderItemHandle ri : m_TransformNodeItems)
 			{
-				// Update reflection world matrix.
-				XMStoreFloat4x4(&e->World, XMLoadFloat4x4(&e->ReflectionSource->World) * R);
-				e->NumFramesDirty = gNumFrameResources;
+				const RenderItemInfo& info = m_RenderItems.Info(ri);
+				if (m_RenderItems.IsValid(info.ShadowSource) && !m_RenderItems.IsValid(info.ReflectionSource))
+					m_Transforms.SetLocal(m_RenderItems.Transform(ri).TransformNode, m_ShadowTransform);
 			}
 		}
+
+		PropagateTransforms();
 	}
 
-	void GraphicsClass::UpdateObjectConstantBuffers(const Timer& gameTimer)
+	void GraphicsClass::UpdateInstanceBuffer(const Timer& gameTimer)
 	{
-		auto currObjectCB = m_CurrentFrameResource->ObjectCB.get();
-		for (auto& e : m_AllRenderItems)
-		{
-			// Only update the cbuffer data if the constants have changed.  
-			// This needs to be tracked per frame resource.
-			if (e->NumFramesDirty > 0)
+		auto currInstanceBuffer = m_CurrentFrameResource->InstanceBuffer.get();
+		auto& dirtyItems = m_CurrentFrameResource->DirtyRenderItems;
+		UINT frameBit = 1u << m_CurrentFrameResourceIndex;
+
+		// Only the items whose data changed since this frame resource was last used are
+		// queued.  Every item writes its own instance buffer element, so ranges can be
+		// updated in parallel.
+		m_JobSystem.ParallelFor((UINT)dirtyItems.size(), RenderItemsPerJob, [&](UINT begin, UINT end)
 			{
-				DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&e->World);
-				DirectX::XMMATRIX texTransform = DirectX::XMLoadFloat4x4(&e->TexTransform);
+				for (UINT i = begin; i < end; ++i)
+				{
+					RenderItemHandle e = dirtyItems[i];
+					if (!m_RenderItems.IsValid(e))
+						continue;
 
-				ObjectConstants objConstants;
-				DirectX::XMStoreFloat4x4(&objConstants.World, DirectX::XMMatrixTranspose(world));
-				DirectX::XMStoreFloat4x4(&objConstants.TexTransform, DirectX::XMMatrixTranspose(texTransform));
+					const RenderItemTransform& transform = m_RenderItems.Transform(e);
 
-				currObjectCB->CopyData(e->ObjConstantBufferIndex, objConstants);
+					DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&transform.World);
+					DirectX::XMMATRIX texTransform = DirectX::XMLoadFloat4x4(&transform.TexTransform);
 
-				// Next FrameResource need to be updated too.
-				e->NumFramesDirty--;
-			}
-		}
+					InstanceData instanceData;
+					DirectX::XMStoreFloat4x4(&instanceData.World, DirectX::XMMatrixTranspose(world));
+					DirectX::XMStoreFloat4x4(&instanceData.TexTransform, DirectX::XMMatrixTranspose(texTransform));
+					instanceData.MaterialIndex = m_RenderItems.Mat(e)->MatCBIndex;
+
+					currInstanceBuffer->CopyData(transform.ObjConstantBufferIndex, instanceData);
+
+					m_RenderItems.Flags(e).DirtyFrameMask &= ~frameBit;
+				}
+			});
+
+		m_InstanceBytesWritten += dirtyItems.size() * sizeof(InstanceData);
+		dirtyItems.clear();
 	}
 
-	void GraphicsClass::UpdateMaterialConstantBuffers(const Timer& gameTimer)
+	void GraphicsClass::UpdateMaterialBuffer(const Timer& gameTimer)
 	{
-		auto currMaterialCB = m_CurrentFrameResource->MaterialCB.get();
-		for (auto& e : m_Materials)
+		auto currMaterialBuffer = m_CurrentFrameResource->MaterialBuffer.get();
+		UINT frameBit = 1u << m_CurrentFrameResourceIndex;
+
+		// Materials are only queued outside the update stages, so the list can be
+		// drained without taking the dirty lock.
+		auto& dirtyMaterials = m_CurrentFrameResource->DirtyMaterials;
+		for (Material* mat : dirtyMaterials)
 		{
-			// Only update the cbuffer data if the constants have changed.  If the cbuffer
-			// data changes, it needs to be updated for each FrameResource.
-			Material* mat = e.second.get();
+			DirectX::XMMATRIX matTransform = DirectX::XMLoadFloat4x4(&mat->MatTransform);
 
-			if (mat->NumFramesDirty > 0)
-			{
-				DirectX::XMMATRIX matTransform = DirectX::XMLoadFloat4x4(&mat->MatTransform);
+			MaterialConstants matConstants;
+			matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
+			matConstants.FresnelR0 = mat->FresnelR0;
+			matConstants.Roughness = mat->Roughness;
+			matConstants.DiffuseMapIndex = (UINT)mat->DiffuseSrvHeapIndex;
+			DirectX::XMStoreFloat4x4(&matConstants.MatTransform, DirectX::XMMatrixTranspose(matTransform));
 
-				MaterialConstants matConstants;
-				matConstants.DiffuseAlbedo = mat->DiffuseAlbedo;
-				matConstants.FresnelR0 = mat->FresnelR0;
-				matConstants.Roughness = mat->Roughness;
-				DirectX::XMStoreFloat4x4(&matConstants.MatTransform, DirectX::XMMatrixTranspose(matTransform));
+			currMaterialBuffer->CopyData(mat->MatCBIndex, matConstants);
 
-				currMaterialCB->CopyData(mat->MatCBIndex, matConstants);
-				// Next FrameResource need to be updated too.
-				mat->NumFramesDirty--;
-			}
+			mat->DirtyFrameMask &= ~frameBit;
 		}
+
+		m_MaterialBytesWritten += dirtyMaterials.size() * sizeof(MaterialConstants);
+		dirtyMaterials.clear();
+	}
+
+	void GraphicsClass::BuildInstanceBatches(const Timer& gameTimer)
+	{
+		m_InstanceBatcher.Clear();
+		m_InstanceBatcher.SetView(m_MainPassConstantBuffer.EyePosW, m_MainPassConstantBuffer.FarZ);
+		for (int layer = 0; layer < (int)RenderLayer::Count; ++layer)
+		{
+			bool backToFront = layer == (int)RenderLayer::Transparent;
+			m_VisibleBatches[layer] = m_InstanceBatcher.Add(m_RenderItems, m_VisibleRenderItemLayer[layer], backToFront);
+		}
+
+		// The instance indices are the only per-draw data, uploaded in one copy.
+		const std::vector<UINT>& instances = m_InstanceBatcher.Instances();
+		if (!instances.empty())
+			m_CurrentFrameResource->InstanceIndexBuffer->CopyData(0, instances.data(), (UINT)instances.size());
+		m_InstanceBytesWritten += instances.size() * sizeof(UINT);
 	}
 
 	void GraphicsClass::UpdateMainPassConstantBuffer(const Timer& gameTimer)
@@ -423,6 +681,7 @@ namespace Graphics
 
 		auto currPassCB = m_CurrentFrameResource->PassCB.get();
 		currPassCB->CopyData(0, m_MainPassConstantBuffer);
+		m_PassCBBytesWritten += sizeof(PassConstants);
 	}
 
 	void GraphicsClass::UpdateReflectedPassConstantBuffer(const Timer& gameTimer)
@@ -440,62 +699,67 @@ namespace Graphics
 		// Reflected pass stored in index 1
 		auto currPassCB = m_CurrentFrameResource->PassCB.get();
 		currPassCB->CopyData(1, m_ReflectedPassCB);
+		m_PassCBBytesWritten += sizeof(PassConstants);
 	}
 
 	void GraphicsClass::LoadTextures()
 	{
-		auto bricksTex = std::make_unique<Texture>();
-		bricksTex->Name = "bricksTex";
-		bricksTex->Filename = L"..\\Engine\\Content\\Textures\\bricks3.dds";
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(m_d3dDevice.Get(),
-			m_CommandList.Get(), bricksTex->Filename.c_str(),
-			bricksTex->Resource, bricksTex->UploadHeap));
-
-		auto checkboardTex = std::make_unique<Texture>();
-		checkboardTex->Name = "checkboardTex";
-		checkboardTex->Filename = L"..\\Engine\\Content\\Textures\\checkboard.dds";
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(m_d3dDevice.Get(),
-			m_CommandList.Get(), checkboardTex->Filename.c_str(),
-			checkboardTex->Resource, checkboardTex->UploadHeap));
-
-		auto iceTex = std::make_unique<Texture>();
-		iceTex->Name = "iceTex";
-		iceTex->Filename = L"..\\Engine\\Content\\Textures\\ice.dds";
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(m_d3dDevice.Get(),
-			m_CommandList.Get(), iceTex->Filename.c_str(),
-			iceTex->Resource, iceTex->UploadHeap));
-
-		auto white1x1Tex = std::make_unique<Texture>();
-		white1x1Tex->Name = "white1x1Tex";
-		white1x1Tex->Filename = L"..\\Engine\\Content\\Textures\\white1x1.dds";
-		ThrowIfFailed(DirectX::CreateDDSTextureFromFile12(m_d3dDevice.Get(),
-			m_CommandList.Get(), white1x1Tex->Filename.c_str(),
-			white1x1Tex->Resource, white1x1Tex->UploadHeap));
-
-		m_Textures[bricksTex->Name] = std::move(bricksTex);
-		m_Textures[checkboardTex->Name] = std::move(checkboardTex);
-		m_Textures[iceTex->Name] = std::move(iceTex);
-		m_Textures[white1x1Tex->Name] = std::move(white1x1Tex);
+		const std::vector<std::pair<std::string, std::wstring>> textureFiles =
+		{
+			{ "bricksTex", L"..\\Engine\\Content\\Textures\\bricks3.dds" },
+			{ "checkboardTex", L"..\\Engine\\Content\\Textures\\checkboard.dds" },
+			{ "iceTex", L"..\\Engine\\Content\\Textures\\ice.dds" },
+			{ "white1x1Tex", L"..\\Engine\\Content\\Textures\\white1x1.dds" },
+		};
+
+		// The files are read, validated and laid out on the job threads.  This part does
+		// not touch the device.
+		std::vector<DirectX::DDSTextureData> textureData(textureFiles.size());
+		std::vector<HRESULT> results(textureFiles.size());
+		m_JobSystem.ParallelFor((UINT)textureFiles.size(), 1, [&](UINT begin, UINT end)
+			{
+				for (UINT i = begin; i < end; ++i)
+					results[i] = DirectX::LoadDDSTextureData(textureFiles[i].second.c_str(), textureData[i]);
+			});
+
+		// Then all the textures are created and their uploads recorded on the command list
+		// that carries the rest of the initialization.
+		for (size_t i = 0; i < textureFiles.size(); ++i)
+		{
+			ThrowIfFailed(results[i]);
+
+			auto tex = std::make_unique<Texture>();
+			tex->Name = textureFiles[i].first;
+			tex->Filename = textureFiles[i].second;
+			ThrowIfFailed(DirectX::CreateDDSTextureFromData12(m_d3dDevice.Get(),
+				m_CommandList.Get(), textureData[i], tex->Resource, tex->UploadHeap));
+
+			m_Textures[tex->Name] = std::move(tex);
+		}
 	}
 
 	void GraphicsClass::BuildRootSignature()
 	{
 		CD3DX12_DESCRIPTOR_RANGE texTable;
-		texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
+		texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, MaxTextures, 0);
 
 		// Root parameter can be a table, root descriptor or root constants.
-		CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+		CD3DX12_ROOT_PARAMETER slotRootParameter[6];
 
 		// Create root CBV.
 		slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
-		slotRootParameter[1].InitAsConstantBufferView(0);
+		// Base instance and the position quantization of packed vertices.
+		slotRootParameter[1].InitAsConstants(7, 0);
 		slotRootParameter[2].InitAsConstantBufferView(1);
-		slotRootParameter[3].InitAsConstantBufferView(2);
+		// Structured buffers of the instances, materials and this frame's instance indices.
+		slotRootParameter[3].InitAsShaderResourceView(0, 1);
+		slotRootParameter[4].InitAsShaderResourceView(1, 1);
+		slotRootParameter[5].InitAsShaderResourceView(2, 1);
 
 		auto staticSamplers = GetStaticSamplers();
 
 		// A root signature is an array of root parameters.
-		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+		CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(6, slotRootParameter,
 			(UINT)staticSamplers.size(), staticSamplers.data(),
 			D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -520,68 +784,86 @@ namespace Graphics
 
 	void GraphicsClass::BuildDescriptorHeaps()
 	{
-		// Create the SRV heap.
-		D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-		srvHeapDesc.NumDescriptors = 4;
-		srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-		srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-		ThrowIfFailed(m_d3dDevice->CreateDescriptorHeap(
-			&srvHeapDesc, IID_PPV_ARGS(&m_ShaderResourceViewDescriptorHeap)));
-
-		// Fill out the heap with actual descriptors.
-		CD3DX12_CPU_DESCRIPTOR_HANDLE hDescriptor(
-			m_ShaderResourceViewDescriptorHeap->GetCPUDescriptorHandleForHeapStart());
-
-		auto bricksTex = m_Textures["bricksTex"]->Resource;
-		auto checkboardTex = m_Textures["checkboardTex"]->Resource;
-		auto iceTex = m_Textures["iceTex"]->Resource;
-		auto white1x1Tex = m_Textures["white1x1Tex"]->Resource;
+		// The texture table is one persistent range of the shared heap.
+		m_TextureTableIndex = m_CbvSrvUavHeap->AllocatePersistent(MaxTextures);
 
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-		srvDesc.Format = bricksTex->GetDesc().Format;
+		srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
 		srvDesc.Texture2D.MostDetailedMip = 0;
 		srvDesc.Texture2D.MipLevels = -1;
-		m_d3dDevice->CreateShaderResourceView(bricksTex.Get(), &srvDesc, hDescriptor);
 
-		// next descriptor
-		hDescriptor.Offset(1, m_CbvSrvDescriptorSize);
+		// The whole table is bound, so the unused entries get null descriptors.
+		for (UINT i = 0; i < MaxTextures; ++i)
+			m_d3dDevice->CreateShaderResourceView(nullptr, &srvDesc, m_CbvSrvUavHeap->CpuHandle(m_TextureTableIndex + i));
 
-		srvDesc.Format = checkboardTex->GetDesc().Format;
-		m_d3dDevice->CreateShaderResourceView(checkboardTex.Get(), &srvDesc, hDescriptor);
+		for (auto& e : m_Textures)
+		{
+			UINT index = m_TextureRegistry.Register(e.first);
+			if (index == TextureRegistry::InvalidIndex)
+				ThrowIfFailed(E_OUTOFMEMORY);
+
+			auto resource = e.second->Resource;
+			srvDesc.Format = resource->GetDesc().Format;
+			m_d3dDevice->CreateShaderResourceView(resource.Get(), &srvDesc,
+				m_CbvSrvUavHeap->CpuHandle(m_TextureTableIndex + index));
+		}
+	}
 
-		// next descriptor
-		hDescriptor.Offset(1, m_CbvSrvDescriptorSize);
+	void GraphicsClass::BuildShadersAndInputLayout()
+	{
+		const std::wstring shaderPath = L"..\\Engine\\Shaders\\Default.hlsl";
+		const std::wstring cachePath = L"..\\Engine\\Shaders\\ShaderCache.bin";
+		const UINT flags = d3dUtil::ShaderCompileFlags();
 
-		srvDesc.Format = iceTex->GetDesc().Format;
-		m_d3dDevice->CreateShaderResourceView(iceTex.Get(), &srvDesc, hDescriptor);
+		// The shader declares the texture table with the size of the root signature's range.
+		const std::string maxTextures = std::to_string(MaxTextures);
 
-		// next descriptor
-		hDescriptor.Offset(1, m_CbvSrvDescriptorSize);
+		const std::vector<ShaderDefine> defines =
+		{
+			{ "FOG", "1" },
+			{ "MAX_TEXTURES", maxTextures },
+		};
 
-		srvDesc.Format = white1x1Tex->GetDesc().Format;
-		m_d3dDevice->CreateShaderResourceView(white1x1Tex.Get(), &srvDesc, hDescriptor);
-	}
+		const std::vector<ShaderDefine> alphaTestDefines =
+		{
+			{ "FOG", "1" },
+			{ "ALPHA_TEST", "1" },
+			{ "MAX_TEXTURES", maxTextures },
+		};
 
-	void GraphicsClass::BuildShadersAndInputLayout()
-	{
-		const D3D_SHADER_MACRO defines[] =
+		const std::vector<ShaderDefine> packedDefines =
 		{
-			"FOG", "1",
-			NULL, NULL
+			{ "PACKED_VERTICES", "1" },
 		};
 
-		const D3D_SHADER_MACRO alphaTestDefines[] =
+		const char* shaderNames[] = { "standardVS", "packedVS", "opaquePS", "alphaTestedPS" };
+		const std::vector<ShaderKey> shaderKeys =
 		{
-			"FOG", "1",
-			"ALPHA_TEST", "1",
-			NULL, NULL
+			{ shaderPath, {}, "VS", "vs_5_1", flags },
+			{ shaderPath, packedDefines, "VS", "vs_5_1", flags },
+			{ shaderPath, defines, "PS", "ps_5_1", flags },
+			{ shaderPath, alphaTestDefines, "PS", "ps_5_1", flags },
 		};
 
-		m_Shaders["standardVS"] = d3dUtil::CompileShader(L"..\\Engine\\Shaders\\Default.hlsl", nullptr, "VS", "vs_5_0");
-		m_Shaders["opaquePS"] = d3dUtil::CompileShader(L"..\\Engine\\Shaders\\Default.hlsl", defines, "PS", "ps_5_0");
-		m_Shaders["alphaTestedPS"] = d3dUtil::CompileShader(L"..\\Engine\\Shaders\\Default.hlsl", alphaTestDefines, "PS", "ps_5_0");
+		auto start = std::chrono::steady_clock::now();
+
+		// Only the shaders missing from the cache are compiled, in parallel.
+		ShaderCache shaderCache;
+		shaderCache.Load(cachePath);
+		std::vector<ShaderCache::Bytecode> bytecodes = shaderCache.GetOrCompile(
+			shaderKeys, [](const ShaderKey& key) { return d3dUtil::CompileShader(key); }, &m_JobSystem);
+
+		for (size_t i = 0; i < shaderKeys.size(); ++i)
+			m_Shaders[shaderNames[i]] = d3dUtil::CreateBlob(bytecodes[i]);
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Logger::PrintLog(L"Loaded %u shaders (%u compiled) in %.2f ms\n",
+			(UINT)shaderKeys.size(), shaderCache.Misses(), ms);
+
+		if (shaderCache.IsDirty() && !shaderCache.Save(cachePath))
+			Logger::PrintLog(L"Could not write %s\n", cachePath.c_str());
 
 		m_InputLayout =
 		{
@@ -589,6 +871,14 @@ namespace Graphics
 			{ "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 			{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
 		};
+
+		// PackedVertex, decoded by the packedVS.
+		m_PackedInputLayout =
+		{
+			{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_UNORM, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+			{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
+		};
 	}
 
 	void GraphicsClass::BuildRoomGeometry()
@@ -673,11 +963,9 @@ namespace Graphics
 		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		geo->VertexBufferGPU = m_UploadService->CreateDefaultBuffer(vertices.data(), vbByteSize);
 
-		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		geo->IndexBufferGPU = m_UploadService->CreateDefaultBuffer(indices.data(), ibByteSize);
 
 		geo->VertexByteStride = sizeof(Vertex);
 		geo->VertexBufferByteSize = vbByteSize;
@@ -693,32 +981,31 @@ namespace Graphics
 
 	void GraphicsClass::BuildPipelineStateObjects()
 	{
-		// PSO for opaque objects.
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
-		ZeroMemory(&opaquePsoDesc, sizeof(D3D12_GRAPHICS_PIPELINE_STATE_DESC));
-		opaquePsoDesc.InputLayout = { m_InputLayout.data(), (UINT)m_InputLayout.size() };
-		opaquePsoDesc.pRootSignature = m_RootSignature.Get();
-		opaquePsoDesc.VS =
-		{
-			reinterpret_cast<BYTE*>(m_Shaders["standardVS"]->GetBufferPointer()),
-			m_Shaders["standardVS"]->GetBufferSize()
-		};
-		opaquePsoDesc.PS =
+		const std::wstring cachePath = L"..\\Engine\\Shaders\\PipelineCache.bin";
+
+		m_PipelineStates = std::make_unique<PipelineStateManager>(m_d3dDevice.Get(), m_RootSignature.Get(), m_InputLayout);
+		m_PipelineStates->Load(cachePath);
+
+		// Every pipeline also gets a variant for geometry with packed vertices.
+		auto addPipeline = [this](const std::string& name, const GraphicsPipelineDesc& desc)
 		{
-			reinterpret_cast<BYTE*>(m_Shaders["opaquePS"]->GetBufferPointer()),
-			m_Shaders["opaquePS"]->GetBufferSize()
+			m_PipelineStates->Add(name, desc);
+
+			GraphicsPipelineDesc packedDesc = desc;
+			packedDesc.VS = m_Shaders["packedVS"];
+			packedDesc.InputLayout = m_PackedInputLayout;
+			m_PipelineStates->Add(name + "Packed", packedDesc);
 		};
-		opaquePsoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-		opaquePsoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-		opaquePsoDesc.DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
-		opaquePsoDesc.SampleMask = UINT_MAX;
-		opaquePsoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-		opaquePsoDesc.NumRenderTargets = 1;
-		opaquePsoDesc.RTVFormats[0] = m_BackBufferFormat;
+
+		// PSO for opaque objects.
+		GraphicsPipelineDesc opaquePsoDesc;
+		opaquePsoDesc.VS = m_Shaders["standardVS"];
+		opaquePsoDesc.PS = m_Shaders["opaquePS"];
+		opaquePsoDesc.RTVFormat = m_BackBufferFormat;
 		opaquePsoDesc.SampleDesc.Count = Get4xMsaaState() ? 4 : 1;
 		opaquePsoDesc.SampleDesc.Quality = Get4xMsaaState() ? (Get4xMsaaQuality() - 1) : 0;
 		opaquePsoDesc.DSVFormat = m_DepthStencilFormat;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["opaque"])));
+		addPipeline("opaque", opaquePsoDesc);
 
 		// PSO for marking stencil mirrors.
 		CD3DX12_BLEND_DESC mirrorBlendState(D3D12_DEFAULT);
@@ -739,10 +1026,10 @@ namespace Graphics
 		mirrorDSS.BackFace.StencilDepthFailOp = D3D12_STENCIL_OP_KEEP;
 		mirrorDSS.BackFace.StencilPassOp = D3D12_STENCIL_OP_REPLACE;
 		mirrorDSS.BackFace.StencilFunc = D3D12_COMPARISON_FUNC_ALWAYS;
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC markMirrorsPsoDesc = opaquePsoDesc;
+		GraphicsPipelineDesc markMirrorsPsoDesc = opaquePsoDesc;
 		markMirrorsPsoDesc.BlendState = mirrorBlendState;
 		markMirrorsPsoDesc.DepthStencilState = mirrorDSS;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&markMirrorsPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["markStencilMirrors"])));
+		addPipeline("markStencilMirrors", markMirrorsPsoDesc);
 
 		// PSO for stencil reflections.
 		D3D12_DEPTH_STENCIL_DESC reflectionsDSS;
@@ -761,14 +1048,14 @@ namespace Graphics
 		reflectionsDSS.BackFace.StencilDepthFailOp = D3D12_STENCIL_OP_KEEP;
 		reflectionsDSS.BackFace.StencilPassOp = D3D12_STENCIL_OP_KEEP;
 		reflectionsDSS.BackFace.StencilFunc = D3D12_COMPARISON_FUNC_EQUAL;
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC drawReflectionsPsoDesc = opaquePsoDesc;
+		GraphicsPipelineDesc drawReflectionsPsoDesc = opaquePsoDesc;
 		drawReflectionsPsoDesc.DepthStencilState = reflectionsDSS;
 		drawReflectionsPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
 		drawReflectionsPsoDesc.RasterizerState.FrontCounterClockwise = true;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&drawReflectionsPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["drawStencilReflections"])));
+		addPipeline("drawStencilReflections", drawReflectionsPsoDesc);
 
 		// PSO for transparent objects
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC transparentPsoDesc = opaquePsoDesc;
+		GraphicsPipelineDesc transparentPsoDesc = opaquePsoDesc;
 		D3D12_RENDER_TARGET_BLEND_DESC transparencyBlendDesc;
 		transparencyBlendDesc.BlendEnable = true;
 		transparencyBlendDesc.LogicOpEnable = false;
@@ -781,17 +1068,13 @@ namespace Graphics
 		transparencyBlendDesc.LogicOp = D3D12_LOGIC_OP_NOOP;
 		transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
 		transparentPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&transparentPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["transparent"])));
+		addPipeline("transparent", transparentPsoDesc);
 
 		// PSO for alpha tested objects
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC alphaTestedPsoDesc = opaquePsoDesc;
-		alphaTestedPsoDesc.PS =
-		{
-			reinterpret_cast<BYTE*>(m_Shaders["alphaTestedPS"]->GetBufferPointer()),
-			m_Shaders["alphaTestedPS"]->GetBufferSize()
-		};
+		GraphicsPipelineDesc alphaTestedPsoDesc = opaquePsoDesc;
+		alphaTestedPsoDesc.PS = m_Shaders["alphaTestedPS"];
 		alphaTestedPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&alphaTestedPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["alphaTested"])));
+		addPipeline("alphaTested", alphaTestedPsoDesc);
 
 		// PSO for shadow objects
 		// We are going to draw shadows with transparency, so base it off the transparency description.
@@ -811,19 +1094,19 @@ namespace Graphics
 		shadowDSS.BackFace.StencilDepthFailOp = D3D12_STENCIL_OP_KEEP;
 		shadowDSS.BackFace.StencilPassOp = D3D12_STENCIL_OP_INCR;
 		shadowDSS.BackFace.StencilFunc = D3D12_COMPARISON_FUNC_EQUAL;
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC shadowPsoDesc = transparentPsoDesc;
+		GraphicsPipelineDesc shadowPsoDesc = transparentPsoDesc;
 		shadowPsoDesc.DepthStencilState = shadowDSS;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&shadowPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["shadow"])));
+		addPipeline("shadow", shadowPsoDesc);
 
 		// PSO for shadow reflections
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC drawShadowReflectionsPsoDesc = transparentPsoDesc;
+		GraphicsPipelineDesc drawShadowReflectionsPsoDesc = transparentPsoDesc;
 		drawShadowReflectionsPsoDesc.DepthStencilState = shadowDSS;
 		drawShadowReflectionsPsoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_BACK;
 		drawShadowReflectionsPsoDesc.RasterizerState.FrontCounterClockwise = true;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&drawShadowReflectionsPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["drawShadowReflections"])));
+		addPipeline("drawShadowReflections", drawShadowReflectionsPsoDesc);
 		
 		// PSO for highlight objects
-		D3D12_GRAPHICS_PIPELINE_STATE_DESC highlightPsoDesc = opaquePsoDesc;
+		GraphicsPipelineDesc highlightPsoDesc = opaquePsoDesc;
 		highlightPsoDesc.RasterizerState.FillMode = D3D12_FILL_MODE_WIREFRAME;
 		// Change the depth test from < to <= so that if we draw the same triangle twice, it will
 		// still pass the depth test.  This is needed because we redraw the picked triangle with a
@@ -842,15 +1125,32 @@ namespace Graphics
 		transparencyBlendDesc.LogicOp = D3D12_LOGIC_OP_NOOP;
 		transparencyBlendDesc.RenderTargetWriteMask = D3D12_COLOR_WRITE_ENABLE_ALL;
 		highlightPsoDesc.BlendState.RenderTarget[0] = transparencyBlendDesc;
-		ThrowIfFailed(m_d3dDevice->CreateGraphicsPipelineState(&highlightPsoDesc, IID_PPV_ARGS(&m_PipelineStateObjects["highlight"])));
+		addPipeline("highlight", highlightPsoDesc);
+
+		auto start = std::chrono::steady_clock::now();
+
+		// Identical descriptions share one pipeline, the rest are created in parallel.
+		m_PipelineStates->CreatePending(&m_JobSystem);
+
+		const PipelineCache& cache = m_PipelineStates->Cache();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Logger::PrintLog(L"Created %u pipelines (%u shared, %u from cache) in %.2f ms\n",
+			cache.PipelineCount(), cache.DuplicateCount(), cache.CachedCount(), ms);
+
+		if (cache.IsDirty() && !m_PipelineStates->Save(cachePath))
+			Logger::PrintLog(L"Could not write %s\n", cachePath.c_str());
 	}
 
 	void GraphicsClass::BuildShapeGeometry()
 	{
-		GeometryGenerator geoGen;
-		GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
-		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-		GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
+		// The generator writes straight into the vertex buffer.  The shapes are untextured,
+		// their texture coordinates stay zero.
+		const GeometryGenerator::VertexLayout layout = { sizeof(Vertex), offsetof(Vertex, Normal),
+			GeometryGenerator::NoAttribute, GeometryGenerator::NoAttribute };
+
+		GeometryGenerator::MeshSize boxSize = GeometryGenerator::BoxSize(3);
+		GeometryGenerator::MeshSize sphereSize = GeometryGenerator::SphereSize(20, 20);
+		GeometryGenerator::MeshSize cylinderSize = GeometryGenerator::CylinderSize(20, 20);
 
 		//
 		// We are concatenating all the geometry into one big vertex/index buffer.  So
@@ -859,231 +1159,173 @@ namespace Graphics
 
 		// Cache the vertex offsets to each object in the concatenated vertex buffer.
 		UINT boxVertexOffset = 0;
-		UINT sphereVertexOffset = boxVertexOffset + (UINT)box.Vertices.size();
-		UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
-
-		// Cache the starting index for each object in the concatenated index buffer.
-		UINT boxIndexOffset = 0;
-		UINT sphereIndexOffset = boxIndexOffset + (UINT)box.Indices32.size();
-		UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
-
-		//
-		// Extract the vertex elements we are interested in and pack the
-		// vertices of all the meshes into one vertex buffer.
-		//
-		auto totalVertexCount =
-			box.Vertices.size() +
-			sphere.Vertices.size() +
-			cylinder.Vertices.size();
+		UINT sphereVertexOffset = boxVertexOffset + boxSize.VertexCount;
+		UINT cylinderVertexOffset = sphereVertexOffset + sphereSize.VertexCount;
 
-		std::vector<Vertex> vertices(totalVertexCount);
+		std::vector<Vertex> vertices(cylinderVertexOffset + cylinderSize.VertexCount);
 
-		XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-		XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-		XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-		XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-		UINT k = 0;
-		for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
-		{
-			vertices[k].Pos = box.Vertices[i].Position;
-			vertices[k].Normal = box.Vertices[i].Normal;
-
-			XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-			vertices[i].TexC = { 0.0f, 0.0f };
-
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
-		}
+		// The passes below work on 32-bit indices and append the levels of detail.
+		std::vector<std::uint32_t> boxIndices(boxSize.IndexCount);
+		std::vector<std::uint32_t> sphereIndices(sphereSize.IndexCount);
+		std::vector<std::uint32_t> cylinderIndices(cylinderSize.IndexCount);
 
-		BoundingBox boxBounds;
-		XMStoreFloat3(&boxBounds.Center, 0.5f * (vMin + vMax));
-		XMStoreFloat3(&boxBounds.Extents, 0.5f * (vMax - vMin));
-
-		vMin = XMLoadFloat3(&vMinf3);
-		vMax = XMLoadFloat3(&vMaxf3);
-
-		for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
-		{
-			vertices[k].Pos = sphere.Vertices[i].Position;
-			vertices[k].Normal = sphere.Vertices[i].Normal;
-
-			XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-			vertices[i].TexC = { 0.0f, 0.0f };
-
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
-		}
+		GeometryGenerator geoGen;
+		geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3,
+			{ &vertices[boxVertexOffset], layout, boxIndices.data(), sizeof(std::uint32_t) });
+		geoGen.CreateSphere(0.5f, 20, 20,
+			{ &vertices[sphereVertexOffset], layout, sphereIndices.data(), sizeof(std::uint32_t) });
+		geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20,
+			{ &vertices[cylinderVertexOffset], layout, cylinderIndices.data(), sizeof(std::uint32_t) });
+
+		// The shapes are convex, their clusters do not occlude each other.
+		GeometryGenerator::PreparedMesh box = GeometryGenerator::Prepare(&vertices[boxVertexOffset], layout,
+			boxSize.VertexCount, boxIndices, false);
+		GeometryGenerator::PreparedMesh sphere = GeometryGenerator::Prepare(&vertices[sphereVertexOffset], layout,
+			sphereSize.VertexCount, sphereIndices, false);
+		GeometryGenerator::PreparedMesh cylinder = GeometryGenerator::Prepare(&vertices[cylinderVertexOffset], layout,
+			cylinderSize.VertexCount, cylinderIndices, false);
+
+		MeshletCuller boxMeshlets(box.Meshlets);
+		MeshletCuller sphereMeshlets(sphere.Meshlets);
+		MeshletCuller cylinderMeshlets(cylinder.Meshlets);
 
-		BoundingBox sphereBounds;
-		XMStoreFloat3(&sphereBounds.Center, 0.5f * (vMin + vMax));
-		XMStoreFloat3(&sphereBounds.Extents, 0.5f * (vMax - vMin));
+		// Cache the starting index for each object in the concatenated index buffer.
+		UINT boxIndexOffset = 0;
+		UINT sphereIndexOffset = boxIndexOffset + (UINT)boxIndices.size();
+		UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphereIndices.size();
 
-		vMin = XMLoadFloat3(&vMinf3);
-		vMax = XMLoadFloat3(&vMaxf3);
+		BoundingVolumes boxBounds = BoundsBuilder::Build(&vertices[boxVertexOffset].Pos, sizeof(Vertex), boxSize.VertexCount);
+		BoundingVolumes sphereBounds = BoundsBuilder::Build(&vertices[sphereVertexOffset].Pos, sizeof(Vertex), sphereSize.VertexCount);
+		BoundingVolumes cylinderBounds = BoundsBuilder::Build(&vertices[cylinderVertexOffset].Pos, sizeof(Vertex), cylinderSize.VertexCount);
 
-		for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+		std::vector<std::uint16_t> indices;
+		indices.reserve(cylinderIndexOffset + cylinderIndices.size());
+		for (const std::vector<std::uint32_t>* shapeIndices : { &boxIndices, &sphereIndices, &cylinderIndices })
 		{
-			vertices[k].Pos = cylinder.Vertices[i].Position;
-			vertices[k].Normal = cylinder.Vertices[i].Normal;
-
-			XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-			vertices[i].TexC = { 0.0f, 0.0f };
-
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
+			for (std::uint32_t index : *shapeIndices)
+				indices.push_back((std::uint16_t)index);
 		}
 
-		BoundingBox cylinderBounds;
-		XMStoreFloat3(&cylinderBounds.Center, 0.5f * (vMin + vMax));
-		XMStoreFloat3(&cylinderBounds.Extents, 0.5f * (vMax - vMin));
-
-		std::vector<std::uint16_t> indices;
-		indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-		indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-		indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
-
-		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
 
 		auto geo = std::make_unique<MeshGeometry>();
 		geo->Name = "shapeGeo";
 
-		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
 		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
 		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
 
-		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		geo->IndexBufferGPU = m_UploadService->CreateDefaultBuffer(indices.data(), ibByteSize);
 
-		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-		geo->VertexByteStride = sizeof(Vertex);
-		geo->VertexBufferByteSize = vbByteSize;
 		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
 		geo->IndexBufferByteSize = ibByteSize;
 
 		SubmeshGeometry boxSubmesh;
-		boxSubmesh.IndexCount = (UINT)box.Indices32.size();
+		boxSubmesh.IndexCount = box.Lods[0].IndexCount;
 		boxSubmesh.StartIndexLocation = boxIndexOffset;
 		boxSubmesh.BaseVertexLocation = boxVertexOffset;
+		boxSubmesh.VertexCount = boxSize.VertexCount;
 		boxSubmesh.Bounds = boxBounds;
 
 		SubmeshGeometry sphereSubmesh;
-		sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+		sphereSubmesh.IndexCount = sphere.Lods[0].IndexCount;
 		sphereSubmesh.StartIndexLocation = sphereIndexOffset;
 		sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
-		boxSubmesh.Bounds = sphereBounds;
+		sphereSubmesh.VertexCount = sphereSize.VertexCount;
+		sphereSubmesh.Bounds = sphereBounds;
 
 		SubmeshGeometry cylinderSubmesh;
-		cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
+		cylinderSubmesh.IndexCount = cylinder.Lods[0].IndexCount;
 		cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 		cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
-		boxSubmesh.Bounds = cylinderBounds;
+		cylinderSubmesh.VertexCount = cylinderSize.VertexCount;
+		cylinderSubmesh.Bounds = cylinderBounds;
+
+		boxSubmesh.Lods = box.Lods;
+		sphereSubmesh.Lods = sphere.Lods;
+		cylinderSubmesh.Lods = cylinder.Lods;
+
+		boxSubmesh.Meshlets = boxMeshlets;
+		sphereSubmesh.Meshlets = sphereMeshlets;
+		cylinderSubmesh.Meshlets = cylinderMeshlets;
 
 		geo->DrawArgs["box"] = boxSubmesh;
 		geo->DrawArgs["sphere"] = sphereSubmesh;
 		geo->DrawArgs["cylinder"] = cylinderSubmesh;
 
+		CreateVertexBuffer(geo.get(), vertices.data(), (UINT)vertices.size());
+		BuildTriangleBvhs(geo.get());
+
 		m_Geometries[geo->Name] = std::move(geo);
 	}
 
-	void GraphicsClass::BuildCarGeometry()
+	bool GraphicsClass::LoadModel(const std::wstring& name, MeshFile& meshFile)
 	{
-		std::ifstream fin(L"..\\Engine\\Content\\Models\\car.txt");
+		const std::wstring textPath = L"..\\Engine\\Content\\Models\\" + name + L".txt";
+		const std::wstring meshPath = L"..\\Engine\\Content\\Models\\" + name + L".mesh";
 
-		if (!fin)
-		{
-			MessageBox(0, L"Models/car.txt not found.", 0, 0);
-			return;
-		}
-
-		UINT vcount = 0;
-		UINT tcount = 0;
-		std::string ignore;
-
-		fin >> ignore >> vcount;
-		fin >> ignore >> tcount;
-		fin >> ignore >> ignore >> ignore >> ignore;
+		auto start = std::chrono::steady_clock::now();
 
-		XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-		XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-		XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-		XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-		std::vector<Vertex> vertices(vcount);
-		for (UINT i = 0; i < vcount; ++i)
+		// Use the binary cache unless the text model changed since it was written.
+		if (meshFile.Open(meshPath) && meshFile.IsUpToDate(textPath))
 		{
-			fin >> vertices[i].Pos.x >> vertices[i].Pos.y >> vertices[i].Pos.z;
-			fin >> vertices[i].Normal.x >> vertices[i].Normal.y >> vertices[i].Normal.z;
-
-			XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
-
-			vertices[i].TexC = { 0.0f, 0.0f };
-
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			Logger::PrintLog(L"Mapped %s in %.2f ms\n", meshPath.c_str(), ms);
+			return true;
 		}
 
-		BoundingBox bounds;
-		XMStoreFloat3(&bounds.Center, 0.5f * (vMin + vMax));
-		XMStoreFloat3(&bounds.Extents, 0.5f * (vMax - vMin));
-
-		fin >> ignore;
-		fin >> ignore;
-		fin >> ignore;
-
-		std::vector<std::int32_t> indices(3 * tcount);
-		for (UINT i = 0; i < tcount; ++i)
+		MeshOptimizer::Result stats;
+		if (!meshFile.ParseText(textPath, &stats))
 		{
-			fin >> indices[i * 3 + 0] >> indices[i * 3 + 1] >> indices[i * 3 + 2];
+			MessageBox(0, (L"Models/" + name + L".txt not found.").c_str(), 0, 0);
+			return false;
 		}
 
-		fin.close();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		Logger::PrintLog(L"Parsed %s in %.2f ms, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", textPath.c_str(), ms,
+			stats.Before.Acmr, stats.After.Acmr, stats.Before.Atvr, stats.After.Atvr);
 
-		//
-		// Pack the indices of all the meshes into one index buffer.
-		//
+		// A read-only content folder only costs the parse on the next start.
+		if (!meshFile.Save(meshPath))
+			Logger::PrintLog(L"Could not write %s\n", meshPath.c_str());
 
-		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
+		return true;
+	}
 
-		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::int32_t);
+	void GraphicsClass::BuildModelGeometry(const std::string& name)
+	{
+		MeshFile meshFile;
+		if (!LoadModel(AnsiToWString(name), meshFile))
+			return;
 
-		auto geo = std::make_unique<MeshGeometry>();
-		geo->Name = "carGeo";
+		const MeshFileHeader& header = meshFile.Header();
+		const UINT ibByteSize = meshFile.IndexBufferByteSize();
 
-		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+		auto geo = std::make_unique<MeshGeometry>();
+		geo->Name = name + "Geo";
 
 		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
-
-		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), meshFile.Indices(), ibByteSize);
 
-		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		// The staging ring is filled straight from the mapped file.
+		geo->IndexBufferGPU = m_UploadService->CreateDefaultBuffer(meshFile.Indices(), ibByteSize);
 
-		geo->VertexByteStride = sizeof(Vertex);
-		geo->VertexBufferByteSize = vbByteSize;
-		geo->IndexFormat = DXGI_FORMAT_R32_UINT;
+		geo->IndexFormat = header.IndexByteSize == sizeof(std::uint16_t) ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 		geo->IndexBufferByteSize = ibByteSize;
 
 		SubmeshGeometry submesh;
-		submesh.IndexCount = (UINT)indices.size();
+		submesh.IndexCount = header.Lods[0].IndexCount;
 		submesh.StartIndexLocation = 0;
 		submesh.BaseVertexLocation = 0;
-		submesh.Bounds = bounds;
+		submesh.VertexCount = header.VertexCount;
+		submesh.Bounds = header.Bounds;
+		submesh.Lods.assign(header.Lods, header.Lods + header.LodCount);
+		submesh.Meshlets = MeshletCuller(std::vector<Meshlet>(meshFile.Meshlets(), meshFile.Meshlets() + header.MeshletCount));
 
-		geo->DrawArgs["car"] = submesh;
+		geo->DrawArgs[name] = submesh;
+
+		// The file keeps float vertices, they are packed on the way to the GPU.
+		CreateVertexBuffer(geo.get(), static_cast<const Vertex*>(meshFile.Vertices()), header.VertexCount);
+		BuildTriangleBvhs(geo.get());
 
 		m_Geometries[geo->Name] = std::move(geo);
 	}
@@ -1093,7 +1335,7 @@ namespace Graphics
 		for (int i = 0; i < gNumFrameResources; ++i)
 		{
 			m_FrameResources.push_back(std::make_unique<FrameResource>(m_d3dDevice.Get(),
-				2, (UINT)m_AllRenderItems.size(), (UINT)m_Materials.size()));
+				2, m_ObjectSlots.Capacity(), m_MaterialSlots.Capacity(), LayerItemCount()));
 		}
 	}
 
@@ -1101,72 +1343,72 @@ namespace Graphics
 	{
 		auto bricks = std::make_unique<Material>();
 		bricks->Name = "bricks";
-		bricks->MatCBIndex = m_MatConstantBufferIndex++;
-		bricks->DiffuseSrvHeapIndex = 0;
+		bricks->MatCBIndex = m_MaterialSlots.Allocate();
+		bricks->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("bricksTex");
 		bricks->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 		bricks->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 		bricks->Roughness = 0.25f;
 
 		auto checkertile = std::make_unique<Material>();
 		checkertile->Name = "checkertile";
-		checkertile->MatCBIndex = m_MatConstantBufferIndex++;
-		checkertile->DiffuseSrvHeapIndex = 1;
+		checkertile->MatCBIndex = m_MaterialSlots.Allocate();
+		checkertile->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("checkboardTex");
 		checkertile->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 		checkertile->FresnelR0 = XMFLOAT3(0.07f, 0.07f, 0.07f);
 		checkertile->Roughness = 0.3f;
 
 		auto icemirror = std::make_unique<Material>();
 		icemirror->Name = "icemirror";
-		icemirror->MatCBIndex = m_MatConstantBufferIndex++;
-		icemirror->DiffuseSrvHeapIndex = 2;
+		icemirror->MatCBIndex = m_MaterialSlots.Allocate();
+		icemirror->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("iceTex");
 		icemirror->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 0.3f);
 		icemirror->FresnelR0 = XMFLOAT3(0.1f, 0.1f, 0.1f);
 		icemirror->Roughness = 0.5f;
 
 		auto bone = std::make_unique<Material>();
 		bone->Name = "bone";
-		bone->MatCBIndex = m_MatConstantBufferIndex++;
-		bone->DiffuseSrvHeapIndex = 3;
+		bone->MatCBIndex = m_MaterialSlots.Allocate();
+		bone->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("white1x1Tex");
 		bone->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
 		bone->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 		bone->Roughness = 0.3f;
 
 		auto shadowMat = std::make_unique<Material>();
 		shadowMat->Name = "shadowMat";
-		shadowMat->MatCBIndex = m_MatConstantBufferIndex++;
-		shadowMat->DiffuseSrvHeapIndex = 3;
+		shadowMat->MatCBIndex = m_MaterialSlots.Allocate();
+		shadowMat->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("white1x1Tex");
 		shadowMat->DiffuseAlbedo = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.5f);
 		shadowMat->FresnelR0 = XMFLOAT3(0.001f, 0.001f, 0.001f);
 		shadowMat->Roughness = 0.0f;
 
 		auto stone = std::make_unique<Material>();
 		stone->Name = "stone";
-		stone->MatCBIndex = m_MatConstantBufferIndex++;
-		stone->DiffuseSrvHeapIndex = 0;
+		stone->MatCBIndex = m_MaterialSlots.Allocate();
+		stone->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("bricksTex");
 		stone->DiffuseAlbedo = XMFLOAT4(Colors::LightSteelBlue);
 		stone->FresnelR0 = XMFLOAT3(0.05f, 0.05f, 0.05f);
 		stone->Roughness = 0.3f;
 
 		auto tile = std::make_unique<Material>();
 		tile->Name = "tile";
-		tile->MatCBIndex = m_MatConstantBufferIndex++;
-		tile->DiffuseSrvHeapIndex = 0;
+		tile->MatCBIndex = m_MaterialSlots.Allocate();
+		tile->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("bricksTex");
 		tile->DiffuseAlbedo = XMFLOAT4(Colors::LightGray);
 		tile->FresnelR0 = XMFLOAT3(0.02f, 0.02f, 0.02f);
 		tile->Roughness = 0.2f;
 
 		auto metal = std::make_unique<Material>();
 		metal->Name = "metal";
-		metal->MatCBIndex = m_MatConstantBufferIndex++;
-		metal->DiffuseSrvHeapIndex = 0;
+		metal->MatCBIndex = m_MaterialSlots.Allocate();
+		metal->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("bricksTex");
 		metal->DiffuseAlbedo = XMFLOAT4(Colors::Silver);
 		metal->FresnelR0 = XMFLOAT3(0.2f, 0.2f, 0.2f);
 		metal->Roughness = 0.005f;
 
 		auto highlight = std::make_unique<Material>();
 		highlight->Name = "highlight";
-		highlight->MatCBIndex = m_MatConstantBufferIndex++;
-		highlight->DiffuseSrvHeapIndex = 0;
+		highlight->MatCBIndex = m_MaterialSlots.Allocate();
+		highlight->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("bricksTex");
 		highlight->DiffuseAlbedo = XMFLOAT4(1.0f, 1.0f, 0.0f, 0.6f);
 		highlight->FresnelR0 = XMFLOAT3(0.06f, 0.06f, 0.06f);
 		highlight->Roughness = 0.0f;
@@ -1193,339 +1435,651 @@ namespace Graphics
 
 	void GraphicsClass::BuildRenderItems()
 	{
-		auto floorRitem = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&floorRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f));
-		floorRitem->TexTransform = MathHelper::Identity4x4();
-		floorRitem->GeoShapeName = "floor";
-		floorRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		floorRitem->Mat = m_Materials["checkertile"].get();
-		floorRitem->Geo = m_Geometries["roomGeo"].get();
-		floorRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		floorRitem->IndexCount = floorRitem->Geo->DrawArgs["floor"].IndexCount;
-		floorRitem->StartIndexLocation = floorRitem->Geo->DrawArgs["floor"].StartIndexLocation;
-		floorRitem->BaseVertexLocation = floorRitem->Geo->DrawArgs["floor"].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(floorRitem.get());
-		m_ImguiManager.SetGeometryShapes(floorRitem->GeoShapeName, floorRitem->IsVisible);
+		RenderItemDesc floorRitem;
+		XMStoreFloat3(&floorRitem.WorldScaling, { 3.0f, 3.0f, 3.0f });
+		floorRitem.TexTransform = MathHelper::Identity4x4();
+		floorRitem.GeoShapeName = "floor";
+		floorRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		floorRitem.Mat = m_Materials["checkertile"].get();
+		floorRitem.Geo = m_Geometries["roomGeo"].get();
+		floorRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		floorRitem.IndexCount = floorRitem.Geo->DrawArgs["floor"].IndexCount;
+		floorRitem.StartIndexLocation = floorRitem.Geo->DrawArgs["floor"].StartIndexLocation;
+		floorRitem.BaseVertexLocation = floorRitem.Geo->DrawArgs["floor"].BaseVertexLocation;
+		RenderItemHandle floorItem = m_RenderItems.Create(floorRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(floorItem);
+		m_ImguiManager.SetGeometryShapes(floorRitem.GeoShapeName, floorRitem.IsVisible);
 		
-		auto wallsRitem = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&wallsRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f));
-		wallsRitem->TexTransform = MathHelper::Identity4x4();
-		wallsRitem->GeoShapeName = "wall";
-		wallsRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		wallsRitem->Mat = m_Materials["bricks"].get();
-		wallsRitem->Geo = m_Geometries["roomGeo"].get();
-		wallsRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		wallsRitem->IndexCount = wallsRitem->Geo->DrawArgs["wall"].IndexCount;
-		wallsRitem->StartIndexLocation = wallsRitem->Geo->DrawArgs["wall"].StartIndexLocation;
-		wallsRitem->BaseVertexLocation = wallsRitem->Geo->DrawArgs["wall"].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(wallsRitem.get());
-		m_ImguiManager.SetGeometryShapes(wallsRitem->GeoShapeName, wallsRitem->IsVisible);
-
-		auto carRitem = std::make_unique<RenderItem>();
-		XMStoreFloat3(&carRitem->WorldScaling, { 1.0f, 1.0f, 1.0f });
-		XMStoreFloat3(&carRitem->WorldTranslation, { 12.0f, 3.0f, -14.0f });
-		XMStoreFloat4x4(&carRitem->World, XMMatrixScaling(1.0f, 1.0f, 1.0f) * XMMatrixTranslation(12.0f, 3.0f, -14.0f));
-		XMStoreFloat4x4(&carRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		carRitem->GeoName = "carGeo";
-		carRitem->GeoShapeName = "car";
-		carRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		carRitem->Mat = m_Materials["metal"].get();
-		carRitem->Geo = m_Geometries[carRitem->GeoName].get();
-		carRitem->DoPicking = true;
-		carRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		carRitem->Bounds = carRitem->Geo->DrawArgs[carRitem->GeoShapeName].Bounds;
-		carRitem->IndexCount = carRitem->Geo->DrawArgs[carRitem->GeoShapeName].IndexCount;
-		carRitem->StartIndexLocation = carRitem->Geo->DrawArgs[carRitem->GeoShapeName].StartIndexLocation;
-		carRitem->BaseVertexLocation = carRitem->Geo->DrawArgs[carRitem->GeoShapeName].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(carRitem.get());
-		m_ImguiManager.SetModels(carRitem->GeoShapeName, carRitem->IsVisible);
-
-		auto boxRitem = std::make_unique<RenderItem>();
-		XMStoreFloat3(&boxRitem->WorldScaling, { 3.0f, 3.0f, 3.0f });
-		XMStoreFloat3(&boxRitem->WorldTranslation, { -5.0f, 1.0f, -10.0f });
-		XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f) * XMMatrixTranslation(-5.0f, 1.0f, -10.0f));
-		XMStoreFloat4x4(&boxRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		boxRitem->GeoName = "shapeGeo";
-		boxRitem->GeoShapeName = "box";
-		boxRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		boxRitem->Mat = m_Materials["tile"].get();
-		boxRitem->Geo = m_Geometries[boxRitem->GeoName].get();
-		boxRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		boxRitem->DoPicking = true;
-		boxRitem->Bounds = boxRitem->Geo->DrawArgs[boxRitem->GeoShapeName].Bounds;
-		boxRitem->IndexCount = boxRitem->Geo->DrawArgs[boxRitem->GeoShapeName].IndexCount;
-		boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs[boxRitem->GeoShapeName].StartIndexLocation;
-		boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs[boxRitem->GeoShapeName].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(boxRitem.get());
-		m_ImguiManager.SetGeometryShapes(boxRitem->GeoShapeName, boxRitem->IsVisible);
-
-		auto sphereRitem = std::make_unique<RenderItem>();
-		XMStoreFloat3(&sphereRitem->WorldScaling, { 4.0f, 4.0f, 4.0f });
-		XMStoreFloat3(&sphereRitem->WorldTranslation, { -1.0f, 4.0f, -18.0f });
-		XMStoreFloat4x4(&sphereRitem->World, XMMatrixScaling(4.0f, 4.0f, 4.0f) * XMMatrixTranslation(-1.0f, 4.0f, -18.0f));
-		XMStoreFloat4x4(&sphereRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		sphereRitem->GeoName = "shapeGeo";
-		sphereRitem->GeoShapeName = "sphere";
-		sphereRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		sphereRitem->Mat = m_Materials["bone"].get();
-		sphereRitem->Geo = m_Geometries[sphereRitem->GeoName].get();
-		sphereRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		sphereRitem->DoPicking = true;
-		sphereRitem->Bounds = sphereRitem->Geo->DrawArgs[sphereRitem->GeoShapeName].Bounds;
-		sphereRitem->IndexCount = sphereRitem->Geo->DrawArgs[sphereRitem->GeoShapeName].IndexCount;
-		sphereRitem->StartIndexLocation = sphereRitem->Geo->DrawArgs[sphereRitem->GeoShapeName].StartIndexLocation;
-		sphereRitem->BaseVertexLocation = sphereRitem->Geo->DrawArgs[sphereRitem->GeoShapeName].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(sphereRitem.get());
-		m_ImguiManager.SetGeometryShapes(sphereRitem->GeoShapeName, sphereRitem->IsVisible);
-
-		auto cylinderRitem = std::make_unique<RenderItem>();
-		XMStoreFloat3(&cylinderRitem->WorldScaling, { 3.0f, 3.0f, 3.0f });
-		XMStoreFloat3(&cylinderRitem->WorldTranslation, { 5.0f, 5.0f, -10.0f });
-		XMStoreFloat4x4(&cylinderRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f) * XMMatrixTranslation(5.0f, 5.0f, -10.0f));
-		XMStoreFloat4x4(&cylinderRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		cylinderRitem->GeoName = "shapeGeo";
-		cylinderRitem->GeoShapeName = "cylinder";
-		cylinderRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		cylinderRitem->Mat = m_Materials["stone"].get();
-		cylinderRitem->Geo = m_Geometries[cylinderRitem->GeoName].get();
-		cylinderRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		cylinderRitem->DoPicking = true;
-		cylinderRitem->Bounds = cylinderRitem->Geo->DrawArgs[cylinderRitem->GeoShapeName].Bounds;
-		cylinderRitem->IndexCount = cylinderRitem->Geo->DrawArgs[cylinderRitem->GeoShapeName].IndexCount;
-		cylinderRitem->StartIndexLocation = cylinderRitem->Geo->DrawArgs[cylinderRitem->GeoShapeName].StartIndexLocation;
-		cylinderRitem->BaseVertexLocation = cylinderRitem->Geo->DrawArgs[cylinderRitem->GeoShapeName].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(cylinderRitem.get());
-		m_ImguiManager.SetGeometryShapes(cylinderRitem->GeoShapeName, cylinderRitem->IsVisible);
-
-		auto reflectedFloorRitem = std::make_unique<RenderItem>();
-		*reflectedFloorRitem = *floorRitem;
-		reflectedFloorRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedFloorRitem->GeoShapeName = "reflFloor";
-		reflectedFloorRitem->FrustumTest = false;
-		reflectedFloorRitem->ReflectionSource = floorRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedFloorRitem.get());
-
-		auto reflectedCarRitem = std::make_unique<RenderItem>();
-		*reflectedCarRitem = *carRitem;
-		reflectedCarRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedCarRitem->GeoShapeName = "reflCar";
-		reflectedCarRitem->FrustumTest = false;
-		reflectedCarRitem->ReflectionSource = carRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedCarRitem.get());
-
-		auto reflectedBoxRitem = std::make_unique<RenderItem>();
-		*reflectedBoxRitem = *boxRitem;
-		reflectedBoxRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedBoxRitem->GeoShapeName = "reflBox";
-		reflectedBoxRitem->FrustumTest = false;
-		reflectedBoxRitem->ReflectionSource = boxRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedBoxRitem.get());
-
-		auto reflectedSphereRitem = std::make_unique<RenderItem>();
-		*reflectedSphereRitem = *sphereRitem;
-		reflectedSphereRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedSphereRitem->GeoShapeName = "reflSphere";
-		reflectedSphereRitem->FrustumTest = false;
-		reflectedSphereRitem->ReflectionSource = sphereRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedSphereRitem.get());
-
-		auto reflectedCylinderRitem = std::make_unique<RenderItem>();
-		*reflectedCylinderRitem = *cylinderRitem;
-		reflectedCylinderRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedCylinderRitem->GeoShapeName = "reflCylinder";
-		reflectedCylinderRitem->FrustumTest = false;
-		reflectedCylinderRitem->ReflectionSource = cylinderRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedCylinderRitem.get());
+		RenderItemDesc wallsRitem;
+		XMStoreFloat3(&wallsRitem.WorldScaling, { 3.0f, 3.0f, 3.0f });
+		wallsRitem.TexTransform = MathHelper::Identity4x4();
+		wallsRitem.GeoShapeName = "wall";
+		wallsRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		wallsRitem.Mat = m_Materials["bricks"].get();
+		wallsRitem.Geo = m_Geometries["roomGeo"].get();
+		wallsRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		wallsRitem.IndexCount = wallsRitem.Geo->DrawArgs["wall"].IndexCount;
+		wallsRitem.StartIndexLocation = wallsRitem.Geo->DrawArgs["wall"].StartIndexLocation;
+		wallsRitem.BaseVertexLocation = wallsRitem.Geo->DrawArgs["wall"].BaseVertexLocation;
+		RenderItemHandle wallsItem = m_RenderItems.Create(wallsRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(wallsItem);
+		m_ImguiManager.SetGeometryShapes(wallsRitem.GeoShapeName, wallsRitem.IsVisible);
+
+		RenderItemDesc carRitem;
+		XMStoreFloat3(&carRitem.WorldScaling, { 1.0f, 1.0f, 1.0f });
+		XMStoreFloat3(&carRitem.WorldTranslation, { 12.0f, 3.0f, -14.0f });
+		XMStoreFloat4x4(&carRitem.TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		carRitem.GeoName = "carGeo";
+		carRitem.GeoShapeName = "car";
+		carRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		carRitem.Mat = m_Materials["metal"].get();
+		carRitem.Geo = m_Geometries[carRitem.GeoName].get();
+		carRitem.DoPicking = true;
+		carRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		carRitem.Bounds = carRitem.Geo->DrawArgs[carRitem.GeoShapeName].Bounds;
+		carRitem.IndexCount = carRitem.Geo->DrawArgs[carRitem.GeoShapeName].IndexCount;
+		carRitem.StartIndexLocation = carRitem.Geo->DrawArgs[carRitem.GeoShapeName].StartIndexLocation;
+		carRitem.BaseVertexLocation = carRitem.Geo->DrawArgs[carRitem.GeoShapeName].BaseVertexLocation;
+		carRitem.Submesh = &carRitem.Geo->DrawArgs[carRitem.GeoShapeName];
+		RenderItemHandle carItem = m_RenderItems.Create(carRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(carItem);
+		m_ImguiManager.SetModels(carRitem.GeoShapeName, carRitem.IsVisible);
+
+		RenderItemDesc skullRitem;
+		XMStoreFloat3(&skullRitem.WorldScaling, { 0.6f, 0.6f, 0.6f });
+		XMStoreFloat3(&skullRitem.WorldTranslation, { -8.0f, 0.0f, -20.0f });
+		XMStoreFloat4x4(&skullRitem.TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		skullRitem.GeoName = "skullGeo";
+		skullRitem.GeoShapeName = "skull";
+		skullRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		skullRitem.Mat = m_Materials["bone"].get();
+		skullRitem.Geo = m_Geometries[skullRitem.GeoName].get();
+		skullRitem.DoPicking = true;
+		skullRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		skullRitem.Bounds = skullRitem.Geo->DrawArgs[skullRitem.GeoShapeName].Bounds;
+		skullRitem.IndexCount = skullRitem.Geo->DrawArgs[skullRitem.GeoShapeName].IndexCount;
+		skullRitem.StartIndexLocation = skullRitem.Geo->DrawArgs[skullRitem.GeoShapeName].StartIndexLocation;
+		skullRitem.BaseVertexLocation = skullRitem.Geo->DrawArgs[skullRitem.GeoShapeName].BaseVertexLocation;
+		skullRitem.Submesh = &skullRitem.Geo->DrawArgs[skullRitem.GeoShapeName];
+		RenderItemHandle skullItem = m_RenderItems.Create(skullRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(skullItem);
+		m_ImguiManager.SetModels(skullRitem.GeoShapeName, skullRitem.IsVisible);
+
+		RenderItemDesc boxRitem;
+		XMStoreFloat3(&boxRitem.WorldScaling, { 3.0f, 3.0f, 3.0f });
+		XMStoreFloat3(&boxRitem.WorldTranslation, { -5.0f, 1.0f, -10.0f });
+		XMStoreFloat4x4(&boxRitem.TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		boxRitem.GeoName = "shapeGeo";
+		boxRitem.GeoShapeName = "box";
+		boxRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		boxRitem.Mat = m_Materials["tile"].get();
+		boxRitem.Geo = m_Geometries[boxRitem.GeoName].get();
+		boxRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		boxRitem.DoPicking = true;
+		boxRitem.Bounds = boxRitem.Geo->DrawArgs[boxRitem.GeoShapeName].Bounds;
+		boxRitem.IndexCount = boxRitem.Geo->DrawArgs[boxRitem.GeoShapeName].IndexCount;
+		boxRitem.StartIndexLocation = boxRitem.Geo->DrawArgs[boxRitem.GeoShapeName].StartIndexLocation;
+		boxRitem.BaseVertexLocation = boxRitem.Geo->DrawArgs[boxRitem.GeoShapeName].BaseVertexLocation;
+		boxRitem.Submesh = &boxRitem.Geo->DrawArgs[boxRitem.GeoShapeName];
+		RenderItemHandle boxItem = m_RenderItems.Create(boxRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(boxItem);
+		m_ImguiManager.SetGeometryShapes(boxRitem.GeoShapeName, boxRitem.IsVisible);
+
+		RenderItemDesc sphereRitem;
+		XMStoreFloat3(&sphereRitem.WorldScaling, { 4.0f, 4.0f, 4.0f });
+		XMStoreFloat3(&sphereRitem.WorldTranslation, { -1.0f, 4.0f, -18.0f });
+		XMStoreFloat4x4(&sphereRitem.TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		sphereRitem.GeoName = "shapeGeo";
+		sphereRitem.GeoShapeName = "sphere";
+		sphereRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		sphereRitem.Mat = m_Materials["bone"].get();
+		sphereRitem.Geo = m_Geometries[sphereRitem.GeoName].get();
+		sphereRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		sphereRitem.DoPicking = true;
+		sphereRitem.Bounds = sphereRitem.Geo->DrawArgs[sphereRitem.GeoShapeName].Bounds;
+		sphereRitem.IndexCount = sphereRitem.Geo->DrawArgs[sphereRitem.GeoShapeName].IndexCount;
+		sphereRitem.StartIndexLocation = sphereRitem.Geo->DrawArgs[sphereRitem.GeoShapeName].StartIndexLocation;
+		sphereRitem.BaseVertexLocation = sphereRitem.Geo->DrawArgs[sphereRitem.GeoShapeName].BaseVertexLocation;
+		sphereRitem.Submesh = &sphereRitem.Geo->DrawArgs[sphereRitem.GeoShapeName];
+		RenderItemHandle sphereItem = m_RenderItems.Create(sphereRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(sphereItem);
+		m_ImguiManager.SetGeometryShapes(sphereRitem.GeoShapeName, sphereRitem.IsVisible);
+
+		RenderItemDesc cylinderRitem;
+		XMStoreFloat3(&cylinderRitem.WorldScaling, { 3.0f, 3.0f, 3.0f });
+		XMStoreFloat3(&cylinderRitem.WorldTranslation, { 5.0f, 5.0f, -10.0f });
+		XMStoreFloat4x4(&cylinderRitem.TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		cylinderRitem.GeoName = "shapeGeo";
+		cylinderRitem.GeoShapeName = "cylinder";
+		cylinderRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		cylinderRitem.Mat = m_Materials["stone"].get();
+		cylinderRitem.Geo = m_Geometries[cylinderRitem.GeoName].get();
+		cylinderRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		cylinderRitem.DoPicking = true;
+		cylinderRitem.Bounds = cylinderRitem.Geo->DrawArgs[cylinderRitem.GeoShapeName].Bounds;
+		cylinderRitem.IndexCount = cylinderRitem.Geo->DrawArgs[cylinderRitem.GeoShapeName].IndexCount;
+		cylinderRitem.StartIndexLocation = cylinderRitem.Geo->DrawArgs[cylinderRitem.GeoShapeName].StartIndexLocation;
+		cylinderRitem.BaseVertexLocation = cylinderRitem.Geo->DrawArgs[cylinderRitem.GeoShapeName].BaseVertexLocation;
+		cylinderRitem.Submesh = &cylinderRitem.Geo->DrawArgs[cylinderRitem.GeoShapeName];
+		RenderItemHandle cylinderItem = m_RenderItems.Create(cylinderRitem);
+		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(cylinderItem);
+		m_ImguiManager.SetGeometryShapes(cylinderRitem.GeoShapeName, cylinderRitem.IsVisible);
+
+		RenderItemDesc reflectedFloorRitem = floorRitem;
+		reflectedFloorRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedFloorRitem.GeoShapeName = "reflFloor";
+		reflectedFloorRitem.FrustumTest = false;
+		reflectedFloorRitem.ReflectionSource = floorItem;
+		RenderItemHandle reflectedFloorItem = m_RenderItems.Create(reflectedFloorRitem);
+		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedFloorItem);
+
+		RenderItemDesc reflectedCarRitem = carRitem;
+		reflectedCarRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedCarRitem.GeoShapeName = "reflCar";
+		reflectedCarRitem.FrustumTest = false;
+		reflectedCarRitem.ReflectionSource = carItem;
+		RenderItemHandle reflectedCarItem = m_RenderItems.Create(reflectedCarRitem);
+		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedCarItem);
+
+		RenderItemDesc reflectedSkullRitem = skullRitem;
+		reflectedSkullRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedSkullRitem.GeoShapeName = "reflSkull";
+		reflectedSkullRitem.FrustumTest = false;
+		reflectedSkullRitem.ReflectionSource = skullItem;
+		RenderItemHandle reflectedSkullItem = m_RenderItems.Create(reflectedSkullRitem);
+		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedSkullItem);
+
+		RenderItemDesc reflectedBoxRitem = boxRitem;
+		reflectedBoxRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedBoxRitem.GeoShapeName = "reflBox";
+		reflectedBoxRitem.FrustumTest = false;
+		reflectedBoxRitem.ReflectionSource = boxItem;
+		RenderItemHandle reflectedBoxItem = m_RenderItems.Create(reflectedBoxRitem);
+		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedBoxItem);
+
+		RenderItemDesc reflectedSphereRitem = sphereRitem;
+		reflectedSphereRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedSphereRitem.GeoShapeName = "reflSphere";
+		reflectedSphereRitem.FrustumTest = false;
+		reflectedSphereRitem.ReflectionSource = sphereItem;
+		RenderItemHandle reflectedSphereItem = m_RenderItems.Create(reflectedSphereRitem);
+		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedSphereItem);
+
+		RenderItemDesc reflectedCylinderRitem = cylinderRitem;
+		reflectedCylinderRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedCylinderRitem.GeoShapeName = "reflCylinder";
+		reflectedCylinderRitem.FrustumTest = false;
+		reflectedCylinderRitem.ReflectionSource = cylinderItem;
+		RenderItemHandle reflectedCylinderItem = m_RenderItems.Create(reflectedCylinderRitem);
+		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedCylinderItem);
 		
-		auto shadowedCarRitem = std::make_unique<RenderItem>();
-		*shadowedCarRitem = *carRitem;
-		shadowedCarRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		shadowedCarRitem->Mat = m_Materials["shadowMat"].get();
-		shadowedCarRitem->GeoShapeName = "shadowCar";
-		shadowedCarRitem->ShadowSource = carRitem.get();
-		shadowedCarRitem->ShadowIndex = 0;
-		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedCarRitem.get());
-
-		auto shadowedBoxRitem = std::make_unique<RenderItem>();
-		*shadowedBoxRitem = *boxRitem;
-		shadowedBoxRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		shadowedBoxRitem->Mat = m_Materials["shadowMat"].get();
-		shadowedBoxRitem->GeoShapeName = "shadowBox";
-		shadowedBoxRitem->ShadowSource = boxRitem.get();
-		shadowedBoxRitem->ShadowIndex = 0;
-		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedBoxRitem.get());
-
-		auto shadowedSphereRitem = std::make_unique<RenderItem>();
-		*shadowedSphereRitem = *sphereRitem;
-		shadowedSphereRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		shadowedSphereRitem->Mat = m_Materials["shadowMat"].get();
-		shadowedSphereRitem->GeoShapeName = "shadowSphere";
-		shadowedSphereRitem->ShadowSource = sphereRitem.get();
-		shadowedSphereRitem->ShadowIndex = 0;
-		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedSphereRitem.get());
-
-		auto shadowedCylinderRitem = std::make_unique<RenderItem>();
-		*shadowedCylinderRitem = *cylinderRitem;
-		shadowedCylinderRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		shadowedCylinderRitem->Mat = m_Materials["shadowMat"].get();
-		shadowedCylinderRitem->GeoShapeName = "shadowCylinder";
-		shadowedCylinderRitem->ShadowSource = cylinderRitem.get();
-		shadowedCylinderRitem->ShadowIndex = 0;
-		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedCylinderRitem.get());
-
-		auto reflectedShadowedCarRitem = std::make_unique<RenderItem>();
-		*reflectedShadowedCarRitem = *shadowedCarRitem;
-		reflectedShadowedCarRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedShadowedCarRitem->GeoShapeName = "reflShadowCar";
-		reflectedShadowedCarRitem->FrustumTest = false;
-		reflectedShadowedCarRitem->ReflectionSource = shadowedCarRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedCarRitem.get());
-
-		auto reflectedShadowedBoxRitem = std::make_unique<RenderItem>();
-		*reflectedShadowedBoxRitem = *shadowedBoxRitem;
-		reflectedShadowedBoxRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedShadowedBoxRitem->GeoShapeName = "reflShadowBox";
-		reflectedShadowedBoxRitem->FrustumTest = false;
-		reflectedShadowedBoxRitem->ReflectionSource = shadowedBoxRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedBoxRitem.get());
-
-		auto reflectedShadowedSphereRitem = std::make_unique<RenderItem>();
-		*reflectedShadowedSphereRitem = *shadowedSphereRitem;
-		reflectedShadowedSphereRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedShadowedSphereRitem->GeoShapeName = "reflShadowSphere";
-		reflectedShadowedSphereRitem->FrustumTest = false;
-		reflectedShadowedSphereRitem->ReflectionSource = shadowedSphereRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedSphereRitem.get());
-
-		auto reflectedShadowedCylinderRitem = std::make_unique<RenderItem>();
-		*reflectedShadowedCylinderRitem = *shadowedCylinderRitem;
-		reflectedShadowedCylinderRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedShadowedCylinderRitem->GeoShapeName = "reflShadowCylinder";
-		reflectedShadowedCylinderRitem->FrustumTest = false;
-		reflectedShadowedCylinderRitem->ReflectionSource = shadowedCylinderRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedCylinderRitem.get());
-
-		auto mirrorRitem = std::make_unique<RenderItem>();
-		XMStoreFloat4x4(&mirrorRitem->World, XMMatrixScaling(3.0f, 3.0f, 3.0f));
-		mirrorRitem->TexTransform = MathHelper::Identity4x4();
-		mirrorRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		mirrorRitem->Mat = m_Materials["icemirror"].get();
-		mirrorRitem->Geo = m_Geometries["roomGeo"].get();
-		mirrorRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		mirrorRitem->IndexCount = mirrorRitem->Geo->DrawArgs["mirror"].IndexCount;
-		mirrorRitem->StartIndexLocation = mirrorRitem->Geo->DrawArgs["mirror"].StartIndexLocation;
-		mirrorRitem->BaseVertexLocation = mirrorRitem->Geo->DrawArgs["mirror"].BaseVertexLocation;
-		mirrorRitem->GeoShapeName = "mirror";
-		m_RenderItemLayer[(int)RenderLayer::Mirrors].push_back(mirrorRitem.get());
-		m_RenderItemLayer[(int)RenderLayer::Transparent].push_back(mirrorRitem.get());
-
-		auto pickedRitem = std::make_unique<RenderItem>();
-		pickedRitem->World = MathHelper::Identity4x4();
-		pickedRitem->TexTransform = MathHelper::Identity4x4();
-		pickedRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		pickedRitem->Mat = m_Materials["highlight"].get();
-		pickedRitem->Geo = m_Geometries["shapeGeo"].get();
-		pickedRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		RenderItemDesc shadowedCarRitem = carRitem;
+		shadowedCarRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shadowedCarRitem.Mat = m_Materials["shadowMat"].get();
+		shadowedCarRitem.GeoShapeName = "shadowCar";
+		shadowedCarRitem.ShadowSource = carItem;
+		shadowedCarRitem.ShadowIndex = 0;
+		RenderItemHandle shadowedCarItem = m_RenderItems.Create(shadowedCarRitem);
+		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedCarItem);
+
+		RenderItemDesc shadowedSkullRitem = skullRitem;
+		shadowedSkullRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shadowedSkullRitem.Mat = m_Materials["shadowMat"].get();
+		shadowedSkullRitem.GeoShapeName = "shadowSkull";
+		shadowedSkullRitem.ShadowSource = skullItem;
+		shadowedSkullRitem.ShadowIndex = 0;
+		RenderItemHandle shadowedSkullItem = m_RenderItems.Create(shadowedSkullRitem);
+		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedSkullItem);
+
+		RenderItemDesc shadowedBoxRitem = boxRitem;
+		shadowedBoxRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shadowedBoxRitem.Mat = m_Materials["shadowMat"].get();
+		shadowedBoxRitem.GeoShapeName = "shadowBox";
+		shadowedBoxRitem.ShadowSource = boxItem;
+		shadowedBoxRitem.ShadowIndex = 0;
+		RenderItemHandle shadowedBoxItem = m_RenderItems.Create(shadowedBoxRitem);
+		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedBoxItem);
+
+		RenderItemDesc shadowedSphereRitem = sphereRitem;
+		shadowedSphereRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shadowedSphereRitem.Mat = m_Materials["shadowMat"].get();
+		shadowedSphereRitem.GeoShapeName = "shadowSphere";
+		shadowedSphereRitem.ShadowSource = sphereItem;
+		shadowedSphereRitem.ShadowIndex = 0;
+		RenderItemHandle shadowedSphereItem = m_RenderItems.Create(shadowedSphereRitem);
+		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedSphereItem);
+
+		RenderItemDesc shadowedCylinderRitem = cylinderRitem;
+		shadowedCylinderRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shadowedCylinderRitem.Mat = m_Materials["shadowMat"].get();
+		shadowedCylinderRitem.GeoShapeName = "shadowCylinder";
+		shadowedCylinderRitem.ShadowSource = cylinderItem;
+		shadowedCylinderRitem.ShadowIndex = 0;
+		RenderItemHandle shadowedCylinderItem = m_RenderItems.Create(shadowedCylinderRitem);
+		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedCylinderItem);
+
+		RenderItemDesc reflectedShadowedCarRitem = shadowedCarRitem;
+		reflectedShadowedCarRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShadowedCarRitem.GeoShapeName = "reflShadowCar";
+		reflectedShadowedCarRitem.FrustumTest = false;
+		reflectedShadowedCarRitem.ReflectionSource = shadowedCarItem;
+		RenderItemHandle reflectedShadowedCarItem = m_RenderItems.Create(reflectedShadowedCarRitem);
+		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedCarItem);
+
+		RenderItemDesc reflectedShadowedSkullRitem = shadowedSkullRitem;
+		reflectedShadowedSkullRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShadowedSkullRitem.GeoShapeName = "reflShadowSkull";
+		reflectedShadowedSkullRitem.FrustumTest = false;
+		reflectedShadowedSkullRitem.ReflectionSource = shadowedSkullItem;
+		RenderItemHandle reflectedShadowedSkullItem = m_RenderItems.Create(reflectedShadowedSkullRitem);
+		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedSkullItem);
+
+		RenderItemDesc reflectedShadowedBoxRitem = shadowedBoxRitem;
+		reflectedShadowedBoxRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShadowedBoxRitem.GeoShapeName = "reflShadowBox";
+		reflectedShadowedBoxRitem.FrustumTest = false;
+		reflectedShadowedBoxRitem.ReflectionSource = shadowedBoxItem;
+		RenderItemHandle reflectedShadowedBoxItem = m_RenderItems.Create(reflectedShadowedBoxRitem);
+		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedBoxItem);
+
+		RenderItemDesc reflectedShadowedSphereRitem = shadowedSphereRitem;
+		reflectedShadowedSphereRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShadowedSphereRitem.GeoShapeName = "reflShadowSphere";
+		reflectedShadowedSphereRitem.FrustumTest = false;
+		reflectedShadowedSphereRitem.ReflectionSource = shadowedSphereItem;
+		RenderItemHandle reflectedShadowedSphereItem = m_RenderItems.Create(reflectedShadowedSphereRitem);
+		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedSphereItem);
+
+		RenderItemDesc reflectedShadowedCylinderRitem = shadowedCylinderRitem;
+		reflectedShadowedCylinderRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShadowedCylinderRitem.GeoShapeName = "reflShadowCylinder";
+		reflectedShadowedCylinderRitem.FrustumTest = false;
+		reflectedShadowedCylinderRitem.ReflectionSource = shadowedCylinderItem;
+		RenderItemHandle reflectedShadowedCylinderItem = m_RenderItems.Create(reflectedShadowedCylinderRitem);
+		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedCylinderItem);
+
+		RenderItemDesc mirrorRitem;
+		XMStoreFloat3(&mirrorRitem.WorldScaling, { 3.0f, 3.0f, 3.0f });
+		mirrorRitem.TexTransform = MathHelper::Identity4x4();
+		mirrorRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		mirrorRitem.Mat = m_Materials["icemirror"].get();
+		mirrorRitem.Geo = m_Geometries["roomGeo"].get();
+		mirrorRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		mirrorRitem.IndexCount = mirrorRitem.Geo->DrawArgs["mirror"].IndexCount;
+		mirrorRitem.StartIndexLocation = mirrorRitem.Geo->DrawArgs["mirror"].StartIndexLocation;
+		mirrorRitem.BaseVertexLocation = mirrorRitem.Geo->DrawArgs["mirror"].BaseVertexLocation;
+		mirrorRitem.GeoShapeName = "mirror";
+		RenderItemHandle mirrorItem = m_RenderItems.Create(mirrorRitem);
+		m_RenderItemLayer[(int)RenderLayer::Mirrors].push_back(mirrorItem);
+		m_RenderItemLayer[(int)RenderLayer::Transparent].push_back(mirrorItem);
+
+		RenderItemDesc pickedRitem;
+		pickedRitem.TexTransform = MathHelper::Identity4x4();
+		pickedRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		pickedRitem.Mat = m_Materials["highlight"].get();
+		pickedRitem.Geo = m_Geometries["shapeGeo"].get();
+		pickedRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		// Picked triangle is not visible until one is picked.
-		pickedRitem->IsVisible = false;
+		pickedRitem.IsVisible = false;
 		// DrawCall parameters are filled out when a triangle is picked.
-		pickedRitem->IndexCount = 0;
-		pickedRitem->StartIndexLocation = 0;
-		pickedRitem->BaseVertexLocation = 0;
-		m_PickedRenderItem = pickedRitem.get();
+		pickedRitem.IndexCount = 0;
+		pickedRitem.StartIndexLocation = 0;
+		pickedRitem.BaseVertexLocation = 0;
+		m_PickedRenderItem = m_RenderItems.Create(pickedRitem);
 		m_RenderItemLayer[(int)RenderLayer::Highlight].push_back(m_PickedRenderItem);
 
-		m_AllRenderItems.push_back(std::move(floorRitem));
-		m_AllRenderItems.push_back(std::move(wallsRitem));
-		m_AllRenderItems.push_back(std::move(carRitem));
-		m_AllRenderItems.push_back(std::move(boxRitem));
-		m_AllRenderItems.push_back(std::move(sphereRitem));
-		m_AllRenderItems.push_back(std::move(cylinderRitem));
-		m_AllRenderItems.push_back(std::move(reflectedFloorRitem));
-		m_AllRenderItems.push_back(std::move(reflectedCarRitem));
-		m_AllRenderItems.push_back(std::move(reflectedBoxRitem));
-		m_AllRenderItems.push_back(std::move(reflectedSphereRitem));
-		m_AllRenderItems.push_back(std::move(reflectedCylinderRitem));
-		m_AllRenderItems.push_back(std::move(shadowedCarRitem));
-		m_AllRenderItems.push_back(std::move(shadowedBoxRitem));
-		m_AllRenderItems.push_back(std::move(shadowedSphereRitem));
-		m_AllRenderItems.push_back(std::move(shadowedCylinderRitem));
-		m_AllRenderItems.push_back(std::move(reflectedShadowedCarRitem));
-		m_AllRenderItems.push_back(std::move(reflectedShadowedBoxRitem));
-		m_AllRenderItems.push_back(std::move(reflectedShadowedSphereRitem));
-		m_AllRenderItems.push_back(std::move(reflectedShadowedCylinderRitem));
-		m_AllRenderItems.push_back(std::move(mirrorRitem));
-		m_AllRenderItems.push_back(std::move(pickedRitem));
+		BuildTransformHierarchy();
+		RebuildLayerMasks();
+		RebuildPickingBvh();
 	}
-	
-	void GraphicsClass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
+
+	void GraphicsClass::BuildTransformHierarchy()
 	{
-		UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-		UINT matCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(MaterialConstants));
+		// Shadows and reflections hang below the item they project.  Reflected shadows are
+		// copied from their shadow and keep its ShadowSource, the reflection comes first.
+		auto transformParent = [this](RenderItemHandle ri)
+			{
+				const RenderItemInfo& info = m_RenderItems.Info(ri);
+				return m_RenderItems.IsValid(info.ReflectionSource) ? info.ReflectionSource : info.ShadowSource;
+			};
+
+		// Order the items by their depth below a root, so the hierarchy can be built level
+		// by level.  Sources come before their shadows and reflections.
+		std::vector<std::pair<UINT, RenderItemHandle>> items;
+		items.reserve(m_RenderItems.Count());
+		for (UINT i = 0; i < m_RenderItems.Count(); ++i)
+		{
+			RenderItemHandle ri = m_RenderItems.HandleAt(i);
+			UINT depth = 0;
+			for (RenderItemHandle parent = transformParent(ri); m_RenderItems.IsValid(parent); parent = transformParent(parent))
+				++depth;
+			items.push_back({ depth, ri });
+		}
+		std::stable_sort(items.begin(), items.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
 
-		auto objectCB = m_CurrentFrameResource->ObjectCB->Resource();
-		auto matCB = m_CurrentFrameResource->MaterialCB->Resource();
+		XMVECTOR mirrorPlane = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f); // xy plane
+		XMFLOAT4X4 reflection;
+		XMStoreFloat4x4(&reflection, XMMatrixReflect(mirrorPlane));
 
-		// For each render item...
-		for (size_t i = 0; i < ritems.size(); ++i)
+		m_Transforms.Clear();
+		m_TransformNodeItems.clear();
+		for (auto& item : items)
 		{
-			auto ri = ritems[i];
+			RenderItemHandle ri = item.second;
+			RenderItemHandle parent = transformParent(ri);
+			const RenderItemInfo& info = m_RenderItems.Info(ri);
+			UINT& node = m_RenderItems.Transform(ri).TransformNode;
+			if (!m_RenderItems.IsValid(parent))
+			{
+				node = m_Transforms.Add(TransformHierarchy::InvalidNode, MathHelper::Identity4x4());
+				m_Transforms.SetLocal(node, info.WorldScaling, info.WorldRotation, info.WorldTranslation);
+			}
+			else if (m_RenderItems.IsValid(info.ReflectionSource))
+			{
+				node = m_Transforms.Add(m_RenderItems.Transform(parent).TransformNode, reflection, TransformHierarchy::Space::World);
+			}
+			else
+			{
+				node = m_Transforms.Add(m_RenderItems.Transform(parent).TransformNode, m_ShadowTransform, TransformHierarchy::Space::World);
+			}
+			m_TransformNodeItems.push_back(ri);
+		}
 
-			if (ri->IsVisible == false || ri->FrustumTestResult == false)
-				continue;
+		PropagateTransforms();
+	}
 
-			D3D12_VERTEX_BUFFER_VIEW vertexBufferView = ri->Geo->VertexBufferView();
-			cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
-			D3D12_INDEX_BUFFER_VIEW indexBufferView = ri->Geo->IndexBufferView();
-			cmdList->IASetIndexBuffer(&indexBufferView);
-			cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
+	void GraphicsClass::PropagateTransforms()
+	{
+		for (UINT node : m_Transforms.Update())
+		{
+			RenderItemHandle ri = m_TransformNodeItems[node];
+			XMFLOAT4X4& world = m_RenderItems.Transform(ri).World;
 
-			CD3DX12_GPU_DESCRIPTOR_HANDLE tex(m_ShaderResourceViewDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
-			tex.Offset(ri->Mat->DiffuseSrvHeapIndex, m_CbvSrvDescriptorSize);
+			// A rebuilt hierarchy updates every node, only upload the worlds that moved.
+			if (memcmp(&world, &m_Transforms.World(node), sizeof(world)) != 0)
+			{
+				world = m_Transforms.World(node);
+				MarkDirty(ri);
+			}
+		}
+	}
 
-			D3D12_GPU_VIRTUAL_ADDRESS objCBAddress = 
-				objectCB->GetGPUVirtualAddress() + ri->ObjConstantBufferIndex * objCBByteSize;
-			D3D12_GPU_VIRTUAL_ADDRESS matCBAddress = 
-				matCB->GetGPUVirtualAddress() + ri->Mat->MatCBIndex * matCBByteSize;
+	void GraphicsClass::RebuildLayerMasks()
+	{
+		for (UINT i = 0; i < m_RenderItems.Count(); ++i)
+			m_RenderItems.Flags(m_RenderItems.HandleAt(i)).LayerMask = 0;
 
-			cmdList->SetGraphicsRootDescriptorTable(0, tex);
-			cmdList->SetGraphicsRootConstantBufferView(1, objCBAddress);
-			cmdList->SetGraphicsRootConstantBufferView(3, matCBAddress);
+		for (int i = 0; i < (int)RenderLayer::Count; i++)
+		{
+			for (auto e : m_RenderItemLayer[i])
+				m_RenderItems.Flags(e).LayerMask |= 1u << i;
+		}
+	}
 
-			cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
+	UINT GraphicsClass::LayerItemCount() const
+	{
+		UINT count = 0;
+		for (int i = 0; i < (int)RenderLayer::Count; i++)
+			count += (UINT)m_RenderItemLayer[i].size();
+		return count;
+	}
+	
+	void GraphicsClass::CreateVertexBuffer(MeshGeometry* geo, const Vertex* vertices, UINT vertexCount)
+	{
+		const void* data = vertices;
+		UINT vertexByteStride = sizeof(Vertex);
+
+		std::vector<PackedVertex> packedVertices;
+		if (PackVertices)
+		{
+			const FloatVertexLayout layout = { sizeof(Vertex), offsetof(Vertex, Normal), offsetof(Vertex, TexC) };
+			packedVertices.resize(vertexCount);
+
+			auto start = std::chrono::steady_clock::now();
+
+			for (auto& e : geo->DrawArgs)
+			{
+				SubmeshGeometry& submesh = e.second;
+				assert(submesh.VertexCount > 0 && submesh.BaseVertexLocation + submesh.VertexCount <= vertexCount);
+
+				const Vertex* first = vertices + submesh.BaseVertexLocation;
+				submesh.Quantization = VertexPacker::ComputeQuantization(first, sizeof(Vertex), submesh.VertexCount);
+				VertexPacker::Pack(first, layout, submesh.VertexCount, submesh.Quantization,
+					packedVertices.data() + submesh.BaseVertexLocation);
+			}
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			PackingError maxError;
+			for (auto& e : geo->DrawArgs)
+			{
+				const SubmeshGeometry& submesh = e.second;
+				PackingError error = VertexPacker::MeasureError(vertices + submesh.BaseVertexLocation, layout,
+					packedVertices.data() + submesh.BaseVertexLocation, submesh.VertexCount, submesh.Quantization);
+				maxError.Position = std::max<float>(maxError.Position, error.Position);
+				maxError.Normal = std::max<float>(maxError.Normal, error.Normal);
+				maxError.TexC = std::max<float>(maxError.TexC, error.TexC);
+			}
+
+			Logger::PrintLog(L"Packed %u vertices of %s in %.3f ms, %u -> %u bytes, max error: position %.6f, normal %.3f deg, texture %.6f\n",
+				vertexCount, AnsiToWString(geo->Name).c_str(), ms, vertexCount * (UINT)sizeof(Vertex),
+				vertexCount * (UINT)sizeof(PackedVertex), maxError.Position, maxError.Normal, maxError.TexC);
+
+			data = packedVertices.data();
+			vertexByteStride = sizeof(PackedVertex);
+			geo->PackedVertices = true;
 		}
+
+		const UINT vbByteSize = vertexCount * vertexByteStride;
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), data, vbByteSize);
+
+		geo->VertexBufferGPU = m_UploadService->CreateDefaultBuffer(data, vbByteSize);
+
+		geo->VertexByteStride = vertexByteStride;
+		geo->VertexBufferByteSize = vbByteSize;
 	}
 
-	void GraphicsClass::UpdateImGuiData()
+	void GraphicsClass::BuildTriangleBvhs(MeshGeometry* geo)
 	{
-		for (auto ri : m_RenderItemLayer[(int)RenderLayer::Opaque])
+		// NOTE: Every pickable mesh starts its vertex format with the position.
+		UINT indexByteSize = geo->IndexFormat == DXGI_FORMAT_R32_UINT ? 4 : 2;
+
+		const void* vertices = geo->VertexBufferCPU->GetBufferPointer();
+		UINT vertexByteStride = geo->VertexByteStride;
+
+		// Picking tests the positions the GPU draws, packed ones are unpacked for the build.
+		std::vector<Vertex> unpackedVertices;
+		if (geo->PackedVertices)
 		{
-			if (ri->IsPicked)
+			const FloatVertexLayout layout = { sizeof(Vertex), offsetof(Vertex, Normal), offsetof(Vertex, TexC) };
+			const PackedVertex* packedVertices = static_cast<const PackedVertex*>(vertices);
+			unpackedVertices.resize(geo->VertexBufferByteSize / sizeof(PackedVertex));
+
+			for (auto& e : geo->DrawArgs)
 			{
-				ri->WorldScaling = m_ImguiManager.GetItemScaling();
-				ri->WorldRotation.x = XMConvertToRadians(m_ImguiManager.GetItemRotation().x);
-				ri->WorldRotation.y = XMConvertToRadians(m_ImguiManager.GetItemRotation().y);
-				ri->WorldRotation.z = XMConvertToRadians(m_ImguiManager.GetItemRotation().z);
-				ri->WorldTranslation = m_ImguiManager.GetItemTranslation();
+				const SubmeshGeometry& submesh = e.second;
+				VertexPacker::Unpack(packedVertices + submesh.BaseVertexLocation, submesh.VertexCount,
+					submesh.Quantization, unpackedVertices.data() + submesh.BaseVertexLocation, layout);
+			}
 
-				XMMATRIX world = XMMatrixIdentity();
-				world *= XMMatrixScaling(ri->WorldScaling.x, ri->WorldScaling.y, ri->WorldScaling.z);
-				world *= XMMatrixRotationX(ri->WorldRotation.x) * XMMatrixRotationY(ri->WorldRotation.y) * XMMatrixRotationZ(ri->WorldRotation.z);
-				world *= XMMatrixTranslation(ri->WorldTranslation.x, ri->WorldTranslation.y, ri->WorldTranslation.z);
-				XMStoreFloat4x4(&ri->World, world);
+			vertices = unpackedVertices.data();
+			vertexByteStride = sizeof(Vertex);
+		}
 
-				ri->Mat = m_Materials[m_ImguiManager.GetItemMaterial()].get();
+		for (auto& e : geo->DrawArgs)
+		{
+			const SubmeshGeometry& submesh = e.second;
+			geo->SubmeshBvhs[e.first].Build(vertices, vertexByteStride,
+				geo->IndexBufferCPU->GetBufferPointer(), indexByteSize,
+				submesh.IndexCount, submesh.StartIndexLocation, submesh.BaseVertexLocation);
+		}
+	}
+
+	void GraphicsClass::RebuildPickingBvh()
+	{
+		m_PickableRenderItems.clear();
+		for (auto ri : m_RenderItemLayer[(int)RenderLayer::Opaque])
+		{
+			if (m_RenderItems.Flags(ri).DoPicking)
+				m_PickableRenderItems.push_back(ri);
+		}
+
+		m_PickableBoundsMin.resize(m_PickableRenderItems.size());
+		m_PickableBoundsMax.resize(m_PickableRenderItems.size());
+
+		// Drop the old tree first so the refit only computes the item bounds.
+		m_PickingBvh.Clear();
+		RefitPickingBvh();
+
+		m_PickingBvh.Build((UINT)m_PickableRenderItems.size(), m_PickableBoundsMin.data(), m_PickableBoundsMax.data());
+	}
+
+	void GraphicsClass::RefitPickingBvh()
+	{
+		for (size_t i = 0; i < m_PickableRenderItems.size(); ++i)
+		{
+			auto ri = m_PickableRenderItems[i];
+
+			// The triangle BVH bounds are exact, fall back to the item bounds otherwise.
+			BoundingBox localBounds = m_RenderItems.Bounds(ri).Box;
+			MeshGeometry* geo = m_RenderItems.DrawArgs(ri).Geo;
+			auto bvh = geo->SubmeshBvhs.find(m_RenderItems.Info(ri).GeoShapeName);
+			if (bvh != geo->SubmeshBvhs.end())
+				localBounds = bvh->second.Bounds();
+
+			BoundingBox worldBounds;
+			localBounds.Transform(worldBounds, XMLoadFloat4x4(&m_RenderItems.Transform(ri).World));
+
+			XMVECTOR center = XMLoadFloat3(&worldBounds.Center);
+			XMVECTOR extents = XMLoadFloat3(&worldBounds.Extents);
+			XMStoreFloat3(&m_PickableBoundsMin[i], center - extents);
+			XMStoreFloat3(&m_PickableBoundsMax[i], center + extents);
+		}
+
+		if (!m_PickingBvh.Empty())
+			m_PickingBvh.Refit(m_PickableBoundsMin.data(), m_PickableBoundsMax.data());
+
+		m_PickingBvhIsDirty = false;
+	}
+
+	void GraphicsClass::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const InstanceBatcher::Range& batches,
+		const std::string& pipeline)
+	{
+		if (batches.BatchCount == 0)
+			return;
 
-				ri->NumFramesDirty = gNumFrameResources;
-				ri->Mat->NumFramesDirty = gNumFrameResources;
+		ID3D12PipelineState* pipelineStates[] =
+		{
+			m_PipelineStates->Get(pipeline),
+			m_PipelineStates->Get(pipeline + "Packed"),
+		};
 
-				m_PickedRenderItem->World = ri->World;
-				m_PickedRenderItem->NumFramesDirty = gNumFrameResources;
+		// For each batch...
+		for (UINT i = batches.FirstBatch; i < batches.FirstBatch + batches.BatchCount; ++i)
+		{
+			const InstanceBatch& batch = m_InstanceBatcher.Batches()[i];
+			const RenderItemDrawArgs& drawArgs = m_RenderItems.DrawArgs(batch.Item);
 
-				for (auto& e : m_RenderItemLayer[(int)RenderLayer::Reflected])
+			// Only changes where the batches move between float and packed geometry.
+			ID3D12PipelineState* pipelineState = pipelineStates[drawArgs.Geo->PackedVertices ? 1 : 0];
+			if (m_DrawState.SetPipelineState(pipelineState))
+				cmdList->SetPipelineState(pipelineState);
+
+			// Batches are sorted by geometry, so consecutive draws mostly share it.
+			if (m_DrawState.SetGeometry(drawArgs.Geo))
+			{
+				D3D12_VERTEX_BUFFER_VIEW vertexBufferView = drawArgs.Geo->VertexBufferView();
+				cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
+				D3D12_INDEX_BUFFER_VIEW indexBufferView = drawArgs.Geo->IndexBufferView();
+				cmdList->IASetIndexBuffer(&indexBufferView);
+			}
+
+			// Packed positions are decoded with the quantization of their submesh, which
+			// follows the base instance in the per-draw constants.  Only the hidden
+			// highlight has no submesh.
+			if (drawArgs.Geo->PackedVertices && drawArgs.Submesh != nullptr && m_DrawState.SetSubmesh(drawArgs.Submesh))
+				cmdList->SetGraphicsRoot32BitConstants(1, 6, &drawArgs.Submesh->Quantization, 1);
+			if (m_DrawState.SetPrimitiveType(drawArgs.PrimitiveType))
+				cmdList->IASetPrimitiveTopology(drawArgs.PrimitiveType);
+
+			// SV_InstanceID starts at zero for every draw, the shader adds the batch offset.
+			cmdList->SetGraphicsRoot32BitConstant(1, batch.FirstInstance, 0);
+
+			// An item drawn alone draws only its visible meshlets.  Instances share one
+			// draw and are drawn whole.
+			UINT index = m_RenderItems.IndexOf(batch.Item);
+			if (batch.InstanceCount == 1 && index < m_VisibleMeshlets.size())
+			{
+				const VisibleMeshlets& meshlets = m_VisibleMeshlets[index];
+				if (meshlets.IsCulled)
+				{
+					for (const IndexRange& range : meshlets.Ranges)
+					{
+						cmdList->DrawIndexedInstanced(range.IndexCount, 1,
+							drawArgs.Submesh->StartIndexLocation + range.FirstIndex, drawArgs.BaseVertexLocation, 0);
+					}
+					continue;
+				}
+			}
+
+			cmdList->DrawIndexedInstanced(drawArgs.IndexCount, batch.InstanceCount,
+				drawArgs.StartIndexLocation, drawArgs.BaseVertexLocation, 0);
+		}
+	}
+
+	void GraphicsClass::UpdateImGuiData()
+	{
+		for (auto ri : m_RenderItemLayer[(int)RenderLayer::Opaque])
+		{
+			if (m_RenderItems.Flags(ri).IsPicked)
+			{
+				RenderItemInfo& info = m_RenderItems.Info(ri);
+
+				XMFLOAT3 scaling = m_ImguiManager.GetItemScaling();
+				XMFLOAT3 rotation(
+					XMConvertToRadians(m_ImguiManager.GetItemRotation().x),
+					XMConvertToRadians(m_ImguiManager.GetItemRotation().y),
+					XMConvertToRadians(m_ImguiManager.GetItemRotation().z));
+				XMFLOAT3 translation = m_ImguiManager.GetItemTranslation();
+
+				// The panel reports its values every frame, only rebuild the world matrix
+				// when one of them has been edited.
+				if (memcmp(&scaling, &info.WorldScaling, sizeof(scaling)) != 0 ||
+					memcmp(&rotation, &info.WorldRotation, sizeof(rotation)) != 0 ||
+					memcmp(&translation, &info.WorldTranslation, sizeof(translation)) != 0)
 				{
-					if (e->ReflectionSource == ri)
-						e->Mat = ri->Mat;
+					info.WorldScaling = scaling;
+					info.WorldRotation = rotation;
+					info.WorldTranslation = translation;
+					m_Transforms.SetLocal(m_RenderItems.Transform(ri).TransformNode, scaling, rotation, translation);
+					m_PickingBvhIsDirty = true;
+
+					// The highlight is a root drawn over the picked item.
+					RenderItemInfo& pickedInfo = m_RenderItems.Info(m_PickedRenderItem);
+					pickedInfo.WorldScaling = scaling;
+					pickedInfo.WorldRotation = rotation;
+					pickedInfo.WorldTranslation = translation;
+					m_Transforms.SetLocal(m_RenderItems.Transform(m_PickedRenderItem).TransformNode, scaling, rotation, translation);
+				}
+
+				// The material index is part of the instance data.
+				Material* mat = m_Materials[m_ImguiManager.GetItemMaterial()].get();
+				if (m_RenderItems.Mat(ri) != mat)
+				{
+					m_RenderItems.Mat(ri) = mat;
+					MarkDirty(ri);
+
+					for (auto& e : m_RenderItemLayer[(int)RenderLayer::Reflected])
+					{
+						if (m_RenderItems.Info(e).ReflectionSource == ri)
+						{
+							m_RenderItems.Mat(e) = mat;
+							MarkDirty(e);
+						}
+					}
 				}
 			}
 		}
@@ -1545,45 +2099,34 @@ namespace Graphics
 		int i = 0;
 		for (auto ri : m_RenderItemLayer[(int)RenderLayer::Opaque])
 		{
-			if (m_ImguiManager.GetGeometryShapes().contains(ri->GeoShapeName))
-			{
-				ri->IsVisible = m_ImguiManager.GetGeometryShapes()[ri->GeoShapeName];
-				for (auto& e : m_AllRenderItems)
-				{
-					if (e->ShadowSource == ri)
-						e->IsVisible = ri->IsVisible;
-					if (e->ReflectionSource == ri)
-						e->IsVisible = ri->IsVisible;
-				}
-			}
+			const std::string& geoShapeName = m_RenderItems.Info(ri).GeoShapeName;
+			RenderItemFlags& flags = m_RenderItems.Flags(ri);
+
+			if (m_ImguiManager.GetGeometryShapes().contains(geoShapeName))
+				flags.IsVisible = m_ImguiManager.GetGeometryShapes()[geoShapeName];
 			else
+				flags.IsVisible = m_ImguiManager.GetModels()[geoShapeName];
+
+			bool erase = geoShapeName == m_ImguiManager.GetShapeEraseName();
+
+			for (UINT j = 0; j < m_RenderItems.Count(); ++j)
 			{
-				ri->IsVisible = m_ImguiManager.GetModels()[ri->GeoShapeName];
-				for (auto& e : m_AllRenderItems)
-				{
-					if (e->ShadowSource == ri)
-						e->IsVisible = ri->IsVisible;
-					if (e->ReflectionSource == ri)
-						e->IsVisible = ri->IsVisible;
-				}
+				RenderItemHandle e = m_RenderItems.HandleAt(j);
+				const RenderItemInfo& info = m_RenderItems.Info(e);
+				if (info.ShadowSource == ri || info.ReflectionSource == ri)
+					m_RenderItems.Flags(e).IsVisible = erase ? false : flags.IsVisible;
 			}
 
-			if (ri->GeoShapeName == m_ImguiManager.GetShapeEraseName())
+			if (erase)
 			{
-				for (auto& e : m_AllRenderItems)
-				{
-					if (e->ShadowSource == ri)
-						e->IsVisible = false;
-					if (e->ReflectionSource == ri)
-						e->IsVisible = false;
-				}
-				if (ri->IsPicked)
-					m_PickedRenderItem->IsVisible = false;
+				if (flags.IsPicked)
+					m_RenderItems.Flags(m_PickedRenderItem).IsVisible = false;
 
-				m_RenderItemLayer->erase(m_RenderItemLayer->begin() + i, m_RenderItemLayer->begin() + i + 1);
+				// This frame's batches still reference the item, it is destroyed at the
+				// start of the next update.
+				m_ErasedRenderItems.push_back(ri);
 				m_ImguiManager.EraseShape(m_ImguiManager.GetShapeEraseName());
 				m_ImguiManager.SetShapeEraseName("\0");
-				--m_ObjConstantBufferIndex;
 
 				break;
 			}
@@ -1594,204 +2137,256 @@ namespace Graphics
 		i = 0;
 		for (auto& e : m_Materials)
 		{
-			e.second.get()->DiffuseAlbedo = m_ImguiManager.GetMaterialsAlbedo()[i];
-			e.second.get()->FresnelR0 = m_ImguiManager.GetMaterialsFresnelR0()[i];
-			e.second.get()->Roughness = m_ImguiManager.GetMaterialsRoughness()[i];
-			e.second.get()->NumFramesDirty = gNumFrameResources;
+			Material* mat = e.second.get();
+			XMFLOAT4 albedo = m_ImguiManager.GetMaterialsAlbedo()[i];
+			XMFLOAT3 fresnelR0 = m_ImguiManager.GetMaterialsFresnelR0()[i];
+			float roughness = m_ImguiManager.GetMaterialsRoughness()[i];
+
+			// Only queue materials that were actually edited.
+			if (memcmp(&albedo, &mat->DiffuseAlbedo, sizeof(albedo)) != 0 ||
+				memcmp(&fresnelR0, &mat->FresnelR0, sizeof(fresnelR0)) != 0 ||
+				roughness != mat->Roughness)
+			{
+				mat->DiffuseAlbedo = albedo;
+				mat->FresnelR0 = fresnelR0;
+				mat->Roughness = roughness;
+				MarkDirty(mat);
+			}
 			++i;
 		}
 	}
 
-	void GraphicsClass::AddShape()
+	void GraphicsClass::MarkDirty(RenderItemHandle ri)
 	{
-		ThrowIfFailed(m_CommandList->Reset(m_DirectCommandListAllocator.Get(), nullptr));
+		std::lock_guard<std::mutex> lock(m_DirtyMutex);
+		RenderItemFlags& flags = m_RenderItems.Flags(ri);
+		for (int i = 0; i < (int)m_FrameResources.size(); ++i)
+		{
+			if ((flags.DirtyFrameMask & (1u << i)) == 0)
+			{
+				flags.DirtyFrameMask |= 1u << i;
+				m_FrameResources[i]->DirtyRenderItems.push_back(ri);
+			}
+		}
+	}
+
+	void GraphicsClass::MarkDirty(Material* mat)
+	{
+		std::lock_guard<std::mutex> lock(m_DirtyMutex);
+		for (int i = 0; i < (int)m_FrameResources.size(); ++i)
+		{
+			if ((mat->DirtyFrameMask & (1u << i)) == 0)
+			{
+				mat->DirtyFrameMask |= 1u << i;
+				m_FrameResources[i]->DirtyMaterials.push_back(mat);
+			}
+		}
+	}
+
+	void GraphicsClass::MarkAllDirty()
+	{
+		for (auto& frameResource : m_FrameResources)
+		{
+			frameResource->DirtyRenderItems.clear();
+			frameResource->DirtyMaterials.clear();
+		}
 
+		for (UINT i = 0; i < (UINT)m_RenderItems.Count(); ++i)
+		{
+			RenderItemHandle ri = m_RenderItems.HandleAt(i);
+			m_RenderItems.Flags(ri).DirtyFrameMask = 0;
+			MarkDirty(ri);
+		}
+
+		for (auto& e : m_Materials)
+		{
+			e.second->DirtyFrameMask = 0;
+			MarkDirty(e.second.get());
+		}
+	}
+
+	void GraphicsClass::AddShape()
+	{
 		GeometryGenerator geoGen;
-		GeometryGenerator::MeshData shape;
 		std::string geoShapeName;
 		std::string num = std::to_string(++m_AddedShapesCount);
 		std::string matName;
 
 		AddShapeData addShapeData = m_ImguiManager.GetAddShape();
 
+		// The generator writes straight into the vertex buffer, untextured like the other
+		// shapes.  The passes below work on 32-bit indices.
+		const GeometryGenerator::VertexLayout layout = { sizeof(Vertex), offsetof(Vertex, Normal),
+			GeometryGenerator::NoAttribute, GeometryGenerator::NoAttribute };
+
+		std::vector<Vertex> vertices;
+		std::vector<std::uint32_t> shapeIndices;
+		auto buffers = [&](GeometryGenerator::MeshSize size)
+		{
+			vertices.resize(size.VertexCount);
+			shapeIndices.resize(size.IndexCount);
+			return GeometryGenerator::MeshBuffers{ vertices.data(), layout, shapeIndices.data(), sizeof(std::uint32_t) };
+		};
+
 		if (addShapeData.ShapeGeo == Geometry::Box)
 		{
-			shape = geoGen.CreateBox(addShapeData.BoxWidth, addShapeData.BoxHeight,
-				addShapeData.BoxDepth, addShapeData.BoxNumSubdivisions);
+			geoGen.CreateBox(addShapeData.BoxWidth, addShapeData.BoxHeight,
+				addShapeData.BoxDepth, addShapeData.BoxNumSubdivisions,
+				buffers(GeometryGenerator::BoxSize(addShapeData.BoxNumSubdivisions)));
 			geoShapeName = "box" + num;
 			matName = addShapeData.BoxMaterial;
 		}
 		else if (addShapeData.ShapeGeo == Geometry::Grid)
 		{
-			shape = geoGen.CreateGrid(addShapeData.GridWidth, addShapeData.GridDepth,
-				addShapeData.GridM, addShapeData.GridN);
+			geoGen.CreateGrid(addShapeData.GridWidth, addShapeData.GridDepth,
+				addShapeData.GridM, addShapeData.GridN,
+				buffers(GeometryGenerator::GridSize(addShapeData.GridM, addShapeData.GridN)));
 			geoShapeName = "grid" + num;
 			matName = addShapeData.GridMaterial;
 		}
 		else if (addShapeData.ShapeGeo == Geometry::Sphere)
 		{
-			shape = geoGen.CreateSphere(addShapeData.SphereRadius,
-				addShapeData.SphereSliceCount, addShapeData.SphereStackCount);
+			geoGen.CreateSphere(addShapeData.SphereRadius,
+				addShapeData.SphereSliceCount, addShapeData.SphereStackCount,
+				buffers(GeometryGenerator::SphereSize(addShapeData.SphereSliceCount, addShapeData.SphereStackCount)));
 			geoShapeName = "sphere" + num;
 			matName = addShapeData.SphereMaterial;
 		}
 		else if (addShapeData.ShapeGeo == Geometry::Geosphere)
 		{
-			shape = geoGen.CreateGeosphere(addShapeData.GeosphereRadius,
-				addShapeData.GeosphereNumSubdivisions);
+			geoGen.CreateGeosphere(addShapeData.GeosphereRadius,
+				addShapeData.GeosphereNumSubdivisions,
+				buffers(GeometryGenerator::GeosphereSize(addShapeData.GeosphereNumSubdivisions)));
 			geoShapeName = "geosphere" + num;
 			matName = addShapeData.GeosphereMaterial;
 		}
 		else if (addShapeData.ShapeGeo == Geometry::Cylinder)
 		{
-			shape = geoGen.CreateCylinder(addShapeData.CylinderBottomRadius,
+			geoGen.CreateCylinder(addShapeData.CylinderBottomRadius,
 				addShapeData.CylinderTopRadius, addShapeData.CylinderHeight,
-				addShapeData.CylinderSliceCount, addShapeData.CylinderStackCount);
+				addShapeData.CylinderSliceCount, addShapeData.CylinderStackCount,
+				buffers(GeometryGenerator::CylinderSize(addShapeData.CylinderSliceCount, addShapeData.CylinderStackCount)));
 			geoShapeName = "cylinder" + num;
 			matName = addShapeData.CylinderMaterial;
 		}
 
+		// Grids are flat and the rest convex, their clusters do not occlude each other.
+		GeometryGenerator::PreparedMesh shape = GeometryGenerator::Prepare(vertices.data(), layout,
+			(UINT)vertices.size(), shapeIndices, false);
+		MeshletCuller shapeMeshlets(shape.Meshlets);
+
 		UINT shapeVertexOffset = 0;
 		UINT shapeIndexOffset = 0;
 
-		auto totalVertexCount = shape.Vertices.size();
+		BoundingVolumes shapeBounds = BoundsBuilder::Build(&vertices[0].Pos, sizeof(Vertex), vertices.size());
 
-		std::vector<Vertex> vertices(totalVertexCount);
+		// Large grids need 32-bit indices, the rest is drawn with 16-bit ones.
+		const void* indexData = shapeIndices.data();
+		UINT indexByteSize = sizeof(std::uint32_t);
 
-		XMFLOAT3 vMinf3(+MathHelper::Infinity, +MathHelper::Infinity, +MathHelper::Infinity);
-		XMFLOAT3 vMaxf3(-MathHelper::Infinity, -MathHelper::Infinity, -MathHelper::Infinity);
-
-		XMVECTOR vMin = XMLoadFloat3(&vMinf3);
-		XMVECTOR vMax = XMLoadFloat3(&vMaxf3);
-
-		UINT k = 0;
-		for (size_t i = 0; i < shape.Vertices.size(); ++i, ++k)
+		std::vector<std::uint16_t> indices;
+		if (vertices.size() <= 0x10000)
 		{
-			vertices[k].Pos = shape.Vertices[i].Position;
-			vertices[k].Normal = shape.Vertices[i].Normal;
-
-			XMVECTOR P = XMLoadFloat3(&vertices[i].Pos);
+			indices.reserve(shapeIndices.size());
+			for (std::uint32_t index : shapeIndices)
+				indices.push_back((std::uint16_t)index);
 
-			vertices[i].TexC = { 0.0f, 0.0f };
-
-			vMin = XMVectorMin(vMin, P);
-			vMax = XMVectorMax(vMax, P);
+			indexData = indices.data();
+			indexByteSize = sizeof(std::uint16_t);
 		}
 
-		BoundingBox shapeBounds;
-		XMStoreFloat3(&shapeBounds.Center, 0.5f * (vMin + vMax));
-		XMStoreFloat3(&shapeBounds.Extents, 0.5f * (vMax - vMin));
-
-		std::vector<std::uint16_t> indices;
-		indices.insert(indices.end(), std::begin(shape.GetIndices16()), std::end(shape.GetIndices16()));
-
-		const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
-		const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
+		const UINT ibByteSize = (UINT)shapeIndices.size() * indexByteSize;
 
 		auto geo = std::make_unique<MeshGeometry>();
 
 		std::string geoName = "addedShapeGeo" + num;
 		geo->Name = geoName;
 
-		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
-		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
-
 		ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+		CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexData, ibByteSize);
 
-		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+		geo->IndexBufferGPU = m_UploadService->CreateDefaultBuffer(indexData, ibByteSize);
 
-		geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(m_d3dDevice.Get(),
-			m_CommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
-
-		geo->VertexByteStride = sizeof(Vertex);
-		geo->VertexBufferByteSize = vbByteSize;
-		geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+		geo->IndexFormat = indexByteSize == sizeof(std::uint32_t) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
 		geo->IndexBufferByteSize = ibByteSize;
 
 		SubmeshGeometry shapeSubmesh;
-		shapeSubmesh.IndexCount = (UINT)shape.Indices32.size();
+		shapeSubmesh.IndexCount = shape.Lods[0].IndexCount;
 		shapeSubmesh.StartIndexLocation = shapeIndexOffset;
 		shapeSubmesh.BaseVertexLocation = shapeVertexOffset;
+		shapeSubmesh.VertexCount = (UINT)vertices.size();
 		shapeSubmesh.Bounds = shapeBounds;
+		shapeSubmesh.Lods = shape.Lods;
+		shapeSubmesh.Meshlets = shapeMeshlets;
 
 		geo->DrawArgs[geoShapeName] = shapeSubmesh;
 
+		CreateVertexBuffer(geo.get(), vertices.data(), (UINT)vertices.size());
+		BuildTriangleBvhs(geo.get());
+
 		m_Geometries[geo->Name] = std::move(geo);
 
-		auto shapeRitem = std::make_unique<RenderItem>();
-		XMStoreFloat3(&shapeRitem->WorldScaling, { 1.0f, 1.0f, 1.0f });
-		XMStoreFloat3(&shapeRitem->WorldTranslation, { addShapeData.Pos.x,
+		RenderItemDesc shapeRitem;
+		XMStoreFloat3(&shapeRitem.WorldScaling, { 1.0f, 1.0f, 1.0f });
+		XMStoreFloat3(&shapeRitem.WorldTranslation, { addShapeData.Pos.x,
 			addShapeData.Pos.y, addShapeData.Pos.z });
-		XMStoreFloat4x4(&shapeRitem->World, XMMatrixTranslation(shapeRitem->WorldTranslation.x,
-			shapeRitem->WorldTranslation.y, shapeRitem->WorldTranslation.z));
-		XMStoreFloat4x4(&shapeRitem->TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
-		shapeRitem->GeoName = geoName;
-		shapeRitem->GeoShapeName = geoShapeName;
-		shapeRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		shapeRitem->Mat = m_Materials[matName].get();
-		shapeRitem->Geo = m_Geometries[shapeRitem->GeoName].get();
-		shapeRitem->DoPicking = true;
-		shapeRitem->PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-		shapeRitem->Bounds = shapeRitem->Geo->DrawArgs[shapeRitem->GeoShapeName].Bounds;
-		shapeRitem->IndexCount = shapeRitem->Geo->DrawArgs[shapeRitem->GeoShapeName].IndexCount;
-		shapeRitem->StartIndexLocation = shapeRitem->Geo->DrawArgs[shapeRitem->GeoShapeName].StartIndexLocation;
-		shapeRitem->BaseVertexLocation = shapeRitem->Geo->DrawArgs[shapeRitem->GeoShapeName].BaseVertexLocation;
-		m_RenderItemLayer[(int)RenderLayer::Opaque].push_back(shapeRitem.get());
-		m_ImguiManager.SetGeometryShapes(shapeRitem->GeoShapeName, shapeRitem->IsVisible);
-
-		auto reflectedShapeRitem = std::make_unique<RenderItem>();
-		*reflectedShapeRitem = *shapeRitem;
-		reflectedShapeRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedShapeRitem->GeoShapeName = "refl" + geoShapeName;
-		reflectedShapeRitem->FrustumTest = false;
-		reflectedShapeRitem->ReflectionSource = shapeRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::Reflected].push_back(reflectedShapeRitem.get());
-
-		auto shadowedShapeRitem = std::make_unique<RenderItem>();
-		*shadowedShapeRitem = *shapeRitem;
-		shadowedShapeRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		shadowedShapeRitem->Mat = m_Materials["shadowMat"].get();
-		shadowedShapeRitem->GeoShapeName = "shadow" + geoShapeName;
-		shadowedShapeRitem->ShadowSource = shapeRitem.get();
-		shadowedShapeRitem->ShadowIndex = 0;
-		m_RenderItemLayer[(int)RenderLayer::Shadow].push_back(shadowedShapeRitem.get());
-
-		auto reflectedShadowedShapeRitem = std::make_unique<RenderItem>();
-		*reflectedShadowedShapeRitem = *shadowedShapeRitem;
-		reflectedShadowedShapeRitem->ObjConstantBufferIndex = m_ObjConstantBufferIndex++;
-		reflectedShadowedShapeRitem->GeoShapeName = "reflShadow" + geoShapeName;
-		reflectedShadowedShapeRitem->FrustumTest = false;
-		reflectedShadowedShapeRitem->ReflectionSource = shadowedShapeRitem.get();
-		m_RenderItemLayer[(int)RenderLayer::ShadowReflected].push_back(reflectedShadowedShapeRitem.get());
-
-		m_AllRenderItems.push_back(std::move(shapeRitem));
-		m_AllRenderItems.push_back(std::move(reflectedShapeRitem));
-		m_AllRenderItems.push_back(std::move(shadowedShapeRitem));
-		m_AllRenderItems.push_back(std::move(reflectedShadowedShapeRitem));
-
-		m_FrameResources.clear();
-
-		for (int i = 0; i < gNumFrameResources; ++i)
-		{
-			m_FrameResources.push_back(std::make_unique<FrameResource>(m_d3dDevice.Get(),
-				2, (UINT)m_AllRenderItems.size(), (UINT)m_Materials.size()));
-		}
-
-		for (int i = 0; i < (int)RenderLayer::Count; i++)
-		{
-			for (auto e : m_RenderItemLayer[i])
-			{
-				e->NumFramesDirty = gNumFrameResources;
-				e->Mat->NumFramesDirty = gNumFrameResources;
-			}
-		}
-
-		ThrowIfFailed(m_CommandList->Close());
-		ID3D12CommandList* cmdsLists[] = { m_CommandList.Get() };
-		m_CommandQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
-		FlushCommandQueue();
+		XMStoreFloat4x4(&shapeRitem.TexTransform, XMMatrixScaling(1.0f, 1.0f, 1.0f));
+		shapeRitem.GeoName = geoName;
+		shapeRitem.GeoShapeName = geoShapeName;
+		shapeRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shapeRitem.Mat = m_Materials[matName].get();
+		shapeRitem.Geo = m_Geometries[shapeRitem.GeoName].get();
+		shapeRitem.DoPicking = true;
+		shapeRitem.PrimitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		shapeRitem.Bounds = shapeRitem.Geo->DrawArgs[shapeRitem.GeoShapeName].Bounds;
+		shapeRitem.IndexCount = shapeRitem.Geo->DrawArgs[shapeRitem.GeoShapeName].IndexCount;
+		shapeRitem.StartIndexLocation = shapeRitem.Geo->DrawArgs[shapeRitem.GeoShapeName].StartIndexLocation;
+		shapeRitem.BaseVertexLocation = shapeRitem.Geo->DrawArgs[shapeRitem.GeoShapeName].BaseVertexLocation;
+		shapeRitem.Submesh = &shapeRitem.Geo->DrawArgs[shapeRitem.GeoShapeName];
+		RenderItemHandle shapeItem = m_RenderItems.Create(shapeRitem);
+		m_ImguiManager.SetGeometryShapes(shapeRitem.GeoShapeName, shapeRitem.IsVisible);
+
+		RenderItemDesc reflectedShapeRitem = shapeRitem;
+		reflectedShapeRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShapeRitem.GeoShapeName = "refl" + geoShapeName;
+		reflectedShapeRitem.FrustumTest = false;
+		reflectedShapeRitem.ReflectionSource = shapeItem;
+		RenderItemHandle reflectedShapeItem = m_RenderItems.Create(reflectedShapeRitem);
+
+		RenderItemDesc shadowedShapeRitem = shapeRitem;
+		shadowedShapeRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		shadowedShapeRitem.Mat = m_Materials["shadowMat"].get();
+		shadowedShapeRitem.GeoShapeName = "shadow" + geoShapeName;
+		shadowedShapeRitem.ShadowSource = shapeItem;
+		shadowedShapeRitem.ShadowIndex = 0;
+		RenderItemHandle shadowedShapeItem = m_RenderItems.Create(shadowedShapeRitem);
+
+		RenderItemDesc reflectedShadowedShapeRitem = shadowedShapeRitem;
+		reflectedShadowedShapeRitem.ObjConstantBufferIndex = m_ObjectSlots.Allocate();
+		reflectedShadowedShapeRitem.GeoShapeName = "reflShadow" + geoShapeName;
+		reflectedShadowedShapeRitem.FrustumTest = false;
+		reflectedShadowedShapeRitem.ReflectionSource = shadowedShapeItem;
+		RenderItemHandle reflectedShadowedShapeItem = m_RenderItems.Create(reflectedShadowedShapeRitem);
+
+		BuildTransformHierarchy();
+
+		// Only the new items need uploading.  The frame resources make room for their
+		// slots when they come around again.
+		MarkDirty(shapeItem);
+		MarkDirty(reflectedShapeItem);
+		MarkDirty(shadowedShapeItem);
+		MarkDirty(reflectedShadowedShapeItem);
+
+		// The items are drawn once the copy queue has passed the ticket, the main loop
+		// does not wait for it.
+		PendingShape pending;
+		pending.UploadTicket = m_UploadService->Flush();
+		pending.Items = {
+			{ RenderLayer::Opaque, shapeItem },
+			{ RenderLayer::Reflected, reflectedShapeItem },
+			{ RenderLayer::Shadow, shadowedShapeItem },
+			{ RenderLayer::ShadowReflected, reflectedShadowedShapeItem } };
+		m_PendingShapes.push_back(std::move(pending));
 
 		m_ImguiManager.AddShapeFlag(false);
 	}
@@ -1802,8 +2397,8 @@ namespace Graphics
 
 		auto mat = std::make_unique<Material>();
 		mat->Name = addMaterialData.Name;
-		mat->MatCBIndex = m_MatConstantBufferIndex++;
-		mat->DiffuseSrvHeapIndex = 0;
+		mat->MatCBIndex = m_MaterialSlots.Allocate();
+		mat->DiffuseSrvHeapIndex = m_TextureRegistry.IndexOf("bricksTex");
 		mat->DiffuseAlbedo = addMaterialData.Albedo;
 		mat->FresnelR0 = addMaterialData.FresnelR0;
 		mat->Roughness = addMaterialData.Roughness;
@@ -1814,32 +2409,137 @@ namespace Graphics
 		m_ImguiManager.SetMaterialsFresnelR0(mat->FresnelR0);
 		m_ImguiManager.SetMaterialsRoughness(mat->Roughness);
 
+		Material* newMat = mat.get();
 		m_Materials[addMaterialData.Name] = std::move(mat);
+		MarkDirty(newMat);
 
-		m_FrameResources.clear();
+		m_ImguiManager.CreateMaterialFlag(false);
+	}
 
-		for (int i = 0; i < gNumFrameResources; ++i)
+	void GraphicsClass::AddUploadedShapes()
+	{
+		auto uploaded = [this](const PendingShape& shape)
+			{
+				return m_UploadService->IsComplete(shape.UploadTicket);
+			};
+
+		bool added = false;
+		for (const PendingShape& shape : m_PendingShapes)
 		{
-			m_FrameResources.push_back(std::make_unique<FrameResource>(m_d3dDevice.Get(),
-				2, (UINT)m_AllRenderItems.size(), (UINT)m_Materials.size()));
+			if (!uploaded(shape))
+				continue;
+
+			for (auto& item : shape.Items)
+				m_RenderItemLayer[(int)item.first].push_back(item.second);
+			added = true;
 		}
-		
-		for (int i = 0; i < (int)RenderLayer::Count; i++)
+
+		if (added)
 		{
-			for (auto e : m_RenderItemLayer[i])
+			std::erase_if(m_PendingShapes, uploaded);
+			RebuildLayerMasks();
+			RebuildPickingBvh();
+		}
+	}
+
+	void GraphicsClass::EraseShapes()
+	{
+		if (m_ErasedRenderItems.empty())
+			return;
+
+		// Shadows and reflections go with their source, reflected shadows with their
+		// shadow.  Items reached twice are skipped once they are destroyed.
+		std::vector<RenderItemHandle> erased;
+		erased.swap(m_ErasedRenderItems);
+		std::vector<MeshGeometry*> geometries;
+		for (size_t i = 0; i < erased.size(); ++i)
+		{
+			for (UINT j = 0; j < m_RenderItems.Count(); ++j)
 			{
-				e->NumFramesDirty = gNumFrameResources;
-				e->Mat->NumFramesDirty = gNumFrameResources;
+				RenderItemHandle e = m_RenderItems.HandleAt(j);
+				const RenderItemInfo& info = m_RenderItems.Info(e);
+				if (info.ShadowSource == erased[i] || info.ReflectionSource == erased[i])
+					erased.push_back(e);
 			}
 		}
 
-		m_ImguiManager.CreateMaterialFlag(false);
+		for (RenderItemHandle ri : erased)
+		{
+			if (!m_RenderItems.IsValid(ri))
+				continue;
+
+			MeshGeometry* geo = m_RenderItems.DrawArgs(ri).Geo;
+			if (std::find(geometries.begin(), geometries.end(), geo) == geometries.end())
+				geometries.push_back(geo);
+			DestroyRenderItem(ri);
+		}
+
+		// Added shapes own their geometry, shared geometry stays while other items use it.
+		// The highlight falls back to its initial geometry.
+		for (MeshGeometry* geo : geometries)
+		{
+			bool used = false;
+			for (UINT i = 0; i < m_RenderItems.Count() && !used; ++i)
+			{
+				RenderItemHandle ri = m_RenderItems.HandleAt(i);
+				used = ri != m_PickedRenderItem && m_RenderItems.DrawArgs(ri).Geo == geo;
+			}
+			if (used)
+				continue;
+
+			if (m_RenderItems.DrawArgs(m_PickedRenderItem).Geo == geo)
+			{
+				RenderItemDrawArgs pickedDrawArgs = m_RenderItems.DrawArgs(m_PickedRenderItem);
+				pickedDrawArgs.Geo = m_Geometries["shapeGeo"].get();
+				pickedDrawArgs.IndexCount = 0;
+				pickedDrawArgs.StartIndexLocation = 0;
+				pickedDrawArgs.BaseVertexLocation = 0;
+				pickedDrawArgs.Submesh = nullptr;
+				pickedDrawArgs.Lod = 0;
+				m_RenderItems.SetDrawArgs(m_PickedRenderItem, pickedDrawArgs);
+				m_RenderItems.Flags(m_PickedRenderItem).IsVisible = false;
+			}
+
+			RetireGeometry(geo);
+		}
+
+		BuildTransformHierarchy();
+		RebuildLayerMasks();
+		RebuildPickingBvh();
 	}
 
-	void GraphicsClass::Pick(int sx, int sy)
+	void GraphicsClass::RetireGeometry(MeshGeometry* geo)
 	{
-		bool pick = false;
+		// Frames still in flight may draw the geometry, the last one signals m_CurrentFence.
+		m_DeferredReleases.Release(m_CurrentFence, std::move(geo->VertexBufferGPU));
+		m_DeferredReleases.Release(m_CurrentFence, std::move(geo->IndexBufferGPU));
+		m_DeferredReleases.Release(m_CurrentFence, std::move(geo->VertexBufferUploader));
+		m_DeferredReleases.Release(m_CurrentFence, std::move(geo->IndexBufferUploader));
+
+		// The key lives in the geometry that is erased.
+		std::string name = geo->Name;
+		m_Geometries.erase(name);
+	}
+
+	void GraphicsClass::DestroyRenderItem(RenderItemHandle ri)
+	{
+		m_ObjectSlots.Free(m_RenderItems.Transform(ri).ObjConstantBufferIndex);
+
+		for (auto& layer : m_RenderItemLayer)
+			std::erase(layer, ri);
+		for (auto& layer : m_VisibleRenderItemLayer)
+			std::erase(layer, ri);
+
+		// The store moves its last item into the freed index, the culler has to pick up
+		// the bounds at the new index.
+		UINT index = m_RenderItems.IndexOf(ri);
+		m_RenderItems.Destroy(ri);
+		if (index < m_RenderItems.Count())
+			MarkDirty(m_RenderItems.HandleAt(index));
+	}
 
+	void GraphicsClass::Pick(int sx, int sy)
+	{
 		XMFLOAT4X4 P = m_Camera.GetProj4x4f();
 
 		// Compute picking ray in view space.
@@ -1850,108 +2550,95 @@ namespace Graphics
 		XMVECTOR detV = XMMatrixDeterminant(V);
 		XMMATRIX invView = XMMatrixInverse(&detV, V);
 
+		// Ray in world space.  The direction is left unnormalized so the hit distances of
+		// different items, measured in their local spaces, stay comparable.
+		XMVECTOR rayOrigin = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), invView);
+		XMVECTOR rayDir = XMVector3TransformNormal(XMVectorSet(vx, vy, 1.0f, 0.0f), invView);
+
 		// Assume nothing is picked to start, so the picked render-item is invisible.
-		m_PickedRenderItem->IsVisible = false;
+		m_RenderItems.Flags(m_PickedRenderItem).IsVisible = false;
+		for (auto ri : m_PickableRenderItems)
+			m_RenderItems.Flags(ri).IsPicked = false;
 
-		// Check if we picked an opaque render item.  A real app might keep a separate "picking list"
-		// of objects that can be selected.   
-		for (auto ri : m_RenderItemLayer[(int)RenderLayer::Opaque])
-		{
-			auto geo = ri->Geo;
+		if (m_PickingBvhIsDirty)
+			RefitPickingBvh();
 
-			ri->IsPicked = false;
+		// Walk the scene BVH front to back.  Items whose box starts beyond the nearest
+		// triangle hit so far are skipped without touching their triangles.
+		RenderItemHandle pickedRitem;
+		const std::vector<UINT>& pickableIndices = m_PickingBvh.PrimitiveIndices();
 
-			// Skip invisible render-items.
-			if (ri->IsVisible == false || ri->DoPicking == false)
-				continue;
+		m_PickingBvh.Intersect(rayOrigin, rayDir, MathHelper::Infinity, [&](UINT slot, float tMax)
+			{
+				RenderItemHandle ri = m_PickableRenderItems[pickableIndices[slot]];
 
-			XMMATRIX W = XMLoadFloat4x4(&ri->World);
-			XMVECTOR detW = XMMatrixDeterminant(W);
-			XMMATRIX invWorld = XMMatrixInverse(&detW, W);
+				// Skip invisible render-items.
+				if (m_RenderItems.Flags(ri).IsVisible == false)
+					return tMax;
 
-			// Tranform ray to vi space of Mesh.
-			XMMATRIX toLocal = XMMatrixMultiply(invView, invWorld);
+				MeshGeometry* geo = m_RenderItems.DrawArgs(ri).Geo;
+				auto bvh = geo->SubmeshBvhs.find(m_RenderItems.Info(ri).GeoShapeName);
+				if (bvh == geo->SubmeshBvhs.end())
+					return tMax;
 
-			// Ray definition in view space.
-			XMVECTOR rayOrigin = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-			XMVECTOR rayDir = XMVectorSet(vx, vy, 1.0f, 0.0f);
+				XMMATRIX W = XMLoadFloat4x4(&m_RenderItems.Transform(ri).World);
+				XMVECTOR detW = XMMatrixDeterminant(W);
+				XMMATRIX invWorld = XMMatrixInverse(&detW, W);
 
-			rayOrigin = XMVector3TransformCoord(rayOrigin, toLocal);
-			rayDir = XMVector3TransformNormal(rayDir, toLocal);
+				// Transform ray to the local space of the mesh.
+				XMVECTOR localOrigin = XMVector3TransformCoord(rayOrigin, invWorld);
+				XMVECTOR localDir = XMVector3TransformNormal(rayDir, invWorld);
 
-			// Make the ray direction unit length for the intersection tests.
-			rayDir = XMVector3Normalize(rayDir);
+				float t = tMax;
+				UINT triangle = 0;
+				if (bvh->second.Intersect(localOrigin, localDir, t, triangle))
+					pickedRitem = ri;
 
-			// If we hit the bounding box of the Mesh, then we might have picked a Mesh triangle,
-			// so do the ray/triangle tests.
-			//
-			// If we did not hit the bounding box, then it is impossible that we hit 
-			// the Mesh, so do not waste effort doing ray/triangle tests.
-			float tmin = 0.0f;
+				return t;
+			});
 
-			if (ri->Bounds.Intersects(rayOrigin, rayDir, tmin))
-			{
-				// NOTE: For the demo, we know what to cast the vertex/index data to.  If we were mixing
-				// formats, some metadata would be needed to figure out what to cast it to.
-				auto vertices = (Vertex*)geo->VertexBufferCPU->GetBufferPointer();
-				auto indices = (std::uint16_t*)geo->IndexBufferCPU->GetBufferPointer();
-				UINT triCount = ri->IndexCount / 3;
-
-				// Find the nearest ray/triangle intersection.
-				tmin = MathHelper::Infinity;
-				for (UINT i = 0; i < triCount; ++i)
-				{
-					// Indices for this triangle.
-					UINT i0 = indices[i * 3 + 0];
-					UINT i1 = indices[i * 3 + 1];
-					UINT i2 = indices[i * 3 + 2];
-
-					// Vertices for this triangle.
-					XMVECTOR v0 = XMLoadFloat3(&vertices[i0].Pos);
-					XMVECTOR v1 = XMLoadFloat3(&vertices[i1].Pos);
-					XMVECTOR v2 = XMLoadFloat3(&vertices[i2].Pos);
-
-					// We have to iterate over all the triangles in order to find the nearest intersection.
-					float t = 0.0f;
-					if (TriangleTests::Intersects(rayOrigin, rayDir, v0, v1, v2, t))
-					{
-						if (t < tmin)
-						{
-							// This is the new nearest picked triangle.
-							tmin = t;
-							UINT pickedTriangle = i;
-
-							//m_RenderItemLayer[(int)RenderLayer::Opaque].at(i)->Picked = true;
-							ri->IsPicked = true;
-
-							m_PickedRenderItem->IsVisible = true;
-							m_PickedRenderItem->Geo = m_Geometries[ri->GeoName].get();
-							m_PickedRenderItem->IndexCount = ri->Geo->DrawArgs[ri->GeoShapeName].IndexCount;
-							m_PickedRenderItem->BaseVertexLocation = ri->Geo->DrawArgs[ri->GeoShapeName].BaseVertexLocation;
-							// Offset to the picked triangle in the mesh index buffer.
-							m_PickedRenderItem->StartIndexLocation = ri->Geo->DrawArgs[ri->GeoShapeName].StartIndexLocation;
-							// Picked render item needs same world matrix as object picked.
-							m_PickedRenderItem->World = ri->World;
-							m_PickedRenderItem->NumFramesDirty = gNumFrameResources;
-							m_ImguiManager.UpdateItems(ri->IsPicked, ri->GeoShapeName, ri->Mat->Name,
-								ri->WorldScaling, ri->WorldRotation, ri->WorldTranslation);
-							pick = true;
-						}
-					}
-				}
-			}
-		}
-		if (!pick)
+		if (!m_RenderItems.IsValid(pickedRitem))
+		{
 			m_ImguiManager.UpdateItems(false);
+			return;
+		}
+
+		auto ri = pickedRitem;
+		const RenderItemInfo& info = m_RenderItems.Info(ri);
+		const SubmeshGeometry& submesh = m_RenderItems.DrawArgs(ri).Geo->DrawArgs[info.GeoShapeName];
+
+		m_RenderItems.Flags(ri).IsPicked = true;
+
+		m_RenderItems.Flags(m_PickedRenderItem).IsVisible = true;
+		RenderItemDrawArgs pickedDrawArgs = m_RenderItems.DrawArgs(m_PickedRenderItem);
+		pickedDrawArgs.Geo = m_Geometries[info.GeoName].get();
+		pickedDrawArgs.IndexCount = submesh.IndexCount;
+		pickedDrawArgs.BaseVertexLocation = submesh.BaseVertexLocation;
+		pickedDrawArgs.StartIndexLocation = submesh.StartIndexLocation;
+		pickedDrawArgs.Submesh = &submesh;
+		pickedDrawArgs.Lod = 0;
+		m_RenderItems.SetDrawArgs(m_PickedRenderItem, pickedDrawArgs);
+		// Same bounds as the picked item, so both select the same level of detail.
+		m_RenderItems.Bounds(m_PickedRenderItem) = submesh.Bounds;
+		// Picked render item needs same world matrix as object picked.
+		RenderItemInfo& pickedInfo = m_RenderItems.Info(m_PickedRenderItem);
+		pickedInfo.WorldScaling = info.WorldScaling;
+		pickedInfo.WorldRotation = info.WorldRotation;
+		pickedInfo.WorldTranslation = info.WorldTranslation;
+		m_Transforms.SetLocal(m_RenderItems.Transform(m_PickedRenderItem).TransformNode,
+			info.WorldScaling, info.WorldRotation, info.WorldTranslation);
+		m_ImguiManager.UpdateItems(true, info.GeoShapeName, m_RenderItems.Mat(ri)->Name,
+			info.WorldScaling, info.WorldRotation, info.WorldTranslation);
 	}
 
 	void GraphicsClass::MoveRenderItem(int sx, int sy, int sz)
 	{
 		for (auto ri : m_RenderItemLayer[(int)RenderLayer::Opaque])
 		{
-			if (ri->IsPicked)
+			if (m_RenderItems.Flags(ri).IsPicked)
 			{
-				DirectX::XMFLOAT3 translation = ri->WorldTranslation;
+				RenderItemInfo& info = m_RenderItems.Info(ri);
+				DirectX::XMFLOAT3 translation = info.WorldTranslation;
 
 				if (sx < m_LastMousePos.x)
 					translation.x -= 0.05f;
@@ -1966,16 +2653,13 @@ namespace Graphics
 				if (sz > 0)
 					translation.y += 0.1f;
 
-				ri->WorldTranslation = translation;
-
-				XMMATRIX world = XMMatrixIdentity();
-				world *= XMMatrixScaling(ri->WorldScaling.x, ri->WorldScaling.y, ri->WorldScaling.z);
-				world *= XMMatrixRotationX(ri->WorldRotation.x) * XMMatrixRotationY(ri->WorldRotation.y) * XMMatrixRotationZ(ri->WorldRotation.z);
-				world *= XMMatrixTranslation(ri->WorldTranslation.x, ri->WorldTranslation.y, ri->WorldTranslation.z);
-				XMStoreFloat4x4(&ri->World, world);
+				info.WorldTranslation = translation;
+				m_Transforms.SetLocal(m_RenderItems.Transform(ri).TransformNode, info.WorldScaling, info.WorldRotation, info.WorldTranslation);
+				m_PickingBvhIsDirty = true;
 
-				ri->NumFramesDirty = gNumFrameResources;
-				ri->IsPicked = false;
+				// Picking below tests the moved world matrix.
+				PropagateTransforms();
+				m_RenderItems.Flags(ri).IsPicked = false;
 
 				Pick(sx, sy);
 			}
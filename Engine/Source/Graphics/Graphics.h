@@ -6,6 +6,17 @@
 #include "FrameResource.h"
 #include "GeometryGenerator.h"
 #include "Camera.h"
+#include "FrustumCuller.h"
+#include "TransformHierarchy.h"
+#include "RenderItemStore.h"
+#include "InstanceBatcher.h"
+#include "DrawStateCache.h"
+#include "MeshFile.h"
+#include "UploadService.h"
+#include "DeferredReleaseQueue.h"
+#include "PipelineStateManager.h"
+#include "Common/SlotAllocator.h"
+#include "Common/TextureRegistry.h"
 
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -28,7 +39,13 @@ namespace Graphics
 
 		virtual void Initialize(HWND mainWnd, int width, int height) override;
 
+		// Upload buffer bytes written by the last frame's update.
+		UINT64 GetInstanceBufferBytesWritten() const;
+		UINT64 GetMaterialBufferBytesWritten() const;
+		UINT64 GetPassConstantBufferBytesWritten() const;
+
 	protected:
+		virtual std::wstring CalculateFrameStats() override;
 		virtual void OnResize() override;
 		virtual void Update(const Timer& gameTimer) override;
 		virtual void Draw(const Timer& gameTimer) override;
@@ -39,11 +56,19 @@ namespace Graphics
 		void OnMouseWheel(WPARAM buttonState, int x, int y, int z) override;
 
 		void OnKeyboardInput(const Timer& gameTimer);
+		void UpdateCullingBounds(const Timer& gameTimer);
 		void FrustumCulling(const Timer& gameTimer);
-		void UpdateReflections(const Timer& gameTimer);
-		void UpdateShadows(const Timer& gameTimer);
-		void UpdateObjectConstantBuffers(const Timer& gameTimer);
-		void UpdateMaterialConstantBuffers(const Timer& gameTimer);
+		// Picks the level of detail of every visible item from its projected size.
+		void SelectLods(const Timer& gameTimer);
+		// Culls the meshlets of the visible items that draw their full level of detail.
+		// Items whose world is not an invertible affine transform, like the shadows that
+		// are flattened onto their plane, are drawn whole.
+		void CullMeshlets(const Timer& gameTimer);
+		static bool IsInvertibleAffine(const DirectX::XMFLOAT4X4& world);
+		void UpdateTransforms(const Timer& gameTimer);
+		void UpdateInstanceBuffer(const Timer& gameTimer);
+		void UpdateMaterialBuffer(const Timer& gameTimer);
+		void BuildInstanceBatches(const Timer& gameTimer);
 		void UpdateMainPassConstantBuffer(const Timer& gameTimer);
 		void UpdateReflectedPassConstantBuffer(const Timer& gameTimer);
 
@@ -53,17 +78,47 @@ namespace Graphics
 		void BuildShadersAndInputLayout();
 		void BuildRoomGeometry();
 		void BuildShapeGeometry();
-		void BuildCarGeometry();
+		void BuildModelGeometry(const std::string& name);
+		bool LoadModel(const std::wstring& name, MeshFile& meshFile);
 		void BuildPipelineStateObjects();
 		void BuildFrameResources();
 		void BuildMaterials();
 		void BuildRenderItems();
-		void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+		void RebuildLayerMasks();
+		// Number of layer entries, the most instances a frame can draw.
+		UINT LayerItemCount() const;
+		void BuildTransformHierarchy();
+		// Copies the world matrices of the moved nodes to their render items.
+		void PropagateTransforms();
+		// Creates the vertex buffers of geo and its CPU copy.  With PackVertices the vertices
+		// of each submesh are packed within the submesh's bounds.
+		void CreateVertexBuffer(MeshGeometry* geo, const Vertex* vertices, UINT vertexCount);
+		void BuildTriangleBvhs(MeshGeometry* geo);
+		void RebuildPickingBvh();
+		void RefitPickingBvh();
+		// Draws with the named pipeline, or its packed variant for geometry with packed vertices.
+		void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const InstanceBatcher::Range& batches,
+			const std::string& pipeline);
 		void UpdateImGuiData();
 		void UpdateLights();
 		void UpdateSceneData();
+		// Queue the constants of an item or material for upload in every frame resource.
+		// Safe to call from the update jobs.
+		void MarkDirty(RenderItemHandle ri);
+		void MarkDirty(Material* mat);
+		// Requeues everything, after the frame resources have been recreated.
+		void MarkAllDirty();
 		void AddShape();
 		void AddMaterial();
+		// Removes the shapes erased in the editor together with their shadows and
+		// reflections, and releases their instance buffer slots.
+		void EraseShapes();
+		// Puts the added shapes whose geometry has finished uploading into their layers.
+		void AddUploadedShapes();
+		void DestroyRenderItem(RenderItemHandle ri);
+		// Hands the GPU buffers of a geometry no render item uses to the deferred release
+		// queue and forgets the geometry.
+		void RetireGeometry(MeshGeometry* geo);
 
 		void Pick(int sx, int sy);
 		void MoveRenderItem(int sx, int sy, int sz);
@@ -71,43 +126,120 @@ namespace Graphics
 		std::array<const CD3DX12_STATIC_SAMPLER_DESC, 6> GetStaticSamplers();
 
 	protected:
+		// Render items per job in the parallel loops of the update stages.
+		static const UINT RenderItemsPerJob = 256;
+		// Staging memory of the upload service.  Larger buffers are copied in pieces.
+		static const UINT64 StagingBufferSize = 16 * 1024 * 1024;
+		// Size of the texture table the shaders index with the material's texture index.
+		static const UINT MaxTextures = 1024;
+		// A level of detail is drawn while its error covers at most this many pixels.
+		static constexpr float MaxLodPixelError = 1.0f;
+		// Upload the shapes and models as PackedVertex, the room keeps float vertices.
+		static constexpr bool PackVertices = true;
+
+		// Declared first so the worker threads outlive every member that jobs touch.
+		JobSystem m_JobSystem;
+
 		Camera m_Camera;
 
 		std::vector<std::unique_ptr<FrameResource>> m_FrameResources;
 		FrameResource* m_CurrentFrameResource = nullptr;
 		int m_CurrentFrameResourceIndex = 0;
 
-		UINT m_CbvSrvDescriptorSize = 0;
-
 		ComPtr<ID3D12RootSignature> m_RootSignature = nullptr;
 
-		ComPtr<ID3D12DescriptorHeap> m_ShaderResourceViewDescriptorHeap = nullptr;
+		// Texture table bound once per frame, a texture's descriptor sits at its registry
+		// index from the start of the table.
+		UINT m_TextureTableIndex = 0;
+		TextureRegistry m_TextureRegistry{ MaxTextures };
 
 		std::unordered_map<std::string, std::unique_ptr<MeshGeometry>> m_Geometries;
 		std::unordered_map<std::string, std::unique_ptr<Material>> m_Materials;
 		std::unordered_map<std::string, std::unique_ptr<Texture>> m_Textures;
 		std::unordered_map<std::string, ComPtr<ID3DBlob>> m_Shaders;
-		std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> m_PipelineStateObjects;
+		std::unique_ptr<PipelineStateManager> m_PipelineStates;
 
 		std::vector<D3D12_INPUT_ELEMENT_DESC> m_InputLayout;
+		std::vector<D3D12_INPUT_ELEMENT_DESC> m_PackedInputLayout;
 
-		// List of all the render items.
-		std::vector<std::unique_ptr<RenderItem>> m_AllRenderItems;
+		// All the render items.
+		RenderItemStore m_RenderItems;
 		// Render items divided by PSO.
-		std::vector<RenderItem*> m_RenderItemLayer[(int)RenderLayer::Count];
-
-		RenderItem* m_PickedRenderItem = nullptr;
+		std::vector<RenderItemHandle> m_RenderItemLayer[(int)RenderLayer::Count];
+		// Render items that passed frustum culling this frame, divided by PSO.
+		std::vector<RenderItemHandle> m_VisibleRenderItemLayer[(int)RenderLayer::Count];
+		// Instanced draws of the visible items, divided by PSO.
+		InstanceBatcher m_InstanceBatcher;
+		InstanceBatcher::Range m_VisibleBatches[(int)RenderLayer::Count];
+		// State bound by DrawRenderItems on the command list.
+		DrawStateCache m_DrawState;
+
+		RenderItemHandle m_PickedRenderItem;
+
+		// World matrices of all render items.  Shadows and reflections are children of
+		// their source with the projection as local transform.
+		TransformHierarchy m_Transforms;
+		std::vector<RenderItemHandle> m_TransformNodeItems;
+		// Local transform of the shadows, rebuilt when the main light turns.
+		XMFLOAT4X4 m_ShadowTransform = MathHelper::Identity4x4();
+
+		// Scene BVH over the world bounds of the pickable opaque items.  Rebuilt when the
+		// set of items changes and refit when one of them moves.
+		std::vector<RenderItemHandle> m_PickableRenderItems;
+		std::vector<XMFLOAT3> m_PickableBoundsMin;
+		std::vector<XMFLOAT3> m_PickableBoundsMax;
+		Bvh m_PickingBvh;
+		bool m_PickingBvhIsDirty = false;
 
 		bool m_FrustumCullingIsEnabled = true;
 		BoundingFrustum m_CameraFrustum;
+		FrustumCuller m_FrustumCuller;
+
+		// Index ranges of the visible meshlets of every item, by dense index.  Items that
+		// were not culled draw their whole index range.
+		struct VisibleMeshlets
+		{
+			bool IsCulled = false;
+			std::vector<IndexRange> Ranges;
+		};
+		std::vector<VisibleMeshlets> m_VisibleMeshlets;
+		std::atomic<UINT> m_MeshletsTested = 0;
+		std::atomic<UINT> m_MeshletsVisible = 0;
+
+		// Guards the dirty lists of the frame resources.
+		std::mutex m_DirtyMutex;
+
+		std::atomic<UINT64> m_InstanceBytesWritten = 0;
+		std::atomic<UINT64> m_MaterialBytesWritten = 0;
+		std::atomic<UINT64> m_PassCBBytesWritten = 0;
 
 		PassConstants m_MainPassConstantBuffer;
 		PassConstants m_ReflectedPassCB;
 
 		POINT m_LastMousePos = { 0, 0 };
 
-		u_int m_ObjConstantBufferIndex = 0;
-		u_int m_MatConstantBufferIndex = 0;
+		// Slots in the instance and material buffers.  The frame resources grow their
+		// buffers to the capacity of the allocators instead of being recreated.
+		SlotAllocator m_ObjectSlots;
+		SlotAllocator m_MaterialSlots;
+
+		// Geometry uploads on the copy queue.
+		std::unique_ptr<UploadService> m_UploadService;
+
+		// Added shapes stay out of the layers until their upload ticket is complete.
+		struct PendingShape
+		{
+			UINT64 UploadTicket = 0;
+			std::vector<std::pair<RenderLayer, RenderItemHandle>> Items;
+		};
+		std::vector<PendingShape> m_PendingShapes;
+
+		// Retired resources, released once the direct queue has passed their fence.
+		DeferredReleaseQueue m_DeferredReleases;
+
+		// Shapes erased in the editor, removed at the start of the next update.
+		std::vector<RenderItemHandle> m_ErasedRenderItems;
+
 		u_int m_AddedShapesCount = 0;
 	};
 }
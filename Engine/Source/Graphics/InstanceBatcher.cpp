@@ -0,0 +1,152 @@
+#include "Engine.h"
+#include "InstanceBatcher.h"
+
+using namespace DirectX;
+
+void InstanceBatcher::Clear()
+{
+	m_Batches.clear();
+	m_Instances.clear();
+}
+
+void InstanceBatcher::SetView(const XMFLOAT3& eyePosW, float farZ)
+{
+	m_EyePosW = eyePosW;
+	m_FarZ = farZ;
+}
+
+InstanceBatcher::Range InstanceBatcher::Add(const RenderItemStore& items, const std::vector<RenderItemHandle>& layer,
+	bool backToFront)
+{
+	Range range;
+	range.FirstBatch = (UINT)m_Batches.size();
+
+	m_Items.clear();
+	m_Keys.clear();
+	for (RenderItemHandle ri : layer)
+	{
+		if (items.Flags(ri).IsVisible == false)
+			continue;
+
+		const RenderItemDrawArgs& drawArgs = items.DrawArgs(ri);
+		// Materials without a texture have index -1, which becomes id 0.
+		UINT texture = (UINT)(items.Mat(ri)->DiffuseSrvHeapIndex + 1);
+
+		// Items of different runs are never merged, which costs draws but not correctness.
+		if (!m_GeometryIds.CanMap(drawArgs.GeometryId, GeometryBits) || !m_DrawIds.CanMap(drawArgs.DrawId, DrawBits) ||
+			!m_TextureIds.CanMap(texture, TextureBits))
+		{
+			FlushRun(items);
+		}
+
+		SortKey key;
+		key.Key = MakeSortKey(m_GeometryIds.Map(drawArgs.GeometryId), m_DrawIds.Map(drawArgs.DrawId),
+			m_TextureIds.Map(texture), DepthBucket(items.Transform(ri).World, backToFront));
+		key.Value = (UINT)m_Items.size();
+		m_Keys.push_back(key);
+		m_Items.push_back(ri);
+	}
+
+	FlushRun(items);
+
+	range.BatchCount = (UINT)m_Batches.size() - range.FirstBatch;
+	return range;
+}
+
+void InstanceBatcher::FlushRun(const RenderItemStore& items)
+{
+	RadixSort(m_Keys, m_SortScratch);
+
+	// Everything above the depth bucket has to match for two items to share a draw.
+	for (size_t i = 0; i < m_Keys.size(); ++i)
+	{
+		RenderItemHandle ri = m_Items[m_Keys[i].Value];
+
+		if (i == 0 || (m_Keys[i - 1].Key >> DepthBits) != (m_Keys[i].Key >> DepthBits))
+		{
+			InstanceBatch batch;
+			batch.Item = ri;
+			batch.FirstInstance = (UINT)m_Instances.size();
+			m_Batches.push_back(batch);
+		}
+
+		m_Instances.push_back(items.Transform(ri).ObjConstantBufferIndex);
+		m_Batches.back().InstanceCount++;
+	}
+
+	m_Items.clear();
+	m_Keys.clear();
+	m_GeometryIds.Reset();
+	m_DrawIds.Reset();
+	m_TextureIds.Reset();
+}
+
+const std::vector<InstanceBatch>& InstanceBatcher::Batches() const
+{
+	return m_Batches;
+}
+
+const std::vector<UINT>& InstanceBatcher::Instances() const
+{
+	return m_Instances;
+}
+
+UINT InstanceBatcher::ItemCount() const
+{
+	return (UINT)m_Instances.size();
+}
+
+UINT InstanceBatcher::BatchCount() const
+{
+	return (UINT)m_Batches.size();
+}
+
+UINT64 InstanceBatcher::MakeSortKey(UINT geometryId, UINT drawId, UINT texture, UINT depth)
+{
+	// Ids that do not fit would merge batches that cannot be drawn together.
+	assert(geometryId < (1u << GeometryBits) && drawId < (1u << DrawBits) &&
+		texture < (1u << TextureBits) && depth < (1u << DepthBits));
+
+	UINT64 key = geometryId;
+	key = (key << DrawBits) | drawId;
+	key = (key << TextureBits) | texture;
+	key = (key << DepthBits) | depth;
+	return key;
+}
+
+UINT InstanceBatcher::DepthBucket(const XMFLOAT4X4& world, bool backToFront) const
+{
+	XMVECTOR toItem = XMVectorSet(world._41, world._42, world._43, 0.0f) - XMLoadFloat3(&m_EyePosW);
+	float distance = std::min<float>(XMVectorGetX(XMVector3Length(toItem)) / m_FarZ, 1.0f);
+
+	const UINT maxBucket = (1u << DepthBits) - 1;
+	UINT bucket = (UINT)(distance * maxBucket);
+	return backToFront ? maxBucket - bucket : bucket;
+}
+
+bool InstanceBatcher::DenseIds::CanMap(UINT id, UINT bits) const
+{
+	bool seen = id < (UINT)m_DenseIds.size() && m_DenseIds[id] != 0;
+	return seen || m_SeenIds.size() < (size_t(1) << bits);
+}
+
+UINT InstanceBatcher::DenseIds::Map(UINT id)
+{
+	if (id >= (UINT)m_DenseIds.size())
+		m_DenseIds.resize((size_t)id + 1, 0);
+
+	if (m_DenseIds[id] == 0)
+	{
+		m_SeenIds.push_back(id);
+		m_DenseIds[id] = (UINT)m_SeenIds.size();
+	}
+	return m_DenseIds[id] - 1;
+}
+
+void InstanceBatcher::DenseIds::Reset()
+{
+	// Only the entries in use are cleared, the table keeps its size.
+	for (UINT id : m_SeenIds)
+		m_DenseIds[id] = 0;
+	m_SeenIds.clear();
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "RenderItemStore.h"
+#include "Common/RadixSort.h"
+
+#include <vector>
+
+// One instanced draw.  Item supplies the geometry, draw arguments and texture shared by
+// all instances of the batch.
+struct InstanceBatch
+{
+	RenderItemHandle Item;
+
+	// Range of the batch in InstanceBatcher::Instances().
+	UINT FirstInstance = 0;
+	UINT InstanceCount = 0;
+};
+
+// Groups the visible items of a layer into instanced draws.  Items of one layer are drawn
+// with the same PSO, so items sharing the geometry, the submesh, the topology and the
+// texture differ only in their instance data and become one batch.  Only reads the render
+// item store, no device is needed.
+//
+// Every item of a layer gets a 64-bit sort key
+//
+//   63..48 geometry | 47..32 draw | 31..20 texture | 19..0 depth
+//
+// and the keys are radix sorted, so batches that share buffers are drawn one after the
+// other and the instances of a batch are ordered by their distance to the eye.  The ids
+// in the key are renumbered densely for every layer.  Should a layer use more ids than
+// a field holds, its items are split into runs that are sorted and batched on their own.
+class ENGINE_API InstanceBatcher
+{
+public:
+	struct Range
+	{
+		UINT FirstBatch = 0;
+		UINT BatchCount = 0;
+	};
+
+	InstanceBatcher() = default;
+	InstanceBatcher(const InstanceBatcher& rhs) = delete;
+	InstanceBatcher& operator=(const InstanceBatcher& rhs) = delete;
+	~InstanceBatcher() = default;
+
+	void Clear();
+
+	// Eye position and the distance that maps to the last depth bucket.
+	void SetView(const DirectX::XMFLOAT3& eyePosW, float farZ);
+
+	// Appends the batches of one layer and returns where they are stored.  Hidden items
+	// are skipped.  Blended layers sort their instances back to front.
+	Range Add(const RenderItemStore& items, const std::vector<RenderItemHandle>& layer,
+		bool backToFront = false);
+
+	const std::vector<InstanceBatch>& Batches() const;
+	// ObjConstantBufferIndex of every instance, grouped by batch.
+	const std::vector<UINT>& Instances() const;
+
+	// Draws issued without batching, one per visible item, since the last Clear().
+	UINT ItemCount() const;
+	// Draws issued with batching since the last Clear().
+	UINT BatchCount() const;
+
+	static const UINT DepthBits = 20;
+	static const UINT TextureBits = 12;
+	static const UINT DrawBits = 16;
+	static const UINT GeometryBits = 16;
+
+	// Every id has to be below 1 << its field's bits.
+	static UINT64 MakeSortKey(UINT geometryId, UINT drawId, UINT texture, UINT depth);
+
+private:
+	// Numbers sparse ids densely in the order they are first seen.
+	class DenseIds
+	{
+	public:
+		// False when the id is new and all 1 << bits dense ids are taken.
+		bool CanMap(UINT id, UINT bits) const;
+		UINT Map(UINT id);
+		void Reset();
+
+	private:
+		// Dense id + 1 of every sparse id, 0 for ids not seen since Reset().
+		std::vector<UINT> m_DenseIds;
+		std::vector<UINT> m_SeenIds;
+	};
+
+	UINT DepthBucket(const DirectX::XMFLOAT4X4& world, bool backToFront) const;
+	// Sorts the keys collected so far into batches and starts a new run.
+	void FlushRun(const RenderItemStore& items);
+
+private:
+	std::vector<InstanceBatch> m_Batches;
+	std::vector<UINT> m_Instances;
+
+	DirectX::XMFLOAT3 m_EyePosW = { 0.0f, 0.0f, 0.0f };
+	float m_FarZ = 1000.0f;
+
+	// Scratch space of Add(), kept to avoid reallocating every frame.
+	std::vector<RenderItemHandle> m_Items;
+	std::vector<SortKey> m_Keys;
+	std::vector<SortKey> m_SortScratch;
+	DenseIds m_GeometryIds;
+	DenseIds m_DrawIds;
+	DenseIds m_TextureIds;
+};
@@ -0,0 +1,140 @@
+#include "Engine.h"
+#include "MappedFile.h"
+
+#ifndef _WIN32
+	#include <filesystem>
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::wstring& path)
+{
+	Close();
+
+	m_File = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize = {};
+	if (!GetFileSizeEx(m_File, &fileSize) || fileSize.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_Mapping = CreateFileMappingW(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_Data = static_cast<const std::uint8_t*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	if (m_Data == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_Size = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data != nullptr)
+	{
+		UnmapViewOfFile(m_Data);
+		m_Data = nullptr;
+	}
+
+	if (m_Mapping != nullptr)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	m_Size = 0;
+}
+
+#else
+
+bool MappedFile::Open(const std::wstring& path)
+{
+	Close();
+
+	m_File = open(std::filesystem::path(path).c_str(), O_RDONLY);
+	if (m_File == -1)
+		return false;
+
+	struct stat fileStat = {};
+	if (fstat(m_File, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+
+	void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, m_File, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+
+	// Same access pattern as FILE_FLAG_SEQUENTIAL_SCAN.
+	madvise(data, (size_t)fileStat.st_size, MADV_SEQUENTIAL);
+
+	m_Data = static_cast<const std::uint8_t*>(data);
+	m_Size = (size_t)fileStat.st_size;
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (m_Data != nullptr)
+	{
+		munmap(const_cast<std::uint8_t*>(m_Data), m_Size);
+		m_Data = nullptr;
+	}
+
+	if (m_File != -1)
+	{
+		close(m_File);
+		m_File = -1;
+	}
+
+	m_Size = 0;
+}
+
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return m_Data != nullptr;
+}
+
+const std::uint8_t* MappedFile::Data() const
+{
+	return m_Data;
+}
+
+size_t MappedFile::Size() const
+{
+	return m_Size;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file.  Uses file mappings on Windows and mmap on
+// POSIX systems, so code that only reads files can run on both.
+class ENGINE_API MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	// Returns false if the file does not exist or cannot be mapped.  Empty files cannot
+	// be mapped and are reported as a failure as well.
+	bool Open(const std::wstring& path);
+	void Close();
+
+	bool IsOpen() const;
+	const std::uint8_t* Data() const;
+	size_t Size() const;
+
+private:
+#ifdef _WIN32
+	HANDLE m_File = INVALID_HANDLE_VALUE;
+	HANDLE m_Mapping = nullptr;
+#else
+	int m_File = -1;
+#endif
+	const std::uint8_t* m_Data = nullptr;
+	size_t m_Size = 0;
+};
@@ -105,7 +105,6 @@ DirectX::XMFLOAT4X4 MathHelper::Identity4x4()
 XMVECTOR MathHelper::RandUnitVec3()
 {
 	XMVECTOR One = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
-	XMVECTOR Zero = XMVectorZero();
 
 	// Keep trying until we get a point on/in the hemisphere.
 	while (true)
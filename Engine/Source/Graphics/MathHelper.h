@@ -1,6 +1,8 @@
 #pragma once
 
-#include <Windows.h>
+#ifdef WIN32
+	#include <Windows.h>
+#endif // WIN32
 #include <DirectXMath.h>
 #include <cstdint>
 
@@ -0,0 +1,300 @@
+#include "Engine.h"
+#include "MeshFile.h"
+#include "ModelLoader.h"
+#include "Vertex.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+	#include <cstdio>
+	#include <filesystem>
+#endif
+
+using namespace DirectX;
+
+static_assert(sizeof(MeshFileHeader) % 16 == 0, "The vertex block should stay 16 byte aligned.");
+
+MeshFile::~MeshFile()
+{
+	Close();
+}
+
+bool MeshFile::Open(const std::wstring& path)
+{
+	Close();
+
+	if (!m_File.Open(path) || m_File.Size() < sizeof(MeshFileHeader))
+	{
+		Close();
+		return false;
+	}
+
+	m_Data = m_File.Data();
+	m_ByteSize = m_File.Size();
+
+	if (!Validate(m_ByteSize))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+bool MeshFile::ParseText(const std::wstring& path, MeshOptimizer::Result* stats)
+{
+	Close();
+
+	ModelLoader loader;
+	if (!loader.Open(path))
+		return false;
+
+	MeshFileHeader header;
+	header.Magic = FileMagic;
+	header.Version = FileVersion;
+	GetSourceStamp(path, header.SourceSize, header.SourceWriteTime);
+
+	header.VertexCount = loader.VertexCount();
+	header.VertexByteStride = sizeof(Vertex);
+	// Every index is below the vertex count, so 16 bits are enough for small meshes.
+	header.IndexByteSize = header.VertexCount <= 0x10000 ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+
+	// Vertices are parsed straight into the image, indices as 32 bits for the optimizer
+	// and narrowed once the levels of detail are known.
+	size_t vertexBytes = (size_t)header.VertexCount * header.VertexByteStride;
+	m_Image.resize(sizeof(MeshFileHeader) + vertexBytes);
+
+	BYTE* vertices = m_Image.data() + sizeof(MeshFileHeader);
+	std::vector<std::uint32_t> indices32(3 * (size_t)loader.TriangleCount());
+	if (!loader.ParseVertices(reinterpret_cast<Vertex*>(vertices)) ||
+		!loader.ParseIndices(indices32.data(), sizeof(std::uint32_t)))
+	{
+		m_Image.clear();
+		return false;
+	}
+
+	header.Bounds = BoundsBuilder::Build(vertices, header.VertexByteStride, header.VertexCount);
+
+	MeshOptimizer::Result result = MeshOptimizer::Optimize(vertices, header.VertexByteStride, header.VertexCount,
+		indices32.data(), indices32.size());
+	if (stats != nullptr)
+		*stats = result;
+
+	std::vector<std::uint32_t> lodIndices;
+	std::vector<MeshLod> lods = MeshSimplifier::BuildLodChain(vertices, header.VertexByteStride, header.VertexCount,
+		indices32.data(), indices32.size(), { { offsetof(Vertex, Normal), 3, LodNormalWeight } }, lodIndices);
+	header.LodCount = (std::uint32_t)lods.size();
+	std::copy(lods.begin(), lods.end(), header.Lods);
+	indices32 = std::move(lodIndices);
+	header.IndexCount = (std::uint32_t)indices32.size();
+
+	// Reorders the triangles of level 0 into the meshlets.
+	std::vector<Meshlet> meshlets = MeshletBuilder::Build(vertices, header.VertexByteStride, header.VertexCount,
+		indices32.data(), lods[0].IndexCount);
+	header.MeshletCount = (std::uint32_t)meshlets.size();
+
+	size_t indexBytes = (size_t)header.IndexCount * header.IndexByteSize;
+	size_t meshletOffset = (sizeof(MeshFileHeader) + vertexBytes + indexBytes + 3) & ~(size_t)3;
+	m_Image.resize(meshletOffset + meshlets.size() * sizeof(Meshlet));
+	vertices = m_Image.data() + sizeof(MeshFileHeader);
+	BYTE* indices = vertices + vertexBytes;
+	std::memcpy(m_Image.data() + meshletOffset, meshlets.data(), meshlets.size() * sizeof(Meshlet));
+
+	if (header.IndexByteSize == sizeof(std::uint16_t))
+	{
+		std::uint16_t* indices16 = reinterpret_cast<std::uint16_t*>(indices);
+		for (size_t i = 0; i < indices32.size(); ++i)
+			indices16[i] = (std::uint16_t)indices32[i];
+	}
+	else
+	{
+		std::memcpy(indices, indices32.data(), indexBytes);
+	}
+
+	std::memcpy(m_Image.data(), &header, sizeof(MeshFileHeader));
+
+	m_Data = m_Image.data();
+	m_ByteSize = m_Image.size();
+
+	return true;
+}
+
+#ifdef _WIN32
+
+bool MeshFile::Save(const std::wstring& path) const
+{
+	if (m_Data == nullptr)
+		return false;
+
+	std::wstring tempPath = path + L".tmp";
+
+	HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	BOOL result = WriteFile(file, m_Data, (DWORD)m_ByteSize, &written, nullptr);
+	CloseHandle(file);
+
+	if (!result || written != m_ByteSize)
+	{
+		DeleteFileW(tempPath.c_str());
+		return false;
+	}
+
+	return MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+}
+
+#else
+
+bool MeshFile::Save(const std::wstring& path) const
+{
+	if (m_Data == nullptr)
+		return false;
+
+	std::filesystem::path tempPath = std::filesystem::path(path + L".tmp");
+
+	FILE* file = std::fopen(tempPath.c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+	bool result = std::fwrite(m_Data, 1, m_ByteSize, file) == m_ByteSize;
+	result = std::fclose(file) == 0 && result;
+
+	if (!result)
+	{
+		std::remove(tempPath.c_str());
+		return false;
+	}
+
+	// rename replaces an existing file atomically, like MOVEFILE_REPLACE_EXISTING.
+	return std::rename(tempPath.c_str(), std::filesystem::path(path).c_str()) == 0;
+}
+
+#endif
+
+void MeshFile::Close()
+{
+	m_File.Close();
+	m_Image.clear();
+	m_Data = nullptr;
+	m_ByteSize = 0;
+}
+
+bool MeshFile::IsUpToDate(const std::wstring& sourcePath) const
+{
+	std::uint64_t size = 0;
+	std::uint64_t writeTime = 0;
+	if (m_Data == nullptr || !GetSourceStamp(sourcePath, size, writeTime))
+		return false;
+
+	return Header().SourceSize == size && Header().SourceWriteTime == writeTime;
+}
+
+const MeshFileHeader& MeshFile::Header() const
+{
+	return *reinterpret_cast<const MeshFileHeader*>(m_Data);
+}
+
+const void* MeshFile::Vertices() const
+{
+	return m_Data + sizeof(MeshFileHeader);
+}
+
+const void* MeshFile::Indices() const
+{
+	return m_Data + sizeof(MeshFileHeader) + VertexBufferByteSize();
+}
+
+const Meshlet* MeshFile::Meshlets() const
+{
+	return reinterpret_cast<const Meshlet*>(m_Data + MeshletOffset());
+}
+
+UINT MeshFile::VertexBufferByteSize() const
+{
+	return Header().VertexCount * Header().VertexByteStride;
+}
+
+UINT MeshFile::IndexBufferByteSize() const
+{
+	return Header().IndexCount * Header().IndexByteSize;
+}
+
+#ifdef _WIN32
+
+bool MeshFile::GetSourceStamp(const std::wstring& path, std::uint64_t& size, std::uint64_t& writeTime)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data = {};
+	if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+		return false;
+
+	size = ((std::uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	writeTime = ((std::uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+#else
+
+bool MeshFile::GetSourceStamp(const std::wstring& path, std::uint64_t& size, std::uint64_t& writeTime)
+{
+	// std::filesystem keeps the sub-second part of the write time, which stat only
+	// exposes under platform specific names.
+	std::error_code error;
+	std::uintmax_t fileSize = std::filesystem::file_size(path, error);
+	if (error)
+		return false;
+	std::filesystem::file_time_type fileTime = std::filesystem::last_write_time(path, error);
+	if (error)
+		return false;
+
+	size = (std::uint64_t)fileSize;
+	writeTime = (std::uint64_t)fileTime.time_since_epoch().count();
+	return true;
+}
+
+#endif
+
+size_t MeshFile::MeshletOffset() const
+{
+	size_t end = sizeof(MeshFileHeader) + VertexBufferByteSize() + IndexBufferByteSize();
+	return (end + 3) & ~(size_t)3;
+}
+
+bool MeshFile::Validate(size_t byteSize) const
+{
+	const MeshFileHeader& header = Header();
+
+	if (header.Magic != FileMagic || header.Version != FileVersion)
+		return false;
+	if (header.VertexByteStride != sizeof(Vertex))
+		return false;
+	if (header.IndexByteSize != sizeof(std::uint16_t) && header.IndexByteSize != sizeof(std::uint32_t))
+		return false;
+	if (header.LodCount == 0 || header.LodCount > MeshSimplifier::MaxLodCount)
+		return false;
+	for (std::uint32_t i = 0; i < header.LodCount; ++i)
+	{
+		if ((std::uint64_t)header.Lods[i].FirstIndex + header.Lods[i].IndexCount > header.IndexCount)
+			return false;
+	}
+
+	std::uint64_t expected = sizeof(MeshFileHeader) +
+		(std::uint64_t)header.VertexCount * header.VertexByteStride +
+		(std::uint64_t)header.IndexCount * header.IndexByteSize;
+	expected = (expected + 3) & ~(std::uint64_t)3;
+	expected += (std::uint64_t)header.MeshletCount * sizeof(Meshlet);
+	if (expected != byteSize)
+		return false;
+
+	const Meshlet* meshlets = Meshlets();
+	for (std::uint32_t i = 0; i < header.MeshletCount; ++i)
+	{
+		if ((std::uint64_t)meshlets[i].FirstIndex + meshlets[i].IndexCount > header.Lods[0].IndexCount)
+			return false;
+	}
+
+	return true;
+}
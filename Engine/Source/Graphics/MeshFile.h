@@ -0,0 +1,101 @@
+#pragma once
+
+#include "BoundingVolumes.h"
+#include "MappedFile.h"
+#include "Common/MeshOptimizer.h"
+#include "Common/MeshSimplifier.h"
+#include "Common/Meshlets.h"
+
+#include <DirectXCollision.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Header of a binary mesh file.  It is followed by the vertex block (VertexCount vertices
+// of VertexByteStride bytes, in the layout of Vertex) and the index block (IndexCount
+// indices of IndexByteSize bytes, 16-bit whenever the vertex count allows it).  The index
+// block holds the levels of detail one after the other, level 0 is the full mesh.  The
+// meshlets of level 0 follow at the next 4 byte boundary.
+struct MeshFileHeader
+{
+	std::uint32_t Magic = 0;
+	std::uint32_t Version = 0;
+
+	// Size and last write time of the text model the file was converted from, used to
+	// detect a stale cache.
+	std::uint64_t SourceSize = 0;
+	std::uint64_t SourceWriteTime = 0;
+
+	std::uint32_t VertexCount = 0;
+	std::uint32_t VertexByteStride = 0;
+	std::uint32_t IndexCount = 0;
+	std::uint32_t IndexByteSize = 0;
+
+	BoundingVolumes Bounds;
+
+	std::uint32_t LodCount = 0;
+	std::uint32_t MeshletCount = 0;
+	MeshLod Lods[MeshSimplifier::MaxLodCount];
+
+	// Keeps the vertex block 16 byte aligned.
+	std::uint32_t Padding[1] = {};
+};
+
+// Binary mesh cache for the text models in Content/Models.  A cached file is memory mapped
+// and its vertex and index blocks are handed to the GPU upload as they are, so loading
+// does no parsing and no intermediate copies.
+class ENGINE_API MeshFile
+{
+public:
+	static const std::uint32_t FileMagic = 0x4853454D; // "MESH"
+	// Bump whenever the header, the Vertex layout or the mesh processing changes.
+	static const std::uint32_t FileVersion = 6;
+
+	MeshFile() = default;
+	MeshFile(const MeshFile& rhs) = delete;
+	MeshFile& operator=(const MeshFile& rhs) = delete;
+	~MeshFile();
+
+	// Maps a binary mesh file.  Returns false if the file is missing, truncated or was
+	// written by another version.
+	bool Open(const std::wstring& path);
+
+	// Parses a text model with ModelLoader into an in-memory image with the same layout
+	// as a mapped file.  The mesh is reordered with MeshOptimizer, stats receives its
+	// vertex cache stats before and after, and its levels of detail are built with
+	// MeshSimplifier.
+	bool ParseText(const std::wstring& path, MeshOptimizer::Result* stats = nullptr);
+
+	// Writes the current image to disk.  The file is replaced atomically so a crash never
+	// leaves a half written cache behind.
+	bool Save(const std::wstring& path) const;
+
+	void Close();
+
+	// True if the image was converted from the text model at path in its current state.
+	bool IsUpToDate(const std::wstring& sourcePath) const;
+
+	const MeshFileHeader& Header() const;
+	const void* Vertices() const;
+	const void* Indices() const;
+	const Meshlet* Meshlets() const;
+	UINT VertexBufferByteSize() const;
+	UINT IndexBufferByteSize() const;
+
+private:
+	// Cost of a unit normal difference in the simplifier, relative to a position error of
+	// the model extent.
+	static constexpr float LodNormalWeight = 0.5f;
+
+	static bool GetSourceStamp(const std::wstring& path, std::uint64_t& size, std::uint64_t& writeTime);
+	size_t MeshletOffset() const;
+	bool Validate(size_t byteSize) const;
+
+private:
+	// Either m_File.Data() or m_Image.data().
+	const BYTE* m_Data = nullptr;
+	size_t m_ByteSize = 0;
+
+	MappedFile m_File;
+	std::vector<BYTE> m_Image;
+};
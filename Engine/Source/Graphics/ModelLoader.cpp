@@ -0,0 +1,233 @@
+#include "Engine.h"
+#include "ModelLoader.h"
+#include "Vertex.h"
+
+#include <charconv>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	const char* SkipSpace(const char* p, const char* end)
+	{
+		while (p < end && IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	const char* SkipToken(const char* p, const char* end)
+	{
+		while (p < end && !IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	// Reads "<label> <count>" and checks the label.
+	bool ReadCount(const char*& p, const char* end, const char* label, UINT& count)
+	{
+		p = SkipSpace(p, end);
+		const char* labelEnd = SkipToken(p, end);
+		if ((size_t)(labelEnd - p) != std::strlen(label) || std::memcmp(p, label, labelEnd - p) != 0)
+			return false;
+
+		p = SkipSpace(labelEnd, end);
+		auto result = std::from_chars(p, end, count);
+		if (result.ec != std::errc())
+			return false;
+
+		p = result.ptr;
+		return true;
+	}
+
+	// Finds the contents of the next "{ ... }" block.
+	bool FindBlock(const char*& p, const char* end, const char*& blockBegin, const char*& blockEnd)
+	{
+		const char* open = static_cast<const char*>(std::memchr(p, '{', end - p));
+		if (open == nullptr)
+			return false;
+
+		const char* close = static_cast<const char*>(std::memchr(open + 1, '}', end - open - 1));
+		if (close == nullptr)
+			return false;
+
+		blockBegin = open + 1;
+		blockEnd = close;
+		p = close + 1;
+		return true;
+	}
+
+	UINT CountNumbers(const char* p, const char* end)
+	{
+		UINT count = 0;
+		for (;;)
+		{
+			p = SkipSpace(p, end);
+			if (p == end)
+				return count;
+			p = SkipToken(p, end);
+			++count;
+		}
+	}
+}
+
+template<typename ParseChunk>
+bool ModelLoader::ParseSection(const Section& section, UINT numberCount, ParseChunk&& parseChunk)
+{
+	size_t byteSize = section.End - section.Begin;
+
+	JobSystem* jobSystem = JobSystem::Instance();
+	UINT taskCount = jobSystem != nullptr ?
+		(UINT)std::min<size_t>(jobSystem->ThreadCount(), std::max<size_t>(1, byteSize / MinBytesPerTask)) : 1;
+
+	if (taskCount == 1)
+	{
+		return CountNumbers(section.Begin, section.End) == numberCount &&
+			parseChunk(section.Begin, section.End, 0);
+	}
+
+	// Chunk boundaries are moved forward to the next whitespace so no number is split.
+	std::vector<const char*> bounds(taskCount + 1);
+	bounds[0] = section.Begin;
+	bounds[taskCount] = section.End;
+	for (UINT t = 1; t < taskCount; ++t)
+		bounds[t] = SkipToken(std::max<const char*>(bounds[t - 1], section.Begin + byteSize * t / taskCount), section.End);
+
+	// First pass: count the numbers of each chunk to get its output offset.
+	std::vector<UINT> firstNumbers(taskCount + 1, 0);
+	jobSystem->ParallelFor(taskCount, 1, [&bounds, &firstNumbers](UINT begin, UINT end)
+		{
+			for (UINT t = begin; t < end; ++t)
+				firstNumbers[t + 1] = CountNumbers(bounds[t], bounds[t + 1]);
+		});
+
+	for (UINT t = 1; t <= taskCount; ++t)
+		firstNumbers[t] += firstNumbers[t - 1];
+
+	if (firstNumbers[taskCount] != numberCount)
+		return false;
+
+	// Second pass: parse the chunks into their own output ranges.
+	std::vector<char> succeeded(taskCount, 0);
+	jobSystem->ParallelFor(taskCount, 1, [&](UINT begin, UINT end)
+		{
+			for (UINT t = begin; t < end; ++t)
+				succeeded[t] = parseChunk(bounds[t], bounds[t + 1], firstNumbers[t]);
+		});
+
+	return std::all_of(succeeded.begin(), succeeded.end(), [](char s) { return s != 0; });
+}
+
+bool ModelLoader::Open(const std::wstring& path)
+{
+	Close();
+
+	if (!m_File.Open(path))
+		return false;
+
+	const char* p = reinterpret_cast<const char*>(m_File.Data());
+	const char* end = p + m_File.Size();
+
+	if (!ReadCount(p, end, "VertexCount:", m_VertexCount) ||
+		!ReadCount(p, end, "TriangleCount:", m_TriangleCount) ||
+		!FindBlock(p, end, m_VertexList.Begin, m_VertexList.End) ||
+		!FindBlock(p, end, m_TriangleList.Begin, m_TriangleList.End))
+	{
+		Close();
+		return false;
+	}
+
+	return true;
+}
+
+void ModelLoader::Close()
+{
+	m_File.Close();
+	m_VertexCount = 0;
+	m_TriangleCount = 0;
+	m_VertexList = Section();
+	m_TriangleList = Section();
+}
+
+UINT ModelLoader::VertexCount() const
+{
+	return m_VertexCount;
+}
+
+UINT ModelLoader::TriangleCount() const
+{
+	return m_TriangleCount;
+}
+
+bool ModelLoader::ParseVertices(Vertex* vertices) const
+{
+	// Position and normal are the first six floats of a vertex.
+	static_assert(offsetof(Vertex, Pos) == 0 && offsetof(Vertex, Normal) == 3 * sizeof(float),
+		"ParseVertices expects the position and normal at the start of Vertex.");
+	constexpr UINT FloatsPerVertex = 6;
+
+	bool result = ParseSection(m_VertexList, m_VertexCount * FloatsPerVertex,
+		[vertices](const char* p, const char* end, UINT firstNumber)
+		{
+			UINT v = firstNumber / FloatsPerVertex;
+			UINT component = firstNumber % FloatsPerVertex;
+
+			for (;;)
+			{
+				p = SkipSpace(p, end);
+				if (p == end)
+					return true;
+
+				float value = 0.0f;
+				auto parsed = std::from_chars(p, end, value);
+				if (parsed.ec != std::errc() || (parsed.ptr != end && !IsSpace(*parsed.ptr)))
+					return false;
+				p = parsed.ptr;
+
+				reinterpret_cast<float*>(&vertices[v])[component] = value;
+				if (++component == FloatsPerVertex)
+				{
+					vertices[v].TexC = { 0.0f, 0.0f };
+					component = 0;
+					++v;
+				}
+			}
+		});
+
+	return result;
+}
+
+bool ModelLoader::ParseIndices(void* indices, UINT indexByteSize) const
+{
+	UINT vertexCount = m_VertexCount;
+
+	return ParseSection(m_TriangleList, 3 * m_TriangleCount,
+		[indices, indexByteSize, vertexCount](const char* p, const char* end, UINT firstNumber)
+		{
+			UINT i = firstNumber;
+
+			for (;;)
+			{
+				p = SkipSpace(p, end);
+				if (p == end)
+					return true;
+
+				std::uint32_t index = 0;
+				auto parsed = std::from_chars(p, end, index);
+				if (parsed.ec != std::errc() || (parsed.ptr != end && !IsSpace(*parsed.ptr)) || index >= vertexCount)
+					return false;
+				p = parsed.ptr;
+
+				if (indexByteSize == sizeof(std::uint16_t))
+					static_cast<std::uint16_t*>(indices)[i] = (std::uint16_t)index;
+				else
+					static_cast<std::uint32_t*>(indices)[i] = index;
+				++i;
+			}
+		});
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <DirectXCollision.h>
+
+struct Vertex;
+
+// Parser for the text models in Content/Models:
+//
+//   VertexCount: N
+//   TriangleCount: M
+//   VertexList (pos, normal)
+//   { px py pz nx ny nz ... }
+//   TriangleList
+//   { i0 i1 i2 ... }
+//
+// The file is memory mapped and scanned with std::from_chars.  Each list is split into
+// chunks at whitespace, the chunks first count their numbers to find where their output
+// starts and are then parsed as jobs straight into the caller's memory.
+class ENGINE_API ModelLoader
+{
+public:
+	ModelLoader() = default;
+	ModelLoader(const ModelLoader& rhs) = delete;
+	ModelLoader& operator=(const ModelLoader& rhs) = delete;
+	~ModelLoader() = default;
+
+	// Maps the file and reads the counts.  Returns false if the file is missing or the
+	// layout does not match the format above.
+	bool Open(const std::wstring& path);
+	void Close();
+
+	UINT VertexCount() const;
+	UINT TriangleCount() const;
+
+	// Parses VertexCount() vertices.  Texture coordinates are set to zero.
+	bool ParseVertices(Vertex* vertices) const;
+
+	// Parses 3 * TriangleCount() indices of indexByteSize (2 or 4) bytes each.  Fails on
+	// indices outside the vertex list.
+	bool ParseIndices(void* indices, UINT indexByteSize) const;
+
+private:
+	struct Section
+	{
+		const char* Begin = nullptr;
+		const char* End = nullptr;
+	};
+
+	// Calls parseChunk(begin, end, firstNumber) for chunks of the section, firstNumber
+	// being the index of the first number of the chunk within the section.  Fails if the
+	// section does not hold exactly numberCount numbers or any chunk fails.
+	template<typename ParseChunk>
+	static bool ParseSection(const Section& section, UINT numberCount, ParseChunk&& parseChunk);
+
+private:
+	// Below this many bytes per chunk it is cheaper to parse on the calling thread.
+	static const size_t MinBytesPerTask = 64 * 1024;
+
+	MappedFile m_File;
+
+	UINT m_VertexCount = 0;
+	UINT m_TriangleCount = 0;
+
+	Section m_VertexList;
+	Section m_TriangleList;
+};
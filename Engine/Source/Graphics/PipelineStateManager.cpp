@@ -0,0 +1,195 @@
+#include "Engine.h"
+#include "PipelineStateManager.h"
+#include "Common/JobSystem.h"
+
+namespace
+{
+	template<typename T>
+	void Append(std::vector<std::uint8_t>& bytes, const T& value)
+	{
+		const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(&value);
+		bytes.insert(bytes.end(), p, p + sizeof(T));
+	}
+
+	void AppendBytecode(std::vector<std::uint8_t>& bytes, ID3DBlob* bytecode)
+	{
+		std::uint64_t hash = bytecode != nullptr ?
+			BlobCache::HashBytes(bytecode->GetBufferPointer(), bytecode->GetBufferSize()) : 0;
+		Append(bytes, hash);
+	}
+
+	void AppendInputLayout(std::vector<std::uint8_t>& bytes, const std::vector<D3D12_INPUT_ELEMENT_DESC>& inputLayout)
+	{
+		for (const D3D12_INPUT_ELEMENT_DESC& element : inputLayout)
+		{
+			const char* name = element.SemanticName;
+			bytes.insert(bytes.end(), name, name + strlen(name) + 1);
+			Append(bytes, element.SemanticIndex);
+			Append(bytes, element.Format);
+			Append(bytes, element.InputSlot);
+			Append(bytes, element.AlignedByteOffset);
+			Append(bytes, element.InputSlotClass);
+			Append(bytes, element.InstanceDataStepRate);
+		}
+	}
+
+	void AppendStencilOp(std::vector<std::uint8_t>& bytes, const D3D12_DEPTH_STENCILOP_DESC& op)
+	{
+		Append(bytes, op.StencilFailOp);
+		Append(bytes, op.StencilDepthFailOp);
+		Append(bytes, op.StencilPassOp);
+		Append(bytes, op.StencilFunc);
+	}
+
+	D3D12_SHADER_BYTECODE ShaderBytecode(ID3DBlob* bytecode)
+	{
+		if (bytecode == nullptr)
+			return { nullptr, 0 };
+		return { bytecode->GetBufferPointer(), bytecode->GetBufferSize() };
+	}
+}
+
+PipelineStateManager::PipelineStateManager(ID3D12Device* device, ID3D12RootSignature* rootSignature,
+	const std::vector<D3D12_INPUT_ELEMENT_DESC>& inputLayout) :
+	m_Device(device),
+	m_RootSignature(rootSignature),
+	m_InputLayout(inputLayout)
+{
+	AppendInputLayout(m_InputLayoutBytes, m_InputLayout);
+}
+
+void PipelineStateManager::Add(const std::string& name, const GraphicsPipelineDesc& desc)
+{
+	std::vector<std::uint8_t> bytes = Serialize(desc);
+	PipelineCache::PipelineId id = m_Cache.Add(bytes.data(), bytes.size());
+	if (id == m_Descs.size())
+		m_Descs.push_back(desc);
+
+	m_Names[name] = id;
+}
+
+void PipelineStateManager::CreatePending(JobSystem* jobSystem)
+{
+	// Every job writes only the pipeline state of its id.
+	m_PipelineStates.resize(m_Descs.size());
+	m_Cache.CreatePending([this](PipelineCache::PipelineId id, const PipelineCache::Blob* cachedBlob)
+	{
+		return Create(id, cachedBlob);
+	}, jobSystem);
+}
+
+ID3D12PipelineState* PipelineStateManager::Get(const std::string& name) const
+{
+	auto it = m_Names.find(name);
+	if (it == m_Names.end() || it->second >= m_PipelineStates.size())
+		return nullptr;
+	return m_PipelineStates[it->second].Get();
+}
+
+bool PipelineStateManager::Load(const std::wstring& path)
+{
+	return m_Cache.Load(path);
+}
+
+bool PipelineStateManager::Save(const std::wstring& path) const
+{
+	return m_Cache.Save(path);
+}
+
+const PipelineCache& PipelineStateManager::Cache() const
+{
+	return m_Cache;
+}
+
+std::vector<std::uint8_t> PipelineStateManager::Serialize(const GraphicsPipelineDesc& desc) const
+{
+	std::vector<std::uint8_t> bytes;
+	if (desc.InputLayout.empty())
+		bytes = m_InputLayoutBytes;
+	else
+		AppendInputLayout(bytes, desc.InputLayout);
+
+	AppendBytecode(bytes, desc.VS.Get());
+	AppendBytecode(bytes, desc.PS.Get());
+
+	// Only 4 byte fields, so there is no padding.
+	Append(bytes, desc.RasterizerState);
+
+	const D3D12_BLEND_DESC& blend = desc.BlendState;
+	Append(bytes, blend.AlphaToCoverageEnable);
+	Append(bytes, blend.IndependentBlendEnable);
+	for (const D3D12_RENDER_TARGET_BLEND_DESC& rt : blend.RenderTarget)
+	{
+		Append(bytes, rt.BlendEnable);
+		Append(bytes, rt.LogicOpEnable);
+		Append(bytes, rt.SrcBlend);
+		Append(bytes, rt.DestBlend);
+		Append(bytes, rt.BlendOp);
+		Append(bytes, rt.SrcBlendAlpha);
+		Append(bytes, rt.DestBlendAlpha);
+		Append(bytes, rt.BlendOpAlpha);
+		Append(bytes, rt.LogicOp);
+		Append(bytes, rt.RenderTargetWriteMask);
+	}
+
+	const D3D12_DEPTH_STENCIL_DESC& depthStencil = desc.DepthStencilState;
+	Append(bytes, depthStencil.DepthEnable);
+	Append(bytes, depthStencil.DepthWriteMask);
+	Append(bytes, depthStencil.DepthFunc);
+	Append(bytes, depthStencil.StencilEnable);
+	Append(bytes, depthStencil.StencilReadMask);
+	Append(bytes, depthStencil.StencilWriteMask);
+	AppendStencilOp(bytes, depthStencil.FrontFace);
+	AppendStencilOp(bytes, depthStencil.BackFace);
+
+	Append(bytes, desc.SampleMask);
+	Append(bytes, desc.PrimitiveTopologyType);
+	Append(bytes, desc.RTVFormat);
+	Append(bytes, desc.DSVFormat);
+	Append(bytes, desc.SampleDesc.Count);
+	Append(bytes, desc.SampleDesc.Quality);
+
+	return bytes;
+}
+
+PipelineCache::Blob PipelineStateManager::Create(PipelineCache::PipelineId id, const PipelineCache::Blob* cachedBlob)
+{
+	const GraphicsPipelineDesc& desc = m_Descs[id];
+
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+	const std::vector<D3D12_INPUT_ELEMENT_DESC>& inputLayout = desc.InputLayout.empty() ? m_InputLayout : desc.InputLayout;
+	psoDesc.InputLayout = { inputLayout.data(), (UINT)inputLayout.size() };
+	psoDesc.pRootSignature = m_RootSignature.Get();
+	psoDesc.VS = ShaderBytecode(desc.VS.Get());
+	psoDesc.PS = ShaderBytecode(desc.PS.Get());
+	psoDesc.RasterizerState = desc.RasterizerState;
+	psoDesc.BlendState = desc.BlendState;
+	psoDesc.DepthStencilState = desc.DepthStencilState;
+	psoDesc.SampleMask = desc.SampleMask;
+	psoDesc.PrimitiveTopologyType = desc.PrimitiveTopologyType;
+	psoDesc.NumRenderTargets = 1;
+	psoDesc.RTVFormats[0] = desc.RTVFormat;
+	psoDesc.DSVFormat = desc.DSVFormat;
+	psoDesc.SampleDesc = desc.SampleDesc;
+
+	Microsoft::WRL::ComPtr<ID3D12PipelineState> pipelineState;
+	HRESULT hr = E_FAIL;
+	if (cachedBlob != nullptr)
+	{
+		// A new driver or adapter rejects the blob, then the pipeline is compiled again.
+		psoDesc.CachedPSO = { cachedBlob->data(), cachedBlob->size() };
+		hr = m_Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState));
+		psoDesc.CachedPSO = { nullptr, 0 };
+	}
+	if (FAILED(hr))
+		ThrowIfFailed(m_Device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
+
+	m_PipelineStates[id] = pipelineState;
+
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+	if (FAILED(pipelineState->GetCachedBlob(&blob)))
+		return {};
+
+	const std::uint8_t* bytes = (const std::uint8_t*)blob->GetBufferPointer();
+	return PipelineCache::Blob(bytes, bytes + blob->GetBufferSize());
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "D3DUtils.h"
+#include "Common/PipelineCache.h"
+
+class JobSystem;
+
+// Value type describing a graphics pipeline.  Two descriptions with the same state and the
+// same shader bytecode describe the same pipeline.  The root signature is shared by every
+// pipeline of a manager, and so is the input layout unless the description has its own.
+struct GraphicsPipelineDesc
+{
+	Microsoft::WRL::ComPtr<ID3DBlob> VS;
+	Microsoft::WRL::ComPtr<ID3DBlob> PS;
+	// Empty for the input layout of the manager.  Semantic names must outlive the manager.
+	std::vector<D3D12_INPUT_ELEMENT_DESC> InputLayout;
+	D3D12_RASTERIZER_DESC RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+	D3D12_BLEND_DESC BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+	D3D12_DEPTH_STENCIL_DESC DepthStencilState = CD3DX12_DEPTH_STENCIL_DESC(D3D12_DEFAULT);
+	UINT SampleMask = UINT_MAX;
+	D3D12_PRIMITIVE_TOPOLOGY_TYPE PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+	DXGI_FORMAT RTVFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+	DXGI_FORMAT DSVFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+	DXGI_SAMPLE_DESC SampleDesc = { 1, 0 };
+};
+
+// Creates named pipeline states from descriptions.  Identical descriptions are created once,
+// all pending ones are created in parallel, and the compiled pipelines are kept in a
+// PipelineCache file between runs.
+class ENGINE_API PipelineStateManager
+{
+public:
+	PipelineStateManager(ID3D12Device* device, ID3D12RootSignature* rootSignature,
+		const std::vector<D3D12_INPUT_ELEMENT_DESC>& inputLayout);
+	PipelineStateManager(const PipelineStateManager& rhs) = delete;
+	PipelineStateManager& operator=(const PipelineStateManager& rhs) = delete;
+	~PipelineStateManager() = default;
+
+	// The pipeline is created by the next CreatePending().
+	void Add(const std::string& name, const GraphicsPipelineDesc& desc);
+	void CreatePending(JobSystem* jobSystem);
+
+	// nullptr if there is no created pipeline of that name.
+	ID3D12PipelineState* Get(const std::string& name) const;
+
+	bool Load(const std::wstring& path);
+	bool Save(const std::wstring& path) const;
+
+	const PipelineCache& Cache() const;
+
+private:
+	// Canonical bytes of desc, field by field so padding does not count.
+	std::vector<std::uint8_t> Serialize(const GraphicsPipelineDesc& desc) const;
+	PipelineCache::Blob Create(PipelineCache::PipelineId id, const PipelineCache::Blob* cachedBlob);
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> m_Device;
+	Microsoft::WRL::ComPtr<ID3D12RootSignature> m_RootSignature;
+	std::vector<D3D12_INPUT_ELEMENT_DESC> m_InputLayout;
+	// Serialized once, it is part of every description.
+	std::vector<std::uint8_t> m_InputLayoutBytes;
+
+	// Descriptions and pipeline states by pipeline id.
+	std::vector<GraphicsPipelineDesc> m_Descs;
+	std::vector<Microsoft::WRL::ComPtr<ID3D12PipelineState>> m_PipelineStates;
+	std::unordered_map<std::string, PipelineCache::PipelineId> m_Names;
+
+	PipelineCache m_Cache;
+};
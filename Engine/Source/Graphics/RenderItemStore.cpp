@@ -0,0 +1,260 @@
+#include "Engine.h"
+#include "RenderItemStore.h"
+
+RenderItemHandle RenderItemStore::Create(const RenderItemDesc& desc)
+{
+	UINT slot;
+	if (!m_FreeSlots.empty())
+	{
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	}
+	else
+	{
+		slot = (UINT)m_Slots.size();
+		m_Slots.push_back(Slot());
+	}
+
+	m_Slots[slot].Index = Count();
+	m_ItemSlots.push_back(slot);
+
+	RenderItemTransform transform;
+	transform.TexTransform = desc.TexTransform;
+	transform.ObjConstantBufferIndex = desc.ObjConstantBufferIndex;
+	m_Transforms.push_back(transform);
+
+	RenderItemDrawArgs drawArgs;
+	drawArgs.Geo = desc.Geo;
+	drawArgs.PrimitiveType = desc.PrimitiveType;
+	drawArgs.IndexCount = desc.IndexCount;
+	drawArgs.StartIndexLocation = desc.StartIndexLocation;
+	drawArgs.BaseVertexLocation = desc.BaseVertexLocation;
+	drawArgs.Submesh = desc.Submesh;
+	AssignDrawIds(drawArgs);
+	m_DrawArgs.push_back(drawArgs);
+
+	RenderItemFlags flags;
+	flags.IsVisible = desc.IsVisible;
+	flags.FrustumTest = desc.FrustumTest;
+	flags.DoPicking = desc.DoPicking;
+	m_Flags.push_back(flags);
+
+	m_Bounds.push_back(desc.Bounds);
+	m_Materials.push_back(desc.Mat);
+
+	RenderItemInfo info;
+	info.GeoName = desc.GeoName;
+	info.GeoShapeName = desc.GeoShapeName;
+	info.WorldScaling = desc.WorldScaling;
+	info.WorldRotation = desc.WorldRotation;
+	info.WorldTranslation = desc.WorldTranslation;
+	info.ShadowSource = desc.ShadowSource;
+	info.ShadowIndex = desc.ShadowIndex;
+	info.ReflectionSource = desc.ReflectionSource;
+	m_Infos.push_back(std::move(info));
+
+	return { slot, m_Slots[slot].Generation };
+}
+
+void RenderItemStore::Destroy(RenderItemHandle handle)
+{
+	if (!IsValid(handle))
+		return;
+
+	UINT index = m_Slots[handle.Slot].Index;
+	UINT last = Count() - 1;
+
+	ReleaseDrawIds(m_DrawArgs[index]);
+
+	if (index != last)
+	{
+		m_Transforms[index] = m_Transforms[last];
+		m_DrawArgs[index] = m_DrawArgs[last];
+		m_Flags[index] = m_Flags[last];
+		m_Bounds[index] = m_Bounds[last];
+		m_Materials[index] = m_Materials[last];
+		m_Infos[index] = std::move(m_Infos[last]);
+
+		m_ItemSlots[index] = m_ItemSlots[last];
+		m_Slots[m_ItemSlots[index]].Index = index;
+	}
+
+	m_Transforms.pop_back();
+	m_DrawArgs.pop_back();
+	m_Flags.pop_back();
+	m_Bounds.pop_back();
+	m_Materials.pop_back();
+	m_Infos.pop_back();
+	m_ItemSlots.pop_back();
+
+	// Invalidate the handles to the slot before it is reused.
+	m_Slots[handle.Slot].Generation++;
+	m_FreeSlots.push_back(handle.Slot);
+}
+
+void RenderItemStore::Clear()
+{
+	// Keep the generations, so handles to the old items stay invalid.
+	for (UINT slot : m_ItemSlots)
+	{
+		m_Slots[slot].Generation++;
+		m_FreeSlots.push_back(slot);
+	}
+
+	m_ItemSlots.clear();
+	m_Transforms.clear();
+	m_DrawArgs.clear();
+	m_Flags.clear();
+	m_Bounds.clear();
+	m_Materials.clear();
+	m_Infos.clear();
+
+	m_GeometryIds.Clear();
+	m_DrawIds.Clear();
+}
+
+bool RenderItemStore::IsValid(RenderItemHandle handle) const
+{
+	return handle.Slot < (UINT)m_Slots.size() && m_Slots[handle.Slot].Generation == handle.Generation;
+}
+
+UINT RenderItemStore::Count() const
+{
+	return (UINT)m_ItemSlots.size();
+}
+
+UINT RenderItemStore::IndexOf(RenderItemHandle handle) const
+{
+	return m_Slots[handle.Slot].Index;
+}
+
+RenderItemHandle RenderItemStore::HandleAt(UINT index) const
+{
+	UINT slot = m_ItemSlots[index];
+	return { slot, m_Slots[slot].Generation };
+}
+
+RenderItemTransform& RenderItemStore::Transform(RenderItemHandle handle)
+{
+	return m_Transforms[IndexOf(handle)];
+}
+
+const RenderItemTransform& RenderItemStore::Transform(RenderItemHandle handle) const
+{
+	return m_Transforms[IndexOf(handle)];
+}
+
+const RenderItemDrawArgs& RenderItemStore::DrawArgs(RenderItemHandle handle) const
+{
+	return m_DrawArgs[IndexOf(handle)];
+}
+
+void RenderItemStore::SetDrawArgs(RenderItemHandle handle, const RenderItemDrawArgs& drawArgs)
+{
+	// Acquired before the old ids are released, so an unchanged draw keeps its ids.
+	RenderItemDrawArgs args = drawArgs;
+	AssignDrawIds(args);
+	ReleaseDrawIds(m_DrawArgs[IndexOf(handle)]);
+	m_DrawArgs[IndexOf(handle)] = args;
+}
+
+RenderItemFlags& RenderItemStore::Flags(RenderItemHandle handle)
+{
+	return m_Flags[IndexOf(handle)];
+}
+
+const RenderItemFlags& RenderItemStore::Flags(RenderItemHandle handle) const
+{
+	return m_Flags[IndexOf(handle)];
+}
+
+BoundingVolumes& RenderItemStore::Bounds(RenderItemHandle handle)
+{
+	return m_Bounds[IndexOf(handle)];
+}
+
+const BoundingVolumes& RenderItemStore::Bounds(RenderItemHandle handle) const
+{
+	return m_Bounds[IndexOf(handle)];
+}
+
+Material*& RenderItemStore::Mat(RenderItemHandle handle)
+{
+	return m_Materials[IndexOf(handle)];
+}
+
+Material* RenderItemStore::Mat(RenderItemHandle handle) const
+{
+	return m_Materials[IndexOf(handle)];
+}
+
+RenderItemInfo& RenderItemStore::Info(RenderItemHandle handle)
+{
+	return m_Infos[IndexOf(handle)];
+}
+
+const RenderItemInfo& RenderItemStore::Info(RenderItemHandle handle) const
+{
+	return m_Infos[IndexOf(handle)];
+}
+
+const std::vector<RenderItemFlags>& RenderItemStore::FlagsArray() const
+{
+	return m_Flags;
+}
+
+template<typename Key>
+UINT RenderItemStore::IdTable<Key>::Acquire(const Key& key)
+{
+	auto [it, inserted] = Ids.try_emplace(key);
+	if (inserted)
+	{
+		if (!FreeIds.empty())
+		{
+			it->second.Id = FreeIds.back();
+			FreeIds.pop_back();
+		}
+		else
+		{
+			it->second.Id = IdCount++;
+		}
+	}
+
+	it->second.RefCount++;
+	return it->second.Id;
+}
+
+template<typename Key>
+void RenderItemStore::IdTable<Key>::Release(const Key& key)
+{
+	auto it = Ids.find(key);
+	assert(it != Ids.end() && it->second.RefCount > 0);
+
+	if (--it->second.RefCount == 0)
+	{
+		FreeIds.push_back(it->second.Id);
+		Ids.erase(it);
+	}
+}
+
+template<typename Key>
+void RenderItemStore::IdTable<Key>::Clear()
+{
+	Ids.clear();
+	FreeIds.clear();
+	IdCount = 0;
+}
+
+void RenderItemStore::AssignDrawIds(RenderItemDrawArgs& drawArgs)
+{
+	drawArgs.GeometryId = m_GeometryIds.Acquire(drawArgs.Geo);
+	drawArgs.DrawId = m_DrawIds.Acquire(DrawKey(drawArgs.Geo, drawArgs.PrimitiveType, drawArgs.IndexCount,
+		drawArgs.StartIndexLocation, drawArgs.BaseVertexLocation));
+}
+
+void RenderItemStore::ReleaseDrawIds(const RenderItemDrawArgs& drawArgs)
+{
+	m_GeometryIds.Release(drawArgs.Geo);
+	m_DrawIds.Release(DrawKey(drawArgs.Geo, drawArgs.PrimitiveType, drawArgs.IndexCount,
+		drawArgs.StartIndexLocation, drawArgs.BaseVertexLocation));
+}
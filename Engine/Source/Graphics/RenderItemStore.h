@@ -0,0 +1,228 @@
+#pragma once
+
+#include "SceneTypes.h"
+
+#include <map>
+#include <tuple>
+
+// Stable reference to a render item.  Slots are reused after an item is destroyed, the
+// generation tells a stale handle apart from one to the slot's new item.
+struct RenderItemHandle
+{
+	static const UINT InvalidSlot = 0xFFFFFFFF;
+
+	UINT Slot = InvalidSlot;
+	UINT Generation = 0;
+
+	bool operator==(const RenderItemHandle& rhs) const = default;
+};
+
+// Components of a render item.  Each one lives in its own contiguous array, so the
+// per-frame loops only stream through the data they actually read.
+
+// Read by the transform and object constant buffer updates.
+struct RenderItemTransform
+{
+	// World matrix of the shape that describes the object's local space
+	// relative to the world space, which defines the position, orientation,
+	// and scale of the object in the world.  Copied from the transform hierarchy
+	// whenever the item's node changes.
+	DirectX::XMFLOAT4X4 World = MathHelper::Identity4x4();
+	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+	// Index of the item's InstanceData in the frame resource's InstanceBuffer.
+	UINT ObjConstantBufferIndex = -1;
+
+	// Node of the item in GraphicsClass::m_Transforms.
+	UINT TransformNode = 0;
+};
+
+// Read when the item is drawn.
+struct RenderItemDrawArgs
+{
+	MeshGeometry* Geo = nullptr;
+
+	// Primitive topology.
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	// DrawIndexedInstanced parameters.
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	// Submesh whose levels of detail the item switches between, and the level the index
+	// range above currently draws.
+	const SubmeshGeometry* Submesh = nullptr;
+	UINT Lod = 0;
+
+	// Ids assigned by the store.  Items with the same GeometryId share vertex and index
+	// buffers, items with the same DrawId also share the topology and the submesh.  Ids are
+	// released with the last item using them and reused, so they stay below the number
+	// of geometries and draws in use.
+	UINT GeometryId = 0;
+	UINT DrawId = 0;
+};
+
+struct RenderItemFlags
+{
+	// Bit i is set when the item is a member of m_RenderItemLayer[i].  Used to sort
+	// the visible items back into their layers after culling.
+	UINT LayerMask = 0;
+
+	// Bit i is set while the item is queued in the dirty list of frame resource i.
+	// Because we have an instance buffer for each FrameResource, modified object data is
+	// queued in every FrameResource, and at most once in each of them.
+	UINT DirtyFrameMask = 0;
+
+	bool IsVisible = true;
+	bool FrustumTest = true;
+
+	bool DoPicking = false;
+	bool IsPicked = false;
+};
+
+// Cold data, only used by the editor and when the scene changes.
+struct RenderItemInfo
+{
+	std::string GeoName;
+	std::string GeoShapeName;
+
+	// Local transform of root items.  Shadows and reflections take the world matrix
+	// of their source instead.
+	DirectX::XMFLOAT3 WorldScaling = { 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 WorldRotation = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 WorldTranslation = { 0.0f, 0.0f, 0.0f };
+
+	// Shadows and reflections are children of their source in the transform hierarchy.
+	RenderItemHandle ShadowSource;
+	UINT ShadowIndex = 0;
+	RenderItemHandle ReflectionSource;
+};
+
+// Everything needed to create a render item.  Filled in once and split into the
+// components by RenderItemStore::Create().
+struct RenderItemDesc
+{
+	DirectX::XMFLOAT3 WorldScaling = { 1.0f, 1.0f, 1.0f };
+	DirectX::XMFLOAT3 WorldRotation = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 WorldTranslation = { 0.0f, 0.0f, 0.0f };
+
+	DirectX::XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+	BoundingVolumes Bounds;
+	bool FrustumTest = true;
+
+	bool IsVisible = true;
+
+	bool DoPicking = false;
+
+	UINT ObjConstantBufferIndex = -1;
+
+	Material* Mat = nullptr;
+	MeshGeometry* Geo = nullptr;
+
+	D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+	UINT IndexCount = 0;
+	UINT StartIndexLocation = 0;
+	int BaseVertexLocation = 0;
+
+	// Null for items that always draw the index range above.
+	const SubmeshGeometry* Submesh = nullptr;
+
+	std::string GeoName;
+	std::string GeoShapeName;
+
+	RenderItemHandle ShadowSource;
+	UINT ShadowIndex = 0;
+	RenderItemHandle ReflectionSource;
+};
+
+// Owns the render items as a structure of arrays.  Items are kept densely packed, so
+// a loop over all of them is a linear walk over each component it touches.  Handles stay
+// valid while the dense index of an item changes when another item is destroyed.
+class ENGINE_API RenderItemStore
+{
+public:
+	RenderItemStore() = default;
+	RenderItemStore(const RenderItemStore& rhs) = delete;
+	RenderItemStore& operator=(const RenderItemStore& rhs) = delete;
+	~RenderItemStore() = default;
+
+	RenderItemHandle Create(const RenderItemDesc& desc);
+	// Moves the last item into the hole, which changes the dense index of that item.
+	void Destroy(RenderItemHandle handle);
+	void Clear();
+
+	bool IsValid(RenderItemHandle handle) const;
+	UINT Count() const;
+
+	// Position of the item in the component arrays.
+	UINT IndexOf(RenderItemHandle handle) const;
+	RenderItemHandle HandleAt(UINT index) const;
+
+	RenderItemTransform& Transform(RenderItemHandle handle);
+	const RenderItemTransform& Transform(RenderItemHandle handle) const;
+	const RenderItemDrawArgs& DrawArgs(RenderItemHandle handle) const;
+	// Replaces the draw arguments and assigns their ids.
+	void SetDrawArgs(RenderItemHandle handle, const RenderItemDrawArgs& drawArgs);
+	RenderItemFlags& Flags(RenderItemHandle handle);
+	const RenderItemFlags& Flags(RenderItemHandle handle) const;
+	BoundingVolumes& Bounds(RenderItemHandle handle);
+	const BoundingVolumes& Bounds(RenderItemHandle handle) const;
+	Material*& Mat(RenderItemHandle handle);
+	Material* Mat(RenderItemHandle handle) const;
+	RenderItemInfo& Info(RenderItemHandle handle);
+	const RenderItemInfo& Info(RenderItemHandle handle) const;
+
+	// Flags of all items, indexed by IndexOf().
+	const std::vector<RenderItemFlags>& FlagsArray() const;
+
+private:
+	struct Slot
+	{
+		UINT Index = 0;
+		UINT Generation = 0;
+	};
+
+	using DrawKey = std::tuple<const MeshGeometry*, D3D12_PRIMITIVE_TOPOLOGY, UINT, UINT, int>;
+
+	// Id and the number of items using it.
+	struct SharedId
+	{
+		UINT Id = 0;
+		UINT RefCount = 0;
+	};
+
+	template<typename Key>
+	struct IdTable
+	{
+		std::map<Key, SharedId> Ids;
+		std::vector<UINT> FreeIds;
+		UINT IdCount = 0;
+
+		UINT Acquire(const Key& key);
+		void Release(const Key& key);
+		void Clear();
+	};
+
+	void AssignDrawIds(RenderItemDrawArgs& drawArgs);
+	void ReleaseDrawIds(const RenderItemDrawArgs& drawArgs);
+
+	std::vector<Slot> m_Slots;
+	std::vector<UINT> m_FreeSlots;
+
+	// Slot of every item, to find the handle of a dense index.
+	std::vector<UINT> m_ItemSlots;
+
+	std::vector<RenderItemTransform> m_Transforms;
+	std::vector<RenderItemDrawArgs> m_DrawArgs;
+	std::vector<RenderItemFlags> m_Flags;
+	std::vector<BoundingVolumes> m_Bounds;
+	std::vector<Material*> m_Materials;
+	std::vector<RenderItemInfo> m_Infos;
+
+	// Keyed by the geometry pointer, which is released before the geometry is retired.
+	IdTable<const MeshGeometry*> m_GeometryIds;
+	IdTable<DrawKey> m_DrawIds;
+};
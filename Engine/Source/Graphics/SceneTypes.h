@@ -0,0 +1,90 @@
+#pragma once
+
+// Types the scene and draw code shares with the Direct3D layer, without the Direct3D
+// headers.  The render item store, the instance batcher and the draw state cache only
+// compare geometries and pipeline states by address, so those stay incomplete here and
+// are defined in D3DUtils.h.
+
+#ifdef _WIN32
+	#include <d3d12.h>
+#else
+	// Values of D3D_PRIMITIVE_TOPOLOGY in d3dcommon.h, for builds without the Windows SDK.
+	enum D3D_PRIMITIVE_TOPOLOGY
+	{
+		D3D_PRIMITIVE_TOPOLOGY_UNDEFINED = 0,
+		D3D_PRIMITIVE_TOPOLOGY_POINTLIST = 1,
+		D3D_PRIMITIVE_TOPOLOGY_LINELIST = 2,
+		D3D_PRIMITIVE_TOPOLOGY_LINESTRIP = 3,
+		D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST = 4,
+		D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP = 5,
+	};
+	typedef D3D_PRIMITIVE_TOPOLOGY D3D12_PRIMITIVE_TOPOLOGY;
+
+	struct ID3D12PipelineState;
+#endif // _WIN32
+
+#include "MathHelper.h"
+#include "BoundingVolumes.h"
+#include "Common/MeshSimplifier.h"
+#include "Common/VertexPacking.h"
+#include "Common/Meshlets.h"
+
+#include <string>
+#include <vector>
+
+struct MeshGeometry;
+
+// Defines a subrange of geometry in a MeshGeometry.  This is for when multiple
+// geometries are stored in one vertex and index buffer.  It provides the offsets
+// and data needed to draw a subset of geometry stores in the vertex and index
+// buffers so that we can implement the technique described by Figure 6.3.
+struct SubmeshGeometry
+{
+    UINT IndexCount = 0;
+    UINT StartIndexLocation = 0;
+    INT BaseVertexLocation = 0;
+    // Vertices from BaseVertexLocation on that belong to this submesh, needed to pack them.
+    UINT VertexCount = 0;
+
+    // Decodes the positions of this submesh when its geometry has packed vertices.
+    PositionQuantization Quantization;
+
+    // Bounding volumes of the geometry defined by this submesh.
+    BoundingVolumes Bounds;
+
+    // Levels of detail with index ranges relative to StartIndexLocation.  Level 0 is
+    // the full submesh, empty when it has no simplified levels.
+    std::vector<MeshLod> Lods;
+
+    // Meshlets of the full level for cluster culling, with index ranges relative to
+    // StartIndexLocation.
+    MeshletCuller Meshlets;
+};
+
+// Simple struct to represent a material for our demos.  A production 3D engine
+// would likely create a class hierarchy of Materials.
+struct Material
+{
+    // Unique material name for lookup.
+    std::string Name;
+
+    // Index into the material buffer corresponding to this material.
+    int MatCBIndex = -1;
+
+    // Index of the diffuse texture in the texture table, assigned by the texture registry.
+    int DiffuseSrvHeapIndex = -1;
+
+    // Index into SRV heap for normal texture.
+    int NormalSrvHeapIndex = -1;
+
+    // Bit i is set while the material is queued in the dirty list of frame resource i.
+    // Because we have a material buffer for each FrameResource, a modified
+    // material is queued in every FrameResource, and at most once in each of them.
+    UINT DirtyFrameMask = 0;
+
+    // Material constant buffer data used for shading.
+    DirectX::XMFLOAT4 DiffuseAlbedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+    DirectX::XMFLOAT3 FresnelR0 = { 0.01f, 0.01f, 0.01f };
+    float Roughness = 0.25f;
+    DirectX::XMFLOAT4X4 MatTransform = MathHelper::Identity4x4();
+};
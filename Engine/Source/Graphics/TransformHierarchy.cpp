@@ -0,0 +1,142 @@
+#include "Engine.h"
+#include "TransformHierarchy.h"
+
+using namespace DirectX;
+
+void TransformHierarchy::Clear()
+{
+	m_Parents.clear();
+	m_Spaces.clear();
+	m_Locals.clear();
+	m_Worlds.clear();
+	m_Flags.clear();
+	m_Depths.clear();
+	m_LevelStarts.clear();
+	m_ChangedNodes.clear();
+	m_FirstDirtyNode = InvalidNode;
+}
+
+UINT TransformHierarchy::Add(UINT parent, const XMFLOAT4X4& local, Space space)
+{
+	UINT node = (UINT)m_Parents.size();
+	UINT depth = parent == InvalidNode ? 0 : m_Depths[parent] + 1;
+
+	// Keep the levels sorted, a node may only start a new level or join the last one.
+	assert(depth + 1 >= (UINT)m_LevelStarts.size() && depth <= (UINT)m_LevelStarts.size());
+	if (depth == (UINT)m_LevelStarts.size())
+		m_LevelStarts.push_back(node);
+
+	m_Parents.push_back(parent);
+	m_Spaces.push_back(space);
+	m_Locals.push_back(local);
+	m_Worlds.push_back(local);
+	m_Flags.push_back(NodeDirty);
+	m_Depths.push_back(depth);
+
+	m_FirstDirtyNode = std::min<UINT>(m_FirstDirtyNode, node);
+	return node;
+}
+
+void TransformHierarchy::SetLocal(UINT node, const XMFLOAT4X4& local)
+{
+	m_Locals[node] = local;
+	m_Flags[node] |= NodeDirty;
+	m_FirstDirtyNode = std::min<UINT>(m_FirstDirtyNode, node);
+}
+
+void TransformHierarchy::SetLocal(UINT node, const XMFLOAT3& scaling, const XMFLOAT3& rotation,
+	const XMFLOAT3& translation)
+{
+	XMMATRIX local = XMMatrixScaling(scaling.x, scaling.y, scaling.z);
+	local *= XMMatrixRotationX(rotation.x) * XMMatrixRotationY(rotation.y) * XMMatrixRotationZ(rotation.z);
+	local *= XMMatrixTranslation(translation.x, translation.y, translation.z);
+
+	XMFLOAT4X4 localMatrix;
+	XMStoreFloat4x4(&localMatrix, local);
+	SetLocal(node, localMatrix);
+}
+
+UINT TransformHierarchy::NodeCount() const
+{
+	return (UINT)m_Parents.size();
+}
+
+UINT TransformHierarchy::Parent(UINT node) const
+{
+	return m_Parents[node];
+}
+
+const XMFLOAT4X4& TransformHierarchy::Local(UINT node) const
+{
+	return m_Locals[node];
+}
+
+const XMFLOAT4X4& TransformHierarchy::World(UINT node) const
+{
+	return m_Worlds[node];
+}
+
+const std::vector<UINT>& TransformHierarchy::Update()
+{
+	m_ChangedNodes.clear();
+	if (m_FirstDirtyNode == InvalidNode)
+		return m_ChangedNodes;
+
+	UINT nodeCount = NodeCount();
+	UINT levelCount = (UINT)m_LevelStarts.size();
+	JobSystem* jobSystem = JobSystem::Instance();
+
+	// Levels that end before the first modified node have nothing to update.  Parents are
+	// finished one level before their children, so the nodes of a level are independent.
+	for (UINT level = m_Depths[m_FirstDirtyNode]; level < levelCount; ++level)
+	{
+		UINT begin = std::max<UINT>(m_LevelStarts[level], m_FirstDirtyNode);
+		UINT end = level + 1 < levelCount ? m_LevelStarts[level + 1] : nodeCount;
+
+		auto updateRange = [this, begin](UINT rangeBegin, UINT rangeEnd)
+			{
+				for (UINT i = begin + rangeBegin; i < begin + rangeEnd; ++i)
+					UpdateNode(i);
+			};
+
+		if (jobSystem != nullptr)
+			jobSystem->ParallelFor(end - begin, NodesPerJob, updateRange);
+		else
+			updateRange(0, end - begin);
+	}
+
+	for (UINT i = m_FirstDirtyNode; i < nodeCount; ++i)
+	{
+		if (m_Flags[i] & NodeChanged)
+			m_ChangedNodes.push_back(i);
+		m_Flags[i] = 0;
+	}
+
+	m_FirstDirtyNode = InvalidNode;
+	return m_ChangedNodes;
+}
+
+void TransformHierarchy::UpdateNode(UINT node)
+{
+	UINT parent = m_Parents[node];
+	bool parentChanged = parent != InvalidNode && (m_Flags[parent] & NodeChanged) != 0;
+
+	if ((m_Flags[node] & NodeDirty) == 0 && !parentChanged)
+		return;
+
+	XMMATRIX local = XMLoadFloat4x4(&m_Locals[node]);
+	if (parent == InvalidNode)
+	{
+		XMStoreFloat4x4(&m_Worlds[node], local);
+	}
+	else
+	{
+		XMMATRIX parentWorld = XMLoadFloat4x4(&m_Worlds[parent]);
+		if (m_Spaces[node] == Space::Parent)
+			XMStoreFloat4x4(&m_Worlds[node], local * parentWorld);
+		else
+			XMStoreFloat4x4(&m_Worlds[node], parentWorld * local);
+	}
+
+	m_Flags[node] = NodeChanged;
+}
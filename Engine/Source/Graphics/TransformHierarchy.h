@@ -0,0 +1,79 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <cstdint>
+#include <vector>
+
+// Flat transform hierarchy.  Nodes are stored in arrays sorted by depth, a node's parent
+// always being on the level above it, so one pass over the levels in order propagates
+// every change and the nodes of one level can be updated in parallel.  Only nodes whose
+// local transform was set since the last Update(), and their descendants, are recomputed.
+class ENGINE_API TransformHierarchy
+{
+public:
+	static const UINT InvalidNode = 0xFFFFFFFF;
+
+	// How a node's local transform combines with its parent's world matrix.
+	enum class Space
+	{
+		// World = Local * ParentWorld, the usual child transform.
+		Parent,
+		// World = ParentWorld * Local.  The local transform is applied after the parent's,
+		// in world space, as for shadows and reflections projecting their parent.
+		World
+	};
+
+	TransformHierarchy() = default;
+	TransformHierarchy(const TransformHierarchy& rhs) = delete;
+	TransformHierarchy& operator=(const TransformHierarchy& rhs) = delete;
+	~TransformHierarchy() = default;
+
+	void Clear();
+
+	// Appends a node and returns its index.  parent is InvalidNode for a root.  Nodes have
+	// to be added level by level: roots first, then their children, and so on.
+	UINT Add(UINT parent, const DirectX::XMFLOAT4X4& local, Space space = Space::Parent);
+
+	void SetLocal(UINT node, const DirectX::XMFLOAT4X4& local);
+	// Local = Scaling * RotationX * RotationY * RotationZ * Translation, angles in radians.
+	void SetLocal(UINT node, const DirectX::XMFLOAT3& scaling, const DirectX::XMFLOAT3& rotation,
+		const DirectX::XMFLOAT3& translation);
+
+	UINT NodeCount() const;
+	UINT Parent(UINT node) const;
+	const DirectX::XMFLOAT4X4& Local(UINT node) const;
+	const DirectX::XMFLOAT4X4& World(UINT node) const;
+
+	// Recomputes the world matrices of the modified subtrees and returns the nodes whose
+	// world matrix was recomputed, in ascending order.  Returns an empty list right away
+	// when nothing was modified.
+	const std::vector<UINT>& Update();
+
+private:
+	void UpdateNode(UINT node);
+
+private:
+	// Below this many nodes per level it is cheaper to update on the calling thread.
+	static const UINT NodesPerJob = 1024;
+
+	enum : std::uint8_t
+	{
+		NodeDirty = 1,
+		NodeChanged = 2
+	};
+
+	std::vector<UINT> m_Parents;
+	std::vector<Space> m_Spaces;
+	std::vector<DirectX::XMFLOAT4X4> m_Locals;
+	std::vector<DirectX::XMFLOAT4X4> m_Worlds;
+	std::vector<std::uint8_t> m_Flags;
+	std::vector<UINT> m_Depths;
+
+	// First node of every level.
+	std::vector<UINT> m_LevelStarts;
+
+	// Lowest modified node, InvalidNode when nothing was modified.
+	UINT m_FirstDirtyNode = InvalidNode;
+
+	std::vector<UINT> m_ChangedNodes;
+};
@@ -58,10 +58,86 @@ public:
         memcpy(&m_MappedData[elementIndex * m_ElementByteSize], &data, sizeof(T));
     }
 
+    // Copies count consecutive elements, only for buffers without constant buffer padding.
+    void CopyData(int elementIndex, const T* data, UINT count)
+    {
+        assert(!m_IsConstantBuffer);
+        memcpy(&m_MappedData[elementIndex * m_ElementByteSize], data, count * sizeof(T));
+    }
+
+    // Copies the first elementCount elements of another buffer with the same layout.
+    void CopyFrom(const UploadBuffer& source, UINT elementCount)
+    {
+        assert(m_ElementByteSize == source.m_ElementByteSize);
+        memcpy(m_MappedData, source.m_MappedData, (size_t)elementCount * m_ElementByteSize);
+    }
+
 protected:
     Microsoft::WRL::ComPtr<ID3D12Resource> m_UploadBuffer;
     BYTE* m_MappedData = nullptr;
 
     UINT m_ElementByteSize = 0;
     bool m_IsConstantBuffer = false;
+};
+
+// Upload buffer that grows instead of being recreated.  Growing allocates a larger buffer
+// and copies the elements written so far, so indices into it stay valid and nothing has
+// to be uploaded again.  The caller makes sure the GPU no longer reads the old buffer.
+template<typename T>
+class ENGINE_API GrowableUploadBuffer
+{
+public:
+    GrowableUploadBuffer(ID3D12Device* device, UINT elementCount, bool isConstantBuffer) :
+        m_IsConstantBuffer(isConstantBuffer)
+    {
+        m_Capacity = elementCount > 0 ? elementCount : 1;
+        m_Buffer = std::make_unique<UploadBuffer<T>>(device, m_Capacity, isConstantBuffer);
+    }
+
+    GrowableUploadBuffer(const GrowableUploadBuffer& rhs) = delete;
+    GrowableUploadBuffer& operator=(const GrowableUploadBuffer& rhs) = delete;
+    ~GrowableUploadBuffer() = default;
+
+    // Makes room for elementCount elements and returns true if the buffer was replaced.
+    // The capacity at least doubles, so the copies add up to a constant cost per element.
+    bool Reserve(ID3D12Device* device, UINT elementCount)
+    {
+        if (elementCount <= m_Capacity)
+            return false;
+
+        UINT capacity = std::max<UINT>(elementCount, 2 * m_Capacity);
+        auto buffer = std::make_unique<UploadBuffer<T>>(device, capacity, m_IsConstantBuffer);
+        buffer->CopyFrom(*m_Buffer, m_Capacity);
+
+        m_Buffer = std::move(buffer);
+        m_Capacity = capacity;
+        return true;
+    }
+
+    UINT Capacity() const
+    {
+        return m_Capacity;
+    }
+
+    ID3D12Resource* Resource() const
+    {
+        return m_Buffer->Resource();
+    }
+
+    void CopyData(int elementIndex, const T& data)
+    {
+        assert((UINT)elementIndex < m_Capacity);
+        m_Buffer->CopyData(elementIndex, data);
+    }
+
+    void CopyData(int elementIndex, const T* data, UINT count)
+    {
+        assert((UINT)elementIndex + count <= m_Capacity);
+        m_Buffer->CopyData(elementIndex, data, count);
+    }
+
+private:
+    std::unique_ptr<UploadBuffer<T>> m_Buffer;
+    UINT m_Capacity = 0;
+    bool m_IsConstantBuffer = false;
 };
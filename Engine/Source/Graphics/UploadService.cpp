@@ -0,0 +1,155 @@
+#include "Engine.h"
+#include "UploadService.h"
+
+using Microsoft::WRL::ComPtr;
+
+UploadService::UploadService(ID3D12Device* device, UINT64 stagingSize) :
+	m_Device(device),
+	m_Ring(this, stagingSize)
+{
+	D3D12_COMMAND_QUEUE_DESC queueDesc = {};
+	queueDesc.Type = D3D12_COMMAND_LIST_TYPE_COPY;
+	queueDesc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+	ThrowIfFailed(device->CreateCommandQueue(&queueDesc, IID_PPV_ARGS(&m_CopyQueue)));
+
+	ThrowIfFailed(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&m_Fence)));
+
+	m_Allocator = AcquireAllocator();
+	ThrowIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_COPY,
+		m_Allocator.Get(), nullptr, IID_PPV_ARGS(m_CommandList.GetAddressOf())));
+
+	// The staging buffer stays mapped for its whole lifetime.
+	D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+	D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(stagingSize);
+	ThrowIfFailed(device->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&m_StagingBuffer)));
+
+	ThrowIfFailed(m_StagingBuffer->Map(0, nullptr, reinterpret_cast<void**>(&m_MappedStaging)));
+}
+
+UploadService::~UploadService()
+{
+	WaitForTicket(Flush());
+	m_StagingBuffer->Unmap(0, nullptr);
+}
+
+ComPtr<ID3D12Resource> UploadService::CreateDefaultBuffer(const void* data, UINT64 byteSize)
+{
+	ComPtr<ID3D12Resource> defaultBuffer;
+
+	// Buffers are promoted from the common state by the copy and decay back to it when the
+	// copy queue is done, so the direct queue can read them without barriers.
+	D3D12_HEAP_PROPERTIES heapProperties = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+	D3D12_RESOURCE_DESC resourceDesc = CD3DX12_RESOURCE_DESC::Buffer(byteSize);
+	ThrowIfFailed(m_Device->CreateCommittedResource(
+		&heapProperties,
+		D3D12_HEAP_FLAG_NONE,
+		&resourceDesc,
+		D3D12_RESOURCE_STATE_COMMON,
+		nullptr,
+		IID_PPV_ARGS(defaultBuffer.GetAddressOf())));
+
+	const BYTE* source = static_cast<const BYTE*>(data);
+	for (UINT64 copied = 0; copied < byteSize;)
+	{
+		// Allocating may submit the copies recorded so far to make room.
+		UINT64 size = std::min<UINT64>(byteSize - copied, m_Ring.Size());
+		UINT64 offset = m_Ring.Allocate(size, 16);
+
+		memcpy(m_MappedStaging + offset, source + copied, size);
+		m_CommandList->CopyBufferRegion(defaultBuffer.Get(), copied, m_StagingBuffer.Get(), offset, size);
+		m_HasCommands = true;
+
+		copied += size;
+	}
+
+	return defaultBuffer;
+}
+
+UINT64 UploadService::Flush()
+{
+	return m_Ring.Submit();
+}
+
+bool UploadService::IsComplete(UINT64 ticket) const
+{
+	return m_Ring.IsComplete(ticket);
+}
+
+void UploadService::WaitForTicket(UINT64 ticket)
+{
+	m_Ring.WaitForTicket(ticket);
+}
+
+void UploadService::Retire()
+{
+	m_Ring.Retire();
+}
+
+UINT64 UploadService::StagingBytesInUse() const
+{
+	return m_Ring.UsedBytes();
+}
+
+std::uint64_t UploadService::Submit()
+{
+	if (m_HasCommands)
+	{
+		ThrowIfFailed(m_CommandList->Close());
+		ID3D12CommandList* cmdsLists[] = { m_CommandList.Get() };
+		m_CopyQueue->ExecuteCommandLists(_countof(cmdsLists), cmdsLists);
+	}
+
+	ThrowIfFailed(m_CopyQueue->Signal(m_Fence.Get(), ++m_CurrentFence));
+
+	if (m_HasCommands)
+	{
+		m_SubmittedAllocators.push_back({ m_CurrentFence, m_Allocator });
+		m_Allocator = AcquireAllocator();
+		ThrowIfFailed(m_CommandList->Reset(m_Allocator.Get(), nullptr));
+		m_HasCommands = false;
+	}
+
+	return m_CurrentFence;
+}
+
+std::uint64_t UploadService::CompletedFence() const
+{
+	return m_Fence->GetCompletedValue();
+}
+
+void UploadService::WaitForFence(std::uint64_t fence)
+{
+	if (m_Fence->GetCompletedValue() < fence)
+	{
+		HANDLE eventHandle = CreateEventEx(nullptr, nullptr, false, EVENT_ALL_ACCESS);
+		ThrowIfFailed(m_Fence->SetEventOnCompletion(fence, eventHandle));
+		WaitForSingleObject(eventHandle, INFINITE);
+		CloseHandle(eventHandle);
+	}
+}
+
+ComPtr<ID3D12CommandAllocator> UploadService::AcquireAllocator()
+{
+	ComPtr<ID3D12CommandAllocator> allocator;
+
+	// Reuse the oldest allocator if the copy queue has finished its list.
+	if (!m_SubmittedAllocators.empty() && m_SubmittedAllocators.front().first <= m_Fence->GetCompletedValue())
+	{
+		allocator = m_SubmittedAllocators.front().second;
+		m_SubmittedAllocators.pop_front();
+		ThrowIfFailed(allocator->Reset());
+	}
+	else
+	{
+		ThrowIfFailed(m_Device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+			IID_PPV_ARGS(allocator.GetAddressOf())));
+	}
+
+	return allocator;
+}
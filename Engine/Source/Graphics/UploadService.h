@@ -0,0 +1,54 @@
+#pragma once
+
+#include "D3DUtils.h"
+#include "Common/UploadRing.h"
+
+// Uploads buffers through a persistent staging ring on a dedicated copy queue.  Copies are
+// recorded until Flush(), which returns a fence ticket.  The default buffers may be used on
+// the direct queue once the ticket is complete, nothing waits for the copies in between.
+class ENGINE_API UploadService : public UploadQueue
+{
+public:
+	UploadService(ID3D12Device* device, UINT64 stagingSize);
+	UploadService(const UploadService& rhs) = delete;
+	UploadService& operator=(const UploadService& rhs) = delete;
+	~UploadService();
+
+	// Creates a default heap buffer and records the copy of data into it.  Buffers larger
+	// than the staging ring are copied in pieces.
+	Microsoft::WRL::ComPtr<ID3D12Resource> CreateDefaultBuffer(const void* data, UINT64 byteSize);
+
+	// Submits the copies recorded so far and returns their ticket.
+	UINT64 Flush();
+	bool IsComplete(UINT64 ticket) const;
+	void WaitForTicket(UINT64 ticket);
+
+	// Frees the staging memory and allocators of the completed uploads.
+	void Retire();
+
+	UINT64 StagingBytesInUse() const;
+
+	// UploadQueue
+	std::uint64_t Submit() override;
+	std::uint64_t CompletedFence() const override;
+	void WaitForFence(std::uint64_t fence) override;
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> AcquireAllocator();
+
+private:
+	Microsoft::WRL::ComPtr<ID3D12Device> m_Device;
+	Microsoft::WRL::ComPtr<ID3D12CommandQueue> m_CopyQueue;
+	Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> m_CommandList;
+	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> m_Allocator;
+	// Allocators of submitted lists with the fence after which they can be reset.
+	std::deque<std::pair<UINT64, Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>> m_SubmittedAllocators;
+	bool m_HasCommands = false;
+
+	Microsoft::WRL::ComPtr<ID3D12Fence> m_Fence;
+	UINT64 m_CurrentFence = 0;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_StagingBuffer;
+	BYTE* m_MappedStaging = nullptr;
+	UploadRing m_Ring;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <DirectXMath.h>
+
+// Vertex of the meshes built on the CPU: the shapes, the text models and the binary mesh
+// cache, which stores it as is.  Bump MeshFile::FileVersion when the layout changes.
+struct Vertex
+{
+    Vertex() = default;
+    Vertex(float x, float y, float z, float nx, float ny, float nz, float u, float v) :
+        Pos(x, y, z),
+        Normal(nx, ny, nz),
+        TexC(u, v) {}
+
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT3 Normal;
+    DirectX::XMFLOAT2 TexC;
+};
@@ -15,14 +15,13 @@ ImguiManager::~ImguiManager()
 	ImGui::DestroyContext();
 }
 
-void ImguiManager::Initialize(ID3D12Device* d3dDevice, DXGI_FORMAT backBufferFormat, ID3D12DescriptorHeap* srvHeap)
+void ImguiManager::Initialize(ID3D12Device* d3dDevice, DXGI_FORMAT backBufferFormat, ID3D12DescriptorHeap* srvHeap,
+	D3D12_CPU_DESCRIPTOR_HANDLE fontSrvCpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE fontSrvGpuHandle)
 {
 	if (!ImGuiImplDX12Initialized)
 	{
 		ImGuiImplDX12Initialized = ImGui_ImplDX12_Init(d3dDevice, 3,
-			backBufferFormat, srvHeap,
-			srvHeap->GetCPUDescriptorHandleForHeapStart(),
-			srvHeap->GetGPUDescriptorHandleForHeapStart());
+			backBufferFormat, srvHeap, fontSrvCpuHandle, fontSrvGpuHandle);
 	}
 }
 
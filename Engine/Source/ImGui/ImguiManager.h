@@ -14,7 +14,9 @@ public:
 	ImguiManager();
 	~ImguiManager();
 
-	void Initialize(ID3D12Device* d3dDevice, DXGI_FORMAT backBufferFormat, ID3D12DescriptorHeap* srvHeap);
+	// The font texture's view is created at the given descriptor of srvHeap.
+	void Initialize(ID3D12Device* d3dDevice, DXGI_FORMAT backBufferFormat, ID3D12DescriptorHeap* srvHeap,
+		D3D12_CPU_DESCRIPTOR_HANDLE fontSrvCpuHandle, D3D12_GPU_DESCRIPTOR_HANDLE fontSrvGpuHandle);
 	void NewFrame();
 	void DrawRenderData(ID3D12GraphicsCommandList* commandList);
 	void ShowSetItemsWindow();
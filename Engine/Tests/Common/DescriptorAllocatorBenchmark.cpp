@@ -0,0 +1,93 @@
+#include "Engine.h"
+#include "Common/DescriptorAllocator.h"
+#include "Benchmark.h"
+
+#include <random>
+#include <thread>
+
+// Measures allocation throughput and fragmentation of the persistent allocator under random
+// churn, and the transient ring filled by one and by several recording threads.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const std::uint32_t operationCount = quick ? 10000 : 1000000;
+	const int repeatCount = quick ? 1 : 10;
+	const std::uint32_t capacity = 1 << 16;
+
+	// Sizes like SRV tables: mostly single descriptors, a few larger ranges.
+	std::mt19937 rng(17);
+	std::vector<std::uint32_t> sizes(operationCount);
+	std::vector<std::uint32_t> victims(operationCount);
+	for (std::uint32_t i = 0; i < operationCount; ++i)
+	{
+		sizes[i] = rng() % 8 == 0 ? 1 + rng() % 32 : 1;
+		victims[i] = (std::uint32_t)rng();
+	}
+
+	std::uint32_t freeRanges = 0;
+	std::uint32_t largest = 0;
+	std::uint32_t allocated = 0;
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			// Keeps the heap about three quarters full, freeing a random live range whenever
+			// the next allocation does not fit.
+			DescriptorAllocator allocator(capacity);
+			std::vector<std::pair<std::uint32_t, std::uint32_t>> live;
+			for (std::uint32_t i = 0; i < operationCount; ++i)
+			{
+				if (allocator.AllocatedCount() + sizes[i] > capacity * 3 / 4 && !live.empty())
+				{
+					size_t victim = victims[i] % live.size();
+					allocator.Free(live[victim].first, live[victim].second);
+					live[victim] = live.back();
+					live.pop_back();
+				}
+
+				std::uint32_t offset = allocator.Allocate(sizes[i]);
+				if (offset != DescriptorAllocator::InvalidOffset)
+					live.push_back({ offset, sizes[i] });
+			}
+			freeRanges = allocator.FreeRangeCount();
+			largest = allocator.LargestFreeRange();
+			allocated = allocator.AllocatedCount();
+		});
+	Benchmark::Report("DescriptorAllocator, random churn", ms, operationCount);
+	std::printf("  %u allocated, %u free ranges, largest %u of %u free\n", allocated, freeRanges, largest,
+		capacity - allocated);
+
+	// Large enough for every allocation of a fill.
+	std::uint64_t totalSize = 0;
+	for (std::uint32_t size : sizes)
+		totalSize += size;
+	TransientDescriptorRing ring((std::uint32_t)totalSize * 2);
+	std::uint64_t fence = 0;
+	for (std::uint32_t threadCount : { 1u, 4u })
+	{
+		std::uint32_t perThread = operationCount / threadCount;
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				// One frame per fill, retired at once as if the GPU were idle.
+				std::vector<std::thread> threads;
+				for (std::uint32_t t = 0; t < threadCount; ++t)
+				{
+					threads.emplace_back([&ring, &sizes, perThread, t]()
+						{
+							for (std::uint32_t i = 0; i < perThread; ++i)
+							{
+								if (ring.Allocate(sizes[t * perThread + i]) == TransientDescriptorRing::InvalidOffset)
+									break;
+							}
+						});
+				}
+				for (std::thread& thread : threads)
+					thread.join();
+				ring.EndFrame(++fence);
+				ring.Retire(fence);
+			});
+		char name[64];
+		std::snprintf(name, sizeof(name), "TransientDescriptorRing, %u threads", threadCount);
+		Benchmark::Report(name, ms, perThread * threadCount);
+	}
+
+	return 0;
+}
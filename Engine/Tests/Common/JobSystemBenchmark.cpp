@@ -0,0 +1,86 @@
+#include "Engine.h"
+#include "Common/JobSystem.h"
+#include "Benchmark.h"
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+
+namespace
+{
+	float Work(std::uint32_t i)
+	{
+		float x = (float)i;
+		for (int k = 0; k < 64; ++k)
+			x = std::sqrt(x + (float)k);
+		return x;
+	}
+}
+
+// Measures the cost of scheduling small jobs, the scaling of ParallelFor over a loop of
+// cheap items and the overhead of running a JobGraph.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const std::uint32_t jobCount = quick ? 1000 : 100000;
+	const std::uint32_t itemCount = quick ? 10000 : 1000000;
+	const int repeatCount = quick ? 1 : 10;
+
+	std::vector<float> results(itemCount);
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			for (std::uint32_t i = 0; i < itemCount; ++i)
+				results[i] = Work(i);
+		});
+	Benchmark::Report("loop, serial", ms, itemCount);
+
+	std::unique_ptr<JobSystem> jobSystem = std::make_unique<JobSystem>();
+	std::printf("%u threads\n", jobSystem->ThreadCount());
+
+	std::atomic<std::uint32_t> done = 0;
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			JobCounter counter;
+			for (std::uint32_t j = 0; j < jobCount; ++j)
+				jobSystem->Run(&counter, [&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+			jobSystem->Wait(counter);
+		});
+	Benchmark::Report("Run and Wait, empty jobs", ms, jobCount);
+
+	for (std::uint32_t grainSize : { 64u, 1024u, 16384u })
+	{
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				jobSystem->ParallelFor(itemCount, grainSize, [&results](std::uint32_t begin, std::uint32_t end)
+					{
+						for (std::uint32_t i = begin; i < end; ++i)
+							results[i] = Work(i);
+					});
+			});
+		char name[64];
+		std::snprintf(name, sizeof(name), "loop, ParallelFor grain %u", grainSize);
+		Benchmark::Report(name, ms, itemCount);
+	}
+
+	// Layers of 32 nodes, each node depending on two of the layer before.
+	JobGraph graph;
+	const std::uint32_t layerCount = jobCount / 32;
+	for (std::uint32_t layer = 0; layer < layerCount; ++layer)
+	{
+		for (std::uint32_t n = 0; n < 32; ++n)
+		{
+			JobGraph::NodeId id = graph.Add([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+			if (layer > 0)
+			{
+				graph.Precede(id - 32, id);
+				graph.Precede((layer - 1) * 32 + (n + 1) % 32, id);
+			}
+		}
+	}
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]() { graph.Run(jobSystem.get()); });
+	Benchmark::Report("JobGraph::Run, empty nodes", ms, layerCount * 32.0);
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]() { graph.Run(nullptr); });
+	Benchmark::Report("JobGraph::Run, serial", ms, layerCount * 32.0);
+
+	return 0;
+}
@@ -0,0 +1,278 @@
+#include "Engine.h"
+#include "Common/JobSystem.h"
+#include "Test.h"
+
+#include <atomic>
+#include <memory>
+#include <random>
+#include <thread>
+
+namespace
+{
+	// Splits itself in two until depth reaches zero, waiting for both halves from inside
+	// the job, and counts the leaves.
+	void Split(JobSystem& jobSystem, std::uint32_t depth, std::atomic<std::uint32_t>& leaves)
+	{
+		if (depth == 0)
+		{
+			leaves.fetch_add(1);
+			return;
+		}
+
+		JobCounter counter;
+		jobSystem.Run(&counter, [&jobSystem, depth, &leaves]() { Split(jobSystem, depth - 1, leaves); });
+		jobSystem.Run(&counter, [&jobSystem, depth, &leaves]() { Split(jobSystem, depth - 1, leaves); });
+		jobSystem.Wait(counter);
+	}
+
+	struct RandomGraph
+	{
+		std::vector<std::pair<JobGraph::NodeId, JobGraph::NodeId>> Edges;
+		std::uint32_t NodeCount = 0;
+	};
+
+	// Edges only go from lower to higher ids, so the graph has no cycles.
+	RandomGraph MakeRandomGraph(std::uint32_t nodeCount, std::uint32_t edgeCount, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<std::uint32_t> node(0, nodeCount - 1);
+
+		RandomGraph graph;
+		graph.NodeCount = nodeCount;
+		while (graph.Edges.size() < edgeCount)
+		{
+			std::uint32_t a = node(rng);
+			std::uint32_t b = node(rng);
+			if (a != b)
+				graph.Edges.push_back({ std::min(a, b), std::max(a, b) });
+		}
+		return graph;
+	}
+}
+
+TEST(JobSystem, InstanceIsTheNewestJobSystem)
+{
+	CHECK(JobSystem::Instance() == nullptr);
+	{
+		JobSystem outer(1);
+		CHECK(JobSystem::Instance() == &outer);
+		CHECK_EQ(outer.ThreadCount(), 2u);
+		{
+			JobSystem inner(3);
+			CHECK(JobSystem::Instance() == &inner);
+			CHECK_EQ(inner.ThreadCount(), 4u);
+		}
+		CHECK(JobSystem::Instance() == nullptr);
+	}
+	CHECK(JobSystem::Instance() == nullptr);
+
+	JobSystem automatic;
+	CHECK_GT(automatic.ThreadCount(), 1u);
+}
+
+TEST(JobSystem, ParallelForCoversEveryIndexOnce)
+{
+	for (std::uint32_t workerCount : { 1u, 3u, 7u })
+	{
+		JobSystem jobSystem(workerCount);
+		for (std::uint32_t count : { 0u, 1u, 2u, 7u, 1000u, 100003u })
+		{
+			for (std::uint32_t grainSize : { 0u, 1u, 3u, 64u, 100005u })
+			{
+				std::vector<std::atomic<std::uint32_t>> hits(count);
+				std::atomic<std::uint32_t> oversized = 0;
+				jobSystem.ParallelFor(count, grainSize, [&](std::uint32_t begin, std::uint32_t end)
+					{
+						if (end - begin > std::max(grainSize, 1u) || end > count || begin >= end)
+							oversized.fetch_add(1);
+						for (std::uint32_t i = begin; i < end && i < count; ++i)
+							hits[i].fetch_add(1);
+					});
+
+				std::uint32_t wrong = 0;
+				for (auto& hit : hits)
+					wrong += hit.load() != 1;
+				CHECK_MSG(wrong == 0 && oversized.load() == 0, "count " << count << ", grain " << grainSize <<
+					", " << workerCount << " workers: " << wrong << " indices not hit once, " << oversized.load() << " bad ranges");
+			}
+		}
+	}
+}
+
+TEST(JobSystem, FullQueueRunsJobsInline)
+{
+	// More jobs than a deque holds are scheduled from one thread.
+	JobSystem jobSystem(2);
+	std::atomic<std::uint64_t> sum = 0;
+	JobCounter counter;
+	for (std::uint32_t i = 0; i < 20000; ++i)
+		jobSystem.Run(&counter, [&sum, i]() { sum.fetch_add(i); });
+	jobSystem.Wait(counter);
+
+	CHECK_EQ(counter.Value.load(), 0u);
+	CHECK_EQ(sum.load(), 20000ull * 19999ull / 2);
+}
+
+TEST(JobSystem, NestedWaitsFinish)
+{
+	for (std::uint32_t workerCount : { 1u, 3u, 7u })
+	{
+		JobSystem jobSystem(workerCount);
+
+		std::atomic<std::uint32_t> leaves = 0;
+		Split(jobSystem, 12, leaves);
+		CHECK_EQ(leaves.load(), 1u << 12);
+
+		// ParallelFor inside ParallelFor: every inner loop waits on a worker.
+		std::vector<std::atomic<std::uint32_t>> cells(64 * 257);
+		jobSystem.ParallelFor(64, 1, [&](std::uint32_t begin, std::uint32_t end)
+			{
+				for (std::uint32_t row = begin; row < end; ++row)
+				{
+					jobSystem.ParallelFor(257, 16, [&cells, row](std::uint32_t b, std::uint32_t e)
+						{
+							for (std::uint32_t column = b; column < e; ++column)
+								cells[row * 257 + column].fetch_add(1);
+						});
+				}
+			});
+
+		std::uint32_t wrong = 0;
+		for (auto& cell : cells)
+			wrong += cell.load() != 1;
+		CHECK_EQ(wrong, 0u);
+	}
+}
+
+TEST(JobSystem, ForeignThreadsCanRunAndWait)
+{
+	JobSystem jobSystem(2);
+	std::atomic<std::uint32_t> done = 0;
+
+	// Threads that do not own a queue go through the shared list and only wait.
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([&jobSystem, &done]()
+			{
+				for (int round = 0; round < 50; ++round)
+				{
+					JobCounter counter;
+					for (int j = 0; j < 20; ++j)
+						jobSystem.Run(&counter, [&done]() { done.fetch_add(1); });
+					jobSystem.Wait(counter);
+				}
+			});
+	}
+
+	// The creating thread keeps working meanwhile.
+	std::atomic<std::uint32_t> own = 0;
+	for (int round = 0; round < 50; ++round)
+		jobSystem.ParallelFor(100, 10, [&own](std::uint32_t begin, std::uint32_t end) { own.fetch_add(end - begin); });
+
+	for (std::thread& thread : threads)
+		thread.join();
+
+	CHECK_EQ(done.load(), 4u * 50u * 20u);
+	CHECK_EQ(own.load(), 50u * 100u);
+}
+
+TEST(JobSystem, DestroyingWithFireAndForgetJobs)
+{
+	std::atomic<std::uint32_t> started = 0;
+	for (int round = 0; round < 20; ++round)
+	{
+		JobSystem jobSystem(3);
+		for (int j = 0; j < 200; ++j)
+			jobSystem.Run(nullptr, [&started]() { started.fetch_add(1); });
+	}
+	CHECK_LE(started.load(), 20u * 200u);
+	CHECK(JobSystem::Instance() == nullptr);
+}
+
+TEST(JobGraph, RunsEveryNodeOnceAfterItsDependencies)
+{
+	RandomGraph shape = MakeRandomGraph(400, 1200, 5);
+
+	std::atomic<std::uint32_t> clock = 0;
+	std::vector<std::atomic<std::uint32_t>> started(shape.NodeCount);
+	std::vector<std::atomic<std::uint32_t>> finished(shape.NodeCount);
+	std::vector<std::atomic<std::uint32_t>> runs(shape.NodeCount);
+
+	JobGraph graph;
+	for (std::uint32_t i = 0; i < shape.NodeCount; ++i)
+	{
+		graph.Add([&, i]()
+			{
+				started[i].store(++clock);
+				runs[i].fetch_add(1);
+				finished[i].store(++clock);
+			});
+	}
+	for (auto [before, after] : shape.Edges)
+		graph.Precede(before, after);
+
+	auto check = [&](std::uint32_t expectedRuns, const char* mode)
+		{
+			std::uint32_t wrongRuns = 0;
+			for (auto& run : runs)
+				wrongRuns += run.load() != expectedRuns;
+			std::uint32_t wrongOrder = 0;
+			for (auto [before, after] : shape.Edges)
+				wrongOrder += finished[before].load() >= started[after].load();
+			CHECK_MSG(wrongRuns == 0 && wrongOrder == 0, mode << ": " << wrongRuns << " nodes ran a wrong number of times, " <<
+				wrongOrder << " edges out of order");
+		};
+
+	graph.Run(nullptr);
+	check(1, "serial");
+
+	std::uint32_t expectedRuns = 1;
+	for (std::uint32_t workerCount : { 1u, 3u, 7u })
+	{
+		JobSystem jobSystem(workerCount);
+		for (int round = 0; round < 20; ++round)
+		{
+			graph.Run(&jobSystem);
+			check(++expectedRuns, "parallel");
+		}
+	}
+}
+
+TEST(JobGraph, NodesCanWaitOnNestedWork)
+{
+	JobSystem jobSystem(3);
+	std::vector<std::atomic<std::uint32_t>> cells(8 * 1000);
+	std::atomic<std::uint32_t> order = 0;
+	std::uint32_t lastStep = 0;
+
+	// A chain of fan outs: each step fills its row with a ParallelFor and checks the
+	// previous row is complete.
+	JobGraph graph;
+	std::uint32_t incompleteRows = 0;
+	JobGraph::NodeId previous = 0;
+	for (std::uint32_t row = 0; row < 8; ++row)
+	{
+		JobGraph::NodeId id = graph.Add([&, row]()
+			{
+				if (row > 0)
+				{
+					for (std::uint32_t i = 0; i < 1000; ++i)
+						incompleteRows += cells[(row - 1) * 1000 + i].load() != 1;
+				}
+				jobSystem.ParallelFor(1000, 50, [&cells, row](std::uint32_t begin, std::uint32_t end)
+					{
+						for (std::uint32_t i = begin; i < end; ++i)
+							cells[row * 1000 + i].fetch_add(1);
+					});
+				lastStep = ++order;
+			});
+		if (row > 0)
+			graph.Precede(previous, id);
+		previous = id;
+	}
+
+	graph.Run(&jobSystem);
+	CHECK_EQ(incompleteRows, 0u);
+	CHECK_EQ(lastStep, 8u);
+}
@@ -0,0 +1,71 @@
+#include "Engine.h"
+#include "Common/MeshOptimizer.h"
+#include "Benchmark.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+	const size_t Stride = 6 * sizeof(float);
+
+	void Run(const std::string& name, const TextModel& model, int repeatCount)
+	{
+		MeshOptimizer::Result result;
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				TextModel copy = model;
+				result = MeshOptimizer::Optimize(copy.Vertices.data(), Stride, copy.VertexCount(), copy.Indices.data(),
+					copy.Indices.size());
+			});
+		std::printf("%s: %u vertices, %u triangles\n", name.c_str(), model.VertexCount(), model.TriangleCount());
+		std::printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", result.Before.Acmr, result.After.Acmr,
+			result.Before.Atvr, result.After.Atvr);
+		Benchmark::Report("  MeshOptimizer::Optimize", ms, model.TriangleCount());
+
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				TextModel copy = model;
+				MeshOptimizer::OptimizeVertexCache(copy.Indices.data(), copy.Indices.size(), copy.VertexCount());
+			});
+		Benchmark::Report("  OptimizeVertexCache only", ms, model.TriangleCount());
+	}
+}
+
+// Optimizes the shipped models and a terrain grid in random triangle order, and prints the
+// vertex cache statistics before and after with the time it takes.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 10;
+
+	for (const char* name : { "car", "skull" })
+	{
+		std::vector<std::uint8_t> bytes = TempDirectory::Read(
+			(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (std::string(name) + ".txt")).wstring());
+		TextModel model;
+		if (!TextModel::Parse(std::string(bytes.begin(), bytes.end()), model))
+		{
+			std::printf("%s: cannot parse\n", name);
+			return 1;
+		}
+		Run(name, model, repeatCount);
+	}
+
+	const std::uint32_t size = quick ? 32 : 256;
+	TextModel terrain = TextModel::Terrain(size, size);
+	std::vector<std::uint32_t> order(terrain.TriangleCount());
+	for (std::uint32_t t = 0; t < order.size(); ++t)
+		order[t] = t;
+	std::shuffle(order.begin(), order.end(), std::mt19937(20));
+	std::vector<std::uint32_t> indices;
+	for (std::uint32_t t : order)
+		indices.insert(indices.end(), terrain.Indices.begin() + 3 * t, terrain.Indices.begin() + 3 * t + 3);
+	terrain.Indices = indices;
+	Run("shuffled terrain", terrain, repeatCount);
+
+	return 0;
+}
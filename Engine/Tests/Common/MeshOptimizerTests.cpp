@@ -0,0 +1,227 @@
+#include "Engine.h"
+#include "Common/MeshOptimizer.h"
+#include "Test.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+	const size_t Stride = 6 * sizeof(float);
+
+	using Corner = std::array<float, 6>;
+	using Triangle = std::array<Corner, 3>;
+
+	// Every triangle by the vertices it is made of, each rotated to start at its smallest
+	// corner, so reordered and renumbered meshes compare equal when they draw the same.
+	std::vector<Triangle> Triangles(const TextModel& model)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i < model.Indices.size(); i += 3)
+		{
+			Triangle t;
+			for (size_t k = 0; k < 3; ++k)
+				std::copy_n(&model.Vertices[6 * (size_t)model.Indices[i + k]], 6, t[k].begin());
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	TextModel Shuffled(TextModel model, std::uint32_t seed)
+	{
+		std::vector<std::uint32_t> order(model.TriangleCount());
+		for (std::uint32_t t = 0; t < order.size(); ++t)
+			order[t] = t;
+		std::mt19937 rng(seed);
+		std::shuffle(order.begin(), order.end(), rng);
+
+		std::vector<std::uint32_t> indices;
+		for (std::uint32_t t : order)
+			indices.insert(indices.end(), model.Indices.begin() + 3 * t, model.Indices.begin() + 3 * t + 3);
+		model.Indices = indices;
+		return model;
+	}
+
+	bool LoadModel(const std::string& name, TextModel& model)
+	{
+		std::vector<std::uint8_t> bytes = TempDirectory::Read(
+			(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (name + ".txt")).wstring());
+		return TextModel::Parse(std::string(bytes.begin(), bytes.end()), model);
+	}
+
+	VertexCacheStats Analyze(const TextModel& model)
+	{
+		return MeshOptimizer::AnalyzeVertexCache(model.Indices.data(), model.Indices.size(), model.VertexCount());
+	}
+}
+
+TEST(MeshOptimizer, AnalyzeVertexCacheSimulatesAFifo)
+{
+	// One triangle, then the same one again from the cache.
+	std::vector<std::uint32_t> indices = { 0, 1, 2, 2, 1, 0 };
+	VertexCacheStats stats = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), 5);
+	CHECK_EQ(stats.TriangleCount, 2u);
+	CHECK_EQ(stats.VertexCount, 3u);
+	CHECK_EQ(stats.TransformCount, 3u);
+	CHECK_NEAR(stats.Acmr, 1.5f, 1e-6f);
+	CHECK_NEAR(stats.Atvr, 1.0f, 1e-6f);
+
+	// Hits do not move a vertex to the front: 0 is the oldest entry and is pushed out by 3,
+	// and every later miss pushes out the vertex needed next.
+	indices = { 0, 1, 2, 0, 1, 3, 0, 1, 2 };
+	stats = MeshOptimizer::AnalyzeVertexCache(indices.data(), indices.size(), 4, 3);
+	CHECK_EQ(stats.TransformCount, 7u);
+	CHECK_EQ(stats.VertexCount, 4u);
+	CHECK_NEAR(stats.Atvr, 1.75f, 1e-6f);
+
+	stats = MeshOptimizer::AnalyzeVertexCache(nullptr, 0, 0);
+	CHECK_EQ(stats.TransformCount, 0u);
+	CHECK_EQ(stats.Acmr, 0.0f);
+}
+
+TEST(MeshOptimizer, VertexCacheOrderKeepsTheTriangles)
+{
+	const TextModel grid = TextModel::Terrain(64, 64);
+	for (std::uint32_t seed : { 1u, 2u })
+	{
+		TextModel model = Shuffled(grid, seed);
+		const std::vector<Triangle> expected = Triangles(model);
+		const VertexCacheStats before = Analyze(model);
+
+		std::vector<std::uint32_t> clusterStarts;
+		MeshOptimizer::OptimizeVertexCache(model.Indices.data(), model.Indices.size(), model.VertexCount(),
+			MeshOptimizer::DefaultCacheSize, &clusterStarts);
+		CHECK(Triangles(model) == expected);
+
+		// A shuffled grid transforms nearly every corner, a Tipsify order about one vertex
+		// per triangle pair.
+		VertexCacheStats after = Analyze(model);
+		CHECK_GT(before.Acmr, 2.0f);
+		CHECK_LT(after.Acmr, 0.8f);
+		CHECK_EQ(after.VertexCount, before.VertexCount);
+
+		REQUIRE(!clusterStarts.empty());
+		CHECK_EQ(clusterStarts[0], 0u);
+		bool increasing = true;
+		for (size_t c = 1; c < clusterStarts.size(); ++c)
+			increasing = increasing && clusterStarts[c - 1] < clusterStarts[c];
+		CHECK(increasing);
+		CHECK_LT(clusterStarts.back(), model.TriangleCount());
+	}
+
+	// Nothing to reorder.
+	std::vector<std::uint32_t> clusterStarts = { 7 };
+	MeshOptimizer::OptimizeVertexCache(nullptr, 0, 0, MeshOptimizer::DefaultCacheSize, &clusterStarts);
+	CHECK(clusterStarts.empty());
+}
+
+TEST(MeshOptimizer, OverdrawOrderDrawsOutwardClustersFirst)
+{
+	// Two clusters of one triangle: the first sits at x = 1 facing the center, the second
+	// at x = -1 facing away from it.
+	TextModel model;
+	model.Vertices = {
+		1, 0, 0, 0, 0, 0,   1, 0, 1, 0, 0, 0,   1, 1, 0, 0, 0, 0,
+		-1, 0, 0, 0, 0, 0,  -1, 0, 1, 0, 0, 0,  -1, 1, 0, 0, 0, 0 };
+	model.Indices = { 0, 1, 2, 3, 4, 5 };
+	MeshOptimizer::OptimizeOverdraw(model.Indices.data(), model.Indices.size(), model.Vertices.data(), Stride, { 0, 1 });
+	CHECK(model.Indices == std::vector<std::uint32_t>({ 3, 4, 5, 0, 1, 2 }));
+
+	// Clusters move as a whole and keep their order inside.
+	TextModel grid = Shuffled(TextModel::Terrain(32, 32), 3);
+	std::vector<std::uint32_t> clusterStarts;
+	MeshOptimizer::OptimizeVertexCache(grid.Indices.data(), grid.Indices.size(), grid.VertexCount(),
+		MeshOptimizer::DefaultCacheSize, &clusterStarts);
+	const std::vector<std::uint32_t> cacheOrder = grid.Indices;
+	MeshOptimizer::OptimizeOverdraw(grid.Indices.data(), grid.Indices.size(), grid.Vertices.data(), Stride,
+		clusterStarts);
+
+	std::uint32_t moved = 0;
+	for (size_t c = 0; c < clusterStarts.size(); ++c)
+	{
+		size_t begin = 3 * (size_t)clusterStarts[c];
+		size_t end = c + 1 < clusterStarts.size() ? 3 * (size_t)clusterStarts[c + 1] : cacheOrder.size();
+		auto found = std::search(grid.Indices.begin(), grid.Indices.end(), cacheOrder.begin() + begin,
+			cacheOrder.begin() + end);
+		moved += found == grid.Indices.end() || (found - grid.Indices.begin()) % 3 != 0;
+	}
+	CHECK_EQ(moved, 0u);
+	CHECK(Triangles(grid) == Triangles(Shuffled(TextModel::Terrain(32, 32), 3)));
+}
+
+TEST(MeshOptimizer, VertexFetchOrderFollowsFirstUse)
+{
+	TextModel model = Shuffled(TextModel::Terrain(16, 16), 4);
+	// One vertex no triangle uses, it moves behind the used ones.
+	model.Vertices.insert(model.Vertices.end(), { 100, 100, 100, 0, 1, 0 });
+	const std::vector<Triangle> expected = Triangles(model);
+	const VertexCacheStats before = Analyze(model);
+
+	MeshOptimizer::OptimizeVertexFetch(model.Vertices.data(), Stride, model.VertexCount(), model.Indices.data(),
+		model.Indices.size());
+	CHECK(Triangles(model) == expected);
+
+	std::uint32_t next = 0;
+	std::uint32_t outOfOrder = 0;
+	for (std::uint32_t index : model.Indices)
+	{
+		outOfOrder += index > next;
+		next = std::max(next, index + 1);
+	}
+	CHECK_EQ(outOfOrder, 0u);
+	CHECK_EQ(next, model.VertexCount() - 1);
+	CHECK_EQ(model.Vertices[6 * (size_t)next], 100.0f);
+
+	// Renumbering does not change what the cache sees.
+	CHECK_EQ(Analyze(model).TransformCount, before.TransformCount);
+}
+
+TEST(MeshOptimizer, OptimizeNeverLosesToTheInputOrder)
+{
+	TextModel grid = Shuffled(TextModel::Terrain(48, 48), 5);
+	const std::vector<Triangle> expected = Triangles(grid);
+	MeshOptimizer::Result result = MeshOptimizer::Optimize(grid.Vertices.data(), Stride, grid.VertexCount(),
+		grid.Indices.data(), grid.Indices.size());
+	CHECK(Triangles(grid) == expected);
+	CHECK_EQ(result.After.TransformCount, Analyze(grid).TransformCount);
+	CHECK_LT(result.After.Acmr, result.Before.Acmr * 0.5f);
+
+	// The overdraw order may only cost a few percent over the cache order alone.
+	TextModel cacheOrdered = Shuffled(TextModel::Terrain(48, 48), 5);
+	MeshOptimizer::Result cacheOnly = MeshOptimizer::Optimize(cacheOrdered.Vertices.data(), Stride,
+		cacheOrdered.VertexCount(), cacheOrdered.Indices.data(), cacheOrdered.Indices.size(), false);
+	CHECK_LE(result.After.Acmr, cacheOnly.After.Acmr * MeshOptimizer::OverdrawAcmrThreshold);
+
+	// A second pass finds nothing better.
+	const std::uint32_t transforms = result.After.TransformCount;
+	result = MeshOptimizer::Optimize(grid.Vertices.data(), Stride, grid.VertexCount(), grid.Indices.data(),
+		grid.Indices.size());
+	CHECK_EQ(result.Before.TransformCount, transforms);
+	CHECK_LE(result.After.Acmr, result.Before.Acmr * MeshOptimizer::OverdrawAcmrThreshold);
+	CHECK(Triangles(grid) == expected);
+}
+
+TEST(MeshOptimizer, ShippedModelsKeepTheirTriangles)
+{
+	for (const char* name : { "car", "skull" })
+	{
+		TextModel model;
+		REQUIRE(LoadModel(name, model));
+		const std::vector<Triangle> expected = Triangles(model);
+		const VertexCacheStats input = Analyze(model);
+
+		MeshOptimizer::Result result = MeshOptimizer::Optimize(model.Vertices.data(), Stride, model.VertexCount(),
+			model.Indices.data(), model.Indices.size());
+		CHECK_MSG(Triangles(model) == expected, name);
+		CHECK_EQ(result.Before.TransformCount, input.TransformCount);
+		CHECK_MSG(result.After.Acmr <= result.Before.Acmr * MeshOptimizer::OverdrawAcmrThreshold,
+			name << ": ACMR " << result.Before.Acmr << " -> " << result.After.Acmr);
+		CHECK_EQ(result.After.VertexCount, result.Before.VertexCount);
+	}
+}
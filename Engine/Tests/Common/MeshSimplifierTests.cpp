@@ -0,0 +1,332 @@
+#include "Engine.h"
+#include "Common/MeshSimplifier.h"
+#include "SurfaceDistance.h"
+#include "Test.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <map>
+#include <set>
+
+namespace
+{
+	// Position, normal and texture coordinates.
+	const std::uint32_t FloatCount = 8;
+	const size_t Stride = FloatCount * sizeof(float);
+
+	struct Mesh
+	{
+		std::vector<float> Vertices;
+		std::vector<std::uint32_t> Indices;
+
+		std::uint32_t VertexCount() const
+		{
+			return (std::uint32_t)(Vertices.size() / FloatCount);
+		}
+
+		const float* Position(std::uint32_t v) const
+		{
+			return &Vertices[FloatCount * (size_t)v];
+		}
+	};
+
+	// Unit sphere of rings around the y axis.  With a seam, the first column of every ring
+	// is repeated with u = 1, like a textured sphere, otherwise every position is one vertex.
+	Mesh Sphere(std::uint32_t slices, std::uint32_t stacks, bool seam)
+	{
+		const float pi = 3.14159265f;
+		Mesh mesh;
+		auto add = [&mesh](float x, float y, float z, float u, float v)
+		{
+			mesh.Vertices.insert(mesh.Vertices.end(), { x, y, z, x, y, z, u, v });
+		};
+
+		std::uint32_t columns = seam ? slices + 1 : slices;
+		mesh.Vertices.reserve(FloatCount * (2 + (size_t)(stacks - 1) * columns));
+		add(0, 1, 0, 0, 0);
+		for (std::uint32_t i = 1; i < stacks; ++i)
+		{
+			float phi = pi * i / stacks;
+			for (std::uint32_t j = 0; j < columns; ++j)
+			{
+				float theta = 2.0f * pi * (j % slices) / slices;
+				add(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta),
+					(float)j / slices, (float)i / stacks);
+			}
+		}
+		add(0, -1, 0, 0, 1);
+
+		std::uint32_t south = mesh.VertexCount() - 1;
+		auto ring = [columns](std::uint32_t i, std::uint32_t j) { return 1 + (i - 1) * columns + j; };
+		auto next = [seam, slices](std::uint32_t j) { return seam ? j + 1 : (j + 1) % slices; };
+		for (std::uint32_t j = 0; j < slices; ++j)
+		{
+			mesh.Indices.insert(mesh.Indices.end(), { 0, ring(1, next(j)), ring(1, j) });
+			mesh.Indices.insert(mesh.Indices.end(), { south, ring(stacks - 1, j), ring(stacks - 1, next(j)) });
+		}
+		for (std::uint32_t i = 1; i + 1 < stacks; ++i)
+		{
+			for (std::uint32_t j = 0; j < slices; ++j)
+			{
+				std::uint32_t a = ring(i, j), b = ring(i, next(j)), c = ring(i + 1, j), d = ring(i + 1, next(j));
+				mesh.Indices.insert(mesh.Indices.end(), { a, b, c, c, b, d });
+			}
+		}
+		return mesh;
+	}
+
+	// Height field with an open border, flat if height is 0.
+	Mesh Grid(std::uint32_t size, float height)
+	{
+		TextModel terrain = TextModel::Terrain(size, size);
+		Mesh mesh;
+		for (size_t v = 0; v < terrain.Vertices.size(); v += 6)
+		{
+			const float* p = &terrain.Vertices[v];
+			mesh.Vertices.insert(mesh.Vertices.end(), { p[0], p[1] * height, p[2], p[3], p[4], p[5], p[0] / size, p[2] / size });
+		}
+		mesh.Indices = terrain.Indices;
+		return mesh;
+	}
+
+	std::vector<std::uint32_t> Level(const std::vector<std::uint32_t>& lodIndices, const MeshLod& lod)
+	{
+		return std::vector<std::uint32_t>(lodIndices.begin() + lod.FirstIndex,
+			lodIndices.begin() + lod.FirstIndex + lod.IndexCount);
+	}
+
+	// Largest distance between two surfaces made of the same vertices: from every vertex of
+	// one to the other, and from the centroid and edge midpoints of every triangle of the
+	// other to the first.
+	float MeasuredDistance(const Mesh& mesh, const std::vector<std::uint32_t>& full,
+		const std::vector<std::uint32_t>& level, float maxDistance)
+	{
+		SurfaceDistance fullSurface(mesh.Vertices.data(), Stride, full.data(), full.size());
+		SurfaceDistance levelSurface(mesh.Vertices.data(), Stride, level.data(), level.size());
+
+		float worst = 0.0f;
+		for (std::uint32_t v : full)
+			worst = std::max(worst, levelSurface.Distance(SurfaceDistance::Position(mesh.Vertices.data(), Stride, v), maxDistance));
+		for (size_t i = 0; i < level.size(); i += 3)
+		{
+			SurfaceDistance::Float3 p[3];
+			for (int k = 0; k < 3; ++k)
+				p[k] = SurfaceDistance::Position(mesh.Vertices.data(), Stride, level[i + k]);
+			for (int k = 0; k < 4; ++k)
+			{
+				// Centroid, then the midpoints of the three edges.
+				const SurfaceDistance::Float3& a = k == 0 ? p[0] : p[k - 1];
+				const SurfaceDistance::Float3& b = k == 0 ? p[1] : p[k % 3];
+				SurfaceDistance::Float3 sample = k == 0 ?
+					SurfaceDistance::Float3{ (p[0].X + p[1].X + p[2].X) / 3, (p[0].Y + p[1].Y + p[2].Y) / 3, (p[0].Z + p[1].Z + p[2].Z) / 3 } :
+					SurfaceDistance::Float3{ (a.X + b.X) / 2, (a.Y + b.Y) / 2, (a.Z + b.Z) / 2 };
+				worst = std::max(worst, fullSurface.Distance(sample, maxDistance));
+			}
+		}
+		return worst;
+	}
+
+	std::set<std::uint32_t> UsedVertices(const std::vector<std::uint32_t>& indices)
+	{
+		return std::set<std::uint32_t>(indices.begin(), indices.end());
+	}
+
+	// Triangles whose normal points away from the origin, and directed edges without a
+	// twin in the opposite direction.
+	std::pair<std::uint32_t, std::uint32_t> InwardAndOpenEdges(const Mesh& mesh, const std::vector<std::uint32_t>& indices)
+	{
+		std::uint32_t inward = 0;
+		std::map<std::pair<std::uint32_t, std::uint32_t>, int> edges;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const float* a = mesh.Position(indices[i]);
+			const float* b = mesh.Position(indices[i + 1]);
+			const float* c = mesh.Position(indices[i + 2]);
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			inward += n[0] * (a[0] + b[0] + c[0]) + n[1] * (a[1] + b[1] + c[1]) + n[2] * (a[2] + b[2] + c[2]) <= 0.0f;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t from = indices[i + k], to = indices[i + (k + 1) % 3];
+				edges[{ std::min(from, to), std::max(from, to) }] += from < to ? 1 : -1;
+			}
+		}
+
+		std::uint32_t open = 0;
+		for (const auto& edge : edges)
+			open += edge.second != 0;
+		return { inward, open };
+	}
+
+	float Area(const Mesh& mesh, const std::vector<std::uint32_t>& indices, float& minNormalY)
+	{
+		double area = 0.0;
+		minNormalY = 1.0f;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			const float* a = mesh.Position(indices[i]);
+			const float* b = mesh.Position(indices[i + 1]);
+			const float* c = mesh.Position(indices[i + 2]);
+			float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			area += 0.5 * length;
+			minNormalY = std::min(minNormalY, length > 0.0f ? n[1] / length : -1.0f);
+		}
+		return (float)area;
+	}
+}
+
+TEST(MeshSimplifier, ErrorBoundsTheMeasuredDistance)
+{
+	std::vector<std::pair<std::string, Mesh>> meshes;
+	meshes.push_back({ "sphere", Sphere(48, 24, false) });
+	meshes.push_back({ "textured sphere", Sphere(48, 24, true) });
+	meshes.push_back({ "terrain", Grid(48, 1.0f) });
+
+	// The car with the layout of the text models, texture coordinates left at zero.
+	TextModel car;
+	std::vector<std::uint8_t> bytes = TempDirectory::Read(
+		(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / "car.txt").wstring());
+	REQUIRE(TextModel::Parse(std::string(bytes.begin(), bytes.end()), car));
+	Mesh carMesh;
+	for (size_t v = 0; v < car.Vertices.size(); v += 6)
+		carMesh.Vertices.insert(carMesh.Vertices.end(), { car.Vertices[v], car.Vertices[v + 1], car.Vertices[v + 2],
+			car.Vertices[v + 3], car.Vertices[v + 4], car.Vertices[v + 5], 0, 0 });
+	carMesh.Indices = car.Indices;
+	meshes.push_back({ "car", carMesh });
+
+	for (const auto& [name, mesh] : meshes)
+	{
+		std::vector<std::uint32_t> lodIndices;
+		std::vector<MeshLod> lods = MeshSimplifier::BuildLodChain(mesh.Vertices.data(), Stride, mesh.VertexCount(),
+			mesh.Indices.data(), mesh.Indices.size(), { { 3 * sizeof(float), 3, 0.5f } }, lodIndices);
+		MeshSimplifier simplifier(mesh.Vertices.data(), Stride, mesh.VertexCount());
+		const float maxError = MeshSimplifier::MaxLodError * simplifier.Extent();
+
+		REQUIRE(lods.size() >= 2);
+		CHECK_EQ(lods[0].IndexCount, (std::uint32_t)mesh.Indices.size());
+		CHECK_EQ(lods[0].Error, 0.0f);
+		CHECK(Level(lodIndices, lods[0]) == mesh.Indices);
+		for (size_t i = 1; i < lods.size(); ++i)
+		{
+			std::vector<std::uint32_t> level = Level(lodIndices, lods[i]);
+			float measured = MeasuredDistance(mesh, mesh.Indices, level, simplifier.Extent());
+			CHECK_MSG(measured <= lods[i].Error * 1.0001f + 1e-6f,
+				name << " LOD " << i << ": error " << lods[i].Error << ", measured " << measured);
+			CHECK_MSG(lods[i].Error <= maxError, name << " LOD " << i << ": error " << lods[i].Error);
+			CHECK_MSG(lods[i].Error >= lods[i - 1].Error, name << " LOD " << i);
+			CHECK_MSG(lods[i].IndexCount * 10 <= lods[i - 1].IndexCount * 9, name << " LOD " << i);
+			CHECK_EQ(lods[i].FirstIndex, lods[i - 1].FirstIndex + lods[i - 1].IndexCount);
+		}
+		CHECK_EQ((size_t)lods.back().FirstIndex + lods.back().IndexCount, lodIndices.size());
+	}
+}
+
+TEST(MeshSimplifier, LevelsAreNestedAndStayClosed)
+{
+	const Mesh sphere = Sphere(64, 32, false);
+	REQUIRE(InwardAndOpenEdges(sphere, sphere.Indices) == std::make_pair(0u, 0u));
+
+	std::vector<std::uint32_t> lodIndices;
+	std::vector<MeshLod> lods = MeshSimplifier::BuildLodChain(sphere.Vertices.data(), Stride, sphere.VertexCount(),
+		sphere.Indices.data(), sphere.Indices.size(), {}, lodIndices);
+	REQUIRE(lods.size() > (size_t)2);
+
+	for (size_t i = 1; i < lods.size(); ++i)
+	{
+		std::vector<std::uint32_t> level = Level(lodIndices, lods[i]);
+		auto [inward, open] = InwardAndOpenEdges(sphere, level);
+		CHECK_MSG(inward == 0, "LOD " << i << ": " << inward << " triangles turned inside out");
+		CHECK_MSG(open == 0, "LOD " << i << ": " << open << " edges without a twin");
+
+		// Vertices only collapse onto neighbours, so each level uses a subset of the vertices
+		// of the previous one.
+		std::set<std::uint32_t> used = UsedVertices(level);
+		std::set<std::uint32_t> previous = UsedVertices(Level(lodIndices, lods[i - 1]));
+		CHECK_MSG(std::includes(previous.begin(), previous.end(), used.begin(), used.end()), "LOD " << i);
+	}
+}
+
+TEST(MeshSimplifier, FlatRegionsCollapseWithoutError)
+{
+	const Mesh grid = Grid(32, 0.0f);
+	float minNormalY = 0.0f;
+	const float area = Area(grid, grid.Indices, minNormalY);
+	REQUIRE(minNormalY > 0.99f);
+
+	MeshSimplifier simplifier(grid.Vertices.data(), Stride, grid.VertexCount());
+	simplifier.Reset(grid.Indices.data(), grid.Indices.size());
+	simplifier.Simplify(0, 0.0f);
+	const std::vector<std::uint32_t>& indices = simplifier.Indices();
+	CHECK_LE(simplifier.Error(), 1e-5f);
+	CHECK_LT(indices.size() * 4, grid.Indices.size());
+
+	// The plane is still covered once, facing up.
+	CHECK_NEAR(Area(grid, indices, minNormalY), area, area * 1e-4f);
+	CHECK_GT(minNormalY, 0.99f);
+
+	// Every vertex of the open border is kept.
+	std::set<std::uint32_t> used = UsedVertices(indices);
+	std::uint32_t missing = 0;
+	for (std::uint32_t v = 0; v < grid.VertexCount(); ++v)
+	{
+		const float* p = grid.Position(v);
+		bool border = p[0] == 0.0f || p[0] == 32.0f || p[2] == 0.0f || p[2] == 32.0f;
+		missing += border && used.count(v) == 0;
+	}
+	CHECK_EQ(missing, 0u);
+}
+
+TEST(MeshSimplifier, CurvedSurfacesNeedAnErrorBudget)
+{
+	const Mesh sphere = Sphere(32, 16, false);
+	MeshSimplifier simplifier(sphere.Vertices.data(), Stride, sphere.VertexCount());
+	simplifier.Reset(sphere.Indices.data(), sphere.Indices.size());
+
+	// Every collapse moves a curved surface, none fits in no budget at all.
+	simplifier.Simplify(0, 0.0f);
+	CHECK(simplifier.Indices() == sphere.Indices);
+	CHECK_LE(simplifier.Error(), 1e-6f);
+
+	// A small budget stops well before the target, a larger one gets further.
+	simplifier.Simplify(0, 0.01f);
+	size_t small = simplifier.Indices().size();
+	CHECK_GT(small, (size_t)0);
+	CHECK_LT(small, sphere.Indices.size());
+	simplifier.Simplify(0, 0.1f);
+	CHECK_LT(simplifier.Indices().size(), small);
+	CHECK_GT(simplifier.Error(), 0.0f);
+	CHECK_LE(simplifier.Error(), 0.2f);
+
+	// Reset starts over from the full mesh.
+	simplifier.Reset(sphere.Indices.data(), sphere.Indices.size());
+	CHECK(simplifier.Indices() == sphere.Indices);
+	CHECK_EQ(simplifier.Error(), 0.0f);
+}
+
+TEST(MeshSimplifier, SeamVerticesAreKept)
+{
+	const Mesh sphere = Sphere(48, 24, true);
+	std::vector<std::uint32_t> lodIndices;
+	std::vector<MeshLod> lods = MeshSimplifier::BuildLodChain(sphere.Vertices.data(), Stride, sphere.VertexCount(),
+		sphere.Indices.data(), sphere.Indices.size(), { { 6 * sizeof(float), 2, 1.0f } }, lodIndices);
+	REQUIRE(lods.size() > (size_t)1);
+
+	// Both copies of every seam vertex survive in every level, so the texture does not tear.
+	std::set<std::uint32_t> used = UsedVertices(Level(lodIndices, lods.back()));
+	std::uint32_t missing = 0;
+	for (std::uint32_t v = 0; v < sphere.VertexCount(); ++v)
+	{
+		const float u = sphere.Vertices[FloatCount * (size_t)v + 6];
+		bool onSeam = v != 0 && v + 1 != sphere.VertexCount() && (u == 0.0f || u == 1.0f);
+		missing += onSeam && used.count(v) == 0;
+	}
+	CHECK_EQ(missing, 0u);
+}
@@ -0,0 +1,117 @@
+#include "Engine.h"
+#include "Common/MeshOptimizer.h"
+#include "Common/Meshlets.h"
+#include "Benchmark.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <cmath>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+	const size_t Stride = 6 * sizeof(float);
+
+	struct Camera
+	{
+		float Position[3];
+		float Planes[6][4];
+	};
+
+	// 90 degree frustum looking at the origin from a random direction.
+	Camera RandomCamera(std::mt19937& rng, float distance)
+	{
+		std::normal_distribution<float> normal;
+		float d[3] = { normal(rng), normal(rng), normal(rng) };
+		float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+
+		Camera camera;
+		float f[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			camera.Position[k] = d[k] / length * distance;
+			f[k] = -d[k] / length;
+		}
+		float r[3] = { f[2], 0.0f, -f[0] };
+		length = std::sqrt(r[0] * r[0] + r[2] * r[2]);
+		r[0] /= length;
+		r[2] /= length;
+		float u[3] = { f[1] * r[2] - f[2] * r[1], f[2] * r[0] - f[0] * r[2], f[0] * r[1] - f[1] * r[0] };
+
+		auto setPlane = [&camera](int p, float x, float y, float z, float w)
+		{
+			camera.Planes[p][0] = x;
+			camera.Planes[p][1] = y;
+			camera.Planes[p][2] = z;
+			camera.Planes[p][3] = w - (x * camera.Position[0] + y * camera.Position[1] + z * camera.Position[2]);
+		};
+		const float s = std::sqrt(0.5f);
+		setPlane(0, f[0], f[1], f[2], -0.1f);
+		setPlane(1, -f[0], -f[1], -f[2], 4.0f * distance);
+		setPlane(2, s * (r[0] + f[0]), s * (r[1] + f[1]), s * (r[2] + f[2]), 0.0f);
+		setPlane(3, s * (f[0] - r[0]), s * (f[1] - r[1]), s * (f[2] - r[2]), 0.0f);
+		setPlane(4, s * (u[0] + f[0]), s * (u[1] + f[1]), s * (u[2] + f[2]), 0.0f);
+		setPlane(5, s * (f[0] - u[0]), s * (f[1] - u[1]), s * (f[2] - u[2]), 0.0f);
+		return camera;
+	}
+}
+
+// Splits the skull into meshlets and culls them from random viewpoints around it, close
+// enough that part of it is outside the frustum.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 10;
+	const int viewCount = quick ? 64 : 4096;
+
+	std::vector<std::uint8_t> bytes = TempDirectory::Read(
+		(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / "skull.txt").wstring());
+	TextModel model;
+	if (!TextModel::Parse(std::string(bytes.begin(), bytes.end()), model))
+	{
+		std::printf("skull: cannot parse\n");
+		return 1;
+	}
+	MeshOptimizer::OptimizeVertexCache(model.Indices.data(), model.Indices.size(), model.VertexCount());
+
+	std::vector<Meshlet> meshlets;
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			TextModel copy = model;
+			meshlets = MeshletBuilder::Build(copy.Vertices.data(), Stride, copy.VertexCount(), copy.Indices.data(),
+				copy.Indices.size());
+		});
+	std::printf("skull: %u triangles, %zu meshlets\n", model.TriangleCount(), meshlets.size());
+	Benchmark::Report("MeshletBuilder::Build", ms, model.TriangleCount());
+
+	MeshletCuller culler(meshlets);
+	std::mt19937 rng(22);
+	std::vector<Camera> cameras;
+	for (int view = 0; view < viewCount; ++view)
+		cameras.push_back(RandomCamera(rng, view % 2 == 0 ? 8.0f : 20.0f));
+
+	std::vector<IndexRange> ranges;
+	for (bool backfaceCulling : { false, true })
+	{
+		std::uint64_t visibleCount = 0;
+		size_t rangeCount = 0;
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				visibleCount = 0;
+				rangeCount = 0;
+				for (const Camera& camera : cameras)
+				{
+					visibleCount += culler.Cull(camera.Planes, camera.Position, backfaceCulling, ranges);
+					rangeCount += ranges.size();
+				}
+			});
+		Benchmark::Report(backfaceCulling ? "MeshletCuller::Cull, frustum and cone" : "MeshletCuller::Cull, frustum",
+			ms, (double)viewCount * meshlets.size());
+		std::printf("  %.1f%% visible in %.1f ranges per view, %.2f us per view\n",
+			100.0 * visibleCount / ((double)viewCount * meshlets.size()), (double)rangeCount / viewCount,
+			ms * 1000.0 / viewCount);
+	}
+
+	return 0;
+}
@@ -0,0 +1,345 @@
+#include "Engine.h"
+#include "Common/Meshlets.h"
+#include "Test.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <filesystem>
+#include <random>
+#include <set>
+
+namespace
+{
+	const size_t Stride = 6 * sizeof(float);
+
+	using Triangle = std::array<std::uint32_t, 3>;
+
+	std::vector<Triangle> Triangles(const std::vector<std::uint32_t>& indices)
+	{
+		std::vector<Triangle> triangles;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			Triangle t = { indices[i], indices[i + 1], indices[i + 2] };
+			std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+			triangles.push_back(t);
+		}
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	bool LoadModel(const std::string& name, TextModel& model)
+	{
+		std::vector<std::uint8_t> bytes = TempDirectory::Read(
+			(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (name + ".txt")).wstring());
+		return TextModel::Parse(std::string(bytes.begin(), bytes.end()), model);
+	}
+
+	float Dot(const float* a, const float* b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	// Same winding as the builder: the cross product of the first two edges.
+	void Normal(const TextModel& model, const std::uint32_t* tri, float* n)
+	{
+		const float* p0 = &model.Vertices[6 * (size_t)tri[0]];
+		const float* p1 = &model.Vertices[6 * (size_t)tri[1]];
+		const float* p2 = &model.Vertices[6 * (size_t)tri[2]];
+		float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+	}
+
+	struct Camera
+	{
+		float Position[3];
+		float Planes[6][4];
+	};
+
+	// Perspective frustum with normals pointing inwards, looking from a random point at
+	// distance around the origin towards a random point near it.
+	Camera RandomCamera(std::mt19937& rng, float distance, float spread)
+	{
+		std::normal_distribution<float> normal;
+		std::uniform_real_distribution<float> offset(-spread, spread);
+		std::uniform_real_distribution<float> halfAngle(0.2f, 0.7f);
+
+		Camera camera;
+		float d[3] = { normal(rng), normal(rng), normal(rng) };
+		float length = std::sqrt(Dot(d, d));
+		float target[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			camera.Position[k] = d[k] / length * distance;
+			target[k] = offset(rng);
+		}
+
+		float f[3] = { target[0] - camera.Position[0], target[1] - camera.Position[1], target[2] - camera.Position[2] };
+		length = std::sqrt(Dot(f, f));
+		for (float& c : f)
+			c /= length;
+		float up[3] = { 0.0f, 1.0f, 0.0f };
+		float r[3] = { up[1] * f[2] - up[2] * f[1], up[2] * f[0] - up[0] * f[2], up[0] * f[1] - up[1] * f[0] };
+		length = std::sqrt(Dot(r, r));
+		for (float& c : r)
+			c /= length;
+		float u[3] = { f[1] * r[2] - f[2] * r[1], f[2] * r[0] - f[0] * r[2], f[0] * r[1] - f[1] * r[0] };
+
+		auto setPlane = [&camera](int p, const float* n, float w)
+		{
+			camera.Planes[p][0] = n[0];
+			camera.Planes[p][1] = n[1];
+			camera.Planes[p][2] = n[2];
+			camera.Planes[p][3] = w - Dot(n, camera.Position);
+		};
+		float nearZ = 0.1f * distance;
+		float farZ = 2.0f * distance;
+		float back[3] = { -f[0], -f[1], -f[2] };
+		setPlane(0, f, -nearZ);
+		setPlane(1, back, farZ);
+
+		float x = halfAngle(rng), y = halfAngle(rng);
+		for (int side = 0; side < 2; ++side)
+		{
+			float s = side == 0 ? 1.0f : -1.0f;
+			float nx[3], ny[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				nx[k] = s * std::cos(x) * r[k] + std::sin(x) * f[k];
+				ny[k] = s * std::cos(y) * u[k] + std::sin(y) * f[k];
+			}
+			setPlane(2 + side, nx, 0.0f);
+			setPlane(4 + side, ny, 0.0f);
+		}
+		return camera;
+	}
+
+	// The culler's tests written out one meshlet at a time.
+	std::vector<std::uint32_t> CullScalar(const std::vector<Meshlet>& meshlets, const Camera& camera, bool backfaceCulling)
+	{
+		std::vector<std::uint32_t> visible;
+		for (std::uint32_t i = 0; i < meshlets.size(); ++i)
+		{
+			const Meshlet& m = meshlets[i];
+			bool inside = true;
+			for (const float* plane : camera.Planes)
+			{
+				float distance = (plane[0] * m.Center[0] + plane[1] * m.Center[1]) + (plane[2] * m.Center[2] + plane[3]);
+				inside = inside && distance >= -m.Radius;
+			}
+			if (inside && backfaceCulling)
+			{
+				float d[3] = { m.Center[0] - camera.Position[0], m.Center[1] - camera.Position[1], m.Center[2] - camera.Position[2] };
+				float length = std::sqrt((d[0] * d[0] + d[1] * d[1]) + d[2] * d[2]);
+				float dot = (d[0] * m.ConeAxis[0] + d[1] * m.ConeAxis[1]) + d[2] * m.ConeAxis[2];
+				inside = !(dot >= m.ConeCutoff * length + m.Radius);
+			}
+			if (inside)
+				visible.push_back(i);
+		}
+		return visible;
+	}
+
+	// Ranges of the given meshlets with adjacent ones merged, as Cull writes them.
+	std::vector<IndexRange> Merged(const std::vector<Meshlet>& meshlets, const std::vector<std::uint32_t>& visible)
+	{
+		std::vector<IndexRange> ranges;
+		for (std::uint32_t i : visible)
+		{
+			if (!ranges.empty() && ranges.back().FirstIndex + ranges.back().IndexCount == meshlets[i].FirstIndex)
+				ranges.back().IndexCount += meshlets[i].IndexCount;
+			else
+				ranges.push_back({ meshlets[i].FirstIndex, meshlets[i].IndexCount });
+		}
+		return ranges;
+	}
+
+	bool SameRanges(const std::vector<IndexRange>& a, const std::vector<IndexRange>& b)
+	{
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const IndexRange& x, const IndexRange& y)
+			{
+				return x.FirstIndex == y.FirstIndex && x.IndexCount == y.IndexCount;
+			});
+	}
+}
+
+TEST(Meshlets, BuildPartitionsTheTriangles)
+{
+	TextModel skull;
+	REQUIRE(LoadModel("skull", skull));
+	const TextModel terrain = TextModel::Terrain(64, 64);
+
+	struct Limits
+	{
+		std::uint32_t Vertices;
+		std::uint32_t Triangles;
+	};
+	for (const TextModel* source : { &terrain, (const TextModel*)&skull })
+	{
+		for (Limits limits : { Limits{ MeshletBuilder::MaxVertices, MeshletBuilder::MaxTriangles }, Limits{ 16, 8 }, Limits{ 3, 1 } })
+		{
+			TextModel model = *source;
+			std::vector<Meshlet> meshlets = MeshletBuilder::Build(model.Vertices.data(), Stride, model.VertexCount(),
+				model.Indices.data(), model.Indices.size(), limits.Vertices, limits.Triangles);
+			CHECK(Triangles(model.Indices) == Triangles(source->Indices));
+
+			std::uint32_t next = 0;
+			std::uint32_t overLimit = 0, wrongCount = 0, outsideSphere = 0, outsideCone = 0;
+			for (const Meshlet& m : meshlets)
+			{
+				CHECK_EQ(m.FirstIndex, next);
+				next = m.FirstIndex + m.IndexCount;
+
+				std::set<std::uint32_t> vertices(model.Indices.begin() + m.FirstIndex, model.Indices.begin() + next);
+				overLimit += vertices.size() > limits.Vertices || m.IndexCount > 3 * limits.Triangles || m.IndexCount == 0;
+				wrongCount += vertices.size() != m.VertexCount;
+				for (std::uint32_t v : vertices)
+				{
+					const float* p = &model.Vertices[6 * (size_t)v];
+					float d[3] = { p[0] - m.Center[0], p[1] - m.Center[1], p[2] - m.Center[2] };
+					outsideSphere += std::sqrt(Dot(d, d)) > m.Radius * 1.0001f + 1e-6f;
+				}
+
+				// Every normal is within the cone: the sine of the half angle is the cutoff.
+				if (m.ConeCutoff < 1.0f)
+				{
+					float minDot = std::sqrt(1.0f - m.ConeCutoff * m.ConeCutoff);
+					for (std::uint32_t i = m.FirstIndex; i < next; i += 3)
+					{
+						float n[3];
+						Normal(model, &model.Indices[i], n);
+						float length = std::sqrt(Dot(n, n));
+						outsideCone += length > 0.0f && Dot(n, m.ConeAxis) < (minDot - 1e-4f) * length;
+					}
+				}
+			}
+			CHECK_EQ(next, (std::uint32_t)model.Indices.size());
+			CHECK_EQ(overLimit, 0u);
+			CHECK_EQ(wrongCount, 0u);
+			CHECK_EQ(outsideSphere, 0u);
+			CHECK_EQ(outsideCone, 0u);
+			if (limits.Triangles == 1)
+				CHECK_EQ(meshlets.size(), (size_t)model.TriangleCount());
+			else
+				CHECK_LT(meshlets.size() * limits.Triangles, (size_t)model.TriangleCount() * 3);
+		}
+	}
+
+	// Nothing to split.
+	std::vector<std::uint32_t> none;
+	CHECK(MeshletBuilder::Build(nullptr, Stride, 0, none.data(), 0).empty());
+}
+
+TEST(Meshlets, CullMatchesTheScalarTests)
+{
+	TextModel skull;
+	REQUIRE(LoadModel("skull", skull));
+	std::vector<Meshlet> meshlets = MeshletBuilder::Build(skull.Vertices.data(), Stride, skull.VertexCount(),
+		skull.Indices.data(), skull.Indices.size());
+	// A count that is not a multiple of four leaves padding in the last group.
+	meshlets.resize(meshlets.size() / 4 * 4 + 3);
+	MeshletCuller culler(meshlets);
+	CHECK_EQ(culler.MeshletCount(), (std::uint32_t)meshlets.size());
+
+	std::mt19937 rng(22);
+	std::vector<IndexRange> ranges;
+	std::uint32_t mismatches = 0;
+	for (int view = 0; view < 200; ++view)
+	{
+		Camera camera = RandomCamera(rng, view % 2 == 0 ? 15.0f : 5.0f, 4.0f);
+		for (bool backfaceCulling : { false, true })
+		{
+			std::vector<std::uint32_t> expected = CullScalar(meshlets, camera, backfaceCulling);
+			std::uint32_t visibleCount = culler.Cull(camera.Planes, camera.Position, backfaceCulling, ranges);
+			mismatches += visibleCount != expected.size() || !SameRanges(ranges, Merged(meshlets, expected));
+		}
+	}
+	CHECK_EQ(mismatches, 0u);
+
+	// An empty culler clears the output.
+	MeshletCuller empty;
+	CHECK(empty.Empty());
+	Camera camera = RandomCamera(rng, 10.0f, 1.0f);
+	CHECK_EQ(empty.Cull(camera.Planes, camera.Position, true, ranges), 0u);
+	CHECK(ranges.empty());
+}
+
+TEST(Meshlets, CullKeepsEveryVisibleTriangle)
+{
+	TextModel skull;
+	REQUIRE(LoadModel("skull", skull));
+	const TextModel terrain = TextModel::Terrain(64, 64);
+
+	std::mt19937 rng(23);
+	for (const TextModel* source : { (const TextModel*)&skull, &terrain })
+	{
+		TextModel model = *source;
+		std::vector<Meshlet> meshlets = MeshletBuilder::Build(model.Vertices.data(), Stride, model.VertexCount(),
+			model.Indices.data(), model.Indices.size());
+		MeshletCuller culler(meshlets);
+
+		// Around the middle of the mesh.
+		float center[3] = { 0.0f, 0.0f, 0.0f };
+		for (size_t v = 0; v < model.Vertices.size(); v += 6)
+		{
+			for (int k = 0; k < 3; ++k)
+				center[k] += model.Vertices[v + k] / model.VertexCount();
+		}
+
+		std::vector<IndexRange> ranges;
+		std::vector<bool> drawn(model.TriangleCount());
+		std::uint32_t missing = 0;
+		double culledFraction = 0.0;
+		const int viewCount = 100;
+		for (int view = 0; view < viewCount; ++view)
+		{
+			Camera camera = RandomCamera(rng, view % 2 == 0 ? 40.0f : 12.0f, 3.0f);
+			for (int k = 0; k < 3; ++k)
+			{
+				camera.Position[k] += center[k];
+				for (float* plane : camera.Planes)
+					plane[3] -= plane[k] * center[k];
+			}
+
+			std::uint32_t visibleCount = culler.Cull(camera.Planes, camera.Position, true, ranges);
+			culledFraction += 1.0 - (double)visibleCount / meshlets.size();
+			std::fill(drawn.begin(), drawn.end(), false);
+			for (const IndexRange& range : ranges)
+			{
+				for (std::uint32_t i = range.FirstIndex; i < range.FirstIndex + range.IndexCount; i += 3)
+					drawn[i / 3] = true;
+			}
+
+			// A triangle that faces the camera and is not behind any one plane may be seen.
+			for (std::uint32_t t = 0; t < model.TriangleCount(); ++t)
+			{
+				const std::uint32_t* tri = &model.Indices[3 * (size_t)t];
+				const float* p0 = &model.Vertices[6 * (size_t)tri[0]];
+				float n[3];
+				Normal(model, tri, n);
+				float toCamera[3] = { camera.Position[0] - p0[0], camera.Position[1] - p0[1], camera.Position[2] - p0[2] };
+				if (Dot(n, toCamera) <= 1e-4f * std::sqrt(Dot(n, n) * Dot(toCamera, toCamera)))
+					continue;
+
+				bool behind = false;
+				for (const float* plane : camera.Planes)
+				{
+					bool allBehind = true;
+					for (int k = 0; k < 3; ++k)
+						allBehind = allBehind && Dot(plane, &model.Vertices[6 * (size_t)tri[k]]) + plane[3] < 0.0f;
+					behind = behind || allBehind;
+				}
+				missing += !behind && !drawn[t];
+			}
+		}
+		CHECK_EQ(missing, 0u);
+
+		// The cones and spheres do cull a good part of the meshlets.
+		CHECK_MSG(culledFraction / viewCount > 0.15, "culled " << culledFraction / viewCount);
+	}
+}
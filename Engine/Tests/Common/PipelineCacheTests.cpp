@@ -0,0 +1,287 @@
+#include "Engine.h"
+#include "Common/PipelineCache.h"
+#include "Common/JobSystem.h"
+#include "Test.h"
+#include "TempDirectory.h"
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+	// Stands in for a pipeline description, hashed by its bytes like the real ones.
+	struct Desc
+	{
+		std::uint32_t Shader;
+		std::uint32_t BlendMode;
+		std::uint32_t CullMode;
+		std::uint32_t Format;
+	};
+
+	Desc MakeDesc(std::uint32_t i)
+	{
+		return { i / 8, i % 2, (i / 2) % 4, 28 };
+	}
+
+	PipelineCache::PipelineId Add(PipelineCache& cache, const Desc& desc)
+	{
+		return cache.Add(&desc, sizeof(desc));
+	}
+
+	// Stands in for the driver: compiles pipeline id into a blob derived from its id, or
+	// takes the cached blob if it is one it would have compiled.
+	struct StubDriver
+	{
+		std::uint32_t Version = 1;
+		std::atomic<std::uint32_t> Compiles = 0;
+		std::atomic<std::uint32_t> CacheHits = 0;
+		std::mutex Mutex;
+		std::vector<PipelineCache::PipelineId> Created;
+
+		PipelineCache::Blob Compile(PipelineCache::PipelineId id) const
+		{
+			return PipelineCache::Blob(16, (std::uint8_t)(Version * 64 + id));
+		}
+
+		PipelineCache::Blob operator()(PipelineCache::PipelineId id, const PipelineCache::Blob* cachedBlob)
+		{
+			{
+				std::lock_guard<std::mutex> lock(Mutex);
+				Created.push_back(id);
+			}
+
+			PipelineCache::Blob blob = Compile(id);
+			if (cachedBlob != nullptr && *cachedBlob == blob)
+				CacheHits.fetch_add(1);
+			else
+				Compiles.fetch_add(1);
+			return blob;
+		}
+	};
+
+	PipelineCache::CreateFunction Bind(StubDriver& driver)
+	{
+		return [&driver](PipelineCache::PipelineId id, const PipelineCache::Blob* cachedBlob)
+		{
+			return driver(id, cachedBlob);
+		};
+	}
+}
+
+TEST(PipelineCache, IdenticalDescriptionsShareAPipeline)
+{
+	PipelineCache cache;
+	std::vector<PipelineCache::PipelineId> ids;
+	for (std::uint32_t i = 0; i < 32; ++i)
+		ids.push_back(Add(cache, MakeDesc(i)));
+	CHECK_EQ(cache.PipelineCount(), 32u);
+	CHECK_EQ(cache.DuplicateCount(), 0u);
+	for (std::uint32_t i = 0; i < 32; ++i)
+		CHECK_EQ(ids[i], i);
+
+	for (std::uint32_t i = 0; i < 32; ++i)
+		CHECK_EQ(Add(cache, MakeDesc(i)), ids[i]);
+	CHECK_EQ(cache.PipelineCount(), 32u);
+	CHECK_EQ(cache.DuplicateCount(), 32u);
+
+	// The hash is the one of the description bytes.
+	Desc desc = MakeDesc(5);
+	CHECK_EQ(cache.Hash(ids[5]), BlobCache::HashBytes(&desc, sizeof(desc)));
+
+	// Any byte makes it another pipeline, and so does the length.
+	desc.Format = 29;
+	CHECK_EQ(Add(cache, desc), 32u);
+	CHECK_EQ(cache.Add(&desc, sizeof(desc) - 1), 33u);
+	CHECK_EQ(cache.Add(&desc, sizeof(desc) - 1), 33u);
+}
+
+TEST(PipelineCache, SecondRunCreatesFromCachedBlobs)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("pipelines.bin");
+
+	StubDriver first;
+	{
+		PipelineCache cache;
+		CHECK(!cache.Load(path));
+		for (std::uint32_t i = 0; i < 24; ++i)
+			Add(cache, MakeDesc(i % 12));
+		cache.CreatePending(Bind(first), nullptr);
+		CHECK_EQ(first.Compiles.load(), 12u);
+		CHECK_EQ(cache.CompiledCount(), 12u);
+		CHECK_EQ(cache.CachedCount(), 0u);
+		CHECK(cache.IsDirty());
+		REQUIRE(cache.Save(path));
+	}
+
+	StubDriver second;
+	PipelineCache cache;
+	REQUIRE(cache.Load(path));
+	for (std::uint32_t i = 0; i < 12; ++i)
+		Add(cache, MakeDesc(i));
+	cache.CreatePending(Bind(second), nullptr);
+	CHECK_EQ(second.CacheHits.load(), 12u);
+	CHECK_EQ(second.Compiles.load(), 0u);
+	CHECK_EQ(cache.CachedCount(), 12u);
+	CHECK_EQ(cache.CompiledCount(), 0u);
+	CHECK(!cache.IsDirty());
+}
+
+TEST(PipelineCache, StaleAndUnusedBlobsAreReplaced)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("pipelines.bin");
+	{
+		StubDriver driver;
+		PipelineCache cache;
+		for (std::uint32_t i = 0; i < 8; ++i)
+			Add(cache, MakeDesc(i));
+		cache.CreatePending(Bind(driver), nullptr);
+		REQUIRE(cache.Save(path));
+	}
+
+	// A new driver rejects the old blobs, and pipeline 7 is no longer wanted.
+	StubDriver updated;
+	updated.Version = 2;
+	{
+		PipelineCache cache;
+		REQUIRE(cache.Load(path));
+		for (std::uint32_t i = 0; i < 7; ++i)
+			Add(cache, MakeDesc(i));
+		cache.CreatePending(Bind(updated), nullptr);
+		CHECK_EQ(updated.Compiles.load(), 7u);
+		// The cached blobs were offered, they were stale.
+		CHECK_EQ(cache.CachedCount(), 7u);
+		CHECK(cache.IsDirty());
+		REQUIRE(cache.Save(path));
+	}
+
+	StubDriver again;
+	again.Version = 2;
+	PipelineCache cache;
+	REQUIRE(cache.Load(path));
+	for (std::uint32_t i = 0; i < 8; ++i)
+		Add(cache, MakeDesc(i));
+	cache.CreatePending(Bind(again), nullptr);
+	CHECK_EQ(again.CacheHits.load(), 7u);
+	// Pipeline 7 was dropped from the file.
+	CHECK_EQ(again.Compiles.load(), 1u);
+	CHECK_EQ(cache.CachedCount(), 7u);
+	CHECK_EQ(cache.CompiledCount(), 1u);
+}
+
+TEST(PipelineCache, PipelinesWithoutABlobAreNotCached)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("pipelines.bin");
+
+	PipelineCache cache;
+	Add(cache, MakeDesc(0));
+	cache.CreatePending([](PipelineCache::PipelineId, const PipelineCache::Blob*) { return PipelineCache::Blob(); },
+		nullptr);
+	CHECK_EQ(cache.CompiledCount(), 1u);
+	CHECK(!cache.IsDirty());
+	REQUIRE(cache.Save(path));
+
+	PipelineCache loaded;
+	REQUIRE(loaded.Load(path));
+	Add(loaded, MakeDesc(0));
+	bool offered = false;
+	loaded.CreatePending([&offered](PipelineCache::PipelineId, const PipelineCache::Blob* cachedBlob)
+		{
+			offered = cachedBlob != nullptr;
+			return PipelineCache::Blob();
+		}, nullptr);
+	CHECK(!offered);
+}
+
+TEST(PipelineCache, OnlyPendingPipelinesAreCreated)
+{
+	StubDriver driver;
+	PipelineCache cache;
+	for (std::uint32_t i = 0; i < 4; ++i)
+		Add(cache, MakeDesc(i));
+	cache.CreatePending(Bind(driver), nullptr);
+	CHECK_EQ(driver.Created.size(), (size_t)4);
+
+	// Nothing new, nothing created.
+	Add(cache, MakeDesc(2));
+	cache.CreatePending(Bind(driver), nullptr);
+	CHECK_EQ(driver.Created.size(), (size_t)4);
+
+	for (std::uint32_t i = 2; i < 6; ++i)
+		Add(cache, MakeDesc(i));
+	cache.CreatePending(Bind(driver), nullptr);
+	REQUIRE_EQ(driver.Created.size(), (size_t)6);
+	CHECK_EQ(driver.Created[4], 4u);
+	CHECK_EQ(driver.Created[5], 5u);
+	CHECK_EQ(cache.CompiledCount(), 6u);
+}
+
+TEST(PipelineCache, ParallelCreatesEachPipelineOnce)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("pipelines.bin");
+	JobSystem jobSystem(4);
+
+	StubDriver driver;
+	{
+		PipelineCache cache;
+		for (std::uint32_t i = 0; i < 512; ++i)
+			Add(cache, MakeDesc(i % 200));
+		cache.CreatePending(Bind(driver), &jobSystem);
+		REQUIRE(cache.Save(path));
+	}
+	REQUIRE_EQ(driver.Created.size(), (size_t)200);
+	std::vector<std::uint32_t> created(200, 0);
+	for (PipelineCache::PipelineId id : driver.Created)
+		created[id]++;
+	CHECK(created == std::vector<std::uint32_t>(200, 1));
+
+	// The file written after a parallel run serves every pipeline of the next one.
+	StubDriver next;
+	PipelineCache cache;
+	REQUIRE(cache.Load(path));
+	for (std::uint32_t i = 0; i < 200; ++i)
+		Add(cache, MakeDesc(i));
+	cache.CreatePending(Bind(next), &jobSystem);
+	CHECK_EQ(next.CacheHits.load(), 200u);
+}
+
+TEST(PipelineCache, FailedCreatesAreRethrownAndRetried)
+{
+	JobSystem jobSystem(4);
+	for (JobSystem* jobs : { (JobSystem*)nullptr, &jobSystem })
+	{
+		PipelineCache cache;
+		for (std::uint32_t i = 0; i < 16; ++i)
+			Add(cache, MakeDesc(i));
+
+		std::atomic<std::uint32_t> calls = 0;
+		bool thrown = false;
+		try
+		{
+			cache.CreatePending([&calls](PipelineCache::PipelineId id, const PipelineCache::Blob*)
+				{
+					calls.fetch_add(1);
+					if (id == 5 || id == 9)
+						throw std::runtime_error(std::to_string(id));
+					return PipelineCache::Blob(4, 1);
+				}, jobs);
+		}
+		catch (const std::runtime_error& e)
+		{
+			thrown = std::string(e.what()) == "5";
+		}
+		CHECK(thrown);
+		CHECK_EQ(calls.load(), 16u);
+		CHECK(!cache.IsDirty());
+
+		// The whole batch is still pending.
+		StubDriver driver;
+		cache.CreatePending(Bind(driver), jobs);
+		CHECK_EQ(driver.Created.size(), (size_t)16);
+		CHECK_EQ(cache.CompiledCount(), 16u);
+	}
+}
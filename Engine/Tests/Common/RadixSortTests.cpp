@@ -0,0 +1,105 @@
+#include "Engine.h"
+#include "Common/RadixSort.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <functional>
+#include <random>
+
+namespace
+{
+	struct Distribution
+	{
+		const char* Name;
+		std::function<std::uint64_t(std::mt19937_64&, std::uint32_t)> Key;
+	};
+
+	const Distribution Distributions[] =
+	{
+		{ "uniform", [](std::mt19937_64& rng, std::uint32_t) { return rng(); } },
+		{ "few values", [](std::mt19937_64& rng, std::uint32_t) { return rng() % 7; } },
+		{ "constant", [](std::mt19937_64&, std::uint32_t) { return 0x0123456789ABCDEFull; } },
+		// Like the batcher's keys: high fields with few values, low bits random.
+		{ "fields", [](std::mt19937_64& rng, std::uint32_t) { return ((rng() % 5) << 48) | ((rng() % 300) << 32) | (rng() & 0xFFFFF); } },
+		{ "high byte only", [](std::mt19937_64& rng, std::uint32_t) { return (rng() & 0xFF) << 56; } },
+		{ "sorted", [](std::mt19937_64&, std::uint32_t i) { return (std::uint64_t)i * 0x10001; } },
+		{ "reversed", [](std::mt19937_64&, std::uint32_t i) { return ~(std::uint64_t)i; } },
+	};
+
+	std::vector<SortKey> MakeKeys(const Distribution& distribution, std::uint32_t count, unsigned seed)
+	{
+		std::mt19937_64 rng(seed);
+		std::vector<SortKey> keys(count);
+		for (std::uint32_t i = 0; i < count; ++i)
+		{
+			keys[i].Key = distribution.Key(rng, i);
+			keys[i].Value = i;
+		}
+		return keys;
+	}
+
+	// The values of equal keys are the positions the keys had, so comparing the values
+	// with std::stable_sort also checks stability.
+	bool SameOrder(const std::vector<SortKey>& a, const std::vector<SortKey>& b)
+	{
+		return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+			[](const SortKey& x, const SortKey& y) { return x.Key == y.Key && x.Value == y.Value; });
+	}
+
+	void ReferenceSort(std::vector<SortKey>& keys)
+	{
+		std::stable_sort(keys.begin(), keys.end(), [](const SortKey& a, const SortKey& b) { return a.Key < b.Key; });
+	}
+}
+
+TEST(RadixSort, MatchesStableSort)
+{
+	for (const Distribution& distribution : Distributions)
+	{
+		for (std::uint32_t count : { 0u, 1u, 2u, 3u, 255u, 256u, 1000u, 65537u })
+		{
+			std::vector<SortKey> keys = MakeKeys(distribution, count, count + 1);
+			std::vector<SortKey> expected = keys;
+			ReferenceSort(expected);
+
+			std::vector<SortKey> scratch;
+			RadixSort(keys, scratch);
+			CHECK_MSG(SameOrder(keys, expected), distribution.Name << ", " << count << " keys");
+		}
+	}
+}
+
+TEST(RadixSort, ScratchCanBeReused)
+{
+	// Scratch larger than the keys and full of old keys, then smaller, then shared by
+	// sorts of every distribution.
+	std::vector<SortKey> scratch(100000);
+	for (SortKey& key : scratch)
+		key.Key = ~0ull;
+
+	unsigned seed = 1;
+	for (std::uint32_t count : { 5000u, 70000u, 20u, 40000u })
+	{
+		for (const Distribution& distribution : Distributions)
+		{
+			std::vector<SortKey> keys = MakeKeys(distribution, count, seed++);
+			std::vector<SortKey> expected = keys;
+			ReferenceSort(expected);
+
+			RadixSort(keys, scratch);
+			CHECK_MSG(SameOrder(keys, expected), distribution.Name << ", " << count << " keys");
+			CHECK_GT(scratch.size(), 0u);
+		}
+	}
+}
+
+TEST(RadixSort, SortedKeysStaySorted)
+{
+	// Sorting again must not move equal keys, whatever the number of passes.
+	std::vector<SortKey> keys = MakeKeys(Distributions[3], 10000, 3);
+	std::vector<SortKey> scratch;
+	RadixSort(keys, scratch);
+	std::vector<SortKey> once = keys;
+	RadixSort(keys, scratch);
+	CHECK(SameOrder(keys, once));
+}
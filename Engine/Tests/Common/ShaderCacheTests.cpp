@@ -0,0 +1,341 @@
+#include "Engine.h"
+#include "Common/ShaderCache.h"
+#include "Common/JobSystem.h"
+#include "Test.h"
+#include "TempDirectory.h"
+
+#include <atomic>
+#include <stdexcept>
+
+namespace
+{
+	const std::uint32_t TestMagic = 0x54534554;
+
+	BlobCache::Blob MakeBlob(std::uint32_t seed, size_t size)
+	{
+		BlobCache::Blob blob(size);
+		for (size_t i = 0; i < size; ++i)
+			blob[i] = (std::uint8_t)(seed * 131 + i * 7);
+		return blob;
+	}
+
+	std::string Name(const std::filesystem::path& path)
+	{
+		return path.filename().string();
+	}
+
+	// Stands in for the compiler: the bytecode is the entry point and target, and every
+	// call is counted.
+	struct StubCompiler
+	{
+		std::atomic<std::uint32_t> Calls = 0;
+
+		ShaderCache::Bytecode operator()(const ShaderKey& key)
+		{
+			Calls.fetch_add(1);
+			std::string text = key.EntryPoint + "/" + key.Target;
+			return ShaderCache::Bytecode(text.begin(), text.end());
+		}
+	};
+
+	std::vector<ShaderKey> MakeKeys(const std::filesystem::path& file, std::uint32_t count)
+	{
+		std::vector<ShaderKey> keys;
+		for (std::uint32_t i = 0; i < count; ++i)
+			keys.push_back({ file, { { "VARIANT", std::to_string(i) } }, "main" + std::to_string(i), "ps_5_1", 0 });
+		return keys;
+	}
+}
+
+TEST(BlobCache, HashBytesIsFnv1a)
+{
+	CHECK_EQ(BlobCache::HashBytes("", 0), BlobCache::HashBasis);
+	CHECK_EQ(BlobCache::HashBytes("a", 1), 0xaf63dc4c8601ec8cull);
+	CHECK_EQ(BlobCache::HashBytes("foobar", 6), 0x85944171f73967e8ull);
+	// Hashing in pieces gives the hash of the whole.
+	CHECK_EQ(BlobCache::HashBytes("bar", 3, BlobCache::HashBytes("foo", 3)), BlobCache::HashBytes("foobar", 6));
+}
+
+TEST(BlobCache, SavedEntriesLoadBack)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("cache.bin");
+
+	BlobCache cache(TestMagic, 1);
+	CHECK(!cache.IsDirty());
+	for (std::uint32_t i = 0; i < 20; ++i)
+		cache.Store(i * 1000003ull, MakeBlob(i, i * 37));
+	CHECK(cache.IsDirty());
+	CHECK_EQ(cache.EntryCount(), 20u);
+	REQUIRE(cache.Save(path));
+	CHECK(!std::filesystem::exists(directory.Path("cache.bin.tmp")));
+
+	BlobCache loaded(TestMagic, 1);
+	REQUIRE(loaded.Load(path));
+	CHECK_EQ(loaded.EntryCount(), 20u);
+	std::uint32_t wrong = 0;
+	for (std::uint32_t i = 0; i < 20; ++i)
+	{
+		const BlobCache::Blob* blob = loaded.Find(i * 1000003ull);
+		wrong += blob == nullptr || *blob != MakeBlob(i, i * 37);
+	}
+	CHECK_EQ(wrong, 0u);
+	CHECK(loaded.Find(7) == nullptr);
+	CHECK_EQ(loaded.Hits(), 20u);
+	CHECK_EQ(loaded.Misses(), 1u);
+
+	// Every entry was asked for, saving would write the same file again.
+	CHECK(!loaded.IsDirty());
+}
+
+TEST(BlobCache, OnlyUsedEntriesAreSaved)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("cache.bin");
+
+	BlobCache cache(TestMagic, 1);
+	for (std::uint32_t i = 0; i < 4; ++i)
+		cache.Store(i, MakeBlob(i, 16));
+	REQUIRE(cache.Save(path));
+
+	BlobCache loaded(TestMagic, 1);
+	REQUIRE(loaded.Load(path));
+	CHECK(loaded.IsDirty());
+	CHECK(loaded.Find(1) != nullptr);
+	CHECK(loaded.Find(3) != nullptr);
+	REQUIRE(loaded.Save(path));
+
+	BlobCache trimmed(TestMagic, 1);
+	REQUIRE(trimmed.Load(path));
+	CHECK_EQ(trimmed.EntryCount(), 2u);
+	CHECK(trimmed.Find(0) == nullptr);
+	CHECK(trimmed.Find(1) != nullptr);
+	CHECK(trimmed.Find(2) == nullptr);
+	CHECK(trimmed.Find(3) != nullptr);
+
+	// Replacing an entry makes the cache dirty even if every entry was used.
+	CHECK(!trimmed.IsDirty());
+	trimmed.Store(1, MakeBlob(9, 4));
+	CHECK(trimmed.IsDirty());
+	CHECK(*trimmed.Find(1) == MakeBlob(9, 4));
+}
+
+TEST(BlobCache, DamagedFilesLeaveItEmpty)
+{
+	TempDirectory directory;
+	std::filesystem::path path = directory.Path("cache.bin");
+
+	BlobCache cache(TestMagic, 1);
+	cache.Store(1, MakeBlob(1, 40));
+	cache.Store(2, MakeBlob(2, 3));
+	REQUIRE(cache.Save(path));
+	const std::vector<std::uint8_t> bytes = TempDirectory::Read(path.wstring());
+
+	BlobCache loaded(TestMagic, 1);
+	CHECK(!loaded.Load(directory.Path("missing.bin")));
+	CHECK_EQ(loaded.EntryCount(), 0u);
+
+	// Every truncation, from the header to the last byte of the blobs.
+	std::uint32_t accepted = 0;
+	for (size_t size = 0; size < bytes.size(); ++size)
+	{
+		REQUIRE(loaded.Load(path));
+		std::wstring truncated = directory.Write("truncated.bin", bytes.data(), size);
+		accepted += loaded.Load(truncated) || loaded.EntryCount() != 0;
+	}
+	CHECK_EQ(accepted, 0u);
+
+	// Another cache or another layout.
+	REQUIRE(loaded.Load(path));
+	BlobCache otherMagic(TestMagic + 1, 1);
+	CHECK(!otherMagic.Load(path));
+	CHECK_EQ(otherMagic.EntryCount(), 0u);
+	BlobCache otherVersion(TestMagic, 2);
+	CHECK(!otherVersion.Load(path));
+	CHECK_EQ(otherVersion.EntryCount(), 0u);
+
+	// An entry pointing past the end of the file.
+	std::vector<std::uint8_t> corrupt = bytes;
+	corrupt[16 + 8] = 0xff;
+	CHECK(!loaded.Load(directory.Write("corrupt.bin", corrupt.data(), corrupt.size())));
+	CHECK_EQ(loaded.EntryCount(), 0u);
+
+	// A directory that does not exist cannot be written.
+	CHECK(!cache.Save(directory.Root() / "missing" / "cache.bin"));
+}
+
+TEST(ShaderCache, IncludeClosureFollowsNestedIncludesOnce)
+{
+	TempDirectory directory;
+	std::filesystem::create_directories(directory.Root() / "Common");
+	directory.Write("Main.hlsl",
+		"#include \"Common/Lighting.hlsl\"\n"
+		"  #  include <Common/Math.hlsl>\n"
+		"#include \"Missing.hlsl\"\n"
+		"// #include \"Commented.hlsl\"\n"
+		"#include \"Common/Lighting.hlsl\"\n");
+	// Relative to the including file, and back up a directory.
+	directory.Write("Common/Lighting.hlsl", "#include \"Math.hlsl\"\n#include \"../Main.hlsl\"\n");
+	directory.Write("Common/Math.hlsl", "#include \"../Shared.hlsl\"\n");
+	directory.Write("Shared.hlsl", "static const float Pi = 3.14159f;\n");
+	directory.Write("Commented.hlsl", "");
+
+	std::vector<std::filesystem::path> closure = ShaderCache::IncludeClosure(directory.Path("Main.hlsl"));
+	REQUIRE_EQ(closure.size(), (size_t)4);
+	CHECK_EQ(Name(closure[0]), std::string("Main.hlsl"));
+	CHECK_EQ(Name(closure[1]), std::string("Lighting.hlsl"));
+	CHECK_EQ(Name(closure[2]), std::string("Math.hlsl"));
+	CHECK_EQ(Name(closure[3]), std::string("Shared.hlsl"));
+	CHECK(closure[3] == (directory.Root() / "Shared.hlsl").lexically_normal());
+
+	CHECK(ShaderCache::IncludeClosure(directory.Path("Missing.hlsl")).empty());
+}
+
+TEST(ShaderCache, ShippedShadersIncludeTheirUtilities)
+{
+	std::vector<std::filesystem::path> closure =
+		ShaderCache::IncludeClosure(std::filesystem::path(ENGINE_SHADER_DIR) / "Default.hlsl");
+	REQUIRE_EQ(closure.size(), (size_t)2);
+	CHECK_EQ(Name(closure[1]), std::string("LightningUtils.hlsl"));
+}
+
+TEST(ShaderCache, HashChangesWithEverythingThatDecidesTheBytecode)
+{
+	TempDirectory directory;
+	std::wstring main = directory.Write("Main.hlsl", "#include \"Utils.hlsl\"\nfloat4 main() : SV_Target { return 0; }\n");
+	directory.Write("Utils.hlsl", "float Square(float x) { return x * x; }\n");
+
+	const ShaderKey key = { main, { { "FOG", "1" }, { "ALPHA_TEST", "" } }, "main", "ps_5_1", 1 };
+	const std::uint64_t hash = ShaderCache::Hash(key);
+	CHECK_EQ(ShaderCache::Hash(key), hash);
+
+	auto changed = [&](auto change)
+	{
+		ShaderKey other = key;
+		change(other);
+		return ShaderCache::Hash(other) != hash;
+	};
+	CHECK(changed([](ShaderKey& k) { k.Defines[0].Value = "0"; }));
+	CHECK(changed([](ShaderKey& k) { k.Defines[1].Name = "ALPHA_BLEND"; }));
+	CHECK(changed([](ShaderKey& k) { k.Defines.pop_back(); }));
+	CHECK(changed([](ShaderKey& k) { std::swap(k.Defines[0], k.Defines[1]); }));
+	// Strings are length prefixed, moving a character from one to the next changes the hash.
+	CHECK(changed([](ShaderKey& k) { k.Defines[0] = { "FOG1", "" }; }));
+	CHECK(changed([](ShaderKey& k) { k.EntryPoint = "VS"; }));
+	CHECK(changed([](ShaderKey& k) { k.Target = "ps_6_0"; }));
+	CHECK(changed([](ShaderKey& k) { k.Flags = 0; }));
+
+	// Editing an included file misses the cache as well.
+	directory.Write("Utils.hlsl", "float Square(float x) { return x * x * 1; }\n");
+	const std::uint64_t edited = ShaderCache::Hash(key);
+	CHECK(edited != hash);
+	directory.Write("Utils.hlsl", "float Square(float x) { return x * x; }\n");
+	CHECK_EQ(ShaderCache::Hash(key), hash);
+
+	// Only contents count, the same sources elsewhere hash the same.
+	TempDirectory copy;
+	ShaderKey moved = key;
+	moved.File = copy.Write("Main.hlsl", "#include \"Utils.hlsl\"\nfloat4 main() : SV_Target { return 0; }\n");
+	copy.Write("Utils.hlsl", "float Square(float x) { return x * x; }\n");
+	CHECK_EQ(ShaderCache::Hash(moved), hash);
+}
+
+TEST(ShaderCache, OnlyMissesAreCompiled)
+{
+	TempDirectory directory;
+	std::wstring main = directory.Write("Main.hlsl", "float4 main() : SV_Target { return 0; }\n");
+	std::filesystem::path path = directory.Path("shaders.bin");
+	const std::vector<ShaderKey> keys = MakeKeys(main, 6);
+
+	StubCompiler compiler;
+	auto compile = [&compiler](const ShaderKey& key) { return compiler(key); };
+	{
+		ShaderCache cache;
+		CHECK(!cache.Load(path));
+		std::vector<ShaderCache::Bytecode> bytecodes = cache.GetOrCompile(keys, compile, nullptr);
+		CHECK_EQ(compiler.Calls.load(), 6u);
+		CHECK_EQ(cache.Misses(), 6u);
+		REQUIRE_EQ(bytecodes.size(), keys.size());
+		CHECK(bytecodes[4] == compiler(keys[4]));
+		compiler.Calls = 0;
+
+		// The second request is served from memory.
+		CHECK(cache.GetOrCompile(keys, compile, nullptr) == bytecodes);
+		CHECK_EQ(compiler.Calls.load(), 0u);
+		CHECK_EQ(cache.Hits(), 6u);
+		CHECK(cache.IsDirty());
+		REQUIRE(cache.Save(path));
+	}
+
+	// A new run loads the file and compiles only the key that is new.
+	ShaderCache cache;
+	REQUIRE(cache.Load(path));
+	std::vector<ShaderKey> more = MakeKeys(main, 7);
+	std::vector<ShaderCache::Bytecode> bytecodes = cache.GetOrCompile(more, compile, nullptr);
+	CHECK_EQ(compiler.Calls.load(), 1u);
+	CHECK_EQ(cache.Hits(), 6u);
+	CHECK_EQ(cache.Misses(), 1u);
+	CHECK(bytecodes[6] == compiler(more[6]));
+
+	// Editing the source misses every key.
+	directory.Write("Main.hlsl", "float4 main() : SV_Target { return 1; }\n");
+	compiler.Calls = 0;
+	cache.GetOrCompile(more, compile, nullptr);
+	CHECK_EQ(compiler.Calls.load(), 7u);
+}
+
+TEST(ShaderCache, ParallelCompilesMatchSerialOnes)
+{
+	TempDirectory directory;
+	std::wstring main = directory.Write("Main.hlsl", "float4 main() : SV_Target { return 0; }\n");
+	const std::vector<ShaderKey> keys = MakeKeys(main, 64);
+
+	StubCompiler serialCompiler;
+	ShaderCache serial;
+	std::vector<ShaderCache::Bytecode> expected =
+		serial.GetOrCompile(keys, [&](const ShaderKey& key) { return serialCompiler(key); }, nullptr);
+
+	JobSystem jobSystem(4);
+	StubCompiler parallelCompiler;
+	ShaderCache parallel;
+	std::vector<ShaderCache::Bytecode> bytecodes =
+		parallel.GetOrCompile(keys, [&](const ShaderKey& key) { return parallelCompiler(key); }, &jobSystem);
+	CHECK(bytecodes == expected);
+	CHECK_EQ(parallelCompiler.Calls.load(), 64u);
+	CHECK_EQ(parallel.EntryCount(), 64u);
+}
+
+TEST(ShaderCache, CompileErrorsAreRethrownAfterEveryCompile)
+{
+	TempDirectory directory;
+	std::wstring main = directory.Write("Main.hlsl", "float4 main() : SV_Target { return 0; }\n");
+	const std::vector<ShaderKey> keys = MakeKeys(main, 16);
+
+	JobSystem jobSystem(4);
+	for (JobSystem* jobs : { (JobSystem*)nullptr, &jobSystem })
+	{
+		ShaderCache cache;
+		std::atomic<std::uint32_t> calls = 0;
+		bool thrown = false;
+		try
+		{
+			cache.GetOrCompile(keys, [&calls](const ShaderKey& key)
+				{
+					calls.fetch_add(1);
+					if (key.EntryPoint == "main3" || key.EntryPoint == "main11")
+						throw std::runtime_error(key.EntryPoint);
+					return ShaderCache::Bytecode(4, 0);
+				}, jobs);
+		}
+		catch (const std::runtime_error& e)
+		{
+			// The first failure in key order, whichever thread saw it first.
+			thrown = std::string(e.what()) == "main3";
+		}
+		CHECK(thrown);
+		CHECK_EQ(calls.load(), 16u);
+		// Nothing of a failed request is kept.
+		CHECK_EQ(cache.EntryCount(), 0u);
+		CHECK(!cache.IsDirty());
+	}
+}
@@ -0,0 +1,98 @@
+#include "Engine.h"
+#include "Common/SlotAllocator.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+
+TEST(SlotAllocator, FreedSlotsAreReusedFirst)
+{
+	SlotAllocator slots(4);
+	CHECK_EQ(slots.Allocate(), 0u);
+	CHECK_EQ(slots.Allocate(), 1u);
+	CHECK_EQ(slots.Allocate(), 2u);
+	CHECK_EQ(slots.Count(), 3u);
+
+	slots.Free(1);
+	CHECK_EQ(slots.Count(), 2u);
+	CHECK_EQ(slots.Allocate(), 1u);
+	CHECK_EQ(slots.Allocate(), 3u);
+
+	// The last freed slot comes back first.
+	slots.Free(0);
+	slots.Free(2);
+	CHECK_EQ(slots.Allocate(), 2u);
+	CHECK_EQ(slots.Allocate(), 0u);
+	CHECK_EQ(slots.Allocate(), 4u);
+}
+
+TEST(SlotAllocator, CapacityGrowsByWholePages)
+{
+	SlotAllocator slots(64);
+	CHECK_EQ(slots.SlotsPerPage(), 64u);
+	CHECK_EQ(slots.PageCount(), 0u);
+	CHECK_EQ(slots.Capacity(), 0u);
+
+	slots.Allocate();
+	CHECK_EQ(slots.PageCount(), 1u);
+	CHECK_EQ(slots.Capacity(), 64u);
+
+	for (int i = 1; i < 64; ++i)
+		slots.Allocate();
+	CHECK_EQ(slots.Capacity(), 64u);
+	slots.Allocate();
+	CHECK_EQ(slots.PageCount(), 2u);
+	CHECK_EQ(slots.Capacity(), 128u);
+
+	// Freeing never shrinks the pages, the slots keep their place in the buffer.
+	for (std::uint32_t slot = 0; slot < 65; ++slot)
+		slots.Free(slot);
+	CHECK_EQ(slots.Count(), 0u);
+	CHECK_EQ(slots.Capacity(), 128u);
+
+	slots.Clear();
+	CHECK_EQ(slots.Capacity(), 0u);
+	CHECK_EQ(slots.Allocate(), 0u);
+
+	SlotAllocator single(0);
+	CHECK_EQ(single.SlotsPerPage(), 1u);
+	single.Allocate();
+	single.Allocate();
+	CHECK_EQ(single.Capacity(), 2u);
+}
+
+TEST(SlotAllocator, RandomChurnKeepsSlotsUniqueAndInsideTheBuffer)
+{
+	SlotAllocator slots(16);
+	std::set<std::uint32_t> live;
+
+	std::mt19937 rng(11);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::uint32_t duplicates = 0;
+	std::uint32_t outside = 0;
+	std::uint32_t maxLive = 0;
+	for (std::uint32_t step = 0; step < 20000; ++step)
+	{
+		if (action(rng) < 6 || live.empty())
+		{
+			std::uint32_t slot = slots.Allocate();
+			duplicates += !live.insert(slot).second;
+			outside += slot >= slots.Capacity();
+		}
+		else
+		{
+			auto it = std::next(live.begin(), std::uniform_int_distribution<size_t>(0, live.size() - 1)(rng));
+			slots.Free(*it);
+			live.erase(it);
+		}
+		maxLive = std::max(maxLive, (std::uint32_t)live.size());
+	}
+
+	CHECK_EQ(duplicates, 0u);
+	CHECK_EQ(outside, 0u);
+	CHECK_EQ(slots.Count(), (std::uint32_t)live.size());
+	// Slots are reused, so the buffer only grows with the most items alive at once.
+	CHECK_EQ(slots.Capacity(), (maxLive + 15) / 16 * 16);
+}
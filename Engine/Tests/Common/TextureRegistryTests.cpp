@@ -0,0 +1,91 @@
+#include "Engine.h"
+#include "Common/TextureRegistry.h"
+#include "Test.h"
+
+#include <map>
+#include <random>
+#include <set>
+
+TEST(TextureRegistry, IndicesAreStable)
+{
+	TextureRegistry registry(8);
+	CHECK_EQ(registry.Capacity(), 8u);
+
+	std::uint32_t bricks = registry.Register("bricksTex");
+	std::uint32_t ice = registry.Register("iceTex");
+	CHECK(bricks != ice);
+	CHECK_EQ(registry.Register("bricksTex"), bricks);
+	CHECK_EQ(registry.IndexOf("bricksTex"), bricks);
+	CHECK_EQ(registry.IndexOf("iceTex"), ice);
+	CHECK_EQ(registry.IndexOf("stoneTex"), TextureRegistry::InvalidIndex);
+	CHECK_EQ(registry.Count(), 2u);
+
+	// Removing a texture leaves the others where they are.
+	CHECK(registry.Unregister("bricksTex"));
+	CHECK(!registry.Unregister("bricksTex"));
+	CHECK_EQ(registry.IndexOf("bricksTex"), TextureRegistry::InvalidIndex);
+	CHECK_EQ(registry.IndexOf("iceTex"), ice);
+	CHECK_EQ(registry.Count(), 1u);
+
+	// The freed index is the next one handed out.
+	CHECK_EQ(registry.Register("stoneTex"), bricks);
+}
+
+TEST(TextureRegistry, FullTableRejectsNewTextures)
+{
+	TextureRegistry registry(3);
+	for (int i = 0; i < 3; ++i)
+		CHECK_LT(registry.Register("texture" + std::to_string(i)), 3u);
+
+	CHECK_EQ(registry.Register("oneTooMany"), TextureRegistry::InvalidIndex);
+	CHECK_EQ(registry.IndexOf("oneTooMany"), TextureRegistry::InvalidIndex);
+	CHECK_EQ(registry.Count(), 3u);
+	// Textures already in the table are still found.
+	CHECK_LT(registry.Register("texture1"), 3u);
+
+	CHECK(registry.Unregister("texture0"));
+	CHECK_LT(registry.Register("oneTooMany"), 3u);
+
+	TextureRegistry empty(0);
+	CHECK_EQ(empty.Register("any"), TextureRegistry::InvalidIndex);
+}
+
+TEST(TextureRegistry, RandomChurnStaysInsideTheTable)
+{
+	const std::uint32_t capacity = 200;
+	TextureRegistry registry(capacity);
+	std::map<std::string, std::uint32_t> expected;
+
+	std::mt19937 rng(16);
+	std::uniform_int_distribution<int> name(0, 399);
+	std::uniform_int_distribution<int> action(0, 2);
+	std::uint32_t wrong = 0;
+	for (int step = 0; step < 20000; ++step)
+	{
+		std::string texture = "texture" + std::to_string(name(rng));
+		if (action(rng) < 2)
+		{
+			std::uint32_t index = registry.Register(texture);
+			auto it = expected.find(texture);
+			if (it != expected.end())
+				wrong += index != it->second;
+			else if (expected.size() < capacity)
+				expected.emplace(texture, index);
+			else
+				wrong += index != TextureRegistry::InvalidIndex;
+		}
+		else
+		{
+			wrong += registry.Unregister(texture) != (expected.erase(texture) == 1);
+		}
+	}
+	CHECK_EQ(wrong, 0u);
+	CHECK_EQ(registry.Count(), (std::uint32_t)expected.size());
+
+	// Every texture has its own index inside the table.
+	std::set<std::uint32_t> indices;
+	std::uint32_t bad = 0;
+	for (const auto& [texture, index] : expected)
+		bad += index >= capacity || !indices.insert(index).second || registry.IndexOf(texture) != index;
+	CHECK_EQ(bad, 0u);
+}
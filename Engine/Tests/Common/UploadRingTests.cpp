@@ -0,0 +1,228 @@
+#include "Engine.h"
+#include "Common/UploadRing.h"
+#include "Test.h"
+
+#include <random>
+
+namespace
+{
+	// GPU timeline without a GPU: submits complete only when the test advances the
+	// timeline, or when the ring blocks on them, which counts as a stall.
+	class SimulatedQueue : public UploadQueue
+	{
+	public:
+		std::uint64_t Submit() override
+		{
+			return ++m_Submitted;
+		}
+
+		std::uint64_t CompletedFence() const override
+		{
+			return m_Completed;
+		}
+
+		void WaitForFence(std::uint64_t fence) override
+		{
+			// Waiting on a fence that was never submitted would hang a real queue.
+			REQUIRE(fence <= m_Submitted);
+			m_Stalls++;
+			m_Completed = std::max(m_Completed, fence);
+		}
+
+		// The GPU finishes submits up to fence, at most those submitted so far.
+		void CompleteUpTo(std::uint64_t fence)
+		{
+			m_Completed = std::max(m_Completed, std::min(fence, m_Submitted));
+		}
+
+		std::uint64_t Submitted() const { return m_Submitted; }
+		std::uint32_t Stalls() const { return m_Stalls; }
+
+	private:
+		std::uint64_t m_Submitted = 0;
+		std::uint64_t m_Completed = 0;
+		std::uint32_t m_Stalls = 0;
+	};
+}
+
+TEST(UploadRing, AllocationsAreAlignedAndPacked)
+{
+	SimulatedQueue queue;
+	UploadRing ring(&queue, 4096);
+
+	CHECK_EQ(ring.Allocate(100, 4), 0u);
+	CHECK_EQ(ring.Allocate(100, 256), 256u);
+	CHECK_EQ(ring.Allocate(8, 8), 360u);
+	CHECK_EQ(ring.UsedBytes(), 368u);
+	CHECK_EQ(ring.PendingSubmits(), 0u);
+	CHECK_EQ(queue.Submitted(), 0u);
+	CHECK_EQ(queue.Stalls(), 0u);
+}
+
+TEST(UploadRing, SubmitsRetireInFenceOrder)
+{
+	SimulatedQueue queue;
+	UploadRing ring(&queue, 4096);
+
+	ring.Allocate(1000, 4);
+	std::uint64_t first = ring.Submit();
+	ring.Allocate(500, 4);
+	std::uint64_t second = ring.Submit();
+	CHECK_LT(first, second);
+	CHECK_EQ(ring.PendingSubmits(), 2u);
+	CHECK(!ring.IsComplete(first));
+
+	// A submit without allocations still returns a ticket, but holds no bytes.
+	std::uint64_t empty = ring.Submit();
+	CHECK_EQ(ring.PendingSubmits(), 2u);
+
+	// Nothing is freed before the GPU gets there.
+	ring.Retire();
+	CHECK_EQ(ring.UsedBytes(), 1500u);
+
+	queue.CompleteUpTo(first);
+	CHECK(ring.IsComplete(first));
+	CHECK(!ring.IsComplete(second));
+	ring.Retire();
+	CHECK_EQ(ring.PendingSubmits(), 1u);
+	CHECK_EQ(ring.UsedBytes(), 500u);
+
+	queue.CompleteUpTo(empty);
+	ring.Retire();
+	CHECK_EQ(ring.PendingSubmits(), 0u);
+	CHECK_EQ(ring.UsedBytes(), 0u);
+	CHECK_EQ(queue.Stalls(), 0u);
+
+	// Waiting on a finished ticket does not block.
+	ring.WaitForTicket(second);
+	CHECK_EQ(queue.Stalls(), 0u);
+}
+
+TEST(UploadRing, WrapAroundSkipsTheEndOfTheBuffer)
+{
+	SimulatedQueue queue;
+	UploadRing ring(&queue, 1024);
+
+	CHECK_EQ(ring.Allocate(600, 4), 0u);
+	std::uint64_t first = ring.Submit();
+	CHECK_EQ(ring.Allocate(300, 4), 600u);
+	ring.Submit();
+
+	// 200 bytes do not fit before the end, and the start is still in flight: the ring
+	// waits for the first submit only, then wraps.
+	CHECK_EQ(ring.Allocate(200, 4), 0u);
+	CHECK_EQ(queue.Stalls(), 1u);
+	CHECK(ring.IsComplete(first));
+	CHECK_EQ(ring.PendingSubmits(), 1u);
+	// The skipped 124 bytes at the end stay in use until the second submit retires.
+	CHECK_EQ(ring.UsedBytes(), 300u + 124u + 200u);
+
+	// An empty ring restarts where the head is, without counting the skipped bytes.
+	ring.Submit();
+	queue.CompleteUpTo(queue.Submitted());
+	ring.Retire();
+	CHECK_EQ(ring.UsedBytes(), 0u);
+	CHECK_EQ(ring.Allocate(1000, 4), 0u);
+	CHECK_EQ(ring.UsedBytes(), 1000u);
+}
+
+TEST(UploadRing, FullRingSubmitsAndStalls)
+{
+	SimulatedQueue queue;
+	UploadRing ring(&queue, 1024);
+
+	// Nothing submitted yet: the full ring submits its own allocations to wait for them.
+	for (int i = 0; i < 4; ++i)
+		CHECK_EQ(ring.Allocate(256, 256), (std::uint64_t)i * 256);
+	CHECK_EQ(queue.Submitted(), 0u);
+	CHECK_EQ(ring.Allocate(256, 256), 0u);
+	CHECK_EQ(queue.Submitted(), 1u);
+	CHECK_EQ(queue.Stalls(), 1u);
+	CHECK_EQ(ring.UsedBytes(), 256u);
+
+	// An allocation as large as the ring waits for everything before it.
+	ring.Submit();
+	CHECK_EQ(ring.Allocate(1024, 4), 0u);
+	CHECK_EQ(queue.Stalls(), 2u);
+	CHECK_EQ(ring.UsedBytes(), 1024u);
+}
+
+TEST(UploadRing, RandomTimelineNeverReusesBytesInFlight)
+{
+	struct Allocation
+	{
+		std::uint64_t Offset;
+		std::uint64_t Size;
+		// 0 until submitted.
+		std::uint64_t Ticket;
+	};
+
+	const std::uint64_t ringSize = 64 * 1024;
+	SimulatedQueue queue;
+	UploadRing ring(&queue, ringSize);
+
+	std::mt19937 rng(12);
+	std::uniform_int_distribution<std::uint64_t> size(1, 9000);
+	std::uniform_int_distribution<int> alignmentShift(0, 9);
+	std::uniform_int_distribution<int> action(0, 9);
+
+	std::vector<Allocation> inFlight;
+	std::uint32_t overlaps = 0;
+	std::uint32_t outside = 0;
+	std::uint32_t misaligned = 0;
+	std::uint32_t overfull = 0;
+	for (int step = 0; step < 20000; ++step)
+	{
+		int a = action(rng);
+		if (a < 6)
+		{
+			std::uint64_t alignment = std::uint64_t(1) << alignmentShift(rng);
+			std::uint64_t bytes = size(rng);
+			std::uint64_t submitted = queue.Submitted();
+			std::uint64_t offset = ring.Allocate(bytes, alignment);
+
+			// A full ring with nothing submitted submits the pending allocations itself.
+			if (queue.Submitted() != submitted)
+			{
+				for (Allocation& x : inFlight)
+					x.Ticket = x.Ticket != 0 ? x.Ticket : submitted + 1;
+			}
+			// Stalls may have finished submits, their bytes are free now.
+			std::erase_if(inFlight, [&](const Allocation& x) { return x.Ticket != 0 && ring.IsComplete(x.Ticket); });
+			for (const Allocation& x : inFlight)
+				overlaps += offset < x.Offset + x.Size && x.Offset < offset + bytes;
+			outside += offset + bytes > ringSize;
+			misaligned += offset % alignment != 0;
+			overfull += ring.UsedBytes() > ringSize;
+			inFlight.push_back({ offset, bytes, 0 });
+		}
+		else if (a < 9)
+		{
+			std::uint64_t ticket = ring.Submit();
+			for (Allocation& x : inFlight)
+				x.Ticket = x.Ticket != 0 ? x.Ticket : ticket;
+		}
+		else
+		{
+			// The GPU runs one to three submits behind, like a frame or two of latency.
+			std::uint64_t frame = queue.Submitted() - std::min<std::uint64_t>(queue.Submitted(), std::uniform_int_distribution<int>(1, 3)(rng));
+			queue.CompleteUpTo(frame);
+			ring.Retire();
+			std::erase_if(inFlight, [&](const Allocation& x) { return x.Ticket != 0 && ring.IsComplete(x.Ticket); });
+		}
+	}
+
+	CHECK_EQ(overlaps, 0u);
+	CHECK_EQ(outside, 0u);
+	CHECK_EQ(misaligned, 0u);
+	CHECK_EQ(overfull, 0u);
+	// The timeline keeps up most of the time, so the ring rarely has to block.
+	CHECK_GT(queue.Stalls(), 0u);
+	CHECK_LT(queue.Stalls(), queue.Submitted() / 4);
+
+	// Everything retires once the GPU catches up.
+	std::uint64_t last = ring.Submit();
+	ring.WaitForTicket(last);
+	CHECK_EQ(ring.PendingSubmits(), 0u);
+	CHECK_EQ(ring.UsedBytes(), 0u);
+}
@@ -0,0 +1,79 @@
+#include "Engine.h"
+#include "Common/VertexPacking.h"
+#include "Benchmark.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+
+namespace
+{
+	// The layout of the engine's float vertex: position, normal and texture coordinates.
+	struct FloatVertex
+	{
+		float Position[3];
+		float Normal[3];
+		float TexC[2];
+	};
+	const FloatVertexLayout Layout = { sizeof(FloatVertex), offsetof(FloatVertex, Normal), offsetof(FloatVertex, TexC) };
+}
+
+// Packs the shipped models into 16-byte vertices and unpacks them again, and prints the
+// time it takes with the largest reconstruction errors.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 20;
+
+	for (const char* name : { "car", "skull" })
+	{
+		std::vector<std::uint8_t> bytes = TempDirectory::Read(
+			(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (std::string(name) + ".txt")).wstring());
+		TextModel model;
+		if (!TextModel::Parse(std::string(bytes.begin(), bytes.end()), model))
+		{
+			std::printf("%s: cannot parse\n", name);
+			return 1;
+		}
+
+		// Texture coordinates from a spherical mapping, repeated four times around.
+		std::vector<FloatVertex> vertices(model.VertexCount());
+		for (std::uint32_t v = 0; v < model.VertexCount(); ++v)
+		{
+			const float* source = &model.Vertices[6 * (size_t)v];
+			std::memcpy(vertices[v].Position, source, sizeof(vertices[v].Position));
+			std::memcpy(vertices[v].Normal, source + 3, sizeof(vertices[v].Normal));
+			vertices[v].TexC[0] = 2.0f * (std::atan2(source[2], source[0]) / 3.14159265f + 1.0f);
+			vertices[v].TexC[1] = 0.1f * source[1];
+		}
+		const size_t count = vertices.size();
+
+		PositionQuantization quantization;
+		std::vector<PackedVertex> packed(count);
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				quantization = VertexPacker::ComputeQuantization(vertices.data(), Layout.Stride, count);
+				VertexPacker::Pack(vertices.data(), Layout, count, quantization, packed.data());
+			});
+		std::printf("%s: %zu vertices, %zu KB -> %zu KB\n", name, count, count * sizeof(FloatVertex) / 1024,
+			count * sizeof(PackedVertex) / 1024);
+		Benchmark::Report("  ComputeQuantization and Pack", ms, (double)count);
+
+		std::vector<FloatVertex> unpacked(count);
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				VertexPacker::Unpack(packed.data(), count, quantization, unpacked.data(), Layout);
+			});
+		Benchmark::Report("  Unpack", ms, (double)count);
+
+		PackingError error = VertexPacker::MeasureError(vertices.data(), Layout, packed.data(), count, quantization);
+		float extent = std::sqrt(quantization.Scale[0] * quantization.Scale[0] + quantization.Scale[1] * quantization.Scale[1] +
+			quantization.Scale[2] * quantization.Scale[2]);
+		std::printf("  position error %.2e of extent %.3f, normal error %.4f degrees, texture coordinate error %.2e\n",
+			error.Position, extent, error.Normal, error.TexC);
+	}
+
+	return 0;
+}
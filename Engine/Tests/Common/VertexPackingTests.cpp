@@ -0,0 +1,314 @@
+#include "Engine.h"
+#include "Common/VertexPacking.h"
+#include "Test.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
+namespace
+{
+	// Position, normal and texture coordinates.
+	struct FloatVertex
+	{
+		float Position[3];
+		float Normal[3];
+		float TexC[2];
+	};
+	const FloatVertexLayout Layout = { sizeof(FloatVertex), offsetof(FloatVertex, Normal), offsetof(FloatVertex, TexC) };
+
+	std::uint32_t Bits(float f)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &f, sizeof(bits));
+		return bits;
+	}
+
+	float FromBits(std::uint32_t bits)
+	{
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		return f;
+	}
+
+	// IEEE half conversions one value at a time.
+	std::uint16_t FloatToHalf(float f)
+	{
+		std::uint32_t bits = Bits(f);
+		std::uint16_t sign = (std::uint16_t)((bits >> 16) & 0x8000);
+		std::uint32_t magnitude = bits & 0x7fffffff;
+		if (magnitude > 0x7f800000)
+			return sign | 0x7e00;
+		// 65520 and up round past the largest half, 65504.
+		if (magnitude >= 0x477ff000)
+			return sign | 0x7c00;
+		// Below 2^-14 the half is a multiple of 2^-24, and scaling by 2^24 is exact.
+		if (magnitude < 0x38800000)
+			return sign | (std::uint16_t)std::nearbyint(FromBits(magnitude) * 16777216.0f);
+
+		std::uint32_t half = (((magnitude >> 23) - 112) << 10) | ((magnitude >> 13) & 0x3ff);
+		std::uint32_t rest = magnitude & 0x1fff;
+		if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+			++half;
+		return sign | (std::uint16_t)half;
+	}
+
+	float HalfToFloat(std::uint16_t h)
+	{
+		float sign = (h & 0x8000) ? -1.0f : 1.0f;
+		std::uint32_t exponent = (h >> 10) & 0x1f;
+		std::uint32_t mantissa = h & 0x3ff;
+		if (exponent == 0)
+			return sign * std::ldexp((float)mantissa, -24);
+		if (exponent == 31)
+			return mantissa == 0 ? sign * INFINITY : NAN;
+		return sign * std::ldexp((float)(mantissa | 0x400), (int)exponent - 25);
+	}
+
+	std::vector<FloatVertex> Unpacked(const std::vector<PackedVertex>& packed, const PositionQuantization& quantization)
+	{
+		std::vector<FloatVertex> vertices(packed.size());
+		VertexPacker::Unpack(packed.data(), packed.size(), quantization, vertices.data(), Layout);
+		return vertices;
+	}
+
+	// In double from the cross product, which resolves the small angles the packing loses.
+	double AngleDegrees(const float* a, const float* b)
+	{
+		double cross[3] = {
+			(double)a[1] * b[2] - (double)a[2] * b[1],
+			(double)a[2] * b[0] - (double)a[0] * b[2],
+			(double)a[0] * b[1] - (double)a[1] * b[0] };
+		double dot = (double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2];
+		return std::atan2(std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]), dot) * 180.0 / 3.14159265358979;
+	}
+
+	// Half a unorm step, plus the rounding of offset + unorm * scale in float.
+	float PositionBound(const PositionQuantization& quantization, int c)
+	{
+		return 0.5f * quantization.Scale[c] / 65535.0f + (std::fabs(quantization.Offset[c]) + quantization.Scale[c]) * 2.4e-7f;
+	}
+
+	// The text models with texture coordinates from a spherical mapping, repeated four
+	// times around.
+	std::vector<FloatVertex> LoadModel(const std::string& name)
+	{
+		std::vector<std::uint8_t> bytes = TempDirectory::Read(
+			(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (name + ".txt")).wstring());
+		TextModel model;
+		if (!TextModel::Parse(std::string(bytes.begin(), bytes.end()), model))
+			return {};
+
+		std::vector<FloatVertex> vertices(model.VertexCount());
+		for (std::uint32_t v = 0; v < model.VertexCount(); ++v)
+		{
+			const float* source = &model.Vertices[6 * (size_t)v];
+			FloatVertex& vertex = vertices[v];
+			std::memcpy(vertex.Position, source, sizeof(vertex.Position));
+			std::memcpy(vertex.Normal, source + 3, sizeof(vertex.Normal));
+			vertex.TexC[0] = 2.0f * (std::atan2(source[2], source[0]) / 3.14159265f + 1.0f);
+			vertex.TexC[1] = 0.1f * source[1];
+		}
+		return vertices;
+	}
+}
+
+TEST(VertexPacking, HalvesMatchTheScalarConversion)
+{
+	// Every half unpacks to its value and packs back to itself, NaN to the quiet NaN.
+	std::vector<PackedVertex> packed(65536);
+	for (std::uint32_t h = 0; h < 65536; ++h)
+	{
+		packed[h] = {};
+		packed[h].TexC[0] = (std::uint16_t)h;
+		packed[h].TexC[1] = (std::uint16_t)(h ^ 0x8000);
+	}
+	std::vector<FloatVertex> vertices = Unpacked(packed, PositionQuantization());
+	std::uint32_t wrongFloats = 0;
+	for (std::uint32_t h = 0; h < 65536; ++h)
+	{
+		float expected = HalfToFloat((std::uint16_t)h);
+		float value = vertices[h].TexC[0];
+		wrongFloats += std::isnan(expected) ? !std::isnan(value) : Bits(value) != Bits(expected);
+	}
+	CHECK_EQ(wrongFloats, 0u);
+
+	std::vector<PackedVertex> repacked(packed.size());
+	VertexPacker::Pack(vertices.data(), Layout, vertices.size(), PositionQuantization(), repacked.data());
+	std::uint32_t wrongHalves = 0;
+	for (std::uint32_t h = 0; h < 65536; ++h)
+	{
+		bool isNan = (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+		std::uint16_t expected = isNan ? (std::uint16_t)((h & 0x8000) | 0x7e00) : (std::uint16_t)h;
+		wrongHalves += repacked[h].TexC[0] != expected;
+	}
+	CHECK_EQ(wrongHalves, 0u);
+
+	// Random floats over the whole range, halfway cases, the overflow threshold and the
+	// smallest subnormals.
+	std::mt19937 rng(23);
+	std::uniform_int_distribution<std::uint32_t> anyBits;
+	std::uniform_int_distribution<std::uint32_t> halfRange(0x33000000, 0x47800000);
+	vertices.assign(100000, FloatVertex{});
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		vertices[i].TexC[0] = FromBits(i % 2 == 0 ? anyBits(rng) : halfRange(rng) | (anyBits(rng) & 0x80000000));
+		vertices[i].TexC[1] = FromBits((halfRange(rng) & ~0x1fffu) | 0x1000);
+	}
+	for (float f : { 65504.0f, 65519.99f, 65520.0f, 5.96046448e-8f, 2.98023224e-8f, 2.98023259e-8f, 6.09755516e-5f, 0.0f, -0.0f })
+		vertices.push_back({ {}, {}, { f, -f } });
+
+	repacked.resize(vertices.size());
+	VertexPacker::Pack(vertices.data(), Layout, vertices.size(), PositionQuantization(), repacked.data());
+	wrongHalves = 0;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		for (int c = 0; c < 2; ++c)
+			wrongHalves += repacked[i].TexC[c] != FloatToHalf(vertices[i].TexC[c]);
+	}
+	CHECK_EQ(wrongHalves, 0u);
+}
+
+TEST(VertexPacking, RoundTripErrorIsBounded)
+{
+	std::mt19937 rng(24);
+	std::uniform_real_distribution<float> coordinate(-50.0f, 120.0f);
+	std::normal_distribution<float> normal;
+	std::uniform_real_distribution<float> texC(-4.0f, 4.0f);
+
+	std::vector<FloatVertex> vertices(10001);
+	for (FloatVertex& vertex : vertices)
+	{
+		for (float& p : vertex.Position)
+			p = coordinate(rng);
+		for (float& n : vertex.Normal)
+			n = normal(rng);
+		vertex.TexC[0] = texC(rng);
+		vertex.TexC[1] = texC(rng);
+	}
+	// Axes, the folds of the octahedron and normals that are not unit length.
+	const float axes[][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 },
+		{ 1, 1, 0 }, { -1, 0, -1 }, { 0, -3, -3 }, { 1, 1, 1e-7f }, { 1, 1, -1e-7f }, { 0.001f, 0, -0.001f } };
+	for (size_t i = 0; i < sizeof(axes) / sizeof(axes[0]); ++i)
+		std::memcpy(vertices[i].Normal, axes[i], sizeof(axes[i]));
+
+	PositionQuantization quantization = VertexPacker::ComputeQuantization(vertices.data(), Layout.Stride, vertices.size());
+	std::vector<PackedVertex> packed(vertices.size());
+	VertexPacker::Pack(vertices.data(), Layout, vertices.size(), quantization, packed.data());
+	std::vector<FloatVertex> unpacked = Unpacked(packed, quantization);
+
+	// Half a unorm step per axis, a 16-bit octahedral normal stays within a few
+	// thousandths of a degree, and a half keeps 11 significant bits.
+	float positionError = 0.0f, texCError = 0.0f, normalLength = 0.0f;
+	double normalError = 0.0;
+	std::uint32_t outsideStep = 0;
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			float error = std::fabs(vertices[i].Position[c] - unpacked[i].Position[c]);
+			positionError = std::max(positionError, error);
+			outsideStep += error > PositionBound(quantization, c);
+		}
+		normalError = std::max(normalError, AngleDegrees(vertices[i].Normal, unpacked[i].Normal));
+		const float* n = unpacked[i].Normal;
+		normalLength = std::max(normalLength, std::fabs(std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) - 1.0f));
+		for (int c = 0; c < 2; ++c)
+			texCError = std::max(texCError, std::fabs(vertices[i].TexC[c] - unpacked[i].TexC[c]) / std::max(1.0f, std::fabs(vertices[i].TexC[c])));
+	}
+	CHECK_EQ(outsideStep, 0u);
+	CHECK_LT(normalError, 0.005);
+	CHECK_LT(normalLength, 1e-5f);
+	CHECK_LE(texCError, 1.0f / 2048.0f);
+
+	// MeasureError reports the same largest differences.
+	PackingError error = VertexPacker::MeasureError(vertices.data(), Layout, packed.data(), vertices.size(), quantization);
+	CHECK_EQ(error.Position, positionError);
+	CHECK_NEAR(error.Normal, normalError, 1e-4);
+	CHECK_LT(error.TexC, 4.0f / 2048.0f);
+
+	// The smallest coordinate on each axis is the offset and comes back exactly.
+	for (int c = 0; c < 3; ++c)
+	{
+		auto lowest = std::min_element(vertices.begin(), vertices.end(),
+			[c](const FloatVertex& a, const FloatVertex& b) { return a.Position[c] < b.Position[c]; });
+		CHECK_EQ(lowest->Position[c], quantization.Offset[c]);
+		CHECK_EQ(unpacked[lowest - vertices.begin()].Position[c], quantization.Offset[c]);
+	}
+}
+
+TEST(VertexPacking, PacksTheSameWhereverAVertexIs)
+{
+	std::mt19937 rng(25);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+	std::vector<FloatVertex> vertices(7);
+	for (FloatVertex& vertex : vertices)
+	{
+		for (float& p : vertex.Position)
+			p = value(rng);
+		for (float& n : vertex.Normal)
+			n = value(rng);
+		vertex.TexC[0] = value(rng);
+		vertex.TexC[1] = value(rng);
+	}
+	PositionQuantization quantization = VertexPacker::ComputeQuantization(vertices.data(), Layout.Stride, vertices.size());
+
+	// Every count up to seven, so the tail of each group of four is covered, and nothing
+	// past the count is written.
+	std::vector<PackedVertex> all(vertices.size());
+	VertexPacker::Pack(vertices.data(), Layout, vertices.size(), quantization, all.data());
+	for (size_t first = 0; first < vertices.size(); ++first)
+	{
+		for (size_t count = 1; first + count <= vertices.size(); ++count)
+		{
+			std::vector<PackedVertex> part(count + 1);
+			std::memset(&part[count], 0xAB, sizeof(PackedVertex));
+			VertexPacker::Pack(&vertices[first], Layout, count, quantization, part.data());
+			CHECK(std::memcmp(part.data(), &all[first], count * sizeof(PackedVertex)) == 0);
+			CHECK_EQ(part[count].Position[0], 0xABABu);
+
+			std::vector<FloatVertex> unpacked(count + 1);
+			std::memset(&unpacked[count], 0xCD, sizeof(FloatVertex));
+			VertexPacker::Unpack(part.data(), count, quantization, unpacked.data(), Layout);
+			CHECK_EQ(Bits(unpacked[count].Position[0]), 0xCDCDCDCDu);
+		}
+	}
+
+	// A flat axis has no extent and unpacks to its offset.
+	for (FloatVertex& vertex : vertices)
+		vertex.Position[1] = 3.5f;
+	quantization = VertexPacker::ComputeQuantization(vertices.data(), Layout.Stride, vertices.size());
+	CHECK_EQ(quantization.Scale[1], 0.0f);
+	VertexPacker::Pack(vertices.data(), Layout, vertices.size(), quantization, all.data());
+	std::vector<FloatVertex> unpacked = Unpacked(all, quantization);
+	std::uint32_t moved = 0;
+	for (const FloatVertex& vertex : unpacked)
+		moved += vertex.Position[1] != 3.5f;
+	CHECK_EQ(moved, 0u);
+
+	// Nothing to bound.
+	quantization = VertexPacker::ComputeQuantization(nullptr, Layout.Stride, 0);
+	CHECK_EQ(quantization.Scale[0], 1.0f);
+}
+
+TEST(VertexPacking, ShippedModelsStayWithinOneStep)
+{
+	for (const char* name : { "car", "skull" })
+	{
+		std::vector<FloatVertex> vertices = LoadModel(name);
+		REQUIRE(!vertices.empty());
+		PositionQuantization quantization = VertexPacker::ComputeQuantization(vertices.data(), Layout.Stride, vertices.size());
+		std::vector<PackedVertex> packed(vertices.size());
+		VertexPacker::Pack(vertices.data(), Layout, vertices.size(), quantization, packed.data());
+		PackingError error = VertexPacker::MeasureError(vertices.data(), Layout, packed.data(), vertices.size(), quantization);
+
+		float bound = std::max({ PositionBound(quantization, 0), PositionBound(quantization, 1), PositionBound(quantization, 2) });
+		CHECK_MSG(error.Position <= bound, name << ": position error " << error.Position << ", bound " << bound);
+		CHECK_MSG(error.Normal < 0.005f, name << ": normal error " << error.Normal);
+		CHECK_MSG(error.TexC <= 4.0f / 2048.0f, name << ": texture coordinate error " << error.TexC);
+	}
+}
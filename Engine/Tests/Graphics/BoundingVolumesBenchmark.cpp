@@ -0,0 +1,114 @@
+#include "Engine.h"
+#include "Graphics/BoundingVolumes.h"
+#include "Graphics/FrustumCuller.h"
+#include "Benchmark.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <filesystem>
+#include <random>
+
+using namespace DirectX;
+
+// Builds the volumes of the shipped models and of a turned plank, then scatters turned
+// copies of each around a frustum and counts the copies that are drawn with all their
+// vertices outside it, with the built volumes and with the axis-aligned box alone.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 20;
+	const UINT itemCount = quick ? 500 : 5000;
+
+	for (const char* name : { "car", "skull", "plank" })
+	{
+		// The plank is a long thin box turned off the axes, where the oriented box helps most.
+		TextModel model;
+		if (std::string(name) == "plank")
+		{
+			std::mt19937 rng(6);
+			std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+			XMMATRIX turn = XMMatrixRotationRollPitchYaw(0.6f, 0.4f, 0.9f);
+			model.Vertices.resize(6 * 4096);
+			for (size_t v = 0; v < 4096; ++v)
+			{
+				XMVECTOR p = XMVector3TransformCoord(XMVectorSet(6.0f * unit(rng), 0.5f * unit(rng), 0.2f * unit(rng), 1.0f), turn);
+				XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&model.Vertices[6 * v]), p);
+			}
+		}
+		else
+		{
+			std::vector<std::uint8_t> bytes = TempDirectory::Read(
+				(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (std::string(name) + ".txt")).wstring());
+			if (!TextModel::Parse(std::string(bytes.begin(), bytes.end()), model))
+			{
+				std::printf("%s: cannot parse\n", name);
+				return 1;
+			}
+		}
+
+		const size_t stride = 6 * sizeof(float);
+		BoundingVolumes volumes;
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				volumes = BoundsBuilder::Build(model.Vertices.data(), stride, model.VertexCount());
+			});
+		std::printf("%s: %u vertices\n", name, model.VertexCount());
+		Benchmark::Report("  BoundsBuilder::Build", ms, model.VertexCount());
+
+		const XMFLOAT3& e = volumes.Box.Extents;
+		const XMFLOAT3& o = volumes.OrientedBox.Extents;
+		std::printf("  box volume %.1f, oriented box volume %.1f, sphere radius %.2f of box radius %.2f\n",
+			8.0f * e.x * e.y * e.z, 8.0f * o.x * o.y * o.z, volumes.Sphere.Radius,
+			XMVectorGetX(XMVector3Length(XMLoadFloat3(&e))));
+
+		BoundingVolumes boxOnly;
+		boxOnly.Box = volumes.Box;
+		boxOnly.Sphere = BoundingSphere(volumes.Box.Center, XMVectorGetX(XMVector3Length(XMLoadFloat3(&e))));
+		boxOnly.OrientedBox = BoundingOrientedBox(volumes.Box.Center, e, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+		// Copies within a few model sizes of the frustum's sides, where the volumes matter.
+		float size = volumes.Sphere.Radius;
+		std::mt19937 rng(25);
+		std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+		std::uniform_real_distribution<float> lateral(-12.0f * size, 12.0f * size);
+		std::uniform_real_distribution<float> depth(-2.0f * size, 30.0f * size);
+
+		FrustumCuller tight, loose;
+		tight.Resize(itemCount);
+		loose.Resize(itemCount);
+		std::vector<XMFLOAT4X4> worlds(itemCount);
+		for (UINT i = 0; i < itemCount; ++i)
+		{
+			XMStoreFloat4x4(&worlds[i], XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+				XMMatrixTranslation(lateral(rng), lateral(rng), depth(rng)));
+			tight.UpdateBounds(i, volumes, worlds[i]);
+			loose.UpdateBounds(i, boxOnly, worlds[i]);
+		}
+
+		BoundingFrustum frustum(XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 25.0f * size));
+		tight.Cull(frustum);
+		loose.Cull(frustum);
+
+		UINT visible = 0;
+		for (UINT i = 0; i < itemCount; ++i)
+		{
+			XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+			for (std::uint32_t v = 0; v < model.VertexCount(); ++v)
+			{
+				XMVECTOR p = XMVector3TransformCoord(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&model.Vertices[6 * (size_t)v])), world);
+				if (frustum.Contains(p) != DISJOINT)
+				{
+					++visible;
+					break;
+				}
+			}
+		}
+
+		std::printf("  %u of %u copies have a vertex in the frustum\n", visible, itemCount);
+		std::printf("  drawn with the box alone %zu (%zu outside), with the volumes %zu (%zu outside)\n",
+			loose.VisibleIndices().size(), loose.VisibleIndices().size() - visible,
+			tight.VisibleIndices().size(), tight.VisibleIndices().size() - visible);
+	}
+
+	return 0;
+}
@@ -0,0 +1,289 @@
+#include "Engine.h"
+#include "Graphics/BoundingVolumes.h"
+#include "Graphics/FrustumCuller.h"
+
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Position followed by a normal, like the engine's vertices, so the stride is not 12.
+	struct Point
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+	};
+
+	BoundingVolumes Build(const std::vector<Point>& points)
+	{
+		return BoundsBuilder::Build(points.data(), sizeof(Point), points.size());
+	}
+
+	// Points inside a box with the given extents, turned and moved.  Half of them are on its
+	// faces so the box is what the points fill.
+	std::vector<Point> TurnedBox(std::mt19937& rng, size_t count, XMFLOAT3 extents, FXMMATRIX world)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Point> points(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			float p[3] = { unit(rng), unit(rng), unit(rng) };
+			if (i % 2 == 0)
+				p[i / 2 % 3] = (i / 6) % 2 == 0 ? -1.0f : 1.0f;
+			XMVECTOR local = XMVectorSet(p[0] * extents.x, p[1] * extents.y, p[2] * extents.z, 1.0f);
+			XMStoreFloat3(&points[i].Position, XMVector3TransformCoord(local, world));
+			points[i].Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		}
+		return points;
+	}
+
+	// Counts the points outside each volume by more than tolerance times its size.
+	struct Outside
+	{
+		size_t Box = 0;
+		size_t Sphere = 0;
+		size_t OrientedBox = 0;
+	};
+
+	Outside CountOutside(const BoundingVolumes& volumes, const std::vector<Point>& points, float tolerance = 1e-5f)
+	{
+		Outside outside;
+		XMVECTOR boxCenter = XMLoadFloat3(&volumes.Box.Center);
+		XMVECTOR boxExtents = XMLoadFloat3(&volumes.Box.Extents);
+		XMVECTOR sphereCenter = XMLoadFloat3(&volumes.Sphere.Center);
+		XMVECTOR orientedCenter = XMLoadFloat3(&volumes.OrientedBox.Center);
+		XMVECTOR orientedExtents = XMLoadFloat3(&volumes.OrientedBox.Extents);
+		XMVECTOR orientation = XMLoadFloat4(&volumes.OrientedBox.Orientation);
+		float size = std::max(volumes.Sphere.Radius, 1.0f);
+
+		for (const Point& point : points)
+		{
+			XMVECTOR p = XMLoadFloat3(&point.Position);
+			XMVECTOR slack = XMVectorReplicate(tolerance * size);
+			outside.Box += !XMVector3LessOrEqual(XMVectorAbs(p - boxCenter), boxExtents + slack);
+			outside.Sphere += XMVectorGetX(XMVector3Length(p - sphereCenter)) > volumes.Sphere.Radius + tolerance * size;
+			XMVECTOR local = XMVector3InverseRotate(p - orientedCenter, orientation);
+			outside.OrientedBox += !XMVector3LessOrEqual(XMVectorAbs(local), orientedExtents + slack);
+		}
+		return outside;
+	}
+
+	float Volume(const XMFLOAT3& extents)
+	{
+		return 8.0f * extents.x * extents.y * extents.z;
+	}
+}
+
+TEST(BoundsBuilder, VolumesContainEveryPoint)
+{
+	std::mt19937 rng(25);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> offset(-100.0f, 100.0f);
+
+	// Counts around the four points a pass reads at once.
+	for (size_t count : { 1, 2, 3, 4, 5, 7, 8, 9, 63, 1000 })
+	{
+		for (int trial = 0; trial < 20; ++trial)
+		{
+			XMMATRIX world = XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+				XMMatrixTranslation(offset(rng), offset(rng), offset(rng));
+			std::vector<Point> points = TurnedBox(rng, count, XMFLOAT3(4.0f, 1.0f, 0.25f), world);
+			BoundingVolumes volumes = Build(points);
+
+			Outside outside = CountOutside(volumes, points);
+			CHECK_MSG(outside.Box == 0, count << " points: " << outside.Box << " outside the box");
+			CHECK_MSG(outside.Sphere == 0, count << " points: " << outside.Sphere << " outside the sphere");
+			CHECK_MSG(outside.OrientedBox == 0, count << " points: " << outside.OrientedBox << " outside the oriented box");
+		}
+	}
+}
+
+TEST(BoundsBuilder, BoxIsTheExactRange)
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> coordinate(-50.0f, 50.0f);
+	std::vector<Point> points(333);
+	XMFLOAT3 lo(+1e9f, +1e9f, +1e9f), hi(-1e9f, -1e9f, -1e9f);
+	for (Point& point : points)
+	{
+		point.Position = XMFLOAT3(coordinate(rng), coordinate(rng), 0.1f * coordinate(rng));
+		lo = XMFLOAT3(std::min(lo.x, point.Position.x), std::min(lo.y, point.Position.y), std::min(lo.z, point.Position.z));
+		hi = XMFLOAT3(std::max(hi.x, point.Position.x), std::max(hi.y, point.Position.y), std::max(hi.z, point.Position.z));
+	}
+
+	BoundingVolumes volumes = Build(points);
+	const BoundingBox& box = volumes.Box;
+	CHECK_NEAR(box.Center.x - box.Extents.x, lo.x, 1e-5f);
+	CHECK_NEAR(box.Center.y - box.Extents.y, lo.y, 1e-5f);
+	CHECK_NEAR(box.Center.z - box.Extents.z, lo.z, 1e-5f);
+	CHECK_NEAR(box.Center.x + box.Extents.x, hi.x, 1e-5f);
+	CHECK_NEAR(box.Center.y + box.Extents.y, hi.y, 1e-5f);
+	CHECK_NEAR(box.Center.z + box.Extents.z, hi.z, 1e-5f);
+}
+
+TEST(BoundsBuilder, TurnedBoxesGetTightOrientedBoxes)
+{
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	const XMFLOAT3 extents(4.0f, 1.0f, 0.25f);
+
+	float worstRatio = 0.0f;
+	for (int trial = 0; trial < 50; ++trial)
+	{
+		XMMATRIX world = XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) * XMMatrixTranslation(3.0f, -2.0f, 1.0f);
+		std::vector<Point> points = TurnedBox(rng, 2000, extents, world);
+		BoundingVolumes volumes = Build(points);
+
+		// The principal axes of a box full of points are its own axes, so the oriented box
+		// is close to the box the points came from.  The axes of a sample turn a little from
+		// the box's, which widens its thin side most.  Never worse than the axis-aligned one.
+		float orientedVolume = Volume(volumes.OrientedBox.Extents);
+		worstRatio = std::max(worstRatio, orientedVolume / Volume(extents));
+		CHECK_LE(orientedVolume, Volume(volumes.Box.Extents));
+
+		// Ritter's sphere is within a fifth of the half diagonal, the smallest sphere.
+		float halfDiagonal = std::sqrt(extents.x * extents.x + extents.y * extents.y + extents.z * extents.z);
+		CHECK_LE(volumes.Sphere.Radius, 1.2f * halfDiagonal);
+		CHECK_LE(0.99f * halfDiagonal, volumes.Sphere.Radius);
+	}
+	CHECK_LT(worstRatio, 1.2f);
+}
+
+TEST(BoundsBuilder, SymmetricPointsGetTheSphereAroundTheBox)
+{
+	// Points on a sphere: the sphere around the box center is the smallest one, which
+	// Ritter's growing sphere only gets close to.
+	std::mt19937 rng(11);
+	std::normal_distribution<float> normal;
+	std::vector<Point> points(4096);
+	for (Point& point : points)
+	{
+		XMVECTOR d = XMVector3Normalize(XMVectorSet(normal(rng), normal(rng), normal(rng), 0.0f));
+		XMStoreFloat3(&point.Position, XMVectorMultiplyAdd(d, XMVectorReplicate(2.0f), XMVectorSet(5.0f, 6.0f, 7.0f, 0.0f)));
+	}
+
+	BoundingVolumes volumes = Build(points);
+	CHECK_LE(volumes.Sphere.Radius, 2.0f * 1.001f);
+	CHECK_NEAR(volumes.Sphere.Center.x, 5.0f, 0.01f);
+	CHECK_NEAR(volumes.Sphere.Center.y, 6.0f, 0.01f);
+	CHECK_NEAR(volumes.Sphere.Center.z, 7.0f, 0.01f);
+	CHECK_EQ(CountOutside(volumes, points).Sphere, 0u);
+}
+
+TEST(BoundsBuilder, DegeneratePointSets)
+{
+	// No points: empty volumes at the origin.
+	BoundingVolumes empty = BoundsBuilder::Build(nullptr, sizeof(Point), 0);
+	CHECK_EQ(empty.Sphere.Radius, 0.0f);
+	CHECK_EQ(Volume(empty.Box.Extents), 0.0f);
+	CHECK_EQ(Volume(empty.OrientedBox.Extents), 0.0f);
+	CHECK_EQ(empty.OrientedBox.Orientation.w, 1.0f);
+
+	// One point, repeated.
+	std::vector<Point> single(5, Point{ XMFLOAT3(1.0f, -2.0f, 3.0f), XMFLOAT3() });
+	BoundingVolumes volumes = Build(single);
+	CHECK_EQ(volumes.Sphere.Radius, 0.0f);
+	CHECK_EQ(volumes.Box.Center.x, 1.0f);
+	CHECK_EQ(volumes.Box.Center.y, -2.0f);
+	CHECK_EQ(volumes.Box.Center.z, 3.0f);
+	CHECK_EQ(CountOutside(volumes, single).OrientedBox, 0u);
+
+	// A diagonal segment and a tilted plane: the oriented box is flat and still holds them.
+	std::mt19937 rng(5);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<Point> line(100), plane(100);
+	for (size_t i = 0; i < line.size(); ++i)
+	{
+		float t = unit(rng), s = unit(rng);
+		line[i].Position = XMFLOAT3(t, 2.0f * t, -t);
+		plane[i].Position = XMFLOAT3(t, s, 0.5f * t + 0.25f * s);
+	}
+	for (const std::vector<Point>* points : { &line, &plane })
+	{
+		volumes = Build(*points);
+		Outside outside = CountOutside(volumes, *points);
+		CHECK_EQ(outside.Box, 0u);
+		CHECK_EQ(outside.Sphere, 0u);
+		CHECK_EQ(outside.OrientedBox, 0u);
+		CHECK_LE(Volume(volumes.OrientedBox.Extents), 1e-3f);
+	}
+}
+
+TEST(BoundsBuilder, FarFromTheOriginStaysTight)
+{
+	// The covariance sums are taken around the first point, so a small mesh far away still
+	// gets its own axes.
+	std::mt19937 rng(9);
+	XMMATRIX world = XMMatrixRotationRollPitchYaw(0.3f, 0.7f, -0.4f) * XMMatrixTranslation(1e4f, -2e4f, 5e3f);
+	std::vector<Point> points = TurnedBox(rng, 3000, XMFLOAT3(2.0f, 0.5f, 0.1f), world);
+	BoundingVolumes volumes = Build(points);
+
+	Outside outside = CountOutside(volumes, points, 1e-4f);
+	CHECK_EQ(outside.Box, 0u);
+	CHECK_EQ(outside.Sphere, 0u);
+	CHECK_EQ(outside.OrientedBox, 0u);
+	CHECK_LT(Volume(volumes.OrientedBox.Extents), 1.2f * Volume(XMFLOAT3(2.0f, 0.5f, 0.1f)));
+}
+
+TEST(BoundsBuilder, CullingKeepsEveryItemWithAVisiblePoint)
+{
+	// Thin turned planks scattered around a frustum.  An item is culled only when none of its
+	// points is inside, and the built volumes cull more than the axis-aligned box alone.
+	std::mt19937 rng(17);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+	std::uniform_real_distribution<float> depth(-10.0f, 120.0f);
+
+	XMMATRIX plankWorld = XMMatrixRotationRollPitchYaw(0.6f, 0.4f, 0.9f);
+	std::vector<Point> points = TurnedBox(rng, 256, XMFLOAT3(6.0f, 0.5f, 0.2f), plankWorld);
+	BoundingVolumes volumes = Build(points);
+
+	// What culling had before: the box, and the sphere through its corners.
+	BoundingVolumes boxOnly;
+	boxOnly.Box = volumes.Box;
+	boxOnly.Sphere = BoundingSphere(volumes.Box.Center, XMVectorGetX(XMVector3Length(XMLoadFloat3(&volumes.Box.Extents))));
+	boxOnly.OrientedBox = BoundingOrientedBox(volumes.Box.Center, volumes.Box.Extents, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	const UINT itemCount = 2000;
+	FrustumCuller tight, loose;
+	tight.Resize(itemCount);
+	loose.Resize(itemCount);
+	std::vector<XMFLOAT4X4> worlds(itemCount);
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		XMStoreFloat4x4(&worlds[i], XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+			XMMatrixTranslation(position(rng), position(rng), depth(rng)));
+		tight.UpdateBounds(i, volumes, worlds[i]);
+		loose.UpdateBounds(i, boxOnly, worlds[i]);
+	}
+
+	BoundingFrustum frustum(XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 100.0f));
+	tight.Cull(frustum);
+	loose.Cull(frustum);
+
+	std::vector<bool> visible(itemCount, false);
+	for (UINT i : tight.VisibleIndices())
+		visible[i] = true;
+
+	UINT missed = 0, pointVisible = 0;
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+		bool inside = false;
+		for (const Point& point : points)
+			inside = inside || frustum.Contains(XMVector3TransformCoord(XMLoadFloat3(&point.Position), world)) != DISJOINT;
+		pointVisible += inside;
+		missed += inside && !visible[i];
+	}
+	CHECK_EQ(missed, 0u);
+
+	// Fewer false positives over the items whose points are all outside.
+	size_t tightFalse = tight.VisibleIndices().size() - pointVisible;
+	size_t looseFalse = loose.VisibleIndices().size() - pointVisible;
+	CHECK_MSG(2 * tightFalse < looseFalse, tightFalse << " false positives against " << looseFalse);
+}
@@ -0,0 +1,113 @@
+#include "Engine.h"
+#include "Graphics/Bvh.h"
+#include "Benchmark.h"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Same two sided test as TriangleBvh, over every triangle.
+	bool BruteForce(const std::vector<XMFLOAT3>& positions, const std::vector<std::uint32_t>& indices,
+		FXMVECTOR origin, FXMVECTOR direction, float& t)
+	{
+		bool hit = false;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			XMVECTOR v0 = XMLoadFloat3(&positions[indices[i]]);
+			XMVECTOR e1 = XMVectorSubtract(XMLoadFloat3(&positions[indices[i + 1]]), v0);
+			XMVECTOR e2 = XMVectorSubtract(XMLoadFloat3(&positions[indices[i + 2]]), v0);
+
+			XMVECTOR p = XMVector3Cross(direction, e2);
+			float det = XMVectorGetX(XMVector3Dot(e1, p));
+			if (std::fabs(det) < 1e-12f)
+				continue;
+
+			float invDet = 1.0f / det;
+			XMVECTOR s = XMVectorSubtract(origin, v0);
+			float u = XMVectorGetX(XMVector3Dot(s, p)) * invDet;
+			XMVECTOR q = XMVector3Cross(s, e1);
+			float v = XMVectorGetX(XMVector3Dot(direction, q)) * invDet;
+			float tHit = XMVectorGetX(XMVector3Dot(e2, q)) * invDet;
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && tHit >= 0.0f && tHit < t)
+			{
+				t = tHit;
+				hit = true;
+			}
+		}
+		return hit;
+	}
+}
+
+// Picks a height field with rays from above, by testing every triangle and through
+// TriangleBvh.
+int main(int argc, char** argv)
+{
+	const UINT size = Benchmark::IsQuick(argc, argv) ? 32 : 300;
+	const int rayCount = Benchmark::IsQuick(argc, argv) ? 100 : 1000;
+
+	std::vector<XMFLOAT3> positions;
+	for (UINT z = 0; z <= size; ++z)
+	{
+		for (UINT x = 0; x <= size; ++x)
+			positions.push_back(XMFLOAT3((float)x, 2.0f * std::sin(0.3f * x) * std::cos(0.2f * z), (float)z));
+	}
+	std::vector<std::uint32_t> indices;
+	for (UINT z = 0; z < size; ++z)
+	{
+		for (UINT x = 0; x < size; ++x)
+		{
+			std::uint32_t i = z * (size + 1) + x;
+			indices.insert(indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+		}
+	}
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> coordinate(0.0f, (float)size);
+	std::vector<XMFLOAT3> origins(rayCount), directions(rayCount);
+	for (int r = 0; r < rayCount; ++r)
+	{
+		origins[r] = XMFLOAT3(coordinate(rng), 20.0f, coordinate(rng));
+		directions[r] = XMFLOAT3(coordinate(rng) - origins[r].x, -20.0f, coordinate(rng) - origins[r].z);
+	}
+
+	std::printf("%zu triangles, %d rays\n", indices.size() / 3, rayCount);
+
+	TriangleBvh bvh;
+	double ms = Benchmark::BestMilliseconds(3, [&]()
+		{
+			bvh.Build(positions.data(), sizeof(XMFLOAT3), indices.data(), 4, (UINT)indices.size(), 0, 0);
+		});
+	Benchmark::Report("TriangleBvh::Build", ms, (double)indices.size() / 3);
+
+	int bruteForceHits = 0;
+	ms = Benchmark::BestMilliseconds(1, [&]()
+		{
+			bruteForceHits = 0;
+			for (int r = 0; r < rayCount; ++r)
+			{
+				float t = MathHelper::Infinity;
+				bruteForceHits += BruteForce(positions, indices, XMLoadFloat3(&origins[r]), XMLoadFloat3(&directions[r]), t);
+			}
+		});
+	Benchmark::Report("brute force, per ray", ms, rayCount);
+
+	int bvhHits = 0;
+	ms = Benchmark::BestMilliseconds(5, [&]()
+		{
+			bvhHits = 0;
+			for (int r = 0; r < rayCount; ++r)
+			{
+				float t = MathHelper::Infinity;
+				UINT triangle = 0;
+				bvhHits += bvh.Intersect(XMLoadFloat3(&origins[r]), XMLoadFloat3(&directions[r]), t, triangle);
+			}
+		});
+	Benchmark::Report("TriangleBvh::Intersect, per ray", ms, rayCount);
+
+	std::printf("hits: %d brute force, %d bvh\n", bruteForceHits, bvhHits);
+	return bruteForceHits == bvhHits ? 0 : 1;
+}
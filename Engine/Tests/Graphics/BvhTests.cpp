@@ -0,0 +1,310 @@
+#include "Engine.h"
+#include "Graphics/Bvh.h"
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Mesh
+	{
+		std::vector<XMFLOAT3> Positions;
+		std::vector<std::uint32_t> Indices;
+	};
+
+	// Height field with some noise, so the triangles are not axis aligned.
+	Mesh MakeTerrain(UINT size, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> noise(-0.3f, 0.3f);
+
+		Mesh mesh;
+		for (UINT z = 0; z <= size; ++z)
+		{
+			for (UINT x = 0; x <= size; ++x)
+			{
+				float y = 2.0f * std::sin(0.3f * x) * std::cos(0.2f * z) + noise(rng);
+				mesh.Positions.push_back(XMFLOAT3((float)x, y, (float)z));
+			}
+		}
+		for (UINT z = 0; z < size; ++z)
+		{
+			for (UINT x = 0; x < size; ++x)
+			{
+				std::uint32_t i = z * (size + 1) + x;
+				mesh.Indices.insert(mesh.Indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+			}
+		}
+		return mesh;
+	}
+
+	void Store(FXMVECTOR v, double out[3])
+	{
+		XMFLOAT3 f;
+		XMStoreFloat3(&f, v);
+		out[0] = f.x;
+		out[1] = f.y;
+		out[2] = f.z;
+	}
+
+	// Double precision two sided ray/triangle test.
+	bool IntersectTriangle(const double o[3], const double d[3], const XMFLOAT3& a, const XMFLOAT3& b,
+		const XMFLOAT3& c, double& t)
+	{
+		double e1[3] = { b.x - a.x, b.y - a.y, b.z - a.z };
+		double e2[3] = { c.x - a.x, c.y - a.y, c.z - a.z };
+		double p[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+		double det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (std::abs(det) < 1e-12)
+			return false;
+
+		double s[3] = { o[0] - a.x, o[1] - a.y, o[2] - a.z };
+		double u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) / det;
+		double q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+		t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+		return u >= 0.0 && v >= 0.0 && u + v <= 1.0 && t >= 0.0;
+	}
+
+	// Closest hit over all triangles, or -1.
+	double BruteForce(const Mesh& mesh, XMVECTOR origin, XMVECTOR direction, UINT& triangle)
+	{
+		double o[3], d[3];
+		Store(origin, o);
+		Store(direction, d);
+
+		double closest = -1.0;
+		for (UINT i = 0; i < (UINT)mesh.Indices.size() / 3; ++i)
+		{
+			double t;
+			if (IntersectTriangle(o, d, mesh.Positions[mesh.Indices[3 * i]], mesh.Positions[mesh.Indices[3 * i + 1]],
+				mesh.Positions[mesh.Indices[3 * i + 2]], t) && (closest < 0.0 || t < closest))
+			{
+				closest = t;
+				triangle = i;
+			}
+		}
+		return closest;
+	}
+
+	// Rays from above the terrain towards random points on it, some of them grazing.
+	void RandomRay(std::mt19937& rng, float size, XMVECTOR& origin, XMVECTOR& direction)
+	{
+		std::uniform_real_distribution<float> coordinate(-0.1f * size, 1.1f * size);
+		std::uniform_real_distribution<float> height(0.5f, 20.0f);
+		origin = XMVectorSet(coordinate(rng), height(rng), coordinate(rng), 0.0f);
+		XMVECTOR target = XMVectorSet(coordinate(rng), 0.0f, coordinate(rng), 0.0f);
+		direction = XMVectorSubtract(target, origin);
+	}
+}
+
+TEST(Bvh, EveryPrimitiveIsInOneLeaf)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+	std::uniform_real_distribution<float> size(0.1f, 5.0f);
+
+	const UINT count = 1000;
+	std::vector<XMFLOAT3> boundsMin(count), boundsMax(count);
+	for (UINT i = 0; i < count; ++i)
+	{
+		boundsMin[i] = XMFLOAT3(position(rng), position(rng), position(rng));
+		boundsMax[i] = XMFLOAT3(boundsMin[i].x + size(rng), boundsMin[i].y + size(rng), boundsMin[i].z + size(rng));
+	}
+
+	Bvh bvh;
+	bvh.Build(count, boundsMin.data(), boundsMax.data());
+	const std::vector<Bvh::Node>& nodes = bvh.Nodes();
+	REQUIRE(!nodes.empty());
+	CHECK_LT(nodes.size(), 2u * count);
+
+	std::vector<UINT> leafCount(count, 0);
+	for (const Bvh::Node& node : nodes)
+	{
+		if (node.PrimitiveCount == 0)
+		{
+			// Children come after their parent and enclose nothing outside it.
+			REQUIRE(node.LeftFirst + 1 < nodes.size());
+			for (UINT child = node.LeftFirst; child <= node.LeftFirst + 1; ++child)
+			{
+				CHECK(nodes[child].BoundsMin.x >= node.BoundsMin.x && nodes[child].BoundsMax.x <= node.BoundsMax.x);
+				CHECK(nodes[child].BoundsMin.y >= node.BoundsMin.y && nodes[child].BoundsMax.y <= node.BoundsMax.y);
+				CHECK(nodes[child].BoundsMin.z >= node.BoundsMin.z && nodes[child].BoundsMax.z <= node.BoundsMax.z);
+			}
+			continue;
+		}
+
+		for (UINT slot = node.LeftFirst; slot < node.LeftFirst + node.PrimitiveCount; ++slot)
+		{
+			UINT primitive = bvh.PrimitiveIndices()[slot];
+			REQUIRE(primitive < count);
+			leafCount[primitive]++;
+			CHECK(boundsMin[primitive].x >= node.BoundsMin.x && boundsMax[primitive].x <= node.BoundsMax.x);
+			CHECK(boundsMin[primitive].y >= node.BoundsMin.y && boundsMax[primitive].y <= node.BoundsMax.y);
+			CHECK(boundsMin[primitive].z >= node.BoundsMin.z && boundsMax[primitive].z <= node.BoundsMax.z);
+		}
+	}
+	for (UINT i = 0; i < count; ++i)
+		CHECK_EQ(leafCount[i], 1u);
+}
+
+TEST(Bvh, EmptyHierarchyMissesEverything)
+{
+	Bvh bvh;
+	bvh.Build(0, nullptr, nullptr);
+	CHECK(bvh.Empty());
+
+	int leafCalls = 0;
+	float t = bvh.Intersect(XMVectorZero(), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f), 10.0f,
+		[&](UINT, float tMax) { ++leafCalls; return tMax; });
+	CHECK_EQ(t, 10.0f);
+	CHECK_EQ(leafCalls, 0);
+}
+
+TEST(TriangleBvh, PicksTheSameTriangleAsBruteForce)
+{
+	Mesh mesh = MakeTerrain(40, 2);
+	TriangleBvh bvh;
+	bvh.Build(mesh.Positions.data(), sizeof(XMFLOAT3), mesh.Indices.data(), 4, (UINT)mesh.Indices.size(), 0, 0);
+	CHECK_EQ(bvh.TriangleCount(), (UINT)mesh.Indices.size() / 3);
+
+	std::mt19937 rng(3);
+	UINT hitCount = 0;
+	for (int r = 0; r < 2000; ++r)
+	{
+		XMVECTOR origin, direction;
+		RandomRay(rng, 40.0f, origin, direction);
+
+		UINT expectedTriangle = 0;
+		double expectedT = BruteForce(mesh, origin, direction, expectedTriangle);
+
+		float t = MathHelper::Infinity;
+		UINT triangle = 0;
+		bool hit = bvh.Intersect(origin, direction, t, triangle);
+
+		CHECK_MSG(hit == (expectedT >= 0.0), "ray " << r);
+		if (!hit || expectedT < 0.0)
+			continue;
+
+		++hitCount;
+		CHECK_NEAR(t, expectedT, 1e-4);
+
+		// Rays through a shared edge may report either triangle, at the same distance.
+		if (triangle != expectedTriangle)
+		{
+			double o[3], d[3];
+			Store(origin, o);
+			Store(direction, d);
+			double otherT = -1.0;
+			bool otherHit = IntersectTriangle(o, d, mesh.Positions[mesh.Indices[3 * triangle]],
+				mesh.Positions[mesh.Indices[3 * triangle + 1]], mesh.Positions[mesh.Indices[3 * triangle + 2]], otherT);
+			CHECK_MSG(otherHit && std::abs(otherT - expectedT) < 1e-4, "ray " << r << " triangle " << triangle);
+		}
+	}
+	CHECK_GT(hitCount, 1000u);
+}
+
+TEST(TriangleBvh, ReadsSixteenBitIndexRanges)
+{
+	Mesh mesh = MakeTerrain(8, 4);
+
+	// Put the mesh after some padding vertices and indices, as a submesh of a larger buffer.
+	const UINT baseVertex = 5;
+	const UINT startIndex = 12;
+	std::vector<XMFLOAT3> vertices(baseVertex, XMFLOAT3(1000.0f, 1000.0f, 1000.0f));
+	vertices.insert(vertices.end(), mesh.Positions.begin(), mesh.Positions.end());
+	std::vector<std::uint16_t> indices(startIndex, 0);
+	for (std::uint32_t index : mesh.Indices)
+		indices.push_back((std::uint16_t)index);
+
+	TriangleBvh bvh;
+	bvh.Build(vertices.data(), sizeof(XMFLOAT3), indices.data(), 2, (UINT)mesh.Indices.size(), startIndex, baseVertex);
+
+	BoundingBox bounds = bvh.Bounds();
+	CHECK_NEAR(bounds.Center.x, 4.0f, 1e-5f);
+	CHECK_NEAR(bounds.Extents.x, 4.0f, 1e-5f);
+
+	XMVECTOR origin = XMVectorSet(3.3f, 10.0f, 5.6f, 0.0f);
+	XMVECTOR direction = XMVectorSet(0.0f, -1.0f, 0.0f, 0.0f);
+	UINT expectedTriangle = 0;
+	double expectedT = BruteForce(mesh, origin, direction, expectedTriangle);
+
+	float t = MathHelper::Infinity;
+	UINT triangle = 0;
+	REQUIRE(bvh.Intersect(origin, direction, t, triangle));
+	CHECK_EQ(triangle, expectedTriangle);
+	CHECK_NEAR(t, expectedT, 1e-4);
+
+	// Nothing is closer than a hit limit in front of the surface.
+	t = (float)expectedT * 0.5f;
+	CHECK(!bvh.Intersect(origin, direction, t, triangle));
+}
+
+TEST(Bvh, RefitFollowsMovedPrimitives)
+{
+	Mesh mesh = MakeTerrain(16, 5);
+	UINT triangleCount = (UINT)mesh.Indices.size() / 3;
+
+	std::vector<XMFLOAT3> boundsMin(triangleCount), boundsMax(triangleCount);
+	auto computeBounds = [&]()
+		{
+			for (UINT i = 0; i < triangleCount; ++i)
+			{
+				boundsMin[i] = boundsMax[i] = mesh.Positions[mesh.Indices[3 * i]];
+				for (int k = 1; k < 3; ++k)
+				{
+					const XMFLOAT3& p = mesh.Positions[mesh.Indices[3 * i + k]];
+					boundsMin[i] = XMFLOAT3(std::min(boundsMin[i].x, p.x), std::min(boundsMin[i].y, p.y), std::min(boundsMin[i].z, p.z));
+					boundsMax[i] = XMFLOAT3(std::max(boundsMax[i].x, p.x), std::max(boundsMax[i].y, p.y), std::max(boundsMax[i].z, p.z));
+				}
+			}
+		};
+	computeBounds();
+
+	Bvh bvh;
+	bvh.Build(triangleCount, boundsMin.data(), boundsMax.data());
+
+	// Lift the terrain and refit, the old topology has to find the new hits.
+	for (XMFLOAT3& p : mesh.Positions)
+		p.y += 3.0f + 0.1f * p.x;
+	computeBounds();
+	bvh.Refit(boundsMin.data(), boundsMax.data());
+
+	std::mt19937 rng(6);
+	for (int r = 0; r < 500; ++r)
+	{
+		XMVECTOR origin, direction;
+		RandomRay(rng, 16.0f, origin, direction);
+		origin = XMVectorAdd(origin, XMVectorSet(0.0f, 5.0f, 0.0f, 0.0f));
+
+		UINT expectedTriangle = 0;
+		double expectedT = BruteForce(mesh, origin, direction, expectedTriangle);
+
+		double o[3], d[3];
+		Store(origin, o);
+		Store(direction, d);
+
+		const std::vector<UINT>& order = bvh.PrimitiveIndices();
+		float t = bvh.Intersect(origin, direction, MathHelper::Infinity, [&](UINT slot, float tMax)
+			{
+				UINT i = order[slot];
+				double tHit;
+				if (IntersectTriangle(o, d, mesh.Positions[mesh.Indices[3 * i]], mesh.Positions[mesh.Indices[3 * i + 1]],
+					mesh.Positions[mesh.Indices[3 * i + 2]], tHit) && tHit < tMax)
+				{
+					return (float)tHit;
+				}
+				return tMax;
+			});
+
+		if (expectedT < 0.0)
+			CHECK_MSG(t == MathHelper::Infinity, "ray " << r);
+		else
+			CHECK_MSG(std::abs(t - expectedT) < 1e-4, "ray " << r << ": " << t << " and " << expectedT);
+	}
+}
@@ -0,0 +1,88 @@
+#include "Engine.h"
+#include "Graphics/DDSTextureData.h"
+#include "Benchmark.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+
+using namespace DirectX;
+
+namespace
+{
+	// Reads every texel of the subresources, as the copy into the upload heap does.
+	std::uint64_t TouchTexels(const DDSTextureData& data)
+	{
+		std::uint64_t sum = 0;
+		for (const DDSSubresource& subresource : data.Subresources)
+		{
+			const BYTE* bits = static_cast<const BYTE*>(subresource.pData);
+			for (std::intptr_t i = 0; i < subresource.SlicePitch; i += 64)
+				sum += bits[i];
+		}
+		return sum;
+	}
+}
+
+// Runs the CPU phase of texture loading over every .dds file in Content/Textures, on one
+// thread and on the job system, as LoadTextures does.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 20;
+
+	std::vector<std::filesystem::path> paths;
+	std::uintmax_t totalBytes = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(ENGINE_CONTENT_DIR) / "Textures"))
+	{
+		if (entry.path().extension() == ".dds")
+		{
+			paths.push_back(entry.path());
+			totalBytes += entry.file_size();
+		}
+	}
+	std::printf("%zu textures, %llu bytes\n", paths.size(), (unsigned long long)totalBytes);
+
+	std::vector<DDSTextureData> textures(paths.size());
+	std::atomic<std::uint64_t> sum = 0;
+	auto load = [&](UINT begin, UINT end)
+		{
+			for (UINT i = begin; i < end; ++i)
+			{
+				if (FAILED(LoadDDSTextureData(paths[i].wstring().c_str(), textures[i])))
+				{
+					std::printf("%s: cannot load\n", paths[i].filename().string().c_str());
+					std::exit(1);
+				}
+			}
+		};
+
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]() { load(0, (UINT)paths.size()); });
+	Benchmark::Report("LoadDDSTextureData, serial", ms, (double)paths.size());
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			load(0, (UINT)paths.size());
+			for (const DDSTextureData& texture : textures)
+				sum.fetch_add(TouchTexels(texture));
+		});
+	Benchmark::Report("  and read the texels", ms, (double)paths.size());
+
+	std::unique_ptr<JobSystem> jobSystem = std::make_unique<JobSystem>();
+	std::printf("%u threads\n", jobSystem->ThreadCount());
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]() { jobSystem->ParallelFor((UINT)paths.size(), 1, load); });
+	Benchmark::Report("LoadDDSTextureData, job system", ms, (double)paths.size());
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			jobSystem->ParallelFor((UINT)paths.size(), 1, [&](UINT begin, UINT end)
+				{
+					load(begin, end);
+					for (UINT i = begin; i < end; ++i)
+						sum.fetch_add(TouchTexels(textures[i]));
+				});
+		});
+	Benchmark::Report("  and read the texels", ms, (double)paths.size());
+
+	std::printf("checksum %llu\n", (unsigned long long)sum.load());
+	return 0;
+}
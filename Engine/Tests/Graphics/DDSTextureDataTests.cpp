@@ -0,0 +1,198 @@
+#include "Engine.h"
+#include "Graphics/DDSTextureData.h"
+#include "Test.h"
+#include "TempDirectory.h"
+
+#include <algorithm>
+#include <filesystem>
+
+using namespace DirectX;
+
+namespace
+{
+	std::vector<std::filesystem::path> ShippedTextures()
+	{
+		std::vector<std::filesystem::path> paths;
+		for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(ENGINE_CONTENT_DIR) / "Textures"))
+		{
+			if (entry.path().extension() == ".dds")
+				paths.push_back(entry.path());
+		}
+		std::sort(paths.begin(), paths.end());
+		return paths;
+	}
+
+	// Every subresource lies inside the mapping, in file order, with pitches that hold at
+	// least one row.
+	bool SubresourcesAreInTheFile(const DDSTextureData& data)
+	{
+		const BYTE* begin = data.File->Data();
+		const BYTE* end = begin + data.File->Size();
+		const BYTE* previous = begin;
+		for (const DDSSubresource& subresource : data.Subresources)
+		{
+			const BYTE* bits = static_cast<const BYTE*>(subresource.pData);
+			if (bits <= previous || subresource.RowPitch <= 0 || subresource.SlicePitch < subresource.RowPitch ||
+				bits + subresource.SlicePitch > end)
+			{
+				return false;
+			}
+			previous = bits;
+		}
+		return true;
+	}
+}
+
+TEST(DDSTextureData, ShippedTexturesLoadFromTheMapping)
+{
+	std::vector<std::filesystem::path> paths = ShippedTextures();
+	REQUIRE(!paths.empty());
+
+	for (const std::filesystem::path& path : paths)
+	{
+		DDSTextureData data;
+		HRESULT hr = LoadDDSTextureData(path.wstring().c_str(), data);
+		CHECK_MSG(SUCCEEDED(hr), path.filename().string() << ": 0x" << std::hex << (unsigned)hr);
+		if (FAILED(hr))
+			continue;
+
+		CHECK(data.File != nullptr && data.File->IsOpen());
+		CHECK_MSG(data.Width > 0 && data.Height > 0 && data.MipCount > 0 && data.ArraySize > 0 &&
+			data.Format != DXGI_FORMAT_UNKNOWN, path.filename().string());
+		CHECK_EQ(data.Subresources.size(), data.MipCount * data.ArraySize);
+		CHECK_MSG(SubresourcesAreInTheFile(data), path.filename().string());
+	}
+}
+
+TEST(DDSTextureData, MaxSizeSkipsTheLargestMips)
+{
+	int checked = 0;
+	for (const std::filesystem::path& path : ShippedTextures())
+	{
+		DDSTextureData full;
+		if (FAILED(LoadDDSTextureData(path.wstring().c_str(), full)) || full.MipCount < 2 || full.ArraySize != 1 ||
+			full.Depth > 1 || full.Width < 2 || full.Height < 2)
+		{
+			continue;
+		}
+
+		// Half the size drops exactly the first mip, the rest still point into the file.
+		size_t maxSize = std::max(full.Width, full.Height) / 2;
+		DDSTextureData reduced;
+		REQUIRE(SUCCEEDED(LoadDDSTextureData(path.wstring().c_str(), reduced, maxSize)));
+		CHECK_MSG(reduced.Width == full.Width / 2 && reduced.Height == full.Height / 2 &&
+			reduced.MipCount == full.MipCount - 1, path.filename().string());
+		CHECK(reduced.Subresources[0].RowPitch == full.Subresources[1].RowPitch);
+		CHECK(reduced.Subresources[0].pData == reduced.File->Data() + (static_cast<const BYTE*>(full.Subresources[1].pData) -
+			full.File->Data()));
+		++checked;
+	}
+	CHECK_GT(checked, 0);
+}
+
+TEST(DDSTextureData, DamagedFilesAreRejected)
+{
+	std::vector<std::filesystem::path> paths = ShippedTextures();
+	REQUIRE(!paths.empty());
+	std::vector<std::uint8_t> bytes = TempDirectory::Read(paths.front().wstring());
+	REQUIRE(bytes.size() > 256);
+
+	TempDirectory directory;
+	std::vector<std::uint8_t> badMagic = bytes;
+	badMagic[0] = 'X';
+
+	const std::wstring damaged[] =
+	{
+		directory.Path("missing.dds"),
+		directory.Write("empty.dds", "", 0),
+		directory.Write("magic.dds", badMagic.data(), badMagic.size()),
+		directory.Write("header.dds", bytes.data(), 64),
+		directory.Write("bits.dds", bytes.data(), bytes.size() / 2),
+	};
+	for (const std::wstring& path : damaged)
+	{
+		DDSTextureData data;
+		CHECK_MSG(FAILED(LoadDDSTextureData(path.c_str(), data)), std::filesystem::path(path).filename().string());
+	}
+
+	DDSTextureData data;
+	CHECK(FAILED(LoadDDSTextureData(nullptr, data)));
+}
+
+TEST(DDSTextureData, SurfaceSizes)
+{
+	// Block compressed rows are rows of 4x4 blocks, and a partial block takes a whole one.
+	size_t numBytes = 0, rowBytes = 0, numRows = 0;
+	GetSurfaceInfo(4, 4, DXGI_FORMAT_BC1_UNORM, &numBytes, &rowBytes, &numRows);
+	CHECK(numBytes == 8 && rowBytes == 8 && numRows == 1);
+	GetSurfaceInfo(1, 1, DXGI_FORMAT_BC1_UNORM, &numBytes, &rowBytes, &numRows);
+	CHECK(numBytes == 8 && rowBytes == 8 && numRows == 1);
+	GetSurfaceInfo(10, 6, DXGI_FORMAT_BC3_UNORM, &numBytes, &rowBytes, &numRows);
+	CHECK(numBytes == 3 * 2 * 16 && rowBytes == 3 * 16 && numRows == 2);
+
+	GetSurfaceInfo(33, 7, DXGI_FORMAT_R8G8B8A8_UNORM, &numBytes, &rowBytes, &numRows);
+	CHECK(numBytes == 33 * 4 * 7 && rowBytes == 33 * 4 && numRows == 7);
+	CHECK_EQ(BitsPerPixel(DXGI_FORMAT_R16G16B16A16_FLOAT), 64u);
+	CHECK_EQ(BitsPerPixel(DXGI_FORMAT_UNKNOWN), 0u);
+}
+
+TEST(DDSTextureData, MemoryMatchesTheMapping)
+{
+	for (const std::filesystem::path& path : ShippedTextures())
+	{
+		DDSTextureData mapped;
+		REQUIRE(SUCCEEDED(LoadDDSTextureData(path.wstring().c_str(), mapped)));
+
+		std::vector<std::uint8_t> bytes = TempDirectory::Read(path.wstring());
+		DDSTextureData memory;
+		REQUIRE(SUCCEEDED(GetDDSTextureData(bytes.data(), bytes.size(), memory)));
+		CHECK(memory.File == nullptr);
+		bool same = memory.Width == mapped.Width && memory.Height == mapped.Height &&
+			memory.MipCount == mapped.MipCount && memory.Format == mapped.Format &&
+			memory.AlphaMode == mapped.AlphaMode && memory.Subresources.size() == mapped.Subresources.size();
+		for (size_t s = 0; same && s < memory.Subresources.size(); ++s)
+		{
+			same = memory.Subresources[s].RowPitch == mapped.Subresources[s].RowPitch &&
+				static_cast<const BYTE*>(memory.Subresources[s].pData) - bytes.data() ==
+				static_cast<const BYTE*>(mapped.Subresources[s].pData) - mapped.File->Data();
+		}
+		CHECK_MSG(same, path.filename().string());
+	}
+}
+
+TEST(DDSTextureData, ParallelLoadMatchesSerial)
+{
+	std::vector<std::filesystem::path> paths = ShippedTextures();
+	std::vector<DDSTextureData> serial(paths.size());
+	for (size_t i = 0; i < paths.size(); ++i)
+		REQUIRE(SUCCEEDED(LoadDDSTextureData(paths[i].wstring().c_str(), serial[i])));
+
+	// The CPU phase the way LoadTextures runs it, one file per job.
+	JobSystem jobSystem(3);
+	std::vector<DDSTextureData> parallel(paths.size());
+	std::vector<HRESULT> results(paths.size());
+	jobSystem.ParallelFor((UINT)paths.size(), 1, [&](UINT begin, UINT end)
+		{
+			for (UINT i = begin; i < end; ++i)
+				results[i] = LoadDDSTextureData(paths[i].wstring().c_str(), parallel[i]);
+		});
+
+	UINT different = 0;
+	for (size_t i = 0; i < paths.size(); ++i)
+	{
+		const DDSTextureData& a = serial[i];
+		const DDSTextureData& b = parallel[i];
+		bool same = SUCCEEDED(results[i]) && a.Width == b.Width && a.Height == b.Height && a.Depth == b.Depth &&
+			a.MipCount == b.MipCount && a.ArraySize == b.ArraySize && a.Format == b.Format && a.IsCubeMap == b.IsCubeMap &&
+			a.Subresources.size() == b.Subresources.size();
+		for (size_t s = 0; same && s < a.Subresources.size(); ++s)
+		{
+			same = a.Subresources[s].RowPitch == b.Subresources[s].RowPitch &&
+				a.Subresources[s].SlicePitch == b.Subresources[s].SlicePitch &&
+				static_cast<const BYTE*>(a.Subresources[s].pData) - a.File->Data() ==
+				static_cast<const BYTE*>(b.Subresources[s].pData) - b.File->Data();
+		}
+		different += !same;
+	}
+	CHECK_EQ(different, 0u);
+}
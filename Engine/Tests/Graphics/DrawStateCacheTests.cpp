@@ -0,0 +1,140 @@
+#include "Engine.h"
+#include "Graphics/DrawStateCache.h"
+#include "Graphics/InstanceBatcher.h"
+#include "FakeObjects.h"
+#include "Test.h"
+
+#include <random>
+#include <set>
+
+namespace
+{
+	// Commands a draw loop records on the command list.
+	struct RecordedCommands
+	{
+		UINT PipelineStates = 0;
+		UINT VertexBuffers = 0;
+		UINT IndexBuffers = 0;
+		UINT Topologies = 0;
+		UINT Draws = 0;
+
+		UINT Total() const { return PipelineStates + VertexBuffers + IndexBuffers + Topologies + Draws; }
+	};
+
+	// Records one draw the way GraphicsClass::DrawRenderItems does, setting state only
+	// where the cache asks for it.  Without a cache every state is set.
+	void RecordDraw(DrawStateCache* cache, ID3D12PipelineState* pipelineState, const RenderItemDrawArgs& args,
+		RecordedCommands& commands)
+	{
+		if (cache == nullptr || cache->SetPipelineState(pipelineState))
+			commands.PipelineStates++;
+		if (cache == nullptr || cache->SetGeometry(args.Geo))
+		{
+			commands.VertexBuffers++;
+			commands.IndexBuffers++;
+		}
+		if (cache == nullptr || cache->SetPrimitiveType(args.PrimitiveType))
+			commands.Topologies++;
+		commands.Draws++;
+	}
+}
+
+TEST(DrawStateCache, OnlyChangesAreReported)
+{
+	DrawStateCache cache;
+
+	// Everything is unknown after a reset.
+	CHECK(cache.SetPipelineState(FakeObject<ID3D12PipelineState>(0)));
+	CHECK(cache.SetGeometry(FakeObject<MeshGeometry>(0)));
+	CHECK(cache.SetPrimitiveType(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+	CHECK_EQ(cache.StateChanges(), 3u);
+	CHECK_EQ(cache.SkippedStateChanges(), 0u);
+
+	CHECK(!cache.SetPipelineState(FakeObject<ID3D12PipelineState>(0)));
+	CHECK(!cache.SetGeometry(FakeObject<MeshGeometry>(0)));
+	CHECK(!cache.SetPrimitiveType(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST));
+	CHECK_EQ(cache.SkippedStateChanges(), 3u);
+
+	CHECK(cache.SetPipelineState(FakeObject<ID3D12PipelineState>(1)));
+	CHECK(cache.SetGeometry(FakeObject<MeshGeometry>(1)));
+	CHECK(cache.SetPrimitiveType(D3D_PRIMITIVE_TOPOLOGY_LINELIST));
+	CHECK(cache.SetGeometry(FakeObject<MeshGeometry>(0)));
+	CHECK_EQ(cache.StateChanges(), 7u);
+	CHECK_EQ(cache.SkippedStateChanges(), 3u);
+
+	// A new command list binds nothing, so the same state has to be set again.
+	cache.Reset();
+	CHECK_EQ(cache.StateChanges(), 0u);
+	CHECK_EQ(cache.SkippedStateChanges(), 0u);
+	CHECK(cache.SetGeometry(FakeObject<MeshGeometry>(0)));
+	CHECK(cache.SetPrimitiveType(D3D_PRIMITIVE_TOPOLOGY_LINELIST));
+}
+
+TEST(DrawStateCache, SubmeshesAreTrackedByAddress)
+{
+	SubmeshGeometry submeshes[2];
+	DrawStateCache cache;
+	CHECK(cache.SetSubmesh(&submeshes[0]));
+	CHECK(!cache.SetSubmesh(&submeshes[0]));
+	CHECK(cache.SetSubmesh(&submeshes[1]));
+	CHECK(cache.SetSubmesh(nullptr));
+	CHECK(!cache.SetSubmesh(nullptr));
+}
+
+TEST(DrawStateCache, SortedBatchesRecordFewerCommands)
+{
+	const UINT geometryCount = 6;
+	const UINT drawCount = 4;
+	const UINT itemCount = 3000;
+
+	Material material;
+	RenderItemStore items;
+	std::vector<RenderItemHandle> layer;
+
+	std::mt19937 rng(10);
+	std::uniform_int_distribution<UINT> geometry(0, geometryCount - 1);
+	std::uniform_int_distribution<UINT> draw(0, drawCount - 1);
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		UINT d = draw(rng);
+		RenderItemDesc desc;
+		desc.Geo = FakeObject<MeshGeometry>(geometry(rng));
+		desc.Mat = &material;
+		desc.PrimitiveType = d == 0 ? D3D_PRIMITIVE_TOPOLOGY_LINELIST : D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+		desc.IndexCount = 6 * (d + 1);
+		desc.StartIndexLocation = 100 * d;
+		desc.ObjConstantBufferIndex = i;
+		layer.push_back(items.Create(desc));
+	}
+
+	// Every item drawn on its own, in creation order, setting all state.
+	RecordedCommands unsorted;
+	for (RenderItemHandle handle : layer)
+		RecordDraw(nullptr, FakeObject<ID3D12PipelineState>(0), items.DrawArgs(handle), unsorted);
+	CHECK_EQ(unsorted.Total(), 5 * itemCount);
+
+	// The same items in batches, with redundant state skipped.
+	InstanceBatcher batcher;
+	InstanceBatcher::Range range = batcher.Add(items, layer);
+	DrawStateCache cache;
+	RecordedCommands sorted;
+	std::set<std::pair<const MeshGeometry*, D3D12_PRIMITIVE_TOPOLOGY>> topologies;
+	for (UINT b = range.FirstBatch; b < range.FirstBatch + range.BatchCount; ++b)
+	{
+		const RenderItemDrawArgs& args = items.DrawArgs(batcher.Batches()[b].Item);
+		topologies.insert({ args.Geo, args.PrimitiveType });
+		RecordDraw(&cache, FakeObject<ID3D12PipelineState>(0), args, sorted);
+	}
+
+	CHECK_EQ(sorted.Draws, range.BatchCount);
+	CHECK_LE(range.BatchCount, geometryCount * drawCount);
+	CHECK_EQ(sorted.PipelineStates, 1u);
+	// Batches of a geometry are adjacent, so its buffers are set once.
+	CHECK_EQ(sorted.VertexBuffers, geometryCount);
+	CHECK_EQ(sorted.IndexBuffers, geometryCount);
+	// The topology changes at most once per geometry and topology it is drawn with.
+	CHECK_LE(sorted.Topologies, (UINT)topologies.size());
+	CHECK_EQ(cache.StateChanges() + cache.SkippedStateChanges(), 3 * range.BatchCount);
+	CHECK_EQ(cache.StateChanges(), sorted.PipelineStates + sorted.VertexBuffers + sorted.Topologies);
+	CHECK_LT(sorted.Total() * 50, unsorted.Total());
+}
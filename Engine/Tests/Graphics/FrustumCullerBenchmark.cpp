@@ -0,0 +1,78 @@
+#include "Engine.h"
+#include "Graphics/FrustumCuller.h"
+#include "Benchmark.h"
+
+#include <memory>
+#include <random>
+
+using namespace DirectX;
+
+// Culls a field of boxes with the old per-item test, which moved the frustum into every
+// item's local space, and with FrustumCuller on one thread and on the job system.
+int main(int argc, char** argv)
+{
+	const UINT itemCount = Benchmark::IsQuick(argc, argv) ? 5000 : 100000;
+	const int repeatCount = Benchmark::IsQuick(argc, argv) ? 1 : 20;
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+	std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	BoundingBox localBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 2.0f, 0.5f));
+	BoundingVolumes localBounds;
+	localBounds.Box = localBox;
+	localBounds.Sphere = BoundingSphere(localBox.Center, 2.3f);
+	localBounds.OrientedBox = BoundingOrientedBox(localBox.Center, localBox.Extents, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+	std::vector<XMFLOAT4X4> worlds(itemCount);
+	for (XMFLOAT4X4& world : worlds)
+	{
+		float s = scale(rng);
+		XMStoreFloat4x4(&world, XMMatrixScaling(s, s, s) * XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+			XMMatrixTranslation(position(rng), position(rng), position(rng)));
+	}
+
+	BoundingFrustum frustum(XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f));
+
+	std::printf("%u items\n", itemCount);
+
+	UINT visibleCount = 0;
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			visibleCount = 0;
+			for (const XMFLOAT4X4& world : worlds)
+			{
+				XMMATRIX W = XMLoadFloat4x4(&world);
+				XMVECTOR det = XMMatrixDeterminant(W);
+				XMMATRIX invWorld = XMMatrixInverse(&det, W);
+
+				BoundingFrustum localFrustum;
+				frustum.Transform(localFrustum, invWorld);
+				visibleCount += localFrustum.Contains(localBox) != DISJOINT;
+			}
+		});
+	Benchmark::Report("inverse world per item", ms, itemCount);
+	std::printf("  %u visible\n", visibleCount);
+
+	FrustumCuller culler;
+	culler.Resize(itemCount);
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			for (UINT i = 0; i < itemCount; ++i)
+				culler.UpdateBounds(i, localBounds, worlds[i]);
+		});
+	Benchmark::Report("FrustumCuller::UpdateBounds", ms, itemCount);
+
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]() { culler.Cull(frustum); });
+	Benchmark::Report("FrustumCuller::Cull, one thread", ms, itemCount);
+	std::printf("  %zu visible\n", culler.VisibleIndices().size());
+
+	auto jobSystem = std::make_unique<JobSystem>();
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]() { culler.Cull(frustum); });
+	char name[64];
+	std::snprintf(name, sizeof(name), "FrustumCuller::Cull, %u threads", jobSystem->ThreadCount());
+	Benchmark::Report(name, ms, itemCount);
+
+	return 0;
+}
@@ -0,0 +1,337 @@
+#include "Engine.h"
+#include "Graphics/FrustumCuller.h"
+
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Item
+	{
+		BoundingVolumes Bounds;
+		XMFLOAT4X4 World;
+	};
+
+	// Camera looking roughly down +z, turned a little so the planes are not axis aligned.
+	BoundingFrustum MakeFrustum()
+	{
+		BoundingFrustum viewFrustum(XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 200.0f));
+		XMMATRIX cameraWorld = XMMatrixRotationRollPitchYaw(0.1f, 0.3f, 0.05f) * XMMatrixTranslation(1.0f, 2.0f, -3.0f);
+		BoundingFrustum frustum;
+		viewFrustum.Transform(frustum, cameraWorld);
+		return frustum;
+	}
+
+	XMFLOAT4 RandomOrientation(std::mt19937& rng)
+	{
+		std::normal_distribution<float> normal;
+		XMFLOAT4 q(normal(rng), normal(rng), normal(rng), normal(rng));
+		float length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		return XMFLOAT4(q.x / length, q.y / length, q.z / length, q.w / length);
+	}
+
+	// Items spread over and around the frustum.  Every fourth world matrix has shear, and
+	// one in five flattens the item onto a plane like the planar shadows do, half of them
+	// for a point light, which makes the matrix projective.
+	std::vector<Item> MakeItems(UINT count, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+		std::uniform_real_distribution<float> depth(-20.0f, 250.0f);
+		std::uniform_real_distribution<float> extent(0.1f, 6.0f);
+		std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+		std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+		std::uniform_real_distribution<float> shear(-0.5f, 0.5f);
+
+		std::vector<Item> items(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			Item& item = items[i];
+			BoundingOrientedBox& box = item.Bounds.OrientedBox;
+			box.Center = XMFLOAT3(extent(rng) - 3.0f, extent(rng) - 3.0f, extent(rng) - 3.0f);
+			box.Extents = XMFLOAT3(extent(rng), extent(rng), extent(rng));
+			box.Orientation = RandomOrientation(rng);
+
+			// Sometimes smaller than the box, so both volumes decide some of the items.
+			float boxRadius = std::sqrt(box.Extents.x * box.Extents.x + box.Extents.y * box.Extents.y +
+				box.Extents.z * box.Extents.z);
+			item.Bounds.Sphere = BoundingSphere(box.Center, boxRadius * (i % 3 == 0 ? 0.7f : 1.0f));
+
+			XMMATRIX W = XMMatrixScaling(scale(rng), scale(rng), scale(rng)) *
+				XMMatrixRotationRollPitchYaw(angle(rng), angle(rng), angle(rng)) *
+				XMMatrixTranslation(position(rng), position(rng), depth(rng));
+			if (i % 4 == 1)
+			{
+				XMMATRIX S = XMMatrixIdentity();
+				S.r[0] = XMVectorSet(1.0f, shear(rng), shear(rng), 0.0f);
+				W = S * W;
+			}
+			if (i % 10 == 3 || i % 10 == 7)
+			{
+				XMVECTOR plane = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+				XMVECTOR light = i % 10 == 3 ? XMVectorSet(0.3f, 1.0f, -0.2f, 0.0f) : XMVectorSet(10.0f, 1000.0f, 50.0f, 1.0f);
+				W = W * XMMatrixShadow(plane, light);
+			}
+			XMStoreFloat4x4(&item.World, W);
+		}
+		return items;
+	}
+
+	void Fill(FrustumCuller& culler, const std::vector<Item>& items)
+	{
+		culler.Resize((UINT)items.size());
+		for (UINT i = 0; i < (UINT)items.size(); ++i)
+			culler.UpdateBounds(i, items[i].Bounds, items[i].World);
+	}
+
+	// Scalar, double precision version of the culler's test.  Returns the largest signed
+	// distance by which the box or the sphere is outside a plane: the item is culled when
+	// it is positive.
+	double ReferenceMargin(const Item& item, const XMVECTOR* planes)
+	{
+		const BoundingOrientedBox& box = item.Bounds.OrientedBox;
+		const XMFLOAT4X4& m = item.World;
+		double W[4][4];
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				W[r][c] = m.m[r][c];
+
+		// Rows of the box rotation scaled by the extents.
+		double qx = box.Orientation.x, qy = box.Orientation.y, qz = box.Orientation.z, qw = box.Orientation.w;
+		double R[3][3] = {
+			{ 1 - 2 * (qy * qy + qz * qz), 2 * (qx * qy + qz * qw), 2 * (qx * qz - qy * qw) },
+			{ 2 * (qx * qy - qz * qw), 1 - 2 * (qx * qx + qz * qz), 2 * (qy * qz + qx * qw) },
+			{ 2 * (qx * qz + qy * qw), 2 * (qy * qz - qx * qw), 1 - 2 * (qx * qx + qy * qy) } };
+		double extents[3] = { box.Extents.x, box.Extents.y, box.Extents.z };
+
+		auto transformPoint = [&W](const double p[3], double out[3])
+			{
+				double h[4];
+				for (int c = 0; c < 4; ++c)
+					h[c] = p[0] * W[0][c] + p[1] * W[1][c] + p[2] * W[2][c] + W[3][c];
+				for (int c = 0; c < 3; ++c)
+					out[c] = h[c] / h[3];
+			};
+
+		double center[3], axes[3][3], sphereCenter[3], sphereRadius;
+		bool affine = m._14 == 0.0f && m._24 == 0.0f && m._34 == 0.0f && m._44 == 1.0f;
+		if (affine)
+		{
+			double c[3] = { box.Center.x, box.Center.y, box.Center.z };
+			transformPoint(c, center);
+			for (int k = 0; k < 3; ++k)
+				for (int j = 0; j < 3; ++j)
+					axes[k][j] = extents[k] * (R[k][0] * W[0][j] + R[k][1] * W[1][j] + R[k][2] * W[2][j]);
+
+			double s[3] = { item.Bounds.Sphere.Center.x, item.Bounds.Sphere.Center.y, item.Bounds.Sphere.Center.z };
+			transformPoint(s, sphereCenter);
+			double gram[3][3];
+			for (int a = 0; a < 3; ++a)
+				for (int b = 0; b < 3; ++b)
+					gram[a][b] = W[a][0] * W[b][0] + W[a][1] * W[b][1] + W[a][2] * W[b][2];
+			double maxRowSum = 0.0;
+			for (int a = 0; a < 3; ++a)
+				maxRowSum = std::max(maxRowSum, std::abs(gram[a][0]) + std::abs(gram[a][1]) + std::abs(gram[a][2]));
+			sphereRadius = item.Bounds.Sphere.Radius * std::sqrt(maxRowSum);
+		}
+		else
+		{
+			double lo[3] = { 1e30, 1e30, 1e30 }, hi[3] = { -1e30, -1e30, -1e30 };
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				double p[3] = { box.Center.x, box.Center.y, box.Center.z };
+				for (int k = 0; k < 3; ++k)
+				{
+					double sign = (corner >> k) & 1 ? 1.0 : -1.0;
+					for (int j = 0; j < 3; ++j)
+						p[j] += sign * extents[k] * R[k][j];
+				}
+				double q[3];
+				transformPoint(p, q);
+				for (int j = 0; j < 3; ++j)
+				{
+					lo[j] = std::min(lo[j], q[j]);
+					hi[j] = std::max(hi[j], q[j]);
+				}
+			}
+			for (int j = 0; j < 3; ++j)
+			{
+				center[j] = 0.5 * (lo[j] + hi[j]);
+				sphereCenter[j] = center[j];
+				for (int k = 0; k < 3; ++k)
+					axes[k][j] = k == j ? 0.5 * (hi[j] - lo[j]) : 0.0;
+			}
+			sphereRadius = std::sqrt(axes[0][0] * axes[0][0] + axes[1][1] * axes[1][1] + axes[2][2] * axes[2][2]);
+		}
+
+		double margin = -1e30;
+		for (int p = 0; p < 6; ++p)
+		{
+			XMFLOAT4 plane;
+			XMStoreFloat4(&plane, planes[p]);
+			double n[3] = { plane.x, plane.y, plane.z };
+
+			double distance = n[0] * center[0] + n[1] * center[1] + n[2] * center[2] + plane.w;
+			double radius = 0.0;
+			for (int k = 0; k < 3; ++k)
+				radius += std::abs(n[0] * axes[k][0] + n[1] * axes[k][1] + n[2] * axes[k][2]);
+			margin = std::max(margin, distance - radius);
+
+			double sphereDistance = n[0] * sphereCenter[0] + n[1] * sphereCenter[1] + n[2] * sphereCenter[2] + plane.w;
+			margin = std::max(margin, sphereDistance - sphereRadius);
+		}
+		return margin;
+	}
+
+	std::vector<bool> VisibleFlags(const FrustumCuller& culler)
+	{
+		std::vector<bool> visible(culler.ItemCount(), false);
+		for (UINT index : culler.VisibleIndices())
+			visible[index] = true;
+		return visible;
+	}
+}
+
+TEST(FrustumCuller, MatchesScalarReference)
+{
+	// Not a multiple of four, so the last SIMD vector is partly padding.
+	std::vector<Item> items = MakeItems(5003, 1);
+	BoundingFrustum frustum = MakeFrustum();
+	XMVECTOR planes[6];
+	frustum.GetPlanes(&planes[0], &planes[1], &planes[2], &planes[3], &planes[4], &planes[5]);
+
+	FrustumCuller culler;
+	Fill(culler, items);
+	culler.Cull(frustum);
+
+	const std::vector<UINT>& indices = culler.VisibleIndices();
+	CHECK(std::is_sorted(indices.begin(), indices.end()));
+	CHECK(std::adjacent_find(indices.begin(), indices.end()) == indices.end());
+	REQUIRE(indices.empty() || indices.back() < items.size());
+
+	std::vector<bool> visible = VisibleFlags(culler);
+	UINT visibleCount = 0;
+	UINT culledCount = 0;
+	for (UINT i = 0; i < (UINT)items.size(); ++i)
+	{
+		double margin = ReferenceMargin(items[i], planes);
+
+		// Float rounding may flip items that touch a plane.
+		if (std::abs(margin) < 1e-2)
+			continue;
+
+		CHECK_MSG(visible[i] == (margin <= 0.0), "item " << i << " margin " << margin);
+		visibleCount += margin <= 0.0;
+		culledCount += margin > 0.0;
+	}
+
+	// The scene has to exercise both outcomes.
+	CHECK_GT(visibleCount, 100u);
+	CHECK_GT(culledCount, 100u);
+}
+
+TEST(FrustumCuller, NeverCullsVisiblePoints)
+{
+	std::vector<Item> items = MakeItems(3000, 2);
+	BoundingFrustum frustum = MakeFrustum();
+
+	FrustumCuller culler;
+	Fill(culler, items);
+	culler.Cull(frustum);
+	std::vector<bool> visible = VisibleFlags(culler);
+
+	// Sample every box at its corners and inside, keeping the samples that are also in the
+	// sphere, since the points of a mesh are bounded by both.  A culled item must not have
+	// any sample in the frustum.
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (UINT i = 0; i < (UINT)items.size(); ++i)
+	{
+		if (visible[i])
+			continue;
+
+		const BoundingOrientedBox& box = items[i].Bounds.OrientedBox;
+		XMMATRIX R = XMMatrixRotationQuaternion(XMLoadFloat4(&box.Orientation));
+		XMMATRIX W = XMLoadFloat4x4(&items[i].World);
+		for (int s = 0; s < 64; ++s)
+		{
+			float u[3];
+			for (int k = 0; k < 3; ++k)
+				u[k] = s < 8 ? ((s >> k) & 1 ? 1.0f : -1.0f) : unit(rng);
+
+			XMVECTOR local = XMLoadFloat3(&box.Center);
+			local += R.r[0] * (u[0] * box.Extents.x);
+			local += R.r[1] * (u[1] * box.Extents.y);
+			local += R.r[2] * (u[2] * box.Extents.z);
+			if (items[i].Bounds.Sphere.Contains(local) == DISJOINT)
+				continue;
+
+			XMVECTOR world = XMVector3TransformCoord(local, W);
+
+			CHECK_MSG(frustum.Contains(world) == DISJOINT, "item " << i << " sample " << s);
+		}
+	}
+}
+
+TEST(FrustumCuller, AlwaysVisibleItemsAreReported)
+{
+	std::vector<Item> items = MakeItems(64, 4);
+	for (Item& item : items)
+		XMStoreFloat4x4(&item.World, XMMatrixTranslation(0.0f, 0.0f, -1000.0f));
+
+	FrustumCuller culler;
+	Fill(culler, items);
+	culler.SetAlwaysVisible(5, true);
+	culler.SetAlwaysVisible(63, true);
+	culler.Cull(MakeFrustum());
+
+	CHECK(culler.VisibleIndices() == std::vector<UINT>({ 5, 63 }));
+
+	culler.SetAllVisible();
+	CHECK_EQ(culler.VisibleIndices().size(), items.size());
+}
+
+TEST(FrustumCuller, ParallelCullMatchesSerial)
+{
+	std::vector<Item> items = MakeItems(40001, 5);
+	BoundingFrustum frustum = MakeFrustum();
+
+	FrustumCuller culler;
+	Fill(culler, items);
+
+	REQUIRE(JobSystem::Instance() == nullptr);
+	culler.Cull(frustum);
+	std::vector<UINT> serial = culler.VisibleIndices();
+
+	{
+		JobSystem jobSystem(3);
+		culler.Cull(frustum);
+	}
+
+	CHECK(culler.VisibleIndices() == serial);
+}
+
+TEST(FrustumCuller, WorldSphereFollowsTheWorldMatrix)
+{
+	BoundingVolumes bounds;
+	bounds.Sphere = BoundingSphere(XMFLOAT3(1.0f, 0.0f, 0.0f), 2.0f);
+
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixScaling(3.0f, 3.0f, 3.0f) * XMMatrixTranslation(0.0f, 5.0f, 0.0f));
+
+	FrustumCuller culler;
+	culler.Resize(1);
+	culler.UpdateBounds(0, bounds, world);
+
+	BoundingSphere sphere = culler.WorldSphere(0);
+	CHECK_NEAR(sphere.Center.x, 3.0f, 1e-5f);
+	CHECK_NEAR(sphere.Center.y, 5.0f, 1e-5f);
+	CHECK_NEAR(sphere.Center.z, 0.0f, 1e-5f);
+	CHECK_NEAR(sphere.Radius, 6.0f, 1e-5f);
+}
@@ -0,0 +1,64 @@
+#include "Engine.h"
+#include "Graphics/GeometryGenerator.h"
+#include "Benchmark.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Generates the subdivided shapes, with the vertex counts the welded subdivision saves over
+// one vertex per triangle corner, and the grid with and without the job system.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 10;
+	const std::uint32_t maxLevel = quick ? 4 : 6;
+
+	GeometryGenerator generator;
+	for (std::uint32_t level = 1; level <= maxLevel; ++level)
+	{
+		GeometryGenerator::MeshData mesh;
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				mesh = generator.CreateGeosphere(1.0f, level);
+			});
+		// Without welding every subdivided triangle wrote its six vertices.
+		std::uint32_t unwelded = 6 * GeometryGenerator::GeosphereSize(level - 1).IndexCount / 3;
+		std::printf("geosphere level %u: %zu vertices, %u unwelded, %zu triangles\n", level, mesh.Vertices.size(),
+			unwelded, mesh.Indices32.size() / 3);
+		Benchmark::Report("  CreateGeosphere", ms, (double)mesh.Vertices.size());
+	}
+
+	GeometryGenerator::MeshData box;
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			box = generator.CreateBox(1.0f, 1.0f, 1.0f, maxLevel);
+		});
+	std::printf("box level %u: %zu vertices, %u unwelded\n", maxLevel, box.Vertices.size(),
+		6 * GeometryGenerator::BoxSize(maxLevel - 1).IndexCount / 3);
+	Benchmark::Report("  CreateBox", ms, (double)box.Vertices.size());
+
+	// The grid is written to buffers allocated once, so the timing is the generation alone.
+	const std::uint32_t gridSide = quick ? 256 : 2048;
+	GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(gridSide, gridSide);
+	std::vector<GeometryGenerator::Vertex> vertices(size.VertexCount);
+	std::vector<std::uint32_t> indices(size.IndexCount);
+	const GeometryGenerator::MeshBuffers out = { vertices.data(),
+		{ sizeof(GeometryGenerator::Vertex), offsetof(GeometryGenerator::Vertex, Normal),
+			offsetof(GeometryGenerator::Vertex, TangentU), offsetof(GeometryGenerator::Vertex, TexC) },
+		indices.data(), sizeof(std::uint32_t) };
+	std::printf("grid %ux%u: %u vertices\n", gridSide, gridSide, size.VertexCount);
+	for (bool threaded : { false, true })
+	{
+		std::unique_ptr<JobSystem> jobSystem;
+		if (threaded)
+			jobSystem = std::make_unique<JobSystem>();
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				generator.CreateGrid(100.0f, 100.0f, gridSide, gridSide, out);
+			});
+		Benchmark::Report(threaded ? "  CreateGrid, job system" : "  CreateGrid, serial", ms, (double)size.VertexCount);
+	}
+
+	return 0;
+}
@@ -0,0 +1,293 @@
+#include "Engine.h"
+#include "Graphics/GeometryGenerator.h"
+
+#include "Test.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+
+using namespace DirectX;
+
+namespace
+{
+	using MeshData = GeometryGenerator::MeshData;
+
+	struct Topology
+	{
+		// Vertices that share their position with an earlier one.
+		std::uint32_t DuplicatePositions = 0;
+		// Positions, edges and triangles with vertices welded by position.
+		std::uint32_t PositionCount = 0;
+		std::uint32_t EdgeCount = 0;
+		std::uint32_t TriangleCount = 0;
+		// Edges not used exactly once in each direction, which a closed surface has none of.
+		std::uint32_t OpenEdges = 0;
+		std::uint32_t DegenerateTriangles = 0;
+		// Triangles whose winding disagrees with the vertex normals.
+		std::uint32_t InvertedTriangles = 0;
+		bool IndicesInRange = true;
+	};
+
+	// Welds vertices closer than the tolerance, since the seam of a ring ends at the sine and
+	// cosine of two pi rather than at its first vertex.
+	Topology Analyze(const MeshData& mesh, float tolerance = 1e-5f)
+	{
+		Topology topology;
+		const std::vector<GeometryGenerator::Vertex>& vertices = mesh.Vertices;
+		std::vector<std::uint32_t> order(vertices.size());
+		for (std::uint32_t v = 0; v < order.size(); ++v)
+			order[v] = v;
+		std::sort(order.begin(), order.end(), [&vertices](std::uint32_t a, std::uint32_t b)
+			{
+				return vertices[a].Position.x < vertices[b].Position.x;
+			});
+
+		std::vector<std::uint32_t> welded(vertices.size(), ~0u);
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			std::uint32_t v = order[i];
+			if (welded[v] != ~0u)
+				continue;
+			welded[v] = topology.PositionCount++;
+			XMVECTOR p = XMLoadFloat3(&vertices[v].Position);
+			for (size_t j = i + 1; j < order.size() && vertices[order[j]].Position.x - vertices[v].Position.x <= tolerance; ++j)
+			{
+				std::uint32_t w = order[j];
+				if (welded[w] == ~0u && XMVectorGetX(XMVector3Length(XMLoadFloat3(&vertices[w].Position) - p)) <= tolerance)
+				{
+					welded[w] = welded[v];
+					++topology.DuplicatePositions;
+				}
+			}
+		}
+
+		std::map<std::pair<std::uint32_t, std::uint32_t>, std::int32_t> edges;
+		for (size_t i = 0; i + 2 < mesh.Indices32.size(); i += 3)
+		{
+			const std::uint32_t* tri = &mesh.Indices32[i];
+			if (tri[0] >= mesh.Vertices.size() || tri[1] >= mesh.Vertices.size() || tri[2] >= mesh.Vertices.size())
+			{
+				topology.IndicesInRange = false;
+				return topology;
+			}
+			++topology.TriangleCount;
+
+			XMVECTOR p0 = XMLoadFloat3(&mesh.Vertices[tri[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&mesh.Vertices[tri[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&mesh.Vertices[tri[2]].Position);
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			XMVECTOR vertexNormals = XMLoadFloat3(&mesh.Vertices[tri[0]].Normal) + XMLoadFloat3(&mesh.Vertices[tri[1]].Normal) +
+				XMLoadFloat3(&mesh.Vertices[tri[2]].Normal);
+			topology.DegenerateTriangles += XMVectorGetX(XMVector3LengthSq(n)) <= 0.0f;
+			topology.InvertedTriangles += XMVectorGetX(XMVector3Dot(n, vertexNormals)) <= 0.0f;
+
+			for (int k = 0; k < 3; ++k)
+			{
+				std::uint32_t a = welded[tri[k]], b = welded[tri[(k + 1) % 3]];
+				// +1 one way, +1024 the other, so a closed edge sums to 1025.
+				edges[{ std::min(a, b), std::max(a, b) }] += a < b ? 1 : 1024;
+			}
+		}
+
+		topology.EdgeCount = (std::uint32_t)edges.size();
+		for (const auto& edge : edges)
+			topology.OpenEdges += edge.second != 1025;
+		return topology;
+	}
+
+	// Euler characteristic of the surface with the vertices welded, 2 for a closed sphere.
+	int Euler(const Topology& topology)
+	{
+		return (int)topology.PositionCount - (int)topology.EdgeCount + (int)topology.TriangleCount;
+	}
+
+	std::vector<std::uint16_t> Indices16(const std::vector<std::uint32_t>& indices)
+	{
+		return std::vector<std::uint16_t>(indices.begin(), indices.end());
+	}
+}
+
+TEST(GeometryGenerator, SubdividedGeospheresAreWelded)
+{
+	GeometryGenerator generator;
+	MeshData previous;
+	for (std::uint32_t level = 0; level <= 6; ++level)
+	{
+		MeshData mesh = generator.CreateGeosphere(2.0f, level);
+		GeometryGenerator::MeshSize size = GeometryGenerator::GeosphereSize(level);
+		REQUIRE_EQ(mesh.Vertices.size(), (size_t)size.VertexCount);
+		REQUIRE_EQ(mesh.Indices32.size(), (size_t)size.IndexCount);
+
+		// Every edge has one midpoint, so no position repeats and the surface stays closed.
+		Topology topology = Analyze(mesh);
+		REQUIRE(topology.IndicesInRange);
+		CHECK_EQ(topology.DuplicatePositions, 0u);
+		CHECK_EQ(topology.OpenEdges, 0u);
+		CHECK_EQ(Euler(topology), 2);
+		CHECK_EQ(topology.DegenerateTriangles, 0u);
+		CHECK_EQ(topology.InvertedTriangles, 0u);
+		CHECK_EQ(topology.EdgeCount, 3 * size.IndexCount / 6);
+
+		std::uint32_t offSphere = 0;
+		for (const GeometryGenerator::Vertex& v : mesh.Vertices)
+		{
+			XMVECTOR p = XMLoadFloat3(&v.Position);
+			offSphere += std::fabs(XMVectorGetX(XMVector3Length(p)) - 2.0f) > 1e-5f;
+			offSphere += XMVectorGetX(XMVector3Length(XMVector3Normalize(p) - XMLoadFloat3(&v.Normal))) > 1e-5f;
+		}
+		CHECK_EQ(offSphere, 0u);
+
+		// Midpoints are appended, the vertices of the previous level keep their place.
+		std::uint32_t moved = 0;
+		for (size_t v = 0; v < previous.Vertices.size(); ++v)
+		{
+			XMVECTOR d = XMLoadFloat3(&mesh.Vertices[v].Position) - XMLoadFloat3(&previous.Vertices[v].Position);
+			moved += XMVectorGetX(XMVector3Length(d)) > 1e-5f;
+		}
+		CHECK_EQ(moved, 0u);
+		previous = std::move(mesh);
+	}
+
+	// Levels past six are capped.
+	CHECK_EQ(generator.CreateGeosphere(1.0f, 9).Vertices.size(), (size_t)GeometryGenerator::GeosphereSize(6).VertexCount);
+}
+
+TEST(GeometryGenerator, ShapesAreClosedAndFaceOutward)
+{
+	GeometryGenerator generator;
+	struct Shape
+	{
+		const char* Name;
+		MeshData Mesh;
+		GeometryGenerator::MeshSize Size;
+		// Vertices that repeat a position: seams, poles and the corners of separate faces.
+		std::uint32_t Duplicates;
+	};
+	const std::uint32_t side = (1u << 3) + 1;
+	Shape shapes[] = {
+		// Each face has its own vertices, shared along the 12 edges by two faces and at the
+		// 8 corners by three.
+		{ "box", generator.CreateBox(1.0f, 2.0f, 3.0f, 3), GeometryGenerator::BoxSize(3), 6 * side * side - (6 * (side - 2) * (side - 2) + 12 * (side - 2) + 8) },
+		// The first column of every ring is repeated for the texture seam.
+		{ "sphere", generator.CreateSphere(1.5f, 20, 10), GeometryGenerator::SphereSize(20, 10), 9 },
+		// The rings of the caps repeat the rings at the ends of the side.
+		{ "cylinder", generator.CreateCylinder(1.0f, 0.5f, 3.0f, 16, 4), GeometryGenerator::CylinderSize(16, 4), 5 + 2 * 17 },
+	};
+	for (const Shape& shape : shapes)
+	{
+		REQUIRE_EQ(shape.Mesh.Vertices.size(), (size_t)shape.Size.VertexCount);
+		REQUIRE_EQ(shape.Mesh.Indices32.size(), (size_t)shape.Size.IndexCount);
+		Topology topology = Analyze(shape.Mesh);
+		REQUIRE(topology.IndicesInRange);
+		CHECK_MSG(topology.DuplicatePositions == shape.Duplicates, shape.Name << ": " << topology.DuplicatePositions);
+		CHECK_MSG(topology.OpenEdges == 0, shape.Name << ": " << topology.OpenEdges);
+		CHECK_MSG(Euler(topology) == 2, shape.Name << ": " << Euler(topology));
+		CHECK_MSG(topology.DegenerateTriangles == 0, shape.Name << ": " << topology.DegenerateTriangles);
+		CHECK_MSG(topology.InvertedTriangles == 0, shape.Name << ": " << topology.InvertedTriangles);
+	}
+
+	// The grid is an open sheet: every interior edge is closed, the border is not.
+	MeshData grid = generator.CreateGrid(10.0f, 6.0f, 7, 11);
+	Topology topology = Analyze(grid);
+	REQUIRE(topology.IndicesInRange);
+	CHECK_EQ(topology.DuplicatePositions, 0u);
+	CHECK_EQ(topology.OpenEdges, 2u * (6 + 10));
+	CHECK_EQ(Euler(topology), 1);
+	CHECK_EQ(topology.InvertedTriangles, 0u);
+}
+
+TEST(GeometryGenerator, CountsBelowTheMinimumAreClamped)
+{
+	GeometryGenerator generator;
+	struct Case
+	{
+		MeshData Mesh;
+		GeometryGenerator::MeshSize Size;
+	};
+	Case cases[] = {
+		{ generator.CreateSphere(1.0f, 0, 1), GeometryGenerator::SphereSize(0, 1) },
+		{ generator.CreateCylinder(1.0f, 1.0f, 1.0f, 1, 0), GeometryGenerator::CylinderSize(1, 0) },
+		{ generator.CreateGrid(1.0f, 1.0f, 0, 1), GeometryGenerator::GridSize(0, 1) },
+		{ generator.CreateBox(1.0f, 1.0f, 1.0f, 0), GeometryGenerator::BoxSize(0) },
+		{ generator.CreateQuad(0.0f, 0.0f, 1.0f, 1.0f, 0.0f), GeometryGenerator::QuadSize() },
+	};
+	for (const Case& c : cases)
+	{
+		CHECK_EQ(c.Mesh.Vertices.size(), (size_t)c.Size.VertexCount);
+		CHECK_EQ(c.Mesh.Indices32.size(), (size_t)c.Size.IndexCount);
+		CHECK_GT(c.Size.IndexCount, 0u);
+		Topology topology = Analyze(c.Mesh);
+		CHECK(topology.IndicesInRange);
+		CHECK_EQ(topology.DegenerateTriangles, 0u);
+	}
+	CHECK_EQ(GeometryGenerator::SphereSize(0, 1).VertexCount, GeometryGenerator::SphereSize(3, 2).VertexCount);
+}
+
+TEST(GeometryGenerator, BuffersMatchTheMeshData)
+{
+	GeometryGenerator generator;
+	MeshData expected = generator.CreateGeosphere(1.0f, 3);
+	GeometryGenerator::MeshSize size = GeometryGenerator::GeosphereSize(3);
+
+	// 16-bit indices and a layout with the normal first, without tangent and texture
+	// coordinates.  The position still starts every vertex.
+	struct Packed
+	{
+		float Position[3];
+		float Normal[3];
+		float Sentinel[2];
+	};
+	std::vector<Packed> vertices(size.VertexCount);
+	std::memset(vertices.data(), 0x7F, vertices.size() * sizeof(Packed));
+	std::vector<std::uint16_t> indices(size.IndexCount);
+	GeometryGenerator::MeshBuffers out = { vertices.data(),
+		{ sizeof(Packed), offsetof(Packed, Normal), GeometryGenerator::NoAttribute, GeometryGenerator::NoAttribute },
+		indices.data(), sizeof(std::uint16_t) };
+	generator.CreateGeosphere(1.0f, 3, out);
+
+	CHECK(indices == Indices16(expected.Indices32));
+	std::uint32_t different = 0, overwritten = 0;
+	for (size_t v = 0; v < vertices.size(); ++v)
+	{
+		different += std::memcmp(vertices[v].Position, &expected.Vertices[v].Position, sizeof(vertices[v].Position)) != 0;
+		different += std::memcmp(vertices[v].Normal, &expected.Vertices[v].Normal, sizeof(vertices[v].Normal)) != 0;
+		std::uint32_t sentinel;
+		std::memcpy(&sentinel, vertices[v].Sentinel, sizeof(sentinel));
+		overwritten += sentinel != 0x7F7F7F7Fu;
+	}
+	CHECK_EQ(different, 0u);
+	CHECK_EQ(overwritten, 0u);
+
+	// A generator reused for another shape gives the same result as a fresh one.
+	generator.CreateSphere(1.0f, 64, 64);
+	MeshData again = generator.CreateGeosphere(1.0f, 3);
+	CHECK(again.Indices32 == expected.Indices32);
+	CHECK(std::memcmp(again.Vertices.data(), expected.Vertices.data(), expected.Vertices.size() * sizeof(GeometryGenerator::Vertex)) == 0);
+}
+
+TEST(GeometryGenerator, ThreadedGridsMatchSerialOnes)
+{
+	GeometryGenerator generator;
+	const std::uint32_t m = 301, n = 257;
+	MeshData serial = generator.CreateGrid(30.0f, 20.0f, m, n);
+	CHECK_EQ(serial.Vertices.size(), (size_t)m * n);
+
+	MeshData threaded;
+	{
+		auto jobSystem = std::make_unique<JobSystem>(3);
+		threaded = generator.CreateGrid(30.0f, 20.0f, m, n);
+	}
+	CHECK(threaded.Indices32 == serial.Indices32);
+	CHECK(std::memcmp(threaded.Vertices.data(), serial.Vertices.data(), serial.Vertices.size() * sizeof(GeometryGenerator::Vertex)) == 0);
+
+	// Corners of the grid.
+	const XMFLOAT3& first = serial.Vertices.front().Position;
+	const XMFLOAT3& last = serial.Vertices.back().Position;
+	CHECK_NEAR(first.x, -15.0f, 1e-5f);
+	CHECK_NEAR(first.z, 10.0f, 1e-5f);
+	CHECK_NEAR(last.x, 15.0f, 1e-4f);
+	CHECK_NEAR(last.z, -10.0f, 1e-4f);
+}
@@ -0,0 +1,93 @@
+#include "Engine.h"
+#include "Graphics/InstanceBatcher.h"
+#include "Benchmark.h"
+#include "FakeObjects.h"
+
+#include <algorithm>
+#include <random>
+#include <tuple>
+
+using namespace DirectX;
+
+// Batches a large layer with InstanceBatcher and, as a reference, with a comparison sort of
+// the same fields, and prints how many draws batching saves.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const UINT itemCount = quick ? 2000 : 100000;
+	const int repeatCount = quick ? 1 : 20;
+	const UINT geometryCount = 40;
+	const UINT drawCount = 8;
+	const UINT textureCount = 64;
+
+	std::vector<Material> materials(textureCount);
+	for (UINT i = 0; i < textureCount; ++i)
+		materials[i].DiffuseSrvHeapIndex = (int)i;
+
+	std::mt19937 rng(9);
+	std::uniform_int_distribution<UINT> geometry(0, geometryCount - 1);
+	std::uniform_int_distribution<UINT> draw(0, drawCount - 1);
+	std::uniform_int_distribution<UINT> texture(0, textureCount - 1);
+	std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+
+	RenderItemStore items;
+	std::vector<RenderItemHandle> layer;
+	for (UINT i = 0; i < itemCount; ++i)
+	{
+		UINT d = draw(rng);
+		RenderItemDesc desc;
+		desc.Geo = FakeObject<MeshGeometry>(geometry(rng));
+		desc.Mat = &materials[texture(rng)];
+		desc.IndexCount = 36 * (d + 1);
+		desc.StartIndexLocation = 1000 * d;
+		desc.ObjConstantBufferIndex = i;
+
+		RenderItemHandle handle = items.Create(desc);
+		XMStoreFloat4x4(&items.Transform(handle).World, XMMatrixTranslation(position(rng), position(rng), position(rng)));
+		layer.push_back(handle);
+	}
+
+	InstanceBatcher batcher;
+	batcher.SetView(XMFLOAT3(0.0f, 0.0f, 0.0f), 1000.0f);
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			batcher.Clear();
+			batcher.Add(items, layer);
+		});
+	Benchmark::Report("InstanceBatcher::Add", ms, itemCount);
+
+	// The same grouping with std::sort on (geometry, draw, texture, distance).
+	using Key = std::tuple<UINT, UINT, int, float, UINT>;
+	std::vector<Key> keys;
+	std::vector<UINT> instances;
+	UINT referenceBatchCount = 0;
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			keys.clear();
+			for (RenderItemHandle handle : layer)
+			{
+				const RenderItemDrawArgs& args = items.DrawArgs(handle);
+				const XMFLOAT4X4& world = items.Transform(handle).World;
+				float distance = XMVectorGetX(XMVector3Length(XMVectorSet(world._41, world._42, world._43, 0.0f)));
+				keys.emplace_back(args.GeometryId, args.DrawId, items.Mat(handle)->DiffuseSrvHeapIndex, distance,
+					items.Transform(handle).ObjConstantBufferIndex);
+			}
+			std::sort(keys.begin(), keys.end());
+
+			instances.clear();
+			referenceBatchCount = 0;
+			for (size_t i = 0; i < keys.size(); ++i)
+			{
+				if (i == 0 || std::get<0>(keys[i - 1]) != std::get<0>(keys[i]) || std::get<1>(keys[i - 1]) != std::get<1>(keys[i]) ||
+					std::get<2>(keys[i - 1]) != std::get<2>(keys[i]))
+				{
+					++referenceBatchCount;
+				}
+				instances.push_back(std::get<4>(keys[i]));
+			}
+		});
+	Benchmark::Report("std::sort reference", ms, itemCount);
+
+	std::printf("%u items, %u batches (reference %u)\n", batcher.ItemCount(), batcher.BatchCount(), referenceBatchCount);
+	return batcher.BatchCount() == referenceBatchCount ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+#include "Engine.h"
+#include "Graphics/InstanceBatcher.h"
+#include "FakeObjects.h"
+#include "Test.h"
+
+#include <random>
+#include <set>
+#include <tuple>
+
+using namespace DirectX;
+
+namespace
+{
+	struct Scene
+	{
+		std::vector<Material> Materials;
+		RenderItemStore Items;
+		std::vector<RenderItemHandle> Layer;
+		// Item of every ObjConstantBufferIndex.
+		std::vector<RenderItemHandle> ByInstance;
+	};
+
+	// Items spread over the geometries, draws and textures, at random distances from the
+	// origin.  About one in five is hidden.
+	void Populate(Scene& scene, UINT itemCount, UINT geometryCount, UINT drawCount, UINT textureCount, unsigned seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_int_distribution<UINT> geometry(0, geometryCount - 1);
+		std::uniform_int_distribution<UINT> draw(0, drawCount - 1);
+		std::uniform_int_distribution<UINT> texture(0, textureCount - 1);
+		std::uniform_real_distribution<float> position(-400.0f, 400.0f);
+		std::uniform_int_distribution<int> hidden(0, 4);
+
+		scene.Materials.resize(textureCount);
+		for (UINT i = 0; i < textureCount; ++i)
+			scene.Materials[i].DiffuseSrvHeapIndex = (int)(textureCount - 1 - i) * 3;
+
+		for (UINT i = 0; i < itemCount; ++i)
+		{
+			UINT d = draw(rng);
+			RenderItemDesc desc;
+			desc.Geo = FakeObject<MeshGeometry>(geometry(rng));
+			desc.Mat = &scene.Materials[texture(rng)];
+			desc.IndexCount = 6 * (d + 1);
+			desc.StartIndexLocation = 100 * d;
+			desc.ObjConstantBufferIndex = (UINT)scene.ByInstance.size();
+			desc.IsVisible = hidden(rng) != 0;
+
+			RenderItemHandle handle = scene.Items.Create(desc);
+			XMStoreFloat4x4(&scene.Items.Transform(handle).World, XMMatrixTranslation(position(rng), position(rng), position(rng)));
+			scene.Layer.push_back(handle);
+			scene.ByInstance.push_back(handle);
+		}
+	}
+
+	using BatchKey = std::tuple<UINT, UINT, int>;
+
+	BatchKey KeyOf(const Scene& scene, RenderItemHandle handle)
+	{
+		const RenderItemDrawArgs& args = scene.Items.DrawArgs(handle);
+		return { args.GeometryId, args.DrawId, scene.Items.Mat(handle)->DiffuseSrvHeapIndex };
+	}
+
+	float Distance(const Scene& scene, RenderItemHandle handle, const XMFLOAT3& eye)
+	{
+		const XMFLOAT4X4& world = scene.Items.Transform(handle).World;
+		XMVECTOR d = XMVectorSet(world._41 - eye.x, world._42 - eye.y, world._43 - eye.z, 0.0f);
+		return XMVectorGetX(XMVector3Length(d));
+	}
+
+	// The batches of range hold every visible item of the layer once, each batch only
+	// items that can be drawn with its item's arguments, and no two batches could have
+	// been merged.
+	void CheckBatches(const Scene& scene, const std::vector<RenderItemHandle>& layer, const InstanceBatcher& batcher,
+		InstanceBatcher::Range range)
+	{
+		std::vector<UINT> drawn(scene.ByInstance.size(), 0);
+		std::set<BatchKey> batchKeys;
+		UINT mixed = 0;
+		UINT duplicates = 0;
+		for (UINT b = range.FirstBatch; b < range.FirstBatch + range.BatchCount; ++b)
+		{
+			const InstanceBatch& batch = batcher.Batches()[b];
+			BatchKey key = KeyOf(scene, batch.Item);
+			duplicates += !batchKeys.insert(key).second;
+			for (UINT i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; ++i)
+			{
+				UINT instance = batcher.Instances()[i];
+				REQUIRE(instance < drawn.size());
+				drawn[instance]++;
+				mixed += KeyOf(scene, scene.ByInstance[instance]) != key;
+			}
+		}
+		CHECK_EQ(mixed, 0u);
+		CHECK_EQ(duplicates, 0u);
+
+		std::vector<UINT> expected(scene.ByInstance.size(), 0);
+		std::set<BatchKey> visibleKeys;
+		for (RenderItemHandle handle : layer)
+		{
+			if (scene.Items.Flags(handle).IsVisible)
+			{
+				expected[scene.Items.Transform(handle).ObjConstantBufferIndex] = 1;
+				visibleKeys.insert(KeyOf(scene, handle));
+			}
+		}
+		CHECK(drawn == expected);
+		CHECK(batchKeys == visibleKeys);
+	}
+}
+
+TEST(InstanceBatcher, BatchesMatchTheDistinctDraws)
+{
+	Scene scene;
+	Populate(scene, 3000, 5, 4, 6, 11);
+
+	InstanceBatcher batcher;
+	batcher.SetView(XMFLOAT3(0.0f, 0.0f, 0.0f), 1000.0f);
+	InstanceBatcher::Range range = batcher.Add(scene.Items, scene.Layer);
+	CHECK_EQ(range.FirstBatch, 0u);
+	CheckBatches(scene, scene.Layer, batcher, range);
+
+	UINT visibleCount = 0;
+	for (RenderItemHandle handle : scene.Layer)
+		visibleCount += scene.Items.Flags(handle).IsVisible;
+	CHECK_EQ(batcher.ItemCount(), visibleCount);
+	CHECK_EQ(batcher.BatchCount(), range.BatchCount);
+	CHECK_LE(range.BatchCount, 5u * 4u * 6u);
+}
+
+TEST(InstanceBatcher, BatchesOfAGeometryAreAdjacent)
+{
+	Scene scene;
+	Populate(scene, 2000, 6, 5, 4, 12);
+
+	InstanceBatcher batcher;
+	InstanceBatcher::Range range = batcher.Add(scene.Items, scene.Layer);
+
+	// Sorting by geometry first means the vertex and index buffers change once per
+	// geometry, and the draw arguments once per draw.
+	std::set<UINT> finishedGeometries;
+	std::set<std::pair<UINT, UINT>> finishedDraws;
+	UINT geometrySwitchBacks = 0;
+	UINT drawSwitchBacks = 0;
+	for (UINT b = 0; b < range.BatchCount; ++b)
+	{
+		const RenderItemDrawArgs& args = scene.Items.DrawArgs(batcher.Batches()[b].Item);
+		if (b > 0)
+		{
+			const RenderItemDrawArgs& previous = scene.Items.DrawArgs(batcher.Batches()[b - 1].Item);
+			if (previous.GeometryId != args.GeometryId)
+				geometrySwitchBacks += !finishedGeometries.insert(previous.GeometryId).second;
+			if (previous.GeometryId != args.GeometryId || previous.DrawId != args.DrawId)
+				drawSwitchBacks += !finishedDraws.insert({ previous.GeometryId, previous.DrawId }).second;
+		}
+		geometrySwitchBacks += finishedGeometries.count(args.GeometryId) != 0;
+		drawSwitchBacks += finishedDraws.count({ args.GeometryId, args.DrawId }) != 0;
+	}
+	CHECK_EQ(geometrySwitchBacks, 0u);
+	CHECK_EQ(drawSwitchBacks, 0u);
+}
+
+TEST(InstanceBatcher, InstancesAreOrderedByDistance)
+{
+	Scene scene;
+	Populate(scene, 2000, 2, 2, 2, 13);
+
+	const XMFLOAT3 eye(30.0f, -20.0f, 10.0f);
+	const float farZ = 1000.0f;
+	// Distances within one depth bucket may come in any order.
+	const float bucketSize = farZ / (1 << InstanceBatcher::DepthBits);
+
+	for (bool backToFront : { false, true })
+	{
+		InstanceBatcher batcher;
+		batcher.SetView(eye, farZ);
+		InstanceBatcher::Range range = batcher.Add(scene.Items, scene.Layer, backToFront);
+		CheckBatches(scene, scene.Layer, batcher, range);
+
+		UINT misordered = 0;
+		for (const InstanceBatch& batch : batcher.Batches())
+		{
+			for (UINT i = batch.FirstInstance + 1; i < batch.FirstInstance + batch.InstanceCount; ++i)
+			{
+				float previous = Distance(scene, scene.ByInstance[batcher.Instances()[i - 1]], eye);
+				float current = Distance(scene, scene.ByInstance[batcher.Instances()[i]], eye);
+				misordered += backToFront ? current > previous + bucketSize : current < previous - bucketSize;
+			}
+		}
+		CHECK_MSG(misordered == 0, (backToFront ? "back to front: " : "front to back: ") << misordered << " instances out of order");
+	}
+}
+
+TEST(InstanceBatcher, LayersAreBatchedOnTheirOwn)
+{
+	Scene scene;
+	Populate(scene, 600, 3, 3, 3, 14);
+
+	// Two layers that share draws, the second one a subset of the first.
+	std::vector<RenderItemHandle> subset;
+	for (size_t i = 0; i < scene.Layer.size(); i += 3)
+		subset.push_back(scene.Layer[i]);
+
+	InstanceBatcher batcher;
+	InstanceBatcher::Range first = batcher.Add(scene.Items, scene.Layer);
+	InstanceBatcher::Range second = batcher.Add(scene.Items, subset, true);
+	InstanceBatcher::Range empty = batcher.Add(scene.Items, {});
+
+	CHECK_EQ(second.FirstBatch, first.FirstBatch + first.BatchCount);
+	CHECK_EQ(empty.BatchCount, 0u);
+	CHECK_EQ(batcher.BatchCount(), first.BatchCount + second.BatchCount);
+	CheckBatches(scene, scene.Layer, batcher, first);
+	CheckBatches(scene, subset, batcher, second);
+
+	batcher.Clear();
+	CHECK_EQ(batcher.BatchCount(), 0u);
+	CHECK_EQ(batcher.ItemCount(), 0u);
+	CHECK(batcher.Instances().empty());
+}
+
+TEST(InstanceBatcher, SortKeysOrderByGeometryDrawTextureDepth)
+{
+	const UINT maxGeometry = (1u << InstanceBatcher::GeometryBits) - 1;
+	const UINT maxDraw = (1u << InstanceBatcher::DrawBits) - 1;
+	const UINT maxTexture = (1u << InstanceBatcher::TextureBits) - 1;
+	const UINT maxDepth = (1u << InstanceBatcher::DepthBits) - 1;
+
+	// Each field outweighs all fields below it, even when those are at their maximum.
+	CHECK_LT(InstanceBatcher::MakeSortKey(0, maxDraw, maxTexture, maxDepth), InstanceBatcher::MakeSortKey(1, 0, 0, 0));
+	CHECK_LT(InstanceBatcher::MakeSortKey(0, 0, maxTexture, maxDepth), InstanceBatcher::MakeSortKey(0, 1, 0, 0));
+	CHECK_LT(InstanceBatcher::MakeSortKey(0, 0, 0, maxDepth), InstanceBatcher::MakeSortKey(0, 0, 1, 0));
+	CHECK_LT(InstanceBatcher::MakeSortKey(0, 0, 0, 0), InstanceBatcher::MakeSortKey(0, 0, 0, 1));
+
+	// The fields do not overlap.
+	CHECK_EQ(InstanceBatcher::MakeSortKey(maxGeometry, maxDraw, maxTexture, maxDepth), ~0ull);
+	CHECK_EQ(InstanceBatcher::MakeSortKey(maxGeometry, 0, 0, 0) | InstanceBatcher::MakeSortKey(0, maxDraw, 0, 0) |
+		InstanceBatcher::MakeSortKey(0, 0, maxTexture, 0) | InstanceBatcher::MakeSortKey(0, 0, 0, maxDepth), ~0ull);
+	CHECK_EQ(InstanceBatcher::MakeSortKey(maxGeometry, 0, 0, 0) & InstanceBatcher::MakeSortKey(0, maxDraw, maxTexture, maxDepth), 0ull);
+	CHECK_EQ(InstanceBatcher::MakeSortKey(0, 0, maxTexture, 0) & InstanceBatcher::MakeSortKey(0, 0, 0, maxDepth), 0ull);
+	CHECK_EQ(InstanceBatcher::DepthBits + InstanceBatcher::TextureBits + InstanceBatcher::DrawBits + InstanceBatcher::GeometryBits, 64u);
+}
+
+TEST(InstanceBatcher, TooManyTexturesSplitTheLayerIntoRuns)
+{
+	// More textures than the texture field holds: the layer is batched in runs, which may
+	// repeat a key but still draw every item once and never mix draws.
+	const UINT textureCount = (1u << InstanceBatcher::TextureBits) + 1000;
+	Scene scene;
+	Populate(scene, 3 * textureCount, 2, 2, textureCount, 15);
+
+	InstanceBatcher batcher;
+	InstanceBatcher::Range range = batcher.Add(scene.Items, scene.Layer);
+
+	std::vector<UINT> drawn(scene.ByInstance.size(), 0);
+	UINT mixed = 0;
+	for (UINT b = range.FirstBatch; b < range.FirstBatch + range.BatchCount; ++b)
+	{
+		const InstanceBatch& batch = batcher.Batches()[b];
+		for (UINT i = batch.FirstInstance; i < batch.FirstInstance + batch.InstanceCount; ++i)
+		{
+			drawn[batcher.Instances()[i]]++;
+			mixed += KeyOf(scene, scene.ByInstance[batcher.Instances()[i]]) != KeyOf(scene, batch.Item);
+		}
+	}
+	CHECK_EQ(mixed, 0u);
+
+	UINT wrong = 0;
+	for (RenderItemHandle handle : scene.Layer)
+		wrong += drawn[scene.Items.Transform(handle).ObjConstantBufferIndex] != (scene.Items.Flags(handle).IsVisible ? 1u : 0u);
+	CHECK_EQ(wrong, 0u);
+
+	// Every run holds at most 1 << TextureBits textures, so the layer needs at least two.
+	std::set<BatchKey> keys;
+	for (UINT b = range.FirstBatch; b < range.FirstBatch + range.BatchCount; ++b)
+		keys.insert(KeyOf(scene, batcher.Batches()[b].Item));
+	CHECK_GT(range.BatchCount, (UINT)keys.size());
+	CHECK_LT(range.BatchCount, batcher.ItemCount());
+}
+
+TEST(InstanceBatcher, MaterialsWithoutTextureAreBatched)
+{
+	Scene scene;
+	Populate(scene, 500, 2, 2, 3, 16);
+	scene.Materials[1].DiffuseSrvHeapIndex = -1;
+
+	InstanceBatcher batcher;
+	InstanceBatcher::Range range = batcher.Add(scene.Items, scene.Layer);
+	CheckBatches(scene, scene.Layer, batcher, range);
+}
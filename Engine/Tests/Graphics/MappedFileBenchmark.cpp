@@ -0,0 +1,65 @@
+#include "Engine.h"
+#include "Graphics/MappedFile.h"
+#include "Benchmark.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace
+{
+	std::uint64_t Sum(const std::uint8_t* data, size_t size)
+	{
+		std::uint64_t sum = 0;
+		for (size_t i = 0; i < size; ++i)
+			sum += data[i];
+		return sum;
+	}
+}
+
+// Reads every file in Content/Textures once into a heap buffer, as the DDS loader used to,
+// and once through a mapping, then reads each byte.  Files stay in the OS cache, so this
+// measures the copy, not the disk.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 20;
+
+	std::vector<std::filesystem::path> paths;
+	double totalBytes = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(ENGINE_CONTENT_DIR) / "Textures"))
+	{
+		paths.push_back(entry.path());
+		totalBytes += (double)entry.file_size();
+	}
+	std::printf("%zu files, %.0f bytes, times per byte\n", paths.size(), totalBytes);
+
+	std::uint64_t readSum = 0;
+	std::vector<std::uint8_t> buffer;
+	double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			readSum = 0;
+			for (const std::filesystem::path& path : paths)
+			{
+				std::ifstream file(path, std::ios::binary);
+				buffer.resize((size_t)std::filesystem::file_size(path));
+				file.read(reinterpret_cast<char*>(buffer.data()), (std::streamsize)buffer.size());
+				readSum += Sum(buffer.data(), buffer.size());
+			}
+		});
+	Benchmark::Report("ifstream into a buffer", ms, totalBytes);
+
+	std::uint64_t mappedSum = 0;
+	ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+		{
+			mappedSum = 0;
+			for (const std::filesystem::path& path : paths)
+			{
+				MappedFile file;
+				file.Open(path.wstring());
+				mappedSum += Sum(file.Data(), file.Size());
+			}
+		});
+	Benchmark::Report("MappedFile", ms, totalBytes);
+
+	return readSum == mappedSum ? 0 : 1;
+}
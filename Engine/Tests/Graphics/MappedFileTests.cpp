@@ -0,0 +1,88 @@
+#include "Engine.h"
+#include "Graphics/MappedFile.h"
+#include "Test.h"
+#include "TempDirectory.h"
+
+#include <cstring>
+#include <filesystem>
+
+TEST(MappedFile, ShippedTexturesMatchTheirBytes)
+{
+	int mapped = 0;
+	for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(ENGINE_CONTENT_DIR) / "Textures"))
+	{
+		if (entry.path().extension() != ".dds")
+			continue;
+
+		std::vector<std::uint8_t> expected = TempDirectory::Read(entry.path().wstring());
+		MappedFile file;
+		REQUIRE(file.Open(entry.path().wstring()));
+		CHECK_MSG(file.Size() == expected.size() && std::memcmp(file.Data(), expected.data(), expected.size()) == 0,
+			entry.path().filename().string());
+		CHECK(std::memcmp(file.Data(), "DDS ", 4) == 0);
+		++mapped;
+	}
+	CHECK_GT(mapped, 0);
+}
+
+TEST(MappedFile, SizesAroundPagesAreMappedWhole)
+{
+	TempDirectory directory;
+	for (size_t size : { (size_t)1, (size_t)4095, (size_t)4096, (size_t)4097, (size_t)65536 * 3 + 7 })
+	{
+		std::vector<std::uint8_t> bytes(size);
+		for (size_t i = 0; i < size; ++i)
+			bytes[i] = (std::uint8_t)(i * 31 + 7);
+
+		MappedFile file;
+		REQUIRE(file.Open(directory.Write("file.bin", bytes.data(), bytes.size())));
+		CHECK_MSG(file.Size() == size && std::memcmp(file.Data(), bytes.data(), size) == 0, size << " bytes");
+	}
+}
+
+TEST(MappedFile, FailuresLeaveItClosed)
+{
+	TempDirectory directory;
+	MappedFile file;
+	CHECK(!file.IsOpen());
+	CHECK(file.Data() == nullptr);
+	CHECK_EQ(file.Size(), (size_t)0);
+
+	CHECK(!file.Open(directory.Path("missing.bin")));
+	CHECK(!file.IsOpen());
+
+	// Empty files cannot be mapped.
+	CHECK(!file.Open(directory.Write("empty.bin", "", 0)));
+	CHECK(!file.IsOpen());
+	CHECK_EQ(file.Size(), (size_t)0);
+
+	// A failed Open closes the file that was open before.
+	REQUIRE(file.Open(directory.Write("one.bin", "one")));
+	CHECK(!file.Open(directory.Path("missing.bin")));
+	CHECK(!file.IsOpen());
+	CHECK(file.Data() == nullptr);
+}
+
+TEST(MappedFile, ReopenAndClose)
+{
+	TempDirectory directory;
+	std::wstring first = directory.Write("first.bin", "first file");
+	std::wstring second = directory.Write("second.bin", "2nd");
+
+	MappedFile file;
+	REQUIRE(file.Open(first));
+	CHECK_EQ(file.Size(), (size_t)10);
+	REQUIRE(file.Open(second));
+	CHECK_EQ(file.Size(), (size_t)3);
+	CHECK(std::memcmp(file.Data(), "2nd", 3) == 0);
+
+	file.Close();
+	CHECK(!file.IsOpen());
+	CHECK_EQ(file.Size(), (size_t)0);
+	file.Close();
+
+	// Closed files can be removed, nothing keeps them open.
+	std::error_code error;
+	CHECK(std::filesystem::remove(std::filesystem::path(first), error));
+	CHECK(std::filesystem::remove(std::filesystem::path(second), error));
+}
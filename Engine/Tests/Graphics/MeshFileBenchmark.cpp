@@ -0,0 +1,92 @@
+#include "Engine.h"
+#include "Graphics/MeshFile.h"
+#include "Graphics/ModelLoader.h"
+#include "Graphics/Vertex.h"
+#include "Benchmark.h"
+#include "TempDirectory.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+namespace
+{
+	std::uint64_t Touch(const void* data, size_t byteSize)
+	{
+		std::uint64_t sum = 0;
+		const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+		for (size_t i = 0; i < byteSize; i += 64)
+			sum += bytes[i];
+		return sum;
+	}
+
+	void Run(const std::string& name, int repeatCount, const TempDirectory& directory)
+	{
+		std::wstring textPath = (std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / (name + ".txt")).wstring();
+		std::wstring meshPath = directory.Path(name + ".mesh");
+
+		MeshFile converted;
+		if (!converted.ParseText(textPath) || !converted.Save(meshPath))
+		{
+			std::printf("%s: cannot convert\n", name.c_str());
+			std::exit(1);
+		}
+		const double vertexCount = converted.Header().VertexCount;
+		std::printf("%s: %u vertices, %u triangles\n", name.c_str(), converted.Header().VertexCount,
+			converted.Header().Lods[0].IndexCount / 3);
+
+		std::uint64_t sum = 0;
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				ModelLoader loader;
+				loader.Open(textPath);
+				std::vector<Vertex> vertices(loader.VertexCount());
+				std::vector<std::uint32_t> indices(3 * (size_t)loader.TriangleCount());
+				loader.ParseVertices(vertices.data());
+				loader.ParseIndices(indices.data(), sizeof(std::uint32_t));
+				sum += Touch(vertices.data(), vertices.size() * sizeof(Vertex));
+			});
+		Benchmark::Report("  ModelLoader, text only", ms, vertexCount);
+
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				MeshFile file;
+				file.ParseText(textPath);
+				sum += Touch(file.Vertices(), file.VertexBufferByteSize());
+			});
+		Benchmark::Report("  MeshFile::ParseText", ms, vertexCount);
+
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				MeshFile file;
+				file.Open(meshPath);
+				sum += Touch(file.Vertices(), file.VertexBufferByteSize());
+				sum += Touch(file.Indices(), file.IndexBufferByteSize());
+			});
+		Benchmark::Report("  MeshFile::Open", ms, vertexCount);
+
+		std::printf("  (checksum %llu)\n", (unsigned long long)sum);
+	}
+}
+
+// Loads the models in Content/Models the three ways Graphics can: parsing the text only,
+// converting it the way a stale cache does (parse, optimize, build the levels of detail
+// and the meshlets), and opening the binary cache.  Every way reads the whole vertex and
+// index data once, as the GPU upload would.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 10;
+
+	TempDirectory directory;
+	Run("car", repeatCount, directory);
+	if (!quick)
+		Run("skull", repeatCount, directory);
+
+	std::unique_ptr<JobSystem> jobSystem = std::make_unique<JobSystem>();
+	std::printf("With %u threads\n", jobSystem->ThreadCount());
+	Run(quick ? "car" : "skull", repeatCount, directory);
+
+	return 0;
+}
@@ -0,0 +1,241 @@
+#include "Engine.h"
+#include "Graphics/MeshFile.h"
+#include "Graphics/Vertex.h"
+#include "Test.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <tuple>
+
+namespace
+{
+	using Position = std::tuple<float, float, float>;
+	using Triangle = std::array<std::uint32_t, 3>;
+
+	std::uint32_t GetIndex(const MeshFile& file, size_t i)
+	{
+		if (file.Header().IndexByteSize == sizeof(std::uint16_t))
+			return static_cast<const std::uint16_t*>(file.Indices())[i];
+		return static_cast<const std::uint32_t*>(file.Indices())[i];
+	}
+
+	// Rotates the smallest index to the front, keeping the winding.
+	Triangle Canonical(Triangle t)
+	{
+		std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+		return t;
+	}
+
+	// Byte size of the image, as Validate expects it.
+	size_t ImageByteSize(const MeshFile& file)
+	{
+		size_t end = sizeof(MeshFileHeader) + file.VertexBufferByteSize() + file.IndexBufferByteSize();
+		return ((end + 3) & ~(size_t)3) + file.Header().MeshletCount * sizeof(Meshlet);
+	}
+
+	std::vector<std::uint8_t> Image(const MeshFile& file)
+	{
+		const std::uint8_t* data = reinterpret_cast<const std::uint8_t*>(&file.Header());
+		return std::vector<std::uint8_t>(data, data + ImageByteSize(file));
+	}
+}
+
+TEST(MeshFile, ParseTextKeepsEveryVertexAndTriangle)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(24, 16);
+	std::wstring path = directory.Write("terrain.txt", model.ToText());
+
+	MeshFile file;
+	MeshOptimizer::Result stats;
+	REQUIRE(file.ParseText(path, &stats));
+
+	const MeshFileHeader& header = file.Header();
+	CHECK_EQ(header.Magic, MeshFile::FileMagic);
+	CHECK_EQ(header.Version, MeshFile::FileVersion);
+	REQUIRE_EQ(header.VertexCount, model.VertexCount());
+	CHECK_EQ(header.VertexByteStride, (std::uint32_t)sizeof(Vertex));
+	CHECK_EQ(header.IndexByteSize, (std::uint32_t)sizeof(std::uint16_t));
+	REQUIRE(header.LodCount >= 1);
+	CHECK_EQ(header.Lods[0].FirstIndex, 0u);
+	REQUIRE_EQ(header.Lods[0].IndexCount, (std::uint32_t)model.Indices.size());
+	CHECK_GT(header.MeshletCount, 0u);
+	CHECK_LE(stats.After.Acmr, stats.Before.Acmr);
+
+	// The optimizer reorders the vertices, so they are matched up by position.
+	std::map<Position, std::uint32_t> sourceIndex;
+	for (std::uint32_t i = 0; i < model.VertexCount(); ++i)
+		sourceIndex[{ model.Vertices[6 * i], model.Vertices[6 * i + 1], model.Vertices[6 * i + 2] }] = i;
+
+	const Vertex* vertices = static_cast<const Vertex*>(file.Vertices());
+	std::vector<std::uint32_t> remap(header.VertexCount);
+	for (std::uint32_t i = 0; i < header.VertexCount; ++i)
+	{
+		const Vertex& v = vertices[i];
+		auto found = sourceIndex.find({ v.Pos.x, v.Pos.y, v.Pos.z });
+		REQUIRE(found != sourceIndex.end());
+		remap[i] = found->second;
+
+		const float* source = &model.Vertices[6 * found->second];
+		CHECK(v.Normal.x == source[3] && v.Normal.y == source[4] && v.Normal.z == source[5]);
+		CHECK(v.TexC.x == 0.0f && v.TexC.y == 0.0f);
+	}
+	sourceIndex.clear();
+
+	std::vector<Triangle> expected;
+	for (size_t i = 0; i < model.Indices.size(); i += 3)
+		expected.push_back(Canonical({ model.Indices[i], model.Indices[i + 1], model.Indices[i + 2] }));
+
+	std::vector<Triangle> actual;
+	for (size_t i = 0; i < header.Lods[0].IndexCount; i += 3)
+		actual.push_back(Canonical({ remap[GetIndex(file, i)], remap[GetIndex(file, i + 1)], remap[GetIndex(file, i + 2)] }));
+
+	std::sort(expected.begin(), expected.end());
+	std::sort(actual.begin(), actual.end());
+	CHECK(actual == expected);
+
+	// The meshlets tile level 0 in order.
+	std::uint32_t next = 0;
+	for (std::uint32_t i = 0; i < header.MeshletCount; ++i)
+	{
+		CHECK_EQ(file.Meshlets()[i].FirstIndex, next);
+		next += file.Meshlets()[i].IndexCount;
+	}
+	CHECK_EQ(next, header.Lods[0].IndexCount);
+}
+
+TEST(MeshFile, LargeMeshesUse32BitIndices)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(1, 0x8000);
+	REQUIRE(model.VertexCount() > 0x10000u);
+	std::wstring path = directory.Write("strip.txt", model.ToText());
+
+	MeshFile file;
+	REQUIRE(file.ParseText(path));
+	CHECK_EQ(file.Header().IndexByteSize, (std::uint32_t)sizeof(std::uint32_t));
+	CHECK_EQ(file.IndexBufferByteSize(), file.Header().IndexCount * 4u);
+
+	std::uint32_t maxIndex = 0;
+	for (size_t i = 0; i < file.Header().IndexCount; ++i)
+		maxIndex = std::max(maxIndex, GetIndex(file, i));
+	CHECK_EQ(maxIndex, model.VertexCount() - 1);
+}
+
+TEST(MeshFile, SaveThenOpenMapsTheSameImage)
+{
+	TempDirectory directory;
+	std::wstring textPath = directory.Write("terrain.txt", TextModel::Terrain(20, 20).ToText());
+	std::wstring meshPath = directory.Path("terrain.mesh");
+
+	MeshFile parsed;
+	REQUIRE(parsed.ParseText(textPath));
+	REQUIRE(parsed.Save(meshPath));
+	CHECK(!std::filesystem::exists(meshPath + L".tmp"));
+
+	std::vector<std::uint8_t> image = Image(parsed);
+	CHECK(TempDirectory::Read(meshPath) == image);
+
+	MeshFile opened;
+	REQUIRE(opened.Open(meshPath));
+	CHECK(Image(opened) == image);
+	CHECK_EQ(opened.VertexBufferByteSize(), parsed.VertexBufferByteSize());
+	CHECK_EQ(opened.IndexBufferByteSize(), parsed.IndexBufferByteSize());
+
+	// Saving again replaces the file.
+	MeshFile smaller;
+	REQUIRE(smaller.ParseText(directory.Write("small.txt", TextModel::Terrain(4, 4).ToText())));
+	REQUIRE(smaller.Save(meshPath));
+	CHECK(TempDirectory::Read(meshPath) == Image(smaller));
+}
+
+TEST(MeshFile, IsUpToDateFollowsTheSource)
+{
+	TempDirectory directory;
+	std::string text = TextModel::Terrain(8, 8).ToText();
+	std::wstring textPath = directory.Write("terrain.txt", text);
+	std::wstring meshPath = directory.Path("terrain.mesh");
+
+	MeshFile file;
+	CHECK(!file.IsUpToDate(textPath));
+	REQUIRE(file.ParseText(textPath));
+	CHECK(file.IsUpToDate(textPath));
+	REQUIRE(file.Save(meshPath));
+
+	MeshFile cached;
+	REQUIRE(cached.Open(meshPath));
+	CHECK(cached.IsUpToDate(textPath));
+	CHECK(!cached.IsUpToDate(directory.Path("missing.txt")));
+
+	// Same size, newer write time.
+	std::filesystem::path source(textPath);
+	std::filesystem::last_write_time(source, std::filesystem::last_write_time(source) + std::chrono::seconds(2));
+	CHECK(!cached.IsUpToDate(textPath));
+
+	// Different size.
+	REQUIRE(file.ParseText(textPath));
+	CHECK(file.IsUpToDate(textPath));
+	directory.Write("terrain.txt", text + "\r\n");
+	CHECK(!file.IsUpToDate(textPath));
+}
+
+TEST(MeshFile, OpenRejectsDamagedFiles)
+{
+	TempDirectory directory;
+	MeshFile parsed;
+	REQUIRE(parsed.ParseText(directory.Write("terrain.txt", TextModel::Terrain(12, 12).ToText())));
+	const std::vector<std::uint8_t> image = Image(parsed);
+
+	MeshFile file;
+	CHECK(!file.Open(directory.Path("missing.mesh")));
+	CHECK(!file.Open(directory.Write("empty.mesh", "")));
+	CHECK(!file.Open(directory.Write("header.mesh", image.data(), sizeof(MeshFileHeader) - 1)));
+	CHECK(!file.Open(directory.Write("truncated.mesh", image.data(), image.size() - 1)));
+
+	std::vector<std::uint8_t> longer = image;
+	longer.push_back(0);
+	CHECK(!file.Open(directory.Write("longer.mesh", longer.data(), longer.size())));
+
+	auto patched = [&](const char* name, auto patch)
+		{
+			std::vector<std::uint8_t> bytes = image;
+			MeshFileHeader header;
+			std::memcpy(&header, bytes.data(), sizeof(header));
+			patch(header);
+			std::memcpy(bytes.data(), &header, sizeof(header));
+			return directory.Write(name, bytes.data(), bytes.size());
+		};
+
+	CHECK(!file.Open(patched("magic.mesh", [](MeshFileHeader& h) { h.Magic = 0; })));
+	CHECK(!file.Open(patched("version.mesh", [](MeshFileHeader& h) { h.Version = MeshFile::FileVersion - 1; })));
+	CHECK(!file.Open(patched("stride.mesh", [](MeshFileHeader& h) { h.VertexByteStride += 4; })));
+	CHECK(!file.Open(patched("indexsize.mesh", [](MeshFileHeader& h) { h.IndexByteSize = 1; })));
+	CHECK(!file.Open(patched("lodcount.mesh", [](MeshFileHeader& h) { h.LodCount = MeshSimplifier::MaxLodCount + 1; })));
+	CHECK(!file.Open(patched("lodrange.mesh", [](MeshFileHeader& h) { h.Lods[0].IndexCount = h.IndexCount + 3; })));
+
+	// A failed Open leaves nothing mapped, and the intact image still opens.
+	CHECK(!file.IsUpToDate(directory.Path("terrain.txt")));
+	CHECK(file.Open(directory.Write("intact.mesh", image.data(), image.size())));
+}
+
+TEST(MeshFile, ParseTextRejectsBrokenModels)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(3, 3);
+
+	MeshFile file;
+	CHECK(!file.ParseText(directory.Path("missing.txt")));
+
+	std::string text = model.ToText();
+	CHECK(!file.ParseText(directory.Write("truncated.txt", text.substr(0, text.size() / 2))));
+
+	model.Indices[4] = model.VertexCount();
+	CHECK(!file.ParseText(directory.Write("index.txt", model.ToText())));
+	CHECK(!file.Save(directory.Path("nothing.mesh")));
+}
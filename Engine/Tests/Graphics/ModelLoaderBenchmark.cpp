@@ -0,0 +1,63 @@
+#include "Engine.h"
+#include "Graphics/ModelLoader.h"
+#include "Graphics/Vertex.h"
+#include "Benchmark.h"
+#include "TextModel.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+
+namespace
+{
+	void Run(const char* name, int repeatCount)
+	{
+		std::filesystem::path path = std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / name;
+		std::ifstream file(path, std::ios::binary);
+		std::ostringstream text;
+		text << file.rdbuf();
+
+		TextModel reference;
+		if (!TextModel::Parse(text.str(), reference))
+		{
+			std::printf("%s: cannot parse\n", name);
+			std::exit(1);
+		}
+		std::printf("%s: %u vertices, %u triangles, %zu bytes\n", name, reference.VertexCount(),
+			reference.TriangleCount(), text.str().size());
+
+		// The reference gets the text already in memory, ModelLoader maps the file itself.
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]() { TextModel::Parse(text.str(), reference); });
+		Benchmark::Report("  istream", ms, reference.VertexCount());
+
+		std::vector<Vertex> vertices(reference.VertexCount());
+		std::vector<std::uint32_t> indices(reference.Indices.size());
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]()
+			{
+				ModelLoader loader;
+				loader.Open(path.wstring());
+				loader.ParseVertices(vertices.data());
+				loader.ParseIndices(indices.data(), sizeof(std::uint32_t));
+			});
+		Benchmark::Report("  ModelLoader", ms, reference.VertexCount());
+	}
+}
+
+// Parses the models in Content/Models with a plain istream parser and with ModelLoader, on
+// one thread and on the job system.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const int repeatCount = quick ? 1 : 10;
+	const char* name = quick ? "car.txt" : "skull.txt";
+
+	Run(name, repeatCount);
+
+	std::unique_ptr<JobSystem> jobSystem = std::make_unique<JobSystem>();
+	std::printf("With %u threads\n", jobSystem->ThreadCount());
+	Run(name, repeatCount);
+
+	return 0;
+}
@@ -0,0 +1,236 @@
+#include "Engine.h"
+#include "Graphics/ModelLoader.h"
+#include "Graphics/Vertex.h"
+#include "Test.h"
+#include "TempDirectory.h"
+#include "TextModel.h"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+
+namespace
+{
+	struct Parsed
+	{
+		bool Opened = false;
+		bool VerticesParsed = false;
+		bool IndicesParsed = false;
+		std::vector<Vertex> Vertices;
+		std::vector<std::uint32_t> Indices32;
+		std::vector<std::uint16_t> Indices16;
+	};
+
+	Parsed Load(const std::wstring& path)
+	{
+		Parsed parsed;
+		ModelLoader loader;
+		parsed.Opened = loader.Open(path);
+		if (!parsed.Opened)
+			return parsed;
+
+		// Filled with a pattern, so untouched entries show up.
+		parsed.Vertices.assign(loader.VertexCount(), Vertex(-7, -7, -7, -7, -7, -7, -7, -7));
+		parsed.Indices32.assign(3 * (size_t)loader.TriangleCount(), 0xDEADBEEF);
+		parsed.Indices16.assign(3 * (size_t)loader.TriangleCount(), 0xBEEF);
+		parsed.VerticesParsed = loader.ParseVertices(parsed.Vertices.data());
+		parsed.IndicesParsed = loader.ParseIndices(parsed.Indices32.data(), sizeof(std::uint32_t)) &&
+			loader.ParseIndices(parsed.Indices16.data(), sizeof(std::uint16_t));
+		return parsed;
+	}
+
+	bool Parses(const TempDirectory& directory, const std::string& text)
+	{
+		Parsed parsed = Load(directory.Write("model.txt", text));
+		return parsed.Opened && parsed.VerticesParsed && parsed.IndicesParsed;
+	}
+
+	void CheckMatches(const Parsed& parsed, const TextModel& reference)
+	{
+		REQUIRE(parsed.Opened && parsed.VerticesParsed && parsed.IndicesParsed);
+		REQUIRE_EQ(parsed.Vertices.size(), (size_t)reference.VertexCount());
+		REQUIRE_EQ(parsed.Indices32.size(), reference.Indices.size());
+
+		size_t mismatches = 0;
+		for (size_t i = 0; i < parsed.Vertices.size(); ++i)
+		{
+			const Vertex& v = parsed.Vertices[i];
+			const float* r = &reference.Vertices[6 * i];
+			mismatches += !(v.Pos.x == r[0] && v.Pos.y == r[1] && v.Pos.z == r[2] &&
+				v.Normal.x == r[3] && v.Normal.y == r[4] && v.Normal.z == r[5] &&
+				v.TexC.x == 0.0f && v.TexC.y == 0.0f);
+		}
+		CHECK_EQ(mismatches, 0u);
+
+		CHECK(parsed.Indices32 == reference.Indices);
+		if (reference.VertexCount() <= 0x10000)
+			CHECK(std::vector<std::uint32_t>(parsed.Indices16.begin(), parsed.Indices16.end()) == reference.Indices);
+	}
+
+	std::string ReadText(const std::filesystem::path& path)
+	{
+		std::ifstream file(path, std::ios::binary);
+		std::ostringstream text;
+		text << file.rdbuf();
+		return text.str();
+	}
+
+	// Four threads whatever the machine, so the sections are split into chunks.
+	std::unique_ptr<JobSystem> MakeJobSystem()
+	{
+		return std::make_unique<JobSystem>(3);
+	}
+}
+
+TEST(ModelLoader, MatchesTheReferenceParser)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(9, 7);
+	std::string text = model.ToText();
+
+	TextModel reference;
+	REQUIRE(TextModel::Parse(text, reference));
+	CHECK(reference.Vertices == model.Vertices);
+	CheckMatches(Load(directory.Write("terrain.txt", text)), reference);
+}
+
+TEST(ModelLoader, MatchesTheReferenceOnTheShippedModels)
+{
+	for (const char* name : { "car.txt", "skull.txt" })
+	{
+		std::filesystem::path path = std::filesystem::path(ENGINE_CONTENT_DIR) / "Models" / name;
+		TextModel reference;
+		REQUIRE(TextModel::Parse(ReadText(path), reference));
+		CheckMatches(Load(path.wstring()), reference);
+
+		std::unique_ptr<JobSystem> jobSystem = MakeJobSystem();
+		CheckMatches(Load(path.wstring()), reference);
+	}
+}
+
+TEST(ModelLoader, ChunkedParseMatchesSerialParse)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(160, 120);
+
+	// Irregular whitespace moves the chunk boundaries around the numbers.
+	std::mt19937 rng(4);
+	std::uniform_int_distribution<int> spaceKind(0, 5);
+	std::string text = model.ToText();
+	std::string shuffled;
+	for (char c : text)
+	{
+		if (c != ' ')
+		{
+			shuffled += c;
+			continue;
+		}
+		static const char* spaces[] = { " ", "  ", "\t", "\r\n", " \t ", "\n\n\n" };
+		shuffled += spaces[spaceKind(rng)];
+	}
+	REQUIRE(shuffled.size() > 8 * 64 * 1024);
+
+	std::wstring path = directory.Write("terrain.txt", shuffled);
+	Parsed serial = Load(path);
+	CheckMatches(serial, model);
+
+	for (UINT workerCount : { 1u, 2u, 3u, 7u })
+	{
+		JobSystem jobSystem(workerCount);
+		Parsed chunked = Load(path);
+		CheckMatches(chunked, model);
+	}
+}
+
+TEST(ModelLoader, ToleratesWhitespaceVariants)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(2, 2);
+
+	std::string text = model.ToText();
+	std::string lineFeeds;
+	for (char c : text)
+	{
+		if (c != '\r')
+			lineFeeds += c;
+	}
+	CheckMatches(Load(directory.Write("lf.txt", lineFeeds)), model);
+
+	std::string oneLine;
+	for (char c : lineFeeds)
+		oneLine += c == '\n' ? ' ' : c;
+	CheckMatches(Load(directory.Write("line.txt", oneLine)), model);
+
+	// Numbers right against the braces, no trailing newline.
+	std::string tight = "VertexCount: 3\nTriangleCount: 1\nVertexList (pos, normal)\n"
+		"{0 0 0 0 1 0\n1 0 0 0 1 0\n0 0 1 0 1 0}\nTriangleList\n{0 2 1}";
+	Parsed parsed = Load(directory.Write("tight.txt", tight));
+	REQUIRE(parsed.Opened && parsed.VerticesParsed && parsed.IndicesParsed);
+	CHECK(parsed.Vertices[1].Pos.x == 1.0f && parsed.Vertices[2].Pos.z == 1.0f && parsed.Vertices[2].Normal.y == 1.0f);
+	CHECK(parsed.Indices32 == std::vector<std::uint32_t>({ 0, 2, 1 }));
+}
+
+TEST(ModelLoader, RejectsMalformedModels)
+{
+	TempDirectory directory;
+	const std::string header = "VertexCount: 3\nTriangleCount: 1\nVertexList (pos, normal)\n";
+	const std::string vertices = "{\n0 0 0 0 1 0\n1 0 0 0 1 0\n0 0 1 0 1 0\n}\n";
+	const std::string triangles = "TriangleList\n{\n0 2 1\n}\n";
+
+	CHECK(Parses(directory, header + vertices + triangles));
+
+	ModelLoader loader;
+	CHECK(!loader.Open(directory.Path("missing.txt")));
+	CHECK(!loader.Open(directory.Write("empty.txt", "")));
+
+	// Layout errors fail in Open.
+	CHECK(!loader.Open(directory.Write("label.txt", "VertexCnt: 3\nTriangleCount: 1\n" + vertices + triangles)));
+	CHECK(!loader.Open(directory.Write("count.txt", "VertexCount: x\nTriangleCount: 1\n" + vertices + triangles)));
+	CHECK(!loader.Open(directory.Write("order.txt", "TriangleCount: 1\nVertexCount: 3\n" + vertices + triangles)));
+	CHECK(!loader.Open(directory.Write("noblock.txt", header + vertices)));
+	CHECK(!loader.Open(directory.Write("unclosed.txt", header + vertices + "TriangleList\n{\n0 2 1\n")));
+
+	// Content errors fail in the parse.
+	CHECK(!Parses(directory, header + "{\n0 0 0 0 1 0\n1 0 0 0 1 0\n0 0 1 0 1\n}\n" + triangles));
+	CHECK(!Parses(directory, header + "{\n0 0 0 0 1 0\n1 0 0 0 1 0\n0 0 1 0 1 0 5\n}\n" + triangles));
+	CHECK(!Parses(directory, header + "{\n0 0 0 0 1 0\n1 0 x 0 1 0\n0 0 1 0 1 0\n}\n" + triangles));
+	CHECK(!Parses(directory, header + "{\n0 0 0 0 1 0\n1 0 0.5f 0 1 0\n0 0 1 0 1 0\n}\n" + triangles));
+	CHECK(!Parses(directory, header + vertices + "TriangleList\n{\n0 2\n}\n"));
+	CHECK(!Parses(directory, header + vertices + "TriangleList\n{\n0 2 3\n}\n"));
+	CHECK(!Parses(directory, header + vertices + "TriangleList\n{\n0 2 -1\n}\n"));
+	CHECK(!Parses(directory, header + vertices + "TriangleList\n{\n0 2 1.0\n}\n"));
+}
+
+TEST(ModelLoader, ChunkedParseRejectsErrorsInAnyChunk)
+{
+	TempDirectory directory;
+	TextModel model = TextModel::Terrain(120, 100);
+	std::unique_ptr<JobSystem> jobSystem = MakeJobSystem();
+
+	// One broken number near the start, the middle and the end of each list.
+	for (double where : { 0.02, 0.5, 0.98 })
+	{
+		TextModel broken = model;
+		broken.Indices[(size_t)(where * (broken.Indices.size() - 1))] = broken.VertexCount();
+		Parsed parsed = Load(directory.Write("index.txt", broken.ToText()));
+		CHECK(parsed.Opened && parsed.VerticesParsed && !parsed.IndicesParsed);
+
+		std::string text = model.ToText();
+		size_t listBegin = text.find('{');
+		size_t listEnd = text.find('}');
+		size_t at = text.find(' ', listBegin + (size_t)(where * (listEnd - listBegin)));
+		REQUIRE(at < listEnd);
+		text = text.substr(0, at + 1) + "#" + text.substr(at + 1);
+		parsed = Load(directory.Write("vertex.txt", text));
+		CHECK(parsed.Opened && !parsed.VerticesParsed && parsed.IndicesParsed);
+	}
+
+	// A missing number anywhere changes the count every chunk is offset by.
+	std::string text = model.ToText();
+	size_t last = text.rfind('}');
+	size_t number = text.rfind('\t', last);
+	text.erase(number, text.find(' ', number) - number);
+	CHECK(!Parses(directory, text));
+}
@@ -0,0 +1,425 @@
+#include "Engine.h"
+#include "Graphics/FrustumCuller.h"
+#include "Graphics/RenderItemStore.h"
+#include "Benchmark.h"
+#include "FakeObjects.h"
+
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	// Layers of the mirror demo, bit i of an item's layer mask is layer i.
+	enum Layer
+	{
+		Opaque,
+		Reflected,
+		Shadow,
+		ShadowReflected,
+		LayerCount
+	};
+
+	// Every shape is followed by its reflection, its shadow and the reflection of its
+	// shadow, as the mirror demo creates them.
+	const UINT ItemsPerShape = 4;
+	const UINT MaterialCount = 16;
+	const UINT GeometryCount = 8;
+
+	// Same layout as InstanceData in FrameResource.h.
+	struct InstanceData
+	{
+		XMFLOAT4X4 World;
+		XMFLOAT4X4 TexTransform;
+		UINT MaterialIndex;
+		UINT InstancePad0;
+		UINT InstancePad1;
+		UINT InstancePad2;
+	};
+
+	// The render item before RenderItemStore: allocated one by one, the fields of every
+	// pass side by side, and the shadow and reflection sources referenced by pointer.
+	struct LegacyRenderItem
+	{
+		XMFLOAT4X4 World = MathHelper::Identity4x4();
+
+		XMFLOAT3 WorldScaling = { 1.0f, 1.0f, 1.0f };
+		XMFLOAT3 WorldRotation = { 0.0f, 0.0f, 0.0f };
+		XMFLOAT3 WorldTranslation = { 0.0f, 0.0f, 0.0f };
+
+		XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+
+		BoundingVolumes Bounds;
+		bool FrustumTest = true;
+
+		UINT LayerMask = 0;
+
+		bool IsVisible = true;
+
+		bool DoPicking = false;
+		bool IsPicked = false;
+
+		UINT DirtyFrameMask = 0;
+
+		UINT ItemIndex = 0;
+
+		UINT ObjConstantBufferIndex = -1;
+
+		Material* Mat = nullptr;
+		MeshGeometry* Geo = nullptr;
+
+		D3D12_PRIMITIVE_TOPOLOGY PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+
+		UINT IndexCount = 0;
+		UINT StartIndexLocation = 0;
+		int BaseVertexLocation = 0;
+
+		std::string GeoName;
+		std::string GeoShapeName;
+
+		LegacyRenderItem* ShadowSource = nullptr;
+		UINT ShadowIndex = 0;
+		LegacyRenderItem* ReflectionSource = nullptr;
+
+		UINT TransformNode = 0;
+	};
+
+	// Shadow projection onto the floor for a light that turns a little every frame.
+	XMMATRIX ShadowTransform(UINT frame)
+	{
+		float angle = 0.01f * (float)frame;
+		XMVECTOR toLight = XMVectorSet(std::cos(angle), 2.0f, std::sin(angle), 0.0f);
+		return XMMatrixShadow(XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f), toLight) * XMMatrixTranslation(0.0f, 0.001f, 0.0f);
+	}
+
+	// Mirror in the x = 0 plane, so reflections stay in front of the camera.
+	XMMATRIX ReflectionTransform()
+	{
+		return XMMatrixReflect(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f));
+	}
+
+	// Shapes scattered in front of a camera at the origin, described once for both layouts.
+	std::vector<RenderItemDesc> MakeScene(UINT shapeCount, std::vector<Material>& materials)
+	{
+		std::mt19937 rng(8);
+		std::uniform_real_distribution<float> lateral(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> height(1.0f, 50.0f);
+		std::uniform_real_distribution<float> depth(1.0f, 1000.0f);
+		std::uniform_real_distribution<float> angle(-XM_PI, XM_PI);
+		std::uniform_int_distribution<UINT> material(0, MaterialCount - 1);
+		std::uniform_int_distribution<UINT> geometry(0, GeometryCount - 1);
+
+		materials.resize(MaterialCount);
+		for (UINT i = 0; i < MaterialCount; ++i)
+			materials[i].MatCBIndex = (int)i;
+
+		BoundingVolumes bounds;
+		bounds.Box = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(1.0f, 2.0f, 0.5f));
+		bounds.Sphere = BoundingSphere(bounds.Box.Center, 2.3f);
+		bounds.OrientedBox = BoundingOrientedBox(bounds.Box.Center, bounds.Box.Extents, XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f));
+
+		std::vector<RenderItemDesc> descs;
+		for (UINT s = 0; s < shapeCount; ++s)
+		{
+			RenderItemDesc shape;
+			shape.WorldRotation = { 0.0f, angle(rng), 0.0f };
+			shape.WorldTranslation = { lateral(rng), height(rng), depth(rng) };
+			shape.Bounds = bounds;
+			shape.Mat = &materials[material(rng)];
+			shape.Geo = FakeObject<MeshGeometry>(geometry(rng));
+			shape.IndexCount = 36;
+			shape.GeoName = "shape" + std::to_string(s);
+			shape.GeoShapeName = shape.GeoName;
+
+			// The sources are set by the layouts, which know their own references.
+			RenderItemDesc reflection = shape;
+			reflection.GeoShapeName = "reflected" + shape.GeoName;
+			RenderItemDesc shadow = shape;
+			shadow.GeoShapeName = "shadow" + shape.GeoName;
+			RenderItemDesc reflectedShadow = shape;
+			reflectedShadow.GeoShapeName = "reflectedShadow" + shape.GeoName;
+			reflectedShadow.FrustumTest = false;
+
+			for (RenderItemDesc* desc : { &shape, &reflection, &shadow, &reflectedShadow })
+			{
+				desc->ObjConstantBufferIndex = (UINT)descs.size();
+				descs.push_back(*desc);
+			}
+		}
+		return descs;
+	}
+
+	XMFLOAT4X4 LocalWorld(const RenderItemDesc& desc)
+	{
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixScaling(desc.WorldScaling.x, desc.WorldScaling.y, desc.WorldScaling.z) *
+			XMMatrixRotationRollPitchYaw(desc.WorldRotation.x, desc.WorldRotation.y, desc.WorldRotation.z) *
+			XMMatrixTranslation(desc.WorldTranslation.x, desc.WorldTranslation.y, desc.WorldTranslation.z));
+		return world;
+	}
+
+	InstanceData MakeInstanceData(const XMFLOAT4X4& world, const XMFLOAT4X4& texTransform, const Material* mat)
+	{
+		InstanceData instanceData;
+		XMStoreFloat4x4(&instanceData.World, XMMatrixTranspose(XMLoadFloat4x4(&world)));
+		XMStoreFloat4x4(&instanceData.TexTransform, XMMatrixTranspose(XMLoadFloat4x4(&texTransform)));
+		instanceData.MaterialIndex = mat->MatCBIndex;
+		instanceData.InstancePad0 = 0;
+		instanceData.InstancePad1 = 0;
+		instanceData.InstancePad2 = 0;
+		return instanceData;
+	}
+
+	// The per-frame loops of GraphicsClass before the store, over one pointer per item.
+	struct LegacyScene
+	{
+		std::vector<std::unique_ptr<LegacyRenderItem>> AllRenderItems;
+		std::vector<LegacyRenderItem*> RenderItemLayer[LayerCount];
+		std::vector<LegacyRenderItem*> VisibleRenderItemLayer[LayerCount];
+		std::vector<LegacyRenderItem*> DirtyRenderItems;
+		FrustumCuller Culler;
+
+		void Build(const std::vector<RenderItemDesc>& descs)
+		{
+			for (UINT i = 0; i < (UINT)descs.size(); ++i)
+			{
+				const RenderItemDesc& desc = descs[i];
+				auto ri = std::make_unique<LegacyRenderItem>();
+				ri->World = LocalWorld(desc);
+				ri->WorldScaling = desc.WorldScaling;
+				ri->WorldRotation = desc.WorldRotation;
+				ri->WorldTranslation = desc.WorldTranslation;
+				ri->TexTransform = desc.TexTransform;
+				ri->Bounds = desc.Bounds;
+				ri->FrustumTest = desc.FrustumTest;
+				ri->ItemIndex = i;
+				ri->ObjConstantBufferIndex = desc.ObjConstantBufferIndex;
+				ri->Mat = desc.Mat;
+				ri->Geo = desc.Geo;
+				ri->IndexCount = desc.IndexCount;
+				ri->GeoName = desc.GeoName;
+				ri->GeoShapeName = desc.GeoShapeName;
+
+				LegacyRenderItem* shape = i % ItemsPerShape == 0 ? ri.get() : AllRenderItems[i - i % ItemsPerShape].get();
+				Layer layer = (Layer)(i % ItemsPerShape);
+				if (layer == Reflected)
+					ri->ReflectionSource = shape;
+				else if (layer == Shadow)
+					ri->ShadowSource = shape;
+				else if (layer == ShadowReflected)
+					ri->ReflectionSource = AllRenderItems[i - 1].get();
+				ri->LayerMask = 1u << layer;
+
+				RenderItemLayer[layer].push_back(ri.get());
+				DirtyRenderItems.push_back(ri.get());
+				AllRenderItems.push_back(std::move(ri));
+			}
+			Culler.Resize((UINT)AllRenderItems.size());
+		}
+
+		void UpdateTransforms(UINT frame)
+		{
+			XMMATRIX S = ShadowTransform(frame);
+			XMMATRIX R = ReflectionTransform();
+			for (Layer layer : { Shadow, Reflected, ShadowReflected })
+			{
+				for (LegacyRenderItem* ri : RenderItemLayer[layer])
+				{
+					const LegacyRenderItem* source = ri->ShadowSource != nullptr ? ri->ShadowSource : ri->ReflectionSource;
+					XMStoreFloat4x4(&ri->World, XMLoadFloat4x4(&source->World) * (layer == Shadow ? S : R));
+				}
+			}
+		}
+
+		void Cull(const BoundingFrustum& frustum)
+		{
+			for (LegacyRenderItem* ri : DirtyRenderItems)
+			{
+				Culler.UpdateBounds(ri->ItemIndex, ri->Bounds, ri->World);
+				Culler.SetAlwaysVisible(ri->ItemIndex, ri->FrustumTest == false);
+			}
+			Culler.Cull(frustum);
+
+			for (auto& layer : VisibleRenderItemLayer)
+				layer.clear();
+			for (UINT i : Culler.VisibleIndices())
+			{
+				LegacyRenderItem* ri = AllRenderItems[i].get();
+				for (int layer = 0; layer < LayerCount; ++layer)
+				{
+					if (ri->LayerMask & (1u << layer))
+						VisibleRenderItemLayer[layer].push_back(ri);
+				}
+			}
+		}
+
+		void UpdateInstances(std::vector<InstanceData>& instanceBuffer, UINT frameBit)
+		{
+			for (LegacyRenderItem* ri : DirtyRenderItems)
+			{
+				instanceBuffer[ri->ObjConstantBufferIndex] = MakeInstanceData(ri->World, ri->TexTransform, ri->Mat);
+				ri->DirtyFrameMask &= ~frameBit;
+			}
+		}
+	};
+
+	// The same loops as GraphicsClass runs them on the store.  The sources of shadows and
+	// reflections are links of the transform hierarchy there, kept here as handle pairs.
+	struct StoreScene
+	{
+		struct Projection
+		{
+			RenderItemHandle Item;
+			RenderItemHandle Source;
+		};
+
+		RenderItemStore Items;
+		std::vector<Projection> Projections[LayerCount];
+		std::vector<RenderItemHandle> VisibleRenderItemLayer[LayerCount];
+		std::vector<RenderItemHandle> DirtyRenderItems;
+		FrustumCuller Culler;
+
+		void Build(const std::vector<RenderItemDesc>& descs)
+		{
+			for (UINT i = 0; i < (UINT)descs.size(); ++i)
+			{
+				Layer layer = (Layer)(i % ItemsPerShape);
+				RenderItemDesc desc = descs[i];
+				RenderItemHandle shape = layer == Opaque ? RenderItemHandle() : DirtyRenderItems[i - i % ItemsPerShape];
+				if (layer == Reflected)
+					desc.ReflectionSource = shape;
+				else if (layer == Shadow)
+					desc.ShadowSource = shape;
+				else if (layer == ShadowReflected)
+					desc.ReflectionSource = DirtyRenderItems[i - 1];
+
+				RenderItemHandle ri = Items.Create(desc);
+				Items.Transform(ri).World = LocalWorld(desc);
+				Items.Flags(ri).LayerMask = 1u << layer;
+
+				if (layer != Opaque)
+				{
+					const RenderItemInfo& info = Items.Info(ri);
+					Projections[layer].push_back({ ri, Items.IsValid(info.ShadowSource) ? info.ShadowSource : info.ReflectionSource });
+				}
+				DirtyRenderItems.push_back(ri);
+			}
+			Culler.Resize(Items.Count());
+		}
+
+		void UpdateTransforms(UINT frame)
+		{
+			XMMATRIX S = ShadowTransform(frame);
+			XMMATRIX R = ReflectionTransform();
+			for (Layer layer : { Shadow, Reflected, ShadowReflected })
+			{
+				for (const Projection& projection : Projections[layer])
+				{
+					XMMATRIX source = XMLoadFloat4x4(&Items.Transform(projection.Source).World);
+					XMStoreFloat4x4(&Items.Transform(projection.Item).World, source * (layer == Shadow ? S : R));
+				}
+			}
+		}
+
+		void Cull(const BoundingFrustum& frustum)
+		{
+			for (RenderItemHandle ri : DirtyRenderItems)
+			{
+				UINT index = Items.IndexOf(ri);
+				Culler.UpdateBounds(index, Items.Bounds(ri), Items.Transform(ri).World);
+				Culler.SetAlwaysVisible(index, Items.Flags(ri).FrustumTest == false);
+			}
+			Culler.Cull(frustum);
+
+			for (auto& layer : VisibleRenderItemLayer)
+				layer.clear();
+			const std::vector<RenderItemFlags>& flags = Items.FlagsArray();
+			for (UINT i : Culler.VisibleIndices())
+			{
+				for (int layer = 0; layer < LayerCount; ++layer)
+				{
+					if (flags[i].LayerMask & (1u << layer))
+						VisibleRenderItemLayer[layer].push_back(Items.HandleAt(i));
+				}
+			}
+		}
+
+		void UpdateInstances(std::vector<InstanceData>& instanceBuffer, UINT frameBit)
+		{
+			for (RenderItemHandle ri : DirtyRenderItems)
+			{
+				const RenderItemTransform& transform = Items.Transform(ri);
+				instanceBuffer[transform.ObjConstantBufferIndex] = MakeInstanceData(transform.World, transform.TexTransform, Items.Mat(ri));
+				Items.Flags(ri).DirtyFrameMask &= ~frameBit;
+			}
+		}
+	};
+
+	// Times the three per-frame loops, every item having moved since the last frame.
+	template<typename Scene>
+	void RunFrames(const char* name, Scene& scene, int repeatCount, const BoundingFrustum& frustum,
+		std::vector<InstanceData>& instanceBuffer)
+	{
+		UINT itemCount = (UINT)scene.DirtyRenderItems.size();
+		UINT frame = 0;
+		std::printf("%s\n", name);
+
+		double ms = Benchmark::BestMilliseconds(repeatCount, [&]() { scene.UpdateTransforms(frame++); });
+		Benchmark::Report("  shadow and reflection transforms", ms, (double)(itemCount - itemCount / ItemsPerShape));
+
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]() { scene.Cull(frustum); });
+		Benchmark::Report("  culling and layer sort", ms, itemCount);
+
+		ms = Benchmark::BestMilliseconds(repeatCount, [&]() { scene.UpdateInstances(instanceBuffer, 1u); });
+		Benchmark::Report("  instance buffer update", ms, itemCount);
+	}
+}
+
+// Runs the culling, shadow and reflection transform and instance buffer loops over the
+// mirror demo's items scaled up, once on one heap allocated item per pointer as before
+// RenderItemStore, and once on the store, and checks both give the same frame.
+int main(int argc, char** argv)
+{
+	const bool quick = Benchmark::IsQuick(argc, argv);
+	const UINT itemCount = quick ? 8000 : 100000;
+	const int repeatCount = quick ? 1 : 20;
+
+	std::vector<Material> materials;
+	std::vector<RenderItemDesc> descs = MakeScene(itemCount / ItemsPerShape, materials);
+	std::printf("%zu items\n", descs.size());
+
+	BoundingFrustum frustum(XMMatrixPerspectiveFovLH(0.25f * XM_PI, 16.0f / 9.0f, 1.0f, 1000.0f));
+
+	LegacyScene legacy;
+	legacy.Build(descs);
+	std::vector<InstanceData> legacyInstances(descs.size());
+	RunFrames("unique_ptr per item", legacy, repeatCount, frustum, legacyInstances);
+
+	StoreScene store;
+	store.Build(descs);
+	std::vector<InstanceData> storeInstances(descs.size());
+	RunFrames("RenderItemStore", store, repeatCount, frustum, storeInstances);
+
+	for (int layer = 0; layer < LayerCount; ++layer)
+	{
+		if (legacy.VisibleRenderItemLayer[layer].size() != store.VisibleRenderItemLayer[layer].size())
+		{
+			std::printf("layer %d: %zu visible items before, %zu with the store\n", layer,
+				legacy.VisibleRenderItemLayer[layer].size(), store.VisibleRenderItemLayer[layer].size());
+			return 1;
+		}
+	}
+	if (std::memcmp(legacyInstances.data(), storeInstances.data(), descs.size() * sizeof(InstanceData)) != 0)
+	{
+		std::printf("the instance buffers differ\n");
+		return 1;
+	}
+	std::printf("%zu opaque, %zu reflected and %zu shadow items visible in both\n",
+		store.VisibleRenderItemLayer[Opaque].size(), store.VisibleRenderItemLayer[Reflected].size(),
+		store.VisibleRenderItemLayer[Shadow].size());
+
+	return 0;
+}
@@ -0,0 +1,238 @@
+#include "Engine.h"
+#include "Graphics/RenderItemStore.h"
+#include "FakeObjects.h"
+#include "Test.h"
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <set>
+
+namespace
+{
+	const UINT GeometryCount = 4;
+	const UINT DrawsPerGeometry = 6;
+
+	// Several geometries with a few draws each, the shapes items are made of, and the
+	// materials they share.  The store only compares geometries by address.
+	struct Scene
+	{
+		Material Materials[3];
+	};
+
+	RenderItemDesc MakeDesc(Scene& scene, UINT geometry, UINT draw, UINT payload)
+	{
+		RenderItemDesc desc;
+		desc.Geo = FakeObject<MeshGeometry>(geometry);
+		desc.Mat = &scene.Materials[payload % 3];
+		desc.IndexCount = 36 * (draw + 1);
+		desc.StartIndexLocation = 1000 * draw;
+		desc.BaseVertexLocation = 100 * (int)draw;
+		desc.ObjConstantBufferIndex = payload;
+		desc.GeoName = "item" + std::to_string(payload);
+		desc.WorldTranslation = { (float)payload, 0.0f, 0.0f };
+		return desc;
+	}
+
+	// Every live item of the store agrees with the expected payloads, handles and dense
+	// indices map onto each other, and the draw ids are dense per distinct key.
+	void CheckStore(const RenderItemStore& store, const std::map<std::pair<UINT, UINT>, UINT>& expected)
+	{
+		REQUIRE_EQ(store.Count(), (UINT)expected.size());
+
+		UINT wrong = 0;
+		for (const auto& [key, payload] : expected)
+		{
+			RenderItemHandle handle = { key.first, key.second };
+			if (!store.IsValid(handle) || !(store.HandleAt(store.IndexOf(handle)) == handle) ||
+				store.Transform(handle).ObjConstantBufferIndex != payload ||
+				store.Info(handle).GeoName != "item" + std::to_string(payload) ||
+				store.Info(handle).WorldTranslation.x != (float)payload)
+			{
+				++wrong;
+			}
+		}
+		CHECK_EQ(wrong, 0u);
+
+		std::map<const MeshGeometry*, UINT> geometryIds;
+		std::map<std::tuple<const MeshGeometry*, UINT, UINT, int>, UINT> drawIds;
+		std::set<UINT> usedGeometryIds, usedDrawIds;
+		UINT inconsistent = 0;
+		for (UINT i = 0; i < store.Count(); ++i)
+		{
+			const RenderItemDrawArgs& args = store.DrawArgs(store.HandleAt(i));
+			auto geometry = geometryIds.try_emplace(args.Geo, args.GeometryId);
+			auto draw = drawIds.try_emplace({ args.Geo, args.IndexCount, args.StartIndexLocation, args.BaseVertexLocation }, args.DrawId);
+			inconsistent += geometry.first->second != args.GeometryId || draw.first->second != args.DrawId;
+			// A new key must not reuse an id that is still in use.
+			inconsistent += geometry.second && !usedGeometryIds.insert(args.GeometryId).second;
+			inconsistent += draw.second && !usedDrawIds.insert(args.DrawId).second;
+		}
+		CHECK_EQ(inconsistent, 0u);
+
+		// Ids are recycled, so they stay below the number of keys that can exist at once.
+		if (!usedGeometryIds.empty())
+			CHECK_LT(*usedGeometryIds.rbegin(), GeometryCount);
+		if (!usedDrawIds.empty())
+			CHECK_LT(*usedDrawIds.rbegin(), GeometryCount * DrawsPerGeometry);
+	}
+}
+
+TEST(RenderItemStore, HandlesSurviveSwapRemove)
+{
+	Scene scene;
+	RenderItemStore store;
+
+	RenderItemHandle a = store.Create(MakeDesc(scene, 0, 0, 10));
+	RenderItemHandle b = store.Create(MakeDesc(scene, 0, 1, 11));
+	RenderItemHandle c = store.Create(MakeDesc(scene, 1, 0, 12));
+	CHECK_EQ(store.Count(), 3u);
+	CHECK_EQ(store.IndexOf(c), 2u);
+
+	// c moves into a's place and keeps its data.
+	store.Destroy(a);
+	CHECK(!store.IsValid(a));
+	CHECK(store.IsValid(b) && store.IsValid(c));
+	CHECK_EQ(store.Count(), 2u);
+	CHECK_EQ(store.IndexOf(c), 0u);
+	CHECK(store.HandleAt(0) == c);
+	CHECK_EQ(store.Transform(c).ObjConstantBufferIndex, 12u);
+	CHECK(store.Mat(c) == &scene.Materials[0]);
+	CHECK(store.DrawArgs(c).Geo == FakeObject<MeshGeometry>(1));
+	CHECK_EQ(store.FlagsArray().size(), 2u);
+
+	// The slot is reused with a new generation, the old handle stays invalid.
+	RenderItemHandle d = store.Create(MakeDesc(scene, 2, 0, 13));
+	CHECK_EQ(d.Slot, a.Slot);
+	CHECK(!(d == a));
+	CHECK(!store.IsValid(a));
+	CHECK(store.IsValid(d));
+
+	// Destroying a stale handle does nothing.
+	store.Destroy(a);
+	CHECK_EQ(store.Count(), 3u);
+
+	CHECK(!store.IsValid(RenderItemHandle()));
+}
+
+TEST(RenderItemStore, ClearInvalidatesEveryHandle)
+{
+	Scene scene;
+	RenderItemStore store;
+	std::vector<RenderItemHandle> handles;
+	for (UINT i = 0; i < 10; ++i)
+		handles.push_back(store.Create(MakeDesc(scene, i % 4, i % 3, i)));
+
+	store.Clear();
+	CHECK_EQ(store.Count(), 0u);
+	for (RenderItemHandle handle : handles)
+		CHECK(!store.IsValid(handle));
+
+	RenderItemHandle fresh = store.Create(MakeDesc(scene, 3, 2, 99));
+	CHECK(store.IsValid(fresh));
+	CHECK_EQ(store.DrawArgs(fresh).GeometryId, 0u);
+	CHECK_EQ(store.DrawArgs(fresh).DrawId, 0u);
+	for (RenderItemHandle handle : handles)
+		CHECK(!store.IsValid(handle));
+}
+
+TEST(RenderItemStore, DrawIdsAreSharedAndRecycled)
+{
+	Scene scene;
+	RenderItemStore store;
+
+	RenderItemHandle a = store.Create(MakeDesc(scene, 0, 0, 0));
+	RenderItemHandle b = store.Create(MakeDesc(scene, 0, 0, 1));
+	RenderItemHandle c = store.Create(MakeDesc(scene, 0, 1, 2));
+	RenderItemHandle d = store.Create(MakeDesc(scene, 1, 0, 3));
+
+	CHECK_EQ(store.DrawArgs(a).GeometryId, store.DrawArgs(b).GeometryId);
+	CHECK_EQ(store.DrawArgs(a).DrawId, store.DrawArgs(b).DrawId);
+	CHECK_EQ(store.DrawArgs(a).GeometryId, store.DrawArgs(c).GeometryId);
+	CHECK(store.DrawArgs(a).DrawId != store.DrawArgs(c).DrawId);
+	CHECK(store.DrawArgs(a).GeometryId != store.DrawArgs(d).GeometryId);
+
+	// The topology is part of the draw.
+	RenderItemDesc lines = MakeDesc(scene, 0, 0, 4);
+	lines.PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_LINELIST;
+	RenderItemHandle e = store.Create(lines);
+	CHECK_EQ(store.DrawArgs(e).GeometryId, store.DrawArgs(a).GeometryId);
+	CHECK(store.DrawArgs(e).DrawId != store.DrawArgs(a).DrawId);
+
+	// The ids of d are free once d is gone, and the next new keys take them.
+	UINT geometryId = store.DrawArgs(d).GeometryId;
+	UINT drawId = store.DrawArgs(d).DrawId;
+	store.Destroy(d);
+	RenderItemHandle f = store.Create(MakeDesc(scene, 2, 3, 5));
+	CHECK_EQ(store.DrawArgs(f).GeometryId, geometryId);
+	CHECK_EQ(store.DrawArgs(f).DrawId, drawId);
+
+	// Setting the same draw arguments keeps the ids.
+	RenderItemDrawArgs args = store.DrawArgs(c);
+	store.SetDrawArgs(c, args);
+	CHECK_EQ(store.DrawArgs(c).DrawId, args.DrawId);
+	CHECK_EQ(store.DrawArgs(c).GeometryId, args.GeometryId);
+
+	// Moving c onto a's draw frees c's old draw id.
+	UINT oldDrawId = args.DrawId;
+	args = store.DrawArgs(a);
+	store.SetDrawArgs(c, args);
+	CHECK_EQ(store.DrawArgs(c).DrawId, store.DrawArgs(a).DrawId);
+	RenderItemHandle g = store.Create(MakeDesc(scene, 3, 3, 6));
+	CHECK_EQ(store.DrawArgs(g).DrawId, oldDrawId);
+}
+
+TEST(RenderItemStore, RandomChurnMatchesReference)
+{
+	Scene scene;
+	RenderItemStore store;
+	std::map<std::pair<UINT, UINT>, UINT> expected;
+	std::vector<RenderItemHandle> destroyed;
+
+	std::mt19937 rng(8);
+	std::uniform_int_distribution<int> action(0, 9);
+	std::uniform_int_distribution<UINT> geometry(0, GeometryCount - 1);
+	std::uniform_int_distribution<UINT> draw(0, DrawsPerGeometry - 1);
+
+	UINT payload = 0;
+	for (int step = 0; step < 5000; ++step)
+	{
+		int a = action(rng);
+		if (a < 5 || expected.empty())
+		{
+			RenderItemHandle handle = store.Create(MakeDesc(scene, geometry(rng), draw(rng), payload));
+			CHECK(expected.emplace(std::make_pair(handle.Slot, handle.Generation), payload).second);
+			++payload;
+		}
+		else if (a < 9)
+		{
+			auto it = std::next(expected.begin(), std::uniform_int_distribution<size_t>(0, expected.size() - 1)(rng));
+			RenderItemHandle handle = { it->first.first, it->first.second };
+			store.Destroy(handle);
+			destroyed.push_back(handle);
+			expected.erase(it);
+		}
+		else
+		{
+			// Moves a random item to another draw.
+			auto it = std::next(expected.begin(), std::uniform_int_distribution<size_t>(0, expected.size() - 1)(rng));
+			RenderItemHandle handle = { it->first.first, it->first.second };
+			RenderItemDesc desc = MakeDesc(scene, geometry(rng), draw(rng), it->second);
+			RenderItemDrawArgs args;
+			args.Geo = desc.Geo;
+			args.IndexCount = desc.IndexCount;
+			args.StartIndexLocation = desc.StartIndexLocation;
+			args.BaseVertexLocation = desc.BaseVertexLocation;
+			store.SetDrawArgs(handle, args);
+		}
+
+		if (step % 250 == 0)
+			CheckStore(store, expected);
+	}
+	CheckStore(store, expected);
+
+	UINT stillValid = 0;
+	for (RenderItemHandle handle : destroyed)
+		stillValid += store.IsValid(handle);
+	CHECK_EQ(stillValid, 0u);
+}
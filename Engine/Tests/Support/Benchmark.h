@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+// Helpers shared by the benchmark executables.
+class Benchmark
+{
+public:
+	// ctest starts the benchmarks with --quick, which asks for small inputs.
+	static bool IsQuick(int argc, char** argv)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			if (std::strcmp(argv[i], "--quick") == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// Runs func repeatCount times and returns the fastest run in milliseconds.
+	template<typename Func>
+	static double BestMilliseconds(int repeatCount, Func&& func)
+	{
+		double best = 1e30;
+		for (int i = 0; i < repeatCount; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			func();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+			best = elapsed.count() < best ? elapsed.count() : best;
+		}
+		return best;
+	}
+
+	static void Report(const char* name, double milliseconds, double itemCount)
+	{
+		std::printf("%-40s %10.3f ms %10.2f ns/item\n", name, milliseconds, milliseconds * 1e6 / itemCount);
+	}
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+// Stands in for the engine's precompiled header when engine sources are compiled into
+// the tests.  Only the window, Direct3D and ImGui layers are left out, so the engine
+// code sees the same types and the same job system.
+#ifdef WIN32
+	#include <Windows.h>
+#else
+	#include <cstdint>
+
+	typedef std::uint8_t BYTE;
+	typedef std::int32_t INT;
+	typedef std::uint32_t UINT;
+	typedef std::uint64_t UINT64;
+
+	// The HRESULT codes the DDS loader reports.
+	typedef std::int32_t HRESULT;
+	#define S_OK ((HRESULT)0)
+	#define E_FAIL ((HRESULT)0x80004005)
+	#define E_POINTER ((HRESULT)0x80004003)
+	#define E_INVALIDARG ((HRESULT)0x80070057)
+	#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+	#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+	#define FAILED(hr) (((HRESULT)(hr)) < 0)
+	#define HRESULT_FROM_WIN32(x) ((HRESULT)(x) <= 0 ? (HRESULT)(x) : (HRESULT)(((x) & 0x0000FFFF) | 0x80070000))
+	#define ERROR_FILE_NOT_FOUND 2
+	#define ERROR_INVALID_DATA 13
+	#define ERROR_HANDLE_EOF 38
+	#define ERROR_NOT_SUPPORTED 50
+#endif // WIN32
+
+#include <cassert>
+#include <string>
+
+// The tests link the engine sources statically.
+#define ENGINE_API
+
+#include "Common/JobSystem.h"
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cassert>
+
+// Stands in for objects that the code under test only compares by address, such as
+// geometries and pipeline states, whose types are incomplete without Direct3D.  Every
+// index gives a distinct address of its type.
+template<typename T>
+T* FakeObject(unsigned index)
+{
+	static char storage[1024];
+	assert(index < sizeof(storage));
+	return reinterpret_cast<T*>(&storage[index]);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// Distance from points to the surface of a triangle list, to measure how far a simplified
+// mesh strays from the original.  Triangles are binned into a uniform grid by their
+// bounds, and a query only looks at the cells within its search radius.
+class SurfaceDistance
+{
+public:
+	struct Float3
+	{
+		float X, Y, Z;
+	};
+
+	// Positions are the float3 at the start of each vertex.  Cells are about twice as large
+	// as the average edge.
+	SurfaceDistance(const void* vertices, size_t vertexStride, const std::uint32_t* indices, size_t indexCount)
+	{
+		double edgeLength = 0.0;
+		for (size_t i = 0; i < indexCount; i += 3)
+		{
+			Float3 a = Position(vertices, vertexStride, indices[i + 0]);
+			Float3 b = Position(vertices, vertexStride, indices[i + 1]);
+			Float3 c = Position(vertices, vertexStride, indices[i + 2]);
+			m_Triangles.push_back({ a, b, c });
+			edgeLength += Length(Sub(b, a)) + Length(Sub(c, b)) + Length(Sub(a, c));
+		}
+		if (edgeLength > 0.0)
+			m_CellSize = (float)(2.0 * edgeLength / indexCount);
+
+		for (std::uint32_t t = 0; t < (std::uint32_t)m_Triangles.size(); ++t)
+		{
+			const Triangle& tri = m_Triangles[t];
+			std::int32_t lo[3] = { Cell(std::min({ tri.A.X, tri.B.X, tri.C.X })),
+				Cell(std::min({ tri.A.Y, tri.B.Y, tri.C.Y })), Cell(std::min({ tri.A.Z, tri.B.Z, tri.C.Z })) };
+			std::int32_t hi[3] = { Cell(std::max({ tri.A.X, tri.B.X, tri.C.X })),
+				Cell(std::max({ tri.A.Y, tri.B.Y, tri.C.Y })), Cell(std::max({ tri.A.Z, tri.B.Z, tri.C.Z })) };
+			for (std::int32_t x = lo[0]; x <= hi[0]; ++x)
+				for (std::int32_t y = lo[1]; y <= hi[1]; ++y)
+					for (std::int32_t z = lo[2]; z <= hi[2]; ++z)
+						m_Cells[Key(x, y, z)].push_back(t);
+		}
+	}
+
+	// Distance to the closest triangle, or maxDistance if none is closer.  The search box
+	// doubles until it holds a triangle closer than its half size.  Finding a triangle
+	// closer than enough ends the search early, which is all a largest distance needs.
+	float Distance(const Float3& p, float maxDistance, float enough = 0.0f) const
+	{
+		float best = maxDistance;
+		for (float radius = m_CellSize; ; radius *= 2.0f)
+		{
+			radius = std::min(radius, maxDistance);
+			std::int32_t lo[3] = { Cell(p.X - radius), Cell(p.Y - radius), Cell(p.Z - radius) };
+			std::int32_t hi[3] = { Cell(p.X + radius), Cell(p.Y + radius), Cell(p.Z + radius) };
+			for (std::int32_t x = lo[0]; x <= hi[0]; ++x)
+			{
+				for (std::int32_t y = lo[1]; y <= hi[1]; ++y)
+				{
+					for (std::int32_t z = lo[2]; z <= hi[2]; ++z)
+					{
+						auto it = m_Cells.find(Key(x, y, z));
+						if (it == m_Cells.end())
+							continue;
+						for (std::uint32_t t : it->second)
+						{
+							const Triangle& tri = m_Triangles[t];
+							best = std::min(best, PointTriangle(p, tri.A, tri.B, tri.C));
+							if (best <= enough)
+								return best;
+						}
+					}
+				}
+			}
+			if (best <= radius || radius >= maxDistance)
+				return best;
+		}
+	}
+
+	static Float3 Position(const void* vertices, size_t vertexStride, std::uint32_t index)
+	{
+		Float3 p;
+		std::memcpy(&p, static_cast<const std::uint8_t*>(vertices) + index * vertexStride, sizeof(p));
+		return p;
+	}
+
+	// Closest point on the triangle by its Voronoi regions ("Real-Time Collision Detection",
+	// Ericson 2005, 5.1.5).
+	static float PointTriangle(const Float3& p, const Float3& a, const Float3& b, const Float3& c)
+	{
+		Float3 ab = Sub(b, a), ac = Sub(c, a), ap = Sub(p, a);
+		float d1 = Dot(ab, ap), d2 = Dot(ac, ap);
+		if (d1 <= 0.0f && d2 <= 0.0f)
+			return Length(ap);
+
+		Float3 bp = Sub(p, b);
+		float d3 = Dot(ab, bp), d4 = Dot(ac, bp);
+		if (d3 >= 0.0f && d4 <= d3)
+			return Length(bp);
+
+		float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+			return Length(Sub(ap, Scale(ab, d1 / (d1 - d3))));
+
+		Float3 cp = Sub(p, c);
+		float d5 = Dot(ab, cp), d6 = Dot(ac, cp);
+		if (d6 >= 0.0f && d5 <= d6)
+			return Length(cp);
+
+		float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+			return Length(Sub(ap, Scale(ac, d2 / (d2 - d6))));
+
+		float va = d3 * d6 - d5 * d4;
+		if (va <= 0.0f && d4 - d3 >= 0.0f && d5 - d6 >= 0.0f)
+			return Length(Sub(bp, Scale(Sub(c, b), (d4 - d3) / ((d4 - d3) + (d5 - d6)))));
+
+		float denom = va + vb + vc;
+		if (denom <= 0.0f)
+			return std::min({ Length(ap), Length(bp), Length(cp) });
+		float v = vb / denom, w = vc / denom;
+		return Length(Sub(ap, Add(Scale(ab, v), Scale(ac, w))));
+	}
+
+private:
+	struct Triangle
+	{
+		Float3 A, B, C;
+	};
+
+	static Float3 Add(const Float3& a, const Float3& b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+	static Float3 Sub(const Float3& a, const Float3& b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+	static Float3 Scale(const Float3& a, float s) { return { a.X * s, a.Y * s, a.Z * s }; }
+	static float Dot(const Float3& a, const Float3& b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+	static float Length(const Float3& a) { return std::sqrt(Dot(a, a)); }
+
+	std::int32_t Cell(float x) const
+	{
+		return (std::int32_t)std::floor(x / m_CellSize);
+	}
+
+	static std::uint64_t Key(std::int32_t x, std::int32_t y, std::int32_t z)
+	{
+		return ((std::uint64_t)(std::uint32_t)(x & 0x1FFFFF) << 42) | ((std::uint64_t)(std::uint32_t)(y & 0x1FFFFF) << 21) |
+			(std::uint64_t)(std::uint32_t)(z & 0x1FFFFF);
+	}
+
+	float m_CellSize = 1.0f;
+	std::vector<Triangle> m_Triangles;
+	std::unordered_map<std::uint64_t, std::vector<std::uint32_t>> m_Cells;
+};
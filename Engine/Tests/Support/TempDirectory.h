@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Directory under the system temp directory that is deleted with everything in it when
+// the object goes out of scope.  Paths are returned as std::wstring, like the engine takes
+// them.
+class TempDirectory
+{
+public:
+	TempDirectory()
+	{
+		static std::atomic<unsigned> s_Counter = 0;
+		auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+		m_Path = std::filesystem::temp_directory_path() /
+			("EngineTests-" + std::to_string(stamp) + "-" + std::to_string(s_Counter++));
+		std::filesystem::create_directories(m_Path);
+	}
+
+	TempDirectory(const TempDirectory& rhs) = delete;
+	TempDirectory& operator=(const TempDirectory& rhs) = delete;
+
+	~TempDirectory()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_Path, error);
+	}
+
+	const std::filesystem::path& Root() const
+	{
+		return m_Path;
+	}
+
+	std::wstring Path(const std::string& name) const
+	{
+		return (m_Path / name).wstring();
+	}
+
+	std::wstring Write(const std::string& name, const void* data, size_t byteSize) const
+	{
+		std::ofstream file(m_Path / name, std::ios::binary | std::ios::trunc);
+		file.write(static_cast<const char*>(data), (std::streamsize)byteSize);
+		return Path(name);
+	}
+
+	std::wstring Write(const std::string& name, const std::string& text) const
+	{
+		return Write(name, text.data(), text.size());
+	}
+
+	// Whole file, or an empty vector if it cannot be read.
+	static std::vector<std::uint8_t> Read(const std::wstring& path)
+	{
+		std::ifstream file(std::filesystem::path(path), std::ios::binary);
+		return std::vector<std::uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+private:
+	std::filesystem::path m_Path;
+};
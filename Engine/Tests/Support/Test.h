@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Minimal test registry, so the tests build with nothing but the standard library.
+//
+//   TEST(Suite, Name)
+//   {
+//       CHECK(a == b);
+//       REQUIRE_EQ(items.size(), 4u);
+//   }
+//
+// A failed CHECK reports and carries on, a failed REQUIRE also returns from the test.
+// Test executables link TestMain.cpp and exit with 1 when any check failed.
+class TestRegistry
+{
+public:
+	using TestFunction = void(*)();
+
+	static bool Register(const char* suite, const char* name, TestFunction function);
+	static void Fail(const char* file, int line, const std::string& message);
+
+	// Runs the tests whose "Suite.Name" contains the first argument, or all of them.
+	static int RunAll(int argc, char** argv);
+
+private:
+	struct TestCase
+	{
+		const char* Suite;
+		const char* Name;
+		TestFunction Function;
+	};
+
+	static std::vector<TestCase>& Tests();
+
+	static int s_FailureCount;
+};
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static const bool suite##_##name##_Registered = TestRegistry::Register(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+// message is streamed, e.g. CHECK_MSG(visible, "item " << i).
+#define CHECK_MSG(condition, message) \
+	do { \
+		if (!(condition)) \
+		{ \
+			std::ostringstream testMessage; \
+			testMessage << #condition << ": " << message; \
+			TestRegistry::Fail(__FILE__, __LINE__, testMessage.str()); \
+		} \
+	} while (0)
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+			TestRegistry::Fail(__FILE__, __LINE__, #condition); \
+	} while (0)
+
+#define REQUIRE(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			TestRegistry::Fail(__FILE__, __LINE__, #condition); \
+			return; \
+		} \
+	} while (0)
+
+#define TEST_COMPARE(a, b, op, onFailure) \
+	do { \
+		const auto& testA = (a); \
+		const auto& testB = (b); \
+		if (!(testA op testB)) \
+		{ \
+			std::ostringstream testMessage; \
+			testMessage << #a " " #op " " #b " with " << testA << " and " << testB; \
+			TestRegistry::Fail(__FILE__, __LINE__, testMessage.str()); \
+			onFailure; \
+		} \
+	} while (0)
+
+#define CHECK_EQ(a, b) TEST_COMPARE(a, b, ==, (void)0)
+#define CHECK_LT(a, b) TEST_COMPARE(a, b, <, (void)0)
+#define CHECK_LE(a, b) TEST_COMPARE(a, b, <=, (void)0)
+#define CHECK_GT(a, b) TEST_COMPARE(a, b, >, (void)0)
+#define REQUIRE_EQ(a, b) TEST_COMPARE(a, b, ==, return)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do { \
+		double testA = (double)(a); \
+		double testB = (double)(b); \
+		if (!(std::abs(testA - testB) <= (double)(tolerance))) \
+		{ \
+			std::ostringstream testMessage; \
+			testMessage << #a " near " #b " with " << testA << " and " << testB; \
+			TestRegistry::Fail(__FILE__, __LINE__, testMessage.str()); \
+		} \
+	} while (0)
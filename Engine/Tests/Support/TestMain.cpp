@@ -0,0 +1,57 @@
+#include "Test.h"
+
+#include <cstdio>
+#include <cstring>
+
+int TestRegistry::s_FailureCount = 0;
+
+std::vector<TestRegistry::TestCase>& TestRegistry::Tests()
+{
+	// Function local, so it exists before the first static registration runs.
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+bool TestRegistry::Register(const char* suite, const char* name, TestFunction function)
+{
+	Tests().push_back({ suite, name, function });
+	return true;
+}
+
+void TestRegistry::Fail(const char* file, int line, const std::string& message)
+{
+	// Loops over many items would flood the log, the count tells the rest.
+	if (++s_FailureCount <= 50)
+		std::printf("%s(%d): failed: %s\n", file, line, message.c_str());
+}
+
+int TestRegistry::RunAll(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+
+	int testCount = 0;
+	int failedTestCount = 0;
+	for (const TestCase& test : Tests())
+	{
+		std::string fullName = std::string(test.Suite) + "." + test.Name;
+		if (fullName.find(filter) == std::string::npos)
+			continue;
+
+		int failuresBefore = s_FailureCount;
+		std::printf("[ RUN  ] %s\n", fullName.c_str());
+		test.Function();
+
+		bool passed = s_FailureCount == failuresBefore;
+		std::printf("[ %s ] %s\n", passed ? " OK " : "FAIL", fullName.c_str());
+		++testCount;
+		failedTestCount += passed ? 0 : 1;
+	}
+
+	std::printf("%d tests, %d failed, %d failed checks\n", testCount, failedTestCount, s_FailureCount);
+	return failedTestCount == 0 && testCount > 0 ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+	return TestRegistry::RunAll(argc, argv);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Mesh in the layout of the text models in Content/Models, for the ModelLoader and
+// MeshFile tests.
+struct TextModel
+{
+	// Position and normal, six floats per vertex.
+	std::vector<float> Vertices;
+	std::vector<std::uint32_t> Indices;
+
+	std::uint32_t VertexCount() const
+	{
+		return (std::uint32_t)(Vertices.size() / 6);
+	}
+
+	std::uint32_t TriangleCount() const
+	{
+		return (std::uint32_t)(Indices.size() / 3);
+	}
+
+	// Rolling height field of (width + 1) * (depth + 1) vertices.  Every vertex has its
+	// own position, so tests can find a vertex again after the mesh was reordered.
+	static TextModel Terrain(std::uint32_t width, std::uint32_t depth)
+	{
+		TextModel model;
+		for (std::uint32_t z = 0; z <= depth; ++z)
+		{
+			for (std::uint32_t x = 0; x <= width; ++x)
+			{
+				float y = 0.5f * std::sin(0.7f * x) * std::cos(0.5f * z);
+				float dx = 0.35f * std::cos(0.7f * x) * std::cos(0.5f * z);
+				float dz = -0.25f * std::sin(0.7f * x) * std::sin(0.5f * z);
+				float length = std::sqrt(dx * dx + 1.0f + dz * dz);
+				model.Vertices.insert(model.Vertices.end(),
+					{ (float)x, y, (float)z, -dx / length, 1.0f / length, -dz / length });
+			}
+		}
+		for (std::uint32_t z = 0; z < depth; ++z)
+		{
+			for (std::uint32_t x = 0; x < width; ++x)
+			{
+				std::uint32_t i = z * (width + 1) + x;
+				model.Indices.insert(model.Indices.end(),
+					{ i, i + width + 1, i + 1, i + 1, i + width + 1, i + width + 2 });
+			}
+		}
+		return model;
+	}
+
+	// Text in the Content/Models format, with enough digits that the floats read back exactly.
+	std::string ToText() const
+	{
+		std::string text = "VertexCount: " + std::to_string(VertexCount()) + "\r\n";
+		text += "TriangleCount: " + std::to_string(TriangleCount()) + "\r\n";
+		text += "VertexList (pos, normal)\r\n{\r\n";
+		char line[256];
+		for (size_t i = 0; i < Vertices.size(); i += 6)
+		{
+			std::snprintf(line, sizeof(line), "\t%.9g %.9g %.9g %.9g %.9g %.9g\r\n", Vertices[i], Vertices[i + 1],
+				Vertices[i + 2], Vertices[i + 3], Vertices[i + 4], Vertices[i + 5]);
+			text += line;
+		}
+		text += "}\r\nTriangleList\r\n{\r\n";
+		for (size_t i = 0; i < Indices.size(); i += 3)
+		{
+			std::snprintf(line, sizeof(line), "\t%u %u %u\r\n", Indices[i], Indices[i + 1], Indices[i + 2]);
+			text += line;
+		}
+		text += "}\r\n";
+		return text;
+	}
+
+	// Straightforward istream parser, the reference ModelLoader is checked and timed
+	// against.  Fails on anything ModelLoader rejects.
+	static bool Parse(const std::string& text, TextModel& model)
+	{
+		std::istringstream in(text);
+		std::string label;
+		std::uint32_t vertexCount = 0;
+		std::uint32_t triangleCount = 0;
+		if (!(in >> label >> vertexCount) || label != "VertexCount:" ||
+			!(in >> label >> triangleCount) || label != "TriangleCount:")
+			return false;
+
+		auto readBlock = [&in](auto& values, size_t count)
+			{
+				std::string token;
+				while (in >> token && token != "{")
+				{
+				}
+				values.resize(count);
+				for (auto& value : values)
+				{
+					// The whole token has to be the number.
+					if (!(in >> value))
+						return false;
+					int next = in.peek();
+					if (next != std::char_traits<char>::eof() && next != '}' && !std::isspace(next))
+						return false;
+				}
+				return in >> token && token == "}";
+			};
+
+		model = TextModel();
+		if (!readBlock(model.Vertices, 6 * (size_t)vertexCount) || !readBlock(model.Indices, 3 * (size_t)triangleCount))
+			return false;
+
+		for (std::uint32_t index : model.Indices)
+		{
+			if (index >= vertexCount)
+				return false;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,139 @@
+#include "Engine.h"
+#include "Graphics/MeshFile.h"
+#include "SurfaceDistance.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Converts text models the way the engine imports them and prints, for every level of
+// detail, its triangle count, the error the simplifier claimed and the error measured
+// against the full mesh.
+//
+//   LodReport [model.txt...]
+//
+// Without arguments every model in Content/Models is reported.  The measured error is the
+// larger of two one-sided distances, sampled: from the full mesh to the level, and from
+// the level to the full mesh.
+namespace
+{
+	// Further than this fraction of the extent is printed as a lower bound.
+	const float SearchRadius = 0.1f;
+
+	std::vector<std::uint32_t> Indices(const MeshFile& file, const MeshLod& lod)
+	{
+		std::vector<std::uint32_t> indices(lod.IndexCount);
+		const BYTE* data = static_cast<const BYTE*>(file.Indices());
+		for (std::uint32_t i = 0; i < lod.IndexCount; ++i)
+		{
+			if (file.Header().IndexByteSize == sizeof(std::uint16_t))
+				indices[i] = reinterpret_cast<const std::uint16_t*>(data)[lod.FirstIndex + i];
+			else
+				indices[i] = reinterpret_cast<const std::uint32_t*>(data)[lod.FirstIndex + i];
+		}
+		return indices;
+	}
+
+	// Largest distance from the vertices of the full mesh to a level.
+	float VertexDistance(const void* vertices, size_t stride, const std::vector<std::uint32_t>& indices,
+		const SurfaceDistance& surface, float radius)
+	{
+		float worst = 0.0f;
+		std::vector<bool> done;
+		for (std::uint32_t v : indices)
+		{
+			if (v >= done.size())
+				done.resize(v + 1, false);
+			if (done[v])
+				continue;
+			done[v] = true;
+			worst = std::max(worst, surface.Distance(SurfaceDistance::Position(vertices, stride, v), radius, worst));
+		}
+		return worst;
+	}
+
+	// Largest distance from the centroids and edge midpoints of the triangles of a level to
+	// the full mesh.  Their corners are vertices of the full mesh.
+	float TriangleDistance(const void* vertices, size_t stride, const std::vector<std::uint32_t>& indices,
+		const SurfaceDistance& surface, float radius)
+	{
+		float worst = 0.0f;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			SurfaceDistance::Float3 p[3];
+			for (int k = 0; k < 3; ++k)
+				p[k] = SurfaceDistance::Position(vertices, stride, indices[i + k]);
+
+			SurfaceDistance::Float3 samples[4] = {
+				{ (p[0].X + p[1].X + p[2].X) / 3, (p[0].Y + p[1].Y + p[2].Y) / 3, (p[0].Z + p[1].Z + p[2].Z) / 3 },
+				{ (p[0].X + p[1].X) / 2, (p[0].Y + p[1].Y) / 2, (p[0].Z + p[1].Z) / 2 },
+				{ (p[1].X + p[2].X) / 2, (p[1].Y + p[2].Y) / 2, (p[1].Z + p[2].Z) / 2 },
+				{ (p[2].X + p[0].X) / 2, (p[2].Y + p[0].Y) / 2, (p[2].Z + p[0].Z) / 2 } };
+			for (const SurfaceDistance::Float3& sample : samples)
+				worst = std::max(worst, surface.Distance(sample, radius, worst));
+		}
+		return worst;
+	}
+
+	bool Report(const std::filesystem::path& path)
+	{
+		MeshFile file;
+		MeshOptimizer::Result stats;
+		if (!file.ParseText(path.wstring(), &stats))
+		{
+			std::printf("%s: cannot parse\n", path.string().c_str());
+			return false;
+		}
+
+		const MeshFileHeader& header = file.Header();
+		const MeshLod* lods = header.Lods;
+		std::vector<std::uint32_t> full = Indices(file, lods[0]);
+		// Diagonal of the bounding box, the extent the simplifier bounds its error by.
+		const DirectX::XMFLOAT3& halfSize = header.Bounds.Box.Extents;
+		const float extent = 2.0f * std::sqrt(halfSize.x * halfSize.x + halfSize.y * halfSize.y + halfSize.z * halfSize.z);
+		const float radius = SearchRadius * extent;
+
+		std::printf("%s: %u vertices, extent %.3f, ACMR %.3f -> %.3f\n", path.filename().string().c_str(),
+			header.VertexCount, extent, stats.Before.Acmr, stats.After.Acmr);
+		std::printf("  LOD  triangles   of full     error  to level   to full  of extent\n");
+
+		SurfaceDistance fullSurface(file.Vertices(), header.VertexByteStride, full.data(), full.size());
+		for (std::uint32_t i = 0; i < header.LodCount; ++i)
+		{
+			std::vector<std::uint32_t> indices = Indices(file, lods[i]);
+			SurfaceDistance lodSurface(file.Vertices(), header.VertexByteStride, indices.data(), indices.size());
+			float toLevel = VertexDistance(file.Vertices(), header.VertexByteStride, full, lodSurface, radius);
+			float toFull = TriangleDistance(file.Vertices(), header.VertexByteStride, indices, fullSurface, radius);
+			float measured = std::max(toLevel, toFull);
+
+			std::printf("  %3u  %9u  %7.1f%%  %8.4f  %s%7.4f  %s%7.4f  %8.2f%%\n", i, lods[i].IndexCount / 3,
+				100.0f * lods[i].IndexCount / lods[0].IndexCount, lods[i].Error, toLevel >= radius ? ">" : " ", toLevel,
+				toFull >= radius ? ">" : " ", toFull, 100.0f * measured / extent);
+		}
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<std::filesystem::path> paths;
+	for (int i = 1; i < argc; ++i)
+		paths.push_back(argv[i]);
+	if (paths.empty())
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(ENGINE_CONTENT_DIR) / "Models"))
+		{
+			if (entry.path().extension() == ".txt")
+				paths.push_back(entry.path());
+		}
+		std::sort(paths.begin(), paths.end());
+	}
+
+	bool ok = true;
+	for (const std::filesystem::path& path : paths)
+		ok = Report(path) && ok;
+	return ok ? 0 : 1;
+}